@@ -1093,6 +1093,25 @@ void gic_clear_irq_pending(unsigned int irq)
 	raw_spin_unlock(&irq_controller_lock);
 }
 
+/*
+ * Return the hardware number of the highest priority interrupt pending
+ * on this cpu's interface without acknowledging it, 1023 if there is
+ * none.  Meant for finding the wakeup source with interrupts disabled.
+ */
+unsigned int gic_get_pending_hwirq(void)
+{
+	struct gic_chip_data *gic = &gic_data[0];
+	u32 val;
+
+	if (gic->need_access_lock)
+		raw_spin_lock(&irq_controller_lock);
+	val = readl_relaxed(gic_data_cpu_base(gic) + GIC_CPU_HIGHPRI);
+	if (gic->need_access_lock)
+		raw_spin_unlock(&irq_controller_lock);
+
+	return val & 0x3ff;
+}
+
 #ifdef CONFIG_ARCH_MSM8625
  /*
   *  Check for any interrupts which are enabled are pending
@@ -97,6 +97,8 @@ static inline void __dma_single_dev_to_cpu(const void *kaddr, size_t size,
 		___dma_single_dev_to_cpu(kaddr, size, dir);
 }
 
+extern bool dma_cache_maint_all(size_t size);
+
 static inline void __dma_page_cpu_to_dev(struct page *page, unsigned long off,
 	size_t size, enum dma_data_direction dir)
 {
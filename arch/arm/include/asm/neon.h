@@ -0,0 +1,31 @@
+/*
+ * linux/arch/arm/include/asm/neon.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#ifndef __ASM_NEON_H
+#define __ASM_NEON_H
+
+#include <asm/hwcap.h>
+
+#define cpu_has_neon()		(!!(elf_hwcap & HWCAP_NEON))
+
+/*
+ * memcpy(), memset() and __memzero() pass requests of at least this
+ * many bytes on to the NEON routines in arch/arm/lib/neon.c.
+ */
+#define NEON_STRING_MIN		256
+
+#ifndef __ASSEMBLY__
+/*
+ * The kernel may only use NEON registers between kernel_neon_begin()
+ * and kernel_neon_end().  Those must not be called from interrupt
+ * context, and the code in between must not sleep.
+ */
+void kernel_neon_begin(void);
+void kernel_neon_end(void);
+#endif
+
+#endif
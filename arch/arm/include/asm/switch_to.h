@@ -2,6 +2,7 @@
 #define __ASM_ARM_SWITCH_TO_H
 
 #include <linux/thread_info.h>
+#include <mach/msm_rtb.h>
 
 /*
  * switch_to(prev, next) should switch from task `prev' to `next'
@@ -12,6 +13,8 @@ extern struct task_struct *__switch_to(struct task_struct *, struct thread_info
 
 #define switch_to(prev,next,last)					\
 do {									\
+	uncached_logk_pc(LOGK_SCHED | LOGTYPE_NOPC,			\
+			 (void *)(long)(prev)->pid, (void *)(long)(next)->pid); \
 	last = __switch_to(prev,task_thread_info(prev), task_thread_info(next));	\
 } while (0)
 
@@ -451,6 +451,33 @@ static inline void local_flush_tlb_kernel_page(unsigned long kaddr)
 	}
 }
 
+/*
+ *	cpu_flush_tlb_kernel_page(kaddr)
+ *
+ *	Like local_flush_tlb_kernel_page(), but without the inner shareable
+ *	broadcast that SMP v7 uses for it.  Only for kernel mappings that
+ *	no other CPU ever accesses, like the per-CPU kmap_atomic slots.
+ */
+static inline void cpu_flush_tlb_kernel_page(unsigned long kaddr)
+{
+	const unsigned int __tlb_flag = __cpu_tlb_flags;
+
+	if (!tlb_flag(TLB_V7_UIS_PAGE)) {
+		local_flush_tlb_kernel_page(kaddr);
+		return;
+	}
+
+	kaddr &= PAGE_MASK;
+	dsb();
+#ifdef CONFIG_ARCH_MSM8X60
+	asm("mcr p15, 0, %0, c8, c7, 3" : : "r" (kaddr) : "cc");
+#else
+	asm("mcr p15, 0, %0, c8, c7, 1" : : "r" (kaddr) : "cc");
+#endif
+	dsb();
+	isb();
+}
+
 /*
  *	flush_pmd_entry
  *
@@ -41,6 +41,7 @@
 #include <asm/mach/time.h>
 
 #include <asm/perftypes.h>
+#include <mach/msm_rtb.h>
 
 /*
  * No architecture-specific irq_finish function defined in arm/arch/irqs.h.
@@ -85,7 +86,9 @@ void handle_IRQ(unsigned int irq, struct pt_regs *regs)
 			printk(KERN_WARNING "Bad IRQ%u\n", irq);
 		ack_bad_irq(irq);
 	} else {
+		uncached_logk(LOGK_IRQ, (void *)irq);
 		generic_handle_irq(irq);
+		uncached_logk(LOGK_IRQ, (void *)(irq | LOGK_IRQ_EXIT));
 	}
 
 	/* AT91 specific workaround */
@@ -0,0 +1,119 @@
+/*
+ *  linux/arch/arm/lib/neon.c
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Large memcpy(), memset(), __memzero() and copy_page() requests are
+ * passed on to here.  On Krait they are done with NEON when the caller
+ * may use it, everything else goes back to the ARM routines.
+ */
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/hardirq.h>
+#include <linux/irqflags.h>
+#include <asm/cputype.h>
+#include <asm/neon.h>
+#include <asm/page.h>
+
+/* the ARM routines, entered past the NEON dispatch */
+extern void *__memcpy_arm(void *dest, const void *src, size_t n);
+extern void *__memset_arm(void *s, int c, size_t n);
+extern void __memzero_arm(void *s, size_t n);
+extern void __copy_page_arm(void *to, const void *from);
+
+extern void __memcpy_neon(void *dest, const void *src, size_t n);
+extern void __memset_neon(void *s, int c, size_t n);
+extern void __copy_page_neon(void *to, const void *from);
+
+static bool neon_string_enabled __read_mostly;
+
+/*
+ * kernel_neon_begin() cannot be used from interrupt context.  CPU bring
+ * up and resume copy with interrupts off before VFP access is enabled
+ * again, and are left alone as well.
+ */
+static inline bool neon_string_usable(void)
+{
+	return neon_string_enabled && !in_interrupt() && !irqs_disabled();
+}
+
+/* the stores are done in 16 byte aligned blocks of 64 bytes */
+static inline size_t neon_string_head(const void *p)
+{
+	return -(unsigned long)p & 15;
+}
+
+void *neon_memcpy(void *dest, const void *src, size_t n)
+{
+	size_t head, bulk;
+
+	if (!neon_string_usable())
+		return __memcpy_arm(dest, src, n);
+
+	head = neon_string_head(dest);
+	if (head)
+		__memcpy_arm(dest, src, head);
+	bulk = (n - head) & ~63;
+
+	kernel_neon_begin();
+	__memcpy_neon(dest + head, src + head, bulk);
+	kernel_neon_end();
+
+	if (n != head + bulk)
+		__memcpy_arm(dest + head + bulk, src + head + bulk,
+			     n - head - bulk);
+	return dest;
+}
+
+void *neon_memset(void *s, int c, size_t n)
+{
+	size_t head, bulk;
+
+	if (!neon_string_usable())
+		return __memset_arm(s, c, n);
+
+	head = neon_string_head(s);
+	if (head)
+		__memset_arm(s, c, head);
+	bulk = (n - head) & ~63;
+
+	kernel_neon_begin();
+	__memset_neon(s + head, c, bulk);
+	kernel_neon_end();
+
+	if (n != head + bulk)
+		__memset_arm(s + head + bulk, c, n - head - bulk);
+	return s;
+}
+
+void neon_memzero(void *s, size_t n)
+{
+	if (!neon_string_usable())
+		__memzero_arm(s, n);
+	else
+		neon_memset(s, 0, n);
+}
+
+void neon_copy_page(void *to, const void *from)
+{
+	if (!neon_string_usable()) {
+		__copy_page_arm(to, from);
+		return;
+	}
+
+	kernel_neon_begin();
+	__copy_page_neon(to, from);
+	kernel_neon_end();
+}
+
+/* vfp_init() is a late_initcall, HWCAP_NEON is only known after it */
+static int __init neon_string_init(void)
+{
+	/* the loops in copy_neon.S are tuned for Krait */
+	if (cpu_has_neon() && (read_cpuid_id() & 0xff00fc00) == 0x51000400)
+		neon_string_enabled = true;
+	return 0;
+}
+late_initcall_sync(neon_string_init);
@@ -57,6 +57,8 @@ static struct drv_data {
 	struct hfpll_data *hfpll_data;
 	u32 bus_perf_client;
 	struct msm_bus_scale_pdata *bus_scale;
+	unsigned int bw_l2_level;	/* bus vote asked for by the L2 rate */
+	int bw_demand_level;		/* measured demand vote, -1 if none */
 	int boost_uv;
 	struct device *dev;
 } drv;
@@ -198,17 +200,55 @@ static unsigned int compute_l2_level(struct scalable *sc, unsigned int vote_l)
 	return new_l;
 }
 
-/* Update the bus bandwidth request. */
+/*
+ * Update the bus bandwidth request. While a bandwidth monitor reports
+ * the measured demand, it is voted for instead of the L2 rate level.
+ */
 static void set_bus_bw(unsigned int bw)
 {
 	int ret;
 
+	drv.bw_l2_level = bw;
+	if (drv.bw_demand_level >= 0)
+		bw = drv.bw_demand_level;
+
 	/* Update bandwidth if request has changed. This may sleep. */
 	ret = msm_bus_scale_client_update_request(drv.bus_perf_client, bw);
 	if (ret)
 		dev_err(drv.dev, "bandwidth request failed (%d)\n", ret);
 }
 
+/**
+ * acpuclk_krait_set_bw_demand - vote for the bus bandwidth actually used
+ * @mbps:	measured CPU to DDR bandwidth in MBps, 0 to go back to
+ *		voting by the L2 rate
+ *
+ * Picks the lowest bus level of at least @mbps, the levels are in
+ * increasing order like the L2 levels that refer to them.  May sleep.
+ */
+void acpuclk_krait_set_bw_demand(unsigned int mbps)
+{
+	struct msm_bus_scale_pdata *bus = drv.bus_scale;
+	int level = -1;
+
+	mutex_lock(&driver_lock);
+	if (!drv.bus_perf_client)
+		goto out;
+
+	if (mbps) {
+		for (level = 0; level < bus->num_usecases - 1; level++)
+			if (bus->usecase[level].vectors[0].ib >=
+			    (u64) mbps * 1000000)
+				break;
+	}
+	if (level != drv.bw_demand_level) {
+		drv.bw_demand_level = level;
+		set_bus_bw(drv.bw_l2_level);
+	}
+out:
+	mutex_unlock(&driver_lock);
+}
+
 /* Set the CPU or L2 clock speed. */
 static void set_speed(struct scalable *sc, const struct core_speed *tgt_s)
 {
@@ -426,9 +466,26 @@ static int calculate_vdd_dig(const struct acpu_level *tgt)
 static bool enable_boost = true;
 module_param_named(boost, enable_boost, bool, S_IRUGO | S_IWUSR);
 
+/* largest margin below the table voltage that AVS feedback may learn */
+static int avs_max_uv = 50000;
+module_param(avs_max_uv, int, S_IRUGO | S_IWUSR);
+
 static int calculate_vdd_core(const struct acpu_level *tgt)
 {
-	return tgt->vdd_core + (enable_boost ? drv.boost_uv : 0);
+	int avs_uv = clamp(tgt->avs_uv, 0, max(avs_max_uv, 0));
+
+	return tgt->vdd_core - avs_uv + (enable_boost ? drv.boost_uv : 0);
+}
+
+static const struct acpu_level *find_acpu_level(unsigned long rate)
+{
+	const struct acpu_level *tgt;
+
+	for (tgt = drv.acpu_freq_tbl; tgt->speed.khz != 0; tgt++)
+		if (tgt->speed.khz == rate)
+			return tgt;
+
+	return NULL;
 }
 
 /* Set the CPU's clock rate and adjust the L2 rate, voltage and BW requests. */
@@ -455,16 +512,12 @@ static int acpuclk_krait_set_rate(int cpu, unsigned long rate,
 		goto out;
 
 	/* Find target frequency. */
-	for (tgt = drv.acpu_freq_tbl; tgt->speed.khz != 0; tgt++) {
-		if (tgt->speed.khz == rate) {
-			tgt_acpu_s = &tgt->speed;
-			break;
-		}
-	}
-	if (tgt->speed.khz == 0) {
+	tgt = find_acpu_level(rate);
+	if (!tgt) {
 		rc = -EINVAL;
 		goto out;
 	}
+	tgt_acpu_s = &tgt->speed;
 
 	/* Calculate voltage requirements for the current CPU. */
 	vdd_data.vdd_mem  = calculate_vdd_mem(tgt);
@@ -515,9 +568,157 @@ out:
 	return rc;
 }
 
+/*
+ * Set the clock rate of all online CPUs in @mask at once. The voltage
+ * votes of every CPU are raised before any of them switches, and the L2
+ * rate and bus bandwidth are updated a single time for the whole set
+ * rather than once per CPU.
+ */
+static int acpuclk_krait_set_rate_mask(const struct cpumask *mask,
+				       unsigned long rate,
+				       enum setrate_reason reason)
+{
+	const struct acpu_level *tgt;
+	struct vdd_data vdd_data;
+	struct cpumask changed;
+	unsigned long flags;
+	int cpu, tgt_l2_l;
+	int rc = 0;
+
+	if (reason != SETRATE_CPUFREQ)
+		return -EINVAL;
+
+	mutex_lock(&driver_lock);
+
+	tgt = find_acpu_level(rate);
+	if (!tgt) {
+		rc = -EINVAL;
+		goto out;
+	}
+
+	vdd_data.vdd_mem  = calculate_vdd_mem(tgt);
+	vdd_data.vdd_dig  = calculate_vdd_dig(tgt);
+	vdd_data.vdd_core = calculate_vdd_core(tgt);
+	vdd_data.ua_core = tgt->ua_core;
+
+	/* Increase VDD levels of every CPU that changes. */
+	cpumask_clear(&changed);
+	for_each_cpu_and(cpu, mask, cpu_online_mask) {
+		if (drv.scalable[cpu].cur_speed == &tgt->speed)
+			continue;
+		rc = increase_vdd(cpu, &vdd_data, reason);
+		if (rc)
+			break;
+		cpumask_set_cpu(cpu, &changed);
+	}
+	if (cpumask_empty(&changed))
+		goto out;
+
+	for_each_cpu(cpu, &changed) {
+		dev_dbg(drv.dev, "Switching from ACPU%d rate %lu KHz -> %lu KHz\n",
+			cpu, drv.scalable[cpu].cur_speed->khz, tgt->speed.khz);
+		set_speed(&drv.scalable[cpu], &tgt->speed);
+	}
+
+	/* One L2 vote update and rate change for all of them. */
+	spin_lock_irqsave(&l2_lock, flags);
+	for_each_cpu(cpu, &changed)
+		drv.scalable[cpu].l2_vote = tgt->l2_level;
+	tgt_l2_l = compute_l2_level(&drv.scalable[cpumask_first(&changed)],
+				    tgt->l2_level);
+	set_speed(&drv.scalable[L2], &drv.l2_freq_tbl[tgt_l2_l].speed);
+	spin_unlock_irqrestore(&l2_lock, flags);
+
+	set_bus_bw(drv.l2_freq_tbl[tgt_l2_l].bw_level);
+
+	for_each_cpu(cpu, &changed)
+		decrease_vdd(cpu, &vdd_data, reason);
+
+	dev_dbg(drv.dev, "ACPU speed change complete\n");
+out:
+	mutex_unlock(&driver_lock);
+	return rc;
+}
+
+static struct acpu_level *find_cur_acpu_level(int cpu)
+{
+	const struct core_speed *speed = drv.scalable[cpu].cur_speed;
+	struct acpu_level *lvl;
+
+	for (lvl = drv.acpu_freq_tbl; lvl->speed.khz != 0; lvl++)
+		if (&lvl->speed == speed)
+			return lvl;
+
+	return NULL;
+}
+
+/**
+ * acpuclk_krait_avs_feedback - adjust the learned voltage of a CPU's level
+ * @cpu:	CPU the sensors measured
+ * @delta_uv:	change of the core voltage they ask for, negative to go lower
+ *
+ * The margin below the table voltage is learned per frequency level and
+ * used by every switch to that level, so a transition goes straight to
+ * the voltage the level was found to need.  A request for more voltage
+ * is also applied at once when called on @cpu, as the CPU regulators
+ * need; otherwise it takes effect at the next switch.  May sleep.
+ */
+void acpuclk_krait_avs_feedback(int cpu, int delta_uv)
+{
+	struct acpu_level *lvl;
+	struct vdd_data vdd_data;
+	int avs_uv;
+
+	if (cpu < 0 || cpu >= num_possible_cpus())
+		return;
+
+	mutex_lock(&driver_lock);
+	lvl = find_cur_acpu_level(cpu);
+	if (!lvl)
+		goto out;
+
+	avs_uv = clamp(lvl->avs_uv - delta_uv, 0, max(avs_max_uv, 0));
+	if (avs_uv == lvl->avs_uv)
+		goto out;
+	dev_dbg(drv.dev, "ACPU%d %lu KHz AVS margin %d -> %d uV\n", cpu,
+		lvl->speed.khz, lvl->avs_uv, avs_uv);
+	lvl->avs_uv = avs_uv;
+
+	if (delta_uv > 0 && cpu == raw_smp_processor_id()) {
+		vdd_data.vdd_mem  = calculate_vdd_mem(lvl);
+		vdd_data.vdd_dig  = calculate_vdd_dig(lvl);
+		vdd_data.vdd_core = calculate_vdd_core(lvl);
+		vdd_data.ua_core = lvl->ua_core;
+		increase_vdd(cpu, &vdd_data, SETRATE_CPUFREQ);
+	}
+out:
+	mutex_unlock(&driver_lock);
+}
+
+/*
+ * Dynamic power of a CPU at its current rate and voltage, f * V^2 in
+ * MHz * V^2.  Called from task wakeup without any locks held, a stale
+ * value only makes for a worse placement.
+ */
+static unsigned long acpuclk_krait_power_cost(int cpu)
+{
+	const struct scalable *sc = &drv.scalable[cpu];
+	const struct core_speed *speed = ACCESS_ONCE(sc->cur_speed);
+	unsigned long mhz, mv;
+
+	if (!speed)
+		return 0;
+
+	mhz = speed->khz / 1000;
+	mv = ACCESS_ONCE(sc->vreg[VREG_CORE].cur_vdd) / 1000;
+	return mhz * mv / 1000 * mv / 1000;
+}
+
 static struct acpuclk_data acpuclk_krait_data = {
 	.set_rate = acpuclk_krait_set_rate,
+	.set_rate_mask = acpuclk_krait_set_rate_mask,
 	.get_rate = acpuclk_krait_get_rate,
+	.power_cost = acpuclk_krait_power_cost,
 };
 
 /* Initialize a HFPLL at a given rate and enable it. */
@@ -828,6 +1029,8 @@ static void __init bus_init(const struct l2_level *l2_level)
 		BUG();
 	}
 
+	drv.bw_l2_level = l2_level->bw_level;
+	drv.bw_demand_level = -1;
 	ret = msm_bus_scale_client_update_request(drv.bus_perf_client,
 			l2_level->bw_level);
 	if (ret)
@@ -143,6 +143,7 @@ struct l2_level {
  * @l2_level: L2 configuration to use.
  * @vdd_core: CPU core voltage in uV.
  * @ua_core: CPU core current consumption in uA.
+ * @avs_uv: Margin below @vdd_core learned from AVS feedback, in uV.
  */
 struct acpu_level {
 	const int use_for_scaling;
@@ -150,6 +151,7 @@ struct acpu_level {
 	const unsigned int l2_level;
 	int vdd_core;
 	int ua_core;
+	int avs_uv;
 };
 
 /**
@@ -258,4 +260,14 @@ struct acpuclk_krait_params {
 extern int acpuclk_krait_init(struct device *dev,
 			      const struct acpuclk_krait_params *params);
 
+/**
+ * acpuclk_krait_set_bw_demand - Vote for the measured CPU bus bandwidth.
+ */
+extern void acpuclk_krait_set_bw_demand(unsigned int mbps);
+
+/**
+ * acpuclk_krait_avs_feedback - Report the CPU voltage AVS sensors ask for.
+ */
+extern void acpuclk_krait_avs_feedback(int cpu, int delta_uv);
+
 #endif
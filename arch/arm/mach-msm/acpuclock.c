@@ -12,6 +12,7 @@
 
 #include <linux/cpu.h>
 #include <linux/smp.h>
+#include <linux/sched.h>
 #include "acpuclock.h"
 
 static struct acpuclk_data *acpuclk_data;
@@ -32,6 +33,22 @@ int acpuclk_set_rate(int cpu, unsigned long rate, enum setrate_reason reason)
 	return acpuclk_data->set_rate(cpu, rate, reason);
 }
 
+int acpuclk_set_rate_mask(const struct cpumask *mask, unsigned long rate,
+			  enum setrate_reason reason)
+{
+	int cpu, rc = 0;
+
+	if (acpuclk_data->set_rate_mask)
+		return acpuclk_data->set_rate_mask(mask, rate, reason);
+
+	for_each_cpu_and(cpu, mask, cpu_online_mask) {
+		rc = acpuclk_set_rate(cpu, rate, reason);
+		if (rc)
+			break;
+	}
+	return rc;
+}
+
 uint32_t acpuclk_get_switch_time(void)
 {
 	return acpuclk_data->switch_time_us;
@@ -53,6 +70,17 @@ unsigned long acpuclk_wait_for_irq(void)
 	return rate;
 }
 
+#ifdef CONFIG_SMP
+/* Lets the scheduler pack small tasks onto the CPUs cheapest to run */
+unsigned long arch_cpu_power_cost(int cpu)
+{
+	if (!acpuclk_data || !acpuclk_data->power_cost)
+		return 0;
+
+	return acpuclk_data->power_cost(cpu);
+}
+#endif
+
 void __devinit acpuclk_register(struct acpuclk_data *data)
 {
 	acpuclk_data = data;
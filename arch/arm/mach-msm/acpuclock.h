@@ -19,6 +19,8 @@
 #ifndef __ARCH_ARM_MACH_MSM_ACPUCLOCK_H
 #define __ARCH_ARM_MACH_MSM_ACPUCLOCK_H
 
+struct cpumask;
+
 /**
  * enum setrate_reason - Reasons for use with acpuclk_set_rate()
  */
@@ -44,6 +46,9 @@ struct acpuclk_pdata {
 struct acpuclk_data {
 	unsigned long (*get_rate)(int cpu);
 	int (*set_rate)(int cpu, unsigned long rate, enum setrate_reason);
+	int (*set_rate_mask)(const struct cpumask *mask, unsigned long rate,
+			     enum setrate_reason);
+	unsigned long (*power_cost)(int cpu);
 	uint32_t switch_time_us;
 	unsigned long power_collapse_khz;
 	unsigned long wait_for_irq_khz;
@@ -65,6 +70,20 @@ unsigned long acpuclk_get_rate(int cpu);
  */
 int acpuclk_set_rate(int cpu, unsigned long rate, enum setrate_reason);
 
+/**
+ * acpuclk_set_rate_mask() - Set the clock rate of several CPUs
+ * @mask: CPUs to set the rate of, offline ones are skipped
+ * @rate: Desired rate in KHz
+ * @setrate_reason: Reason for the rate switch, only SETRATE_CPUFREQ
+ *
+ * Drivers that support it apply the shared voltage, L2 and bus changes
+ * once for the whole set, the others switch the CPUs one by one.
+ *
+ * Returns 0 for success.
+ */
+int acpuclk_set_rate_mask(const struct cpumask *mask, unsigned long rate,
+			  enum setrate_reason);
+
 /**
  * acpuclk_get_switch_time() - Query estimated time in us for a CPU rate switch
  */
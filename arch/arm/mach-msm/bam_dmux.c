@@ -27,6 +27,7 @@
 #include <linux/clk.h>
 #include <linux/wakelock.h>
 #include <linux/kfifo.h>
+#include <linux/hrtimer.h>
 
 #include <mach/sps.h>
 #include <mach/bam_dmux.h>
@@ -70,6 +71,27 @@ static int bam_adaptive_timer_enabled = 1;
 module_param_named(adaptive_timer_enabled,
 			bam_adaptive_timer_enabled,
 		   int, S_IRUGO | S_IWUSR | S_IWGRP);
+static int rx_copybreak = 256;
+module_param_named(rx_copybreak, rx_copybreak,
+		   int, S_IRUGO | S_IWUSR | S_IWGRP);
+static int ul_aggregation = 1;
+module_param_named(ul_aggregation, ul_aggregation,
+		   int, S_IRUGO | S_IWUSR | S_IWGRP);
+static int ul_aggr_us = 1000;
+module_param_named(ul_aggr_us, ul_aggr_us,
+		   int, S_IRUGO | S_IWUSR | S_IWGRP);
+/* packets handled per poll before yielding the cpu */
+static int rx_poll_budget = 64;
+module_param_named(poll_budget, rx_poll_budget,
+		   int, S_IRUGO | S_IWUSR | S_IWGRP);
+/* back to interrupts below this many packets per poll, in percent */
+static int rx_irq_threshold = 25;
+module_param_named(irq_threshold, rx_irq_threshold,
+		   int, S_IRUGO | S_IWUSR | S_IWGRP);
+/* longest a received packet should wait for the next poll, in us */
+static int rx_latency_us = 2000;
+module_param_named(latency_us, rx_latency_us,
+		   int, S_IRUGO | S_IWUSR | S_IWGRP);
 
 #if defined(DEBUG)
 static uint32_t bam_dmux_read_cnt;
@@ -159,6 +181,7 @@ struct tx_pkt_info {
 	struct list_head list_node;
 	unsigned ts_sec;
 	unsigned long ts_nsec;
+	struct sk_buff_head aggr;	/* packets copied into skb, if any */
 };
 
 struct rx_pkt_info {
@@ -175,6 +198,12 @@ struct rx_pkt_info {
 #define A2_PHYS_SIZE		0x2000
 #define BUFFER_SIZE		2048
 #define NUM_BUFFERS		32
+/* uplink aggregation: transfer size, packets and largest packet */
+#define UL_AGGR_SIZE		2048
+#define UL_AGGR_MAX_PKTS	16
+#define UL_AGGR_SMALL		256
+/* queue_rx() tops up once this many descriptors were consumed */
+#define RX_REFILL_BATCH		8
 static struct sps_bam_props a2_props;
 static u32 a2_device_handle;
 static struct sps_pipe *bam_tx_pipe;
@@ -191,10 +220,18 @@ static int bam_mux_initialized;
 
 static int polling_mode;
 static unsigned long rx_timer_interval;
+/* average packets per poll in 1/256ths, and moderation counters */
+static unsigned int rx_poll_rate;
+static unsigned int rx_poll_cycles;
+static unsigned int rx_to_poll_cnt;
+static unsigned int rx_to_irq_cnt;
+static unsigned int rx_budget_cnt;
 
 static LIST_HEAD(bam_rx_pool);
 static DEFINE_MUTEX(bam_rx_pool_mutexlock);
 static int bam_rx_pool_len;
+/* unmapped receive buffers for queue_rx() to reuse before allocating */
+static struct sk_buff_head bam_rx_spare;
 static LIST_HEAD(bam_tx_pool);
 static DEFINE_SPINLOCK(bam_tx_pool_spinlock);
 static DEFINE_MUTEX(bam_pdev_mutexlock);
@@ -221,6 +258,7 @@ static struct workqueue_struct *bam_mux_tx_workqueue;
 /* A2 power collaspe */
 #define UL_TIMEOUT_DELAY 1000	/* in ms */
 #define ENABLE_DISCONNECT_ACK	0x1
+#define ENABLE_UL_AGGREGATION	0x2
 static void toggle_apps_ack(void);
 static void reconnect_to_bam(void);
 static void disconnect_to_bam(void);
@@ -260,6 +298,19 @@ static DEFINE_MUTEX(delayed_ul_vote_lock);
 static int need_delayed_ul_vote;
 static int power_management_only_mode;
 
+/*
+ * Uplink aggregation.  When the A2 announces support in the open
+ * command, small packets are copied one after the other, each still
+ * with its own mux header and padding, into a single transfer.  It is
+ * sent when full or ul_aggr_us after the first packet went in.
+ */
+static int ul_aggr_supported;
+static DEFINE_SPINLOCK(ul_aggr_lock);
+static struct tx_pkt_info *ul_aggr_pkt;
+static struct hrtimer ul_aggr_timer;
+static void ul_aggr_flush_func(struct work_struct *work);
+static DECLARE_WORK(ul_aggr_flush_work, ul_aggr_flush_func);
+
 struct outside_notify_func {
 	void (*notify)(void *, int, unsigned long);
 	void *priv;
@@ -410,6 +461,19 @@ static inline void verify_tx_queue_is_empty(const char *func)
 	spin_unlock_irqrestore(&bam_tx_pool_spinlock, flags);
 }
 
+/*
+ * Keep a receive buffer the clients did not take for queue_rx().  Must
+ * be called with interrupts enabled, see skb_recycle_check().
+ */
+static void rx_recycle(struct sk_buff *skb)
+{
+	if (skb_queue_len(&bam_rx_spare) < NUM_BUFFERS &&
+	    skb_recycle_check(skb, BUFFER_SIZE))
+		skb_queue_tail(&bam_rx_spare, skb);
+	else
+		dev_kfree_skb_any(skb);
+}
+
 static void queue_rx(void)
 {
 	void *ptr;
@@ -421,6 +485,10 @@ static void queue_rx(void)
 	rx_len_cached = bam_rx_pool_len;
 	mutex_unlock(&bam_rx_pool_mutexlock);
 
+	/* refill in batches rather than after every packet */
+	if (rx_len_cached > NUM_BUFFERS - RX_REFILL_BATCH)
+		return;
+
 	while (rx_len_cached < NUM_BUFFERS) {
 		if (in_global_reset)
 			goto fail;
@@ -433,7 +501,9 @@ static void queue_rx(void)
 
 		INIT_WORK(&info->work, handle_bam_mux_cmd);
 
-		info->skb = __dev_alloc_skb(BUFFER_SIZE, GFP_KERNEL);
+		info->skb = skb_dequeue(&bam_rx_spare);
+		if (info->skb == NULL)
+			info->skb = __dev_alloc_skb(BUFFER_SIZE, GFP_KERNEL);
 		if (info->skb == NULL) {
 			DMUX_LOG_KERR("%s: unable to alloc skb\n", __func__);
 			goto fail_info;
@@ -489,24 +559,38 @@ static void bam_mux_process_data(struct sk_buff *rx_skb)
 	unsigned long flags;
 	struct bam_mux_hdr *rx_hdr;
 	unsigned long event_data;
+	struct sk_buff *copy = NULL;
+	uint8_t ch_id;
 
 	rx_hdr = (struct bam_mux_hdr *)rx_skb->data;
+	ch_id = rx_hdr->ch_id;
 
-	rx_skb->data = (unsigned char *)(rx_hdr + 1);
-	rx_skb->tail = rx_skb->data + rx_hdr->pkt_len;
-	rx_skb->len = rx_hdr->pkt_len;
-	rx_skb->truesize = rx_hdr->pkt_len + sizeof(struct sk_buff);
+	/* copy small packets out so that the full size buffer is reused */
+	if (rx_hdr->pkt_len <= rx_copybreak)
+		copy = __dev_alloc_skb(rx_hdr->pkt_len, GFP_KERNEL);
+
+	if (copy) {
+		memcpy(skb_put(copy, rx_hdr->pkt_len), rx_hdr + 1,
+		       rx_hdr->pkt_len);
+		rx_recycle(rx_skb);
+		rx_skb = copy;
+	} else {
+		rx_skb->data = (unsigned char *)(rx_hdr + 1);
+		rx_skb->tail = rx_skb->data + rx_hdr->pkt_len;
+		rx_skb->len = rx_hdr->pkt_len;
+		rx_skb->truesize = rx_hdr->pkt_len + sizeof(struct sk_buff);
+	}
 
 	event_data = (unsigned long)(rx_skb);
 
-	spin_lock_irqsave(&bam_ch[rx_hdr->ch_id].lock, flags);
-	if (bam_ch[rx_hdr->ch_id].notify)
-		bam_ch[rx_hdr->ch_id].notify(
-			bam_ch[rx_hdr->ch_id].priv, BAM_DMUX_RECEIVE,
+	spin_lock_irqsave(&bam_ch[ch_id].lock, flags);
+	if (bam_ch[ch_id].notify)
+		bam_ch[ch_id].notify(
+			bam_ch[ch_id].priv, BAM_DMUX_RECEIVE,
 							event_data);
 	else
 		dev_kfree_skb_any(rx_skb);
-	spin_unlock_irqrestore(&bam_ch[rx_hdr->ch_id].lock, flags);
+	spin_unlock_irqrestore(&bam_ch[ch_id].lock, flags);
 
 	queue_rx();
 }
@@ -524,6 +608,8 @@ static inline void handle_bam_mux_cmd_open(struct bam_mux_hdr *rx_hdr)
 		queue_rx();
 		return;
 	}
+	if (rx_hdr->reserved & ENABLE_UL_AGGREGATION)
+		ul_aggr_supported = 1;
 	spin_lock_irqsave(&bam_ch[rx_hdr->ch_id].lock, flags);
 	bam_ch[rx_hdr->ch_id].status |= BAM_CH_REMOTE_OPEN;
 	bam_ch[rx_hdr->ch_id].num_tx_pkts = 0;
@@ -560,7 +646,7 @@ static void handle_bam_mux_cmd(struct work_struct *work)
 			" pad %d ch %d len %d\n", __func__,
 			rx_hdr->magic_num, rx_hdr->reserved, rx_hdr->cmd,
 			rx_hdr->pad_len, rx_hdr->ch_id, rx_hdr->pkt_len);
-		dev_kfree_skb_any(rx_skb);
+		rx_recycle(rx_skb);
 		queue_rx();
 		return;
 	}
@@ -571,7 +657,7 @@ static void handle_bam_mux_cmd(struct work_struct *work)
 			" pad %d ch %d len %d\n", __func__,
 			rx_hdr->ch_id, rx_hdr->reserved, rx_hdr->cmd,
 			rx_hdr->pad_len, rx_hdr->ch_id, rx_hdr->pkt_len);
-		dev_kfree_skb_any(rx_skb);
+		rx_recycle(rx_skb);
 		queue_rx();
 		return;
 	}
@@ -590,7 +676,7 @@ static void handle_bam_mux_cmd(struct work_struct *work)
 								__func__);
 			disconnect_ack = 0;
 		}
-		dev_kfree_skb_any(rx_skb);
+		rx_recycle(rx_skb);
 		break;
 	case BAM_MUX_HDR_CMD_OPEN_NO_A2_PC:
 		bam_dmux_log("%s: opening cid %d PC disabled\n", __func__,
@@ -602,7 +688,7 @@ static void handle_bam_mux_cmd(struct work_struct *work)
 		}
 
 		handle_bam_mux_cmd_open(rx_hdr);
-		dev_kfree_skb_any(rx_skb);
+		rx_recycle(rx_skb);
 		break;
 	case BAM_MUX_HDR_CMD_CLOSE:
 		/* probably should drop pending write */
@@ -624,7 +710,7 @@ static void handle_bam_mux_cmd(struct work_struct *work)
 		if (!bam_ch[rx_hdr->ch_id].pdev)
 			pr_err("%s: platform_device_alloc failed\n", __func__);
 		mutex_unlock(&bam_pdev_mutexlock);
-		dev_kfree_skb_any(rx_skb);
+		rx_recycle(rx_skb);
 		queue_rx();
 		break;
 	default:
@@ -633,7 +719,7 @@ static void handle_bam_mux_cmd(struct work_struct *work)
 			__func__, rx_hdr->magic_num, rx_hdr->reserved,
 			rx_hdr->cmd, rx_hdr->pad_len, rx_hdr->ch_id,
 			rx_hdr->pkt_len);
-		dev_kfree_skb_any(rx_skb);
+		rx_recycle(rx_skb);
 		queue_rx();
 		return;
 	}
@@ -689,13 +775,32 @@ static int bam_mux_write_cmd(void *data, uint32_t len)
 	return rc;
 }
 
+/* Give a data packet that was sent back to the client that wrote it */
+static void bam_mux_write_done_skb(struct sk_buff *skb)
+{
+	struct bam_mux_hdr *hdr;
+	unsigned long event_data;
+	unsigned long flags;
+
+	hdr = (struct bam_mux_hdr *)skb->data;
+	DBG_INC_WRITE_CNT(skb->len);
+	event_data = (unsigned long)(skb);
+	spin_lock_irqsave(&bam_ch[hdr->ch_id].lock, flags);
+	bam_ch[hdr->ch_id].num_tx_pkts--;
+	spin_unlock_irqrestore(&bam_ch[hdr->ch_id].lock, flags);
+	if (bam_ch[hdr->ch_id].notify)
+		bam_ch[hdr->ch_id].notify(
+			bam_ch[hdr->ch_id].priv, BAM_DMUX_WRITE_DONE,
+							event_data);
+	else
+		dev_kfree_skb_any(skb);
+}
+
 static void bam_mux_write_done(struct work_struct *work)
 {
 	struct sk_buff *skb;
-	struct bam_mux_hdr *hdr;
 	struct tx_pkt_info *info;
 	struct tx_pkt_info *info_expected;
-	unsigned long event_data;
 	unsigned long flags;
 
 	if (in_global_reset)
@@ -732,20 +837,168 @@ static void bam_mux_write_done(struct work_struct *work)
 		kfree(info);
 		return;
 	}
+	if (!skb_queue_empty(&info->aggr)) {
+		dev_kfree_skb_any(info->skb);
+		while ((skb = __skb_dequeue(&info->aggr)))
+			bam_mux_write_done_skb(skb);
+		kfree(info);
+		return;
+	}
 	skb = info->skb;
 	kfree(info);
-	hdr = (struct bam_mux_hdr *)skb->data;
-	DBG_INC_WRITE_CNT(skb->len);
-	event_data = (unsigned long)(skb);
-	spin_lock_irqsave(&bam_ch[hdr->ch_id].lock, flags);
-	bam_ch[hdr->ch_id].num_tx_pkts--;
-	spin_unlock_irqrestore(&bam_ch[hdr->ch_id].lock, flags);
-	if (bam_ch[hdr->ch_id].notify)
-		bam_ch[hdr->ch_id].notify(
-			bam_ch[hdr->ch_id].priv, BAM_DMUX_WRITE_DONE,
-							event_data);
-	else
-		dev_kfree_skb_any(skb);
+	bam_mux_write_done_skb(skb);
+}
+
+/* Send the aggregate being filled, called with ul_aggr_lock held */
+static void __ul_aggr_flush(void)
+{
+	struct tx_pkt_info *pkt = ul_aggr_pkt;
+	struct sk_buff *skb;
+	unsigned long flags;
+	int rc;
+
+	if (!pkt)
+		return;
+	ul_aggr_pkt = NULL;
+	hrtimer_try_to_cancel(&ul_aggr_timer);
+
+	pkt->dma_address = dma_map_single(NULL, pkt->skb->data, pkt->skb->len,
+					  DMA_TO_DEVICE);
+	if (!pkt->dma_address) {
+		pr_err("%s: dma_map_single() failed\n", __func__);
+		goto fail;
+	}
+	set_tx_timestamp(pkt);
+	spin_lock_irqsave(&bam_tx_pool_spinlock, flags);
+	list_add_tail(&pkt->list_node, &bam_tx_pool);
+	rc = sps_transfer_one(bam_tx_pipe, pkt->dma_address, pkt->skb->len,
+				pkt, SPS_IOVEC_FLAG_INT | SPS_IOVEC_FLAG_EOT);
+	if (rc) {
+		DMUX_LOG_KERR("%s sps_transfer_one failed rc=%d\n",
+			__func__, rc);
+		list_del(&pkt->list_node);
+		DBG_INC_TX_SPS_FAILURE_CNT();
+		spin_unlock_irqrestore(&bam_tx_pool_spinlock, flags);
+		dma_unmap_single(NULL, pkt->dma_address, pkt->skb->len,
+				 DMA_TO_DEVICE);
+		goto fail;
+	}
+	spin_unlock_irqrestore(&bam_tx_pool_spinlock, flags);
+	return;
+
+fail:
+	/* the clients were told the packets were taken, complete them */
+	dev_kfree_skb_any(pkt->skb);
+	while ((skb = __skb_dequeue(&pkt->aggr)))
+		bam_mux_write_done_skb(skb);
+	kfree(pkt);
+}
+
+static void ul_aggr_flush(void)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&ul_aggr_lock, flags);
+	__ul_aggr_flush();
+	spin_unlock_irqrestore(&ul_aggr_lock, flags);
+}
+
+/* Drop the aggregate being filled on subsystem restart */
+static void ul_aggr_drop(void)
+{
+	struct tx_pkt_info *pkt;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ul_aggr_lock, flags);
+	pkt = ul_aggr_pkt;
+	ul_aggr_pkt = NULL;
+	ul_aggr_supported = 0;
+	spin_unlock_irqrestore(&ul_aggr_lock, flags);
+
+	hrtimer_cancel(&ul_aggr_timer);
+	if (pkt) {
+		dev_kfree_skb_any(pkt->skb);
+		skb_queue_purge(&pkt->aggr);
+		kfree(pkt);
+	}
+}
+
+static enum hrtimer_restart ul_aggr_timer_func(struct hrtimer *timer)
+{
+	queue_work(bam_mux_tx_workqueue, &ul_aggr_flush_work);
+	return HRTIMER_NORESTART;
+}
+
+static void ul_aggr_flush_func(struct work_struct *work)
+{
+	if (in_global_reset)
+		return;
+
+	read_lock(&ul_wakeup_lock);
+	if (!bam_is_connected) {
+		read_unlock(&ul_wakeup_lock);
+		ul_wakeup();
+		if (unlikely(in_global_reset == 1))
+			return;
+		read_lock(&ul_wakeup_lock);
+		notify_all(BAM_DMUX_UL_CONNECTED, (unsigned long)(NULL));
+	}
+	ul_aggr_flush();
+	read_unlock(&ul_wakeup_lock);
+}
+
+/*
+ * Copy a framed packet into the aggregate, starting a new one if needed.
+ * Called with ul_wakeup_lock held for reading.  The packet is completed
+ * once the aggregate has been sent.
+ */
+static int ul_aggr_add(uint32_t id, struct sk_buff *skb)
+{
+	struct tx_pkt_info *pkt;
+	unsigned long flags;
+	int full;
+
+	spin_lock_irqsave(&ul_aggr_lock, flags);
+	pkt = ul_aggr_pkt;
+	if (pkt && pkt->skb->len + skb->len > UL_AGGR_SIZE) {
+		__ul_aggr_flush();
+		pkt = NULL;
+	}
+
+	if (!pkt) {
+		pkt = kmalloc(sizeof(struct tx_pkt_info), GFP_ATOMIC);
+		if (pkt)
+			pkt->skb = alloc_skb(UL_AGGR_SIZE, GFP_ATOMIC);
+		if (!pkt || !pkt->skb) {
+			spin_unlock_irqrestore(&ul_aggr_lock, flags);
+			kfree(pkt);
+			return -ENOMEM;
+		}
+		pkt->is_cmd = 0;
+		skb_queue_head_init(&pkt->aggr);
+		INIT_WORK(&pkt->work, bam_mux_write_done);
+		ul_aggr_pkt = pkt;
+		hrtimer_start(&ul_aggr_timer,
+			      ns_to_ktime((u64)ul_aggr_us * NSEC_PER_USEC),
+			      HRTIMER_MODE_REL);
+	}
+
+	memcpy(skb_put(pkt->skb, skb->len), skb->data, skb->len);
+	__skb_queue_tail(&pkt->aggr, skb);
+
+	spin_lock(&bam_ch[id].lock);
+	bam_ch[id].num_tx_pkts++;
+	/* a client stopped at the watermark would wait for the timer */
+	full = bam_ch[id].use_wm &&
+		bam_ch[id].num_tx_pkts >= HIGH_WATERMARK;
+	spin_unlock(&bam_ch[id].lock);
+
+	if (full || skb_queue_len(&pkt->aggr) >= UL_AGGR_MAX_PKTS ||
+	    pkt->skb->len > UL_AGGR_SIZE - UL_AGGR_SMALL)
+		__ul_aggr_flush();
+	spin_unlock_irqrestore(&ul_aggr_lock, flags);
+
+	return 0;
 }
 
 int msm_bam_dmux_write(uint32_t id, struct sk_buff *skb)
@@ -823,11 +1076,21 @@ int msm_bam_dmux_write(uint32_t id, struct sk_buff *skb)
 	    __func__, skb->data, skb->tail, skb->len,
 	    hdr->pkt_len, hdr->pad_len);
 
+	if (ul_aggregation && ul_aggr_supported && skb->len <= UL_AGGR_SMALL &&
+	    !ul_aggr_add(id, skb)) {
+		ul_packet_written = 1;
+		read_unlock(&ul_wakeup_lock);
+		return 0;
+	}
+	/* keep packets of a channel in order */
+	ul_aggr_flush();
+
 	pkt = kmalloc(sizeof(struct tx_pkt_info), GFP_ATOMIC);
 	if (pkt == NULL) {
 		pr_err("%s: mem alloc for tx_pkt_info failed\n", __func__);
 		goto write_fail2;
 	}
+	skb_queue_head_init(&pkt->aggr);
 
 	dma_address = dma_map_single(NULL, skb->data, skb->len,
 					DMA_TO_DEVICE);
@@ -1077,6 +1340,7 @@ static void rx_switch_to_interrupt_mode(void)
 		goto fail;
 	}
 	polling_mode = 0;
+	rx_to_irq_cnt++;
 	release_wakelock();
 
 	/* handle any rx packets before interrupt was enabled */
@@ -1121,7 +1385,7 @@ static void rx_switch_to_interrupt_mode(void)
 
 fail:
 	pr_err("%s: reverting to polling\n", __func__);
-	queue_work_on(0, bam_mux_rx_workqueue, &rx_timer_work);
+	queue_work(bam_mux_rx_workqueue, &rx_timer_work);
 }
 
 static void rx_timer_work_func(struct work_struct *work)
@@ -1129,12 +1393,15 @@ static void rx_timer_work_func(struct work_struct *work)
 	struct sps_iovec iov;
 	struct rx_pkt_info *info;
 	int inactive_cycles = 0;
-	int ret;
+	int ret, pkts, budget;
 	u32 buffs_unused, buffs_used;
 
 	while (bam_connection_is_active) { /* timer loop */
 		++inactive_cycles;
-		while (bam_connection_is_active) { /* deplete queue loop */
+		pkts = 0;
+		budget = max(rx_poll_budget, 1);
+		/* deplete queue loop */
+		while (bam_connection_is_active && pkts < budget) {
 			if (in_global_reset)
 				return;
 
@@ -1175,9 +1442,27 @@ static void rx_timer_work_func(struct work_struct *work)
 			--bam_rx_pool_len;
 			mutex_unlock(&bam_rx_pool_mutexlock);
 			handle_bam_mux_cmd(&info->work);
+			pkts++;
 		}
 
-		if (inactive_cycles >= POLLING_INACTIVITY) {
+		/*
+		 * The average decays with every empty poll, so a burst that
+		 * averaged many packets per poll keeps polling for longer
+		 * than a trickle does.
+		 */
+		rx_poll_cycles++;
+		rx_poll_rate = (7 * rx_poll_rate + (pkts << 8)) / 8;
+
+		if (pkts >= budget) {
+			/* more is pending, let others run and poll again */
+			rx_budget_cnt++;
+			cond_resched();
+			continue;
+		}
+
+		if (inactive_cycles >= POLLING_INACTIVITY ||
+		    (inactive_cycles &&
+		     rx_poll_rate < (rx_irq_threshold << 8) / 100)) {
 			rx_switch_to_interrupt_mode();
 			break;
 		}
@@ -1215,6 +1500,11 @@ static void rx_timer_work_func(struct work_struct *work)
 				rx_timer_interval = MAX_POLLING_SLEEP;
 			else if (rx_timer_interval < MIN_POLLING_SLEEP)
 				rx_timer_interval = MIN_POLLING_SLEEP;
+
+			/* but never let packets wait past the target */
+			if (rx_latency_us > MIN_POLLING_SLEEP &&
+			    rx_timer_interval > rx_latency_us)
+				rx_timer_interval = rx_latency_us;
 		} else {
 			usleep_range(POLLING_MIN_SLEEP, POLLING_MAX_SLEEP);
 		}
@@ -1279,11 +1569,10 @@ static void bam_mux_rx_notify(struct sps_event_notify *notify)
 			}
 			grab_wakelock();
 			polling_mode = 1;
-			/*
-			 * run on core 0 so that netif_rx() in rmnet uses only
-			 * one queue
-			 */
-			queue_work_on(0, bam_mux_rx_workqueue, &rx_timer_work);
+			/* count the packet that raised the interrupt */
+			rx_poll_rate = 1 << 8;
+			rx_to_poll_cnt++;
+			queue_work(bam_mux_rx_workqueue, &rx_timer_work);
 		}
 		break;
 	default:
@@ -1338,7 +1627,12 @@ static int debug_stats(char *buf, int max)
 			"rx queue len:    %d\n"
 			"a2 ack out cnt:  %d\n"
 			"a2 ack in cnt:   %d\n"
-			"a2 pwr cntl in:  %d\n",
+			"a2 pwr cntl in:  %d\n"
+			"rx polls:        %u\n"
+			"rx pkts/poll:    %u.%02u\n"
+			"rx to polling:   %u\n"
+			"rx to irq:       %u\n"
+			"rx budget hits:  %u\n",
 			bam_dmux_read_cnt,
 			bam_dmux_write_cnt,
 			bam_dmux_write_cpy_cnt,
@@ -1348,7 +1642,12 @@ static int debug_stats(char *buf, int max)
 			bam_rx_pool_len,
 			atomic_read(&bam_dmux_ack_out_cnt),
 			atomic_read(&bam_dmux_ack_in_cnt),
-			atomic_read(&bam_dmux_a2_pwr_cntl_in_cnt)
+			atomic_read(&bam_dmux_a2_pwr_cntl_in_cnt),
+			rx_poll_cycles,
+			rx_poll_rate >> 8, ((rx_poll_rate & 0xff) * 100) >> 8,
+			rx_to_poll_cnt,
+			rx_to_irq_cnt,
+			rx_budget_cnt
 			);
 
 	return i;
@@ -1646,7 +1945,7 @@ static void ul_timeout(struct work_struct *work)
 		return;
 	ret = write_trylock_irqsave(&ul_wakeup_lock, flags);
 	if (!ret) { /* failed to grab lock, reschedule and bail */
-		schedule_delayed_work(&ul_timeout_work,
+		queue_delayed_work(system_power_efficient_wq, &ul_timeout_work,
 				msecs_to_jiffies(UL_TIMEOUT_DELAY));
 		return;
 	}
@@ -1670,7 +1969,8 @@ static void ul_timeout(struct work_struct *work)
 			bam_dmux_log("%s: pkt written %d\n",
 				__func__, ul_packet_written);
 			ul_packet_written = 0;
-			schedule_delayed_work(&ul_timeout_work,
+			queue_delayed_work(system_power_efficient_wq,
+					&ul_timeout_work,
 					msecs_to_jiffies(UL_TIMEOUT_DELAY));
 		} else {
 			ul_powerdown();
@@ -1732,7 +2032,7 @@ static void ul_wakeup(void)
 		}
 		if (likely(do_vote_dfab))
 			vote_dfab();
-		schedule_delayed_work(&ul_timeout_work,
+		queue_delayed_work(system_power_efficient_wq, &ul_timeout_work,
 				msecs_to_jiffies(UL_TIMEOUT_DELAY));
 		bam_is_connected = 1;
 		mutex_unlock(&wakeup_lock);
@@ -1774,7 +2074,7 @@ static void ul_wakeup(void)
 
 	bam_is_connected = 1;
 	bam_dmux_log("%s complete\n", __func__);
-	schedule_delayed_work(&ul_timeout_work,
+	queue_delayed_work(system_power_efficient_wq, &ul_timeout_work,
 				msecs_to_jiffies(UL_TIMEOUT_DELAY));
 	mutex_unlock(&wakeup_lock);
 }
@@ -1853,7 +2153,8 @@ static void disconnect_to_bam(void)
 		info = container_of(node, struct rx_pkt_info, list_node);
 		dma_unmap_single(NULL, info->dma_address, BUFFER_SIZE,
 							DMA_FROM_DEVICE);
-		dev_kfree_skb_any(info->skb);
+		/* kept for the next connect after A2 power collapse */
+		rx_recycle(info->skb);
 		kfree(info);
 	}
 	bam_rx_pool_len = 0;
@@ -1996,6 +2297,7 @@ static int restart_notifier_cb(struct notifier_block *this,
 						info->skb->len,
 						DMA_TO_DEVICE);
 			dev_kfree_skb_any(info->skb);
+			skb_queue_purge(&info->aggr);
 		} else {
 			dma_unmap_single(NULL, info->dma_address,
 						info->len,
@@ -2005,6 +2307,7 @@ static int restart_notifier_cb(struct notifier_block *this,
 		kfree(info);
 	}
 	spin_unlock_irqrestore(&bam_tx_pool_spinlock, flags);
+	ul_aggr_drop();
 
 	bam_dmux_log("%s: complete\n", __func__);
 	return NOTIFY_DONE;
@@ -2334,12 +2637,13 @@ static int bam_dmux_probe(struct platform_device *pdev)
 		pr_err("%s: unable to set dfab clock rate\n", __func__);
 
 	/*
-	 * setup the workqueue so that it can be pinned to core 0 and not
-	 * block the watchdog pet function, so that netif_rx() in rmnet
-	 * only uses one queue.
+	 * Ordered, so packets are handed to the clients in sequence, and
+	 * unbound, so the polling neither blocks the watchdog pet function
+	 * nor keeps one core busy.  rmnet moves the protocol processing to
+	 * NAPI, from where RPS can spread it across cores.
 	 */
-	bam_mux_rx_workqueue = alloc_workqueue("bam_dmux_rx",
-					WQ_MEM_RECLAIM | WQ_CPU_INTENSIVE, 1);
+	bam_mux_rx_workqueue = alloc_ordered_workqueue("bam_dmux_rx",
+						       WQ_MEM_RECLAIM);
 	if (!bam_mux_rx_workqueue)
 		return -ENOMEM;
 
@@ -2430,6 +2734,9 @@ static int __init bam_dmux_init(void)
 	}
 
 	rx_timer_interval = DEFAULT_POLLING_MIN_SLEEP;
+	skb_queue_head_init(&bam_rx_spare);
+	hrtimer_init(&ul_aggr_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	ul_aggr_timer.function = ul_aggr_timer_func;
 
 	subsys_notif_register_notifier("modem", &restart_notifier);
 	return platform_driver_register(&bam_dmux_driver);
@@ -23,6 +23,7 @@
 #include <linux/clkdev.h>
 #include <linux/list.h>
 #include <trace/events/power.h>
+#include <mach/msm_rtb.h>
 
 #include "clock.h"
 
@@ -69,15 +70,20 @@ static int update_vdd(struct clk_vdd_class *vdd_class)
 	return rc;
 }
 
-/* Vote for a voltage level. */
+/*
+ * Vote for a voltage level.  Only a vote above the current level can
+ * change the highest vote, so all others just count.
+ */
 int vote_vdd_level(struct clk_vdd_class *vdd_class, int level)
 {
 	unsigned long flags;
-	int rc;
+	int rc = 0;
 
 	spin_lock_irqsave(&vdd_class->lock, flags);
 	vdd_class->level_votes[level]++;
-	rc = update_vdd(vdd_class);
+	if (level > vdd_class->cur_level ||
+	    vdd_class->cur_level >= ARRAY_SIZE(vdd_class->level_votes))
+		rc = update_vdd(vdd_class);
 	if (rc)
 		vdd_class->level_votes[level]--;
 	spin_unlock_irqrestore(&vdd_class->lock, flags);
@@ -85,7 +91,10 @@ int vote_vdd_level(struct clk_vdd_class *vdd_class, int level)
 	return rc;
 }
 
-/* Remove vote for a voltage level. */
+/*
+ * Remove vote for a voltage level.  The highest vote only changes when
+ * the last vote for the current level goes away.
+ */
 int unvote_vdd_level(struct clk_vdd_class *vdd_class, int level)
 {
 	unsigned long flags;
@@ -97,7 +106,8 @@ int unvote_vdd_level(struct clk_vdd_class *vdd_class, int level)
 			vdd_class->class_name, level))
 		goto out;
 	vdd_class->level_votes[level]--;
-	rc = update_vdd(vdd_class);
+	if (level == vdd_class->cur_level && !vdd_class->level_votes[level])
+		rc = update_vdd(vdd_class);
 	if (rc)
 		vdd_class->level_votes[level]++;
 out:
@@ -173,6 +183,41 @@ err_prepare_depends:
 }
 EXPORT_SYMBOL(clk_prepare);
 
+/*
+ * An enable count only goes from zero to non-zero and back with
+ * clk->lock held, together with enabling the parents, voting for voltage
+ * and switching the clock itself.  Any other change is a plain reference
+ * count update that is done without the lock, so enabling a clock that
+ * is already on, or disabling one that stays on, costs one cmpxchg.
+ */
+static bool clk_get_unless_zero(struct clk *clk)
+{
+	unsigned count = ACCESS_ONCE(clk->count);
+	unsigned old;
+
+	while (count) {
+		old = cmpxchg(&clk->count, count, count + 1);
+		if (old == count)
+			return true;
+		count = old;
+	}
+	return false;
+}
+
+static bool clk_put_unless_last(struct clk *clk)
+{
+	unsigned count = ACCESS_ONCE(clk->count);
+	unsigned old;
+
+	while (count > 1) {
+		old = cmpxchg(&clk->count, count, count - 1);
+		if (old == count)
+			return true;
+		count = old;
+	}
+	return false;
+}
+
 /*
  * Standard clock functions defined in include/linux/clk.h
  */
@@ -186,13 +231,16 @@ int clk_enable(struct clk *clk)
 		return 0;
 	if (IS_ERR(clk))
 		return -EINVAL;
+	if (clk_get_unless_zero(clk))
+		return 0;
 
 	spin_lock_irqsave(&clk->lock, flags);
 	if (WARN(!clk->warned && !clk->prepare_count,
 				"%s: Don't call enable on unprepared clocks\n",
 				clk->dbg_name))
 		clk->warned = true;
-	if (clk->count == 0) {
+	/* nobody else can take the count off zero while we hold the lock */
+	if (!clk_get_unless_zero(clk)) {
 		parent = clk_get_parent(clk);
 
 		ret = clk_enable(parent);
@@ -210,8 +258,10 @@ int clk_enable(struct clk *clk)
 			ret = clk->ops->enable(clk);
 		if (ret)
 			goto err_enable_clock;
+		/* the clock is on before anyone can see it counted */
+		smp_wmb();
+		clk->count = 1;
 	}
-	clk->count++;
 	spin_unlock_irqrestore(&clk->lock, flags);
 
 	return 0;
@@ -231,9 +281,12 @@ EXPORT_SYMBOL(clk_enable);
 void clk_disable(struct clk *clk)
 {
 	unsigned long flags;
+	struct clk *parent;
 
 	if (IS_ERR_OR_NULL(clk))
 		return;
+	if (clk_put_unless_last(clk))
+		return;
 
 	spin_lock_irqsave(&clk->lock, flags);
 	if (WARN(!clk->warned && !clk->prepare_count,
@@ -241,19 +294,21 @@ void clk_disable(struct clk *clk)
 				"after unprepare\n",
 				clk->dbg_name))
 		clk->warned = true;
-	if (WARN(clk->count == 0, "%s is unbalanced", clk->dbg_name))
-		goto out;
-	if (clk->count == 1) {
-		struct clk *parent = clk_get_parent(clk);
+	/* a lockless clk_enable() may still take another reference */
+	do {
+		if (clk_put_unless_last(clk))
+			goto out;
+		if (WARN(clk->count == 0, "%s is unbalanced", clk->dbg_name))
+			goto out;
+	} while (cmpxchg(&clk->count, 1, 0) != 1);
 
-		trace_clock_disable(clk->dbg_name, 0, smp_processor_id());
-		if (clk->ops->disable)
-			clk->ops->disable(clk);
-		unvote_rate_vdd(clk, clk->rate);
-		clk_disable(clk->depends);
-		clk_disable(parent);
-	}
-	clk->count--;
+	parent = clk_get_parent(clk);
+	trace_clock_disable(clk->dbg_name, 0, smp_processor_id());
+	if (clk->ops->disable)
+		clk->ops->disable(clk);
+	unvote_rate_vdd(clk, clk->rate);
+	clk_disable(clk->depends);
+	clk_disable(parent);
 out:
 	spin_unlock_irqrestore(&clk->lock, flags);
 }
@@ -332,6 +387,7 @@ int clk_set_rate(struct clk *clk, unsigned long rate)
 		goto out;
 
 	trace_clock_set_rate(clk->dbg_name, rate, smp_processor_id());
+	uncached_logk_pc(LOGK_CLK | LOGTYPE_NOPC, clk, (void *)rate);
 	if (clk->count) {
 		start_rate = clk->rate;
 		/* Enforce vdd requirements for target frequency. */
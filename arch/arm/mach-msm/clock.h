@@ -109,8 +109,9 @@ struct clk_ops {
  * struct clk
  * @prepare_count: prepare refcount
  * @prepare_lock: protects clk_prepare()/clk_unprepare() path and @prepare_count
- * @count: enable refcount
- * @lock: protects clk_enable()/clk_disable() path and @count
+ * @count: enable refcount, changed with cmpxchg() unless it goes to or from 0
+ * @lock: protects clk_enable()/clk_disable() path and @count going to or
+ *	from 0
  * @depends: non-direct parent of clock to enable when this clock is enabled
  * @vdd_class: voltage scaling requirement class
  * @fmax: maximum frequency in Hz supported at each voltage level
@@ -16,5 +16,6 @@
 extern void set_l2_indirect_reg(u32 reg_addr, u32 val);
 extern u32 get_l2_indirect_reg(u32 reg_addr);
 extern u32 set_get_l2_indirect_reg(u32 reg_addr, u32 val);
+extern u32 krait_l2_pmu_type(void);
 
 #endif
@@ -25,10 +25,17 @@ enum logk_event_type {
 	LOGK_HOTPLUG = 4,
 	LOGK_CTXID = 5,
 	LOGK_TIMESTAMP = 6,
+	LOGK_IRQ = 7,
+	LOGK_SCHED = 8,
+	LOGK_BUS = 9,
+	LOGK_CLK = 10,
 };
 
 #define LOGTYPE_NOPC 0x80
 
+/* set in the data of a LOGK_IRQ entry logged when the handler is done */
+#define LOGK_IRQ_EXIT 0x80000000
+
 struct msm_rtb_platform_data {
 	unsigned int size;
 };
@@ -279,6 +279,35 @@ int smd_write_segment(smd_channel_t *ch, void *data, int len, int user_buf);
  */
 int smd_write_end(smd_channel_t *ch);
 
+/* Coalesces the interrupts that tell the remote processor about writes.
+ * The remote side is only signaled once @watermark bytes are waiting in
+ * the fifo or @delay_us after the first write it was not signaled for.
+ * A @watermark of 0, the default, signals every write.  The settings are
+ * reset when the channel is closed.
+ *
+ * @ch: open channel
+ * @watermark: fifo fill in bytes that signals at once, at most half the
+ *	fifo is used
+ * @delay_us: longest time a write goes unsignaled
+ *
+ * Returns:
+ *      0 - success
+ *      -ENODEV - invalid smd channel
+ *      -EINVAL - @watermark without @delay_us
+ */
+int smd_set_write_coalescing(smd_channel_t *ch, unsigned watermark,
+			     unsigned delay_us);
+
+/* Signals the remote side now about writes held back by coalescing.
+ *
+ * @ch: channel to flush
+ *
+ * Returns:
+ *      0 - success
+ *      -ENODEV - invalid smd channel
+ */
+int smd_write_flush(smd_channel_t *ch);
+
 /*
  * Returns a pointer to the subsystem name or NULL if no
  * subsystem name is available.
@@ -423,6 +452,18 @@ static inline int smd_write_end(smd_channel_t *ch)
 	return -ENODEV;
 }
 
+static inline int smd_set_write_coalescing(smd_channel_t *ch,
+					   unsigned watermark,
+					   unsigned delay_us)
+{
+	return -ENODEV;
+}
+
+static inline int smd_write_flush(smd_channel_t *ch)
+{
+	return -ENODEV;
+}
+
 static inline const char *smd_edge_to_subsystem(uint32_t type)
 {
 	return NULL;
@@ -22,6 +22,7 @@
 #include <linux/delay.h>
 #include <linux/err.h>
 #include <linux/sched.h>
+#include <linux/rwsem.h>
 #include <linux/poll.h>
 #include <linux/wakelock.h>
 #include <linux/platform_device.h>
@@ -94,11 +95,16 @@ static DEFINE_MUTEX(control_ports_lock);
 
 #define LP_HASH_SIZE 32
 static struct list_head local_ports[LP_HASH_SIZE];
-static DEFINE_MUTEX(local_ports_lock);
+static DECLARE_RWSEM(local_ports_lock);
 
+/*
+ * Servers are hashed by service so that a name lookup, which may mask
+ * the instance, only has to walk one bucket.
+ */
 #define SRV_HASH_SIZE 32
+#define SRV_HASH_KEY(service) ((service) & (SRV_HASH_SIZE - 1))
 static struct list_head server_list[SRV_HASH_SIZE];
-static DEFINE_MUTEX(server_list_lock);
+static DECLARE_RWSEM(server_list_lock);
 static wait_queue_head_t newserver_wait;
 
 struct msm_ipc_server {
@@ -152,7 +158,7 @@ struct msm_ipc_routing_table_entry {
 };
 
 static struct list_head routing_table[RT_HASH_SIZE];
-static DEFINE_MUTEX(routing_table_lock);
+static DECLARE_RWSEM(routing_table_lock);
 static int routing_table_inited;
 
 static LIST_HEAD(msm_ipc_board_dev_list);
@@ -360,6 +366,21 @@ void release_pkt(struct rr_packet *pkt)
 	return;
 }
 
+/*
+ * Queue @pkt on the receive queue of @port_ptr and wake up its reader.
+ * The caller keeps the port alive by holding the lock of the list the
+ * port was looked up in.
+ */
+static void post_pkt_to_port(struct msm_ipc_port *port_ptr,
+			     struct rr_packet *pkt)
+{
+	spin_lock(&port_ptr->port_rx_q_lock);
+	wake_lock(&port_ptr->port_rx_wake_lock);
+	list_add_tail(&pkt->list, &port_ptr->port_rx_q);
+	spin_unlock(&port_ptr->port_rx_q_lock);
+	wake_up(&port_ptr->port_rx_wait_q);
+}
+
 static int post_control_ports(struct rr_packet *pkt)
 {
 	struct msm_ipc_port *port_ptr;
@@ -370,12 +391,10 @@ static int post_control_ports(struct rr_packet *pkt)
 
 	mutex_lock(&control_ports_lock);
 	list_for_each_entry(port_ptr, &control_ports, list) {
-		mutex_lock(&port_ptr->port_rx_q_lock);
 		cloned_pkt = clone_pkt(pkt);
-		wake_lock(&port_ptr->port_rx_wake_lock);
-		list_add_tail(&cloned_pkt->list, &port_ptr->port_rx_q);
-		wake_up(&port_ptr->port_rx_wait_q);
-		mutex_unlock(&port_ptr->port_rx_q_lock);
+		if (!cloned_pkt)
+			continue;
+		post_pkt_to_port(port_ptr, cloned_pkt);
 	}
 	mutex_unlock(&control_ports_lock);
 	return 0;
@@ -388,7 +407,7 @@ static uint32_t allocate_port_id(void)
 
 	mutex_lock(&next_port_id_lock);
 	prev_port_id = next_port_id;
-	mutex_lock(&local_ports_lock);
+	down_read(&local_ports_lock);
 	do {
 		next_port_id++;
 		if ((next_port_id & 0xFFFFFFFE) == 0xFFFFFFFE)
@@ -411,7 +430,7 @@ static uint32_t allocate_port_id(void)
 		}
 		port_id = 0;
 	} while (next_port_id != prev_port_id);
-	mutex_unlock(&local_ports_lock);
+	up_read(&local_ports_lock);
 	mutex_unlock(&next_port_id_lock);
 
 	return port_id;
@@ -425,9 +444,9 @@ void msm_ipc_router_add_local_port(struct msm_ipc_port *port_ptr)
 		return;
 
 	key = (port_ptr->this_port.port_id & (LP_HASH_SIZE - 1));
-	mutex_lock(&local_ports_lock);
+	down_write(&local_ports_lock);
 	list_add_tail(&port_ptr->list, &local_ports[key]);
-	mutex_unlock(&local_ports_lock);
+	up_write(&local_ports_lock);
 }
 
 struct msm_ipc_port *msm_ipc_router_create_raw_port(void *endpoint,
@@ -453,7 +472,8 @@ struct msm_ipc_port *msm_ipc_router_create_raw_port(void *endpoint,
 	INIT_LIST_HEAD(&port_ptr->incomplete);
 	mutex_init(&port_ptr->incomplete_lock);
 	INIT_LIST_HEAD(&port_ptr->port_rx_q);
-	mutex_init(&port_ptr->port_rx_q_lock);
+	spin_lock_init(&port_ptr->port_rx_q_lock);
+	mutex_init(&port_ptr->port_notify_lock);
 	init_waitqueue_head(&port_ptr->port_rx_wait_q);
 	snprintf(port_ptr->rx_wakelock_name, MAX_WAKELOCK_NAME_SZ,
 		 "msm_ipc_read%08x:%08x",
@@ -494,10 +514,10 @@ static struct msm_ipc_router_remote_port *msm_ipc_router_lookup_remote_port(
 	struct msm_ipc_routing_table_entry *rt_entry;
 	int key = (port_id & (RP_HASH_SIZE - 1));
 
-	mutex_lock(&routing_table_lock);
+	down_read(&routing_table_lock);
 	rt_entry = lookup_routing_table(node_id);
 	if (!rt_entry) {
-		mutex_unlock(&routing_table_lock);
+		up_read(&routing_table_lock);
 		pr_err("%s: Node is not up\n", __func__);
 		return NULL;
 	}
@@ -509,12 +529,12 @@ static struct msm_ipc_router_remote_port *msm_ipc_router_lookup_remote_port(
 			if (rport_ptr->restart_state != RESTART_NORMAL)
 				rport_ptr = NULL;
 			mutex_unlock(&rt_entry->lock);
-			mutex_unlock(&routing_table_lock);
+			up_read(&routing_table_lock);
 			return rport_ptr;
 		}
 	}
 	mutex_unlock(&rt_entry->lock);
-	mutex_unlock(&routing_table_lock);
+	up_read(&routing_table_lock);
 	return NULL;
 }
 
@@ -526,10 +546,10 @@ static struct msm_ipc_router_remote_port *msm_ipc_router_create_remote_port(
 	struct msm_ipc_routing_table_entry *rt_entry;
 	int key = (port_id & (RP_HASH_SIZE - 1));
 
-	mutex_lock(&routing_table_lock);
+	down_read(&routing_table_lock);
 	rt_entry = lookup_routing_table(node_id);
 	if (!rt_entry) {
-		mutex_unlock(&routing_table_lock);
+		up_read(&routing_table_lock);
 		pr_err("%s: Node is not up\n", __func__);
 		return NULL;
 	}
@@ -539,7 +559,7 @@ static struct msm_ipc_router_remote_port *msm_ipc_router_create_remote_port(
 			    GFP_KERNEL);
 	if (!rport_ptr) {
 		mutex_unlock(&rt_entry->lock);
-		mutex_unlock(&routing_table_lock);
+		up_read(&routing_table_lock);
 		pr_err("%s: Remote port alloc failed\n", __func__);
 		return NULL;
 	}
@@ -552,7 +572,7 @@ static struct msm_ipc_router_remote_port *msm_ipc_router_create_remote_port(
 	list_add_tail(&rport_ptr->list,
 		      &rt_entry->remote_port_list[key]);
 	mutex_unlock(&rt_entry->lock);
-	mutex_unlock(&routing_table_lock);
+	up_read(&routing_table_lock);
 	return rport_ptr;
 }
 
@@ -566,10 +586,10 @@ static void msm_ipc_router_destroy_remote_port(
 		return;
 
 	node_id = rport_ptr->node_id;
-	mutex_lock(&routing_table_lock);
+	down_read(&routing_table_lock);
 	rt_entry = lookup_routing_table(node_id);
 	if (!rt_entry) {
-		mutex_unlock(&routing_table_lock);
+		up_read(&routing_table_lock);
 		pr_err("%s: Node %d is not up\n", __func__, node_id);
 		return;
 	}
@@ -578,7 +598,7 @@ static void msm_ipc_router_destroy_remote_port(
 	list_del(&rport_ptr->list);
 	kfree(rport_ptr);
 	mutex_unlock(&rt_entry->lock);
-	mutex_unlock(&routing_table_lock);
+	up_read(&routing_table_lock);
 	return;
 }
 
@@ -590,27 +610,27 @@ static struct msm_ipc_server *msm_ipc_router_lookup_server(
 {
 	struct msm_ipc_server *server;
 	struct msm_ipc_server_port *server_port;
-	int key = (instance & (SRV_HASH_SIZE - 1));
+	int key = SRV_HASH_KEY(service);
 
-	mutex_lock(&server_list_lock);
+	down_read(&server_list_lock);
 	list_for_each_entry(server, &server_list[key], list) {
 		if ((server->name.service != service) ||
 		    (server->name.instance != instance))
 			continue;
 		if ((node_id == 0) && (port_id == 0)) {
-			mutex_unlock(&server_list_lock);
+			up_read(&server_list_lock);
 			return server;
 		}
 		list_for_each_entry(server_port, &server->server_port_list,
 				    list) {
 			if ((server_port->server_addr.node_id == node_id) &&
 			    (server_port->server_addr.port_id == port_id)) {
-				mutex_unlock(&server_list_lock);
+				up_read(&server_list_lock);
 				return server;
 			}
 		}
 	}
-	mutex_unlock(&server_list_lock);
+	up_read(&server_list_lock);
 	return NULL;
 }
 
@@ -623,9 +643,9 @@ static struct msm_ipc_server *msm_ipc_router_create_server(
 {
 	struct msm_ipc_server *server = NULL;
 	struct msm_ipc_server_port *server_port;
-	int key = (instance & (SRV_HASH_SIZE - 1));
+	int key = SRV_HASH_KEY(service);
 
-	mutex_lock(&server_list_lock);
+	down_write(&server_list_lock);
 	list_for_each_entry(server, &server_list[key], list) {
 		if ((server->name.service == service) &&
 		    (server->name.instance == instance))
@@ -634,7 +654,7 @@ static struct msm_ipc_server *msm_ipc_router_create_server(
 
 	server = kmalloc(sizeof(struct msm_ipc_server), GFP_KERNEL);
 	if (!server) {
-		mutex_unlock(&server_list_lock);
+		up_write(&server_list_lock);
 		pr_err("%s: Server allocation failed\n", __func__);
 		return NULL;
 	}
@@ -650,7 +670,7 @@ create_srv_port:
 			list_del(&server->list);
 			kfree(server);
 		}
-		mutex_unlock(&server_list_lock);
+		up_write(&server_list_lock);
 		pr_err("%s: Server Port allocation failed\n", __func__);
 		return NULL;
 	}
@@ -658,7 +678,7 @@ create_srv_port:
 	server_port->server_addr.port_id = port_id;
 	server_port->xprt_info = xprt_info;
 	list_add_tail(&server_port->list, &server->server_port_list);
-	mutex_unlock(&server_list_lock);
+	up_write(&server_list_lock);
 
 	return server;
 }
@@ -671,7 +691,7 @@ static void msm_ipc_router_destroy_server(struct msm_ipc_server *server,
 	if (!server)
 		return;
 
-	mutex_lock(&server_list_lock);
+	down_write(&server_list_lock);
 	list_for_each_entry(server_port, &server->server_port_list, list) {
 		if ((server_port->server_addr.node_id == node_id) &&
 		    (server_port->server_addr.port_id == port_id))
@@ -685,7 +705,7 @@ static void msm_ipc_router_destroy_server(struct msm_ipc_server *server,
 		list_del(&server->list);
 		kfree(server);
 	}
-	mutex_unlock(&server_list_lock);
+	up_write(&server_list_lock);
 	return;
 }
 
@@ -780,7 +800,7 @@ static int msm_ipc_router_send_server_list(
 
 	ctl.cmd = IPC_ROUTER_CTRL_CMD_NEW_SERVER;
 
-	mutex_lock(&server_list_lock);
+	down_read(&server_list_lock);
 	for (i = 0; i < SRV_HASH_SIZE; i++) {
 		list_for_each_entry(server, &server_list[i], list) {
 			ctl.srv.service = server->name.service;
@@ -800,7 +820,7 @@ static int msm_ipc_router_send_server_list(
 			}
 		}
 	}
-	mutex_unlock(&server_list_lock);
+	up_read(&server_list_lock);
 
 	return 0;
 }
@@ -961,10 +981,10 @@ static int forward_msg(struct msm_ipc_router_xprt_info *xprt_info,
 
 	hdr = (struct rr_header *)head_pkt->data;
 	dst_node_id = hdr->dst_node_id;
-	mutex_lock(&routing_table_lock);
+	down_read(&routing_table_lock);
 	rt_entry = lookup_routing_table(dst_node_id);
 	if (!(rt_entry) || !(rt_entry->xprt_info)) {
-		mutex_unlock(&routing_table_lock);
+		up_read(&routing_table_lock);
 		pr_err("%s: Routing table not initialized\n", __func__);
 		return -ENODEV;
 	}
@@ -975,7 +995,7 @@ static int forward_msg(struct msm_ipc_router_xprt_info *xprt_info,
 	if (xprt_info->remote_node_id == fwd_xprt_info->remote_node_id) {
 		mutex_unlock(&fwd_xprt_info->tx_lock);
 		mutex_unlock(&rt_entry->lock);
-		mutex_unlock(&routing_table_lock);
+		up_read(&routing_table_lock);
 		pr_err("%s: Discarding Command to route back\n", __func__);
 		return -EINVAL;
 	}
@@ -983,14 +1003,14 @@ static int forward_msg(struct msm_ipc_router_xprt_info *xprt_info,
 	if (xprt_info->xprt->link_id == fwd_xprt_info->xprt->link_id) {
 		mutex_unlock(&fwd_xprt_info->tx_lock);
 		mutex_unlock(&rt_entry->lock);
-		mutex_unlock(&routing_table_lock);
+		up_read(&routing_table_lock);
 		pr_err("%s: DST in the same cluster\n", __func__);
 		return 0;
 	}
 	fwd_xprt_info->xprt->write(pkt, pkt->length, fwd_xprt_info->xprt);
 	mutex_unlock(&fwd_xprt_info->tx_lock);
 	mutex_unlock(&rt_entry->lock);
-	mutex_unlock(&routing_table_lock);
+	up_read(&routing_table_lock);
 
 	return 0;
 }
@@ -1026,7 +1046,7 @@ static void msm_ipc_cleanup_remote_server_info(
 	}
 
 	ctl.cmd = IPC_ROUTER_CTRL_CMD_REMOVE_SERVER;
-	mutex_lock(&server_list_lock);
+	down_write(&server_list_lock);
 	for (i = 0; i < SRV_HASH_SIZE; i++) {
 		list_for_each_entry_safe(svr, tmp_svr, &server_list[i], list) {
 			ctl.srv.service = svr->name.service;
@@ -1055,7 +1075,7 @@ static void msm_ipc_cleanup_remote_server_info(
 			}
 		}
 	}
-	mutex_unlock(&server_list_lock);
+	up_write(&server_list_lock);
 }
 
 static void msm_ipc_cleanup_remote_client_info(
@@ -1072,7 +1092,7 @@ static void msm_ipc_cleanup_remote_client_info(
 	}
 
 	ctl.cmd = IPC_ROUTER_CTRL_CMD_REMOVE_CLIENT;
-	mutex_lock(&routing_table_lock);
+	down_write(&routing_table_lock);
 	for (i = 0; i < RT_HASH_SIZE; i++) {
 		list_for_each_entry(rt_entry, &routing_table[i], list) {
 			mutex_lock(&rt_entry->lock);
@@ -1098,7 +1118,7 @@ static void msm_ipc_cleanup_remote_client_info(
 			mutex_unlock(&rt_entry->lock);
 		}
 	}
-	mutex_unlock(&routing_table_lock);
+	up_write(&routing_table_lock);
 }
 
 static void msm_ipc_cleanup_remote_port_info(uint32_t node_id)
@@ -1107,7 +1127,7 @@ static void msm_ipc_cleanup_remote_port_info(uint32_t node_id)
 	struct msm_ipc_router_remote_port *rport_ptr, *tmp_rport_ptr;
 	int i, j;
 
-	mutex_lock(&routing_table_lock);
+	down_write(&routing_table_lock);
 	for (i = 0; i < RT_HASH_SIZE; i++) {
 		list_for_each_entry_safe(rt_entry, tmp_rt_entry,
 					 &routing_table[i], list) {
@@ -1127,7 +1147,7 @@ static void msm_ipc_cleanup_remote_port_info(uint32_t node_id)
 			mutex_unlock(&rt_entry->lock);
 		}
 	}
-	mutex_unlock(&routing_table_lock);
+	up_write(&routing_table_lock);
 }
 
 static void msm_ipc_cleanup_routing_table(
@@ -1141,7 +1161,7 @@ static void msm_ipc_cleanup_routing_table(
 		return;
 	}
 
-	mutex_lock(&routing_table_lock);
+	down_write(&routing_table_lock);
 	for (i = 0; i < RT_HASH_SIZE; i++) {
 		list_for_each_entry(rt_entry, &routing_table[i], list) {
 			mutex_lock(&rt_entry->lock);
@@ -1150,7 +1170,7 @@ static void msm_ipc_cleanup_routing_table(
 			mutex_unlock(&rt_entry->lock);
 		}
 	}
-	mutex_unlock(&routing_table_lock);
+	up_write(&routing_table_lock);
 }
 
 static void modem_reset_cleanup(struct msm_ipc_router_xprt_info *xprt_info)
@@ -1202,12 +1222,12 @@ static int process_control_msg(struct msm_ipc_router_xprt_info *xprt_info,
 		RR("o HELLO NID %d\n", hdr->src_node_id);
 		xprt_info->remote_node_id = hdr->src_node_id;
 
-		mutex_lock(&routing_table_lock);
+		down_write(&routing_table_lock);
 		rt_entry = lookup_routing_table(hdr->src_node_id);
 		if (!rt_entry) {
 			rt_entry = alloc_routing_table_entry(hdr->src_node_id);
 			if (!rt_entry) {
-				mutex_unlock(&routing_table_lock);
+				up_write(&routing_table_lock);
 				pr_err("%s: rt_entry allocation failed\n",
 					__func__);
 				return -ENOMEM;
@@ -1218,7 +1238,7 @@ static int process_control_msg(struct msm_ipc_router_xprt_info *xprt_info,
 		rt_entry->neighbor_node_id = xprt_info->remote_node_id;
 		rt_entry->xprt_info = xprt_info;
 		mutex_unlock(&rt_entry->lock);
-		mutex_unlock(&routing_table_lock);
+		up_write(&routing_table_lock);
 		msm_ipc_cleanup_remote_port_info(xprt_info->remote_node_id);
 
 		memset(&ctl, 0, sizeof(ctl));
@@ -1264,12 +1284,12 @@ static int process_control_msg(struct msm_ipc_router_xprt_info *xprt_info,
 		   msg->srv.node_id, msg->srv.port_id,
 		   msg->srv.service, msg->srv.instance);
 
-		mutex_lock(&routing_table_lock);
+		down_write(&routing_table_lock);
 		rt_entry = lookup_routing_table(msg->srv.node_id);
 		if (!rt_entry) {
 			rt_entry = alloc_routing_table_entry(msg->srv.node_id);
 			if (!rt_entry) {
-				mutex_unlock(&routing_table_lock);
+				up_write(&routing_table_lock);
 				pr_err("%s: rt_entry allocation failed\n",
 					__func__);
 				return -ENOMEM;
@@ -1280,7 +1300,7 @@ static int process_control_msg(struct msm_ipc_router_xprt_info *xprt_info,
 			mutex_unlock(&rt_entry->lock);
 			add_routing_table_entry(rt_entry);
 		}
-		mutex_unlock(&routing_table_lock);
+		up_write(&routing_table_lock);
 
 		server = msm_ipc_router_lookup_server(msg->srv.service,
 						      msg->srv.instance,
@@ -1425,12 +1445,12 @@ static void do_read_data(struct work_struct *work)
 		rport_ptr = msm_ipc_router_lookup_remote_port(hdr->src_node_id,
 						      hdr->src_port_id);
 
-		mutex_lock(&local_ports_lock);
+		down_read(&local_ports_lock);
 		port_ptr = msm_ipc_router_lookup_local_port(hdr->dst_port_id);
 		if (!port_ptr) {
 			pr_err("%s: No local port id %08x\n", __func__,
 				hdr->dst_port_id);
-			mutex_unlock(&local_ports_lock);
+			up_read(&local_ports_lock);
 			release_pkt(pkt);
 			goto process_done;
 		}
@@ -1443,20 +1463,15 @@ static void do_read_data(struct work_struct *work)
 				pr_err("%s: Rmt Prt %08x:%08x create failed\n",
 					__func__, hdr->src_node_id,
 					hdr->src_port_id);
-				mutex_unlock(&local_ports_lock);
+				up_read(&local_ports_lock);
 				goto process_done;
 			}
 		}
 
 		if (!port_ptr->notify) {
-			mutex_lock(&port_ptr->port_rx_q_lock);
-			wake_lock(&port_ptr->port_rx_wake_lock);
-			list_add_tail(&pkt->list, &port_ptr->port_rx_q);
-			wake_up(&port_ptr->port_rx_wait_q);
-			mutex_unlock(&port_ptr->port_rx_q_lock);
-			mutex_unlock(&local_ports_lock);
+			post_pkt_to_port(port_ptr, pkt);
+			up_read(&local_ports_lock);
 		} else {
-			mutex_lock(&port_ptr->port_rx_q_lock);
 			src_addr = kmalloc(sizeof(struct msm_ipc_port_addr),
 					   GFP_KERNEL);
 			if (src_addr) {
@@ -1464,10 +1479,12 @@ static void do_read_data(struct work_struct *work)
 				src_addr->port_id = hdr->src_port_id;
 			}
 			skb_pull(head_skb, IPC_ROUTER_HDR_SIZE);
-			mutex_unlock(&local_ports_lock);
+			/* close_port() waits on this before freeing the port */
+			mutex_lock(&port_ptr->port_notify_lock);
+			up_read(&local_ports_lock);
 			port_ptr->notify(MSM_IPC_ROUTER_READ_CB,
 				pkt->pkt_fragment_q, src_addr, port_ptr->priv);
-			mutex_unlock(&port_ptr->port_rx_q_lock);
+			mutex_unlock(&port_ptr->port_notify_lock);
 			pkt->pkt_fragment_q = NULL;
 			src_addr = NULL;
 			release_pkt(pkt);
@@ -1592,6 +1609,7 @@ static int loopback_data(struct msm_ipc_port *src,
 	struct rr_header *hdr;
 	struct msm_ipc_port *port_ptr;
 	struct rr_packet *pkt;
+	int ret;
 
 	if (!data) {
 		pr_err("%s: Invalid pkt pointer\n", __func__);
@@ -1625,23 +1643,20 @@ static int loopback_data(struct msm_ipc_port *src,
 	hdr->dst_port_id = port_id;
 	pkt->length += IPC_ROUTER_HDR_SIZE;
 
-	mutex_lock(&local_ports_lock);
+	down_read(&local_ports_lock);
 	port_ptr = msm_ipc_router_lookup_local_port(port_id);
 	if (!port_ptr) {
 		pr_err("%s: Local port %d not present\n", __func__, port_id);
-		mutex_unlock(&local_ports_lock);
+		up_read(&local_ports_lock);
 		release_pkt(pkt);
 		return -ENODEV;
 	}
 
-	mutex_lock(&port_ptr->port_rx_q_lock);
-	wake_lock(&port_ptr->port_rx_wake_lock);
-	list_add_tail(&pkt->list, &port_ptr->port_rx_q);
-	wake_up(&port_ptr->port_rx_wait_q);
-	mutex_unlock(&port_ptr->port_rx_q_lock);
-	mutex_unlock(&local_ports_lock);
+	ret = pkt->length;
+	post_pkt_to_port(port_ptr, pkt);
+	up_read(&local_ports_lock);
 
-	return pkt->length;
+	return ret;
 }
 
 static int msm_ipc_router_write_pkt(struct msm_ipc_port *src,
@@ -1707,10 +1722,10 @@ static int msm_ipc_router_write_pkt(struct msm_ipc_port *src,
 		hdr->confirm_rx = 1;
 	mutex_unlock(&rport_ptr->quota_lock);
 
-	mutex_lock(&routing_table_lock);
+	down_read(&routing_table_lock);
 	rt_entry = lookup_routing_table(hdr->dst_node_id);
 	if (!rt_entry || !rt_entry->xprt_info) {
-		mutex_unlock(&routing_table_lock);
+		up_read(&routing_table_lock);
 		pr_err("%s: Remote node %d not up\n",
 			__func__, hdr->dst_node_id);
 		return -ENODEV;
@@ -1721,7 +1736,7 @@ static int msm_ipc_router_write_pkt(struct msm_ipc_port *src,
 	ret = xprt_info->xprt->write(pkt, pkt->length, xprt_info->xprt);
 	mutex_unlock(&xprt_info->tx_lock);
 	mutex_unlock(&rt_entry->lock);
-	mutex_unlock(&routing_table_lock);
+	up_read(&routing_table_lock);
 
 	if (ret < 0) {
 		pr_err("%s: Write on XPRT failed\n", __func__);
@@ -1784,13 +1799,13 @@ int msm_ipc_router_send_to(struct msm_ipc_port *src,
 			pr_err("%s: Destination not reachable\n", __func__);
 			return -ENODEV;
 		}
-		mutex_lock(&server_list_lock);
+		down_read(&server_list_lock);
 		server_port = list_first_entry(&server->server_port_list,
 					       struct msm_ipc_server_port,
 					       list);
 		dst_node_id = server_port->server_addr.node_id;
 		dst_port_id = server_port->server_addr.port_id;
-		mutex_unlock(&server_list_lock);
+		up_read(&server_list_lock);
 	}
 	if (dst_node_id == IPC_ROUTER_NID_LOCAL) {
 		ret = loopback_data(src, dst_port_id, data);
@@ -1827,24 +1842,26 @@ int msm_ipc_router_read(struct msm_ipc_port *port_ptr,
 	if (!port_ptr || !data)
 		return -EINVAL;
 
-	mutex_lock(&port_ptr->port_rx_q_lock);
+	spin_lock(&port_ptr->port_rx_q_lock);
 	if (list_empty(&port_ptr->port_rx_q)) {
-		mutex_unlock(&port_ptr->port_rx_q_lock);
+		spin_unlock(&port_ptr->port_rx_q_lock);
 		return -EAGAIN;
 	}
 
 	pkt = list_first_entry(&port_ptr->port_rx_q, struct rr_packet, list);
 	if ((buf_len) && ((pkt->length - IPC_ROUTER_HDR_SIZE) > buf_len)) {
-		mutex_unlock(&port_ptr->port_rx_q_lock);
+		spin_unlock(&port_ptr->port_rx_q_lock);
 		return -ETOOSMALL;
 	}
 	list_del(&pkt->list);
 	if (list_empty(&port_ptr->port_rx_q))
 		wake_unlock(&port_ptr->port_rx_wake_lock);
+	spin_unlock(&port_ptr->port_rx_q_lock);
+
+	/* hand the fragments over as they are, only the wrapper goes */
 	*data = pkt->pkt_fragment_q;
 	ret = pkt->length;
 	kfree(pkt);
-	mutex_unlock(&port_ptr->port_rx_q_lock);
 
 	return ret;
 }
@@ -1864,9 +1881,7 @@ int msm_ipc_router_recv_from(struct msm_ipc_port *port_ptr,
 	}
 
 	*data = NULL;
-	mutex_lock(&port_ptr->port_rx_q_lock);
 	while (list_empty(&port_ptr->port_rx_q)) {
-		mutex_unlock(&port_ptr->port_rx_q_lock);
 		if (timeout < 0) {
 			ret = wait_event_interruptible(
 					port_ptr->port_rx_wait_q,
@@ -1883,9 +1898,7 @@ int msm_ipc_router_recv_from(struct msm_ipc_port *port_ptr,
 		}
 		if (timeout == 0)
 			return -ETIMEDOUT;
-		mutex_lock(&port_ptr->port_rx_q_lock);
 	}
-	mutex_unlock(&port_ptr->port_rx_q_lock);
 
 	ret = msm_ipc_router_read(port_ptr, data, 0);
 	if (ret <= 0 || !(*data))
@@ -1927,14 +1940,15 @@ int msm_ipc_router_close_port(struct msm_ipc_port *port_ptr)
 	union rr_control_msg msg;
 	struct rr_packet *pkt, *temp_pkt;
 	struct msm_ipc_server *server;
+	LIST_HEAD(rx_q);
 
 	if (!port_ptr)
 		return -EINVAL;
 
 	if (port_ptr->type == SERVER_PORT || port_ptr->type == CLIENT_PORT) {
-		mutex_lock(&local_ports_lock);
+		down_write(&local_ports_lock);
 		list_del(&port_ptr->list);
-		mutex_unlock(&local_ports_lock);
+		up_write(&local_ports_lock);
 
 		if (port_ptr->type == SERVER_PORT) {
 			msg.cmd = IPC_ROUTER_CTRL_CMD_REMOVE_SERVER;
@@ -1960,12 +1974,17 @@ int msm_ipc_router_close_port(struct msm_ipc_port *port_ptr)
 		mutex_unlock(&control_ports_lock);
 	}
 
-	mutex_lock(&port_ptr->port_rx_q_lock);
-	list_for_each_entry_safe(pkt, temp_pkt, &port_ptr->port_rx_q, list) {
+	/* wait for a notify callback still running on another cpu */
+	mutex_lock(&port_ptr->port_notify_lock);
+	mutex_unlock(&port_ptr->port_notify_lock);
+
+	spin_lock(&port_ptr->port_rx_q_lock);
+	list_splice_init(&port_ptr->port_rx_q, &rx_q);
+	spin_unlock(&port_ptr->port_rx_q_lock);
+	list_for_each_entry_safe(pkt, temp_pkt, &rx_q, list) {
 		list_del(&pkt->list);
 		release_pkt(pkt);
 	}
-	mutex_unlock(&port_ptr->port_rx_q_lock);
 
 	if (port_ptr->type == SERVER_PORT) {
 		server = msm_ipc_router_lookup_server(
@@ -1992,13 +2011,13 @@ int msm_ipc_router_get_curr_pkt_size(struct msm_ipc_port *port_ptr)
 	if (!port_ptr)
 		return -EINVAL;
 
-	mutex_lock(&port_ptr->port_rx_q_lock);
+	spin_lock(&port_ptr->port_rx_q_lock);
 	if (!list_empty(&port_ptr->port_rx_q)) {
 		pkt = list_first_entry(&port_ptr->port_rx_q,
 					struct rr_packet, list);
 		rc = pkt->length;
 	}
-	mutex_unlock(&port_ptr->port_rx_q_lock);
+	spin_unlock(&port_ptr->port_rx_q_lock);
 
 	return rc;
 }
@@ -2008,9 +2027,9 @@ int msm_ipc_router_bind_control_port(struct msm_ipc_port *port_ptr)
 	if (!port_ptr)
 		return -EINVAL;
 
-	mutex_lock(&local_ports_lock);
+	down_write(&local_ports_lock);
 	list_del(&port_ptr->list);
-	mutex_unlock(&local_ports_lock);
+	up_write(&local_ports_lock);
 	port_ptr->type = CONTROL_PORT;
 	mutex_lock(&control_ports_lock);
 	list_add_tail(&port_ptr->list, &control_ports);
@@ -2038,33 +2057,32 @@ int msm_ipc_router_lookup_server_name(struct msm_ipc_port_name *srv_name,
 		return -EINVAL;
 	}
 
-	mutex_lock(&server_list_lock);
 	if (!lookup_mask)
 		lookup_mask = 0xFFFFFFFF;
-	for (key = 0; key < SRV_HASH_SIZE; key++) {
-		list_for_each_entry(server, &server_list[key], list) {
-			if ((server->name.service != srv_name->service) ||
-			    ((server->name.instance & lookup_mask) !=
-				srv_name->instance))
-				continue;
+	key = SRV_HASH_KEY(srv_name->service);
+	down_read(&server_list_lock);
+	list_for_each_entry(server, &server_list[key], list) {
+		if ((server->name.service != srv_name->service) ||
+		    ((server->name.instance & lookup_mask) !=
+			srv_name->instance))
+			continue;
 
-			list_for_each_entry(server_port,
-				&server->server_port_list, list) {
-				if (i < num_entries_in_array) {
-					srv_info[i].node_id =
-					  server_port->server_addr.node_id;
-					srv_info[i].port_id =
-					  server_port->server_addr.port_id;
-					srv_info[i].service =
-					  server->name.service;
-					srv_info[i].instance =
-					  server->name.instance;
-				}
-				i++;
+		list_for_each_entry(server_port,
+			&server->server_port_list, list) {
+			if (i < num_entries_in_array) {
+				srv_info[i].node_id =
+				  server_port->server_addr.node_id;
+				srv_info[i].port_id =
+				  server_port->server_addr.port_id;
+				srv_info[i].service =
+				  server->name.service;
+				srv_info[i].instance =
+				  server->name.instance;
 			}
+			i++;
 		}
 	}
-	mutex_unlock(&server_list_lock);
+	up_read(&server_list_lock);
 
 	return i;
 }
@@ -2091,7 +2109,7 @@ static int dump_routing_table(char *buf, int max)
 	struct msm_ipc_routing_table_entry *rt_entry;
 
 	for (j = 0; j < RT_HASH_SIZE; j++) {
-		mutex_lock(&routing_table_lock);
+		down_read(&routing_table_lock);
 		list_for_each_entry(rt_entry, &routing_table[j], list) {
 			mutex_lock(&rt_entry->lock);
 			i += scnprintf(buf + i, max - i,
@@ -2112,7 +2130,7 @@ static int dump_routing_table(char *buf, int max)
 			i += scnprintf(buf + i, max - i, "\n");
 			mutex_unlock(&rt_entry->lock);
 		}
-		mutex_unlock(&routing_table_lock);
+		up_read(&routing_table_lock);
 	}
 
 	return i;
@@ -2146,7 +2164,7 @@ static int dump_servers(char *buf, int max)
 	struct msm_ipc_server *server;
 	struct msm_ipc_server_port *server_port;
 
-	mutex_lock(&server_list_lock);
+	down_read(&server_list_lock);
 	for (j = 0; j < SRV_HASH_SIZE; j++) {
 		list_for_each_entry(server, &server_list[j], list) {
 			list_for_each_entry(server_port,
@@ -2166,7 +2184,7 @@ static int dump_servers(char *buf, int max)
 			}
 		}
 	}
-	mutex_unlock(&server_list_lock);
+	up_read(&server_list_lock);
 
 	return i;
 }
@@ -2178,7 +2196,7 @@ static int dump_remote_ports(char *buf, int max)
 	struct msm_ipc_routing_table_entry *rt_entry;
 
 	for (j = 0; j < RT_HASH_SIZE; j++) {
-		mutex_lock(&routing_table_lock);
+		down_read(&routing_table_lock);
 		list_for_each_entry(rt_entry, &routing_table[j], list) {
 			mutex_lock(&rt_entry->lock);
 			for (k = 0; k < RP_HASH_SIZE; k++) {
@@ -2199,7 +2217,7 @@ static int dump_remote_ports(char *buf, int max)
 			}
 			mutex_unlock(&rt_entry->lock);
 		}
-		mutex_unlock(&routing_table_lock);
+		up_read(&routing_table_lock);
 	}
 
 	return i;
@@ -2229,7 +2247,7 @@ static int dump_local_ports(char *buf, int max)
 	unsigned long flags;
 	struct msm_ipc_port *port_ptr;
 
-	mutex_lock(&local_ports_lock);
+	down_read(&local_ports_lock);
 	for (j = 0; j < LP_HASH_SIZE; j++) {
 		list_for_each_entry(port_ptr, &local_ports[j], list) {
 			spin_lock_irqsave(&port_ptr->port_lock, flags);
@@ -2249,7 +2267,7 @@ static int dump_local_ports(char *buf, int max)
 			i += scnprintf(buf + i, max - i, "\n");
 		}
 	}
-	mutex_unlock(&local_ports_lock);
+	up_read(&local_ports_lock);
 
 	return i;
 }
@@ -2347,14 +2365,14 @@ static int msm_ipc_router_add_xprt(struct msm_ipc_router_xprt *xprt)
 	list_add_tail(&xprt_info->list, &xprt_info_list);
 	mutex_unlock(&xprt_info_list_lock);
 
-	mutex_lock(&routing_table_lock);
+	down_write(&routing_table_lock);
 	if (!routing_table_inited) {
 		init_routing_table();
 		rt_entry = alloc_routing_table_entry(IPC_ROUTER_NID_LOCAL);
 		add_routing_table_entry(rt_entry);
 		routing_table_inited = 1;
 	}
-	mutex_unlock(&routing_table_lock);
+	up_write(&routing_table_lock);
 
 	xprt->priv = xprt_info;
 
@@ -2530,14 +2548,14 @@ static int __init msm_ipc_router_init(void)
 	for (i = 0; i < LP_HASH_SIZE; i++)
 		INIT_LIST_HEAD(&local_ports[i]);
 
-	mutex_lock(&routing_table_lock);
+	down_write(&routing_table_lock);
 	if (!routing_table_inited) {
 		init_routing_table();
 		rt_entry = alloc_routing_table_entry(IPC_ROUTER_NID_LOCAL);
 		add_routing_table_entry(rt_entry);
 		routing_table_inited = 1;
 	}
-	mutex_unlock(&routing_table_lock);
+	up_write(&routing_table_lock);
 
 	init_waitqueue_head(&newserver_wait);
 	init_waitqueue_head(&subsystem_restart_wait);
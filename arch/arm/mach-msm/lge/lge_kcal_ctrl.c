@@ -20,11 +20,91 @@
 #include <linux/platform_device.h>
 #include <linux/init.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
 #include <mach/board_lge.h>
 
+/* one LUT step per frame while a transition runs */
+#define KCAL_STEP_MS	16
+
 static struct kcal_platform_data *kcal_pdata;
 static int last_status_kcal_ctrl;
 
+/*
+ * With kcal_transition_ms set, a refresh fades from the values shown
+ * to the new ones in the background.  Each step only rewrites the LUT
+ * bank not in use, so the display never shows a half written table.
+ */
+static DEFINE_MUTEX(kcal_lock);
+static unsigned int kcal_transition_ms;
+static int kcal_shown[3];
+static int kcal_from[3];
+static int kcal_target[3];
+static unsigned int kcal_step, kcal_steps;
+
+static void kcal_transition_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(kcal_transition_work, kcal_transition_fn);
+
+/* Caller must hold kcal_lock. */
+static int kcal_apply(int r, int g, int b)
+{
+	int ret;
+
+	kcal_pdata->set_values(r, g, b);
+	ret = kcal_pdata->refresh_display();
+	if (!ret) {
+		kcal_shown[0] = r;
+		kcal_shown[1] = g;
+		kcal_shown[2] = b;
+	}
+	return ret;
+}
+
+static void kcal_transition_fn(struct work_struct *work)
+{
+	int v[3];
+	int i;
+
+	mutex_lock(&kcal_lock);
+	if (!kcal_steps)
+		goto out;
+
+	kcal_step++;
+	for (i = 0; i < 3; i++)
+		v[i] = kcal_from[i] + (kcal_target[i] - kcal_from[i]) *
+			(int)kcal_step / (int)kcal_steps;
+	last_status_kcal_ctrl = kcal_apply(v[0], v[1], v[2]);
+
+	if (last_status_kcal_ctrl || kcal_step == kcal_steps)
+		kcal_steps = 0;
+	else
+		schedule_delayed_work(&kcal_transition_work,
+				      msecs_to_jiffies(KCAL_STEP_MS));
+out:
+	mutex_unlock(&kcal_lock);
+}
+
+/* Caller must hold kcal_lock. */
+static int kcal_refresh(void)
+{
+	int *t = kcal_target;
+
+	kcal_pdata->get_values(&t[0], &t[1], &t[2]);
+	if (!kcal_transition_ms) {
+		kcal_steps = 0;
+		return kcal_apply(t[0], t[1], t[2]);
+	}
+
+	/* a transition still running continues from where it got to */
+	memcpy(kcal_from, kcal_shown, sizeof(kcal_from));
+	kcal_step = 0;
+	kcal_steps = max(kcal_transition_ms / KCAL_STEP_MS, 1U);
+	/* set_values() is overwritten by the steps until the last one */
+	kcal_pdata->set_values(kcal_shown[0], kcal_shown[1], kcal_shown[2]);
+	schedule_delayed_work(&kcal_transition_work, 0);
+	return 0;
+}
+
 static ssize_t kcal_store(struct device *dev, struct device_attribute *attr,
 						const char *buf, size_t count)
 {
@@ -36,7 +116,11 @@ static ssize_t kcal_store(struct device *dev, struct device_attribute *attr,
 		return -EINVAL;
 
 	sscanf(buf, "%d %d %d", &kcal_r, &kcal_g, &kcal_b);
+	mutex_lock(&kcal_lock);
 	kcal_pdata->set_values(kcal_r, kcal_g, kcal_b);
+	/* stop a running transition from overwriting them */
+	kcal_steps = 0;
+	mutex_unlock(&kcal_lock);
 	return count;
 }
 
@@ -47,7 +131,15 @@ static ssize_t kcal_show(struct device *dev, struct device_attribute *attr,
 	int kcal_g = 0;
 	int kcal_b = 0;
 
-	kcal_pdata->get_values(&kcal_r, &kcal_g, &kcal_b);
+	mutex_lock(&kcal_lock);
+	if (kcal_steps) {
+		kcal_r = kcal_target[0];
+		kcal_g = kcal_target[1];
+		kcal_b = kcal_target[2];
+	} else {
+		kcal_pdata->get_values(&kcal_r, &kcal_g, &kcal_b);
+	}
+	mutex_unlock(&kcal_lock);
 
 	return sprintf(buf, "%d %d %d\n", kcal_r, kcal_g, kcal_b);
 }
@@ -64,7 +156,9 @@ static ssize_t kcal_ctrl_store(struct device *dev,
 	if(cmd != 1)
 		return last_status_kcal_ctrl = -EINVAL;
 
-	last_status_kcal_ctrl = kcal_pdata->refresh_display();
+	mutex_lock(&kcal_lock);
+	last_status_kcal_ctrl = kcal_refresh();
+	mutex_unlock(&kcal_lock);
 
 	if(last_status_kcal_ctrl)
 		return -EINVAL;
@@ -81,8 +175,28 @@ static ssize_t kcal_ctrl_show(struct device *dev,
 		return sprintf(buf, "OK\n");
 }
 
+static ssize_t kcal_transition_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	unsigned int ms;
+
+	if (sscanf(buf, "%u", &ms) != 1)
+		return -EINVAL;
+
+	kcal_transition_ms = ms;
+	return count;
+}
+
+static ssize_t kcal_transition_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", kcal_transition_ms);
+}
+
 static DEVICE_ATTR(kcal, 0644, kcal_show, kcal_store);
 static DEVICE_ATTR(kcal_ctrl, 0644, kcal_ctrl_show, kcal_ctrl_store);
+static DEVICE_ATTR(kcal_transition_ms, 0644, kcal_transition_show,
+		   kcal_transition_store);
 
 static int kcal_ctrl_probe(struct platform_device *pdev)
 {
@@ -101,6 +215,12 @@ static int kcal_ctrl_probe(struct platform_device *pdev)
 	rc = device_create_file(&pdev->dev, &dev_attr_kcal_ctrl);
 	if(rc !=0)
 		return -1;
+	rc = device_create_file(&pdev->dev, &dev_attr_kcal_transition_ms);
+	if(rc !=0)
+		return -1;
+
+	kcal_pdata->get_values(&kcal_shown[0], &kcal_shown[1],
+			       &kcal_shown[2]);
 
 	return 0;
 }
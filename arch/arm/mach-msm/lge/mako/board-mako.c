@@ -27,6 +27,7 @@
 #include <linux/msm_ssbi.h>
 #include <linux/spi/spi.h>
 #include <linux/dma-mapping.h>
+#include <linux/dma-contiguous.h>
 #include <linux/platform_data/qcom_crypto_device.h>
 #include <linux/ion.h>
 #include <linux/memory.h>
@@ -305,12 +306,20 @@ static int apq8064_paddr_to_memtype(unsigned int paddr)
 
 #ifdef CONFIG_ION_MSM
 #ifdef CONFIG_MSM_MULTIMEDIA_USE_ION
+#ifdef CONFIG_CMA
+/* owner of the CMA area behind the MM heap */
+static struct device apq8064_ion_mm_cma_dev;
+#endif
+
 static struct ion_cp_heap_pdata cp_mm_apq8064_ion_pdata = {
 	.permission_type = IPT_TYPE_MM_CARVEOUT,
 	.align = PAGE_SIZE,
 	.reusable = FMEM_ENABLED,
 	.mem_is_fmem = FMEM_ENABLED,
 	.fixed_position = FIXED_MIDDLE,
+#ifdef CONFIG_CMA
+	.cma_dev = &apq8064_ion_mm_cma_dev,
+#endif
 };
 
 static struct ion_cp_heap_pdata cp_mfc_apq8064_ion_pdata = {
@@ -433,9 +442,17 @@ static void __init reserve_mem_for_ion(enum ion_memory_types mem_type,
 	apq8064_reserve_table[mem_type].size += size;
 }
 
+#if defined(CONFIG_ION_MSM) && defined(CONFIG_MSM_MULTIMEDIA_USE_ION)
+/* CP heap of the fixed area that is declared as a CMA area instead */
+static struct ion_cp_heap_pdata *apq8064_ion_cma_pdata __initdata;
+static unsigned long apq8064_ion_cma_base __initdata;
+static unsigned long apq8064_ion_cma_size __initdata;
+#endif
+
 static void __init apq8064_reserve_fixed_area(unsigned long fixed_area_size)
 {
 #if defined(CONFIG_ION_MSM) && defined(CONFIG_MSM_MULTIMEDIA_USE_ION)
+	unsigned long start, cma_end, end;
 	int ret;
 
 	if (fixed_area_size > MAX_FIXED_AREA_SIZE)
@@ -445,12 +462,61 @@ static void __init apq8064_reserve_fixed_area(unsigned long fixed_area_size)
 	reserve_info->fixed_area_size = fixed_area_size;
 	reserve_info->fixed_area_start = APQ8064_FW_START;
 
-	ret = memblock_remove(reserve_info->fixed_area_start,
-		reserve_info->fixed_area_size);
+	start = reserve_info->fixed_area_start;
+	end = start + fixed_area_size;
+	if (!apq8064_ion_cma_size) {
+		ret = memblock_remove(start, fixed_area_size);
+		BUG_ON(ret);
+		return;
+	}
+
+	/*
+	 * Everything around the CMA heap is carved out as before, the heap
+	 * itself stays available to movable allocations until it is used.
+	 */
+	cma_end = apq8064_ion_cma_base + apq8064_ion_cma_size;
+	ret = memblock_remove(start, apq8064_ion_cma_base - start);
+	if (!ret && end > cma_end)
+		ret = memblock_remove(cma_end, end - cma_end);
 	BUG_ON(ret);
+
+	if (dma_declare_contiguous(apq8064_ion_cma_pdata->cma_dev,
+				   apq8064_ion_cma_size,
+				   apq8064_ion_cma_base, 0)) {
+		pr_err("%s: falling back to a carveout for the CMA heap\n",
+			__func__);
+		apq8064_ion_cma_pdata->cma_dev = NULL;
+		ret = memblock_remove(apq8064_ion_cma_base,
+				      apq8064_ion_cma_size);
+		BUG_ON(ret);
+	}
 #endif
 }
 
+#if defined(CONFIG_ION_MSM) && defined(CONFIG_MSM_MULTIMEDIA_USE_ION)
+/*
+ * Only one heap can be a CMA area, and only if it is in the fixed area and
+ * its placement there already meets the CMA alignment.
+ */
+static void __init apq8064_ion_cma_setup(struct ion_platform_heap *heap,
+					 struct ion_cp_heap_pdata *pdata)
+{
+	unsigned long align = PAGE_SIZE << max(MAX_ORDER, pageblock_order);
+
+	if (apq8064_ion_cma_size || pdata->reusable ||
+	    pdata->fixed_position == NOT_FIXED ||
+	    !IS_ALIGNED(heap->base, align) || !IS_ALIGNED(heap->size, align)) {
+		pr_info("%s: heap %s stays a carveout\n", __func__, heap->name);
+		pdata->cma_dev = NULL;
+		return;
+	}
+
+	apq8064_ion_cma_pdata = pdata;
+	apq8064_ion_cma_base = heap->base;
+	apq8064_ion_cma_size = heap->size;
+}
+#endif
+
 /**
  * Reserve memory for ION and calculate amount of reusable memory for fmem.
  * We only reserve memory for heaps that are not reusable. However, we only
@@ -557,7 +623,6 @@ static void __init reserve_ion_memory(void)
 	 */
 	fixed_size = (fixed_size + HOLE_SIZE + SECTION_SIZE - 1)
 		& SECTION_MASK;
-	apq8064_reserve_fixed_area(fixed_size);
 
 	fixed_low_start = APQ8064_FIXED_AREA_START;
 	fixed_middle_start = fixed_low_start + fixed_low_size + HOLE_SIZE;
@@ -600,8 +665,13 @@ static void __init reserve_ion_memory(void)
 			default:
 				break;
 			}
+
+			if (pdata && pdata->cma_dev)
+				apq8064_ion_cma_setup(heap, pdata);
 		}
 	}
+
+	apq8064_reserve_fixed_area(fixed_size);
 #endif
 }
 
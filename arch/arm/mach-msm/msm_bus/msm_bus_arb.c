@@ -19,7 +19,9 @@
 #include <linux/mutex.h>
 #include <linux/radix-tree.h>
 #include <linux/clk.h>
+#include <linux/workqueue.h>
 #include <mach/msm_bus.h>
+#include <mach/msm_rtb.h>
 #include "msm_bus_core.h"
 
 #define INDEX_MASK 0x0000FFFF
@@ -43,6 +45,18 @@
 
 static DEFINE_MUTEX(msm_bus_lock);
 
+/*
+ * Requests that only lower bandwidth are committed to the fabrics after
+ * up to commit_delay_ms, together with whatever else was lowered in the
+ * meantime.  Any other request commits at once, the pending ones with it.
+ */
+static unsigned int commit_delay_ms = 10;
+module_param(commit_delay_ms, uint, 0644);
+
+static bool msm_bus_commit_pending;
+static void msm_bus_commit_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(msm_bus_commit_work, msm_bus_commit_work_fn);
+
 /**
  * add_path_node: Adds the path information to the current node
  * @info: Internal node info structure
@@ -415,6 +429,21 @@ static int msm_bus_commit_fn(struct device *dev, void *data)
 	return ret;
 }
 
+/* Called with msm_bus_lock held */
+static void msm_bus_commit_all(void)
+{
+	msm_bus_commit_pending = false;
+	bus_for_each_dev(&msm_bus_type, NULL, NULL, msm_bus_commit_fn);
+}
+
+static void msm_bus_commit_work_fn(struct work_struct *work)
+{
+	mutex_lock(&msm_bus_lock);
+	if (msm_bus_commit_pending)
+		msm_bus_commit_all();
+	mutex_unlock(&msm_bus_lock);
+}
+
 /**
  * msm_bus_scale_register_client() - Register the clients with the msm bus
  * driver
@@ -533,6 +562,7 @@ int msm_bus_scale_client_update_request(uint32_t cl, unsigned index)
 	struct msm_bus_scale_pdata *pdata;
 	int pnode, src, curr, ctx;
 	unsigned long req_clk, req_bw, curr_clk, curr_bw;
+	bool lower = true;
 	struct msm_bus_client *client = (struct msm_bus_client *)cl;
 	if (IS_ERR(client)) {
 		MSM_BUS_ERR("msm_bus_scale_client update req error %d\n",
@@ -553,6 +583,7 @@ int msm_bus_scale_client_update_request(uint32_t cl, unsigned index)
 		ret = -ENXIO;
 		goto err;
 	}
+	uncached_logk_pc(LOGK_BUS, __builtin_return_address(0), (void *)index);
 
 	MSM_BUS_DBG("cl: %u index: %d curr: %d"
 			" num_paths: %d\n", cl, index, client->curr,
@@ -586,6 +617,8 @@ int msm_bus_scale_client_update_request(uint32_t cl, unsigned index)
 			curr_bw = client->pdata->usecase[curr].vectors[i].ab;
 			MSM_BUS_DBG("ab: %lu ib: %lu\n", curr_bw, curr_clk);
 		}
+		if (req_clk > curr_clk || req_bw > curr_bw)
+			lower = false;
 
 		if (!pdata->active_only) {
 			ret = update_path(src, pnode, req_clk, req_bw,
@@ -607,7 +640,15 @@ int msm_bus_scale_client_update_request(uint32_t cl, unsigned index)
 	client->curr = index;
 	ctx = ACTIVE_CTX;
 	msm_bus_dbg_client_data(client->pdata, index, cl);
-	bus_for_each_dev(&msm_bus_type, NULL, NULL, msm_bus_commit_fn);
+	if (lower && commit_delay_ms) {
+		/* an already queued commit keeps its earlier deadline */
+		msm_bus_commit_pending = true;
+		queue_delayed_work(system_power_efficient_wq,
+			&msm_bus_commit_work, msecs_to_jiffies(commit_delay_ms));
+	} else {
+		cancel_delayed_work(&msm_bus_commit_work);
+		msm_bus_commit_all();
+	}
 
 err:
 	mutex_unlock(&msm_bus_lock);
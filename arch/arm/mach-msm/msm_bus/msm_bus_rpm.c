@@ -17,6 +17,7 @@
 #include <linux/init.h>
 #include <linux/device.h>
 #include <linux/module.h>
+#include <linux/slab.h>
 #include <mach/msm_bus.h>
 #include <mach/msm_bus_board.h>
 #include <mach/board.h>
@@ -77,6 +78,70 @@ inter:
 	return true;
 }
 
+/*
+ * hw_data of an RPM fabric: the id-value pairs are built in pairs[] and
+ * a copy of what was last sent for each context is kept in last[], so
+ * that a commit which leaves the fabric unchanged is not sent again.
+ */
+struct msm_bus_rpm_data {
+	bool sent[NUM_CTX];
+	bool valid[NUM_CTX];
+	struct msm_rpm_iv_pair *last[NUM_CTX];
+	struct msm_rpm_iv_pair pairs[];
+};
+
+static void *msm_bus_rpm_alloc_data(uint16_t count)
+{
+	struct msm_bus_rpm_data *rd;
+	int ctx;
+
+	rd = kzalloc(sizeof(struct msm_bus_rpm_data) + (NUM_CTX + 1) *
+		count * sizeof(struct msm_rpm_iv_pair), GFP_KERNEL);
+	if (!rd)
+		return NULL;
+
+	for (ctx = 0; ctx < NUM_CTX; ctx++)
+		rd->last[ctx] = rd->pairs + (ctx + 1) * count;
+	return (void *)rd;
+}
+
+/**
+ * msm_bus_rpm_send() - Set or clear the pairs of a context in the RPM
+ * @rd: hw_data of the fabric, with the pairs to send
+ * @ctx: DUAL_CTX for the sleep set, ACTIVE_CTX for the active set
+ * @count: Number of pairs
+ * @valid: Set the pairs if true, clear them otherwise
+ */
+static int msm_bus_rpm_send(struct msm_bus_rpm_data *rd, int ctx,
+	int count, bool valid)
+{
+	int status;
+	int rpm_ctx = (ctx == ACTIVE_CTX) ? MSM_RPM_CTX_SET_0 :
+		MSM_RPM_CTX_SET_SLEEP;
+	size_t n = count * sizeof(struct msm_rpm_iv_pair);
+
+	if (rd->sent[ctx] && rd->valid[ctx] == valid &&
+		(!valid || !memcmp(rd->last[ctx], rd->pairs, n))) {
+		MSM_BUS_DBG("RPM data unchanged for ctx %d, not sent\n", ctx);
+		return 0;
+	}
+
+	if (valid) {
+		status = msm_rpm_set(rpm_ctx, rd->pairs, count);
+		MSM_BUS_DBG("msm_rpm_set returned: %d\n", status);
+	} else {
+		status = msm_rpm_clear(rpm_ctx, rd->pairs, count);
+		MSM_BUS_DBG("msm_rpm_clear returned: %d\n", status);
+	}
+
+	/* On failure the RPM state is unknown, send in full next time */
+	rd->sent[ctx] = !status;
+	rd->valid[ctx] = valid;
+	if (!status)
+		memcpy(rd->last[ctx], rd->pairs, n);
+	return status;
+}
+
 #ifndef CONFIG_MSM_BUS_RPM_MULTI_TIER_ENABLED
 struct commit_data {
 	uint16_t *bwsum;
@@ -222,13 +287,10 @@ static void free_commit_data(void *cdata)
 static void *msm_bus_rpm_allocate_rpm_data(struct platform_device *pdev,
 	struct msm_bus_fabric_registration *fab_pdata)
 {
-	struct msm_rpm_iv_pair *rpm_data;
 	uint16_t count = ((fab_pdata->nmasters * fab_pdata->ntieredslaves) +
 		fab_pdata->nslaves + 1)/2;
 
-	rpm_data = kmalloc((sizeof(struct msm_rpm_iv_pair) * count),
-		GFP_KERNEL);
-	return (void *)rpm_data;
+	return msm_bus_rpm_alloc_data(count);
 }
 
 #define BWMASK 0x7FFF
@@ -348,9 +410,10 @@ static int msm_bus_rpm_compare_cdata(
 }
 
 static int msm_bus_rpm_commit_arb(struct msm_bus_fabric_registration
-	*fab_pdata, int ctx, struct msm_rpm_iv_pair *rpm_data,
+	*fab_pdata, int ctx, struct msm_bus_rpm_data *rd,
 	struct commit_data *cd, bool valid)
 {
+	struct msm_rpm_iv_pair *rpm_data = rd->pairs;
 	int i, j, offset = 0, status = 0, count, index = 0;
 	/*
 	 * count is the number of 2-byte words required to commit the
@@ -414,33 +477,8 @@ static int msm_bus_rpm_commit_arb(struct msm_bus_fabric_registration
 	msm_bus_dbg_commit_data(fab_pdata->name, cd, fab_pdata->
 		nmasters, fab_pdata->nslaves, fab_pdata->ntieredslaves,
 		MSM_BUS_DBG_OP);
-	if (fab_pdata->rpm_enabled) {
-		if (valid) {
-			if (ctx == ACTIVE_CTX) {
-				status = msm_rpm_set(MSM_RPM_CTX_SET_0,
-					rpm_data, count);
-				MSM_BUS_DBG("msm_rpm_set returned: %d\n",
-					status);
-			} else if (ctx == DUAL_CTX) {
-				status = msm_rpm_set(MSM_RPM_CTX_SET_SLEEP,
-					rpm_data, count);
-				MSM_BUS_DBG("msm_rpm_set returned: %d\n",
-					status);
-			}
-		} else {
-			if (ctx == ACTIVE_CTX) {
-				status = msm_rpm_clear(MSM_RPM_CTX_SET_0,
-					rpm_data, count);
-				MSM_BUS_DBG("msm_rpm_clear returned: %d\n",
-					status);
-			} else if (ctx == DUAL_CTX) {
-				status = msm_rpm_clear(MSM_RPM_CTX_SET_SLEEP,
-					rpm_data, count);
-				MSM_BUS_DBG("msm_rpm_clear returned: %d\n",
-					status);
-			}
-		}
-	}
+	if (fab_pdata->rpm_enabled)
+		status = msm_bus_rpm_send(rd, ctx, count, valid);
 
 	return status;
 }
@@ -601,13 +639,10 @@ static void free_commit_data(void *cdata)
 static void *msm_bus_rpm_allocate_rpm_data(struct platform_device *pdev,
 	struct msm_bus_fabric_registration *fab_pdata)
 {
-	struct msm_rpm_iv_pair *rpm_data;
 	uint16_t count = (((fab_pdata->nmasters * fab_pdata->ntieredslaves *
 		NUM_TIERS)/2) + fab_pdata->nslaves + 1)/2;
 
-	rpm_data = kmalloc((sizeof(struct msm_rpm_iv_pair) * count),
-		GFP_KERNEL);
-	return (void *)rpm_data;
+	return msm_bus_rpm_alloc_data(count);
 }
 
 static int msm_bus_rpm_compare_cdata(
@@ -637,9 +672,10 @@ static int msm_bus_rpm_compare_cdata(
 }
 
 static int msm_bus_rpm_commit_arb(struct msm_bus_fabric_registration
-	*fab_pdata, int ctx, struct msm_rpm_iv_pair *rpm_data,
+	*fab_pdata, int ctx, struct msm_bus_rpm_data *rd,
 	struct commit_data *cd, bool valid)
 {
+	struct msm_rpm_iv_pair *rpm_data = rd->pairs;
 	int i, j, k, offset = 0, status = 0, count, index = 0;
 	/*
 	 * count is the number of 2-byte words required to commit the
@@ -711,33 +747,8 @@ static int msm_bus_rpm_commit_arb(struct msm_bus_fabric_registration
 	msm_bus_dbg_commit_data(fab_pdata->name, (void *)cd, fab_pdata->
 		nmasters, fab_pdata->nslaves, fab_pdata->ntieredslaves,
 		MSM_BUS_DBG_OP);
-	if (fab_pdata->rpm_enabled) {
-		if (valid) {
-			if (ctx == ACTIVE_CTX) {
-				status = msm_rpm_set(MSM_RPM_CTX_SET_0,
-					rpm_data, count);
-				MSM_BUS_DBG("msm_rpm_set returned: %d\n",
-					status);
-			} else if (ctx == DUAL_CTX) {
-				status = msm_rpm_set(MSM_RPM_CTX_SET_SLEEP,
-					rpm_data, count);
-				MSM_BUS_DBG("msm_rpm_set returned: %d\n",
-					status);
-			}
-		} else {
-			if (ctx == ACTIVE_CTX) {
-				status = msm_rpm_clear(MSM_RPM_CTX_SET_0,
-					rpm_data, count);
-				MSM_BUS_DBG("msm_rpm_clear returned: %d\n",
-					status);
-			} else if (ctx == DUAL_CTX) {
-				status = msm_rpm_clear(MSM_RPM_CTX_SET_SLEEP,
-					rpm_data, count);
-				MSM_BUS_DBG("msm_rpm_clear returned: %d\n",
-					status);
-			}
-		}
-	}
+	if (fab_pdata->rpm_enabled)
+		status = msm_bus_rpm_send(rd, ctx, count, valid);
 
 	return status;
 }
@@ -866,7 +877,7 @@ static int msm_bus_rpm_commit(struct msm_bus_fabric_registration
 	int ret;
 	bool valid;
 	struct commit_data *dual_cd, *act_cd;
-	struct msm_rpm_iv_pair *rpm_data = (struct msm_rpm_iv_pair *)hw_data;
+	struct msm_bus_rpm_data *rd = (struct msm_bus_rpm_data *)hw_data;
 	dual_cd = (struct commit_data *)cdata[DUAL_CTX];
 	act_cd = (struct commit_data *)cdata[ACTIVE_CTX];
 
@@ -883,14 +894,14 @@ static int msm_bus_rpm_commit(struct msm_bus_fabric_registration
 	else
 		valid = true;
 
-	ret = msm_bus_rpm_commit_arb(fab_pdata, DUAL_CTX, rpm_data,
-		dual_cd, valid);
+	ret = msm_bus_rpm_commit_arb(fab_pdata, DUAL_CTX, rd, dual_cd,
+		valid);
 	if (ret)
 		MSM_BUS_ERR("Error comiting fabric:%d in %d ctx\n",
 			fab_pdata->id, DUAL_CTX);
 
 	valid = true;
-	ret = msm_bus_rpm_commit_arb(fab_pdata, ACTIVE_CTX, rpm_data, act_cd,
+	ret = msm_bus_rpm_commit_arb(fab_pdata, ACTIVE_CTX, rd, act_cd,
 		valid);
 	if (ret)
 		MSM_BUS_ERR("Error comiting fabric:%d in %d ctx\n",
@@ -43,6 +43,7 @@ struct core_attribs {
 	struct kobj_attribute freq_change_enabled;
 	struct kobj_attribute actual_freq;
 	struct kobj_attribute freq_change_us;
+	struct kobj_attribute active_energy;
 
 	struct kobj_attribute max_time_us;
 
@@ -84,12 +85,30 @@ struct dcvs_core {
 	int32_t timer_disabled;
 	/* track if kthread for change_freq is active */
 	int32_t change_freq_activated;
+
+	/* power budget, protected by budget_lock */
+	struct msm_dcvs_freq_entry *freq_tbl;
+	uint32_t num_freq;
+	uint32_t active_energy;	/* of actual_freq */
+	uint32_t clamped_freq;	/* asked for but cut down by the budget */
 };
 
 static int msm_dcvs_debug;
 static int msm_dcvs_enabled = 1;
 module_param_named(enable, msm_dcvs_enabled, int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/*
+ * Upper limit on the sum of the active energy, as given in the frequency
+ * tables, of the frequencies all cores run at.  A core that would go over
+ * it gets the highest frequency that still fits, and another try as soon
+ * as some other core gives budget back.  0 means no limit.
+ */
+static unsigned int power_budget;
+module_param(power_budget, uint, S_IRUGO | S_IWUSR);
+
+static DEFINE_SPINLOCK(budget_lock);
+static uint32_t budget_used;
+
 static struct dentry *debugfs_base;
 
 static struct dcvs_core core_list[CORES_MAX];
@@ -98,6 +117,94 @@ static DEFINE_MUTEX(core_list_lock);
 static struct kobject *cores_kobj;
 static struct dcvs_core *core_handles[CORES_MAX];
 
+static struct msm_dcvs_freq_entry *msm_dcvs_freq_entry(
+		struct dcvs_core *core, uint32_t freq)
+{
+	int i;
+
+	/* the tables are sorted lowest frequency first */
+	for (i = 0; i < core->num_freq; i++)
+		if (core->freq_tbl[i].freq >= freq)
+			return &core->freq_tbl[i];
+	return core->num_freq ? &core->freq_tbl[core->num_freq - 1] : NULL;
+}
+
+/* Highest frequency up to @freq that @core can run at within the budget */
+static uint32_t msm_dcvs_budget_clamp(struct dcvs_core *core, uint32_t freq)
+{
+	uint32_t budget = power_budget;
+	uint32_t others, clamped = freq;
+	int i;
+
+	if (!budget || !core->num_freq)
+		return freq;
+
+	spin_lock(&budget_lock);
+	others = budget_used - core->active_energy;
+	if (msm_dcvs_freq_entry(core, freq)->active_energy + others > budget) {
+		clamped = core->freq_tbl[0].freq;
+		for (i = 1; i < core->num_freq; i++) {
+			if (core->freq_tbl[i].freq > freq ||
+			    core->freq_tbl[i].active_energy + others > budget)
+				break;
+			clamped = core->freq_tbl[i].freq;
+		}
+	}
+	core->clamped_freq = clamped < freq ? freq : 0;
+	spin_unlock(&budget_lock);
+
+	if (clamped < freq && (msm_dcvs_debug & MSM_DCVS_DEBUG_FREQ_CHANGE))
+		__info("Core %s limited to %u instead of %u by power budget\n",
+			core->core_name, clamped, freq);
+	return clamped;
+}
+
+/*
+ * Account the energy of @core at @freq, 0 when it stops, and let the
+ * cores that the budget held back try again with what it gave back.
+ */
+static void msm_dcvs_budget_update(struct dcvs_core *core, uint32_t freq)
+{
+	struct msm_dcvs_freq_entry *entry;
+	struct dcvs_core *waiter;
+	unsigned long flags;
+	uint32_t energy;
+	int released;
+	int i;
+
+	entry = freq ? msm_dcvs_freq_entry(core, freq) : NULL;
+	energy = entry ? entry->active_energy : 0;
+
+	spin_lock(&budget_lock);
+	budget_used += energy - core->active_energy;
+	released = energy < core->active_energy;
+	core->active_energy = energy;
+	if (!freq)
+		core->clamped_freq = 0;
+	spin_unlock(&budget_lock);
+
+	if (!released || !power_budget)
+		return;
+
+	for (i = 0; i < CORES_MAX; i++) {
+		waiter = &core_list[i];
+		if (waiter == core || !waiter->clamped_freq || !waiter->task)
+			continue;
+
+		spin_lock_irqsave(&waiter->cpu_lock, flags);
+		if (waiter->clamped_freq && !waiter->freq_pending) {
+			waiter->new_freq[waiter->freq_pending++] =
+				waiter->clamped_freq;
+			waiter->time_start = ktime_to_ns(ktime_get());
+			if (!waiter->change_freq_activated) {
+				waiter->change_freq_activated = 1;
+				wake_up_process(waiter->task);
+			}
+		}
+		spin_unlock_irqrestore(&waiter->cpu_lock, flags);
+	}
+}
+
 /* Change core frequency, called with core mutex locked */
 static int __msm_dcvs_change_freq(struct dcvs_core *core)
 {
@@ -117,6 +224,8 @@ static int __msm_dcvs_change_freq(struct dcvs_core *core)
 repeat:
 	spin_lock_irqsave(&core->cpu_lock, flags);
 	if (unlikely(!core->freq_pending)) {
+		/* from here on a new request has to wake us up again */
+		core->change_freq_activated = 0;
 		spin_unlock_irqrestore(&core->cpu_lock, flags);
 		return ret;
 	}
@@ -135,14 +244,17 @@ repeat:
 	/**
 	 * Cancel the timers, we dont want the timer firing as we are
 	 * changing the clock rate. Dont let idle_exit and others setup
-	 * timers as well.
+	 * timers as well.  The timer takes cpu_lock, so it cannot be
+	 * waited for here; one that is already running sees
+	 * timer_disabled and does nothing.
 	 */
-	hrtimer_cancel(&core->timer);
+	hrtimer_try_to_cancel(&core->timer);
 	core->timer_disabled = 1;
 	spin_unlock_irqrestore(&core->cpu_lock, flags);
 
+	requested_freq = msm_dcvs_budget_clamp(core, requested_freq);
 	if (requested_freq == core->actual_freq)
-		return ret;
+		goto repeat;
 
 	/**
 	 * Call the frequency sink driver to change the frequency
@@ -158,6 +270,7 @@ repeat:
 	} else {
 		prev_freq = core->actual_freq;
 		core->actual_freq = ret;
+		msm_dcvs_budget_update(core, core->actual_freq);
 	}
 
 	time_end = ktime_to_ns(ktime_get());
@@ -220,19 +333,13 @@ repeat:
 	 * By the time we are done with freq changes, we could be asked to
 	 * change again. Check before exiting.
 	 */
-	if (core->freq_pending)
-		goto repeat;
-
-	core->change_freq_activated = 0;
-	return ret;
+	goto repeat;
 }
 
 static int msm_dcvs_do_freq(void *data)
 {
 	struct dcvs_core *core = (struct dcvs_core *)data;
-	static struct sched_param param = {.sched_priority = MAX_RT_PRIO - 1};
 
-	sched_setscheduler(current, SCHED_FIFO, &param);
 	set_current_state(TASK_UNINTERRUPTIBLE);
 
 	while (!kthread_should_stop()) {
@@ -277,15 +384,21 @@ static int msm_dcvs_update_freq(struct dcvs_core *core,
 		core->new_freq[core->freq_pending++] = new_freq;
 		core->time_start = ktime_to_ns(ktime_get());
 
-		/* Schedule the frequency change */
+		/*
+		 * Schedule the frequency change.  A thread that is still
+		 * busy picks the new request up before it sleeps again, so
+		 * it only needs waking when it is done.
+		 */
 		if (!core->task)
 			__err("Uninitialized task for core %s\n",
 					core->core_name);
 		else {
 			if (freq_changed)
 				*freq_changed = 1;
-			core->change_freq_activated = 1;
-			wake_up_process(core->task);
+			if (!core->change_freq_activated) {
+				core->change_freq_activated = 1;
+				wake_up_process(core->task);
+			}
 		}
 	} else {
 		if (freq_changed)
@@ -303,6 +416,15 @@ static enum hrtimer_restart msm_dcvs_core_slack_timer(struct hrtimer *timer)
 	struct dcvs_core *core = container_of(timer, struct dcvs_core, timer);
 	uint32_t ret1;
 	uint32_t ret2;
+	unsigned long flags;
+	int32_t disabled;
+
+	/* lost the race against a frequency change cancelling us */
+	spin_lock_irqsave(&core->cpu_lock, flags);
+	disabled = core->timer_disabled;
+	spin_unlock_irqrestore(&core->cpu_lock, flags);
+	if (disabled)
+		return HRTIMER_NORESTART;
 
 	if (msm_dcvs_debug & MSM_DCVS_DEBUG_FREQ_CHANGE)
 		__info("Slack timer fired for core %s\n", core->core_name);
@@ -387,6 +509,7 @@ DCVS_PARAM_SHOW(idle_enabled, (core->idle_driver != NULL))
 DCVS_PARAM_SHOW(freq_change_enabled, (core->freq_driver != NULL))
 DCVS_PARAM_SHOW(actual_freq, (core->actual_freq))
 DCVS_PARAM_SHOW(freq_change_us, (core->freq_change_us))
+DCVS_PARAM_SHOW(active_energy, (core->active_energy))
 DCVS_PARAM_SHOW(max_time_us, (core->max_time_us))
 
 DCVS_ALGO_PARAM(slack_time_us)
@@ -403,7 +526,7 @@ static int msm_dcvs_setup_core_sysfs(struct dcvs_core *core)
 {
 	int ret = 0;
 	struct kobject *core_kobj = NULL;
-	const int attr_count = 15;
+	const int attr_count = 16;
 
 	BUG_ON(!cores_kobj);
 
@@ -420,18 +543,19 @@ static int msm_dcvs_setup_core_sysfs(struct dcvs_core *core)
 	DCVS_RO_ATTRIB(2, actual_freq);
 	DCVS_RO_ATTRIB(3, freq_change_us);
 	DCVS_RO_ATTRIB(4, max_time_us);
+	DCVS_RO_ATTRIB(5, active_energy);
 
-	DCVS_RW_ATTRIB(5, slack_time_us);
-	DCVS_RW_ATTRIB(6, scale_slack_time);
-	DCVS_RW_ATTRIB(7, scale_slack_time_pct);
-	DCVS_RW_ATTRIB(8, disable_pc_threshold);
-	DCVS_RW_ATTRIB(9, em_window_size);
-	DCVS_RW_ATTRIB(10, em_max_util_pct);
-	DCVS_RW_ATTRIB(11, ss_window_size);
-	DCVS_RW_ATTRIB(12, ss_util_pct);
-	DCVS_RW_ATTRIB(13, ss_iobusy_conv);
+	DCVS_RW_ATTRIB(6, slack_time_us);
+	DCVS_RW_ATTRIB(7, scale_slack_time);
+	DCVS_RW_ATTRIB(8, scale_slack_time_pct);
+	DCVS_RW_ATTRIB(9, disable_pc_threshold);
+	DCVS_RW_ATTRIB(10, em_window_size);
+	DCVS_RW_ATTRIB(11, em_max_util_pct);
+	DCVS_RW_ATTRIB(12, ss_window_size);
+	DCVS_RW_ATTRIB(13, ss_util_pct);
+	DCVS_RW_ATTRIB(14, ss_iobusy_conv);
 
-	core->attrib.attrib_group.attrs[14] = NULL;
+	core->attrib.attrib_group.attrs[15] = NULL;
 
 	core_kobj = kobject_create_and_add(core->core_name, cores_kobj);
 	if (!core_kobj) {
@@ -528,6 +652,14 @@ int msm_dcvs_register_core(const char *core_name, uint32_t group_id,
 	memcpy(&core->algo_param, &info->algo_param,
 			sizeof(struct msm_dcvs_algo_param));
 
+	/* the GPU fills its table in at probe, keep what it is now */
+	kfree(core->freq_tbl);
+	core->num_freq = 0;
+	core->freq_tbl = kmemdup(info->freq_tbl, info->core_param.num_freq *
+			sizeof(struct msm_dcvs_freq_entry), GFP_KERNEL);
+	if (core->freq_tbl)
+		core->num_freq = info->core_param.num_freq;
+
 	ret = msm_dcvs_scm_register_core(core->handle, group_id,
 			&info->core_param, info->freq_tbl);
 	if (ret)
@@ -554,6 +686,7 @@ int msm_dcvs_freq_sink_register(struct msm_dcvs_freq *drv)
 {
 	int ret = -EINVAL;
 	struct dcvs_core *core = NULL;
+	struct sched_param param = { .sched_priority = MAX_RT_PRIO - 1 };
 	uint32_t ret1;
 	uint32_t ret2;
 
@@ -569,18 +702,22 @@ int msm_dcvs_freq_sink_register(struct msm_dcvs_freq *drv)
 		__info("Frequency notifier for %s being replaced\n",
 				core->core_name);
 	core->freq_driver = drv;
+	core->change_freq_activated = 0;
 	core->task = kthread_create(msm_dcvs_do_freq, (void *)core,
 			"msm_dcvs/%d", core->handle);
 	if (IS_ERR(core->task)) {
 		mutex_unlock(&core->lock);
 		return -EFAULT;
 	}
+	/* frequency changes are on the critical path of every wake up */
+	sched_setscheduler_nocheck(core->task, SCHED_FIFO, &param);
 
 	if (msm_dcvs_debug & MSM_DCVS_DEBUG_IDLE_PULSE)
 		__info("Enabling idle pulse for %s\n", core->core_name);
 
 	if (core->idle_driver) {
 		core->actual_freq = core->freq_driver->get_frequency(drv);
+		msm_dcvs_budget_update(core, core->actual_freq);
 		/* Notify TZ to start receiving idle info for the core */
 		ret = msm_dcvs_update_freq(core, MSM_DCVS_SCM_ENABLE_CORE, 1,
 					   &ret1, &ret2);
@@ -625,6 +762,7 @@ int msm_dcvs_freq_sink_unregister(struct msm_dcvs_freq *drv)
 	}
 	core->freq_pending = 0;
 	core->freq_driver = NULL;
+	msm_dcvs_budget_update(core, 0);
 	mutex_unlock(&core->lock);
 	kthread_stop(core->task);
 
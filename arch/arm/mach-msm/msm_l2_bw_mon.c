@@ -0,0 +1,216 @@
+/* Copyright (c) 2012, Code Aurora Forum. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * CPU to DDR bandwidth monitor.  Two kernel counters on the Krait L2
+ * PMU count the read and write beats the L2 puts on the bus for all
+ * cores.  Every sample_ms the bandwidth they add up to is turned into a
+ * bus vote with io_percent headroom and handed to acpuclock in place of
+ * the vote derived from the L2 rate.  A higher demand is voted for at
+ * once, a lower one is approached over a few samples.
+ */
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/err.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+#include <linux/perf_event.h>
+#include <linux/workqueue.h>
+
+#include <mach/msm-krait-l2-accessors.h>
+
+#include "acpuclock-krait.h"
+
+/* L2 master port read and write beats, in the msm-l2 perf RAW format */
+#define L2_BUS_RD_BEATS		0x20b2
+#define L2_BUS_WR_BEATS		0x20b3
+#define BYTES_PER_BEAT		8
+
+static bool enabled = 1;
+static unsigned int sample_ms = 50;
+/* percentage of the voted bandwidth the measured traffic may take */
+static unsigned int io_percent = 50;
+/* never vote for less than this, in MBps */
+static unsigned int floor_mbps = 400;
+
+module_param(sample_ms, uint, 0644);
+module_param(io_percent, uint, 0644);
+module_param(floor_mbps, uint, 0644);
+
+static struct {
+	struct mutex lock;
+	struct delayed_work work;
+	struct perf_event *rd, *wr;
+	u64 prev_beats;
+	ktime_t prev_time;
+	unsigned int vote_mbps;
+	unsigned int mbps;		/* last measured bandwidth */
+	int inited;
+} bw;
+
+module_param_named(measured_mbps, bw.mbps, uint, 0444);
+module_param_named(vote_mbps, bw.vote_mbps, uint, 0444);
+
+static struct perf_event *bw_mon_create_counter(u64 config)
+{
+	struct perf_event_attr attr = {
+		.type		= krait_l2_pmu_type(),
+		.size		= sizeof(struct perf_event_attr),
+		.config		= config,
+		.pinned		= 1,
+	};
+
+	/* the L2 counters see all cores, so counting on one cpu is enough */
+	return perf_event_create_kernel_counter(&attr, 0, NULL, NULL);
+}
+
+static u64 bw_mon_read_beats(void)
+{
+	u64 enabled_time, running;
+
+	return perf_event_read_value(bw.rd, &enabled_time, &running) +
+	       perf_event_read_value(bw.wr, &enabled_time, &running);
+}
+
+static void bw_mon_release(void)
+{
+	if (bw.rd)
+		perf_event_release_kernel(bw.rd);
+	if (bw.wr)
+		perf_event_release_kernel(bw.wr);
+	bw.rd = bw.wr = NULL;
+}
+
+static int bw_mon_start(void)
+{
+	struct perf_event *event;
+
+	if (bw.rd)
+		return 0;
+	if (!krait_l2_pmu_type())
+		return -ENODEV;
+
+	event = bw_mon_create_counter(L2_BUS_RD_BEATS);
+	if (IS_ERR(event))
+		return PTR_ERR(event);
+	bw.rd = event;
+
+	event = bw_mon_create_counter(L2_BUS_WR_BEATS);
+	if (IS_ERR(event)) {
+		bw_mon_release();
+		return PTR_ERR(event);
+	}
+	bw.wr = event;
+
+	bw.prev_beats = bw_mon_read_beats();
+	bw.prev_time = ktime_get();
+	bw.vote_mbps = 0;
+	return 0;
+}
+
+static void bw_mon_stop(void)
+{
+	if (!bw.rd)
+		return;
+	bw_mon_release();
+	bw.mbps = bw.vote_mbps = 0;
+	acpuclk_krait_set_bw_demand(0);
+}
+
+static void bw_mon_work(struct work_struct *work)
+{
+	unsigned int want;
+	ktime_t now;
+	u64 beats;
+	s64 us;
+
+	mutex_lock(&bw.lock);
+	if (!enabled || !bw.rd)
+		goto out;
+
+	now = ktime_get();
+	beats = bw_mon_read_beats();
+	us = ktime_us_delta(now, bw.prev_time);
+	if (us <= 0)
+		goto requeue;
+
+	/* bytes per microsecond are MBps */
+	bw.mbps = div64_u64((beats - bw.prev_beats) * BYTES_PER_BEAT, us);
+	bw.prev_beats = beats;
+	bw.prev_time = now;
+
+	want = max(bw.mbps * 100 / clamp(io_percent, 1U, 100U), floor_mbps);
+	/* follow a rise at once, a drop gradually */
+	bw.vote_mbps = max(want, (3 * bw.vote_mbps + want) / 4);
+	acpuclk_krait_set_bw_demand(bw.vote_mbps);
+
+requeue:
+	queue_delayed_work(system_freezable_wq, &bw.work,
+			   msecs_to_jiffies(max(sample_ms, 10U)));
+out:
+	mutex_unlock(&bw.lock);
+}
+
+static int bw_mon_set_enabled(const char *val, const struct kernel_param *kp)
+{
+	int ret = param_set_bool(val, kp);
+
+	if (ret || !bw.inited)
+		return ret;
+
+	mutex_lock(&bw.lock);
+	if (enabled) {
+		ret = bw_mon_start();
+		if (!ret)
+			queue_delayed_work(system_freezable_wq, &bw.work, 0);
+		else
+			enabled = 0;
+	} else {
+		bw_mon_stop();
+	}
+	mutex_unlock(&bw.lock);
+	return ret;
+}
+
+static struct kernel_param_ops bw_mon_enabled_ops = {
+	.set = bw_mon_set_enabled,
+	.get = param_get_bool,
+};
+module_param_cb(enabled, &bw_mon_enabled_ops, &enabled, 0644);
+
+static int __init msm_l2_bw_mon_init(void)
+{
+	int ret;
+
+	mutex_init(&bw.lock);
+	INIT_DELAYED_WORK(&bw.work, bw_mon_work);
+
+	mutex_lock(&bw.lock);
+	bw.inited = 1;
+	if (enabled) {
+		ret = bw_mon_start();
+		if (ret) {
+			pr_warn("%s: no L2 counters (%d), voting by L2 rate\n",
+				__func__, ret);
+			enabled = 0;
+		} else {
+			queue_delayed_work(system_freezable_wq, &bw.work,
+					   msecs_to_jiffies(sample_ms));
+		}
+	}
+	mutex_unlock(&bw.lock);
+	return 0;
+}
+late_initcall(msm_l2_bw_mon_init);
@@ -0,0 +1,269 @@
+/* Copyright (c) 2012, Code Aurora Forum. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * Run queue based cpu hotplug.  Every sample_ms the run queue average
+ * and the load normalized to the maximum frequency are read from
+ * msm_rq_stats and turned into a number of cores: as many as are needed
+ * to keep either below rq_per_cpu / load_per_cpu per core.  More cores
+ * are brought up at once, cores are taken down one at a time and only
+ * after fewer were wanted for down_delay_ms.  Touch input brings up
+ * input_boost_cpus cores right away and keeps them for input_boost_ms.
+ */
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/cpu.h>
+#include <linux/input.h>
+#include <linux/jiffies.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+#include <linux/rq_stats.h>
+
+static bool enabled = 1;
+static unsigned int sample_ms = 50;
+static unsigned int min_cpus = 1;
+static unsigned int max_cpus = NR_CPUS;
+/* run queue average per core, times ten, before another core is wanted */
+static unsigned int rq_per_cpu = 15;
+/* load at maximum frequency per core before another core is wanted */
+static unsigned int load_per_cpu = 70;
+static unsigned int down_delay_ms = 500;
+static unsigned int input_boost_cpus = 2;
+static unsigned int input_boost_ms = 1000;
+
+module_param(sample_ms, uint, 0644);
+module_param(min_cpus, uint, 0644);
+module_param(max_cpus, uint, 0644);
+module_param(rq_per_cpu, uint, 0644);
+module_param(load_per_cpu, uint, 0644);
+module_param(down_delay_ms, uint, 0644);
+module_param(input_boost_cpus, uint, 0644);
+module_param(input_boost_ms, uint, 0644);
+
+static struct {
+	struct mutex lock;
+	struct delayed_work work;
+	struct work_struct boost_work;
+	bool down_pending;
+	unsigned long down_since;	/* jiffies fewer cores were wanted */
+	unsigned long boost_until;
+	int inited;
+} hp;
+
+static unsigned int rq_hotplug_clamp(unsigned int cpus)
+{
+	unsigned int lo = max(min_cpus, 1U);
+	unsigned int hi = min_t(unsigned int, max_cpus, nr_cpu_ids);
+
+	return clamp(cpus, lo, max(lo, hi));
+}
+
+static void rq_hotplug_up(unsigned int target)
+{
+	unsigned int online = num_online_cpus();
+	int cpu;
+
+	for_each_present_cpu(cpu) {
+		if (online >= target)
+			break;
+		if (cpu_online(cpu))
+			continue;
+		if (!cpu_up(cpu))
+			online++;
+	}
+}
+
+static void rq_hotplug_down_one(void)
+{
+	int cpu;
+
+	for (cpu = nr_cpu_ids - 1; cpu > 0; cpu--) {
+		if (cpu_online(cpu)) {
+			cpu_down(cpu);
+			return;
+		}
+	}
+}
+
+static unsigned int rq_hotplug_target(void)
+{
+	unsigned int load = report_load_at_max_freq();
+	unsigned int rq = report_rq_avg();
+	unsigned int target;
+
+	target = max(DIV_ROUND_UP(load, max(load_per_cpu, 1U)),
+		     DIV_ROUND_UP(rq, max(rq_per_cpu, 1U)));
+	if (time_before(jiffies, hp.boost_until))
+		target = max(target, input_boost_cpus);
+
+	pr_debug("%s: load=%u rq=%u target=%u\n", __func__, load, rq, target);
+	return rq_hotplug_clamp(target);
+}
+
+static void rq_hotplug_work(struct work_struct *work)
+{
+	unsigned int online, target;
+
+	if (!enabled)
+		return;
+
+	mutex_lock(&hp.lock);
+	/* the statistics are set up by a late initcall as well */
+	if (!rq_info.init)
+		goto out;
+
+	online = num_online_cpus();
+	target = rq_hotplug_target();
+	if (target > online) {
+		hp.down_pending = false;
+		rq_hotplug_up(target);
+	} else if (target < online) {
+		if (!hp.down_pending) {
+			hp.down_pending = true;
+			hp.down_since = jiffies;
+		} else if (time_after_eq(jiffies, hp.down_since +
+					 msecs_to_jiffies(down_delay_ms))) {
+			rq_hotplug_down_one();
+			/* give the remaining cores a full delay again */
+			hp.down_since = jiffies;
+		}
+	} else {
+		hp.down_pending = false;
+	}
+out:
+	mutex_unlock(&hp.lock);
+
+	queue_delayed_work(system_freezable_wq, &hp.work,
+			   msecs_to_jiffies(max(sample_ms, 10U)));
+}
+
+static void rq_hotplug_boost_work(struct work_struct *work)
+{
+	if (!enabled)
+		return;
+
+	mutex_lock(&hp.lock);
+	hp.down_pending = false;
+	rq_hotplug_up(rq_hotplug_clamp(input_boost_cpus));
+	mutex_unlock(&hp.lock);
+}
+
+static int rq_hotplug_set_enabled(const char *val,
+				  const struct kernel_param *kp)
+{
+	int ret = param_set_bool(val, kp);
+
+	if (!ret && enabled && hp.inited)
+		queue_delayed_work(system_freezable_wq, &hp.work, 0);
+	return ret;
+}
+
+static struct kernel_param_ops rq_hotplug_enabled_ops = {
+	.set = rq_hotplug_set_enabled,
+	.get = param_get_bool,
+};
+module_param_cb(enabled, &rq_hotplug_enabled_ops, &enabled, 0644);
+
+static void rq_hotplug_input_event(struct input_handle *handle,
+		unsigned int type, unsigned int code, int value)
+{
+	if (!enabled)
+		return;
+
+	hp.boost_until = jiffies + msecs_to_jiffies(input_boost_ms);
+	if (num_online_cpus() < rq_hotplug_clamp(input_boost_cpus))
+		queue_work(system_freezable_wq, &hp.boost_work);
+}
+
+static int rq_hotplug_input_connect(struct input_handler *handler,
+		struct input_dev *dev, const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int error;
+
+	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = handler->name;
+
+	error = input_register_handle(handle);
+	if (error)
+		goto err2;
+
+	error = input_open_device(handle);
+	if (error)
+		goto err1;
+
+	return 0;
+err1:
+	input_unregister_handle(handle);
+err2:
+	kfree(handle);
+	return error;
+}
+
+static void rq_hotplug_input_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+/* touchscreens and touchpads, sensors report through input as well */
+static const struct input_device_id rq_hotplug_input_ids[] = {
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+		.absbit = { [BIT_WORD(ABS_MT_POSITION_X)] =
+			    BIT_MASK(ABS_MT_POSITION_X) |
+			    BIT_MASK(ABS_MT_POSITION_Y) },
+	},
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_KEYBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.keybit = { [BIT_WORD(BTN_TOUCH)] = BIT_MASK(BTN_TOUCH) },
+		.absbit = { [BIT_WORD(ABS_X)] =
+			    BIT_MASK(ABS_X) | BIT_MASK(ABS_Y) },
+	},
+	{ },
+};
+
+static struct input_handler rq_hotplug_input_handler = {
+	.event		= rq_hotplug_input_event,
+	.connect	= rq_hotplug_input_connect,
+	.disconnect	= rq_hotplug_input_disconnect,
+	.name		= "rq_hotplug",
+	.id_table	= rq_hotplug_input_ids,
+};
+
+static int __init msm_rq_hotplug_init(void)
+{
+	mutex_init(&hp.lock);
+	INIT_DELAYED_WORK(&hp.work, rq_hotplug_work);
+	INIT_WORK(&hp.boost_work, rq_hotplug_boost_work);
+
+	if (input_register_handler(&rq_hotplug_input_handler))
+		pr_warn("%s: input handler registration failed\n", __func__);
+
+	hp.inited = 1;
+	queue_delayed_work(system_freezable_wq, &hp.work,
+			   msecs_to_jiffies(sample_ms));
+	return 0;
+}
+late_initcall(msm_rq_hotplug_init);
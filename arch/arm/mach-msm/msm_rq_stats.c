@@ -150,7 +150,11 @@ static int update_average_load(unsigned int freq, unsigned int cpu)
 	return 0;
 }
 
-static unsigned int report_load_at_max_freq(void)
+/*
+ * report_load_at_max_freq: sum of the online cpus' load since the last
+ * call, each scaled to their maximum frequency
+ */
+unsigned int report_load_at_max_freq(void)
 {
 	int cpu;
 	struct cpu_load_data *pcpu;
@@ -215,8 +219,11 @@ static void def_work_fn(struct work_struct *work)
 	sysfs_notify(rq_info.kobj, NULL, "def_timer_ms");
 }
 
-static ssize_t run_queue_avg_show(struct kobject *kobj,
-		struct kobj_attribute *attr, char *buf)
+/*
+ * report_rq_avg: average number of runnable tasks since the last call,
+ * times ten
+ */
+unsigned int report_rq_avg(void)
 {
 	unsigned int val = 0;
 	unsigned long flags = 0;
@@ -227,6 +234,14 @@ static ssize_t run_queue_avg_show(struct kobject *kobj,
 	rq_info.rq_avg = 0;
 	spin_unlock_irqrestore(&rq_lock, flags);
 
+	return val;
+}
+
+static ssize_t run_queue_avg_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	unsigned int val = report_rq_avg();
+
 	return snprintf(buf, PAGE_SIZE, "%d.%d\n", val/10, val%10);
 }
 
@@ -35,6 +35,16 @@
 
 #define RTB_COMPAT_STR	"qcom,msm-rtb"
 
+/*
+ * Events logged with LOGTYPE_NOPC carry a value other than a pc in the
+ * caller field:
+ *	LOGK_TIMESTAMP	lower 32 bits of sched_clock(), upper ones in data
+ *	LOGK_SCHED	pid switched away from, pid switched to in data
+ *	LOGK_CLK	struct clk, new rate in data
+ * Enabling LOGK_TIMESTAMP in the filter puts a timestamp entry in front
+ * of every event, at the cost of twice the entries.
+ */
+
 /* Write
  * 1) 3 bytes sentinel
  * 2) 1 bytes of log type
@@ -212,6 +222,10 @@ int uncached_logk_pc(enum logk_event_type log_type, void *caller,
 		return 0;
 
 	i = msm_rtb_get_idx();
+	if (msm_rtb.filter & (1 << LOGK_TIMESTAMP)) {
+		uncached_logk_timestamp(i);
+		i = msm_rtb_get_idx();
+	}
 
 	uncached_logk_pc_idx(log_type, caller, data, i);
 
@@ -23,6 +23,8 @@
 #include <linux/suspend.h>
 #include <linux/percpu.h>
 #include <linux/interrupt.h>
+#include <linux/cpu.h>
+#include <linux/timer.h>
 #include <asm/fiq.h>
 #include <asm/hardware/gic.h>
 #include <mach/msm_iomap.h>
@@ -52,6 +54,7 @@ static void __iomem *msm_wdt_base;
 static unsigned long delay_time;
 static unsigned long bark_time;
 static unsigned long long last_pet;
+static unsigned long last_pet_jiffies;
 static bool has_vic;
 static unsigned int msm_wdog_irq;
 
@@ -94,6 +97,26 @@ static int appsbark_fiq;
 static int print_all_stacks = 1;
 module_param(print_all_stacks, int,  S_IRUGO | S_IWUSR);
 
+/*
+ * On the kernel command line specify msm_watchdog.opportunistic=0 to pet
+ * from the periodic work on cpu0 only. By default cpus that are awake
+ * anyway pet on idle exit and from a deferrable timer, and the work on
+ * cpu0 only runs when nobody petted for a whole pet_time. A pet then
+ * also requires every online cpu to be idle or to have shown a heartbeat
+ * within the last pet_time, so a cpu stuck with interrupts off lets the
+ * dog bark even though the others are fine.
+ */
+static int opportunistic = 1;
+module_param(opportunistic, int, 0);
+
+struct wdog_heartbeat {
+	struct timer_list timer;
+	unsigned long last;	/* jiffies of the last sign of life */
+	bool idle;
+};
+static DEFINE_PER_CPU(struct wdog_heartbeat, wdog_hb);
+static DEFINE_SPINLOCK(opportunistic_pet_lock);
+
 /* Area for context dump in secure mode */
 static void *scm_regsave;
 
@@ -125,12 +148,19 @@ static int msm_watchdog_suspend(struct device *dev)
 
 static int msm_watchdog_resume(struct device *dev)
 {
+	int cpu;
+
 	if (!enable)
 		return 0;
 
+	if (opportunistic)
+		for_each_online_cpu(cpu)
+			per_cpu(wdog_hb, cpu).last = jiffies;
+
 	__raw_writel(1, msm_wdt_base + WDT_EN);
 	__raw_writel(1, msm_wdt_base + WDT_RST);
 	mb();
+	last_pet_jiffies = jiffies;
 	return 0;
 }
 
@@ -178,6 +208,8 @@ static void wdog_disable_work(struct work_struct *work)
 	enable = 0;
 	atomic_notifier_chain_unregister(&panic_notifier_list, &panic_blk);
 	cancel_delayed_work(&dogwork_struct);
+	if (opportunistic)
+		idle_notifier_unregister(&wdog_idle_nb);
 	/* may be suspended after the first write above */
 	__raw_writel(0, msm_wdt_base + WDT_EN);
 	complete(&work_data->complete);
@@ -240,14 +272,141 @@ void pet_watchdog(void)
 	if (slack_ns < min_slack_ns)
 		min_slack_ns = slack_ns;
 	last_pet = time_ns;
+	last_pet_jiffies = jiffies;
+}
+
+static bool wdog_cpus_alive(void)
+{
+	struct wdog_heartbeat *hb;
+	int cpu;
+
+	for_each_online_cpu(cpu) {
+		hb = &per_cpu(wdog_hb, cpu);
+		if (!hb->idle && time_after(jiffies, hb->last + delay_time)) {
+			pr_err_ratelimited("%s: no heartbeat from cpu %d "
+				"for %u ms\n", __func__, cpu,
+				jiffies_to_msecs(jiffies - hb->last));
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Pet from a cpu that is awake anyway, at most every half pet_time */
+static void pet_watchdog_opportunistic(void)
+{
+	if (!enable ||
+	    time_before(jiffies, last_pet_jiffies + delay_time / 2))
+		return;
+
+	if (!spin_trylock(&opportunistic_pet_lock))
+		return;
+	if (wdog_cpus_alive())
+		pet_watchdog();
+	spin_unlock(&opportunistic_pet_lock);
+}
+
+static void wdog_heartbeat_fn(unsigned long data)
+{
+	struct wdog_heartbeat *hb = &__get_cpu_var(wdog_hb);
+
+	if (!enable)
+		return;
+
+	hb->last = jiffies;
+	pet_watchdog_opportunistic();
+	mod_timer_pinned(&hb->timer, jiffies + delay_time / 2);
+}
+
+static int wdog_idle_notify(struct notifier_block *nb, unsigned long val,
+			    void *data)
+{
+	struct wdog_heartbeat *hb = &__get_cpu_var(wdog_hb);
+
+	switch (val) {
+	case IDLE_START:
+		hb->idle = true;
+		break;
+	case IDLE_END:
+		hb->idle = false;
+		hb->last = jiffies;
+		pet_watchdog_opportunistic();
+		break;
+	}
+	return NOTIFY_OK;
+}
+
+static struct notifier_block wdog_idle_nb = {
+	.notifier_call = wdog_idle_notify,
+};
+
+static int __cpuinit wdog_cpu_callback(struct notifier_block *nb,
+				       unsigned long action, void *hcpu)
+{
+	int cpu = (unsigned long)hcpu;
+	struct wdog_heartbeat *hb = &per_cpu(wdog_hb, cpu);
+
+	switch (action & ~CPU_TASKS_FROZEN) {
+	case CPU_UP_PREPARE:
+		hb->idle = false;
+		hb->last = jiffies;
+		break;
+	case CPU_ONLINE:
+	case CPU_DOWN_FAILED:
+		hb->last = jiffies;
+		if (!timer_pending(&hb->timer))
+			add_timer_on(&hb->timer, cpu);
+		break;
+	case CPU_DOWN_PREPARE:
+		del_timer_sync(&hb->timer);
+		break;
+	}
+	return NOTIFY_OK;
+}
+
+static struct notifier_block __cpuinitdata wdog_cpu_nb = {
+	.notifier_call = wdog_cpu_callback,
+};
+
+static void init_heartbeats(void)
+{
+	struct wdog_heartbeat *hb;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		hb = &per_cpu(wdog_hb, cpu);
+		init_timer_deferrable(&hb->timer);
+		hb->timer.function = wdog_heartbeat_fn;
+		hb->last = jiffies;
+	}
+
+	get_online_cpus();
+	for_each_online_cpu(cpu) {
+		hb = &per_cpu(wdog_hb, cpu);
+		hb->timer.expires = jiffies + delay_time / 2;
+		add_timer_on(&hb->timer, cpu);
+	}
+	register_hotcpu_notifier(&wdog_cpu_nb);
+	put_online_cpus();
+
+	idle_notifier_register(&wdog_idle_nb);
 }
 
 static void pet_watchdog_work(struct work_struct *work)
 {
-	pet_watchdog();
+	unsigned long next = delay_time;
+
+	if (!opportunistic) {
+		pet_watchdog();
+	} else if (time_before(jiffies, last_pet_jiffies + delay_time)) {
+		/* somebody petted meanwhile, wait for a full period again */
+		next = last_pet_jiffies + delay_time - jiffies;
+	} else if (wdog_cpus_alive()) {
+		pet_watchdog();
+	}
 
 	if (enable)
-		schedule_delayed_work_on(0, &dogwork_struct, delay_time);
+		schedule_delayed_work_on(0, &dogwork_struct, next);
 }
 
 static irqreturn_t wdog_bark_handler(int irq, void *dev_id)
@@ -376,6 +535,10 @@ static void init_watchdog_work(struct work_struct *work)
 	__raw_writel(1, msm_wdt_base + WDT_EN);
 	__raw_writel(1, msm_wdt_base + WDT_RST);
 	last_pet = sched_clock();
+	last_pet_jiffies = jiffies;
+
+	if (opportunistic)
+		init_heartbeats();
 
 	if (!has_vic)
 		enable_percpu_irq(msm_wdog_irq, IRQ_TYPE_EDGE_RISING);
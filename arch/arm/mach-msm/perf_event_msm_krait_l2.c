@@ -528,6 +528,12 @@ static struct arm_pmu krait_l2_pmu = {
 	.pmu.attr_groups		= msm_l2_pmu_attr_grps,
 };
 
+/* perf type of the L2 PMU for kernel counters, 0 until it is registered */
+u32 krait_l2_pmu_type(void)
+{
+	return pmu_type;
+}
+
 static int __devinit krait_l2_pmu_device_probe(struct platform_device *pdev)
 {
 	krait_l2_pmu.plat_device = pdev;
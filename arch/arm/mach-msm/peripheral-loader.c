@@ -27,6 +27,7 @@
 #include <linux/workqueue.h>
 #include <linux/jiffies.h>
 #include <linux/wakelock.h>
+#include <linux/completion.h>
 
 #include <asm/uaccess.h>
 #include <asm/setup.h>
@@ -57,8 +58,15 @@ struct pil_device {
 	struct delayed_work proxy;
 	struct wake_lock wlock;
 	char wake_name[32];
+	/* metadata of the last full load, for warm restarts */
+	void *mdt;
+	size_t mdt_size;
 };
 
+/* reuse the image in memory when a peripheral is restarted */
+static bool warm_restart = true;
+module_param(warm_restart, bool, S_IRUGO | S_IWUSR);
+
 #define to_pil_device(d) container_of(d, struct pil_device, dev)
 
 static ssize_t name_show(struct device *dev, struct device_attribute *attr,
@@ -133,12 +141,48 @@ static void pil_proxy_unvote(struct pil_device *pil, unsigned long timeout)
 
 #define IOMAP_SIZE SZ_4M
 
+/*
+ * The blob of the next segment is requested while the current one is
+ * copied and verified, so the firmware loader and the authentication of
+ * the previous segment overlap.
+ */
+struct pil_blob {
+	const struct firmware *fw;
+	struct completion done;
+};
+
+static void pil_blob_loaded(const struct firmware *fw, void *context)
+{
+	struct pil_blob *blob = context;
+
+	blob->fw = fw;
+	complete(&blob->done);
+}
+
+static void pil_request_blob(struct pil_device *pil, unsigned num,
+		struct pil_blob *blob)
+{
+	char fw_name[30];
+
+	snprintf(fw_name, ARRAY_SIZE(fw_name), "%s.b%02d", pil->desc->name,
+			num);
+	blob->fw = NULL;
+	init_completion(&blob->done);
+	if (request_firmware_nowait(THIS_MODULE, true, fw_name, &pil->dev,
+				GFP_KERNEL, blob, pil_blob_loaded))
+		complete(&blob->done);
+}
+
+static const struct firmware *pil_wait_blob(struct pil_blob *blob)
+{
+	wait_for_completion(&blob->done);
+	return blob->fw;
+}
+
 static int load_segment(const struct elf32_phdr *phdr, unsigned num,
-		struct pil_device *pil)
+		struct pil_device *pil, const struct firmware *fw)
 {
 	int ret = 0, count, paddr;
-	char fw_name[30];
-	const struct firmware *fw = NULL;
 	const u8 *data;
 
 	if (memblock_overlaps_memory(phdr->p_paddr, phdr->p_memsz)) {
@@ -146,17 +190,16 @@ static int load_segment(const struct elf32_phdr *phdr, unsigned num,
 			"[%#08lx, %#08lx)\n", pil->desc->name,
 			(unsigned long)phdr->p_paddr,
 			(unsigned long)(phdr->p_paddr + phdr->p_memsz));
-		return -EPERM;
+		ret = -EPERM;
+		goto release_fw;
 	}
 
 	if (phdr->p_filesz) {
-		snprintf(fw_name, ARRAY_SIZE(fw_name), "%s.b%02d",
-				pil->desc->name, num);
-		ret = request_firmware(&fw, fw_name, &pil->dev);
-		if (ret) {
-			dev_err(&pil->dev, "%s: Failed to locate blob %s\n",
-					pil->desc->name, fw_name);
-			return ret;
+		if (!fw) {
+			dev_err(&pil->dev, "%s: Failed to locate blob "
+					"%s.b%02d\n", pil->desc->name,
+					pil->desc->name, num);
+			return -ENOENT;
 		}
 
 		if (fw->size != phdr->p_filesz) {
@@ -233,17 +276,52 @@ static int segment_is_loadable(const struct elf32_phdr *p)
 	return (p->p_type == PT_LOAD) && !segment_is_hash(p->p_flags);
 }
 
+/* Index of the first segment from @i on that has a blob, or @num */
+static int next_blob(const struct elf32_phdr *phdr, int i, int num)
+{
+	for (; i < num; i++)
+		if (segment_is_loadable(&phdr[i]) && phdr[i].p_filesz)
+			break;
+	return i;
+}
+
 /* Sychronize request_firmware() with suspend */
 static DECLARE_RWSEM(pil_pm_rwsem);
 
+static int pil_auth_and_reset(struct pil_device *pil)
+{
+	unsigned long proxy_timeout = pil->desc->proxy_timeout;
+	int ret;
+
+	ret = pil_proxy_vote(pil);
+	if (ret) {
+		dev_err(&pil->dev, "%s: Failed to proxy vote\n",
+					pil->desc->name);
+		return ret;
+	}
+
+	ret = pil->desc->ops->auth_and_reset(pil->desc);
+	if (ret) {
+		dev_err(&pil->dev, "%s: Failed to bring out of reset\n",
+				pil->desc->name);
+		proxy_timeout = 0; /* Remove proxy vote immediately on error */
+		goto err_boot;
+	}
+	dev_info(&pil->dev, "%s: Brought out of reset\n", pil->desc->name);
+err_boot:
+	pil_proxy_unvote(pil, proxy_timeout);
+	return ret;
+}
+
 static int load_image(struct pil_device *pil)
 {
-	int i, ret;
+	int i, n, ret;
 	char fw_name[30];
 	struct elf32_hdr *ehdr;
-	const struct elf32_phdr *phdr;
-	const struct firmware *fw;
-	unsigned long proxy_timeout = pil->desc->proxy_timeout;
+	const struct elf32_phdr *phdrs, *phdr;
+	const struct firmware *fw, *blob_fw;
+	struct pil_blob blob;
+	bool pending = false;
 
 	down_read(&pil_pm_rwsem);
 	snprintf(fw_name, sizeof(fw_name), "%s.mdt", pil->desc->name);
@@ -289,36 +367,43 @@ static int load_image(struct pil_device *pil)
 		goto release_fw;
 	}
 
-	phdr = (const struct elf32_phdr *)(fw->data + sizeof(struct elf32_hdr));
-	for (i = 0; i < ehdr->e_phnum; i++, phdr++) {
+	phdrs = (const struct elf32_phdr *)(fw->data + sizeof(struct elf32_hdr));
+	n = next_blob(phdrs, 0, ehdr->e_phnum);
+	if (n < ehdr->e_phnum) {
+		pil_request_blob(pil, n, &blob);
+		pending = true;
+	}
+	for (i = 0; i < ehdr->e_phnum; i++) {
+		phdr = &phdrs[i];
 		if (!segment_is_loadable(phdr))
 			continue;
 
-		ret = load_segment(phdr, i, pil);
+		blob_fw = NULL;
+		if (phdr->p_filesz) {
+			/* i is the segment requested last */
+			blob_fw = pil_wait_blob(&blob);
+			n = next_blob(phdrs, i + 1, ehdr->e_phnum);
+			pending = n < ehdr->e_phnum;
+			if (pending)
+				pil_request_blob(pil, n, &blob);
+		}
+
+		ret = load_segment(phdr, i, pil, blob_fw);
 		if (ret) {
 			dev_err(&pil->dev, "%s: Failed to load segment %d\n",
 					pil->desc->name, i);
+			if (pending)
+				release_firmware(pil_wait_blob(&blob));
 			goto release_fw;
 		}
 	}
 
-	ret = pil_proxy_vote(pil);
-	if (ret) {
-		dev_err(&pil->dev, "%s: Failed to proxy vote\n",
-					pil->desc->name);
-		goto release_fw;
-	}
-
-	ret = pil->desc->ops->auth_and_reset(pil->desc);
-	if (ret) {
-		dev_err(&pil->dev, "%s: Failed to bring out of reset\n",
-				pil->desc->name);
-		proxy_timeout = 0; /* Remove proxy vote immediately on error */
-		goto err_boot;
+	ret = pil_auth_and_reset(pil);
+	if (!ret && pil->desc->warm_restart) {
+		kfree(pil->mdt);
+		pil->mdt = kmemdup(fw->data, fw->size, GFP_KERNEL);
+		pil->mdt_size = pil->mdt ? fw->size : 0;
 	}
-	dev_info(&pil->dev, "%s: Brought out of reset\n", pil->desc->name);
-err_boot:
-	pil_proxy_unvote(pil, proxy_timeout);
 release_fw:
 	release_firmware(fw);
 out:
@@ -326,6 +411,57 @@ out:
 	return ret;
 }
 
+/*
+ * Restart from the image left in memory.  Only the writable segments,
+ * which the peripheral changed while it ran, are loaded again.  The code
+ * stays as it is.  auth_and_reset() checks every segment against the
+ * signed hashes in the metadata, so an image the crash damaged is
+ * refused, and the caller then loads it from scratch.
+ */
+static int warm_boot(struct pil_device *pil)
+{
+	const struct elf32_hdr *ehdr = pil->mdt;
+	const struct elf32_phdr *phdr;
+	struct pil_blob blob;
+	int i, ret;
+
+	ret = pil->desc->ops->init_image(pil->desc, pil->mdt, pil->mdt_size);
+	if (ret)
+		return ret;
+
+	phdr = pil->mdt + sizeof(struct elf32_hdr);
+	for (i = 0; i < ehdr->e_phnum; i++, phdr++) {
+		if (!segment_is_loadable(phdr) || !(phdr->p_flags & PF_W))
+			continue;
+
+		blob.fw = NULL;
+		if (phdr->p_filesz)
+			pil_request_blob(pil, i, &blob);
+		ret = load_segment(phdr, i, pil,
+				   phdr->p_filesz ? pil_wait_blob(&blob) : NULL);
+		if (ret)
+			return ret;
+	}
+
+	return pil_auth_and_reset(pil);
+}
+
+static int pil_boot(struct pil_device *pil, bool restart)
+{
+	int ret;
+
+	if (restart && warm_restart && pil->mdt) {
+		down_read(&pil_pm_rwsem);
+		ret = warm_boot(pil);
+		up_read(&pil_pm_rwsem);
+		if (!ret)
+			return 0;
+		dev_info(&pil->dev, "%s: Warm restart failed %d, reloading\n",
+				pil->desc->name, ret);
+	}
+	return load_image(pil);
+}
+
 static void pil_set_state(struct pil_device *pil, enum pil_state state)
 {
 	if (pil->state != state) {
@@ -369,7 +505,7 @@ void *pil_get(const char *name)
 
 	mutex_lock(&pil->lock);
 	if (!pil->count) {
-		ret = load_image(pil);
+		ret = pil_boot(pil, false);
 		if (ret) {
 			retval = ERR_PTR(ret);
 			goto err_load;
@@ -467,7 +603,7 @@ int pil_force_boot(const char *name)
 	mutex_lock(&pil->lock);
 	if (!WARN(!pil->count, "%s: %s: Reference count mismatch\n",
 			pil->desc->name, __func__))
-		ret = load_image(pil);
+		ret = pil_boot(pil, true);
 	if (!ret)
 		pil_set_state(pil, PIL_ONLINE);
 	mutex_unlock(&pil->lock);
@@ -570,6 +706,7 @@ static void pil_device_release(struct device *dev)
 	struct pil_device *pil = to_pil_device(dev);
 	wake_lock_destroy(&pil->wlock);
 	mutex_destroy(&pil->lock);
+	kfree(pil->mdt);
 	kfree(pil);
 }
 
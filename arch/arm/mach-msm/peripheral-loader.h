@@ -23,6 +23,8 @@ struct module;
  * @ops: callback functions
  * @owner: module the descriptor belongs to
  * @proxy_timeout: delay in ms until proxy vote is removed
+ * @warm_restart: auth_and_reset checks the whole image in memory, so a
+ *		  restart may reuse the read-only segments still loaded
  */
 struct pil_desc {
 	const char *name;
@@ -31,6 +33,7 @@ struct pil_desc {
 	const struct pil_reset_ops *ops;
 	struct module *owner;
 	unsigned long proxy_timeout;
+	bool warm_restart;
 };
 
 /**
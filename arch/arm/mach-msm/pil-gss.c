@@ -351,6 +351,7 @@ static int __devinit pil_gss_probe(struct platform_device *pdev)
 
 	if (pas_supported(PAS_GSS) > 0) {
 		desc->ops = &pil_gss_ops_trusted;
+		desc->warm_restart = true;
 		dev_info(&pdev->dev, "using secure boot\n");
 	} else {
 		desc->ops = &pil_gss_ops;
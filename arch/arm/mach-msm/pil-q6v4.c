@@ -408,6 +408,7 @@ static int __devinit pil_q6v4_driver_probe(struct platform_device *pdev)
 
 	if (pas_supported(pdata->pas_id) > 0) {
 		desc->ops = &pil_q6v4_ops_trusted;
+		desc->warm_restart = true;
 		dev_info(&pdev->dev, "using secure boot\n");
 	} else {
 		desc->ops = &pil_q6v4_ops;
@@ -324,6 +324,7 @@ static int __devinit pil_riva_probe(struct platform_device *pdev)
 
 	if (pas_supported(PAS_WCNSS) > 0) {
 		desc->ops = &pil_riva_ops_trusted;
+		desc->warm_restart = true;
 		dev_info(&pdev->dev, "using secure boot\n");
 	} else {
 		desc->ops = &pil_riva_ops;
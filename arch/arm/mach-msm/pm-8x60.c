@@ -21,7 +21,9 @@
 #include <linux/ktime.h>
 #include <linux/pm.h>
 #include <linux/pm_qos.h>
+#include <linux/sched.h>
 #include <linux/smp.h>
+#include <linux/spinlock.h>
 #include <linux/suspend.h>
 #include <linux/tick.h>
 #include <mach/msm_iomap.h>
@@ -621,6 +623,239 @@ static int64_t msm_pm_timer_exit_suspend(int64_t time, int64_t period)
 	return time;
 }
 
+/******************************************************************************
+ * Idle Prediction
+ *****************************************************************************/
+
+/*
+ * The next timer event is only an upper bound of the idle time.  Each cpu
+ * also remembers its recent idle durations and, for the interrupts that
+ * woke it before its timer, how often each of them does so.  The shortest
+ * of the three guesses is what the low power level is chosen for.
+ */
+#define MSM_PM_IDLE_HIST		8
+#define MSM_PM_IDLE_SOURCES		8
+/* a wakeup source is forgotten after this many of its intervals */
+#define MSM_PM_IDLE_SOURCE_STALE	4
+#define MSM_PM_IDLE_IOWAIT_MULT		10
+
+struct msm_pm_idle_source {
+	unsigned int hwirq;
+	int64_t last_us;	/* time of its last wakeup, 0 if unused */
+	uint32_t interval_us;	/* average time between its wakeups */
+};
+
+struct msm_pm_idle_stats {
+	uint32_t hist[MSM_PM_IDLE_HIST];
+	unsigned int next;
+	uint32_t sleep_us;	/* time to the next timer at idle entry */
+	uint32_t predict_us;	/* expected idle time at idle entry */
+	struct msm_pm_idle_source src[MSM_PM_IDLE_SOURCES];
+};
+
+static DEFINE_PER_CPU(struct msm_pm_idle_stats, msm_pm_idle_stats);
+
+static bool msm_pm_idle_predict = 1;
+module_param_named(
+	idle_predict, msm_pm_idle_predict, bool, S_IRUGO | S_IWUSR | S_IWGRP
+);
+
+/*
+ * Average of the recent idle durations if they are close enough to each
+ * other, dropping the longest up to twice to find such a set.
+ */
+static uint32_t msm_pm_idle_typical(struct msm_pm_idle_stats *st)
+{
+	uint32_t thresh = UINT_MAX;
+	int pass, i;
+
+	for (pass = 0; pass < 3; pass++) {
+		uint64_t avg = 0, var = 0;
+		uint32_t max = 0;
+		int n = 0;
+
+		for (i = 0; i < MSM_PM_IDLE_HIST; i++) {
+			uint32_t v = st->hist[i];
+
+			if (!v || v > thresh)
+				continue;
+			avg += v;
+			max = max(max, v);
+			n++;
+		}
+		if (n < MSM_PM_IDLE_HIST / 2)
+			break;
+		do_div(avg, n);
+
+		for (i = 0; i < MSM_PM_IDLE_HIST; i++) {
+			int64_t d = st->hist[i];
+
+			if (!d || d > thresh)
+				continue;
+			d -= (int64_t) avg;
+			var += d * d;
+		}
+		do_div(var, n);
+
+		/* standard deviation within a sixth of the mean, or 20us */
+		if (var * 36 <= avg * avg || var <= 400)
+			return avg;
+		thresh = max - 1;
+	}
+
+	return UINT_MAX;
+}
+
+/* Time until the wakeup source expected first is due again */
+static uint32_t msm_pm_idle_next_source(struct msm_pm_idle_stats *st,
+		int64_t now)
+{
+	uint32_t next = UINT_MAX;
+	int i;
+
+	for (i = 0; i < MSM_PM_IDLE_SOURCES; i++) {
+		struct msm_pm_idle_source *src = &st->src[i];
+		int64_t due;
+
+		if (!src->interval_us)
+			continue;
+		if (now - src->last_us > MSM_PM_IDLE_SOURCE_STALE *
+				(int64_t) src->interval_us)
+			continue;
+
+		due = src->last_us + src->interval_us - now;
+		if (due > 0 && due < next)
+			next = due;
+	}
+
+	return next;
+}
+
+static void msm_pm_idle_learn(uint32_t idle_us)
+{
+	struct msm_pm_idle_stats *st = &__get_cpu_var(msm_pm_idle_stats);
+	struct msm_pm_idle_source *src, *oldest;
+	unsigned int hwirq;
+	int64_t now, iv;
+	int i;
+
+	st->hist[st->next] = max(idle_us, 1U);
+	st->next = (st->next + 1) % MSM_PM_IDLE_HIST;
+
+	/* nothing pending, or the timer that the sleep length covers */
+	hwirq = gic_get_pending_hwirq();
+	if (hwirq >= 1020 || idle_us + idle_us / 8 >= st->sleep_us)
+		return;
+
+	now = ktime_to_us(ktime_get());
+	oldest = src = st->src;
+	for (i = 0; i < MSM_PM_IDLE_SOURCES; i++, src++) {
+		if (src->last_us && src->hwirq == hwirq)
+			break;
+		if (src->last_us < oldest->last_us)
+			oldest = src;
+	}
+
+	if (i == MSM_PM_IDLE_SOURCES) {
+		src = oldest;
+		src->hwirq = hwirq;
+		src->interval_us = 0;
+	} else {
+		iv = min_t(int64_t, now - src->last_us, UINT_MAX);
+		src->interval_us = src->interval_us ?
+			(3 * (uint64_t) src->interval_us + iv) >> 2 : iv;
+	}
+	src->last_us = now;
+}
+
+/******************************************************************************
+ * Cluster Idle
+ *****************************************************************************/
+
+/*
+ * With more than one cpu online each of them only power collapses on its
+ * own, and the L2 SPM takes the L2 down once the last of them is down.
+ * The last cpu to go idle picks that L2 mode from the time until the
+ * first of them is expected to wake, and the first cpu to wake puts the
+ * L2 SPM back to active, so that siblings waking right after it find the
+ * L2 up and a short idle does not flush or restore it again.
+ */
+static unsigned int msm_pm_l2_retention_us = 300;
+static unsigned int msm_pm_l2_gdhs_us = 2000;
+static unsigned int msm_pm_l2_collapse_us = 10000;
+module_param_named(l2_retention_us, msm_pm_l2_retention_us, uint,
+	S_IRUGO | S_IWUSR | S_IWGRP);
+module_param_named(l2_gdhs_us, msm_pm_l2_gdhs_us, uint,
+	S_IRUGO | S_IWUSR | S_IWGRP);
+module_param_named(l2_collapse_us, msm_pm_l2_collapse_us, uint,
+	S_IRUGO | S_IWUSR | S_IWGRP);
+
+static DEFINE_RAW_SPINLOCK(msm_pm_cluster_lock);
+static int64_t msm_pm_cluster_wake_us[NR_CPUS];
+static cpumask_t msm_pm_cluster_idle;
+static unsigned int msm_pm_cluster_l2_mode = MSM_SPM_L2_MODE_DISABLED;
+
+static unsigned int msm_pm_cluster_l2_select(int64_t residency_us)
+{
+	if (residency_us >= msm_pm_l2_collapse_us)
+		return MSM_SPM_L2_MODE_POWER_COLLAPSE;
+	if (residency_us >= msm_pm_l2_gdhs_us)
+		return MSM_SPM_L2_MODE_GDHS;
+	if (residency_us >= msm_pm_l2_retention_us)
+		return MSM_SPM_L2_MODE_RETENTION;
+	return MSM_SPM_L2_MODE_DISABLED;
+}
+
+static void msm_pm_cluster_enter(unsigned int cpu, uint32_t predict_us)
+{
+	int64_t now = ktime_to_us(ktime_get());
+	int64_t wake = now + predict_us;
+	unsigned int mode;
+	int i;
+
+	raw_spin_lock(&msm_pm_cluster_lock);
+	msm_pm_cluster_wake_us[cpu] = wake;
+	cpumask_set_cpu(cpu, &msm_pm_cluster_idle);
+
+	if (num_online_cpus() < 2 ||
+	    !cpumask_subset(cpu_online_mask, &msm_pm_cluster_idle))
+		goto out;
+
+	/* last man down: the first sibling to wake bounds the L2 idle */
+	for_each_online_cpu(i)
+		wake = min(wake, msm_pm_cluster_wake_us[i]);
+
+	mode = msm_pm_cluster_l2_select(wake - now);
+	if (mode == MSM_SPM_L2_MODE_DISABLED)
+		goto out;
+
+	if (!msm_spm_l2_set_low_power_mode(mode, false)) {
+		msm_pm_cluster_l2_mode = mode;
+		if (mode == MSM_SPM_L2_MODE_POWER_COLLAPSE)
+			msm_pm_set_l2_flush_flag(1);
+	}
+
+	if (MSM_PM_DEBUG_IDLE_LIMITS & msm_pm_debug_mask)
+		pr_info("CPU%u: %s: l2 mode %u for %lldus\n", cpu, __func__,
+			mode, wake - now);
+out:
+	raw_spin_unlock(&msm_pm_cluster_lock);
+}
+
+static void msm_pm_cluster_exit(unsigned int cpu)
+{
+	raw_spin_lock(&msm_pm_cluster_lock);
+	cpumask_clear_cpu(cpu, &msm_pm_cluster_idle);
+
+	/* first one up */
+	if (msm_pm_cluster_l2_mode != MSM_SPM_L2_MODE_DISABLED) {
+		msm_spm_l2_set_low_power_mode(MSM_SPM_L2_MODE_DISABLED, false);
+		msm_pm_set_l2_flush_flag(0);
+		msm_pm_cluster_l2_mode = MSM_SPM_L2_MODE_DISABLED;
+	}
+	raw_spin_unlock(&msm_pm_cluster_lock);
+}
+
 /******************************************************************************
  * External Idle/Suspend Functions
  *****************************************************************************/
@@ -633,7 +868,8 @@ void arch_idle(void)
 int msm_pm_idle_prepare(struct cpuidle_device *dev,
 		struct cpuidle_driver *drv, int index)
 {
-	uint32_t latency_us;
+	struct msm_pm_idle_stats *st = &per_cpu(msm_pm_idle_stats, dev->cpu);
+	uint32_t latency_us, deep_latency_us;
 	uint32_t sleep_us;
 	int i;
 	unsigned int power_usage = -1;
@@ -642,6 +878,26 @@ int msm_pm_idle_prepare(struct cpuidle_device *dev,
 	latency_us = (uint32_t) pm_qos_request(PM_QOS_CPU_DMA_LATENCY);
 	sleep_us = (uint32_t) ktime_to_ns(tick_nohz_get_sleep_length());
 	sleep_us = DIV_ROUND_UP(sleep_us, 1000);
+	st->sleep_us = sleep_us;
+	deep_latency_us = latency_us;
+
+	if (msm_pm_idle_predict) {
+		int64_t now = ktime_to_us(ktime_get());
+		unsigned long iowait = nr_iowait_cpu(dev->cpu);
+
+		sleep_us = min(sleep_us, msm_pm_idle_typical(st));
+		sleep_us = min(sleep_us, msm_pm_idle_next_source(st, now));
+
+		/*
+		 * A task waiting for I/O here is woken by the completion,
+		 * so keep the exit latency of the deeper modes small
+		 * against the expected idle time.
+		 */
+		if (iowait)
+			deep_latency_us = min_t(uint32_t, latency_us, sleep_us /
+					(1 + MSM_PM_IDLE_IOWAIT_MULT * iowait));
+	}
+	st->predict_us = sleep_us;
 
 	for (i = 0; i < dev->state_count; i++) {
 		struct cpuidle_state *state = &drv->states[i];
@@ -649,6 +905,7 @@ int msm_pm_idle_prepare(struct cpuidle_device *dev,
 		enum msm_pm_sleep_mode mode;
 		bool allow;
 		void *rs_limits = NULL;
+		uint32_t mode_latency_us = latency_us;
 		uint32_t power;
 		int idx;
 
@@ -688,9 +945,12 @@ int msm_pm_idle_prepare(struct cpuidle_device *dev,
 			if (!allow)
 				break;
 
+			if (mode != MSM_PM_SLEEP_MODE_WAIT_FOR_INTERRUPT)
+				mode_latency_us = deep_latency_us;
+
 			if (pm_sleep_ops.lowest_limits)
 				rs_limits = pm_sleep_ops.lowest_limits(true,
-						mode, latency_us, sleep_us,
+						mode, mode_latency_us, sleep_us,
 						&power);
 
 			if (MSM_PM_DEBUG_IDLE & msm_pm_debug_mask)
@@ -748,10 +1008,16 @@ int msm_pm_idle_enter(enum msm_pm_sleep_mode sleep_mode)
 		exit_stat = MSM_PM_STAT_RETENTION;
 		break;
 
-	case MSM_PM_SLEEP_MODE_POWER_COLLAPSE_STANDALONE:
+	case MSM_PM_SLEEP_MODE_POWER_COLLAPSE_STANDALONE: {
+		unsigned int cpu = smp_processor_id();
+
+		msm_pm_cluster_enter(cpu,
+			__get_cpu_var(msm_pm_idle_stats).predict_us);
 		msm_pm_power_collapse_standalone(true);
+		msm_pm_cluster_exit(cpu);
 		exit_stat = MSM_PM_STAT_IDLE_STANDALONE_POWER_COLLAPSE;
 		break;
+	}
 
 	case MSM_PM_SLEEP_MODE_POWER_COLLAPSE: {
 		int64_t timer_expiration = 0;
@@ -798,6 +1064,7 @@ int msm_pm_idle_enter(enum msm_pm_sleep_mode sleep_mode)
 	msm_pm_add_stat(exit_stat, time);
 
 	do_div(time, 1000);
+	msm_pm_idle_learn(min_t(int64_t, time, UINT_MAX));
 	return (int) time;
 
 cpuidle_enter_bail:
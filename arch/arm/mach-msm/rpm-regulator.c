@@ -1033,6 +1033,102 @@ static int vreg_store(struct vreg *vreg, unsigned mask0, unsigned val0,
 	return 0;
 }
 
+/*
+ * Between regulator_batch_begin() and regulator_batch_commit() the active
+ * set requests of the batching task only update vreg->req.  They are all
+ * sent to the RPM in one msm_rpm_set() at commit.  batch_lock keeps other
+ * tasks from sending while the batch is put together.
+ */
+#define RPM_VREG_BATCH_MAX	16
+
+static DEFINE_MUTEX(batch_lock);
+static struct task_struct *batch_task;
+static struct vreg *batch_vregs[RPM_VREG_BATCH_MAX];
+static unsigned batch_cnt[RPM_VREG_BATCH_MAX];
+static int batch_len;
+
+/* Queue the request of @vreg, false if it has to be sent right away. */
+static bool vreg_batch_add(struct vreg *vreg, unsigned cnt)
+{
+	int i;
+
+	if (batch_task != current)
+		return false;
+	/* the TCXO workaround has to bracket the request itself */
+	if (requires_tcxo_workaround && vreg->requires_cxo)
+		return false;
+
+	for (i = 0; i < batch_len; i++) {
+		if (batch_vregs[i] == vreg) {
+			batch_cnt[i] = max(batch_cnt[i], cnt);
+			return true;
+		}
+	}
+	if (batch_len == RPM_VREG_BATCH_MAX)
+		return false;
+
+	batch_vregs[batch_len] = vreg;
+	batch_cnt[batch_len++] = cnt;
+	return true;
+}
+
+static void rpm_vreg_batch_begin(void)
+{
+	mutex_lock(&batch_lock);
+	batch_task = current;
+	batch_len = 0;
+	mutex_unlock(&batch_lock);
+}
+
+static int rpm_vreg_batch_commit(void)
+{
+	struct msm_rpm_iv_pair req[2 * RPM_VREG_BATCH_MAX];
+	struct vreg *vreg;
+	int i, n = 0, rc = 0;
+
+	mutex_lock(&batch_lock);
+	for (i = 0; i < batch_len; i++) {
+		vreg = batch_vregs[i];
+		if (vreg->req[0].value == vreg->prev_active_req[0].value &&
+		    (batch_cnt[i] < 2 ||
+		     vreg->req[1].value == vreg->prev_active_req[1].value)) {
+			/* changed and then changed back */
+			batch_vregs[i] = NULL;
+			continue;
+		}
+		memcpy(&req[n], vreg->req, batch_cnt[i] * sizeof(req[0]));
+		n += batch_cnt[i];
+	}
+
+	if (n)
+		rc = msm_rpm_set(MSM_RPM_CTX_SET_0, req, n);
+
+	for (i = 0; i < batch_len; i++) {
+		vreg = batch_vregs[i];
+		if (!vreg)
+			continue;
+		if (rc) {
+			vreg_err(vreg, "msm_rpm_set failed, set=active, "
+				"id=%d, rc=%d\n", vreg->req[0].id, rc);
+			continue;
+		}
+		if (msm_rpm_vreg_debug_mask & MSM_RPM_VREG_DEBUG_REQUEST)
+			rpm_regulator_req(vreg, MSM_RPM_CTX_SET_0);
+		vreg->prev_active_req[0].value = vreg->req[0].value;
+		vreg->prev_active_req[1].value = vreg->req[1].value;
+	}
+
+	batch_task = NULL;
+	batch_len = 0;
+	mutex_unlock(&batch_lock);
+	return rc;
+}
+
+static struct regulator_batch_ops rpm_vreg_batch_ops = {
+	.begin	= rpm_vreg_batch_begin,
+	.commit	= rpm_vreg_batch_commit,
+};
+
 static int vreg_set(struct vreg *vreg, unsigned mask0, unsigned val0,
 		unsigned mask1, unsigned val1, unsigned cnt)
 {
@@ -1050,6 +1146,7 @@ static int vreg_set(struct vreg *vreg, unsigned mask0, unsigned val0,
 		return vreg_set_noirq(vreg, RPM_VREG_VOTER_REG_FRAMEWORK, 1,
 					mask0, val0, mask1, val1, cnt, 1);
 
+	mutex_lock(&batch_lock);
 	prev0 = vreg->req[0].value;
 	vreg->req[0].value &= ~mask0;
 	vreg->req[0].value |= val0 & mask0;
@@ -1063,6 +1160,12 @@ static int vreg_set(struct vreg *vreg, unsigned mask0, unsigned val0,
 	    vreg->req[1].value == vreg->prev_active_req[1].value) {
 		if (msm_rpm_vreg_debug_mask & MSM_RPM_VREG_DEBUG_DUPLICATE)
 			rpm_regulator_duplicate(vreg, MSM_RPM_CTX_SET_0, cnt);
+		mutex_unlock(&batch_lock);
+		return 0;
+	}
+
+	if (vreg_batch_add(vreg, cnt)) {
+		mutex_unlock(&batch_lock);
 		return 0;
 	}
 
@@ -1111,6 +1214,7 @@ static int vreg_set(struct vreg *vreg, unsigned mask0, unsigned val0,
 		else
 			mutex_unlock(&tcxo_mutex);
 	}
+	mutex_unlock(&batch_lock);
 
 	return rc;
 }
@@ -1957,13 +2061,18 @@ static struct platform_driver rpm_vreg_driver = {
 
 static int __init rpm_vreg_init(void)
 {
-	return platform_driver_register(&rpm_vreg_driver);
+	int rc = platform_driver_register(&rpm_vreg_driver);
+
+	if (!rc)
+		regulator_register_batch_ops(&rpm_vreg_batch_ops);
+	return rc;
 }
 
 static void __exit rpm_vreg_exit(void)
 {
 	int i;
 
+	regulator_unregister_batch_ops(&rpm_vreg_batch_ops);
 	platform_driver_unregister(&rpm_vreg_driver);
 
 	kfree(consumer_map);
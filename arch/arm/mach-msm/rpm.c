@@ -65,6 +65,14 @@ static struct msm_rpm_request msm_rpm_request_poll_mode;
 static LIST_HEAD(msm_rpm_notifications);
 static struct msm_rpm_notif_config msm_rpm_notif_cfgs[MSM_RPM_CTX_SET_COUNT];
 static bool msm_rpm_init_notif_done;
+
+/*
+ * The last value written for each id and context, valid as long as the
+ * RPM still holds it.  Protected by <msm_rpm_lock>.
+ */
+static uint32_t msm_rpm_sent_value[MSM_RPM_CTX_SET_COUNT][MSM_RPM_ID_LAST];
+static unsigned long msm_rpm_sent_valid[MSM_RPM_CTX_SET_COUNT]
+	[BITS_TO_LONGS(MSM_RPM_ID_LAST)];
 /******************************************************************************
  * Internal functions
  *****************************************************************************/
@@ -161,6 +169,71 @@ static int msm_rpm_fill_sel_masks(
 	return 0;
 }
 
+/*
+ * Return true if every pair in <req> was already written to <ctx> with
+ * the same value, in which case the request need not be sent again.
+ *
+ * Note: assumes caller has acquired <msm_rpm_lock>.
+ */
+static bool msm_rpm_cache_match(int ctx, struct msm_rpm_iv_pair *req,
+	int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		if (!test_bit(req[i].id, msm_rpm_sent_valid[ctx]) ||
+			msm_rpm_sent_value[ctx][req[i].id] != req[i].value)
+			return false;
+
+	return count > 0;
+}
+
+/*
+ * Record the request being written.  An invalidate request carries the
+ * selector masks in its values, every id of those selectors is dropped.
+ *
+ * Note: assumes caller has acquired <msm_rpm_lock>.
+ */
+static void msm_rpm_cache_update(int ctx, uint32_t *sel_masks,
+	struct msm_rpm_iv_pair *req, int count)
+{
+	unsigned int inv = msm_rpm_data.sel_invalidate;
+	unsigned int sel, reg;
+	int i;
+
+	if (ctx >= MSM_RPM_CTX_SET_COUNT)
+		return;
+
+	if (sel_masks[msm_rpm_get_sel_mask_reg(inv)] &
+			msm_rpm_get_sel_mask(inv)) {
+		for (i = 0; i < MSM_RPM_ID_LAST; i++) {
+			sel = msm_rpm_map_id_to_sel(i);
+			reg = msm_rpm_get_sel_mask_reg(sel);
+			if (sel <= msm_rpm_data.sel_last && reg < count &&
+				(req[reg].value & msm_rpm_get_sel_mask(sel)))
+				clear_bit(i, msm_rpm_sent_valid[ctx]);
+		}
+		return;
+	}
+
+	for (i = 0; i < count; i++) {
+		msm_rpm_sent_value[ctx][req[i].id] = req[i].value;
+		set_bit(req[i].id, msm_rpm_sent_valid[ctx]);
+	}
+}
+
+/*
+ * Note: assumes caller has acquired <msm_rpm_lock>.
+ */
+static void msm_rpm_cache_forget(int ctx, struct msm_rpm_iv_pair *req,
+	int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		clear_bit(req[i].id, msm_rpm_sent_valid[ctx]);
+}
+
 static inline void msm_rpm_send_req_interrupt(void)
 {
 	__raw_writel(msm_rpm_data.ipc_rpm_val,
@@ -330,6 +403,7 @@ static int msm_rpm_set_exclusive(int ctx,
 		msm_rpm_write(MSM_RPM_PAGE_REQ,
 				target_enum(req[i].id), req[i].value);
 	}
+	msm_rpm_cache_update(ctx, sel_masks, req, count);
 
 	msm_rpm_write_contiguous(MSM_RPM_PAGE_CTRL,
 		target_ctrl(MSM_RPM_CTRL_REQ_SEL_0),
@@ -406,6 +480,7 @@ static int msm_rpm_set_exclusive_noirq(int ctx,
 		msm_rpm_write(MSM_RPM_PAGE_REQ,
 				target_enum(req[i].id), req[i].value);
 	}
+	msm_rpm_cache_update(ctx, sel_masks, req, count);
 
 	msm_rpm_write_contiguous(MSM_RPM_PAGE_CTRL,
 		target_ctrl(MSM_RPM_CTRL_REQ_SEL_0),
@@ -455,15 +530,40 @@ static int msm_rpm_set_common(
 	if (rc)
 		goto set_common_exit;
 
+	/*
+	 * Resources are voted again with unchanged values all the time,
+	 * e.g. the whole sleep set on every idle entry.  Such a request
+	 * costs a round trip to the RPM for nothing, so it is dropped.
+	 * <req> then keeps the requested values.
+	 */
 	if (noirq) {
 		unsigned long flags;
 
 		spin_lock_irqsave(&msm_rpm_lock, flags);
-		rc = msm_rpm_set_exclusive_noirq(ctx, sel_masks, req, count);
+		if (!msm_rpm_cache_match(ctx, req, count)) {
+			rc = msm_rpm_set_exclusive_noirq(ctx, sel_masks, req,
+				count);
+			if (rc)
+				msm_rpm_cache_forget(ctx, req, count);
+		}
 		spin_unlock_irqrestore(&msm_rpm_lock, flags);
 	} else {
+		unsigned long flags;
+		bool match;
+
 		mutex_lock(&msm_rpm_mutex);
-		rc = msm_rpm_set_exclusive(ctx, sel_masks, req, count);
+		spin_lock_irqsave(&msm_rpm_lock, flags);
+		match = msm_rpm_cache_match(ctx, req, count);
+		spin_unlock_irqrestore(&msm_rpm_lock, flags);
+
+		if (!match) {
+			rc = msm_rpm_set_exclusive(ctx, sel_masks, req, count);
+			if (rc) {
+				spin_lock_irqsave(&msm_rpm_lock, flags);
+				msm_rpm_cache_forget(ctx, req, count);
+				spin_unlock_irqrestore(&msm_rpm_lock, flags);
+			}
+		}
 		mutex_unlock(&msm_rpm_mutex);
 	}
 
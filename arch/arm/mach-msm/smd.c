@@ -36,6 +36,7 @@
 #include <linux/notifier.h>
 #include <linux/sort.h>
 #include <linux/suspend.h>
+#include <linux/hrtimer.h>
 #include <mach/msm_smd.h>
 #include <mach/msm_iomap.h>
 #include <mach/system.h>
@@ -702,6 +703,14 @@ struct smd_channel {
 
 	char is_pkt_ch;
 
+	/* write interrupt coalescing, see smd_set_write_coalescing() */
+	unsigned coalesce_watermark;
+	ktime_t coalesce_delay;
+	struct hrtimer coalesce_timer;
+	unsigned write_commits;
+	unsigned write_signals;
+	unsigned timer_signals;
+
 	/*
 	 * private internal functions to access *send and *recv.
 	 * never to be exported outside of smd
@@ -1171,6 +1180,46 @@ static void ch_write_done(struct smd_channel *ch, unsigned count)
 	ch->half_ch->set_fHEAD(ch->send, 1);
 }
 
+static void ch_write_signal(struct smd_channel *ch)
+{
+	ch->write_signals++;
+	ch->notify_other_cpu();
+}
+
+static enum hrtimer_restart ch_coalesce_timer_fn(struct hrtimer *timer)
+{
+	struct smd_channel *ch = container_of(timer, struct smd_channel,
+					      coalesce_timer);
+
+	ch->timer_signals++;
+	ch_write_signal(ch);
+	return HRTIMER_NORESTART;
+}
+
+static void ch_init_coalescing(struct smd_channel *ch)
+{
+	hrtimer_init(&ch->coalesce_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	ch->coalesce_timer.function = ch_coalesce_timer_fn;
+}
+
+/* tell the other side about written data, or let it wait for more */
+static void ch_write_commit(struct smd_channel *ch)
+{
+	unsigned fill;
+
+	ch->write_commits++;
+	fill = ch->fifo_mask - smd_stream_write_avail(ch);
+	if (!ch->coalesce_watermark || fill >= ch->coalesce_watermark) {
+		hrtimer_try_to_cancel(&ch->coalesce_timer);
+		ch_write_signal(ch);
+		return;
+	}
+
+	if (!hrtimer_active(&ch->coalesce_timer))
+		hrtimer_start(&ch->coalesce_timer, ch->coalesce_delay,
+			      HRTIMER_MODE_REL);
+}
+
 static void ch_set_state(struct smd_channel *ch, unsigned n)
 {
 	if (n == SMD_SS_OPENED) {
@@ -1443,8 +1492,9 @@ static int smd_is_packet(struct smd_alloc_elm *alloc_elm)
 		return 0;
 }
 
-static int smd_stream_write(smd_channel_t *ch, const void *_data, int len,
-				int user_buf)
+/* copy data into the fifo without telling the other side */
+static int ch_write(struct smd_channel *ch, const void *_data, int len,
+		    int user_buf)
 {
 	void *ptr;
 	const unsigned char *buf = _data;
@@ -1452,12 +1502,6 @@ static int smd_stream_write(smd_channel_t *ch, const void *_data, int len,
 	int orig_len = len;
 	int r = 0;
 
-	SMD_DBG("smd_stream_write() %d -> ch%d\n", len, ch->n);
-	if (len < 0)
-		return -EINVAL;
-	else if (len == 0)
-		return 0;
-
 	while ((xfer = ch_write_buffer(ch, &ptr)) != 0) {
 		if (!ch_is_open(ch)) {
 			len = orig_len;
@@ -1483,12 +1527,27 @@ static int smd_stream_write(smd_channel_t *ch, const void *_data, int len,
 			break;
 	}
 
-	if (orig_len - len)
-		ch->notify_other_cpu();
-
 	return orig_len - len;
 }
 
+static int smd_stream_write(smd_channel_t *ch, const void *_data, int len,
+				int user_buf)
+{
+	int r;
+
+	SMD_DBG("smd_stream_write() %d -> ch%d\n", len, ch->n);
+	if (len < 0)
+		return -EINVAL;
+	else if (len == 0)
+		return 0;
+
+	r = ch_write(ch, _data, len, user_buf);
+	if (r)
+		ch_write_commit(ch);
+
+	return r;
+}
+
 static int smd_packet_write(smd_channel_t *ch, const void *_data, int len,
 				int user_buf)
 {
@@ -1507,16 +1566,19 @@ static int smd_packet_write(smd_channel_t *ch, const void *_data, int len,
 	hdr[0] = len;
 	hdr[1] = hdr[2] = hdr[3] = hdr[4] = 0;
 
-
-	ret = smd_stream_write(ch, hdr, sizeof(hdr), 0);
+	/* header and data go out with a single commit */
+	ret = ch_write(ch, hdr, sizeof(hdr), 0);
 	if (ret < 0 || ret != sizeof(hdr)) {
 		SMD_DBG("%s failed to write pkt header: "
 			"%d returned\n", __func__, ret);
+		if (ret > 0)
+			ch_write_commit(ch);
 		return -1;
 	}
 
 
-	ret = smd_stream_write(ch, _data, len, user_buf);
+	ret = ch_write(ch, _data, len, user_buf);
+	ch_write_commit(ch);
 	if (ret < 0 || ret != len) {
 		SMD_DBG("%s failed to write pkt data: "
 			"%d returned\n", __func__, ret);
@@ -1676,6 +1738,7 @@ static int smd_alloc_channel(struct smd_alloc_elm *alloc_elm)
 	}
 	ch->n = alloc_elm->cid;
 	ch->type = SMD_CHANNEL_TYPE(alloc_elm->type);
+	ch_init_coalescing(ch);
 
 	if (smd_alloc_v2(ch) && smd_alloc_v1(ch)) {
 		kfree(ch);
@@ -1761,6 +1824,7 @@ static int smd_alloc_loopback_channel(void)
 		return -1;
 	}
 	ch->n = SMD_LOOPBACK_CID;
+	ch_init_coalescing(ch);
 
 	ch->send = &smd_loopback_ctl;
 	ch->recv = &smd_loopback_ctl;
@@ -1942,6 +2006,10 @@ int smd_close(smd_channel_t *ch)
 
 	SMD_INFO("smd_close(%s)\n", ch->name);
 
+	/* the state change below signals the other side anyway */
+	hrtimer_cancel(&ch->coalesce_timer);
+	ch->coalesce_watermark = 0;
+
 	spin_lock_irqsave(&smd_lock, flags);
 	list_del(&ch->ch_list);
 	if (ch->n == SMD_LOOPBACK_CID) {
@@ -2001,8 +2069,8 @@ int smd_write_start(smd_channel_t *ch, int len)
 	hdr[0] = len;
 	hdr[1] = hdr[2] = hdr[3] = hdr[4] = 0;
 
-
-	ret = smd_stream_write(ch, hdr, sizeof(hdr), 0);
+	/* committed together with the first segment */
+	ret = ch_write(ch, hdr, sizeof(hdr), 0);
 	if (ret < 0 || ret != sizeof(hdr)) {
 		ch->pending_pkt_sz = 0;
 		pr_err("%s: packet header failed to write\n", __func__);
@@ -2059,6 +2127,77 @@ int smd_write_end(smd_channel_t *ch)
 }
 EXPORT_SYMBOL(smd_write_end);
 
+int smd_set_write_coalescing(smd_channel_t *ch, unsigned watermark,
+			     unsigned delay_us)
+{
+	if (!ch) {
+		pr_err("%s: Invalid channel specified\n", __func__);
+		return -ENODEV;
+	}
+	if (watermark && !delay_us)
+		return -EINVAL;
+
+	ch->coalesce_delay = ns_to_ktime((u64)delay_us * NSEC_PER_USEC);
+	/* a full fifo must always wake the reader */
+	ch->coalesce_watermark = min(watermark, ch->fifo_size / 2);
+	if (!watermark)
+		smd_write_flush(ch);
+
+	return 0;
+}
+EXPORT_SYMBOL(smd_set_write_coalescing);
+
+int smd_write_flush(smd_channel_t *ch)
+{
+	if (!ch) {
+		pr_err("%s: Invalid channel specified\n", __func__);
+		return -ENODEV;
+	}
+
+	/* a running timer signals on its own */
+	if (hrtimer_try_to_cancel(&ch->coalesce_timer) > 0)
+		ch_write_signal(ch);
+
+	return 0;
+}
+EXPORT_SYMBOL(smd_write_flush);
+
+static int smd_write_stats_list(char *buf, int max, struct list_head *list)
+{
+	struct smd_channel *ch;
+	int i = 0;
+
+	list_for_each_entry(ch, list, ch_list)
+		i += scnprintf(buf + i, max - i,
+			"%-20s %9u %9u %10u %10u %10u\n", ch->name,
+			ch->coalesce_watermark,
+			(unsigned)ktime_to_us(ch->coalesce_delay),
+			ch->write_commits, ch->write_signals,
+			ch->timer_signals);
+	return i;
+}
+
+int smd_write_stats(char *buf, int max)
+{
+	unsigned long flags;
+	int i = 0;
+
+	i += scnprintf(buf + i, max - i, "%-20s %9s %9s %10s %10s %10s\n",
+		"channel", "watermark", "delay_us", "commits", "signals",
+		"timer");
+
+	spin_lock_irqsave(&smd_lock, flags);
+	i += smd_write_stats_list(buf + i, max - i, &smd_ch_list_modem);
+	i += smd_write_stats_list(buf + i, max - i, &smd_ch_list_dsp);
+	i += smd_write_stats_list(buf + i, max - i, &smd_ch_list_dsps);
+	i += smd_write_stats_list(buf + i, max - i, &smd_ch_list_wcnss);
+	i += smd_write_stats_list(buf + i, max - i, &smd_ch_list_rpm);
+	i += smd_write_stats_list(buf + i, max - i, &smd_ch_list_loopback);
+	spin_unlock_irqrestore(&smd_lock, flags);
+
+	return i;
+}
+
 int smd_read(smd_channel_t *ch, void *data, int len)
 {
 	if (!ch) {
@@ -262,4 +262,7 @@ struct interrupt_stat {
 };
 extern struct interrupt_stat interrupt_stats[NUM_SMD_SUBSYSTEMS];
 
+/* per channel write commits and remote signals of the open channels */
+int smd_write_stats(char *buf, int max);
+
 #endif
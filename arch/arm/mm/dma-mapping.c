@@ -21,6 +21,10 @@
 #include <linux/highmem.h>
 #include <linux/memblock.h>
 #include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/moduleparam.h>
+#include <linux/smp.h>
 
 #include <asm/memory.h>
 #include <asm/highmem.h>
@@ -698,6 +702,92 @@ void dma_free_coherent(struct device *dev, size_t size, void *cpu_addr, dma_addr
 }
 EXPORT_SYMBOL(dma_free_coherent);
 
+/*
+ * Cache maintenance by address runs a line at a time, which for buffers
+ * of several megabytes costs more than cleaning and invalidating the
+ * whole of every cache by set/way.  Buffers of at least
+ * cache_all_threshold bytes get the latter; the crossover is measured
+ * at boot, 0 turns it off.  Whole cache flushes need IPIs, so they are
+ * only done from process context.
+ */
+static unsigned long cache_all_threshold;
+module_param(cache_all_threshold, ulong, 0644);
+
+static void dma_cache_flush_all_cpu(void *unused)
+{
+	__cpuc_flush_kern_all();
+}
+
+static void dma_cache_flush_all(void)
+{
+	on_each_cpu(dma_cache_flush_all_cpu, NULL, 1);
+	outer_flush_all();
+}
+
+/**
+ * dma_cache_maint_all - flush the whole caches instead of a large range
+ * @size: size of the range the caller would maintain
+ *
+ * Returns true if all caches were cleaned and invalidated, which covers
+ * cleaning, invalidating or flushing any range.  Otherwise the caller
+ * has to do its range maintenance.
+ */
+bool dma_cache_maint_all(size_t size)
+{
+	unsigned long threshold = ACCESS_ONCE(cache_all_threshold);
+
+	if (!threshold || size < threshold || in_interrupt() ||
+	    irqs_disabled())
+		return false;
+	dma_cache_flush_all();
+	return true;
+}
+EXPORT_SYMBOL(dma_cache_maint_all);
+
+/*
+ * Time a flush of a dirty buffer by address against a flush of all
+ * caches, the threshold is where both take the same time.  It is kept
+ * at least at the size of the sample: flushing everything throws out
+ * the working set of the other CPUs as well, which is not measured.
+ */
+#define DMA_CACHE_SAMPLE_ORDER	8
+
+static int __init dma_cache_all_calibrate(void)
+{
+	size_t size = PAGE_SIZE << DMA_CACHE_SAMPLE_ORDER;
+	s64 range_ns, all_ns;
+	unsigned long threshold;
+	ktime_t start;
+	void *buf;
+
+	buf = (void *)__get_free_pages(GFP_KERNEL, DMA_CACHE_SAMPLE_ORDER);
+	if (!buf)
+		return 0;
+
+	memset(buf, 0, size);
+	start = ktime_get();
+	dmac_flush_range(buf, buf + size);
+	outer_flush_range(__pa(buf), __pa(buf) + size);
+	range_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	memset(buf, 0, size);
+	start = ktime_get();
+	dma_cache_flush_all();
+	all_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	free_pages((unsigned long)buf, DMA_CACHE_SAMPLE_ORDER);
+
+	if (range_ns <= 0)
+		return 0;
+	threshold = div64_u64((u64)size * all_ns, range_ns);
+	cache_all_threshold = PAGE_ALIGN(max_t(unsigned long, threshold,
+					       size));
+	pr_info("DMA: whole cache flush from %lu KiB (%lld/%lld ns per %zu KiB)\n",
+		cache_all_threshold >> 10, range_ns, all_ns, size >> 10);
+	return 0;
+}
+late_initcall(dma_cache_all_calibrate);
+
 /*
  * Make an area consistent for devices.
  * Note: Drivers should NOT use this function directly, as it will break
@@ -713,6 +803,9 @@ void ___dma_single_cpu_to_dev(const void *kaddr, size_t size,
 	BUG_ON(!virt_addr_valid(kaddr) || !virt_addr_valid(kaddr + size - 1));
 #endif
 
+	if (dma_cache_maint_all(size))
+		return;
+
 	dmac_map_area(kaddr, size, dir);
 
 #ifdef CONFIG_OUTER_CACHE
@@ -732,7 +825,12 @@ void ___dma_single_dev_to_cpu(const void *kaddr, size_t size,
 {
 #ifdef CONFIG_OUTER_CACHE
 	BUG_ON(!virt_addr_valid(kaddr) || !virt_addr_valid(kaddr + size - 1));
+#endif
 
+	if (dir != DMA_TO_DEVICE && dma_cache_maint_all(size))
+		return;
+
+#ifdef CONFIG_OUTER_CACHE
 	/* FIXME: non-speculating: not required */
 	/* don't bother invalidating if DMA to device */
 	if (dir != DMA_TO_DEVICE) {
@@ -793,6 +891,9 @@ void ___dma_page_cpu_to_dev(struct page *page, unsigned long off,
 {
 	unsigned long paddr;
 
+	if (dma_cache_maint_all(size))
+		return;
+
 	dma_cache_maint_page(page, off, size, dir, dmac_map_area);
 
 	paddr = page_to_phys(page) + off;
@@ -810,6 +911,9 @@ void ___dma_page_dev_to_cpu(struct page *page, unsigned long off,
 {
 	unsigned long paddr = page_to_phys(page) + off;
 
+	if (dir != DMA_TO_DEVICE && dma_cache_maint_all(size))
+		return;
+
 	/* FIXME: non-speculating: not required */
 	/* don't bother invalidating if DMA to device */
 	if (dir != DMA_TO_DEVICE)
@@ -825,6 +929,27 @@ void ___dma_page_dev_to_cpu(struct page *page, unsigned long off,
 }
 EXPORT_SYMBOL(___dma_page_dev_to_cpu);
 
+/*
+ * Many small entries can still add up to a large buffer, so the whole
+ * list is looked at once.  Bounced entries need their own handling.
+ */
+static bool dma_sg_maint_all(struct scatterlist *sg, int nents)
+{
+#ifdef CONFIG_DMABOUNCE
+	return false;
+#else
+	struct scatterlist *s;
+	size_t size = 0;
+	int i;
+
+	if (arch_is_coherent())
+		return false;
+	for_each_sg(sg, s, nents, i)
+		size += s->length;
+	return dma_cache_maint_all(size);
+#endif
+}
+
 /**
  * dma_map_sg - map a set of SG buffers for streaming mode DMA
  * @dev: valid struct device pointer, or NULL for ISA and EISA-like devices
@@ -849,6 +974,14 @@ int dma_map_sg(struct device *dev, struct scatterlist *sg, int nents,
 
 	BUG_ON(!valid_dma_direction(dir));
 
+	if (dma_sg_maint_all(sg, nents)) {
+		for_each_sg(sg, s, nents, i)
+			s->dma_address = pfn_to_dma(dev,
+					page_to_pfn(sg_page(s))) + s->offset;
+		debug_dma_map_sg(dev, sg, nents, nents, dir);
+		return nents;
+	}
+
 	for_each_sg(sg, s, nents, i) {
 		s->dma_address = __dma_map_page(dev, sg_page(s), s->offset,
 						s->length, dir);
@@ -883,6 +1016,9 @@ void dma_unmap_sg(struct device *dev, struct scatterlist *sg, int nents,
 
 	debug_dma_unmap_sg(dev, sg, nents, dir);
 
+	if (dir != DMA_TO_DEVICE && dma_sg_maint_all(sg, nents))
+		return;
+
 	for_each_sg(sg, s, nents, i)
 		__dma_unmap_page(dev, sg_dma_address(s), sg_dma_len(s), dir);
 }
@@ -901,6 +1037,9 @@ void dma_sync_sg_for_cpu(struct device *dev, struct scatterlist *sg,
 	struct scatterlist *s;
 	int i;
 
+	if (dir != DMA_TO_DEVICE && dma_sg_maint_all(sg, nents))
+		goto out;
+
 	for_each_sg(sg, s, nents, i) {
 		if (!dmabounce_sync_for_cpu(dev, sg_dma_address(s),
 					    sg_dma_len(s), dir))
@@ -910,6 +1049,7 @@ void dma_sync_sg_for_cpu(struct device *dev, struct scatterlist *sg,
 				      s->length, dir);
 	}
 
+out:
 	debug_dma_sync_sg_for_cpu(dev, sg, nents, dir);
 }
 EXPORT_SYMBOL(dma_sync_sg_for_cpu);
@@ -927,6 +1067,9 @@ void dma_sync_sg_for_device(struct device *dev, struct scatterlist *sg,
 	struct scatterlist *s;
 	int i;
 
+	if (dma_sg_maint_all(sg, nents))
+		goto out;
+
 	for_each_sg(sg, s, nents, i) {
 		if (!dmabounce_sync_for_device(dev, sg_dma_address(s),
 					sg_dma_len(s), dir))
@@ -936,6 +1079,7 @@ void dma_sync_sg_for_device(struct device *dev, struct scatterlist *sg,
 				      s->length, dir);
 	}
 
+out:
 	debug_dma_sync_sg_for_device(dev, sg, nents, dir);
 }
 EXPORT_SYMBOL(dma_sync_sg_for_device);
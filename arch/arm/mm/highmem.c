@@ -36,6 +36,22 @@ void kunmap(struct page *page)
 }
 EXPORT_SYMBOL(kunmap);
 
+/*
+ * The kmap_atomic slots belong to one CPU and are only used with
+ * preemption disabled, so no other TLB needs to hear about a change.
+ * As kunmap_atomic leaves the mapping in place, a slot may still map
+ * the wanted page and then needs no flush at all.
+ */
+static void set_kmap_pte(unsigned long vaddr, pte_t pte)
+{
+	pte_t *ptep = pte_offset_kernel(top_pmd, vaddr);
+
+	if (pte_val(*ptep) == pte_val(pte))
+		return;
+	set_pte_ext(ptep, pte, 0);
+	cpu_flush_tlb_kernel_page(vaddr);
+}
+
 void *kmap_atomic(struct page *page)
 {
 	unsigned int idx;
@@ -47,15 +63,14 @@ void *kmap_atomic(struct page *page)
 	if (!PageHighMem(page))
 		return page_address(page);
 
-#ifdef CONFIG_DEBUG_HIGHMEM
 	/*
-	 * There is no cache coherency issue when non VIVT, so force the
-	 * dedicated kmap usage for better debugging purposes in that case.
+	 * There is no cache coherency issue when non VIVT, so use the
+	 * dedicated kmap slot then: reusing a kmap() mapping would take
+	 * the global kmap_lock with interrupts off for every call.
 	 */
 	if (!cache_is_vivt())
 		kmap = NULL;
 	else
-#endif
 		kmap = kmap_high_get(page);
 	if (kmap)
 		return kmap;
@@ -76,7 +91,7 @@ void *kmap_atomic(struct page *page)
 	 * in place, so the contained TLB flush ensures the TLB is updated
 	 * with the new mapping.
 	 */
-	set_top_pte(vaddr, mk_pte(page, kmap_prot));
+	set_kmap_pte(vaddr, mk_pte(page, kmap_prot));
 
 	return (void *)vaddr;
 }
@@ -121,7 +136,7 @@ void *kmap_atomic_pfn(unsigned long pfn)
 #ifdef CONFIG_DEBUG_HIGHMEM
 	BUG_ON(!pte_none(get_top_pte(vaddr)));
 #endif
-	set_top_pte(vaddr, pfn_pte(pfn, kmap_prot));
+	set_kmap_pte(vaddr, pfn_pte(pfn, kmap_prot));
 
 	return (void *)vaddr;
 }
@@ -0,0 +1,126 @@
+/*
+ * Per-queue request latency histograms
+ *
+ * Every completed file system request is accounted twice: once for the
+ * time it spent queued before the driver took it (queue latency) and
+ * once for the time the driver needed to complete it (service latency).
+ * Buckets are power of two microseconds, counted per cpu and per data
+ * direction, and exported through /sys/block/<dev>/queue/lat_hist.
+ * Writing anything to that file clears the counters.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/blkdev.h>
+#include <linux/percpu.h>
+#include <linux/bitops.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+
+#include "blk.h"
+
+/* bucket i counts latencies below 2^i usecs, the last one all the rest */
+#define BLK_LAT_HIST_BUCKETS	24
+
+struct blk_lat_hist {
+	unsigned long	queue[2][BLK_LAT_HIST_BUCKETS];
+	unsigned long	service[2][BLK_LAT_HIST_BUCKETS];
+};
+
+static inline int blk_lat_hist_bucket(u64 start, u64 end)
+{
+	u64 usecs;
+
+	/* sched_clock() is not synchronised across cpus */
+	if ((s64)(end - start) <= 0)
+		return 0;
+
+	usecs = div_u64(end - start, NSEC_PER_USEC);
+	return min_t(int, fls64(usecs), BLK_LAT_HIST_BUCKETS - 1);
+}
+
+void blk_lat_hist_done(struct request *rq)
+{
+	struct request_queue *q = rq->q;
+	struct blk_lat_hist *hist;
+	const int rw = rq_data_dir(rq);
+	u64 start, io_start, now;
+
+	if (!q->lat_hist)
+		return;
+
+	start = rq_start_time_ns(rq);
+	io_start = rq_io_start_time_ns(rq);
+	if (!io_start)
+		return;
+	now = sched_clock();
+
+	hist = get_cpu_ptr(q->lat_hist);
+	hist->queue[rw][blk_lat_hist_bucket(start, io_start)]++;
+	hist->service[rw][blk_lat_hist_bucket(io_start, now)]++;
+	put_cpu_ptr(q->lat_hist);
+}
+
+ssize_t blk_lat_hist_show(struct request_queue *q, char *page)
+{
+	unsigned long sum[4];
+	ssize_t len;
+	int i, cpu;
+
+	if (!q->lat_hist)
+		return -ENODEV;
+
+	len = sprintf(page, "%10s %12s %12s %12s %12s\n", "usecs",
+		      "read_queue", "read_svc", "write_queue", "write_svc");
+
+	for (i = 0; i < BLK_LAT_HIST_BUCKETS; i++) {
+		memset(sum, 0, sizeof(sum));
+		for_each_possible_cpu(cpu) {
+			struct blk_lat_hist *hist = per_cpu_ptr(q->lat_hist,
+								cpu);
+
+			sum[0] += hist->queue[READ][i];
+			sum[1] += hist->service[READ][i];
+			sum[2] += hist->queue[WRITE][i];
+			sum[3] += hist->service[WRITE][i];
+		}
+
+		if (i < BLK_LAT_HIST_BUCKETS - 1)
+			len += sprintf(page + len, "<%9llu", 1ULL << i);
+		else
+			len += sprintf(page + len, ">=%8llu", 1ULL << (i - 1));
+		len += sprintf(page + len, " %12lu %12lu %12lu %12lu\n",
+			       sum[0], sum[1], sum[2], sum[3]);
+	}
+
+	return len;
+}
+
+ssize_t blk_lat_hist_store(struct request_queue *q, const char *page,
+			   size_t count)
+{
+	int cpu;
+
+	if (!q->lat_hist)
+		return -ENODEV;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(q->lat_hist, cpu), 0,
+		       sizeof(struct blk_lat_hist));
+
+	return count;
+}
+
+int blk_lat_hist_init(struct request_queue *q)
+{
+	q->lat_hist = alloc_percpu(struct blk_lat_hist);
+	if (!q->lat_hist)
+		return -ENOMEM;
+
+	return 0;
+}
+
+void blk_lat_hist_exit(struct request_queue *q)
+{
+	free_percpu(q->lat_hist);
+	q->lat_hist = NULL;
+}
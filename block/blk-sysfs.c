@@ -387,6 +387,14 @@ static struct queue_sysfs_entry queue_random_entry = {
 	.store = queue_store_random,
 };
 
+#ifdef CONFIG_BLK_DEV_LAT_HIST
+static struct queue_sysfs_entry queue_lat_hist_entry = {
+	.attr = {.name = "lat_hist", .mode = S_IRUGO | S_IWUSR },
+	.show = blk_lat_hist_show,
+	.store = blk_lat_hist_store,
+};
+#endif
+
 static struct attribute *default_attrs[] = {
 	&queue_requests_entry.attr,
 	&queue_ra_entry.attr,
@@ -409,6 +417,9 @@ static struct attribute *default_attrs[] = {
 	&queue_rq_affinity_entry.attr,
 	&queue_iostats_entry.attr,
 	&queue_random_entry.attr,
+#ifdef CONFIG_BLK_DEV_LAT_HIST
+	&queue_lat_hist_entry.attr,
+#endif
 	NULL,
 };
 
@@ -496,6 +507,7 @@ static void blk_release_queue(struct kobject *kobj)
 
 	blk_throtl_release(q);
 	blk_trace_shutdown(q);
+	blk_lat_hist_exit(q);
 
 	bdi_destroy(&q->backing_dev_info);
 
@@ -234,4 +234,20 @@ static inline void blk_throtl_exit(struct request_queue *q) { }
 static inline void blk_throtl_release(struct request_queue *q) { }
 #endif /* CONFIG_BLK_DEV_THROTTLING */
 
+/*
+ * Internal latency histogram interface
+ */
+#ifdef CONFIG_BLK_DEV_LAT_HIST
+extern void blk_lat_hist_done(struct request *rq);
+extern ssize_t blk_lat_hist_show(struct request_queue *q, char *page);
+extern ssize_t blk_lat_hist_store(struct request_queue *q, const char *page,
+				  size_t count);
+extern int blk_lat_hist_init(struct request_queue *q);
+extern void blk_lat_hist_exit(struct request_queue *q);
+#else /* CONFIG_BLK_DEV_LAT_HIST */
+static inline void blk_lat_hist_done(struct request *rq) { }
+static inline int blk_lat_hist_init(struct request_queue *q) { return 0; }
+static inline void blk_lat_hist_exit(struct request_queue *q) { }
+#endif /* CONFIG_BLK_DEV_LAT_HIST */
+
 #endif /* BLK_INTERNAL_H */
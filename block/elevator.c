@@ -790,6 +790,19 @@ void elv_completed_request(struct request_queue *q, struct request *rq)
 	}
 }
 
+/*
+ * The driver can currently pack up to @nr_packed consecutive writes into
+ * a single command, 0 if it is not packing. Called with queue_lock held.
+ */
+void elv_pack_hint(struct request_queue *q, unsigned int nr_packed)
+{
+	struct elevator_queue *e = q->elevator;
+
+	if (e && e->type->ops.elevator_pack_hint_fn)
+		e->type->ops.elevator_pack_hint_fn(q, nr_packed);
+}
+EXPORT_SYMBOL(elv_pack_hint);
+
 #define to_elv(atr) container_of((atr), struct elv_fs_entry, attr)
 
 static ssize_t
@@ -2,6 +2,11 @@
  * IOPS based IO scheduler. Based on CFQ.
  *  Copyright (C) 2003 Jens Axboe <axboe@kernel.dk>
  *  Shaohua Li <shli@kernel.org>
+ *
+ * Scheduling is two-level: the busy group (blkio cgroup) with the least
+ * weighted vios is picked first, then the ioc with the least vios within
+ * that group. Without CONFIG_FIOPS_GROUP_IOSCHED all iocs share the root
+ * group.
  */
 #include <linux/module.h>
 #include <linux/slab.h>
@@ -12,6 +17,7 @@
 #include <linux/ioprio.h>
 #include <linux/blktrace_api.h>
 #include "blk.h"
+#include "blk-cgroup.h"
 
 #define VIOS_SCALE_SHIFT 10
 #define VIOS_SCALE (1 << VIOS_SCALE_SHIFT)
@@ -39,10 +45,30 @@ enum wl_prio_t {
 	FIOPS_PRIO_NR,
 };
 
+struct fiops_group {
+	struct fiops_rb_root service_tree[FIOPS_PRIO_NR];
+
+	struct rb_node rb_node;
+	u64 vios; /* key in fiopsd->group_tree, scaled by weight */
+	unsigned int weight;
+
+	unsigned int busy_queues;
+	int ref; /* iocs attached to the group */
+
+#ifdef CONFIG_FIOPS_GROUP_IOSCHED
+	struct blkio_cgroup *blkcg;
+	struct list_head group_node; /* on fiopsd->group_list */
+#endif
+};
+
 struct fiops_data {
 	struct request_queue *queue;
 
-	struct fiops_rb_root service_tree[FIOPS_PRIO_NR];
+	struct fiops_rb_root group_tree;
+	struct fiops_group root_group;
+#ifdef CONFIG_FIOPS_GROUP_IOSCHED
+	struct list_head group_list;
+#endif
 
 	unsigned int busy_queues;
 	unsigned int in_flight[2];
@@ -60,6 +86,7 @@ struct fiops_ioc {
 
 	unsigned int flags;
 	struct fiops_data *fiopsd;
+	struct fiops_group *group;
 	struct rb_node rb_node;
 	u64 vios; /* key in service_tree */
 	struct fiops_rb_root *service_tree;
@@ -74,7 +101,7 @@ struct fiops_ioc {
 	enum wl_prio_t wl_type;
 };
 
-#define ioc_service_tree(ioc) (&((ioc)->fiopsd->service_tree[(ioc)->wl_type]))
+#define ioc_service_tree(ioc) (&((ioc)->group->service_tree[(ioc)->wl_type]))
 #define RQ_CIC(rq)		icq_to_cic((rq)->elv.icq)
 
 enum ioc_state_flags {
@@ -179,8 +206,96 @@ static void fiops_update_min_vios(struct fiops_rb_root *service_tree)
 	service_tree->min_vios = max_vios(service_tree->min_vios, ioc->vios);
 }
 
+static struct fiops_group *fiops_group_first(struct fiops_rb_root *root)
+{
+	if (!root->count)
+		return NULL;
+
+	if (!root->left)
+		root->left = rb_first(&root->rb);
+
+	if (root->left)
+		return rb_entry(root->left, struct fiops_group, rb_node);
+
+	return NULL;
+}
+
+static void fiops_update_min_group_vios(struct fiops_rb_root *group_tree)
+{
+	struct fiops_group *group;
+
+	group = fiops_group_first(group_tree);
+	if (!group)
+		return;
+	group_tree->min_vios = max_vios(group_tree->min_vios, group->vios);
+}
+
+/*
+ * fiopsd->group_tree holds the groups that have busy iocs, sorted by
+ * their weighted vios. A group becoming busy starts from the tree's
+ * min_vios, so idle time is not banked as credit.
+ */
+static void fiops_group_tree_add(struct fiops_data *fiopsd,
+	struct fiops_group *group)
+{
+	struct fiops_rb_root *group_tree = &fiopsd->group_tree;
+	struct rb_node **p, *parent;
+	struct fiops_group *__group;
+	int left;
+
+	if (RB_EMPTY_NODE(&group->rb_node)) {
+		group->vios = max_vios(group_tree->min_vios, group->vios);
+#ifdef CONFIG_FIOPS_GROUP_IOSCHED
+		if (group->blkcg)
+			group->weight = ACCESS_ONCE(group->blkcg->weight);
+#endif
+	} else
+		fiops_rb_erase(&group->rb_node, group_tree);
+
+	left = 1;
+	parent = NULL;
+	p = &group_tree->rb.rb_node;
+	while (*p) {
+		parent = *p;
+		__group = rb_entry(parent, struct fiops_group, rb_node);
+
+		if (group->vios < __group->vios)
+			p = &(*p)->rb_left;
+		else {
+			p = &(*p)->rb_right;
+			left = 0;
+		}
+	}
+
+	if (left)
+		group_tree->left = &group->rb_node;
+
+	rb_link_node(&group->rb_node, parent, p);
+	rb_insert_color(&group->rb_node, &group_tree->rb);
+	group_tree->count++;
+
+	fiops_update_min_group_vios(group_tree);
+}
+
+static void fiops_group_tree_del(struct fiops_data *fiopsd,
+	struct fiops_group *group)
+{
+	if (!RB_EMPTY_NODE(&group->rb_node))
+		fiops_rb_erase(&group->rb_node, &fiopsd->group_tree);
+}
+
+static void fiops_init_group(struct fiops_group *group, unsigned int weight)
+{
+	int i;
+
+	for (i = IDLE_WORKLOAD; i <= RT_WORKLOAD; i++)
+		group->service_tree[i] = FIOPS_RB_ROOT;
+	RB_CLEAR_NODE(&group->rb_node);
+	group->weight = weight;
+}
+
 /*
- * The fiopsd->service_trees holds all pending fiops_ioc's that have
+ * The group->service_trees holds all pending fiops_ioc's that have
  * requests waiting to be processed. It is sorted in the order that
  * we will service the queues.
  */
@@ -265,6 +380,8 @@ static void fiops_add_ioc_rr(struct fiops_data *fiopsd, struct fiops_ioc *ioc)
 	fiops_mark_ioc_on_rr(ioc);
 
 	fiopsd->busy_queues++;
+	if (!ioc->group->busy_queues++)
+		fiops_group_tree_add(fiopsd, ioc->group);
 
 	fiops_resort_rr_list(fiopsd, ioc);
 }
@@ -285,6 +402,9 @@ static void fiops_del_ioc_rr(struct fiops_data *fiopsd, struct fiops_ioc *ioc)
 
 	BUG_ON(!fiopsd->busy_queues);
 	fiopsd->busy_queues--;
+	BUG_ON(!ioc->group->busy_queues);
+	if (!--ioc->group->busy_queues)
+		fiops_group_tree_del(fiopsd, ioc->group);
 }
 
 /*
@@ -356,20 +476,23 @@ static u64 fiops_dispatch_request(struct fiops_data *fiopsd,
 
 static int fiops_forced_dispatch(struct fiops_data *fiopsd)
 {
+	struct fiops_group *group;
 	struct fiops_ioc *ioc;
 	int dispatched = 0;
 	int i;
 
-	for (i = RT_WORKLOAD; i >= IDLE_WORKLOAD; i--) {
-		while (!RB_EMPTY_ROOT(&fiopsd->service_tree[i].rb)) {
-			ioc = fiops_rb_first(&fiopsd->service_tree[i]);
-
-			while (!list_empty(&ioc->fifo)) {
-				fiops_dispatch_request(fiopsd, ioc);
-				dispatched++;
+	while ((group = fiops_group_first(&fiopsd->group_tree))) {
+		for (i = RT_WORKLOAD; i >= IDLE_WORKLOAD; i--) {
+			while (!RB_EMPTY_ROOT(&group->service_tree[i].rb)) {
+				ioc = fiops_rb_first(&group->service_tree[i]);
+
+				while (!list_empty(&ioc->fifo)) {
+					fiops_dispatch_request(fiopsd, ioc);
+					dispatched++;
+				}
+				if (fiops_ioc_on_rr(ioc))
+					fiops_del_ioc_rr(fiopsd, ioc);
 			}
-			if (fiops_ioc_on_rr(ioc))
-				fiops_del_ioc_rr(fiopsd, ioc);
 		}
 	}
 	return dispatched;
@@ -377,14 +500,19 @@ static int fiops_forced_dispatch(struct fiops_data *fiopsd)
 
 static struct fiops_ioc *fiops_select_ioc(struct fiops_data *fiopsd)
 {
+	struct fiops_group *group;
 	struct fiops_ioc *ioc;
 	struct fiops_rb_root *service_tree = NULL;
 	int i;
 	struct request *rq;
 
+	group = fiops_group_first(&fiopsd->group_tree);
+	if (!group)
+		return NULL;
+
 	for (i = RT_WORKLOAD; i >= IDLE_WORKLOAD; i--) {
-		if (!RB_EMPTY_ROOT(&fiopsd->service_tree[i].rb)) {
-			service_tree = &fiopsd->service_tree[i];
+		if (!RB_EMPTY_ROOT(&group->service_tree[i].rb)) {
+			service_tree = &group->service_tree[i];
 			break;
 		}
 	}
@@ -401,7 +529,7 @@ static struct fiops_ioc *fiops_select_ioc(struct fiops_data *fiopsd)
 	 * to be starved, don't delay
 	 */
 	if (!rq_is_sync(rq) && fiopsd->in_flight[1] != 0 &&
-			service_tree->count == 1) {
+			service_tree->count == 1 && fiopsd->group_tree.count == 1) {
 		fiops_log_ioc(fiopsd, ioc,
 				"postpone async, in_flight async %d sync %d",
 				fiopsd->in_flight[0], fiopsd->in_flight[1]);
@@ -415,7 +543,11 @@ static void fiops_charge_vios(struct fiops_data *fiopsd,
 	struct fiops_ioc *ioc, u64 vios)
 {
 	struct fiops_rb_root *service_tree = ioc->service_tree;
+	struct fiops_group *group = ioc->group;
+
 	ioc->vios += vios;
+	/* Groups are charged in inverse proportion to their weight */
+	group->vios += div_u64(vios * BLKIO_WEIGHT_DEFAULT, group->weight);
 
 	fiops_log_ioc(fiopsd, ioc, "charge vios %lld, new vios %lld", vios, ioc->vios);
 
@@ -425,6 +557,8 @@ static void fiops_charge_vios(struct fiops_data *fiopsd,
 		fiops_resort_rr_list(fiopsd, ioc);
 
 	fiops_update_min_vios(service_tree);
+	if (group->busy_queues)
+		fiops_group_tree_add(fiopsd, group);
 }
 
 static int fiops_dispatch_requests(struct request_queue *q, int force)
@@ -446,6 +580,117 @@ static int fiops_dispatch_requests(struct request_queue *q, int force)
 	return 1;
 }
 
+static void fiops_put_group(struct fiops_data *fiopsd,
+	struct fiops_group *group)
+{
+	BUG_ON(group->ref <= 0);
+	if (--group->ref || group == &fiopsd->root_group)
+		return;
+
+	BUG_ON(group->busy_queues);
+#ifdef CONFIG_FIOPS_GROUP_IOSCHED
+	list_del(&group->group_node);
+	css_put(&group->blkcg->css);
+#endif
+	kfree(group);
+}
+
+/*
+ * Move the ioc to another group, keeping it busy if it was.
+ */
+static void fiops_move_ioc(struct fiops_data *fiopsd, struct fiops_ioc *ioc,
+	struct fiops_group *group)
+{
+	struct fiops_group *old_group = ioc->group;
+	bool on_rr = fiops_ioc_on_rr(ioc);
+
+	fiops_log_ioc(fiopsd, ioc, "move to group weight %u", group->weight);
+
+	if (on_rr)
+		fiops_del_ioc_rr(fiopsd, ioc);
+	group->ref++;
+	ioc->group = group;
+	if (on_rr)
+		fiops_add_ioc_rr(fiopsd, ioc);
+
+	fiops_put_group(fiopsd, old_group);
+}
+
+#ifdef CONFIG_FIOPS_GROUP_IOSCHED
+static struct fiops_group *fiops_find_group(struct fiops_data *fiopsd,
+	struct blkio_cgroup *blkcg)
+{
+	struct fiops_group *group;
+
+	if (blkcg == &blkio_root_cgroup)
+		return &fiopsd->root_group;
+
+	list_for_each_entry(group, &fiopsd->group_list, group_node)
+		if (group->blkcg == blkcg)
+			return group;
+
+	return NULL;
+}
+
+/*
+ * Called for each new request in the context of the submitting task.
+ * Tasks move between cgroups (e.g. Android's foreground and background
+ * groups), so the ioc follows the task's current blkio cgroup.
+ */
+static int fiops_set_request(struct request_queue *q, struct request *rq,
+	gfp_t gfp_mask)
+{
+	struct fiops_data *fiopsd = q->elevator->elevator_data;
+	struct fiops_ioc *ioc = RQ_CIC(rq);
+	struct fiops_group *group, *new_group = NULL;
+	struct blkio_cgroup *blkcg;
+	unsigned long flags;
+
+	if (!ioc)
+		return 0;
+
+	rcu_read_lock();
+	blkcg = task_blkio_cgroup(current);
+	if (!css_tryget(&blkcg->css))
+		blkcg = NULL;
+	rcu_read_unlock();
+	if (!blkcg)
+		return 0;
+
+	spin_lock_irqsave(q->queue_lock, flags);
+	if (ioc->group->blkcg == blkcg)
+		goto out;
+
+	group = fiops_find_group(fiopsd, blkcg);
+	if (!group) {
+		spin_unlock_irqrestore(q->queue_lock, flags);
+		new_group = kzalloc_node(sizeof(*new_group), gfp_mask,
+			q->node);
+		spin_lock_irqsave(q->queue_lock, flags);
+
+		group = fiops_find_group(fiopsd, blkcg);
+		if (!group && new_group) {
+			group = new_group;
+			new_group = NULL;
+			fiops_init_group(group, blkcg->weight);
+			/* the group keeps our reference to blkcg */
+			group->blkcg = blkcg;
+			blkcg = NULL;
+			list_add(&group->group_node, &fiopsd->group_list);
+		}
+	}
+	/* Without memory for a new group, stay in the current one */
+	if (group && group != ioc->group)
+		fiops_move_ioc(fiopsd, ioc, group);
+out:
+	spin_unlock_irqrestore(q->queue_lock, flags);
+	kfree(new_group);
+	if (blkcg)
+		css_put(&blkcg->css);
+	return 0;
+}
+#endif
+
 static void fiops_init_prio_data(struct fiops_ioc *cic)
 {
 	struct task_struct *tsk = current;
@@ -600,6 +845,11 @@ static void fiops_exit_queue(struct elevator_queue *e)
 
 	cancel_work_sync(&fiopsd->unplug_work);
 
+	/* All iocs are gone by now and took their groups with them */
+#ifdef CONFIG_FIOPS_GROUP_IOSCHED
+	WARN_ON(!list_empty(&fiopsd->group_list));
+#endif
+
 	kfree(fiopsd);
 }
 
@@ -617,7 +867,6 @@ static void fiops_kick_queue(struct work_struct *work)
 static void *fiops_init_queue(struct request_queue *q)
 {
 	struct fiops_data *fiopsd;
-	int i;
 
 	fiopsd = kzalloc_node(sizeof(*fiopsd), GFP_KERNEL, q->node);
 	if (!fiopsd)
@@ -625,8 +874,13 @@ static void *fiops_init_queue(struct request_queue *q)
 
 	fiopsd->queue = q;
 
-	for (i = IDLE_WORKLOAD; i <= RT_WORKLOAD; i++)
-		fiopsd->service_tree[i] = FIOPS_RB_ROOT;
+	fiopsd->group_tree = FIOPS_RB_ROOT;
+	fiops_init_group(&fiopsd->root_group, BLKIO_WEIGHT_DEFAULT);
+	fiopsd->root_group.ref = 1;
+#ifdef CONFIG_FIOPS_GROUP_IOSCHED
+	fiopsd->root_group.blkcg = &blkio_root_cgroup;
+	INIT_LIST_HEAD(&fiopsd->group_list);
+#endif
 
 	INIT_WORK(&fiopsd->unplug_work, fiops_kick_queue);
 
@@ -648,11 +902,24 @@ static void fiops_init_icq(struct io_cq *icq)
 	ioc->sort_list = RB_ROOT;
 
 	ioc->fiopsd = fiopsd;
+	ioc->group = &fiopsd->root_group;
+	ioc->group->ref++;
 
 	ioc->pid = current->pid;
 	fiops_mark_ioc_prio_changed(ioc);
 }
 
+static void fiops_exit_icq(struct io_cq *icq)
+{
+	struct fiops_data *fiopsd = icq->q->elevator->elevator_data;
+	struct fiops_ioc *ioc = icq_to_cic(icq);
+
+	/* Requests may still be queued, finish them in the root group */
+	if (ioc->group != &fiopsd->root_group)
+		fiops_move_ioc(fiopsd, ioc, &fiopsd->root_group);
+	fiops_put_group(fiopsd, ioc->group);
+}
+
 /*
  * sysfs parts below -->
  */
@@ -725,6 +992,10 @@ static struct elevator_type iosched_fiops = {
 		.elevator_former_req_fn =	elv_rb_former_request,
 		.elevator_latter_req_fn =	elv_rb_latter_request,
 		.elevator_init_icq_fn =		fiops_init_icq,
+		.elevator_exit_icq_fn =		fiops_exit_icq,
+#ifdef CONFIG_FIOPS_GROUP_IOSCHED
+		.elevator_set_req_fn =		fiops_set_request,
+#endif
 		.elevator_init_fn =		fiops_init_queue,
 		.elevator_exit_fn =		fiops_exit_queue,
 	},
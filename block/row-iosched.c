@@ -84,6 +84,9 @@ static const int queue_quantum[] = {
 #define ROW_IDLE_TIME_MSEC 5	/* msec */
 #define ROW_READ_FREQ_MSEC 20	/* msec */
 
+/* Max time async writes are held back while reads are active */
+#define ROW_WR_HOLD_MSEC 200	/* msec */
+
 /**
  * struct rowq_idling_data -  parameters for idling on the queue
  * @last_insert_time:	time the last request was inserted
@@ -147,6 +150,13 @@ struct idling_data {
  *			scheduler, nr_reqs[1] holds the number of all WRITE
  *			requests in scheduler
  * @cycle_flags:	used for marking unserved queueus
+ * @pack_size:		number of writes the driver currently packs into
+ *			one command (0 if not packing), as reported
+ *			through elevator_pack_hint_fn
+ * @last_read_time:	time (jiffies) the last READ request was inserted
+ * @wr_hold_expire:	max time (jiffies) async writes are held back
+ *			while reads are active, 0 to never hold them
+ * @wr_hold_work:	restarts dispatching once held writes may go
  *
  */
 struct row_data {
@@ -163,6 +173,11 @@ struct row_data {
 	unsigned int			nr_reqs[2];
 
 	unsigned int			cycle_flags;
+
+	unsigned int			pack_size;
+	unsigned long			last_read_time;
+	unsigned long			wr_hold_expire;
+	struct delayed_work		wr_hold_work;
 };
 
 #define RQ_ROWQ(rq) ((struct row_queue *) ((rq)->elv.priv[0]))
@@ -221,6 +236,55 @@ static void kick_queue(struct work_struct *work)
 	}
 }
 
+/*
+ * kick_held_writes() - Wake up device driver queue thread for held writes
+ * @work:	pointer to struct work_struct
+ *
+ * Async writes may have been held back while reads were active. Run the
+ * queue again so they get dispatched once reads went idle or the hold
+ * expired.
+ *
+ */
+static void kick_held_writes(struct work_struct *work)
+{
+	struct delayed_work *hold_work = to_delayed_work(work);
+	struct row_data *rd =
+		container_of(hold_work, struct row_data, wr_hold_work);
+
+	row_log(rd->dispatch_queue, "Kicking held writes");
+	spin_lock_irq(rd->dispatch_queue->queue_lock);
+	__blk_run_queue(rd->dispatch_queue);
+	spin_unlock_irq(rd->dispatch_queue->queue_lock);
+}
+
+/*
+ * row_rowq_held() - Check whether a queue is held back
+ * @rd:		pointer to struct row_data
+ * @qnum:	queue to check
+ *
+ * The async write queue is held back while reads are active: there are
+ * READ requests in the scheduler or one was inserted during the last
+ * read_idle_freq msec. The oldest write is never held longer than
+ * wr_hold_expire.
+ */
+static bool row_rowq_held(struct row_data *rd, enum row_queue_prio qnum)
+{
+	struct list_head *fifo = &rd->row_queues[qnum].rqueue.fifo;
+
+	if (qnum != ROWQ_PRIO_REG_WRITE || !rd->wr_hold_expire ||
+	    list_empty(fifo))
+		return false;
+
+	if (!rd->nr_reqs[READ] &&
+	    time_after(jiffies, rd->last_read_time +
+		       msecs_to_jiffies(rd->read_idle.freq)))
+		return false;
+
+	return time_before(jiffies,
+			   rq_fifo_time(rq_entry_fifo(fifo->next)) +
+			   rd->wr_hold_expire);
+}
+
 /*
  * row_restart_disp_cycle() - Restart the dispatch cycle
  * @rd:	pointer to struct row_data
@@ -265,6 +329,8 @@ static void row_add_request(struct request_queue *q,
 	list_add_tail(&rq->queuelist, &rqueue->fifo);
 	rd->nr_reqs[rq_data_dir(rq)]++;
 	rq_set_fifo_time(rq, jiffies); /* for statistics*/
+	if (rq_data_dir(rq) == READ)
+		rd->last_read_time = jiffies;
 
 	if (queue_idling_enabled[rqueue->prio]) {
 		if (delayed_work_pending(&rd->read_idle.idle_work))
@@ -365,20 +431,29 @@ static void row_remove_request(struct request_queue *q,
  * @rd:	pointer to struct row_data
  *
  * This function moves the next request to dispatch from
- * rd->curr_queue to the dispatch queue
+ * rd->curr_queue to the dispatch queue. While the driver is packing
+ * writes, a whole group of up to pack_size writes is moved at once so
+ * the driver can fetch a full packed command.
  *
  */
 static void row_dispatch_insert(struct row_data *rd)
 {
+	struct row_queue *rqueue = &rd->row_queues[rd->curr_queue].rqueue;
+	unsigned int nr = 0;
 	struct request *rq;
 
-	rq = rq_entry_fifo(rd->row_queues[rd->curr_queue].rqueue.fifo.next);
-	row_remove_request(rd->dispatch_queue, rq);
-	elv_dispatch_add_tail(rd->dispatch_queue, rq);
-	rd->row_queues[rd->curr_queue].rqueue.nr_dispatched++;
+	do {
+		rq = rq_entry_fifo(rqueue->fifo.next);
+		row_remove_request(rd->dispatch_queue, rq);
+		elv_dispatch_add_tail(rd->dispatch_queue, rq);
+		rqueue->nr_dispatched++;
+		nr++;
+	} while (rq_data_dir(rq) == WRITE && nr < rd->pack_size &&
+		 !list_empty(&rqueue->fifo));
 	row_clear_rowq_unserved(rd, rd->curr_queue);
-	row_log_rowq(rd, rd->curr_queue, " Dispatched request nr_disp = %d",
-		     rd->row_queues[rd->curr_queue].rqueue.nr_dispatched);
+	row_log_rowq(rd, rd->curr_queue,
+		     " Dispatched %u request(s) nr_disp = %d", nr,
+		     rqueue->nr_dispatched);
 }
 
 /*
@@ -386,10 +461,11 @@ static void row_dispatch_insert(struct row_data *rd)
  * @rd:	pointer to struct row_data
  *
  * Updates rd->curr_queue. Returns 1 if there are requests to
- * dispatch, 0 if there are no requests in scheduler
+ * dispatch, 0 if there are no requests in scheduler or only held
+ * ones (see row_rowq_held())
  *
  */
-static int row_choose_queue(struct row_data *rd)
+static int row_choose_queue(struct row_data *rd, int force)
 {
 	int prev_curr_queue = rd->curr_queue;
 
@@ -404,13 +480,24 @@ static int row_choose_queue(struct row_data *rd)
 	 * Loop over all queues to find the next queue that is not empty.
 	 * Stop when you get back to curr_queue
 	 */
-	while (list_empty(&rd->row_queues[rd->curr_queue].rqueue.fifo)
+	while ((list_empty(&rd->row_queues[rd->curr_queue].rqueue.fifo) ||
+		(!force && row_rowq_held(rd, rd->curr_queue)))
 	       && rd->curr_queue != prev_curr_queue) {
 		/* Mark rqueue as unserved */
 		row_mark_rowq_unserved(rd, rd->curr_queue);
 		row_get_next_queue(rd);
 	}
 
+	if (list_empty(&rd->row_queues[rd->curr_queue].rqueue.fifo))
+		return 0;
+	if (!force && row_rowq_held(rd, rd->curr_queue)) {
+		queue_delayed_work(rd->read_idle.idle_workqueue,
+				   &rd->wr_hold_work,
+				   msecs_to_jiffies(rd->read_idle.freq));
+		row_log_rowq(rd, rd->curr_queue, "Holding writes");
+		return 0;
+	}
+
 	return 1;
 }
 
@@ -436,7 +523,8 @@ static int row_dispatch_requests(struct request_queue *q, int force)
 	 */
 	for (i = 0; i < currq; i++) {
 		if (row_rowq_unserved(rd, i) &&
-		    !list_empty(&rd->row_queues[i].rqueue.fifo)) {
+		    !list_empty(&rd->row_queues[i].rqueue.fifo) &&
+		    (force || !row_rowq_held(rd, i))) {
 			row_log_rowq(rd, currq,
 				" Preemting for unserved rowq%d", i);
 			rd->curr_queue = i;
@@ -450,7 +538,14 @@ static int row_dispatch_requests(struct request_queue *q, int force)
 	    rd->row_queues[currq].disp_quantum) {
 		rd->row_queues[currq].rqueue.nr_dispatched = 0;
 		row_log_rowq(rd, currq, "Expiring rqueue");
-		ret = row_choose_queue(rd);
+		ret = row_choose_queue(rd, force);
+		if (ret)
+			row_dispatch_insert(rd);
+		goto done;
+	}
+
+	if (!force && row_rowq_held(rd, currq)) {
+		ret = row_choose_queue(rd, force);
 		if (ret)
 			row_dispatch_insert(rd);
 		goto done;
@@ -487,7 +582,7 @@ static int row_dispatch_requests(struct request_queue *q, int force)
 		} else {
 			row_log_rowq(rd, currq,
 				     "Currq empty. Choose next queue");
-			ret = row_choose_queue(rd);
+			ret = row_choose_queue(rd, force);
 			if (!ret)
 				goto done;
 		}
@@ -544,6 +639,8 @@ static void *row_init_queue(struct request_queue *q)
 	if (!rdata->read_idle.idle_workqueue)
 		panic("Failed to create idle workqueue\n");
 	INIT_DELAYED_WORK(&rdata->read_idle.idle_work, kick_queue);
+	INIT_DELAYED_WORK(&rdata->wr_hold_work, kick_held_writes);
+	rdata->wr_hold_expire = msecs_to_jiffies(ROW_WR_HOLD_MSEC);
 
 	rdata->curr_queue = ROWQ_PRIO_HIGH_READ;
 	rdata->dispatch_queue = q;
@@ -567,6 +664,7 @@ static void row_exit_queue(struct elevator_queue *e)
 		BUG_ON(!list_empty(&rd->row_queues[i].rqueue.fifo));
 	(void)cancel_delayed_work_sync(&rd->read_idle.idle_work);
 	BUG_ON(delayed_work_pending(&rd->read_idle.idle_work));
+	(void)cancel_delayed_work_sync(&rd->wr_hold_work);
 	destroy_workqueue(rd->read_idle.idle_workqueue);
 	kfree(rd);
 }
@@ -587,6 +685,19 @@ static void row_merged_requests(struct request_queue *q, struct request *rq,
 	rqueue->rdata->nr_reqs[rq_data_dir(rq)]--;
 }
 
+/*
+ * row_pack_hint() - Called when the driver changes write packing
+ * @q:		requests queue
+ * @nr_packed:	writes the driver packs into one command, 0 if none
+ */
+static void row_pack_hint(struct request_queue *q, unsigned int nr_packed)
+{
+	struct row_data *rd = q->elevator->elevator_data;
+
+	rd->pack_size = nr_packed;
+	row_log(q, "pack size %u", nr_packed);
+}
+
 /*
  * get_queue_type() - Get queue type for a given request
  *
@@ -670,6 +781,7 @@ SHOW_FUNCTION(row_lp_swrite_quantum_show,
 	rowd->row_queues[ROWQ_PRIO_LOW_SWRITE].disp_quantum, 0);
 SHOW_FUNCTION(row_read_idle_show, rowd->read_idle.idle_time, 1);
 SHOW_FUNCTION(row_read_idle_freq_show, rowd->read_idle.freq, 0);
+SHOW_FUNCTION(row_wr_hold_expire_show, rowd->wr_hold_expire, 1);
 #undef SHOW_FUNCTION
 
 #define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
@@ -710,6 +822,7 @@ STORE_FUNCTION(row_lp_swrite_quantum_store,
 			1, INT_MAX, 1);
 STORE_FUNCTION(row_read_idle_store, &rowd->read_idle.idle_time, 1, INT_MAX, 1);
 STORE_FUNCTION(row_read_idle_freq_store, &rowd->read_idle.freq, 1, INT_MAX, 0);
+STORE_FUNCTION(row_wr_hold_expire_store, &rowd->wr_hold_expire, 0, INT_MAX, 1);
 
 #undef STORE_FUNCTION
 
@@ -727,6 +840,7 @@ static struct elv_fs_entry row_attrs[] = {
 	ROW_ATTR(lp_swrite_quantum),
 	ROW_ATTR(read_idle),
 	ROW_ATTR(read_idle_freq),
+	ROW_ATTR(wr_hold_expire),
 	__ATTR_NULL
 };
 
@@ -737,6 +851,7 @@ static struct elevator_type iosched_row = {
 		.elevator_add_req_fn		= row_add_request,
 		.elevator_reinsert_req_fn	= row_reinsert_req,
 		.elevator_is_urgent_fn		= row_urgent_pending,
+		.elevator_pack_hint_fn		= row_pack_hint,
 		.elevator_former_req_fn		= elv_rb_former_request,
 		.elevator_latter_req_fn		= elv_rb_latter_request,
 		.elevator_set_req_fn		= row_set_request,
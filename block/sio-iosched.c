@@ -12,6 +12,11 @@
  * Asynchronous and synchronous requests are not treated separately, but
  * we relay on deadlines to ensure fairness.
  *
+ * Optionally (sort_batch), requests are also dispatched in batches
+ * following sector order, up to batch_kb per batch, so that the device
+ * sees long runs of sequential I/O. A batch is cut short as soon as a
+ * sync read expires.
+ *
  */
 #include <linux/blkdev.h>
 #include <linux/elevator.h>
@@ -32,22 +37,69 @@ static const int async_write_expire = 16 * HZ;	/* ditto for async, these limits
 static const int writes_starved = 2;		/* max times reads can starve a write */
 static const int fifo_batch     = 2;		/* # of sequential requests treated as one
 						   by the above parameters. For throughput. */
+static const int sort_batch     = 0;		/* dispatch batches in sector order. */
+static const int batch_kb       = 512;		/* max size of a sector-sorted batch. */
 
 /* Elevator data */
 struct sio_data {
 	/* Request queues */
 	struct list_head fifo_list[2][2];
+	struct rb_root sort_list[2];
 
 	/* Attributes */
 	unsigned int batched;
 	unsigned int starved;
+	struct request *next_rq;	/* next request of the sorted batch */
+	unsigned int batch_left;	/* bytes left in the sorted batch */
 
 	/* Settings */
 	int fifo_expire[2][2];
 	int fifo_batch;
 	int writes_starved;
+	int sort_batch;
+	int batch_kb;
 };
 
+static void
+sio_remove_request(struct sio_data *sd, struct request *rq)
+{
+	/* Keep the batch going from the request that follows rq */
+	if (sd->next_rq == rq)
+		sd->next_rq = elv_rb_latter_request(rq->q, rq);
+
+	rq_fifo_clear(rq);
+	elv_rb_del(&sd->sort_list[rq_data_dir(rq)], rq);
+}
+
+static int
+sio_merge(struct request_queue *q, struct request **req, struct bio *bio)
+{
+	struct sio_data *sd = q->elevator->elevator_data;
+	sector_t sector = bio->bi_sector + bio_sectors(bio);
+	struct request *__rq;
+
+	/* Check for front merge */
+	__rq = elv_rb_find(&sd->sort_list[bio_data_dir(bio)], sector);
+	if (__rq && elv_rq_merge_ok(__rq, bio)) {
+		*req = __rq;
+		return ELEVATOR_FRONT_MERGE;
+	}
+
+	return ELEVATOR_NO_MERGE;
+}
+
+static void
+sio_merged_request(struct request_queue *q, struct request *req, int type)
+{
+	struct sio_data *sd = q->elevator->elevator_data;
+
+	/* A front merge changes the start sector, reposition request */
+	if (type == ELEVATOR_FRONT_MERGE) {
+		elv_rb_del(&sd->sort_list[rq_data_dir(req)], req);
+		elv_rb_add(&sd->sort_list[rq_data_dir(req)], req);
+	}
+}
+
 static void
 sio_merged_requests(struct request_queue *q, struct request *rq,
 		    struct request *next)
@@ -64,7 +116,7 @@ sio_merged_requests(struct request_queue *q, struct request *rq,
 	}
 
 	/* Delete next request */
-	rq_fifo_clear(next);
+	sio_remove_request(q->elevator->elevator_data, next);
 }
 
 static void
@@ -80,6 +132,7 @@ sio_add_request(struct request_queue *q, struct request *rq)
 	 */
 	rq_set_fifo_time(rq, jiffies + sd->fifo_expire[sync][data_dir]);
 	list_add_tail(&rq->queuelist, &sd->fifo_list[sync][data_dir]);
+	elv_rb_add(&sd->sort_list[data_dir], rq);
 }
 
 #if LINUX_VERSION_CODE <= KERNEL_VERSION(2,6,38)
@@ -167,11 +220,17 @@ sio_choose_request(struct sio_data *sd, int data_dir)
 static inline void
 sio_dispatch_request(struct sio_data *sd, struct request *rq)
 {
+	unsigned int bytes = blk_rq_bytes(rq);
+
 	/*
-	 * Remove the request from the fifo list
+	 * Remove the request from the fifo list and the sort tree,
 	 * and dispatch it.
 	 */
-	rq_fifo_clear(rq);
+	if (rq != sd->next_rq || !sd->batch_left)
+		sd->batch_left = sd->batch_kb << 10;
+	sd->batch_left -= min(bytes, sd->batch_left);
+	sd->next_rq = rq;
+	sio_remove_request(sd, rq);
 	elv_dispatch_add_tail(rq->q, rq);
 
 	sd->batched++;
@@ -189,11 +248,19 @@ sio_dispatch_requests(struct request_queue *q, int force)
 	struct request *rq = NULL;
 	int data_dir = READ;
 
+	/*
+	 * Continue a sector-sorted batch while it has budget left,
+	 * unless a sync read is waiting past its deadline.
+	 */
+	if (sd->sort_batch && sd->next_rq && sd->batch_left &&
+	    !sio_expired_request(sd, SYNC, READ))
+		rq = sd->next_rq;
+
 	/*
 	 * Retrieve any expired request after a batch of
 	 * sequential requests.
 	 */
-	if (sd->batched > sd->fifo_batch) {
+	if (!rq && sd->batched > sd->fifo_batch) {
 		sd->batched = 0;
 		rq = sio_choose_expired_request(sd);
 	}
@@ -252,19 +319,27 @@ sio_init_queue(struct request_queue *q)
 	if (!sd)
 		return NULL;
 
-	/* Initialize fifo lists */
+	/* Initialize fifo lists and sort trees */
 	INIT_LIST_HEAD(&sd->fifo_list[SYNC][READ]);
 	INIT_LIST_HEAD(&sd->fifo_list[SYNC][WRITE]);
 	INIT_LIST_HEAD(&sd->fifo_list[ASYNC][READ]);
 	INIT_LIST_HEAD(&sd->fifo_list[ASYNC][WRITE]);
+	sd->sort_list[READ] = RB_ROOT;
+	sd->sort_list[WRITE] = RB_ROOT;
 
 	/* Initialize data */
 	sd->batched = 0;
+	sd->starved = 0;
+	sd->next_rq = NULL;
+	sd->batch_left = 0;
 	sd->fifo_expire[SYNC][READ] = sync_read_expire;
 	sd->fifo_expire[SYNC][WRITE] = sync_write_expire;
 	sd->fifo_expire[ASYNC][READ] = async_read_expire;
 	sd->fifo_expire[ASYNC][WRITE] = async_write_expire;
 	sd->fifo_batch = fifo_batch;
+	sd->writes_starved = writes_starved;
+	sd->sort_batch = sort_batch;
+	sd->batch_kb = batch_kb;
 
 	return sd;
 }
@@ -317,6 +392,8 @@ SHOW_FUNCTION(sio_async_read_expire_show, sd->fifo_expire[ASYNC][READ], 1);
 SHOW_FUNCTION(sio_async_write_expire_show, sd->fifo_expire[ASYNC][WRITE], 1);
 SHOW_FUNCTION(sio_fifo_batch_show, sd->fifo_batch, 0);
 SHOW_FUNCTION(sio_writes_starved_show, sd->writes_starved, 0);
+SHOW_FUNCTION(sio_sort_batch_show, sd->sort_batch, 0);
+SHOW_FUNCTION(sio_batch_kb_show, sd->batch_kb, 0);
 #undef SHOW_FUNCTION
 
 #define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
@@ -341,6 +418,8 @@ STORE_FUNCTION(sio_async_read_expire_store, &sd->fifo_expire[ASYNC][READ], 0, IN
 STORE_FUNCTION(sio_async_write_expire_store, &sd->fifo_expire[ASYNC][WRITE], 0, INT_MAX, 1);
 STORE_FUNCTION(sio_fifo_batch_store, &sd->fifo_batch, 0, INT_MAX, 0);
 STORE_FUNCTION(sio_writes_starved_store, &sd->writes_starved, 0, INT_MAX, 0);
+STORE_FUNCTION(sio_sort_batch_store, &sd->sort_batch, 0, 1, 0);
+STORE_FUNCTION(sio_batch_kb_store, &sd->batch_kb, 4, 65536, 0);
 #undef STORE_FUNCTION
 
 #define DD_ATTR(name) \
@@ -354,11 +433,15 @@ static struct elv_fs_entry sio_attrs[] = {
 	DD_ATTR(async_write_expire),
 	DD_ATTR(fifo_batch),
 	DD_ATTR(writes_starved),
+	DD_ATTR(sort_batch),
+	DD_ATTR(batch_kb),
 	__ATTR_NULL
 };
 
 static struct elevator_type iosched_sio = {
 	.ops = {
+		.elevator_merge_fn		= sio_merge,
+		.elevator_merged_fn		= sio_merged_request,
 		.elevator_merge_req_fn		= sio_merged_requests,
 		.elevator_dispatch_fn		= sio_dispatch_requests,
 		.elevator_add_req_fn		= sio_add_request,
@@ -396,4 +479,4 @@ module_exit(sio_exit);
 MODULE_AUTHOR("Miguel Boton");
 MODULE_LICENSE("GPL");
 MODULE_DESCRIPTION("Simple IO scheduler");
-MODULE_VERSION("0.2");
+MODULE_VERSION("0.3");
@@ -0,0 +1,585 @@
+/* Copyright (c) 2012, Code Aurora Forum. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Block device benchmark, the measuring counterpart of the test I/O
+ * scheduler.  A workload is run from inside the kernel against a range of
+ * a block device and its IOPS, throughput and completion latency
+ * percentiles are reported.  The I/Os go through whatever I/O scheduler
+ * the device queue has, so the same run can be repeated after switching
+ * it in sysfs to compare schedulers or card firmware.
+ *
+ * The range starting at start_sector is overwritten by the write
+ * workloads and discarded by the discard one.  Everything is set up and
+ * triggered through debugfs:
+ *   echo /dev/block/mmcblk0 > test-iosched-bench/device
+ *   echo <sector> > test-iosched-bench/start_sector
+ *   echo rand_read > test-iosched-bench/run
+ *   cat test-iosched-bench/result
+ */
+
+#include <linux/blkdev.h>
+#include <linux/bio.h>
+#include <linux/debugfs.h>
+#include <linux/elevator.h>
+#include <linux/fs.h>
+#include <linux/init.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/random.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+
+#define MODULE_NAME "test-iosched-bench"
+#define BENCH_MAX_IO_KB 256
+#define BENCH_MAX_PAGES (BENCH_MAX_IO_KB * 1024 / PAGE_SIZE)
+#define BENCH_MAX_IOS 65536
+#define BENCH_MAX_DEPTH 64
+#define BENCH_RESULT_SIZE 1024
+
+#define bench_pr_info(fmt, args...) pr_info("%s: "fmt"\n", MODULE_NAME, args)
+#define bench_pr_err(fmt, args...) pr_err("%s: "fmt"\n", MODULE_NAME, args)
+
+enum bench_workload {
+	BENCH_SEQ_READ,
+	BENCH_SEQ_WRITE,
+	BENCH_RAND_READ,
+	BENCH_RAND_WRITE,
+	BENCH_MIXED,
+	BENCH_FSYNC,
+	BENCH_DISCARD,
+	BENCH_NR_WORKLOADS,
+};
+
+/*
+ * @io_kb is the default I/O size.  mixed does random 4K reads under a
+ * sequential write stream of @io_kb, fsync writes @io_kb and flushes it
+ * out to the media before it completes, like an fsync of a small file.
+ */
+static const struct {
+	const char *name;
+	unsigned int io_kb;
+} bench_workloads[BENCH_NR_WORKLOADS] = {
+	[BENCH_SEQ_READ] = { "seq_read", 128 },
+	[BENCH_SEQ_WRITE] = { "seq_write", 128 },
+	[BENCH_RAND_READ] = { "rand_read", 4 },
+	[BENCH_RAND_WRITE] = { "rand_write", 4 },
+	[BENCH_MIXED] = { "mixed", 128 },
+	[BENCH_FSYNC] = { "fsync", 4 },
+	[BENCH_DISCARD] = { "discard", 1024 },
+};
+
+/* one in this many I/Os of the mixed workload is a read */
+#define BENCH_MIXED_READ_RATIO 4
+
+/**
+ * struct bench_stats - the completions of one direction
+ * @lat_us:	completion latency of each I/O
+ * @nr:		number of completed I/Os
+ * @io_size:	size of each I/O in bytes
+ */
+struct bench_stats {
+	u32 *lat_us;
+	atomic_t nr;
+	unsigned int io_size;
+};
+
+/**
+ * struct bench_io - an I/O in flight
+ * @bd:		the benchmark
+ * @st:		the statistics it is accounted to
+ * @start:	submission time
+ */
+struct bench_io {
+	struct bench_data *bd;
+	struct bench_stats *st;
+	ktime_t start;
+};
+
+/**
+ * struct bench_data - benchmark parameters, state and last result
+ * @lock:	serializes runs and protects the parameters and @result
+ * @device:	path of the block device to run against
+ * @start_sector: first sector of the range that may be accessed
+ * @size_mb:	size of the range
+ * @io_kb:	I/O size, 0 for the workload default
+ * @depth:	number of I/Os kept in flight
+ * @nr_ios:	number of I/Os of a run
+ * @bdev:	the opened device while running
+ * @pages:	data of all the I/Os, its contents do not matter
+ * @inflight:	I/Os submitted and not completed yet
+ * @wait:	woken on each completion
+ * @error:	the first error an I/O completed with
+ * @seq_sector:	next sector of the sequential stream, from @start_sector
+ * @stats:	per direction statistics, discards count as writes
+ * @result:	report of the last run
+ */
+struct bench_data {
+	struct dentry *debug_root;
+	struct mutex lock;
+
+	char device[64];
+	u32 start_sector;
+	u32 size_mb;
+	u32 io_kb;
+	u32 depth;
+	u32 nr_ios;
+
+	struct block_device *bdev;
+	struct page *pages[BENCH_MAX_PAGES];
+	atomic_t inflight;
+	wait_queue_head_t wait;
+	int error;
+	u32 seq_sector;
+	struct bench_stats stats[2];
+
+	char result[BENCH_RESULT_SIZE];
+};
+
+static struct bench_data bench = {
+	.size_mb = 64,
+	.depth = 4,
+	.nr_ios = 4096,
+};
+
+static void bench_end_io(struct bio *bio, int err)
+{
+	struct bench_io *io = bio->bi_private;
+	struct bench_data *bd = io->bd;
+	struct bench_stats *st = io->st;
+	s64 us = ktime_us_delta(ktime_get(), io->start);
+	int i;
+
+	i = atomic_inc_return(&st->nr) - 1;
+	st->lat_us[i] = us > 0 ? min_t(s64, us, U32_MAX) : 0;
+	if (err && !bd->error)
+		bd->error = err;
+
+	kfree(io);
+	bio_put(bio);
+	atomic_dec(&bd->inflight);
+	wake_up(&bd->wait);
+}
+
+static int bench_submit(struct bench_data *bd, int rw, sector_t sector,
+			unsigned int bytes)
+{
+	struct bench_stats *st = &bd->stats[rw & WRITE];
+	struct bench_io *io;
+	struct bio *bio;
+	int i, nr_pages = (rw & REQ_DISCARD) ? 0 : bytes >> PAGE_SHIFT;
+
+	io = kmalloc(sizeof(*io), GFP_KERNEL);
+	if (!io)
+		return -ENOMEM;
+	bio = bio_alloc(GFP_KERNEL, nr_pages);
+	if (!bio) {
+		kfree(io);
+		return -ENOMEM;
+	}
+
+	bio->bi_bdev = bd->bdev;
+	bio->bi_sector = sector;
+	bio->bi_end_io = bench_end_io;
+	bio->bi_private = io;
+	if (rw & REQ_DISCARD)
+		bio->bi_size = bytes;
+	for (i = 0; i < nr_pages; i++) {
+		if (bio_add_page(bio, bd->pages[i], PAGE_SIZE, 0) !=
+		    PAGE_SIZE) {
+			bench_pr_err("%s: device takes no %u byte I/Os",
+				     __func__, bytes);
+			bio_put(bio);
+			kfree(io);
+			return -EINVAL;
+		}
+	}
+
+	io->bd = bd;
+	io->st = st;
+	st->io_size = bytes;
+	atomic_inc(&bd->inflight);
+	io->start = ktime_get();
+	submit_bio(rw, bio);
+	return 0;
+}
+
+/* pick one of the I/Os of @sectors that fit in the range */
+static sector_t bench_rand_sector(struct bench_data *bd, u32 nr_sectors,
+				  unsigned int sectors)
+{
+	u32 slot = random32() % (nr_sectors / sectors);
+
+	return bd->start_sector + (sector_t)slot * sectors;
+}
+
+static sector_t bench_seq_sector(struct bench_data *bd, u32 nr_sectors,
+				 unsigned int sectors)
+{
+	sector_t sector;
+
+	if (bd->seq_sector + sectors > nr_sectors)
+		bd->seq_sector = 0;
+	sector = bd->start_sector + bd->seq_sector;
+	bd->seq_sector += sectors;
+	return sector;
+}
+
+static int bench_issue(struct bench_data *bd, int workload, int i,
+		       u32 nr_sectors, unsigned int bytes)
+{
+	unsigned int sectors = bytes >> 9;
+
+	switch (workload) {
+	case BENCH_SEQ_READ:
+		return bench_submit(bd, READ,
+			bench_seq_sector(bd, nr_sectors, sectors), bytes);
+	case BENCH_SEQ_WRITE:
+		return bench_submit(bd, WRITE,
+			bench_seq_sector(bd, nr_sectors, sectors), bytes);
+	case BENCH_RAND_READ:
+		return bench_submit(bd, READ,
+			bench_rand_sector(bd, nr_sectors, sectors), bytes);
+	case BENCH_RAND_WRITE:
+		return bench_submit(bd, WRITE,
+			bench_rand_sector(bd, nr_sectors, sectors), bytes);
+	case BENCH_MIXED:
+		if (i % BENCH_MIXED_READ_RATIO == BENCH_MIXED_READ_RATIO - 1)
+			return bench_submit(bd, READ | REQ_SYNC,
+				bench_rand_sector(bd, nr_sectors, 8),
+				4096);
+		return bench_submit(bd, WRITE,
+			bench_seq_sector(bd, nr_sectors, sectors), bytes);
+	case BENCH_FSYNC:
+		return bench_submit(bd, WRITE_FLUSH_FUA,
+			bench_seq_sector(bd, nr_sectors, sectors), bytes);
+	case BENCH_DISCARD:
+		return bench_submit(bd, REQ_WRITE | REQ_DISCARD,
+			bench_seq_sector(bd, nr_sectors, sectors), bytes);
+	}
+	return -EINVAL;
+}
+
+static int bench_cmp_u32(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* latency below which @permille of the I/Os completed */
+static u32 bench_percentile(struct bench_stats *st, int nr,
+			    unsigned int permille)
+{
+	return st->lat_us[(nr - 1) * permille / 1000];
+}
+
+static int bench_report(char *buf, int size, const char *label,
+			struct bench_stats *st, s64 us)
+{
+	int nr = atomic_read(&st->nr);
+	u64 bytes = (u64)nr * st->io_size;
+
+	if (!nr || us <= 0)
+		return 0;
+
+	sort(st->lat_us, nr, sizeof(u32), bench_cmp_u32, NULL);
+	return scnprintf(buf, size,
+		"%s: ios %d size %u iops %llu KBps %llu\n"
+		"%s: lat_us p50 %u p90 %u p99 %u p99.9 %u max %u\n",
+		label, nr, st->io_size,
+		div64_u64((u64)nr * USEC_PER_SEC, us),
+		div64_u64(bytes * USEC_PER_SEC, (u64)us * 1024),
+		label, bench_percentile(st, nr, 500),
+		bench_percentile(st, nr, 900), bench_percentile(st, nr, 990),
+		bench_percentile(st, nr, 999), st->lat_us[nr - 1]);
+}
+
+static void bench_free(struct bench_data *bd)
+{
+	int i;
+
+	for (i = 0; i < BENCH_MAX_PAGES; i++) {
+		if (bd->pages[i])
+			__free_page(bd->pages[i]);
+		bd->pages[i] = NULL;
+	}
+	for (i = 0; i < ARRAY_SIZE(bd->stats); i++) {
+		vfree(bd->stats[i].lat_us);
+		bd->stats[i].lat_us = NULL;
+	}
+}
+
+static int bench_alloc(struct bench_data *bd, unsigned int nr_ios)
+{
+	int i;
+
+	for (i = 0; i < BENCH_MAX_PAGES; i++) {
+		bd->pages[i] = alloc_page(GFP_KERNEL);
+		if (!bd->pages[i])
+			goto err;
+		memset(page_address(bd->pages[i]), 0x5a, PAGE_SIZE);
+	}
+	for (i = 0; i < ARRAY_SIZE(bd->stats); i++) {
+		bd->stats[i].lat_us = vmalloc(nr_ios * sizeof(u32));
+		if (!bd->stats[i].lat_us)
+			goto err;
+		atomic_set(&bd->stats[i].nr, 0);
+		bd->stats[i].io_size = 0;
+	}
+	return 0;
+err:
+	bench_free(bd);
+	return -ENOMEM;
+}
+
+/* Run @workload against the device with the current parameters */
+static int bench_run(struct bench_data *bd, int workload)
+{
+	struct request_queue *q;
+	const char *sched = "none";
+	unsigned int nr_ios, depth, bytes;
+	sector_t dev_sectors;
+	u32 nr_sectors;
+	ktime_t start;
+	s64 us;
+	int i, len, ret;
+
+	if (!bd->start_sector) {
+		bench_pr_err("%s: Invalid start sector", __func__);
+		return -EINVAL;
+	}
+
+	bd->bdev = blkdev_get_by_path(bd->device, FMODE_READ | FMODE_WRITE,
+				      NULL);
+	if (IS_ERR(bd->bdev)) {
+		ret = PTR_ERR(bd->bdev);
+		bd->bdev = NULL;
+		bench_pr_err("%s: cannot open %s: %d", __func__, bd->device,
+			     ret);
+		return ret;
+	}
+	q = bdev_get_queue(bd->bdev);
+
+	bytes = (bd->io_kb ? bd->io_kb : bench_workloads[workload].io_kb) *
+		1024;
+	if (workload == BENCH_DISCARD) {
+		if (!blk_queue_discard(q)) {
+			ret = -EOPNOTSUPP;
+			goto out;
+		}
+		bytes = min_t(unsigned int, bytes,
+			      q->limits.max_discard_sectors << 9);
+	} else {
+		bytes = min_t(unsigned int, bytes, BENCH_MAX_IO_KB * 1024);
+	}
+	bytes &= ~(PAGE_SIZE - 1);
+
+	dev_sectors = i_size_read(bd->bdev->bd_inode) >> 9;
+	if (bd->start_sector >= dev_sectors) {
+		ret = -EINVAL;
+		goto out;
+	}
+	nr_sectors = min_t(u64, (u64)bd->size_mb << 11,
+			   min_t(u64, dev_sectors - bd->start_sector, U32_MAX));
+	if (!bytes || nr_sectors < bytes >> 9) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	nr_ios = clamp_t(unsigned int, bd->nr_ios, 1, BENCH_MAX_IOS);
+	depth = clamp_t(unsigned int, bd->depth, 1, BENCH_MAX_DEPTH);
+	ret = bench_alloc(bd, nr_ios);
+	if (ret)
+		goto out;
+
+	if (q->elevator)
+		sched = q->elevator->type->elevator_name;
+	bench_pr_info("%s: %s on %s (%s), %u I/Os of %u bytes, depth %u",
+		      __func__, bench_workloads[workload].name, bd->device,
+		      sched, nr_ios, bytes, depth);
+
+	bd->error = 0;
+	bd->seq_sector = 0;
+	atomic_set(&bd->inflight, 0);
+	start = ktime_get();
+	for (i = 0; i < nr_ios && !bd->error; i++) {
+		wait_event(bd->wait, atomic_read(&bd->inflight) < depth);
+		ret = bench_issue(bd, workload, i, nr_sectors, bytes);
+		if (ret)
+			break;
+	}
+	wait_event(bd->wait, !atomic_read(&bd->inflight));
+	us = ktime_us_delta(ktime_get(), start);
+	if (!ret)
+		ret = bd->error;
+
+	len = scnprintf(bd->result, sizeof(bd->result),
+			"workload %s device %s scheduler %s depth %u "
+			"time_us %lld result %d\n",
+			bench_workloads[workload].name, bd->device, sched,
+			depth, us, ret);
+	len += bench_report(bd->result + len, sizeof(bd->result) - len,
+			    "read", &bd->stats[READ], us);
+	len += bench_report(bd->result + len, sizeof(bd->result) - len,
+			    workload == BENCH_DISCARD ? "discard" : "write",
+			    &bd->stats[WRITE], us);
+	pr_info("%s: %s", MODULE_NAME, bd->result);
+
+	bench_free(bd);
+out:
+	blkdev_put(bd->bdev, FMODE_READ | FMODE_WRITE);
+	bd->bdev = NULL;
+	return ret;
+}
+
+static ssize_t bench_run_write(struct file *file, const char __user *buf,
+			       size_t count, loff_t *ppos)
+{
+	char name[16];
+	size_t len = min(count, sizeof(name) - 1);
+	int i, ret;
+
+	if (copy_from_user(name, buf, len))
+		return -EFAULT;
+	name[len] = '\0';
+	strim(name);
+
+	for (i = 0; i < BENCH_NR_WORKLOADS; i++)
+		if (!strcmp(name, bench_workloads[i].name))
+			break;
+	if (i == BENCH_NR_WORKLOADS)
+		return -EINVAL;
+
+	mutex_lock(&bench.lock);
+	ret = bench_run(&bench, i);
+	mutex_unlock(&bench.lock);
+
+	return ret < 0 ? ret : count;
+}
+
+static ssize_t bench_run_read(struct file *file, char __user *buf,
+			      size_t count, loff_t *ppos)
+{
+	char names[128];
+	int i, len = 0;
+
+	for (i = 0; i < BENCH_NR_WORKLOADS; i++)
+		len += scnprintf(names + len, sizeof(names) - len, "%s%s",
+				 i ? " " : "", bench_workloads[i].name);
+	len += scnprintf(names + len, sizeof(names) - len, "\n");
+	return simple_read_from_buffer(buf, count, ppos, names, len);
+}
+
+static const struct file_operations bench_run_fops = {
+	.open = simple_open,
+	.read = bench_run_read,
+	.write = bench_run_write,
+};
+
+static ssize_t bench_result_read(struct file *file, char __user *buf,
+				 size_t count, loff_t *ppos)
+{
+	ssize_t ret;
+
+	mutex_lock(&bench.lock);
+	ret = simple_read_from_buffer(buf, count, ppos, bench.result,
+				      strlen(bench.result));
+	mutex_unlock(&bench.lock);
+	return ret;
+}
+
+static const struct file_operations bench_result_fops = {
+	.open = simple_open,
+	.read = bench_result_read,
+};
+
+static ssize_t bench_device_write(struct file *file, const char __user *buf,
+				  size_t count, loff_t *ppos)
+{
+	size_t len = min(count, sizeof(bench.device) - 1);
+
+	mutex_lock(&bench.lock);
+	if (copy_from_user(bench.device, buf, len)) {
+		mutex_unlock(&bench.lock);
+		return -EFAULT;
+	}
+	bench.device[len] = '\0';
+	strim(bench.device);
+	mutex_unlock(&bench.lock);
+	return count;
+}
+
+static ssize_t bench_device_read(struct file *file, char __user *buf,
+				 size_t count, loff_t *ppos)
+{
+	char device[sizeof(bench.device) + 1];
+	int len;
+
+	mutex_lock(&bench.lock);
+	len = scnprintf(device, sizeof(device), "%s\n", bench.device);
+	mutex_unlock(&bench.lock);
+	return simple_read_from_buffer(buf, count, ppos, device, len);
+}
+
+static const struct file_operations bench_device_fops = {
+	.open = simple_open,
+	.read = bench_device_read,
+	.write = bench_device_write,
+};
+
+static int __init bench_init(void)
+{
+	struct dentry *root;
+
+	mutex_init(&bench.lock);
+	init_waitqueue_head(&bench.wait);
+
+	root = debugfs_create_dir(MODULE_NAME, NULL);
+	if (!root)
+		return -ENOENT;
+	bench.debug_root = root;
+
+	if (!debugfs_create_file("device", S_IRUGO | S_IWUSR, root, NULL,
+				 &bench_device_fops) ||
+	    !debugfs_create_u32("start_sector", S_IRUGO | S_IWUSR, root,
+				&bench.start_sector) ||
+	    !debugfs_create_u32("size_mb", S_IRUGO | S_IWUSR, root,
+				&bench.size_mb) ||
+	    !debugfs_create_u32("io_kb", S_IRUGO | S_IWUSR, root,
+				&bench.io_kb) ||
+	    !debugfs_create_u32("depth", S_IRUGO | S_IWUSR, root,
+				&bench.depth) ||
+	    !debugfs_create_u32("nr_ios", S_IRUGO | S_IWUSR, root,
+				&bench.nr_ios) ||
+	    !debugfs_create_file("run", S_IRUGO | S_IWUSR, root, NULL,
+				 &bench_run_fops) ||
+	    !debugfs_create_file("result", S_IRUGO, root, NULL,
+				 &bench_result_fops)) {
+		debugfs_remove_recursive(root);
+		return -ENOENT;
+	}
+	return 0;
+}
+
+static void __exit bench_exit(void)
+{
+	debugfs_remove_recursive(bench.debug_root);
+}
+
+module_init(bench_init);
+module_exit(bench_exit);
+
+MODULE_LICENSE("GPL v2");
+MODULE_DESCRIPTION("Block device benchmark");
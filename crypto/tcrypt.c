@@ -26,13 +26,19 @@
 #include <linux/err.h>
 #include <linux/init.h>
 #include <linux/gfp.h>
+#include <linux/cpu.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 #include <linux/module.h>
 #include <linux/scatterlist.h>
+#include <linux/slab.h>
 #include <linux/string.h>
 #include <linux/moduleparam.h>
 #include <linux/jiffies.h>
 #include <linux/timex.h>
 #include <linux/interrupt.h>
+#include <linux/wait.h>
 #include "tcrypt.h"
 #include "internal.h"
 
@@ -52,6 +58,12 @@
  */
 static unsigned int sec;
 
+/*
+ * Used by test_mb_speed()
+ */
+static unsigned int mb_threads;
+static unsigned int mb_depth = 8;
+
 static char *alg = NULL;
 static u32 type;
 static u32 mask;
@@ -920,6 +932,378 @@ out:
 	crypto_free_ablkcipher(tfm);
 }
 
+/*
+ * Multi-threaded async speed tests: one thread per online CPU, up to
+ * mb_threads, keeps mb_depth requests of its own tfm in flight for sec
+ * seconds.  Every implementation registered for the algorithm is run
+ * by its driver name, so software, assembler and hardware providers
+ * can be compared with the CPUs and the engine queues all busy.
+ */
+#define TCRYPT_MB_MAX_PROVIDERS	8
+#define TCRYPT_MB_MAX_KEY	64
+
+struct tcrypt_mb_thread;
+
+struct tcrypt_mb_req {
+	struct tcrypt_mb_thread *t;
+	struct list_head list;
+	struct ablkcipher_request *creq;
+	struct ahash_request *hreq;
+	struct scatterlist sg;
+	void *buf;
+	u8 iv[32];
+	u8 result[64];
+	ktime_t start;
+};
+
+struct tcrypt_mb_thread {
+	struct completion *start;
+	struct completion done;
+	const char *driver;
+	int hash;
+	int enc;
+	unsigned int klen;
+	unsigned int blen;
+	unsigned int sec;
+
+	spinlock_t lock;	/* protects idle and the results */
+	wait_queue_head_t wait;
+	struct list_head idle;	/* requests not in flight */
+	unsigned long ops;
+	u64 lat_ns;
+	u64 lat_max_ns;
+	int ret;
+};
+
+static void tcrypt_mb_finish(struct tcrypt_mb_req *r, int err)
+{
+	struct tcrypt_mb_thread *t = r->t;
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), r->start));
+	unsigned long flags;
+
+	spin_lock_irqsave(&t->lock, flags);
+	if (err) {
+		if (!t->ret)
+			t->ret = err;
+	} else {
+		t->ops++;
+		t->lat_ns += ns;
+		t->lat_max_ns = max(t->lat_max_ns, ns);
+	}
+	list_add_tail(&r->list, &t->idle);
+	/* under the lock, the thread may be gone once it is dropped */
+	wake_up(&t->wait);
+	spin_unlock_irqrestore(&t->lock, flags);
+}
+
+static void tcrypt_mb_complete(struct crypto_async_request *areq, int err)
+{
+	if (err == -EINPROGRESS)
+		return;
+	tcrypt_mb_finish(areq->data, err);
+}
+
+static void tcrypt_mb_submit(struct tcrypt_mb_thread *t,
+			     struct tcrypt_mb_req *r)
+{
+	int ret;
+
+	r->start = ktime_get();
+	if (t->hash)
+		ret = crypto_ahash_digest(r->hreq);
+	else if (t->enc)
+		ret = crypto_ablkcipher_encrypt(r->creq);
+	else
+		ret = crypto_ablkcipher_decrypt(r->creq);
+
+	if (ret != -EINPROGRESS && ret != -EBUSY)
+		tcrypt_mb_finish(r, ret);
+}
+
+static struct tcrypt_mb_req *tcrypt_mb_get_idle(struct tcrypt_mb_thread *t)
+{
+	struct tcrypt_mb_req *r = NULL;
+	unsigned long flags;
+
+	spin_lock_irqsave(&t->lock, flags);
+	if (!list_empty(&t->idle)) {
+		r = list_first_entry(&t->idle, struct tcrypt_mb_req, list);
+		list_del(&r->list);
+	}
+	spin_unlock_irqrestore(&t->lock, flags);
+	return r;
+}
+
+static int tcrypt_mb_setup(struct tcrypt_mb_thread *t,
+			   struct tcrypt_mb_req *reqs, void *tfm)
+{
+	struct tcrypt_mb_req *r;
+	unsigned int i;
+
+	for (i = 0; i < mb_depth; i++) {
+		r = &reqs[i];
+		r->t = t;
+		r->buf = kmalloc(t->blen, GFP_KERNEL);
+		if (!r->buf)
+			return -ENOMEM;
+		memset(r->buf, 0xff, t->blen);
+		memset(r->iv, 0xff, sizeof(r->iv));
+		sg_init_one(&r->sg, r->buf, t->blen);
+
+		if (t->hash) {
+			r->hreq = ahash_request_alloc(tfm, GFP_KERNEL);
+			if (!r->hreq)
+				return -ENOMEM;
+			ahash_request_set_callback(r->hreq,
+						   CRYPTO_TFM_REQ_MAY_BACKLOG,
+						   tcrypt_mb_complete, r);
+			ahash_request_set_crypt(r->hreq, &r->sg, r->result,
+						t->blen);
+		} else {
+			r->creq = ablkcipher_request_alloc(tfm, GFP_KERNEL);
+			if (!r->creq)
+				return -ENOMEM;
+			ablkcipher_request_set_callback(r->creq,
+						CRYPTO_TFM_REQ_MAY_BACKLOG,
+						tcrypt_mb_complete, r);
+			ablkcipher_request_set_crypt(r->creq, &r->sg, &r->sg,
+						     t->blen, r->iv);
+		}
+		list_add_tail(&r->list, &t->idle);
+	}
+	return 0;
+}
+
+static int tcrypt_mb_thread_fn(void *data)
+{
+	struct tcrypt_mb_thread *t = data;
+	struct tcrypt_mb_req *reqs, *r;
+	struct crypto_ablkcipher *ctfm = NULL;
+	struct crypto_ahash *htfm = NULL;
+	u8 key[TCRYPT_MB_MAX_KEY];
+	unsigned long end;
+	unsigned int i, retired = 0;
+	int ret = -ENOMEM;
+
+	reqs = kcalloc(mb_depth, sizeof(*reqs), GFP_KERNEL);
+	if (!reqs)
+		goto out;
+
+	if (t->hash) {
+		htfm = crypto_alloc_ahash(t->driver, 0, 0);
+		ret = IS_ERR(htfm) ? PTR_ERR(htfm) : 0;
+		if (ret) {
+			htfm = NULL;
+			goto out;
+		}
+		ret = -EINVAL;
+		if (crypto_ahash_digestsize(htfm) > sizeof(reqs->result))
+			goto out;
+	} else {
+		ctfm = crypto_alloc_ablkcipher(t->driver, 0, 0);
+		ret = IS_ERR(ctfm) ? PTR_ERR(ctfm) : 0;
+		if (ret) {
+			ctfm = NULL;
+			goto out;
+		}
+		ret = -EINVAL;
+		if (crypto_ablkcipher_ivsize(ctfm) > sizeof(reqs->iv))
+			goto out;
+		memset(key, 0xff, sizeof(key));
+		ret = crypto_ablkcipher_setkey(ctfm, key, t->klen);
+		if (ret)
+			goto out;
+	}
+
+	ret = tcrypt_mb_setup(t, reqs, t->hash ? (void *)htfm : (void *)ctfm);
+	if (ret)
+		goto out;
+
+	wait_for_completion(t->start);
+	end = jiffies + t->sec * HZ;
+	while (retired < mb_depth) {
+		wait_event(t->wait, (r = tcrypt_mb_get_idle(t)) != NULL);
+		if (t->ret || !time_before(jiffies, end))
+			retired++;
+		else
+			tcrypt_mb_submit(t, r);
+	}
+
+out:
+	if (ret)
+		t->ret = ret;
+	for (i = 0; reqs && i < mb_depth; i++) {
+		ablkcipher_request_free(reqs[i].creq);
+		ahash_request_free(reqs[i].hreq);
+		kfree(reqs[i].buf);
+	}
+	kfree(reqs);
+	if (ctfm)
+		crypto_free_ablkcipher(ctfm);
+	if (htfm)
+		crypto_free_ahash(htfm);
+	complete(&t->done);
+	return 0;
+}
+
+static void test_mb_run(const char *driver, int hash, int enc,
+			unsigned int sec, unsigned int klen, unsigned int blen)
+{
+	struct tcrypt_mb_thread *threads, *t;
+	struct task_struct *task;
+	DECLARE_COMPLETION_ONSTACK(start);
+	unsigned int nr = 0, i;
+	unsigned long ops = 0;
+	u64 lat_ns = 0, lat_max_ns = 0;
+	int cpu, ret = 0;
+
+	get_online_cpus();
+	threads = kcalloc(num_online_cpus(), sizeof(*threads), GFP_KERNEL);
+	if (!threads) {
+		put_online_cpus();
+		return;
+	}
+	for_each_online_cpu(cpu) {
+		if (mb_threads && nr == mb_threads)
+			break;
+		t = &threads[nr];
+		t->start = &start;
+		init_completion(&t->done);
+		t->driver = driver;
+		t->hash = hash;
+		t->enc = enc;
+		t->klen = klen;
+		t->blen = blen;
+		t->sec = sec;
+		spin_lock_init(&t->lock);
+		init_waitqueue_head(&t->wait);
+		INIT_LIST_HEAD(&t->idle);
+
+		task = kthread_create(tcrypt_mb_thread_fn, t, "tcrypt/%d", cpu);
+		if (IS_ERR(task))
+			break;
+		kthread_bind(task, cpu);
+		wake_up_process(task);
+		nr++;
+	}
+	put_online_cpus();
+
+	complete_all(&start);
+	for (i = 0; i < nr; i++) {
+		t = &threads[i];
+		wait_for_completion(&t->done);
+		ops += t->ops;
+		lat_ns += t->lat_ns;
+		lat_max_ns = max(lat_max_ns, t->lat_max_ns);
+		if (t->ret && !ret)
+			ret = t->ret;
+	}
+	kfree(threads);
+
+	if (ret) {
+		pr_info("%s %u byte blocks: failed %d\n", driver, blen, ret);
+		return;
+	}
+	if (hash)
+		pr_info("%s %u byte blocks, %u threads x %u: ", driver, blen,
+			nr, mb_depth);
+	else
+		pr_info("%s %s %u bit key, %u byte blocks, %u threads x %u: ",
+			driver, enc ? "encryption" : "decryption", klen * 8,
+			blen, nr, mb_depth);
+	pr_cont("%lu ops/s, %llu KB/s, latency avg %llu max %llu us\n",
+		ops / sec, div_u64((u64)ops * blen, sec * 1024),
+		ops ? div64_u64(lat_ns, (u64)ops * NSEC_PER_USEC) : 0,
+		div_u64(lat_max_ns, NSEC_PER_USEC));
+}
+
+/* names of the implementations of @name registered right now */
+static int tcrypt_mb_find(const char *name,
+			  char (*drivers)[CRYPTO_MAX_ALG_NAME], int *nr)
+{
+	struct crypto_alg *q;
+
+	down_read(&crypto_alg_sem);
+	list_for_each_entry(q, &crypto_alg_list, cra_list) {
+		if (*nr == TCRYPT_MB_MAX_PROVIDERS)
+			break;
+		if (crypto_is_larval(q) || (q->cra_flags & CRYPTO_ALG_DEAD) ||
+		    strcmp(q->cra_name, name))
+			continue;
+		strlcpy(drivers[(*nr)++], q->cra_driver_name,
+			CRYPTO_MAX_ALG_NAME);
+	}
+	up_read(&crypto_alg_sem);
+	return *nr;
+}
+
+/*
+ * Templates are only instantiated for the implementation a lookup
+ * picks, so "mode(cipher)" is first looked up for every provider of
+ * the cipher.
+ */
+static int tcrypt_mb_providers(const char *name,
+			       char (*drivers)[CRYPTO_MAX_ALG_NAME])
+{
+	char inner[CRYPTO_MAX_ALG_NAME], instance[CRYPTO_MAX_ALG_NAME];
+	const char *open = strchr(name, '(');
+	size_t len = strlen(name);
+	int nr = 0, i;
+
+	crypto_has_alg(name, 0, 0);
+	if (open && len > open - name + 2 && name[len - 1] == ')' &&
+	    len < CRYPTO_MAX_ALG_NAME) {
+		strlcpy(inner, open + 1, len - (open - name) - 1);
+		tcrypt_mb_find(inner, drivers, &nr);
+		for (i = 0; i < nr; i++) {
+			if (snprintf(instance, sizeof(instance), "%.*s(%s)",
+				     (int)(open - name), name, drivers[i]) <
+			    sizeof(instance))
+				crypto_has_alg(instance, 0, 0);
+		}
+		nr = 0;
+	}
+	return tcrypt_mb_find(name, drivers, &nr);
+}
+
+static void test_mb_speed(const char *algo, int hash, int enc,
+			  unsigned int sec, u8 *keysize)
+{
+	static u8 no_key[] = { 0, 0 };
+	char (*drivers)[CRYPTO_MAX_ALG_NAME];
+	u8 *klen;
+	u32 *b_size;
+	int nr, i;
+
+	if (!sec)
+		sec = 1;
+	if (!mb_depth)
+		mb_depth = 1;
+	if (hash)
+		keysize = no_key;
+
+	drivers = kcalloc(TCRYPT_MB_MAX_PROVIDERS, CRYPTO_MAX_ALG_NAME,
+			  GFP_KERNEL);
+	if (!drivers)
+		return;
+	nr = tcrypt_mb_providers(algo, drivers);
+
+	pr_info("\ntesting multi-threaded speed of async %s%s, %d providers\n",
+		algo, hash ? "" : (enc ? " encryption" : " decryption"), nr);
+	for (i = 0; i < nr; i++) {
+		klen = keysize;
+		do {
+			if (*klen > TCRYPT_MB_MAX_KEY)
+				break;
+			for (b_size = block_sizes; *b_size; b_size++)
+				test_mb_run(drivers[i], hash, enc, sec, *klen,
+					    *b_size);
+			klen++;
+		} while (*klen);
+	}
+	kfree(drivers);
+}
+
 static void test_available(void)
 {
 	char **name = check;
@@ -1563,6 +1947,30 @@ static int do_test(int m)
 				   speed_template_32_64);
 		break;
 
+	case 600:
+		test_mb_speed("ecb(aes)", 0, ENCRYPT, sec,
+			      speed_template_16_32);
+		test_mb_speed("ecb(aes)", 0, DECRYPT, sec,
+			      speed_template_16_32);
+		test_mb_speed("cbc(aes)", 0, ENCRYPT, sec,
+			      speed_template_16_32);
+		test_mb_speed("cbc(aes)", 0, DECRYPT, sec,
+			      speed_template_16_32);
+		test_mb_speed("ctr(aes)", 0, ENCRYPT, sec,
+			      speed_template_16_32);
+		test_mb_speed("ctr(aes)", 0, DECRYPT, sec,
+			      speed_template_16_32);
+		test_mb_speed("xts(aes)", 0, ENCRYPT, sec,
+			      speed_template_32_64);
+		test_mb_speed("xts(aes)", 0, DECRYPT, sec,
+			      speed_template_32_64);
+		break;
+
+	case 601:
+		test_mb_speed("sha1", 1, 0, sec, NULL);
+		test_mb_speed("sha256", 1, 0, sec, NULL);
+		break;
+
 	case 1000:
 		test_available();
 		break;
@@ -1631,6 +2039,12 @@ module_param(mode, int, 0);
 module_param(sec, uint, 0);
 MODULE_PARM_DESC(sec, "Length in seconds of speed tests "
 		      "(defaults to zero which uses CPU cycles instead)");
+module_param(mb_threads, uint, 0);
+MODULE_PARM_DESC(mb_threads, "Threads of the multi-threaded speed tests, "
+			     "one per online CPU (defaults to all)");
+module_param(mb_depth, uint, 0);
+MODULE_PARM_DESC(mb_depth, "Requests each thread of the multi-threaded "
+			   "speed tests keeps in flight (defaults to 8)");
 
 MODULE_LICENSE("GPL");
 MODULE_DESCRIPTION("Quick & dirty crypto testing module");
@@ -29,6 +29,9 @@
 #include <linux/major.h>
 #include <linux/regulator/consumer.h>
 #include <linux/ion.h>
+#include <linux/slab.h>
+#include <linux/sync.h>
+#include <linux/sw_sync.h>
 #ifdef CONFIG_MSM_BUS_SCALING
 #include <mach/msm_bus.h>
 #include <mach/msm_bus_board.h>
@@ -90,6 +93,9 @@
 #define INVALID_SESSION -1
 #define VERSION_KEY_MASK 0xFFFFFF00
 #define MAX_DOWNSCALE_RATIO 3
+#define WAIT_FENCE_TIMEOUT 800
+/* imported buffers kept per session, enough for triple buffering */
+#define MAX_CACHED_BUFS 8
 
 #define ROTATOR_REVISION_V0		0
 #define ROTATOR_REVISION_V1		1
@@ -128,6 +134,45 @@ struct msm_rotator_fd_info {
 	struct list_head list;
 };
 
+struct msm_rotator_buf {
+	struct ion_handle *ihdl;
+	int domain;
+	unsigned int secure;
+};
+
+/* fence and buffer state of a session, cleared when it is freed */
+struct msm_rotator_session {
+	struct sw_sync_timeline *timeline;
+	u32 timeline_value;
+	int armed;		/* next rotate is queued, see BUFFER_SYNC */
+	struct sync_fence *acq_fen;
+	struct msm_rotator_buf bufs[MAX_CACHED_BUFS];
+	int next_buf;
+};
+
+/*
+ * One rotation with its buffers imported and checked.  Queued jobs are
+ * run in order from commit_work, with the session parameters they were
+ * submitted with.
+ */
+struct msm_rotator_commit {
+	struct list_head list;
+	int s;
+	int rc;			/* set if it must not reach the hardware */
+	int cancelled;		/* session freed while waiting for acq_fen */
+	struct sync_fence *acq_fen;
+	struct msm_rotator_img_info img_info;
+	unsigned int in_paddr, out_paddr;
+	unsigned int in_chroma_paddr, out_chroma_paddr;
+	unsigned int in_chroma2_paddr;
+	struct file *srcp0_file, *dstp0_file;
+	struct file *srcp1_file, *dstp1_file;
+	struct ion_handle *srcp0_ihdl, *dstp0_ihdl;
+	struct ion_handle *srcp1_ihdl, *dstp1_ihdl;
+	int ps0_need;
+	unsigned int src_flags;
+};
+
 struct msm_rotator_dev {
 	void __iomem *io_base;
 	int irq;
@@ -154,6 +199,11 @@ struct msm_rotator_dev {
 	int imem_owner;
 	wait_queue_head_t wq;
 	struct ion_client *client;
+	struct msm_rotator_session session[MAX_SESSIONS];
+	struct workqueue_struct *commit_wq;
+	struct work_struct commit_work;
+	struct list_head commit_list;
+	struct msm_rotator_commit *commit_waiting;
 	#ifdef CONFIG_MSM_BUS_SCALING
 	uint32_t bus_client_handle;
 	#endif
@@ -909,174 +959,270 @@ static void put_img(struct file *p_file, struct ion_handle *p_ihdl,
 	}
 #endif
 }
-static int msm_rotator_do_rotate(unsigned long arg)
+
+#ifdef CONFIG_MSM_MULTIMEDIA_USE_ION
+/*
+ * Keep another import of a buffer used by session @s, so its handle and
+ * IOMMU mapping stay around for the next jobs instead of being torn down
+ * and set up again every time.  Jobs still take and drop their own
+ * reference; the oldest buffer is let go when the cache is full.
+ */
+static void msm_rotator_cache_buf(int s, struct msmfb_data *fbd,
+	struct ion_handle *ihdl, int domain, unsigned int secure)
 {
-	unsigned int status, format;
-	struct msm_rotator_data_info info;
-	unsigned int in_paddr, out_paddr;
-	unsigned long src_len, dst_len;
-	int use_imem = 0, rc = 0, s;
-	struct file *srcp0_file = NULL, *dstp0_file = NULL;
-	struct file *srcp1_file = NULL, *dstp1_file = NULL;
-	struct ion_handle *srcp0_ihdl = NULL, *dstp0_ihdl = NULL;
-	struct ion_handle *srcp1_ihdl = NULL, *dstp1_ihdl = NULL;
-	int ps0_need, p_need;
-	unsigned int in_chroma_paddr = 0, out_chroma_paddr = 0;
-	unsigned int in_chroma2_paddr = 0;
-	struct msm_rotator_img_info *img_info;
-	struct msm_rotator_mem_planes src_planes, dst_planes;
+	struct msm_rotator_session *sess = &msm_rotator_dev->session[s];
+	struct msm_rotator_buf *buf;
+	unsigned long start, len;
+	int i;
 
-	if (copy_from_user(&info, (void __user *)arg, sizeof(info)))
-		return -EFAULT;
+	if (IS_ERR_OR_NULL(ihdl))
+		return;
+	for (i = 0; i < MAX_CACHED_BUFS; i++)
+		if (sess->bufs[i].ihdl == ihdl &&
+		    sess->bufs[i].domain == domain)
+			return;
+
+	buf = &sess->bufs[sess->next_buf];
+	sess->next_buf = (sess->next_buf + 1) % MAX_CACHED_BUFS;
+	put_img(NULL, buf->ihdl, buf->domain, buf->secure);
+	buf->ihdl = NULL;
+
+	if (msm_rotator_iommu_map_buf(fbd->memory_id, domain, &start, &len,
+				      &buf->ihdl, secure)) {
+		if (!IS_ERR_OR_NULL(buf->ihdl))
+			ion_free(msm_rotator_dev->client, buf->ihdl);
+		buf->ihdl = NULL;
+		return;
+	}
+	buf->domain = domain;
+	buf->secure = secure;
+}
+
+static void msm_rotator_uncache_bufs(int s)
+{
+	struct msm_rotator_session *sess = &msm_rotator_dev->session[s];
+	int i;
+
+	for (i = 0; i < MAX_CACHED_BUFS; i++) {
+		put_img(NULL, sess->bufs[i].ihdl, sess->bufs[i].domain,
+			sess->bufs[i].secure);
+		sess->bufs[i].ihdl = NULL;
+	}
+}
+#else
+static inline void msm_rotator_cache_buf(int s, struct msmfb_data *fbd,
+	struct ion_handle *ihdl, int domain, unsigned int secure)
+{
+}
+
+static inline void msm_rotator_uncache_bufs(int s)
+{
+}
+#endif
+
+static int msm_rotator_find_session(unsigned int session_id)
+{
+	int s;
 
-	mutex_lock(&msm_rotator_dev->rotator_lock);
 	for (s = 0; s < MAX_SESSIONS; s++)
 		if ((msm_rotator_dev->img_info[s] != NULL) &&
-			(info.session_id ==
-			(unsigned int)msm_rotator_dev->img_info[s]
-			))
-			break;
+			(session_id ==
+			(unsigned int)msm_rotator_dev->img_info[s]))
+			return s;
+	return INVALID_SESSION;
+}
 
-	if (s == MAX_SESSIONS) {
-		pr_err("%s() : Attempt to use invalid session_id %d\n",
-			__func__, s);
-		rc = -EINVAL;
-		goto do_rotate_unlock_mutex;
+/* drop the buffers of a job, may be called again once they are gone */
+static void msm_rotator_release(struct msm_rotator_commit *c)
+{
+	put_img(c->dstp1_file, c->dstp1_ihdl, ROTATOR_DST_DOMAIN,
+		c->img_info.secure);
+	put_img(c->srcp1_file, c->srcp1_ihdl, ROTATOR_SRC_DOMAIN, 0);
+	put_img(c->dstp0_file, c->dstp0_ihdl, ROTATOR_DST_DOMAIN,
+		c->img_info.secure);
+
+	/* only source may use frame buffer */
+	if (c->src_flags & MDP_MEMORY_ID_TYPE_FB) {
+		if (c->srcp0_file)
+			fput_light(c->srcp0_file, c->ps0_need);
+	} else {
+		put_img(c->srcp0_file, c->srcp0_ihdl, ROTATOR_SRC_DOMAIN, 0);
 	}
 
+	c->srcp0_file = c->dstp0_file = NULL;
+	c->srcp1_file = c->dstp1_file = NULL;
+	c->srcp0_ihdl = c->dstp0_ihdl = NULL;
+	c->srcp1_ihdl = c->dstp1_ihdl = NULL;
+}
+
+/*
+ * Import and check the buffers of a rotation in the caller's context,
+ * where the memory ids are valid.  Called with rotator_lock held.
+ */
+static int msm_rotator_prepare(struct msm_rotator_data_info *info, int s,
+			       struct msm_rotator_commit *c)
+{
+	unsigned long src_len, dst_len;
+	int p_need, rc;
+	struct msm_rotator_img_info *img_info;
+	struct msm_rotator_mem_planes src_planes, dst_planes;
+
+	c->s = s;
 	if (msm_rotator_dev->img_info[s]->enable == 0) {
 		dev_dbg(msm_rotator_dev->device,
 			"%s() : Session_id %d not enabled \n",
 			__func__, s);
-		rc = -EINVAL;
-		goto do_rotate_unlock_mutex;
+		return -EINVAL;
 	}
 
-	img_info = msm_rotator_dev->img_info[s];
+	c->img_info = *msm_rotator_dev->img_info[s];
+	c->src_flags = info->src.flags;
+	img_info = &c->img_info;
 	if (msm_rotator_get_plane_sizes(img_info->src.format,
 					img_info->src.width,
 					img_info->src.height,
 					&src_planes)) {
 		pr_err("%s: invalid src format\n", __func__);
-		rc = -EINVAL;
-		goto do_rotate_unlock_mutex;
+		return -EINVAL;
 	}
 	if (msm_rotator_get_plane_sizes(img_info->dst.format,
 					img_info->dst.width,
 					img_info->dst.height,
 					&dst_planes)) {
 		pr_err("%s: invalid dst format\n", __func__);
-		rc = -EINVAL;
-		goto do_rotate_unlock_mutex;
+		return -EINVAL;
 	}
 
-	rc = get_img(&info.src, ROTATOR_SRC_DOMAIN, (unsigned long *)&in_paddr,
-			(unsigned long *)&src_len, &srcp0_file, &ps0_need,
-			&srcp0_ihdl, 0);
+	rc = get_img(&info->src, ROTATOR_SRC_DOMAIN,
+			(unsigned long *)&c->in_paddr,
+			(unsigned long *)&src_len, &c->srcp0_file,
+			&c->ps0_need, &c->srcp0_ihdl, 0);
 	if (rc) {
 		pr_err("%s: in get_img() failed id=0x%08x\n",
-			DRIVER_NAME, info.src.memory_id);
-		goto do_rotate_unlock_mutex;
+			DRIVER_NAME, info->src.memory_id);
+		goto prepare_err;
 	}
+	msm_rotator_cache_buf(s, &info->src, c->srcp0_ihdl,
+			      ROTATOR_SRC_DOMAIN, 0);
 
-	rc = get_img(&info.dst, ROTATOR_DST_DOMAIN, (unsigned long *)&out_paddr,
-			(unsigned long *)&dst_len, &dstp0_file, &p_need,
-			&dstp0_ihdl, img_info->secure);
+	rc = get_img(&info->dst, ROTATOR_DST_DOMAIN,
+			(unsigned long *)&c->out_paddr,
+			(unsigned long *)&dst_len, &c->dstp0_file, &p_need,
+			&c->dstp0_ihdl, img_info->secure);
 	if (rc) {
 		pr_err("%s: out get_img() failed id=0x%08x\n",
-		       DRIVER_NAME, info.dst.memory_id);
-		goto do_rotate_unlock_mutex;
+		       DRIVER_NAME, info->dst.memory_id);
+		goto prepare_err;
 	}
+	msm_rotator_cache_buf(s, &info->dst, c->dstp0_ihdl,
+			      ROTATOR_DST_DOMAIN, img_info->secure);
 
-	format = msm_rotator_dev->img_info[s]->src.format;
-	if (((info.version_key & VERSION_KEY_MASK) == 0xA5B4C300) &&
-			((info.version_key & ~VERSION_KEY_MASK) > 0) &&
+	if (((info->version_key & VERSION_KEY_MASK) == 0xA5B4C300) &&
+			((info->version_key & ~VERSION_KEY_MASK) > 0) &&
 			(src_planes.num_planes == 2)) {
-		if (checkoffset(info.src.offset,
+		if (checkoffset(info->src.offset,
 				src_planes.plane_size[0],
 				src_len)) {
 			pr_err("%s: invalid src buffer (len=%lu offset=%x)\n",
-			       __func__, src_len, info.src.offset);
+			       __func__, src_len, info->src.offset);
 			rc = -ERANGE;
-			goto do_rotate_unlock_mutex;
+			goto prepare_err;
 		}
-		if (checkoffset(info.dst.offset,
+		if (checkoffset(info->dst.offset,
 				dst_planes.plane_size[0],
 				dst_len)) {
 			pr_err("%s: invalid dst buffer (len=%lu offset=%x)\n",
-			       __func__, dst_len, info.dst.offset);
+			       __func__, dst_len, info->dst.offset);
 			rc = -ERANGE;
-			goto do_rotate_unlock_mutex;
+			goto prepare_err;
 		}
 
-		rc = get_img(&info.src_chroma, ROTATOR_SRC_DOMAIN,
-				(unsigned long *)&in_chroma_paddr,
-				(unsigned long *)&src_len, &srcp1_file, &p_need,
-				&srcp1_ihdl, 0);
+		rc = get_img(&info->src_chroma, ROTATOR_SRC_DOMAIN,
+				(unsigned long *)&c->in_chroma_paddr,
+				(unsigned long *)&src_len, &c->srcp1_file,
+				&p_need, &c->srcp1_ihdl, 0);
 		if (rc) {
 			pr_err("%s: in chroma get_img() failed id=0x%08x\n",
-				DRIVER_NAME, info.src_chroma.memory_id);
-			goto do_rotate_unlock_mutex;
+				DRIVER_NAME, info->src_chroma.memory_id);
+			goto prepare_err;
 		}
+		msm_rotator_cache_buf(s, &info->src_chroma, c->srcp1_ihdl,
+				      ROTATOR_SRC_DOMAIN, 0);
 
-		rc = get_img(&info.dst_chroma, ROTATOR_DST_DOMAIN,
-				(unsigned long *)&out_chroma_paddr,
-				(unsigned long *)&dst_len, &dstp1_file, &p_need,
-				&dstp1_ihdl, img_info->secure);
+		rc = get_img(&info->dst_chroma, ROTATOR_DST_DOMAIN,
+				(unsigned long *)&c->out_chroma_paddr,
+				(unsigned long *)&dst_len, &c->dstp1_file,
+				&p_need, &c->dstp1_ihdl, img_info->secure);
 		if (rc) {
 			pr_err("%s: out chroma get_img() failed id=0x%08x\n",
-				DRIVER_NAME, info.dst_chroma.memory_id);
-			goto do_rotate_unlock_mutex;
+				DRIVER_NAME, info->dst_chroma.memory_id);
+			goto prepare_err;
 		}
+		msm_rotator_cache_buf(s, &info->dst_chroma, c->dstp1_ihdl,
+				      ROTATOR_DST_DOMAIN, img_info->secure);
 
-		if (checkoffset(info.src_chroma.offset,
+		if (checkoffset(info->src_chroma.offset,
 				src_planes.plane_size[1],
 				src_len)) {
 			pr_err("%s: invalid chr src buf len=%lu offset=%x\n",
-			       __func__, src_len, info.src_chroma.offset);
+			       __func__, src_len, info->src_chroma.offset);
 			rc = -ERANGE;
-			goto do_rotate_unlock_mutex;
+			goto prepare_err;
 		}
 
-		if (checkoffset(info.dst_chroma.offset,
+		if (checkoffset(info->dst_chroma.offset,
 				src_planes.plane_size[1],
 				dst_len)) {
 			pr_err("%s: invalid chr dst buf len=%lu offset=%x\n",
-			       __func__, dst_len, info.dst_chroma.offset);
+			       __func__, dst_len, info->dst_chroma.offset);
 			rc = -ERANGE;
-			goto do_rotate_unlock_mutex;
+			goto prepare_err;
 		}
 
-		in_chroma_paddr += info.src_chroma.offset;
-		out_chroma_paddr += info.dst_chroma.offset;
+		c->in_chroma_paddr += info->src_chroma.offset;
+		c->out_chroma_paddr += info->dst_chroma.offset;
 	} else {
-		if (checkoffset(info.src.offset,
+		if (checkoffset(info->src.offset,
 				src_planes.total_size,
 				src_len)) {
 			pr_err("%s: invalid src buffer (len=%lu offset=%x)\n",
-			       __func__, src_len, info.src.offset);
+			       __func__, src_len, info->src.offset);
 			rc = -ERANGE;
-			goto do_rotate_unlock_mutex;
+			goto prepare_err;
 		}
-		if (checkoffset(info.dst.offset,
+		if (checkoffset(info->dst.offset,
 				dst_planes.total_size,
 				dst_len)) {
 			pr_err("%s: invalid dst buffer (len=%lu offset=%x)\n",
-			       __func__, dst_len, info.dst.offset);
+			       __func__, dst_len, info->dst.offset);
 			rc = -ERANGE;
-			goto do_rotate_unlock_mutex;
+			goto prepare_err;
 		}
 	}
 
-	in_paddr += info.src.offset;
-	out_paddr += info.dst.offset;
+	c->in_paddr += info->src.offset;
+	c->out_paddr += info->dst.offset;
 
-	if (!in_chroma_paddr && src_planes.num_planes >= 2)
-		in_chroma_paddr = in_paddr + src_planes.plane_size[0];
-	if (!out_chroma_paddr && dst_planes.num_planes >= 2)
-		out_chroma_paddr = out_paddr + dst_planes.plane_size[0];
+	if (!c->in_chroma_paddr && src_planes.num_planes >= 2)
+		c->in_chroma_paddr = c->in_paddr + src_planes.plane_size[0];
+	if (!c->out_chroma_paddr && dst_planes.num_planes >= 2)
+		c->out_chroma_paddr = c->out_paddr + dst_planes.plane_size[0];
 	if (src_planes.num_planes >= 3)
-		in_chroma2_paddr = in_chroma_paddr + src_planes.plane_size[1];
+		c->in_chroma2_paddr = c->in_chroma_paddr +
+			src_planes.plane_size[1];
+	return 0;
+
+prepare_err:
+	msm_rotator_release(c);
+	return rc;
+}
+
+/* program the hardware and wait for it, called with rotator_lock held */
+static int msm_rotator_hw_run(struct msm_rotator_commit *c)
+{
+	struct msm_rotator_img_info *img_info = &c->img_info;
+	unsigned int status, format = img_info->src.format;
+	int use_imem = 0, rc = 0, s = c->s;
 
 	cancel_delayed_work(&msm_rotator_dev->rot_clk_work);
 	if (msm_rotator_dev->rot_clk_state != CLK_EN) {
@@ -1098,17 +1244,14 @@ static int msm_rotator_do_rotate(unsigned long arg)
 	if (use_imem)
 		iowrite32(0x42, MSM_ROTATOR_MAX_BURST_SIZE);
 
-	iowrite32(((msm_rotator_dev->img_info[s]->src_rect.h & 0x1fff)
-				<< 16) |
-		  (msm_rotator_dev->img_info[s]->src_rect.w & 0x1fff),
+	iowrite32(((img_info->src_rect.h & 0x1fff) << 16) |
+		  (img_info->src_rect.w & 0x1fff),
 		  MSM_ROTATOR_SRC_SIZE);
-	iowrite32(((msm_rotator_dev->img_info[s]->src_rect.y & 0x1fff)
-				<< 16) |
-		  (msm_rotator_dev->img_info[s]->src_rect.x & 0x1fff),
+	iowrite32(((img_info->src_rect.y & 0x1fff) << 16) |
+		  (img_info->src_rect.x & 0x1fff),
 		  MSM_ROTATOR_SRC_XY);
-	iowrite32(((msm_rotator_dev->img_info[s]->src.height & 0x1fff)
-				<< 16) |
-		  (msm_rotator_dev->img_info[s]->src.width & 0x1fff),
+	iowrite32(((img_info->src.height & 0x1fff) << 16) |
+		  (img_info->src.width & 0x1fff),
 		  MSM_ROTATOR_SRC_IMAGE_SIZE);
 
 	switch (format) {
@@ -1122,8 +1265,8 @@ static int msm_rotator_do_rotate(unsigned long arg)
 	case MDP_RGBX_8888:
 	case MDP_YCBCR_H1V1:
 	case MDP_YCRCB_H1V1:
-		rc = msm_rotator_rgb_types(msm_rotator_dev->img_info[s],
-					   in_paddr, out_paddr,
+		rc = msm_rotator_rgb_types(img_info,
+					   c->in_paddr, c->out_paddr,
 					   use_imem,
 					   msm_rotator_dev->last_session_idx
 								!= s);
@@ -1135,39 +1278,41 @@ static int msm_rotator_do_rotate(unsigned long arg)
 	case MDP_Y_CR_CB_GH2V2:
 	case MDP_Y_CRCB_H2V2_TILE:
 	case MDP_Y_CBCR_H2V2_TILE:
-		rc = msm_rotator_ycxcx_h2v2(msm_rotator_dev->img_info[s],
-					    in_paddr, out_paddr, use_imem,
+		rc = msm_rotator_ycxcx_h2v2(img_info,
+					    c->in_paddr, c->out_paddr,
+					    use_imem,
 					    msm_rotator_dev->last_session_idx
 								!= s,
-					    in_chroma_paddr,
-					    out_chroma_paddr,
-					    in_chroma2_paddr);
+					    c->in_chroma_paddr,
+					    c->out_chroma_paddr,
+					    c->in_chroma2_paddr);
 		break;
 	case MDP_Y_CBCR_H2V1:
 	case MDP_Y_CRCB_H2V1:
-		rc = msm_rotator_ycxcx_h2v1(msm_rotator_dev->img_info[s],
-					    in_paddr, out_paddr, use_imem,
+		rc = msm_rotator_ycxcx_h2v1(img_info,
+					    c->in_paddr, c->out_paddr,
+					    use_imem,
 					    msm_rotator_dev->last_session_idx
 								!= s,
-					    in_chroma_paddr,
-					    out_chroma_paddr);
+					    c->in_chroma_paddr,
+					    c->out_chroma_paddr);
 		break;
 	case MDP_YCRYCB_H2V1:
-		rc = msm_rotator_ycrycb(msm_rotator_dev->img_info[s],
-				in_paddr, out_paddr, use_imem,
+		rc = msm_rotator_ycrycb(img_info,
+				c->in_paddr, c->out_paddr, use_imem,
 				msm_rotator_dev->last_session_idx != s,
-				out_chroma_paddr);
+				c->out_chroma_paddr);
 		break;
 	default:
 		rc = -EINVAL;
 		pr_err("%s(): Unsupported format %u\n", __func__, format);
-		goto do_rotate_exit;
+		goto hw_run_exit;
 	}
 
 	if (rc != 0) {
 		msm_rotator_dev->last_session_idx = INVALID_SESSION;
 		pr_err("%s(): Invalid session error\n", __func__);
-		goto do_rotate_exit;
+		goto hw_run_exit;
 	}
 
 	iowrite32(3, MSM_ROTATOR_INTR_ENABLE);
@@ -1186,30 +1331,206 @@ static int msm_rotator_do_rotate(unsigned long arg)
 	iowrite32(0, MSM_ROTATOR_INTR_ENABLE);
 	iowrite32(3, MSM_ROTATOR_INTR_CLEAR);
 
-do_rotate_exit:
+hw_run_exit:
 	disable_irq(msm_rotator_dev->irq);
 #ifdef CONFIG_MSM_ROTATOR_USE_IMEM
 	msm_rotator_imem_free(ROTATOR_REQUEST);
 #endif
 	schedule_delayed_work(&msm_rotator_dev->rot_clk_work, HZ);
-do_rotate_unlock_mutex:
-	put_img(dstp1_file, dstp1_ihdl, ROTATOR_DST_DOMAIN,
-		msm_rotator_dev->img_info[s]->secure);
-	put_img(srcp1_file, srcp1_ihdl, ROTATOR_SRC_DOMAIN, 0);
-	put_img(dstp0_file, dstp0_ihdl, ROTATOR_DST_DOMAIN,
-		msm_rotator_dev->img_info[s]->secure);
+	return rc;
+}
 
-	/* only source may use frame buffer */
-	if (info.src.flags & MDP_MEMORY_ID_TYPE_FB)
-		fput_light(srcp0_file, ps0_need);
-	else
-		put_img(srcp0_file, srcp0_ihdl, ROTATOR_SRC_DOMAIN, 0);
+/*
+ * Run the queued jobs in submission order.  The rotator_lock is dropped
+ * while a job waits for its acquire fence, the session may be freed
+ * meanwhile and marks the job cancelled.
+ */
+static void msm_rotator_commit_work_f(struct work_struct *work)
+{
+	struct msm_rotator_commit *c;
+	int rc;
+
+	mutex_lock(&msm_rotator_dev->rotator_lock);
+	while (!list_empty(&msm_rotator_dev->commit_list)) {
+		c = list_first_entry(&msm_rotator_dev->commit_list,
+				     struct msm_rotator_commit, list);
+		list_del(&c->list);
+
+		if (c->acq_fen) {
+			msm_rotator_dev->commit_waiting = c;
+			mutex_unlock(&msm_rotator_dev->rotator_lock);
+			rc = sync_fence_wait(c->acq_fen, WAIT_FENCE_TIMEOUT);
+			sync_fence_put(c->acq_fen);
+			c->acq_fen = NULL;
+			mutex_lock(&msm_rotator_dev->rotator_lock);
+			msm_rotator_dev->commit_waiting = NULL;
+			if (rc < 0 && !c->rc) {
+				pr_err("%s: sync_fence_wait failed! rc = %d\n",
+				       __func__, rc);
+				c->rc = rc;
+			}
+		}
+
+		if (!c->cancelled) {
+			if (!c->rc)
+				c->rc = msm_rotator_hw_run(c);
+			if (c->rc)
+				dev_dbg(msm_rotator_dev->device,
+					"%s: session %d failed rc = %d\n",
+					__func__, c->s, c->rc);
+			sw_sync_timeline_inc(
+				msm_rotator_dev->session[c->s].timeline, 1);
+		}
+		msm_rotator_release(c);
+		kfree(c);
+	}
+	mutex_unlock(&msm_rotator_dev->rotator_lock);
+}
+
+static int msm_rotator_do_rotate(unsigned long arg)
+{
+	struct msm_rotator_data_info info;
+	struct msm_rotator_commit commit, *c = &commit;
+	struct msm_rotator_session *sess;
+	int rc = 0, s;
+
+	if (copy_from_user(&info, (void __user *)arg, sizeof(info)))
+		return -EFAULT;
+
+	mutex_lock(&msm_rotator_dev->rotator_lock);
+	s = msm_rotator_find_session(info.session_id);
+	if (s == INVALID_SESSION) {
+		pr_err("%s() : Attempt to use invalid session_id %d\n",
+			__func__, info.session_id);
+		rc = -EINVAL;
+		goto do_rotate_unlock_mutex;
+	}
+
+	sess = &msm_rotator_dev->session[s];
+	if (sess->armed) {
+		c = kzalloc(sizeof(*c), GFP_KERNEL);
+		if (!c) {
+			rc = -ENOMEM;
+			goto do_rotate_unlock_mutex;
+		}
+	} else {
+		memset(c, 0, sizeof(*c));
+	}
+
+	rc = msm_rotator_prepare(&info, s, c);
+	if (c != &commit) {
+		/*
+		 * Queued even if it failed, the release fence has to be
+		 * signalled after the ones of the jobs before it.
+		 */
+		c->rc = rc;
+		c->acq_fen = sess->acq_fen;
+		sess->acq_fen = NULL;
+		sess->armed = 0;
+		/* framebuffer memory never goes away, the file is not needed */
+		if ((c->src_flags & MDP_MEMORY_ID_TYPE_FB) && c->srcp0_file) {
+			fput_light(c->srcp0_file, c->ps0_need);
+			c->srcp0_file = NULL;
+		}
+		list_add_tail(&c->list, &msm_rotator_dev->commit_list);
+		queue_work(msm_rotator_dev->commit_wq,
+			   &msm_rotator_dev->commit_work);
+	} else if (!rc) {
+		rc = msm_rotator_hw_run(c);
+		msm_rotator_release(c);
+	}
+
+do_rotate_unlock_mutex:
 	mutex_unlock(&msm_rotator_dev->rotator_lock);
 	dev_dbg(msm_rotator_dev->device, "%s() returning rc = %d\n",
 		__func__, rc);
 	return rc;
 }
 
+static int msm_rotator_buf_sync(unsigned long arg)
+{
+	struct msm_rotator_buf_sync buf_sync;
+	struct msm_rotator_session *sess;
+	struct sync_fence *acq_fen = NULL, *rel_fen;
+	struct sync_pt *pt;
+	int rc = 0, s, fd;
+
+	if (copy_from_user(&buf_sync, (void __user *)arg, sizeof(buf_sync)))
+		return -EFAULT;
+	if (buf_sync.flags)
+		return -EINVAL;
+
+	if (buf_sync.acq_fen_fd >= 0) {
+		acq_fen = sync_fence_fdget(buf_sync.acq_fen_fd);
+		if (!acq_fen) {
+			pr_err("%s: invalid fence fd %d\n", __func__,
+			       buf_sync.acq_fen_fd);
+			return -EINVAL;
+		}
+	}
+
+	fd = get_unused_fd_flags(0);
+	if (fd < 0) {
+		rc = fd;
+		goto buf_sync_err_1;
+	}
+
+	mutex_lock(&msm_rotator_dev->rotator_lock);
+	s = msm_rotator_find_session(buf_sync.session_id);
+	if (s == INVALID_SESSION) {
+		rc = -EINVAL;
+		goto buf_sync_err_2;
+	}
+
+	sess = &msm_rotator_dev->session[s];
+	if (!sess->timeline) {
+		sess->timeline = sw_sync_timeline_create("msm-rotator");
+		if (!sess->timeline) {
+			rc = -ENOMEM;
+			goto buf_sync_err_2;
+		}
+	}
+
+	/* arming again replaces the acquire fence of the same job */
+	pt = sw_sync_pt_create(sess->timeline, sess->timeline_value +
+			       (sess->armed ? 0 : 1));
+	if (!pt) {
+		rc = -ENOMEM;
+		goto buf_sync_err_2;
+	}
+	rel_fen = sync_fence_create("msm-rotator-fence", pt);
+	if (!rel_fen) {
+		sync_pt_free(pt);
+		rc = -ENOMEM;
+		goto buf_sync_err_2;
+	}
+
+	buf_sync.rel_fen_fd = fd;
+	if (copy_to_user((void __user *)arg, &buf_sync, sizeof(buf_sync))) {
+		sync_fence_put(rel_fen);
+		rc = -EFAULT;
+		goto buf_sync_err_2;
+	}
+	sync_fence_install(rel_fen, fd);
+
+	if (!sess->armed)
+		sess->timeline_value++;
+	sess->armed = 1;
+	if (sess->acq_fen)
+		sync_fence_put(sess->acq_fen);
+	sess->acq_fen = acq_fen;
+	mutex_unlock(&msm_rotator_dev->rotator_lock);
+	return 0;
+
+buf_sync_err_2:
+	mutex_unlock(&msm_rotator_dev->rotator_lock);
+	put_unused_fd(fd);
+buf_sync_err_1:
+	if (acq_fen)
+		sync_fence_put(acq_fen);
+	return rc;
+}
+
 static void msm_rotator_set_perf_level(u32 wh, u32 is_rgb)
 {
 	u32 perf_level;
@@ -1361,6 +1682,43 @@ rotator_start_exit:
 	return rc;
 }
 
+/*
+ * Free session @s with rotator_lock held.  Its queued jobs are dropped
+ * and destroying the timeline signals their release fences.
+ */
+static void msm_rotator_free_session(int s)
+{
+	struct msm_rotator_session *sess = &msm_rotator_dev->session[s];
+	struct msm_rotator_commit *c, *tmp;
+
+	list_for_each_entry_safe(c, tmp, &msm_rotator_dev->commit_list,
+				 list) {
+		if (c->s != s)
+			continue;
+		list_del(&c->list);
+		if (c->acq_fen)
+			sync_fence_put(c->acq_fen);
+		msm_rotator_release(c);
+		kfree(c);
+	}
+	if (msm_rotator_dev->commit_waiting &&
+	    msm_rotator_dev->commit_waiting->s == s)
+		msm_rotator_dev->commit_waiting->cancelled = 1;
+
+	if (sess->acq_fen)
+		sync_fence_put(sess->acq_fen);
+	if (sess->timeline)
+		sync_timeline_destroy(&sess->timeline->obj);
+	msm_rotator_uncache_bufs(s);
+	memset(sess, 0, sizeof(*sess));
+
+	if (msm_rotator_dev->last_session_idx == s)
+		msm_rotator_dev->last_session_idx = INVALID_SESSION;
+	kfree(msm_rotator_dev->img_info[s]);
+	msm_rotator_dev->img_info[s] = NULL;
+	msm_rotator_dev->fd_info[s] = NULL;
+}
+
 static int msm_rotator_finish(unsigned long arg)
 {
 	int rc = 0;
@@ -1371,22 +1729,11 @@ static int msm_rotator_finish(unsigned long arg)
 		return -EFAULT;
 
 	mutex_lock(&msm_rotator_dev->rotator_lock);
-	for (s = 0; s < MAX_SESSIONS; s++) {
-		if ((msm_rotator_dev->img_info[s] != NULL) &&
-			(session_id ==
-			(unsigned int)msm_rotator_dev->img_info[s])) {
-			if (msm_rotator_dev->last_session_idx == s)
-				msm_rotator_dev->last_session_idx =
-					INVALID_SESSION;
-			kfree(msm_rotator_dev->img_info[s]);
-			msm_rotator_dev->img_info[s] = NULL;
-			msm_rotator_dev->fd_info[s] = NULL;
-			break;
-		}
-	}
-
-	if (s == MAX_SESSIONS)
+	s = msm_rotator_find_session(session_id);
+	if (s == INVALID_SESSION)
 		rc = -EINVAL;
+	else
+		msm_rotator_free_session(s);
 #ifdef CONFIG_MSM_BUS_SCALING
 	msm_bus_scale_client_update_request(msm_rotator_dev->bus_client_handle,
 		0);
@@ -1461,12 +1808,7 @@ msm_rotator_close(struct inode *inode, struct file *filp)
 			pr_debug("%s: freeing rotator session %p (pid %d)\n",
 				 __func__, msm_rotator_dev->img_info[s],
 				 fd_info->pid);
-			kfree(msm_rotator_dev->img_info[s]);
-			msm_rotator_dev->img_info[s] = NULL;
-			msm_rotator_dev->fd_info[s] = NULL;
-			if (msm_rotator_dev->last_session_idx == s)
-				msm_rotator_dev->last_session_idx =
-					INVALID_SESSION;
+			msm_rotator_free_session(s);
 		}
 	}
 	list_del(&fd_info->list);
@@ -1493,6 +1835,8 @@ static long msm_rotator_ioctl(struct file *file, unsigned cmd,
 		return msm_rotator_do_rotate(arg);
 	case MSM_ROTATOR_IOCTL_FINISH:
 		return msm_rotator_finish(arg);
+	case MSM_ROTATOR_IOCTL_BUFFER_SYNC:
+		return msm_rotator_buf_sync(arg);
 
 	default:
 		dev_dbg(msm_rotator_dev->device,
@@ -1616,6 +1960,14 @@ static int __devinit msm_rotator_probe(struct platform_device *pdev)
 			  msm_rotator_rot_clk_work_f);
 
 	mutex_init(&msm_rotator_dev->rotator_lock);
+	INIT_LIST_HEAD(&msm_rotator_dev->commit_list);
+	INIT_WORK(&msm_rotator_dev->commit_work, msm_rotator_commit_work_f);
+	msm_rotator_dev->commit_wq = alloc_ordered_workqueue("msm_rotator",
+							     WQ_FREEZABLE);
+	if (!msm_rotator_dev->commit_wq) {
+		rc = -ENOMEM;
+		goto error_commit_wq;
+	}
 #ifdef CONFIG_MSM_MULTIMEDIA_USE_ION
 	msm_rotator_dev->client = msm_ion_client_create(-1, pdev->name);
 #endif
@@ -1719,6 +2071,8 @@ error_class_create:
 error_get_irq:
 	iounmap(msm_rotator_dev->io_base);
 error_get_resource:
+	destroy_workqueue(msm_rotator_dev->commit_wq);
+error_commit_wq:
 	mutex_destroy(&msm_rotator_dev->rotator_lock);
 	if (msm_rotator_dev->regulator)
 		regulator_put(msm_rotator_dev->regulator);
@@ -1741,9 +2095,11 @@ static int __devexit msm_rotator_remove(struct platform_device *plat_dev)
 #ifdef CONFIG_MSM_BUS_SCALING
 	msm_bus_scale_unregister_client(msm_rotator_dev->bus_client_handle);
 #endif
+	cdev_del(&msm_rotator_dev->cdev);
+	/* no file is open any more, so the queue is empty once flushed */
+	destroy_workqueue(msm_rotator_dev->commit_wq);
 	free_irq(msm_rotator_dev->irq, NULL);
 	mutex_destroy(&msm_rotator_dev->rotator_lock);
-	cdev_del(&msm_rotator_dev->cdev);
 	device_destroy(msm_rotator_dev->class, msm_rotator_dev->dev_num);
 	class_destroy(msm_rotator_dev->class);
 	unregister_chrdev_region(msm_rotator_dev->dev_num, 1);
@@ -1765,7 +2121,7 @@ static int __devexit msm_rotator_remove(struct platform_device *plat_dev)
 	mutex_destroy(&msm_rotator_dev->imem_lock);
 	for (i = 0; i < MAX_SESSIONS; i++)
 		if (msm_rotator_dev->img_info[i] != NULL)
-			kfree(msm_rotator_dev->img_info[i]);
+			msm_rotator_free_session(i);
 	kfree(msm_rotator_dev);
 	return 0;
 }
@@ -248,6 +248,7 @@
 #include <linux/percpu.h>
 #include <linux/cryptohash.h>
 #include <linux/fips.h>
+#include <crypto/chacha20.h>
 
 #ifdef CONFIG_GENERIC_HARDIRQS
 # include <linux/irq.h>
@@ -256,6 +257,7 @@
 #include <asm/processor.h>
 #include <asm/uaccess.h>
 #include <asm/irq.h>
+#include <asm/irq_regs.h>
 #include <asm/io.h>
 
 /*
@@ -463,28 +465,28 @@ static struct entropy_store nonblocking_pool = {
  * degree, and then twisted.  We twist by three bits at a time because
  * it's cheap to do so and helps slightly in the expected case where
  * the entropy is concentrated in the low-order bits.
+ *
+ * The caller must hold r->lock.
  */
-static void mix_pool_bytes_extract(struct entropy_store *r, const void *in,
-				   int nbytes, __u8 out[64])
+static __u32 const twist_table[8] = {
+	0x00000000, 0x3b6e20c8, 0x76dc4190, 0x4db26158,
+	0xedb88320, 0xd6d6a3e8, 0x9b64c2b0, 0xa00ae278 };
+
+static void __mix_pool_bytes(struct entropy_store *r, const void *in,
+			     int nbytes, __u8 out[64])
 {
-	static __u32 const twist_table[8] = {
-		0x00000000, 0x3b6e20c8, 0x76dc4190, 0x4db26158,
-		0xedb88320, 0xd6d6a3e8, 0x9b64c2b0, 0xa00ae278 };
 	unsigned long i, j, tap1, tap2, tap3, tap4, tap5;
 	int input_rotate;
 	int wordmask = r->poolinfo->poolwords - 1;
 	const char *bytes = in;
 	__u32 w;
-	unsigned long flags;
 
-	/* Taps are constant, so we can load them without holding r->lock.  */
 	tap1 = r->poolinfo->tap1;
 	tap2 = r->poolinfo->tap2;
 	tap3 = r->poolinfo->tap3;
 	tap4 = r->poolinfo->tap4;
 	tap5 = r->poolinfo->tap5;
 
-	spin_lock_irqsave(&r->lock, flags);
 	input_rotate = r->input_rotate;
 	i = r->add_ptr;
 
@@ -519,7 +521,15 @@ static void mix_pool_bytes_extract(struct entropy_store *r, const void *in,
 	if (out)
 		for (j = 0; j < 16; j++)
 			((__u32 *)out)[j] = r->pool[(i - j) & wordmask];
+}
 
+static void mix_pool_bytes_extract(struct entropy_store *r, const void *in,
+				   int nbytes, __u8 out[64])
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&r->lock, flags);
+	__mix_pool_bytes(r, in, nbytes, out);
 	spin_unlock_irqrestore(&r->lock, flags);
 }
 
@@ -611,6 +621,45 @@ static void set_timer_rand_state(unsigned int irq,
 
 static struct timer_rand_state input_timer_state;
 
+/*
+ * Estimate the bits of randomness a new event of @state at @now added,
+ * from the first, second and third-order deltas of its timing.
+ */
+static int timer_entropy_bits(struct timer_rand_state *state, long now)
+{
+	long delta, delta2, delta3;
+
+	if (state->dont_count_entropy)
+		return 0;
+
+	delta = now - state->last_time;
+	state->last_time = now;
+
+	delta2 = delta - state->last_delta;
+	state->last_delta = delta;
+
+	delta3 = delta2 - state->last_delta2;
+	state->last_delta2 = delta2;
+
+	if (delta < 0)
+		delta = -delta;
+	if (delta2 < 0)
+		delta2 = -delta2;
+	if (delta3 < 0)
+		delta3 = -delta3;
+	if (delta > delta2)
+		delta = delta2;
+	if (delta > delta3)
+		delta = delta3;
+
+	/*
+	 * delta is now minimum absolute delta.
+	 * Round down by 1 bit on general principles,
+	 * and limit entropy entimate to 12 bits.
+	 */
+	return min_t(int, fls(delta>>1), 11);
+}
+
 /*
  * This function adds entropy to the entropy "pool" by using timing
  * delays.  It uses the timer_rand_state structure to make an estimate
@@ -628,7 +677,6 @@ static void add_timer_randomness(struct timer_rand_state *state, unsigned num)
 		unsigned cycles;
 		unsigned num;
 	} sample;
-	long delta, delta2, delta3;
 
 	preempt_disable();
 	/* if over the trickle threshold, use only 1 in 4096 samples */
@@ -645,41 +693,8 @@ static void add_timer_randomness(struct timer_rand_state *state, unsigned num)
 	sample.num = num;
 	mix_pool_bytes(&input_pool, &sample, sizeof(sample));
 
-	/*
-	 * Calculate number of bits of randomness we probably added.
-	 * We take into account the first, second and third-order deltas
-	 * in order to make our estimate.
-	 */
-
-	if (!state->dont_count_entropy) {
-		delta = sample.jiffies - state->last_time;
-		state->last_time = sample.jiffies;
-
-		delta2 = delta - state->last_delta;
-		state->last_delta = delta;
-
-		delta3 = delta2 - state->last_delta2;
-		state->last_delta2 = delta2;
-
-		if (delta < 0)
-			delta = -delta;
-		if (delta2 < 0)
-			delta2 = -delta2;
-		if (delta3 < 0)
-			delta3 = -delta3;
-		if (delta > delta2)
-			delta = delta2;
-		if (delta > delta3)
-			delta = delta3;
-
-		/*
-		 * delta is now minimum absolute delta.
-		 * Round down by 1 bit on general principles,
-		 * and limit entropy entimate to 12 bits.
-		 */
-		credit_entropy_bits(&input_pool,
-				    min_t(int, fls(delta>>1), 11));
-	}
+	credit_entropy_bits(&input_pool,
+			    timer_entropy_bits(state, sample.jiffies));
 out:
 	preempt_enable();
 }
@@ -700,9 +715,53 @@ void add_input_randomness(unsigned int type, unsigned int code,
 }
 EXPORT_SYMBOL_GPL(add_input_randomness);
 
+/*
+ * Interrupts are first mixed into a small per-cpu pool, without any
+ * shared lock or cache line. The pool is mixed into the input pool, and
+ * the entropy estimated meanwhile credited, once per FAST_POOL_EVENTS
+ * interrupts or once a second, whichever comes first.
+ */
+#define FAST_POOL_EVENTS	64
+#define FAST_POOL_MAX_CREDIT	64
+
+struct fast_pool {
+	__u32		pool[4];
+	unsigned long	last;		/* jiffies of the last spill */
+	unsigned short	events;		/* interrupts since then */
+	unsigned short	credit;		/* estimated bits since then */
+	unsigned char	rotate;
+	unsigned char	idx;
+};
+
+static DEFINE_PER_CPU(struct fast_pool, irq_randomness);
+
+/* A lighter version of __mix_pool_bytes() for a four word pool */
+static void fast_mix(struct fast_pool *f, const void *in, int nbytes)
+{
+	const char *bytes = in;
+	unsigned int i = f->idx;
+	unsigned int input_rotate = f->rotate;
+	__u32 w;
+
+	while (nbytes--) {
+		w = rol32(*bytes++, input_rotate & 31) ^ f->pool[i & 3] ^
+			f->pool[(i + 1) & 3];
+		f->pool[i & 3] = (w >> 3) ^ twist_table[w & 7];
+		input_rotate += (i++ & 3) ? 7 : 14;
+	}
+	f->idx = i;
+	f->rotate = input_rotate;
+}
+
 void add_interrupt_randomness(int irq)
 {
 	struct timer_rand_state *state;
+	struct fast_pool *fast_pool;
+	struct pt_regs *regs = get_irq_regs();
+	unsigned long now = jiffies;
+	unsigned long flags;
+	__u32 input[4];
+	int credit;
 
 	state = get_timer_rand_state(irq);
 
@@ -710,7 +769,40 @@ void add_interrupt_randomness(int irq)
 		return;
 
 	DEBUG_ENT("irq event %d\n", irq);
-	add_timer_randomness(state, 0x100 + irq);
+
+	local_irq_save(flags);
+	fast_pool = &__get_cpu_var(irq_randomness);
+
+	input[0] = get_cycles();
+	input[1] = now;
+	input[2] = 0x100 + irq;
+	input[3] = regs ? instruction_pointer(regs) : _RET_IP_;
+	fast_mix(fast_pool, input, sizeof(input));
+
+	credit = fast_pool->credit + timer_entropy_bits(state, now);
+	fast_pool->credit = min(credit, FAST_POOL_MAX_CREDIT);
+
+	if (++fast_pool->events < FAST_POOL_EVENTS &&
+	    !time_after(now, fast_pool->last + HZ))
+		goto out;
+
+	/* If somebody else is mixing, try again on the next interrupt */
+	if (!spin_trylock(&input_pool.lock))
+		goto out;
+	__mix_pool_bytes(&input_pool, fast_pool->pool,
+			 sizeof(fast_pool->pool), NULL);
+	spin_unlock(&input_pool.lock);
+
+	credit = fast_pool->credit;
+	fast_pool->credit = 0;
+	fast_pool->events = 0;
+	fast_pool->last = now;
+	local_irq_restore(flags);
+
+	credit_entropy_bits(&input_pool, credit);
+	return;
+out:
+	local_irq_restore(flags);
 }
 
 #ifdef CONFIG_BLOCK
@@ -929,6 +1021,101 @@ static ssize_t extract_entropy_user(struct entropy_store *r, void __user *buf,
 	return ret;
 }
 
+/*
+ * Kernel consumers are served by a ChaCha20 keystream per cpu, so that
+ * frequent small requests (TCP sequence numbers, port numbers) neither
+ * take the pool locks nor run SHA-1 over the nonblocking pool each time.
+ * Each cpu keys its generator from the nonblocking pool on first use and
+ * every CRNG_RESEED_INTERVAL after that, or every second as long as the
+ * input pool had little entropy when the key was taken (early boot).
+ */
+#define CRNG_RESEED_INTERVAL	(300 * HZ)
+
+struct crng_state {
+	__u32		state[16];
+	unsigned long	init_time;
+	bool		keyed;
+	bool		seeded;
+};
+
+static DEFINE_PER_CPU(struct crng_state, crng_pcpu);
+
+/* Called with interrupts disabled */
+static void crng_reseed(struct crng_state *crng)
+{
+	__u32 key[(CHACHA20_KEY_SIZE + CHACHA20_IV_SIZE) / sizeof(__u32)];
+	int i;
+
+	crng->seeded = input_pool.entropy_count >= random_read_wakeup_thresh;
+	extract_entropy(&nonblocking_pool, key, sizeof(key), 0, 0);
+
+	/* "expand 32-byte k" */
+	crng->state[0] = 0x61707865;
+	crng->state[1] = 0x3320646e;
+	crng->state[2] = 0x79622d32;
+	crng->state[3] = 0x6b206574;
+	for (i = 0; i < ARRAY_SIZE(key); i++)
+		crng->state[4 + i] ^= key[i];
+	crng->init_time = jiffies;
+	crng->keyed = true;
+	memset(key, 0, sizeof(key));
+}
+
+static void crng_block(__u8 out[CHACHA20_BLOCK_SIZE])
+{
+	struct crng_state *crng;
+	unsigned long flags;
+	unsigned long interval;
+
+	local_irq_save(flags);
+	crng = &__get_cpu_var(crng_pcpu);
+	interval = crng->seeded ? CRNG_RESEED_INTERVAL : HZ;
+	if (!crng->keyed || time_after(jiffies, crng->init_time + interval))
+		crng_reseed(crng);
+	chacha20_block(crng->state, out);
+	local_irq_restore(flags);
+}
+
+/*
+ * Replace the key with fresh keystream once a request is done, so that
+ * the state left behind cannot be used to recover what was returned.
+ */
+static void crng_backtrack_protect(void)
+{
+	__u32 tmp[CHACHA20_BLOCK_SIZE / sizeof(__u32)];
+	struct crng_state *crng;
+	unsigned long flags;
+	int i;
+
+	local_irq_save(flags);
+	crng = &__get_cpu_var(crng_pcpu);
+	chacha20_block(crng->state, tmp);
+	for (i = 0; i < CHACHA20_KEY_SIZE / sizeof(__u32); i++)
+		crng->state[4 + i] ^= tmp[i];
+	local_irq_restore(flags);
+	memset(tmp, 0, sizeof(tmp));
+}
+
+static void crng_get_bytes(__u8 *p, int nbytes)
+{
+	__u8 tmp[CHACHA20_BLOCK_SIZE];
+	int i;
+
+	if (nbytes <= 0)
+		return;
+
+	while (nbytes > 0) {
+		crng_block(tmp);
+		i = min_t(int, nbytes, CHACHA20_BLOCK_SIZE);
+		memcpy(p, tmp, i);
+		nbytes -= i;
+		p += i;
+	}
+	crng_backtrack_protect();
+
+	memset(tmp, 0, sizeof(tmp));
+}
+
 /*
  * This function is the exported kernel interface.  It returns some
  * number of good random numbers, suitable for seeding TCP sequence
@@ -950,7 +1137,7 @@ void get_random_bytes(void *buf, int nbytes)
 		nbytes -= chunk;
 	}
 
-	extract_entropy(&nonblocking_pool, p, nbytes, 0, 0);
+	crng_get_bytes(p, nbytes);
 }
 EXPORT_SYMBOL(get_random_bytes);
 
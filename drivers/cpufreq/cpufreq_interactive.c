@@ -19,6 +19,7 @@
 #include <linux/cpu.h>
 #include <linux/cpumask.h>
 #include <linux/cpufreq.h>
+#include <linux/cpuset.h>
 #include <linux/module.h>
 #include <linux/moduleparam.h>
 #include <linux/rwsem.h>
@@ -29,6 +30,7 @@
 #include <linux/workqueue.h>
 #include <linux/kthread.h>
 #include <linux/slab.h>
+#include <linux/input.h>
 #include <asm/cputime.h>
 
 #define CREATE_TRACE_POINTS
@@ -58,6 +60,8 @@ struct cpufreq_interactive_cpuinfo {
 	u64 hispeed_validate_time;
 	struct rw_semaphore enable_sem;
 	int governor_enabled;
+	u64 input_boost_until;
+	unsigned int follow_freq;
 };
 
 static DEFINE_PER_CPU(struct cpufreq_interactive_cpuinfo, cpuinfo);
@@ -108,6 +112,24 @@ static int boostpulse_duration_val = DEFAULT_BOOSTPULSE_DURATION;
 /* End time of boost pulse in ktime converted to usecs */
 static u64 boostpulse_endtime;
 
+/*
+ * Touch input holds input_boost_cpus CPUs at input_boost_freq, or at
+ * hispeed_freq if that is 0, for input_boost_duration usecs.  A duration
+ * of 0 turns the input boost off.
+ */
+static unsigned int input_boost_freq;
+static unsigned int input_boost_cpus = 2;
+static unsigned long input_boost_duration = DEFAULT_BOOSTPULSE_DURATION;
+static u64 input_boost_last;
+static struct work_struct input_boost_hotplug_work;
+
+/*
+ * Non-zero means a CPU a fair task was just migrated to starts out at the
+ * speed of the CPU the task came from, capped at hispeed_freq, instead of
+ * waiting a timer interval to notice the load.
+ */
+static int migrate_follow = 1;
+
 /*
  * Max additional time to wait in idle, beyond timer_rate, at speeds above
  * minimum before wakeup to reduce speed, or -1 if unnecessary.
@@ -273,6 +295,32 @@ static u64 update_load(int cpu)
 	return now;
 }
 
+/*
+ * Apply the speed recorded by the scheduler load hook for a task that
+ * migrated to or woke up on this CPU.  Held like a boost for at least
+ * min_sample_time.
+ */
+static void cpufreq_interactive_follow(
+	struct cpufreq_interactive_cpuinfo *pcpu, int cpu)
+{
+	unsigned int freq = xchg(&pcpu->follow_freq, 0);
+	unsigned long flags;
+	u64 now;
+
+	if (!freq || pcpu->target_freq >= freq)
+		return;
+
+	now = ktime_to_us(ktime_get());
+	spin_lock_irqsave(&speedchange_cpumask_lock, flags);
+	pcpu->target_freq = freq;
+	pcpu->floor_freq = freq;
+	pcpu->floor_validate_time = now;
+	pcpu->hispeed_validate_time = now;
+	cpumask_set_cpu(cpu, &speedchange_cpumask);
+	spin_unlock_irqrestore(&speedchange_cpumask_lock, flags);
+	wake_up_process(speedchange_task);
+}
+
 static void cpufreq_interactive_timer(unsigned long data)
 {
 	u64 now;
@@ -292,6 +340,8 @@ static void cpufreq_interactive_timer(unsigned long data)
 	if (!pcpu->governor_enabled)
 		goto exit;
 
+	cpufreq_interactive_follow(pcpu, data);
+
 	spin_lock_irqsave(&pcpu->load_lock, flags);
 	now = update_load(data);
 	delta_time = (unsigned int)(now - pcpu->cputime_speedadj_timestamp);
@@ -319,6 +369,14 @@ static void cpufreq_interactive_timer(unsigned long data)
 		new_freq = choose_freq(pcpu, loadadjfreq);
 	}
 
+	if (now < pcpu->input_boost_until) {
+		unsigned int boost_freq = input_boost_freq ? : hispeed_freq;
+
+		boosted = true;
+		if (new_freq < boost_freq)
+			new_freq = boost_freq;
+	}
+
 	if (pcpu->target_freq >= hispeed_freq &&
 	    new_freq > pcpu->target_freq &&
 	    now - pcpu->hispeed_validate_time < above_hispeed_delay_val) {
@@ -442,6 +500,8 @@ static void cpufreq_interactive_idle_end(void)
 		return;
 	}
 
+	cpufreq_interactive_follow(pcpu, smp_processor_id());
+
 	/* Arm the timer for 1-2 ticks later if not already. */
 	if (!timer_pending(&pcpu->cpu_timer)) {
 		cpufreq_interactive_timer_resched(pcpu);
@@ -557,6 +617,169 @@ static void cpufreq_interactive_boost(void)
 		wake_up_process(speedchange_task);
 }
 
+/*
+ * Raise the first input_boost_cpus online CPUs to the input boost speed.
+ * Called from the input event handler, so nothing in here may sleep; the
+ * hotplug boost is left to a work item.
+ */
+static void cpufreq_interactive_input_boost(u64 now)
+{
+	unsigned int freq = input_boost_freq ? : hispeed_freq;
+	unsigned int n = 0;
+	int i, anyboost = 0;
+	unsigned long flags;
+	struct cpufreq_interactive_cpuinfo *pcpu;
+
+	spin_lock_irqsave(&speedchange_cpumask_lock, flags);
+
+	for_each_online_cpu(i) {
+		if (n++ >= input_boost_cpus)
+			break;
+
+		pcpu = &per_cpu(cpuinfo, i);
+		if (!pcpu->governor_enabled)
+			continue;
+
+		pcpu->input_boost_until = now + input_boost_duration;
+		if (pcpu->target_freq < freq) {
+			pcpu->target_freq = freq;
+			cpumask_set_cpu(i, &speedchange_cpumask);
+			pcpu->hispeed_validate_time = now;
+			anyboost = 1;
+		}
+
+		pcpu->floor_freq = freq;
+		pcpu->floor_validate_time = now;
+	}
+
+	spin_unlock_irqrestore(&speedchange_cpumask_lock, flags);
+
+	if (anyboost)
+		wake_up_process(speedchange_task);
+}
+
+/*
+ * Scheduler load hook.  Runs under the runqueue lock, so only note the
+ * speed for the destination CPU; it is applied when that CPU leaves idle
+ * or on its next timer.  Migrations follow the speed of the source CPU,
+ * wakeups of boosted tasks ask for hispeed_freq.
+ */
+static void cpufreq_interactive_sched_load(int cpu, int event, int src_cpu)
+{
+	struct cpufreq_interactive_cpuinfo *pcpu, *psrc;
+	unsigned int freq;
+
+	pcpu = &per_cpu(cpuinfo, cpu);
+	if (!pcpu->governor_enabled)
+		return;
+
+	if (event == SCHED_LOAD_BOOST) {
+		/* a latency critical task woke up, start it at hispeed */
+		freq = hispeed_freq;
+	} else if (event == SCHED_LOAD_MIGRATE && migrate_follow &&
+		   src_cpu >= 0) {
+		psrc = &per_cpu(cpuinfo, src_cpu);
+		if (!psrc->governor_enabled)
+			return;
+		freq = min(psrc->target_freq, hispeed_freq);
+	} else {
+		return;
+	}
+
+	if (freq > pcpu->target_freq && freq > ACCESS_ONCE(pcpu->follow_freq))
+		pcpu->follow_freq = freq;
+}
+
+static void cpufreq_interactive_input_hotplug(struct work_struct *work)
+{
+	hotplug_boostpulse();
+	cpuset_boost(input_boost_duration / USEC_PER_MSEC);
+}
+
+static void cpufreq_interactive_input_event(struct input_handle *handle,
+		unsigned int type, unsigned int code, int value)
+{
+	u64 now;
+
+	if (!active_count || !input_boost_duration)
+		return;
+
+	/* a touch reports every few ms, the timers sample less often */
+	now = ktime_to_us(ktime_get());
+	if (now - input_boost_last < timer_rate)
+		return;
+	input_boost_last = now;
+
+	trace_cpufreq_interactive_boost("input");
+	cpufreq_interactive_input_boost(now);
+	schedule_work(&input_boost_hotplug_work);
+}
+
+static int cpufreq_interactive_input_connect(struct input_handler *handler,
+		struct input_dev *dev, const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int error;
+
+	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = handler->name;
+
+	error = input_register_handle(handle);
+	if (error)
+		goto err2;
+
+	error = input_open_device(handle);
+	if (error)
+		goto err1;
+
+	return 0;
+err1:
+	input_unregister_handle(handle);
+err2:
+	kfree(handle);
+	return error;
+}
+
+static void cpufreq_interactive_input_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+/* multi-touch screens, e.g. lge_touch_core, and single touch ones */
+static const struct input_device_id cpufreq_interactive_input_ids[] = {
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+		.absbit = { [BIT_WORD(ABS_MT_POSITION_X)] =
+			    BIT_MASK(ABS_MT_POSITION_X) |
+			    BIT_MASK(ABS_MT_POSITION_Y) },
+	},
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_KEYBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.keybit = { [BIT_WORD(BTN_TOUCH)] = BIT_MASK(BTN_TOUCH) },
+		.absbit = { [BIT_WORD(ABS_X)] =
+			    BIT_MASK(ABS_X) | BIT_MASK(ABS_Y) },
+	},
+	{ },
+};
+
+static struct input_handler cpufreq_interactive_input_handler = {
+	.event		= cpufreq_interactive_input_event,
+	.connect	= cpufreq_interactive_input_connect,
+	.disconnect	= cpufreq_interactive_input_disconnect,
+	.name		= "cpufreq_interactive",
+	.id_table	= cpufreq_interactive_input_ids,
+};
+
 static int cpufreq_interactive_notifier(
 	struct notifier_block *nb, unsigned long val, void *data)
 {
@@ -823,8 +1046,10 @@ static ssize_t store_boost(struct kobject *kobj, struct attribute *attr,
 	if (boost_val) {
 		trace_cpufreq_interactive_boost("on");
 		cpufreq_interactive_boost();
+		cpuset_boost(CPUSET_BOOST_HOLD);
 	} else {
 		trace_cpufreq_interactive_unboost("off");
+		cpuset_boost(0);
 	}
 
 	return count;
@@ -845,6 +1070,7 @@ static ssize_t store_boostpulse(struct kobject *kobj, struct attribute *attr,
 	boostpulse_endtime = ktime_to_us(ktime_get()) + boostpulse_duration_val;
 	trace_cpufreq_interactive_boost("pulse");
 	cpufreq_interactive_boost();
+	cpuset_boost(boostpulse_duration_val / USEC_PER_MSEC);
 	return count;
 }
 
@@ -874,6 +1100,98 @@ static ssize_t store_boostpulse_duration(
 
 define_one_global_rw(boostpulse_duration);
 
+static ssize_t show_input_boost_freq(struct kobject *kobj,
+				     struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", input_boost_freq);
+}
+
+static ssize_t store_input_boost_freq(struct kobject *kobj,
+				      struct attribute *attr, const char *buf,
+				      size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+
+	input_boost_freq = val;
+	return count;
+}
+
+define_one_global_rw(input_boost_freq);
+
+static ssize_t show_input_boost_cpus(struct kobject *kobj,
+				     struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", input_boost_cpus);
+}
+
+static ssize_t store_input_boost_cpus(struct kobject *kobj,
+				      struct attribute *attr, const char *buf,
+				      size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+
+	input_boost_cpus = val;
+	return count;
+}
+
+define_one_global_rw(input_boost_cpus);
+
+static ssize_t show_input_boost_duration(struct kobject *kobj,
+					 struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", input_boost_duration);
+}
+
+static ssize_t store_input_boost_duration(struct kobject *kobj,
+					  struct attribute *attr,
+					  const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+
+	input_boost_duration = val;
+	return count;
+}
+
+define_one_global_rw(input_boost_duration);
+
+static ssize_t show_migrate_follow(struct kobject *kobj,
+				   struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", migrate_follow);
+}
+
+static ssize_t store_migrate_follow(struct kobject *kobj,
+				    struct attribute *attr,
+				    const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+
+	migrate_follow = !!val;
+	return count;
+}
+
+define_one_global_rw(migrate_follow);
+
 static struct attribute *interactive_attributes[] = {
 	&target_loads_attr.attr,
 	&hispeed_freq_attr.attr,
@@ -885,6 +1203,10 @@ static struct attribute *interactive_attributes[] = {
 	&boost.attr,
 	&boostpulse.attr,
 	&boostpulse_duration.attr,
+	&input_boost_freq.attr,
+	&input_boost_cpus.attr,
+	&input_boost_duration.attr,
+	&migrate_follow.attr,
 	NULL,
 };
 
@@ -975,6 +1297,8 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 		}
 
 		idle_notifier_register(&cpufreq_interactive_idle_nb);
+		if (sched_register_load_hook(cpufreq_interactive_sched_load))
+			pr_warn("%s: scheduler load hook in use\n", __func__);
 		cpufreq_register_notifier(
 			&cpufreq_notifier_block, CPUFREQ_TRANSITION_NOTIFIER);
 		mutex_unlock(&gov_lock);
@@ -999,6 +1323,7 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 		cpufreq_unregister_notifier(
 			&cpufreq_notifier_block, CPUFREQ_TRANSITION_NOTIFIER);
 		idle_notifier_unregister(&cpufreq_interactive_idle_nb);
+		sched_unregister_load_hook(cpufreq_interactive_sched_load);
 		sysfs_remove_group(cpufreq_global_kobject,
 				&interactive_attr_group);
 		mutex_unlock(&gov_lock);
@@ -1054,6 +1379,10 @@ static int __init cpufreq_interactive_init(void)
 	/* NB: wake up so the thread does not look hung to the freezer */
 	wake_up_process(speedchange_task);
 
+	INIT_WORK(&input_boost_hotplug_work, cpufreq_interactive_input_hotplug);
+	if (input_register_handler(&cpufreq_interactive_input_handler))
+		pr_warn("%s: input handler registration failed\n", __func__);
+
 	return cpufreq_register_governor(&cpufreq_gov_interactive);
 }
 
@@ -1065,6 +1394,8 @@ module_init(cpufreq_interactive_init);
 
 static void __exit cpufreq_interactive_exit(void)
 {
+	input_unregister_handler(&cpufreq_interactive_input_handler);
+	cancel_work_sync(&input_boost_hotplug_work);
 	cpufreq_unregister_governor(&cpufreq_gov_interactive);
 	kthread_stop(speedchange_task);
 	put_task_struct(speedchange_task);
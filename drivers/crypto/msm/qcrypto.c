@@ -46,6 +46,18 @@
 #define DEBUG_MAX_FNAME  16
 #define DEBUG_MAX_RW_BUF 1024
 
+/*
+ * AES requests of at most sw_fallback_bytes are done on the cpu when at
+ * least sw_fallback_depth requests are already waiting for the engine.
+ * The engine setup dominates such requests, so this keeps the queue
+ * short under dm-crypt load without taking work away from an idle
+ * engine.  A depth of 0 disables the software path.
+ */
+static unsigned int sw_fallback_bytes = 512;
+module_param(sw_fallback_bytes, uint, 0644);
+static unsigned int sw_fallback_depth = 4;
+module_param(sw_fallback_depth, uint, 0644);
+
 struct crypto_stat {
 	u32 aead_sha1_aes_enc;
 	u32 aead_sha1_aes_dec;
@@ -63,6 +75,7 @@ struct crypto_stat {
 	u32 ablk_cipher_3des_dec;
 	u32 ablk_cipher_op_success;
 	u32 ablk_cipher_op_fail;
+	u32 ablk_cipher_sw_fallback;
 	u32 sha1_digest;
 	u32 sha256_digest;
 	u32 sha_op_success;
@@ -215,6 +228,9 @@ struct qcrypto_cipher_ctx {
 	unsigned int auth_key_len;
 
 	struct crypto_priv *cp;
+
+	/* software cipher for small requests, ecb/cbc/ctr(aes) only */
+	struct crypto_blkcipher *fallback;
 };
 
 struct qcrypto_cipher_req_ctx {
@@ -514,7 +530,22 @@ static int _qcrypto_ahash_hmac_cra_init(struct crypto_tfm *tfm)
 
 static int _qcrypto_cra_ablkcipher_init(struct crypto_tfm *tfm)
 {
+	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(tfm);
+	const char *name = tfm->__crt_alg->cra_name;
+
 	tfm->crt_ablkcipher.reqsize = sizeof(struct qcrypto_cipher_req_ctx);
+
+	ctx->fallback = NULL;
+	if (tfm->__crt_alg->cra_flags & CRYPTO_ALG_NEED_FALLBACK) {
+		ctx->fallback = crypto_alloc_blkcipher(name, 0,
+				CRYPTO_ALG_ASYNC | CRYPTO_ALG_NEED_FALLBACK);
+		/* not fatal, every request goes to the engine then */
+		if (IS_ERR(ctx->fallback)) {
+			pr_warn("%s: no software fallback for %s\n",
+				__func__, name);
+			ctx->fallback = NULL;
+		}
+	}
 	return _qcrypto_cipher_cra_init(tfm);
 };
 
@@ -528,6 +559,8 @@ static void _qcrypto_cra_ablkcipher_exit(struct crypto_tfm *tfm)
 {
 	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(tfm);
 
+	if (ctx->fallback)
+		crypto_free_blkcipher(ctx->fallback);
 	if (ctx->cp->platform_support.bus_scale_table != NULL)
 		qcrypto_ce_high_bw_req(ctx->cp, false);
 };
@@ -578,6 +611,9 @@ static int _disp_stats(int id)
 	len += snprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
 			"   ABLK CIPHER operation fail   : %d\n",
 					pstat->ablk_cipher_op_fail);
+	len += snprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
+			"   ABLK CIPHER software fallback: %d\n",
+					pstat->ablk_cipher_sw_fallback);
 
 	len += snprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
 			"   AEAD SHA1-AES encryption      : %d\n",
@@ -683,6 +719,11 @@ static int _qcrypto_setkey_aes(struct crypto_ablkcipher *cipher, const u8 *key,
 	};
 	ctx->enc_key_len = len;
 	memcpy(ctx->enc_key, key, len);
+	/* leave everything to the engine if the software cipher refuses it */
+	if (ctx->fallback && crypto_blkcipher_setkey(ctx->fallback, key, len)) {
+		crypto_free_blkcipher(ctx->fallback);
+		ctx->fallback = NULL;
+	}
 	return 0;
 };
 
@@ -730,14 +771,21 @@ static void req_done(unsigned long data)
 	struct crypto_priv *cp = (struct crypto_priv *)data;
 	unsigned long flags;
 
+	int res;
+
 	spin_lock_irqsave(&cp->lock, flags);
 	areq = cp->req;
+	res = cp->res;
 	cp->req = NULL;
 	spin_unlock_irqrestore(&cp->lock, flags);
 
-	if (areq)
-		areq->complete(areq, cp->res);
+	/*
+	 * Get the engine going on the next request before running the
+	 * completion, which may well queue more work or take a while.
+	 */
 	_start_qcrypto_process(cp);
+	if (areq)
+		areq->complete(areq, res);
 };
 
 static void _update_sha1_ctx(struct ahash_request  *req)
@@ -1317,12 +1365,62 @@ again:
 	};
 };
 
+/*
+ * Do a small cipher request on the cpu if enough is queued on the engine
+ * to keep it busy in the meantime.  Returns -EINPROGRESS when the request
+ * has to go to the engine.
+ */
+static int _qcrypto_ablk_cipher_sw(struct crypto_priv *cp,
+				struct crypto_async_request *async_req)
+{
+	struct ablkcipher_request *req;
+	struct qcrypto_cipher_req_ctx *rctx;
+	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(async_req->tfm);
+	struct blkcipher_desc desc;
+	unsigned long flags;
+	unsigned int depth;
+	int ret;
+
+	if (crypto_tfm_alg_type(async_req->tfm) != CRYPTO_ALG_TYPE_ABLKCIPHER)
+		return -EINPROGRESS;
+	/* a zero key length means the key is kept in the hardware */
+	if (!ctx->fallback || !ctx->enc_key_len || !sw_fallback_depth)
+		return -EINPROGRESS;
+	req = container_of(async_req, struct ablkcipher_request, base);
+	if (req->nbytes > sw_fallback_bytes)
+		return -EINPROGRESS;
+
+	spin_lock_irqsave(&cp->lock, flags);
+	depth = cp->queue.qlen + (cp->req ? 1 : 0);
+	spin_unlock_irqrestore(&cp->lock, flags);
+	if (depth < sw_fallback_depth)
+		return -EINPROGRESS;
+
+	rctx = ablkcipher_request_ctx(req);
+	desc.tfm = ctx->fallback;
+	desc.info = req->info;
+	desc.flags = async_req->flags & CRYPTO_TFM_REQ_MAY_SLEEP;
+	if (rctx->dir == QCE_ENCRYPT)
+		ret = crypto_blkcipher_encrypt_iv(&desc, req->dst, req->src,
+				req->nbytes);
+	else
+		ret = crypto_blkcipher_decrypt_iv(&desc, req->dst, req->src,
+				req->nbytes);
+
+	_qcrypto_stat[cp->pdev->id].ablk_cipher_sw_fallback++;
+	return ret;
+}
+
 static int _qcrypto_queue_req(struct crypto_priv *cp,
 				struct crypto_async_request *req)
 {
 	int ret;
 	unsigned long flags;
 
+	ret = _qcrypto_ablk_cipher_sw(cp, req);
+	if (ret != -EINPROGRESS)
+		return ret;
+
 	if (cp->platform_support.ce_shared) {
 		ret = qcrypto_lock_ce(cp);
 		if (ret)
@@ -2939,7 +3037,8 @@ static struct crypto_alg _qcrypto_ablk_cipher_algos[] = {
 		.cra_name		= "ecb(aes)",
 		.cra_driver_name	= "qcrypto-ecb-aes",
 		.cra_priority	= 300,
-		.cra_flags	= CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC,
+		.cra_flags	= CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC |
+				  CRYPTO_ALG_NEED_FALLBACK,
 		.cra_blocksize	= AES_BLOCK_SIZE,
 		.cra_ctxsize	= sizeof(struct qcrypto_cipher_ctx),
 		.cra_alignmask	= 0,
@@ -2961,7 +3060,8 @@ static struct crypto_alg _qcrypto_ablk_cipher_algos[] = {
 		.cra_name	= "cbc(aes)",
 		.cra_driver_name = "qcrypto-cbc-aes",
 		.cra_priority	= 300,
-		.cra_flags	= CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC,
+		.cra_flags	= CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC |
+				  CRYPTO_ALG_NEED_FALLBACK,
 		.cra_blocksize	= AES_BLOCK_SIZE,
 		.cra_ctxsize	= sizeof(struct qcrypto_cipher_ctx),
 		.cra_alignmask	= 0,
@@ -2984,7 +3084,8 @@ static struct crypto_alg _qcrypto_ablk_cipher_algos[] = {
 		.cra_name	= "ctr(aes)",
 		.cra_driver_name = "qcrypto-ctr-aes",
 		.cra_priority	= 300,
-		.cra_flags	= CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC,
+		.cra_flags	= CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC |
+				  CRYPTO_ALG_NEED_FALLBACK,
 		.cra_blocksize	= AES_BLOCK_SIZE,
 		.cra_ctxsize	= sizeof(struct qcrypto_cipher_ctx),
 		.cra_alignmask	= 0,
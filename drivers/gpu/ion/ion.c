@@ -33,7 +33,9 @@
 #include <linux/uaccess.h>
 #include <linux/debugfs.h>
 #include <linux/dma-buf.h>
+#include <linux/dma-mapping.h>
 
+#include <asm/sizes.h>
 #include <mach/iommu_domains.h>
 #include "ion_priv.h"
 #define DEBUG
@@ -222,6 +224,12 @@ static struct ion_buffer *ion_buffer_create(struct ion_heap *heap,
 
 	buffer->heap = heap;
 	kref_init(&buffer->ref);
+	/*
+	 * The memory may still have lines in the CPU caches from its last
+	 * user or from being zeroed, heaps that know better clear these.
+	 */
+	buffer->cpu_cached = 1;
+	buffer->cpu_dirty = 1;
 
 	ret = heap->ops->allocate(heap, buffer, len, align, flags);
 	if (ret) {
@@ -245,9 +253,77 @@ static struct ion_buffer *ion_buffer_create(struct ion_heap *heap,
 	return buffer;
 }
 
+/*
+ * IOMMU mappings no client holds any more are kept on an LRU instead of
+ * being torn down, so a buffer going back and forth between devices is
+ * not remapped on every handoff. Every mapping holds a reference of its
+ * own for this, delayed unmap ones are just never put on the LRU. Idle
+ * mappings are dropped beyond ION_IOMMU_IDLE_MAX bytes of iova space,
+ * when a domain runs out of iova space and when their buffer goes away.
+ * A mapping only moves on or off the LRU with its buffer->lock held.
+ * ion_iommu_idle_lock nests inside buffer->lock, so buffers are only
+ * trylocked with it held.
+ */
+#define ION_IOMMU_IDLE_MAX	SZ_256M
+
+static LIST_HEAD(ion_iommu_idle_lru);
+static DEFINE_MUTEX(ion_iommu_idle_lock);
+static unsigned long ion_iommu_idle_size;
+
+/* must be called with ion_iommu_idle_lock held */
+static void __ion_iommu_idle_del(struct ion_iommu_map *map)
+{
+	if (list_empty(&map->idle))
+		return;
+	list_del_init(&map->idle);
+	ion_iommu_idle_size -= map->mapped_size;
+}
+
+static void ion_iommu_idle_del(struct ion_iommu_map *map)
+{
+	mutex_lock(&ion_iommu_idle_lock);
+	__ion_iommu_idle_del(map);
+	mutex_unlock(&ion_iommu_idle_lock);
+}
+
+/*
+ * Unmap the least recently used idle mappings of @domain_num, or of all
+ * domains for -1, until at most @max bytes are idle.
+ * Must be called with ion_iommu_idle_lock held.
+ */
+static void ion_iommu_idle_trim(int domain_num, unsigned long max)
+{
+	struct ion_iommu_map *map, *tmp;
+	struct ion_buffer *buffer;
+
+	list_for_each_entry_safe_reverse(map, tmp, &ion_iommu_idle_lru, idle) {
+		if (ion_iommu_idle_size <= max)
+			break;
+		if (domain_num >= 0 && iommu_map_domain(map) != domain_num)
+			continue;
+		buffer = map->buffer;
+		/* a busy buffer is likely to need its mappings again */
+		if (!mutex_trylock(&buffer->lock))
+			continue;
+		__ion_iommu_idle_del(map);
+		kref_put(&map->ref, ion_iommu_release);
+		mutex_unlock(&buffer->lock);
+	}
+}
+
+/* must be called with buffer->lock held */
+static void ion_iommu_idle_add(struct ion_iommu_map *map)
+{
+	mutex_lock(&ion_iommu_idle_lock);
+	list_add(&map->idle, &ion_iommu_idle_lru);
+	ion_iommu_idle_size += map->mapped_size;
+	ion_iommu_idle_trim(-1, ION_IOMMU_IDLE_MAX);
+	mutex_unlock(&ion_iommu_idle_lock);
+}
+
 /**
- * Check for delayed IOMMU unmapping. Also unmap any outstanding
- * mappings which would otherwise have been leaked.
+ * Unmap the mappings of a buffer that is going away. Any mapping still
+ * held by a client would otherwise have been leaked.
  */
 static void ion_iommu_delayed_unmap(struct ion_buffer *buffer)
 {
@@ -255,20 +331,19 @@ static void ion_iommu_delayed_unmap(struct ion_buffer *buffer)
 	struct rb_node *node;
 	const struct rb_root *rb = &(buffer->iommu_maps);
 	unsigned long ref_count;
-	unsigned int delayed_unmap;
 
 	mutex_lock(&buffer->lock);
 
 	while ((node = rb_first(rb)) != 0) {
 		iommu_map = rb_entry(node, struct ion_iommu_map, node);
 		ref_count = atomic_read(&iommu_map->ref.refcount);
-		delayed_unmap = iommu_map->flags & ION_IOMMU_UNMAP_DELAYED;
 
-		if ((delayed_unmap && ref_count > 1) || !delayed_unmap) {
+		if (ref_count > 1) {
 			pr_err("%s: Virtual memory address leak in domain %u, partition %u\n",
 				__func__, iommu_map->domain_info[DI_DOMAIN_NUM],
 				iommu_map->domain_info[DI_PARTITION_NUM]);
 		}
+		ion_iommu_idle_del(iommu_map);
 		/* set ref count to 1 to force release */
 		kref_init(&iommu_map->ref);
 		kref_put(&iommu_map->ref, ion_iommu_release);
@@ -542,6 +617,45 @@ int ion_phys(struct ion_client *client, struct ion_handle *handle,
 }
 EXPORT_SYMBOL(ion_phys);
 
+/*
+ * The CPU caches only get lines of a buffer through a mapping, and dirty
+ * lines only through a writable one. Both stay possible while such a
+ * mapping exists. Otherwise they are gone after the whole buffer was
+ * invalidated, or cleaned for dirty lines.
+ * Must be called with buffer->lock held.
+ */
+static unsigned int ion_buffer_cache_op_needed(struct ion_buffer *buffer,
+					       unsigned int cmd)
+{
+	switch (cmd) {
+	case ION_IOC_CLEAN_CACHES:
+		return buffer->cpu_dirty ? cmd : 0;
+	case ION_IOC_INV_CACHES:
+		return buffer->cpu_cached ? cmd : 0;
+	case ION_IOC_CLEAN_INV_CACHES:
+		if (!buffer->cpu_cached)
+			return 0;
+		/* nothing to write back, dropping the lines is enough */
+		return buffer->cpu_dirty ? cmd : ION_IOC_INV_CACHES;
+	default:
+		return cmd;
+	}
+}
+
+static void ion_buffer_cache_op_done(struct ion_buffer *buffer,
+				     unsigned long offset, unsigned long len,
+				     unsigned int cmd)
+{
+	if (offset || len < buffer->size)
+		return;
+
+	if (!buffer->kmap_cnt && !buffer->umap_write_cnt)
+		buffer->cpu_dirty = 0;
+	if (cmd != ION_IOC_CLEAN_CACHES && !buffer->kmap_cnt &&
+	    !buffer->umap_cnt)
+		buffer->cpu_cached = 0;
+}
+
 static void *ion_buffer_kmap_get(struct ion_buffer *buffer)
 {
 	void *vaddr;
@@ -555,6 +669,8 @@ static void *ion_buffer_kmap_get(struct ion_buffer *buffer)
 		return vaddr;
 	buffer->vaddr = vaddr;
 	buffer->kmap_cnt++;
+	buffer->cpu_cached = 1;
+	buffer->cpu_dirty = 1;
 	return vaddr;
 }
 
@@ -608,6 +724,7 @@ static struct ion_iommu_map *__ion_iommu_map(struct ion_buffer *buffer,
 	data->buffer = buffer;
 	iommu_map_domain(data) = domain_num;
 	iommu_map_partition(data) = partition_num;
+	INIT_LIST_HEAD(&data->idle);
 
 	ret = buffer->heap->ops->map_iommu(buffer, data,
 						domain_num,
@@ -693,14 +810,34 @@ int ion_map_iommu(struct ion_client *client, struct ion_handle *handle,
 	}
 
 	iommu_map = ion_iommu_lookup(buffer, domain_num, partition_num);
+	if (iommu_map && !list_empty(&iommu_map->idle)) {
+		ion_iommu_idle_del(iommu_map);
+		/* an idle mapping made differently is not worth an error */
+		if (iommu_map->flags != iommu_flags ||
+		    iommu_map->mapped_size != iova_length) {
+			kref_put(&iommu_map->ref, ion_iommu_release);
+			iommu_map = NULL;
+		}
+	}
+
 	if (!iommu_map) {
 		iommu_map = __ion_iommu_map(buffer, domain_num, partition_num,
 					    align, iova_length, flags, iova);
+		if (PTR_ERR(iommu_map) == -ENOMEM) {
+			/* idle mappings may be holding the iova space */
+			mutex_lock(&ion_iommu_idle_lock);
+			ion_iommu_idle_trim(domain_num, 0);
+			mutex_unlock(&ion_iommu_idle_lock);
+			iommu_map = __ion_iommu_map(buffer, domain_num,
+					partition_num, align, iova_length,
+					flags, iova);
+		}
 		if (!IS_ERR_OR_NULL(iommu_map)) {
 			iommu_map->flags = iommu_flags;
-
-			if (iommu_map->flags & ION_IOMMU_UNMAP_DELAYED)
-				kref_get(&iommu_map->ref);
+			/* kept while idle or until the delayed unmap */
+			kref_get(&iommu_map->ref);
+		} else {
+			ret = iommu_map ? PTR_ERR(iommu_map) : -ENOMEM;
 		}
 	} else {
 		if (iommu_map->flags != iommu_flags) {
@@ -753,13 +890,16 @@ void ion_unmap_iommu(struct ion_client *client, struct ion_handle *handle,
 
 	iommu_map = ion_iommu_lookup(buffer, domain_num, partition_num);
 
-	if (!iommu_map) {
+	if (!iommu_map || !list_empty(&iommu_map->idle)) {
 		WARN(1, "%s: (%d,%d) was never mapped for %p\n", __func__,
 				domain_num, partition_num, buffer);
 		goto out;
 	}
 
 	kref_put(&iommu_map->ref, ion_iommu_release);
+	if (atomic_read(&iommu_map->ref.refcount) == 1 &&
+	    !(iommu_map->flags & ION_IOMMU_UNMAP_DELAYED))
+		ion_iommu_idle_add(iommu_map);
 
 	buffer->iommu_map_cnt--;
 out:
@@ -866,16 +1006,26 @@ int ion_do_cache_op(struct ion_client *client, struct ion_handle *handle,
 		goto out;
 	}
 
+	cmd = ion_buffer_cache_op_needed(buffer, cmd);
+	if (!cmd) {
+		ret = 0;
+		goto out;
+	}
+
 	if (!handle->buffer->heap->ops->cache_op) {
 		pr_err("%s: cache_op is not implemented by this heap.\n",
 		       __func__);
 		ret = -ENODEV;
 		goto out;
 	}
-
-
-	ret = buffer->heap->ops->cache_op(buffer->heap, buffer, uaddr,
-						offset, len, cmd);
+	/* a large buffer is cheaper to handle as part of all caches */
+	if (dma_cache_maint_all(len))
+		ret = 0;
+	else
+		ret = buffer->heap->ops->cache_op(buffer->heap, buffer, uaddr,
+						  offset, len, cmd);
+	if (!ret)
+		ion_buffer_cache_op_done(buffer, offset, len, cmd);
 
 out:
 	mutex_unlock(&buffer->lock);
@@ -1130,6 +1280,8 @@ static void ion_vma_open(struct vm_area_struct *vma)
 
 	mutex_lock(&buffer->lock);
 	buffer->umap_cnt++;
+	if (vma->vm_flags & VM_WRITE)
+		buffer->umap_write_cnt++;
 	mutex_unlock(&buffer->lock);
 }
 
@@ -1141,6 +1293,8 @@ static void ion_vma_close(struct vm_area_struct *vma)
 
 	mutex_lock(&buffer->lock);
 	buffer->umap_cnt--;
+	if (vma->vm_flags & VM_WRITE)
+		buffer->umap_write_cnt--;
 	mutex_unlock(&buffer->lock);
 
 	if (buffer->heap->ops->unmap_user)
@@ -1163,6 +1317,10 @@ static int ion_mmap(struct dma_buf *dmabuf, struct vm_area_struct *vma)
 		return -EINVAL;
 	}
 
+	/* keep the count of writable mappings right across mprotect() */
+	if (!(vma->vm_flags & VM_WRITE))
+		vma->vm_flags &= ~VM_MAYWRITE;
+
 	mutex_lock(&buffer->lock);
 	/* now map it to userspace */
 	ret = buffer->heap->ops->map_user(buffer->heap, buffer, vma);
@@ -1173,6 +1331,11 @@ static int ion_mmap(struct dma_buf *dmabuf, struct vm_area_struct *vma)
 		       __func__);
 	} else {
 		buffer->umap_cnt++;
+		buffer->cpu_cached = 1;
+		if (vma->vm_flags & VM_WRITE) {
+			buffer->umap_write_cnt++;
+			buffer->cpu_dirty = 1;
+		}
 		mutex_unlock(&buffer->lock);
 
 		vma->vm_ops = &ion_vm_ops;
@@ -27,6 +27,8 @@
 #include <linux/seq_file.h>
 #include <linux/fmem.h>
 #include <linux/iommu.h>
+#include <linux/dma-contiguous.h>
+#include <linux/vmalloc.h>
 
 #include <asm/mach/map.h>
 
@@ -72,6 +74,8 @@
  * @iommu_map_all:	Indicates whether we should map whole heap into IOMMU.
  * @iommu_2x_map_domain: Indicates the domain to use for overmapping.
  * @has_outer_cache:    set to 1 if outer cache is used, 0 otherwise.
+ * @cma_dev:	device whose CMA area backs the heap, NULL for a carveout.
+ * @cma_pages:	first page of the CMA area while it is claimed by the heap.
 */
 struct ion_cp_heap {
 	struct ion_heap heap;
@@ -98,6 +102,8 @@ struct ion_cp_heap {
 	int iommu_2x_map_domain;
 	unsigned int has_outer_cache;
 	atomic_t protect_cnt;
+	struct device *cma_dev;
+	struct page *cma_pages;
 };
 
 enum {
@@ -123,6 +129,64 @@ static unsigned long ion_cp_get_total_kmap_count(
 	return cp_heap->kmap_cached_count + cp_heap->kmap_uncached_count;
 }
 
+/**
+ * Take the CMA area backing the heap out of the page allocator. The pages
+ * in use are migrated away, which can take a while. Does nothing for a
+ * carveout heap or when the area is already claimed.
+ * Must be called with heap->lock locked.
+ */
+static int ion_cp_cma_claim(struct ion_cp_heap *cp_heap)
+{
+	int count = cp_heap->total_size >> PAGE_SHIFT;
+	struct page *page;
+	void *vaddr;
+
+	if (!cp_heap->cma_dev || cp_heap->cma_pages)
+		return 0;
+
+	page = dma_alloc_from_contiguous(cp_heap->cma_dev, count, 0);
+	if (!page) {
+		pr_err("%s: unable to claim CMA area of heap %s\n", __func__,
+			cp_heap->heap.name);
+		return -ENOMEM;
+	}
+	if (page_to_phys(page) != cp_heap->base) {
+		pr_err("%s: CMA area of heap %s is not at %lx\n", __func__,
+			cp_heap->heap.name, cp_heap->base);
+		dma_release_from_contiguous(cp_heap->cma_dev, page, count);
+		return -EBUSY;
+	}
+
+	/*
+	 * Lines left dirty by the previous users must not be written back
+	 * once the memory is protected.
+	 */
+	vaddr = page_address(page);
+	dmac_flush_range(vaddr, vaddr + cp_heap->total_size);
+	if (cp_heap->has_outer_cache)
+		outer_flush_range(cp_heap->base,
+				  cp_heap->base + cp_heap->total_size);
+
+	cp_heap->cma_pages = page;
+	return 0;
+}
+
+/**
+ * Give the CMA area back to the page allocator, unless the heap still has
+ * buffers or is protected.
+ * Must be called with heap->lock locked.
+ */
+static void ion_cp_cma_release(struct ion_cp_heap *cp_heap)
+{
+	if (!cp_heap->cma_pages || cp_heap->allocated_bytes ||
+	    cp_heap->heap_protected == HEAP_PROTECTED)
+		return;
+
+	dma_release_from_contiguous(cp_heap->cma_dev, cp_heap->cma_pages,
+				    cp_heap->total_size >> PAGE_SHIFT);
+	cp_heap->cma_pages = NULL;
+}
+
 /**
  * Protects memory if heap is unsecured heap. Also ensures that we are in
  * the correct FMEM state if this heap is a reusable heap.
@@ -142,6 +206,12 @@ static int ion_cp_protect(struct ion_heap *heap, int version, void *data)
 				goto out;
 		}
 
+		ret_value = ion_cp_cma_claim(cp_heap);
+		if (ret_value) {
+			atomic_dec(&cp_heap->protect_cnt);
+			goto out;
+		}
+
 		ret_value = ion_cp_protect_mem(cp_heap->secure_base,
 				cp_heap->secure_size, cp_heap->permission_type,
 				version, data);
@@ -154,6 +224,7 @@ static int ion_cp_protect(struct ion_heap *heap, int version, void *data)
 					pr_err("%s: unable to transition heap to T-state\n",
 						__func__);
 			}
+			ion_cp_cma_release(cp_heap);
 			atomic_dec(&cp_heap->protect_cnt);
 		} else {
 			cp_heap->heap_protected = HEAP_PROTECTED;
@@ -195,6 +266,7 @@ static void ion_cp_unprotect(struct ion_heap *heap, int version, void *data)
 					pr_err("%s: unable to transition heap to T-state",
 						__func__);
 			}
+			ion_cp_cma_release(cp_heap);
 		}
 	}
 	pr_debug("%s: protect count is %d\n", __func__,
@@ -242,6 +314,12 @@ ion_phys_addr_t ion_cp_allocate(struct ion_heap *heap,
 		}
 	}
 
+	/* the first buffer of a CMA backed heap migrates the area out */
+	if (ion_cp_cma_claim(cp_heap)) {
+		mutex_unlock(&cp_heap->lock);
+		return ION_CP_ALLOCATE_FAIL;
+	}
+
 	cp_heap->allocated_bytes += size;
 	mutex_unlock(&cp_heap->lock);
 
@@ -266,6 +344,7 @@ ion_phys_addr_t ion_cp_allocate(struct ion_heap *heap,
 				pr_err("%s: unable to transition heap to T-state\n",
 					__func__);
 		}
+		ion_cp_cma_release(cp_heap);
 		mutex_unlock(&cp_heap->lock);
 
 		return ION_CP_ALLOCATE_FAIL;
@@ -316,6 +395,7 @@ void ion_cp_free(struct ion_heap *heap, ion_phys_addr_t addr,
 			pr_err("%s: unable to transition heap to T-state\n",
 				__func__);
 	}
+	ion_cp_cma_release(cp_heap);
 
 	/* Unmap everything if we previously mapped the whole heap at once. */
 	if (!cp_heap->allocated_bytes) {
@@ -449,6 +529,31 @@ void *ion_map_fmem_buffer(struct ion_buffer *buffer, unsigned long phys_base,
 		return NULL;
 }
 
+/**
+ * A CMA backed heap is RAM, which cannot be ioremapped. Cached buffers use
+ * the linear mapping, uncached ones get a write combined alias.
+ */
+static void *ion_cp_cma_map_kernel(struct ion_buffer *buffer)
+{
+	int npages = PAGE_ALIGN(buffer->size) >> PAGE_SHIFT;
+	struct page *page = phys_to_page(buffer->priv_phys);
+	struct page **pages;
+	void *vaddr;
+	int i;
+
+	if (ION_IS_CACHED(buffer->flags))
+		return page_address(page);
+
+	pages = kmalloc(npages * sizeof(struct page *), GFP_KERNEL);
+	if (!pages)
+		return NULL;
+	for (i = 0; i < npages; i++)
+		pages[i] = page + i;
+	vaddr = vmap(pages, npages, VM_MAP, pgprot_writecombine(PAGE_KERNEL));
+	kfree(pages);
+	return vaddr;
+}
+
 void *ion_cp_heap_map_kernel(struct ion_heap *heap, struct ion_buffer *buffer)
 {
 	struct ion_cp_heap *cp_heap =
@@ -469,6 +574,8 @@ void *ion_cp_heap_map_kernel(struct ion_heap *heap, struct ion_buffer *buffer)
 			ret_value = ion_map_fmem_buffer(buffer, cp_heap->base,
 				cp_heap->reserved_vrange, buffer->flags);
 
+		} else if (cp_heap->cma_dev) {
+			ret_value = ion_cp_cma_map_kernel(buffer);
 		} else {
 			if (ION_IS_CACHED(buffer->flags))
 				ret_value = ioremap_cached(buffer->priv_phys,
@@ -499,8 +606,10 @@ void ion_cp_heap_unmap_kernel(struct ion_heap *heap,
 
 	if (cp_heap->reusable)
 		unmap_kernel_range((unsigned long)buffer->vaddr, buffer->size);
-	else
+	else if (!cp_heap->cma_dev)
 		__arm_iounmap(buffer->vaddr);
+	else if (!ION_IS_CACHED(buffer->flags))
+		vunmap(buffer->vaddr);
 
 	buffer->vaddr = NULL;
 
@@ -616,6 +725,9 @@ static int ion_cp_print_debug(struct ion_heap *heap, struct seq_file *s,
 	seq_printf(s, "kmapping count: %lx\n", kmap_count);
 	seq_printf(s, "heap protected: %s\n", heap_protected ? "Yes" : "No");
 	seq_printf(s, "reusable: %s\n", cp_heap->reusable  ? "Yes" : "No");
+	if (cp_heap->cma_dev)
+		seq_printf(s, "CMA area claimed: %s\n",
+			   cp_heap->cma_pages ? "Yes" : "No");
 
 	if (mem_map) {
 		unsigned long base = cp_heap->base;
@@ -939,6 +1051,8 @@ struct ion_heap *ion_cp_heap_create(struct ion_platform_heap *heap_data)
 		struct ion_cp_heap_pdata *extra_data =
 				heap_data->extra_data;
 		cp_heap->reusable = extra_data->reusable;
+		if (!cp_heap->reusable)
+			cp_heap->cma_dev = extra_data->cma_dev;
 		cp_heap->reserved_vrange = extra_data->virt_addr;
 		cp_heap->permission_type = extra_data->permission_type;
 		if (extra_data->secure_size) {
@@ -974,6 +1088,9 @@ void ion_cp_heap_destroy(struct ion_heap *heap)
 	struct ion_cp_heap *cp_heap =
 	     container_of(heap, struct  ion_cp_heap, heap);
 
+	if (cp_heap->cma_pages)
+		dma_release_from_contiguous(cp_heap->cma_dev,
+			cp_heap->cma_pages, cp_heap->total_size >> PAGE_SHIFT);
 	gen_pool_destroy(cp_heap->pool);
 	kfree(cp_heap);
 	cp_heap = NULL;
@@ -29,6 +29,7 @@
 struct ion_iommu_heap {
 	struct ion_heap heap;
 	unsigned int has_outer_cache;
+	struct ion_page_pool *pools[ION_PAGE_POOL_ORDERS];
 };
 
 struct ion_iommu_priv_data {
@@ -42,13 +43,15 @@ static int ion_iommu_heap_allocate(struct ion_heap *heap,
 				      unsigned long size, unsigned long align,
 				      unsigned long flags)
 {
-	int ret, i;
+	struct ion_iommu_heap *iommu_heap =
+	     container_of(heap, struct  ion_iommu_heap, heap);
+	int ret;
 	struct ion_iommu_priv_data *data = NULL;
 
 	if (msm_use_iommu()) {
 		struct scatterlist *sg;
 		struct sg_table *table;
-		unsigned int i;
+		unsigned int i, j, k = 0;
 
 		data = kmalloc(sizeof(*data), GFP_KERNEL);
 		if (!data)
@@ -63,43 +66,28 @@ static int ion_iommu_heap_allocate(struct ion_heap *heap,
 			goto err1;
 		}
 
-		table = buffer->sg_table =
-				kzalloc(sizeof(struct sg_table), GFP_KERNEL);
-
+		table = ion_page_pools_alloc(iommu_heap->pools, data->size);
 		if (!table) {
 			ret = -ENOMEM;
-			goto err1;
-		}
-		ret = sg_alloc_table(table, data->nrpages, GFP_KERNEL);
-		if (ret)
 			goto err2;
-
-		for_each_sg(table->sgl, sg, table->nents, i) {
-			data->pages[i] = alloc_page(GFP_KERNEL | __GFP_ZERO);
-			if (!data->pages[i])
-				goto err3;
-
-			sg_set_page(sg, data->pages[i], PAGE_SIZE, 0);
 		}
+		buffer->sg_table = table;
+
+		for_each_sg(table->sgl, sg, table->nents, i)
+			for (j = 0; j < sg->length / PAGE_SIZE; j++)
+				data->pages[k++] = nth_page(sg_page(sg), j);
 
 		buffer->priv_virt = data;
+		/* pool chunks are clean in the CPU caches */
+		buffer->cpu_cached = 0;
+		buffer->cpu_dirty = 0;
 		return 0;
 
 	} else {
 		return -ENOMEM;
 	}
 
-
-err3:
-	sg_free_table(buffer->sg_table);
 err2:
-	kfree(buffer->sg_table);
-	buffer->sg_table = 0;
-
-	for (i = 0; i < data->nrpages; i++) {
-		if (data->pages[i])
-			__free_page(data->pages[i]);
-	}
 	kfree(data->pages);
 err1:
 	kfree(data);
@@ -108,14 +96,19 @@ err1:
 
 static void ion_iommu_heap_free(struct ion_buffer *buffer)
 {
+	struct ion_iommu_heap *iommu_heap =
+	     container_of(buffer->heap, struct  ion_iommu_heap, heap);
 	struct ion_iommu_priv_data *data = buffer->priv_virt;
-	int i;
 
 	if (!data)
 		return;
 
-	for (i = 0; i < data->nrpages; i++)
-		__free_page(data->pages[i]);
+	if (buffer->sg_table) {
+		ion_page_pools_free(iommu_heap->pools, buffer->sg_table);
+		sg_free_table(buffer->sg_table);
+		kfree(buffer->sg_table);
+		buffer->sg_table = NULL;
+	}
 
 	kfree(data->pages);
 	kfree(data);
@@ -287,15 +280,18 @@ static int ion_iommu_cache_ops(struct ion_heap *heap, struct ion_buffer *buffer,
 	}
 
 	if (iommu_heap->has_outer_cache) {
-		unsigned long pstart;
-		unsigned int i;
+		unsigned long pstart, start, end, next;
 		struct ion_iommu_priv_data *data = buffer->priv_virt;
 		if (!data)
 			return -ENOMEM;
 
-		for (i = 0; i < data->nrpages; ++i) {
-			pstart = page_to_phys(data->pages[i]);
-			outer_cache_op(pstart, pstart + PAGE_SIZE);
+		/* only the pages backing [offset, offset + length) */
+		end = min_t(unsigned long, offset + length, data->size);
+		for (start = offset; start < end; start = next) {
+			next = min(end, (start & PAGE_MASK) + PAGE_SIZE);
+			pstart = page_to_phys(data->pages[start >> PAGE_SHIFT]) +
+				 (start & ~PAGE_MASK);
+			outer_cache_op(pstart, pstart + next - start);
 		}
 	}
 	return 0;
@@ -310,10 +306,7 @@ static struct sg_table *ion_iommu_heap_map_dma(struct ion_heap *heap,
 static void ion_iommu_heap_unmap_dma(struct ion_heap *heap,
 				 struct ion_buffer *buffer)
 {
-	if (buffer->sg_table)
-		sg_free_table(buffer->sg_table);
-	kfree(buffer->sg_table);
-	buffer->sg_table = 0;
+	/* the table describes the chunks to return, free() releases it */
 }
 
 static struct ion_heap_ops iommu_heap_ops = {
@@ -337,6 +330,11 @@ struct ion_heap *ion_iommu_heap_create(struct ion_platform_heap *heap_data)
 	if (!iommu_heap)
 		return ERR_PTR(-ENOMEM);
 
+	if (ion_page_pools_create(iommu_heap->pools)) {
+		kfree(iommu_heap);
+		return ERR_PTR(-ENOMEM);
+	}
+
 	iommu_heap->heap.ops = &iommu_heap_ops;
 	iommu_heap->heap.type = ION_HEAP_TYPE_IOMMU;
 	iommu_heap->has_outer_cache = heap_data->has_outer_cache;
@@ -349,6 +347,7 @@ void ion_iommu_heap_destroy(struct ion_heap *heap)
 	struct ion_iommu_heap *iommu_heap =
 	     container_of(heap, struct  ion_iommu_heap, heap);
 
+	ion_page_pools_destroy(iommu_heap->pools);
 	kfree(iommu_heap);
 	iommu_heap = NULL;
 }
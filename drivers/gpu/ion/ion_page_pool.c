@@ -0,0 +1,379 @@
+/*
+ * drivers/gpu/ion/ion_page_pool.c
+ *
+ * Copyright (c) 2012, Code Aurora Forum. All rights reserved.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/err.h>
+#include <linux/init.h>
+#include <linux/list.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/scatterlist.h>
+#include <linux/sched.h>
+#include <linux/shrinker.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+#include <asm/cacheflush.h>
+#include "ion_priv.h"
+
+/*
+ * Pages are kept in chunks of 2^order pages.  Freed chunks go on the
+ * dirty list and are zeroed by a work item before they can be handed
+ * out again, so neither the allocation nor the free of a buffer has to
+ * touch the memory.  All pools are trimmed by a single shrinker.
+ */
+
+const unsigned int ion_page_pool_orders[ION_PAGE_POOL_ORDERS] = {8, 4, 0};
+
+static LIST_HEAD(ion_page_pools);
+static DEFINE_MUTEX(ion_page_pools_lock);
+
+static struct page *ion_page_pool_alloc_pages(struct ion_page_pool *pool)
+{
+	struct page *page = alloc_pages(pool->gfp_mask, pool->order);
+	void *addr;
+	size_t size = PAGE_SIZE << pool->order;
+
+	if (!page)
+		return NULL;
+	/* hand out chunks clean in the CPU caches, like zeroed ones */
+	addr = page_address(page);
+	dmac_flush_range(addr, addr + size);
+	outer_flush_range(page_to_phys(page), page_to_phys(page) + size);
+	/* the heaps map and refcount every page of a chunk on its own */
+	if (pool->order)
+		split_page(page, pool->order);
+	return page;
+}
+
+static void ion_page_pool_free_pages(struct ion_page_pool *pool,
+				     struct page *page)
+{
+	int i;
+
+	for (i = 0; i < (1 << pool->order); i++)
+		__free_page(page + i);
+}
+
+static void ion_page_pool_zero(struct ion_page_pool *pool, struct page *page)
+{
+	void *addr = page_address(page);
+	size_t size = PAGE_SIZE << pool->order;
+
+	memset(addr, 0, size);
+	/* buffers may be mapped uncached, so push the zeroes out */
+	dmac_flush_range(addr, addr + size);
+	outer_flush_range(page_to_phys(page), page_to_phys(page) + size);
+}
+
+/* take a chunk off @list, which must not be empty */
+static struct page *ion_page_pool_remove(struct list_head *list)
+{
+	struct page *page = list_first_entry(list, struct page, lru);
+
+	list_del(&page->lru);
+	return page;
+}
+
+static void ion_page_pool_zero_work(struct work_struct *work)
+{
+	struct ion_page_pool *pool = container_of(work, struct ion_page_pool,
+						  zero_work);
+	struct page *page;
+
+	for (;;) {
+		mutex_lock(&pool->mutex);
+		if (!pool->dirty_count) {
+			mutex_unlock(&pool->mutex);
+			break;
+		}
+		page = ion_page_pool_remove(&pool->dirty_items);
+		pool->dirty_count--;
+		mutex_unlock(&pool->mutex);
+
+		ion_page_pool_zero(pool, page);
+
+		mutex_lock(&pool->mutex);
+		list_add(&page->lru, &pool->items);
+		pool->count++;
+		mutex_unlock(&pool->mutex);
+		cond_resched();
+	}
+}
+
+/**
+ * ion_page_pool_alloc - get a zeroed chunk of 2^order pages
+ * @pool:	the pool
+ *
+ * Falls back to zeroing a freed chunk in place and then to the page
+ * allocator when the pool has nothing ready.
+ */
+struct page *ion_page_pool_alloc(struct ion_page_pool *pool)
+{
+	struct page *page = NULL;
+	bool dirty = false;
+
+	mutex_lock(&pool->mutex);
+	if (pool->count) {
+		page = ion_page_pool_remove(&pool->items);
+		pool->count--;
+	} else if (pool->dirty_count) {
+		page = ion_page_pool_remove(&pool->dirty_items);
+		pool->dirty_count--;
+		dirty = true;
+	}
+	mutex_unlock(&pool->mutex);
+
+	if (!page)
+		return ion_page_pool_alloc_pages(pool);
+	if (dirty)
+		ion_page_pool_zero(pool, page);
+	return page;
+}
+
+/**
+ * ion_page_pool_free - give a chunk back to its pool
+ * @pool:	the pool the chunk came from
+ * @page:	first page of the chunk
+ *
+ * The chunk is zeroed later from a work item.
+ */
+void ion_page_pool_free(struct ion_page_pool *pool, struct page *page)
+{
+	mutex_lock(&pool->mutex);
+	list_add_tail(&page->lru, &pool->dirty_items);
+	pool->dirty_count++;
+	mutex_unlock(&pool->mutex);
+
+	queue_work(system_unbound_wq, &pool->zero_work);
+}
+
+/**
+ * ion_page_pool_total - number of pages held by a pool
+ * @pool:	the pool
+ */
+int ion_page_pool_total(struct ion_page_pool *pool)
+{
+	return (pool->count + pool->dirty_count) << pool->order;
+}
+
+/* release up to @nr_to_scan pages, dirty chunks first */
+static int ion_page_pool_shrink(struct ion_page_pool *pool, int nr_to_scan)
+{
+	struct page *page;
+	int freed = 0;
+
+	while (freed < nr_to_scan) {
+		mutex_lock(&pool->mutex);
+		if (pool->dirty_count) {
+			page = ion_page_pool_remove(&pool->dirty_items);
+			pool->dirty_count--;
+		} else if (pool->count) {
+			page = ion_page_pool_remove(&pool->items);
+			pool->count--;
+		} else {
+			mutex_unlock(&pool->mutex);
+			break;
+		}
+		mutex_unlock(&pool->mutex);
+
+		ion_page_pool_free_pages(pool, page);
+		freed += 1 << pool->order;
+	}
+	return freed;
+}
+
+static int ion_page_pool_shrinker_fn(struct shrinker *shrinker,
+				     struct shrink_control *sc)
+{
+	struct ion_page_pool *pool;
+	int nr_to_scan = sc->nr_to_scan;
+	int total = 0;
+
+	mutex_lock(&ion_page_pools_lock);
+	list_for_each_entry(pool, &ion_page_pools, list) {
+		if (nr_to_scan > 0)
+			nr_to_scan -= ion_page_pool_shrink(pool, nr_to_scan);
+		total += ion_page_pool_total(pool);
+	}
+	mutex_unlock(&ion_page_pools_lock);
+
+	return total;
+}
+
+static struct shrinker ion_page_pool_shrinker = {
+	.shrink = ion_page_pool_shrinker_fn,
+	.seeks = DEFAULT_SEEKS,
+};
+
+/**
+ * ion_page_pool_create - create a pool of 2^order page chunks
+ * @gfp_mask:	flags used to refill the pool, must include __GFP_ZERO
+ * @order:	chunk order
+ */
+struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order)
+{
+	struct ion_page_pool *pool = kzalloc(sizeof(*pool), GFP_KERNEL);
+
+	if (!pool)
+		return NULL;
+
+	INIT_LIST_HEAD(&pool->items);
+	INIT_LIST_HEAD(&pool->dirty_items);
+	mutex_init(&pool->mutex);
+	INIT_WORK(&pool->zero_work, ion_page_pool_zero_work);
+	pool->gfp_mask = gfp_mask;
+	pool->order = order;
+
+	mutex_lock(&ion_page_pools_lock);
+	list_add_tail(&pool->list, &ion_page_pools);
+	mutex_unlock(&ion_page_pools_lock);
+	return pool;
+}
+
+void ion_page_pool_destroy(struct ion_page_pool *pool)
+{
+	mutex_lock(&ion_page_pools_lock);
+	list_del(&pool->list);
+	mutex_unlock(&ion_page_pools_lock);
+
+	cancel_work_sync(&pool->zero_work);
+	ion_page_pool_shrink(pool, INT_MAX);
+	kfree(pool);
+}
+
+/**
+ * ion_page_pools_create - create one pool per ion_page_pool_orders entry
+ * @pools:	array of ION_PAGE_POOL_ORDERS pools to fill in
+ */
+int ion_page_pools_create(struct ion_page_pool **pools)
+{
+	gfp_t gfp;
+	int i;
+
+	for (i = 0; i < ION_PAGE_POOL_ORDERS; i++) {
+		gfp = GFP_KERNEL | __GFP_ZERO;
+		/* never stall in reclaim for a large chunk, use smaller ones */
+		if (ion_page_pool_orders[i])
+			gfp = (gfp | __GFP_NOWARN | __GFP_NORETRY) &
+			      ~__GFP_WAIT;
+		pools[i] = ion_page_pool_create(gfp, ion_page_pool_orders[i]);
+		if (!pools[i])
+			goto err;
+	}
+	return 0;
+err:
+	while (--i >= 0)
+		ion_page_pool_destroy(pools[i]);
+	return -ENOMEM;
+}
+
+void ion_page_pools_destroy(struct ion_page_pool **pools)
+{
+	int i;
+
+	for (i = 0; i < ION_PAGE_POOL_ORDERS; i++)
+		ion_page_pool_destroy(pools[i]);
+}
+
+/**
+ * ion_page_pools_alloc - build a buffer out of the largest chunks possible
+ * @pools:	pools created by ion_page_pools_create()
+ * @size:	page aligned size of the buffer
+ *
+ * Returns an sg_table with one entry per chunk, or NULL.
+ */
+struct sg_table *ion_page_pools_alloc(struct ion_page_pool **pools,
+				      unsigned long size)
+{
+	struct sg_table *table;
+	struct scatterlist *sg;
+	struct page *page, *tmp;
+	LIST_HEAD(chunks);
+	unsigned long remaining = size;
+	int i, start = 0, nents = 0;
+
+	while (remaining) {
+		page = NULL;
+		for (i = start; i < ION_PAGE_POOL_ORDERS; i++) {
+			if (remaining < (PAGE_SIZE << ion_page_pool_orders[i]))
+				continue;
+			page = ion_page_pool_alloc(pools[i]);
+			if (page)
+				break;
+		}
+		if (!page)
+			goto err;
+		/* once a large chunk failed, do not retry it */
+		start = i;
+		set_page_private(page, i);
+		list_add_tail(&page->lru, &chunks);
+		remaining -= PAGE_SIZE << ion_page_pool_orders[i];
+		nents++;
+	}
+
+	table = kmalloc(sizeof(struct sg_table), GFP_KERNEL);
+	if (!table)
+		goto err;
+	if (sg_alloc_table(table, nents, GFP_KERNEL)) {
+		kfree(table);
+		goto err;
+	}
+
+	sg = table->sgl;
+	list_for_each_entry_safe(page, tmp, &chunks, lru) {
+		i = page_private(page);
+		set_page_private(page, 0);
+		list_del(&page->lru);
+		sg_set_page(sg, page, PAGE_SIZE << ion_page_pool_orders[i], 0);
+		sg = sg_next(sg);
+	}
+	return table;
+
+err:
+	list_for_each_entry_safe(page, tmp, &chunks, lru) {
+		i = page_private(page);
+		set_page_private(page, 0);
+		list_del(&page->lru);
+		ion_page_pool_free(pools[i], page);
+	}
+	return NULL;
+}
+
+/**
+ * ion_page_pools_free - return the chunks of a buffer to their pools
+ * @pools:	pools the buffer was allocated from
+ * @table:	table returned by ion_page_pools_alloc(), left to the caller
+ */
+void ion_page_pools_free(struct ion_page_pool **pools, struct sg_table *table)
+{
+	struct scatterlist *sg;
+	int i, j;
+
+	for_each_sg(table->sgl, sg, table->nents, i) {
+		for (j = 0; j < ION_PAGE_POOL_ORDERS; j++)
+			if (sg->length == PAGE_SIZE << ion_page_pool_orders[j])
+				break;
+		if (WARN_ON(j == ION_PAGE_POOL_ORDERS))
+			continue;
+		ion_page_pool_free(pools[j], sg_page(sg));
+	}
+}
+
+static int __init ion_page_pool_init(void)
+{
+	register_shrinker(&ion_page_pool_shrinker);
+	return 0;
+}
+device_initcall(ion_page_pool_init);
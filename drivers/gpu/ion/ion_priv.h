@@ -25,6 +25,7 @@
 #include <linux/ion.h>
 #include <linux/iommu.h>
 #include <linux/seq_file.h>
+#include <linux/workqueue.h>
 
 enum {
 	DI_PARTITION_NUM = 0,
@@ -43,6 +44,7 @@ enum {
  * @mapped_size - size of the iova space mapped
  *		(may not be the same as the buffer size)
  * @flags - iommu domain/partition specific flags.
+ * @idle - entry in the LRU of mappings no client holds, empty otherwise
  *
  * Represents a mapping of one ion buffer to a particular iommu domain
  * and address range. There may exist other mappings of this buffer in
@@ -60,6 +62,7 @@ struct ion_iommu_map {
 	struct kref ref;
 	int mapped_size;
 	unsigned long flags;
+	struct list_head idle;
 };
 
 struct ion_buffer *ion_handle_buffer(struct ion_handle *handle);
@@ -81,6 +84,9 @@ struct ion_buffer *ion_handle_buffer(struct ion_handle *handle);
  * @vaddr:		the kenrel mapping if kmap_cnt is not zero
  * @dmap_cnt:		number of times the buffer is mapped for dma
  * @sg_table:		the sg table for the buffer if dmap_cnt is not zero
+ * @umap_write_cnt:	number of writable user space mappings
+ * @cpu_cached:		the CPU caches may hold lines of the buffer
+ * @cpu_dirty:		the CPU caches may hold dirty lines of the buffer
 */
 struct ion_buffer {
 	struct kref ref;
@@ -99,9 +105,12 @@ struct ion_buffer {
 	int dmap_cnt;
 	struct sg_table *sg_table;
 	int umap_cnt;
+	int umap_write_cnt;
 	unsigned int iommu_map_cnt;
 	struct rb_root iommu_maps;
 	int marked;
+	int cpu_cached;
+	int cpu_dirty;
 };
 
 /**
@@ -245,6 +254,49 @@ void ion_cp_heap_destroy(struct ion_heap *);
 struct ion_heap *ion_reusable_heap_create(struct ion_platform_heap *);
 void ion_reusable_heap_destroy(struct ion_heap *);
 
+/**
+ * struct ion_page_pool - pool of zeroed chunks of pages
+ * @count:		number of zeroed chunks in @items
+ * @dirty_count:	number of freed chunks in @dirty_items
+ * @items:		chunks ready to be handed out
+ * @dirty_items:	chunks waiting to be zeroed
+ * @mutex:		protects the lists and counts
+ * @zero_work:		zeroes @dirty_items in the background
+ * @gfp_mask:		flags used to allocate new chunks
+ * @order:		each chunk is 2^order physically contiguous pages
+ * @list:		entry in the list of pools the shrinker walks
+ *
+ * Used by the system and iommu heaps so that buffers can be built out
+ * of large chunks without waiting for the page allocator or for the
+ * pages to be zeroed.
+ */
+struct ion_page_pool {
+	int count;
+	int dirty_count;
+	struct list_head items;
+	struct list_head dirty_items;
+	struct mutex mutex;
+	struct work_struct zero_work;
+	gfp_t gfp_mask;
+	unsigned int order;
+	struct list_head list;
+};
+
+#define ION_PAGE_POOL_ORDERS 3
+extern const unsigned int ion_page_pool_orders[ION_PAGE_POOL_ORDERS];
+
+struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order);
+void ion_page_pool_destroy(struct ion_page_pool *);
+struct page *ion_page_pool_alloc(struct ion_page_pool *);
+void ion_page_pool_free(struct ion_page_pool *, struct page *);
+int ion_page_pool_total(struct ion_page_pool *);
+
+int ion_page_pools_create(struct ion_page_pool **pools);
+void ion_page_pools_destroy(struct ion_page_pool **pools);
+struct sg_table *ion_page_pools_alloc(struct ion_page_pool **pools,
+				      unsigned long size);
+void ion_page_pools_free(struct ion_page_pool **pools, struct sg_table *table);
+
 /**
  * kernel api to allocate/free from carveout -- used when carveout is
  * used to back an architecture specific custom heap
@@ -296,6 +348,9 @@ void *ion_map_fmem_buffer(struct ion_buffer *buffer, unsigned long phys_base,
  *		ION_IOC_INV_CACHES
  *		ION_IOC_CLEAN_INV_CACHES
  *
+ * Nothing is done for buffers the CPU caches cannot hold (dirty) lines of,
+ * see ion_buffer_cache_op_needed().
+ *
  * Returns 0 on success
  */
 int ion_do_cache_op(struct ion_client *client, struct ion_handle *handle,
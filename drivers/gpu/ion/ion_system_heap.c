@@ -33,49 +33,38 @@ static atomic_t system_contig_heap_allocated;
 static unsigned int system_heap_has_outer_cache;
 static unsigned int system_heap_contig_has_outer_cache;
 
+struct ion_system_heap {
+	struct ion_heap heap;
+	struct ion_page_pool *pools[ION_PAGE_POOL_ORDERS];
+};
+
 static int ion_system_heap_allocate(struct ion_heap *heap,
 				     struct ion_buffer *buffer,
 				     unsigned long size, unsigned long align,
 				     unsigned long flags)
 {
+	struct ion_system_heap *sys_heap =
+		container_of(heap, struct ion_system_heap, heap);
 	struct sg_table *table;
-	struct scatterlist *sg;
-	int i, j;
-	int npages = PAGE_ALIGN(size) / PAGE_SIZE;
 
-	table = kmalloc(sizeof(struct sg_table), GFP_KERNEL);
+	table = ion_page_pools_alloc(sys_heap->pools, PAGE_ALIGN(size));
 	if (!table)
 		return -ENOMEM;
-	i = sg_alloc_table(table, npages, GFP_KERNEL);
-	if (i)
-		goto err0;
-	for_each_sg(table->sgl, sg, table->nents, i) {
-		struct page *page;
-		page = alloc_page(GFP_KERNEL|__GFP_ZERO);
-		if (!page)
-			goto err1;
-		sg_set_page(sg, page, PAGE_SIZE, 0);
-	}
 	buffer->priv_virt = table;
+	/* pool chunks are clean in the CPU caches */
+	buffer->cpu_cached = 0;
+	buffer->cpu_dirty = 0;
 	atomic_add(size, &system_heap_allocated);
 	return 0;
-err1:
-	for_each_sg(table->sgl, sg, i, j)
-		__free_page(sg_page(sg));
-	sg_free_table(table);
-err0:
-	kfree(table);
-	return -ENOMEM;
 }
 
 void ion_system_heap_free(struct ion_buffer *buffer)
 {
-	int i;
-	struct scatterlist *sg;
+	struct ion_system_heap *sys_heap =
+		container_of(buffer->heap, struct ion_system_heap, heap);
 	struct sg_table *table = buffer->priv_virt;
 
-	for_each_sg(table->sgl, sg, table->nents, i)
-		__free_page(sg_page(sg));
+	ion_page_pools_free(sys_heap->pools, table);
 	if (buffer->sg_table)
 		sg_free_table(buffer->sg_table);
 	kfree(buffer->sg_table);
@@ -102,16 +91,21 @@ void *ion_system_heap_map_kernel(struct ion_heap *heap,
 		return ERR_PTR(-EINVAL);
 	} else {
 		struct scatterlist *sg;
-		int i;
+		int i, j, npages = PAGE_ALIGN(buffer->size) / PAGE_SIZE;
 		void *vaddr;
 		struct sg_table *table = buffer->priv_virt;
 		struct page **pages = kmalloc(
-					sizeof(struct page *) * table->nents,
+					sizeof(struct page *) * npages,
 					GFP_KERNEL);
+		struct page **tmp = pages;
+
+		if (!pages)
+			return ERR_PTR(-ENOMEM);
 
 		for_each_sg(table->sgl, sg, table->nents, i)
-			pages[i] = sg_page(sg);
-		vaddr = vmap(pages, table->nents, VM_MAP, PAGE_KERNEL);
+			for (j = 0; j < sg->length / PAGE_SIZE; j++)
+				*(tmp++) = nth_page(sg_page(sg), j);
+		vaddr = vmap(pages, npages, VM_MAP, PAGE_KERNEL);
 		kfree(pages);
 
 		return vaddr;
@@ -161,15 +155,20 @@ int ion_system_heap_map_user(struct ion_heap *heap, struct ion_buffer *buffer,
 		unsigned long addr = vma->vm_start;
 		unsigned long offset = vma->vm_pgoff;
 		struct scatterlist *sg;
-		int i;
+		int i, j;
 
 		for_each_sg(table->sgl, sg, table->nents, i) {
-			if (offset) {
-				offset--;
-				continue;
+			for (j = 0; j < sg->length / PAGE_SIZE; j++) {
+				if (offset) {
+					offset--;
+					continue;
+				}
+				if (addr >= vma->vm_end)
+					return 0;
+				vm_insert_page(vma, addr,
+					       nth_page(sg_page(sg), j));
+				addr += PAGE_SIZE;
 			}
-			vm_insert_page(vma, addr, sg_page(sg));
-			addr += PAGE_SIZE;
 		}
 		return 0;
 	}
@@ -199,12 +198,22 @@ int ion_system_heap_cache_ops(struct ion_heap *heap, struct ion_buffer *buffer,
 	}
 
 	if (system_heap_has_outer_cache) {
-		unsigned long pstart;
+		unsigned long pstart, lo, hi;
+		unsigned long pos = 0, end = offset + length;
 		struct sg_table *table = buffer->priv_virt;
 		struct scatterlist *sg;
 		int i;
+		/* only the part of each chunk inside [offset, end) */
 		for_each_sg(table->sgl, sg, table->nents, i) {
 			struct page *page = sg_page(sg);
+
+			if (pos >= end)
+				break;
+			lo = max_t(unsigned long, offset, pos);
+			hi = min_t(unsigned long, end, pos + sg->length);
+			pos += sg->length;
+			if (lo >= hi)
+				continue;
 			pstart = page_to_phys(page);
 			/*
 			 * If page -> phys is returning NULL, something
@@ -214,7 +223,8 @@ int ion_system_heap_cache_ops(struct ion_heap *heap, struct ion_buffer *buffer,
 				WARN(1, "Could not translate virtual address to physical address\n");
 				return -EINVAL;
 			}
-			outer_cache_op(pstart, pstart + PAGE_SIZE);
+			pstart += lo - (pos - sg->length);
+			outer_cache_op(pstart, pstart + hi - lo);
 		}
 	}
 	return 0;
@@ -223,8 +233,16 @@ int ion_system_heap_cache_ops(struct ion_heap *heap, struct ion_buffer *buffer,
 static int ion_system_print_debug(struct ion_heap *heap, struct seq_file *s,
 				  const struct rb_root *unused)
 {
+	struct ion_system_heap *sys_heap =
+		container_of(heap, struct ion_system_heap, heap);
+	int i;
+
 	seq_printf(s, "total bytes currently allocated: %lx\n",
 			(unsigned long) atomic_read(&system_heap_allocated));
+	for (i = 0; i < ION_PAGE_POOL_ORDERS; i++)
+		seq_printf(s, "order %u pool: %d pages\n",
+			   ion_page_pool_orders[i],
+			   ion_page_pool_total(sys_heap->pools[i]));
 
 	return 0;
 }
@@ -311,20 +329,28 @@ static struct ion_heap_ops vmalloc_ops = {
 
 struct ion_heap *ion_system_heap_create(struct ion_platform_heap *pheap)
 {
-	struct ion_heap *heap;
+	struct ion_system_heap *sys_heap;
 
-	heap = kzalloc(sizeof(struct ion_heap), GFP_KERNEL);
-	if (!heap)
+	sys_heap = kzalloc(sizeof(struct ion_system_heap), GFP_KERNEL);
+	if (!sys_heap)
 		return ERR_PTR(-ENOMEM);
-	heap->ops = &vmalloc_ops;
-	heap->type = ION_HEAP_TYPE_SYSTEM;
+	if (ion_page_pools_create(sys_heap->pools)) {
+		kfree(sys_heap);
+		return ERR_PTR(-ENOMEM);
+	}
+	sys_heap->heap.ops = &vmalloc_ops;
+	sys_heap->heap.type = ION_HEAP_TYPE_SYSTEM;
 	system_heap_has_outer_cache = pheap->has_outer_cache;
-	return heap;
+	return &sys_heap->heap;
 }
 
 void ion_system_heap_destroy(struct ion_heap *heap)
 {
-	kfree(heap);
+	struct ion_system_heap *sys_heap =
+		container_of(heap, struct ion_system_heap, heap);
+
+	ion_page_pools_destroy(sys_heap->pools);
+	kfree(sys_heap);
 }
 
 static int ion_system_contig_heap_allocate(struct ion_heap *heap,
@@ -424,7 +450,7 @@ int ion_system_contig_heap_cache_ops(struct ion_heap *heap,
 			return -EINVAL;
 		}
 
-		outer_cache_op(pstart, pstart + PAGE_SIZE);
+		outer_cache_op(pstart, pstart + length);
 	}
 
 	return 0;
@@ -113,6 +113,7 @@ static struct adreno_device device_3d0 = {
 	.pm4_fw = NULL,
 	.wait_timeout = 0, /* in milliseconds, 0 means disabled */
 	.ib_check_level = 0,
+	.inflight_max = ADRENO_INFLIGHT_MAX,
 };
 
 /* This set of registers are used for Hang detection
@@ -279,7 +280,7 @@ static void adreno_iommu_setstate(struct kgsl_device *device,
 					unsigned int context_id,
 					uint32_t flags)
 {
-	unsigned int pt_val, reg_pt_val;
+	unsigned int pt_val, reg_pt_val, asid;
 	unsigned int link[250];
 	unsigned int *cmds = &link[0];
 	int sizedwords = 0;
@@ -324,6 +325,7 @@ static void adreno_iommu_setstate(struct kgsl_device *device,
 	cmds += kgsl_mmu_sync_lock(&device->mmu, cmds);
 
 	pt_val = kgsl_mmu_pt_get_base_addr(device->mmu.hwpagetable);
+	asid = kgsl_mmu_pt_get_asid(device->mmu.hwpagetable);
 	if (flags & KGSL_MMUFLAGS_PTUPDATE) {
 		/*
 		 * We need to perfrom the following operations for all
@@ -335,6 +337,15 @@ static void adreno_iommu_setstate(struct kgsl_device *device,
 				KGSL_IOMMU_TTBR0_PA_SHIFT)) +
 				kgsl_mmu_get_pt_lsb(&device->mmu, i,
 					KGSL_IOMMU_CONTEXT_USER);
+			/* Tag the TLB entries of the new pagetable */
+			if (asid) {
+				*cmds++ = cp_type3_packet(CP_MEM_WRITE, 2);
+				*cmds++ = reg_map_desc[i]->gpuaddr +
+					(KGSL_IOMMU_CONTEXT_USER <<
+					KGSL_IOMMU_CTX_SHIFT) +
+					KGSL_IOMMU_CONTEXTIDR;
+				*cmds++ = asid;
+			}
 			/*
 			 * Set address of the new pagetable by writng to IOMMU
 			 * TTBR0 register
@@ -371,12 +382,14 @@ static void adreno_iommu_setstate(struct kgsl_device *device,
 				kgsl_mmu_get_pt_lsb(&device->mmu, i,
 					KGSL_IOMMU_CONTEXT_USER);
 
+			/* Entries of the other pagetables can stay */
 			*cmds++ = cp_type3_packet(CP_MEM_WRITE, 2);
 			*cmds++ = (reg_map_desc[i]->gpuaddr +
 				(KGSL_IOMMU_CONTEXT_USER <<
 				KGSL_IOMMU_CTX_SHIFT) +
-				KGSL_IOMMU_CTX_TLBIALL);
-			*cmds++ = 1;
+				(asid ? KGSL_IOMMU_CTX_TLBIASID :
+				KGSL_IOMMU_CTX_TLBIALL));
+			*cmds++ = asid ? asid : 1;
 
 			cmds += __adreno_add_idle_indirect_cmds(cmds,
 			device->mmu.setstate_memory.gpuaddr +
@@ -50,11 +50,15 @@
 #endif
 
 void adreno_debugfs_init(struct kgsl_device *device);
+void adreno_bench_init(struct kgsl_device *device);
 
 #define ADRENO_ISTORE_START 0x5000 /* Istore offset */
 
 #define ADRENO_NUM_CTX_SWITCH_ALLOWED_BEFORE_DRAW	50
 
+/* Submissions a background context may have outstanding on the GPU */
+#define ADRENO_INFLIGHT_MAX	4
+
 /* One cannot wait forever for the core to idle, so set an upper limit to the
  * amount of time to wait for the core to go idle
  */
@@ -99,6 +103,9 @@ struct adreno_device {
 	unsigned int instruction_size;
 	unsigned int ib_check_level;
 	unsigned int fast_hang_detect;
+	unsigned int inflight_max;
+	/* pwrctrl.rail_collapses when the ucode was last loaded, plus one */
+	unsigned int ucode_loaded;
 	unsigned int gpulist_index;
 	struct ocmem_buf *ocmem_hdl;
 };
@@ -0,0 +1,259 @@
+/* Copyright (c) 2012, Code Aurora Forum. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * Submission benchmark: writing to bench/run queues batches of NOP
+ * commands on the ringbuffer at a fixed interval and waits for each
+ * batch to retire.  bench/result then holds the time the ringbuffer
+ * took to accept a command, the time from the first submission of a
+ * batch until its last one retired, and the power state transitions
+ * taken while the benchmark ran (max_us is the largest seen since
+ * boot).  A long interval lets the GPU nap or sleep between batches,
+ * so the wake up shows up in the retire time.
+ */
+
+#include <linux/debugfs.h>
+#include <linux/delay.h>
+#include <linux/ktime.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+
+#include "kgsl.h"
+#include "kgsl_pwrctrl.h"
+#include "adreno.h"
+#include "adreno_pm4types.h"
+#include "adreno_ringbuffer.h"
+
+#define BENCH_MAX_NR		10000
+#define BENCH_MAX_NOPS		1024
+#define BENCH_MAX_BATCH		64
+#define BENCH_WAIT_MSECS	1000
+#define BENCH_RESULT_SIZE	2048
+
+/*
+ * Commands go in on a context of their own whose timestamps are the
+ * global ones, so no user context or pagetable is involved.
+ */
+static struct adreno_context bench_ctx = {
+	.id = KGSL_MEMSTORE_GLOBAL,
+};
+
+static u32 bench_nr = 100;
+static u32 bench_nops = 16;
+static u32 bench_batch = 1;
+static u32 bench_interval_us = 1000;
+
+static DEFINE_MUTEX(bench_lock);
+static char *bench_result;
+
+static int bench_cmp(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static u32 bench_pct(u32 *lat, unsigned int n, unsigned int pct)
+{
+	return lat[min(n - 1, n * pct / 100)];
+}
+
+/* One batch, returns the time until it retired or a negative error */
+static int bench_batch_run(struct kgsl_device *device, unsigned int *cmds,
+			   unsigned int batch, unsigned int nops,
+			   u64 *submit_us, u32 *submit_max)
+{
+	unsigned int i, us, timestamp = 0;
+	ktime_t start, t;
+	int ret = 0;
+
+	mutex_lock(&device->mutex);
+	kgsl_check_suspended(device);
+	/* the ringbuffer only runs while someone has the device open */
+	if (!device->open_count) {
+		ret = -ENODEV;
+		goto out;
+	}
+	if (device->state & (KGSL_STATE_HUNG | KGSL_STATE_DUMP_AND_RECOVER)) {
+		ret = -EBUSY;
+		goto out;
+	}
+	kgsl_pre_hwaccess(device);
+
+	start = ktime_get();
+	for (i = 0; i < batch; i++) {
+		t = ktime_get();
+		timestamp = adreno_ringbuffer_issuecmds(device, &bench_ctx,
+					KGSL_CMD_FLAGS_NONE, cmds, nops + 1);
+		us = ktime_us_delta(ktime_get(), t);
+		*submit_us += us;
+		*submit_max = max(*submit_max, us);
+	}
+
+	/* Hold off suspend while the mutex is dropped */
+	device->active_cnt++;
+	ret = device->ftbl->waittimestamp(device, NULL, timestamp,
+					  BENCH_WAIT_MSECS);
+	INIT_COMPLETION(device->suspend_gate);
+	device->active_cnt--;
+	complete(&device->suspend_gate);
+
+	if (!ret)
+		ret = ktime_us_delta(ktime_get(), start);
+out:
+	mutex_unlock(&device->mutex);
+	return ret;
+}
+
+static int bench_run(struct kgsl_device *device)
+{
+	struct kgsl_pwr_transition_stats before[KGSL_PWR_TRANSITIONS];
+	struct kgsl_pwr_transition_stats *after, d;
+	unsigned int nr = clamp_t(u32, bench_nr, 1, BENCH_MAX_NR);
+	unsigned int nops = clamp_t(u32, bench_nops, 1, BENCH_MAX_NOPS);
+	unsigned int batch = clamp_t(u32, bench_batch, 1, BENCH_MAX_BATCH);
+	unsigned int interval = bench_interval_us;
+	unsigned int *cmds;
+	u32 *lat, submit_max = 0;
+	u64 submit_us = 0;
+	ktime_t start;
+	s64 elapsed;
+	unsigned int i;
+	int ret = 0, len;
+	char *buf;
+
+	cmds = kzalloc((nops + 1) * sizeof(*cmds), GFP_KERNEL);
+	lat = vmalloc(nr * sizeof(*lat));
+	buf = kmalloc(BENCH_RESULT_SIZE, GFP_KERNEL);
+	if (!cmds || !lat || !buf) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	cmds[0] = cp_nop_packet(nops);
+
+	mutex_lock(&device->mutex);
+	memcpy(before, device->pwrctrl.transitions, sizeof(before));
+	mutex_unlock(&device->mutex);
+
+	start = ktime_get();
+	for (i = 0; i < nr; i++) {
+		ret = bench_batch_run(device, cmds, batch, nops,
+				      &submit_us, &submit_max);
+		if (ret < 0)
+			goto out;
+		lat[i] = ret;
+
+		if (signal_pending(current)) {
+			ret = -EINTR;
+			goto out;
+		}
+		if (interval >= 20000)
+			msleep(interval / 1000);
+		else if (interval)
+			usleep_range(interval, interval + interval / 8 + 1);
+	}
+	elapsed = ktime_us_delta(ktime_get(), start);
+	ret = 0;
+
+	sort(lat, nr, sizeof(*lat), bench_cmp, NULL);
+
+	len = scnprintf(buf, BENCH_RESULT_SIZE,
+		"batches %u batch %u nops %u interval_us %u elapsed_us %lld\n"
+		"submit_us avg %llu max %u\n"
+		"retire_us p50 %u p90 %u p99 %u max %u\n"
+		"%-12s %8s %8s %8s\n",
+		nr, batch, nops, interval, elapsed,
+		div_u64(submit_us, nr * batch), submit_max,
+		bench_pct(lat, nr, 50), bench_pct(lat, nr, 90),
+		bench_pct(lat, nr, 99), lat[nr - 1],
+		"transition", "count", "avg_us", "max_us");
+
+	mutex_lock(&device->mutex);
+	after = device->pwrctrl.transitions;
+	for (i = 0; i < KGSL_PWR_TRANSITIONS; i++) {
+		d.count = after[i].count - before[i].count;
+		d.total_us = after[i].total_us - before[i].total_us;
+		len += scnprintf(buf + len, BENCH_RESULT_SIZE - len,
+			"%-12s %8u %8llu %8u\n",
+			kgsl_pwr_transition_to_str(i), d.count,
+			d.count ? div_u64(d.total_us, d.count) : 0,
+			after[i].max_us);
+	}
+	mutex_unlock(&device->mutex);
+
+	kfree(bench_result);
+	bench_result = buf;
+	buf = NULL;
+out:
+	kfree(buf);
+	vfree(lat);
+	kfree(cmds);
+	return ret;
+}
+
+static ssize_t bench_run_write(struct file *file, const char __user *ubuf,
+			       size_t count, loff_t *ppos)
+{
+	struct kgsl_device *device = file->private_data;
+	int ret;
+
+	if (mutex_lock_interruptible(&bench_lock))
+		return -EINTR;
+	ret = bench_run(device);
+	mutex_unlock(&bench_lock);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations bench_run_fops = {
+	.open = simple_open,
+	.write = bench_run_write,
+	.llseek = noop_llseek,
+};
+
+static ssize_t bench_result_read(struct file *file, char __user *ubuf,
+				 size_t count, loff_t *ppos)
+{
+	ssize_t ret = 0;
+
+	mutex_lock(&bench_lock);
+	if (bench_result)
+		ret = simple_read_from_buffer(ubuf, count, ppos, bench_result,
+					      strlen(bench_result));
+	mutex_unlock(&bench_lock);
+	return ret;
+}
+
+static const struct file_operations bench_result_fops = {
+	.open = simple_open,
+	.read = bench_result_read,
+	.llseek = default_llseek,
+};
+
+void adreno_bench_init(struct kgsl_device *device)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("bench", device->d_debugfs);
+	if (IS_ERR_OR_NULL(dir))
+		return;
+
+	debugfs_create_u32("nr", 0644, dir, &bench_nr);
+	debugfs_create_u32("nops", 0644, dir, &bench_nops);
+	debugfs_create_u32("batch", 0644, dir, &bench_batch);
+	debugfs_create_u32("interval_us", 0644, dir, &bench_interval_us);
+	debugfs_create_file("run", 0200, dir, device, &bench_run_fops);
+	debugfs_create_file("result", 0444, dir, device, &bench_result_fops);
+}
@@ -64,5 +64,8 @@ void adreno_debugfs_init(struct kgsl_device *device)
 	adreno_dev->fast_hang_detect = 1;
 	debugfs_create_u32("fast_hang_detect", 0644, device->d_debugfs,
 			   &adreno_dev->fast_hang_detect);
+	debugfs_create_u32("inflight_max", 0644, device->d_debugfs,
+			   &adreno_dev->inflight_max);
 
+	adreno_bench_init(device);
 }
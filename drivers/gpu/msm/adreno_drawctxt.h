@@ -81,6 +81,8 @@ struct adreno_context {
 	unsigned int id;
 	uint32_t flags;
 	struct kgsl_pagetable *pagetable;
+	/* nice value of the creator; below 0 is never throttled */
+	int priority;
 	struct kgsl_memdesc gpustate;
 	unsigned int reg_restore[3];
 	unsigned int shader_save[3];
@@ -407,15 +407,31 @@ int adreno_ringbuffer_start(struct adreno_ringbuffer *rb, unsigned int init_ram)
 	adreno_regwrite(device, REG_SCRATCH_UMSK,
 			     GSL_RB_MEMPTRS_SCRATCH_MASK);
 
-	/* load the CP ucode */
-	status = adreno_ringbuffer_load_pm4_ucode(device);
-	if (status != 0)
-		return status;
-
-	/* load the prefetch parser ucode */
-	status = adreno_ringbuffer_load_pfp_ucode(device);
-	if (status != 0)
-		return status;
+	/*
+	 * The ucode RAMs keep their contents as long as the core stays
+	 * powered, so only reload them if the rail dropped since the last
+	 * load, or when recovering from a hang.  A2XX soft resets the core
+	 * on every start and always needs them.
+	 */
+	if (!adreno_is_a3xx(adreno_dev) ||
+	    adreno_dev->ucode_loaded != device->pwrctrl.rail_collapses + 1 ||
+	    device->state == KGSL_STATE_DUMP_AND_RECOVER) {
+		adreno_dev->ucode_loaded = 0;
+
+		/* load the CP ucode */
+		status = adreno_ringbuffer_load_pm4_ucode(device);
+		if (status != 0)
+			return status;
+
+		/* load the prefetch parser ucode */
+		status = adreno_ringbuffer_load_pfp_ucode(device);
+		if (status != 0)
+			return status;
+
+		adreno_dev->ucode_loaded = device->pwrctrl.rail_collapses + 1;
+	} else {
+		adreno_regwrite(device, REG_CP_DEBUG, CP_DEBUG_DEFAULT);
+	}
 
 	/* CP ROQ queue sizes (bytes) - RB:16, ST:16, IB1:32, IB2:64 */
 	if (adreno_is_a305(adreno_dev) || adreno_is_a320(adreno_dev))
@@ -717,8 +733,99 @@ adreno_ringbuffer_issuecmds(struct kgsl_device *device,
 static bool _parse_ibs(struct kgsl_device_private *dev_priv, uint gpuaddr,
 			   int sizedwords);
 
+/*
+ * IB check cache.  Command streams that passed _parse_ibs() are kept
+ * in their memory entry and are not parsed again until the CPU may
+ * have changed them.  The cache goes away with the entry, and CPU
+ * writes are caught by zapping the userspace mapping of the entry
+ * before a stream in it is parsed: any later CPU access faults and
+ * bumps cpu_generation, which empties the cache.  Only memory that
+ * KGSL allocated and can only be mapped through KGSL is tracked.
+ */
+#define KGSL_IB_CACHE_SIZE 16
+
+struct kgsl_ib_cache {
+	unsigned int generation;
+	unsigned int next;
+	struct {
+		unsigned int gpuaddr;
+		int sizedwords;
+	} ib[KGSL_IB_CACHE_SIZE];
+};
+
+static bool _ib_cache_trackable(struct kgsl_mem_entry *entry)
+{
+	return entry->memtype == KGSL_MEM_ENTRY_KERNEL &&
+		!(entry->flags & KGSL_MEM_ENTRY_UNTRACKED);
+}
+
+static bool _ib_cache_lookup(struct kgsl_mem_entry *entry, uint gpuaddr,
+			     int sizedwords)
+{
+	struct kgsl_ib_cache *cache = entry->ib_cache;
+	int i;
+
+	if (cache == NULL || !_ib_cache_trackable(entry) ||
+	    cache->generation != atomic_read(&entry->cpu_generation))
+		return false;
+
+	for (i = 0; i < KGSL_IB_CACHE_SIZE; i++)
+		if (cache->ib[i].gpuaddr == gpuaddr &&
+		    cache->ib[i].sizedwords == sizedwords)
+			return true;
+
+	return false;
+}
+
+/* Make sure that CPU writes from here on are noticed */
+static void _ib_cache_protect(struct kgsl_mem_entry *entry)
+{
+	struct kgsl_ib_cache *cache = entry->ib_cache;
+	unsigned int generation = atomic_read(&entry->cpu_generation);
+
+	if (!_ib_cache_trackable(entry))
+		return;
+
+	if (cache == NULL) {
+		cache = kmalloc(sizeof(*cache), GFP_KERNEL);
+		if (cache == NULL)
+			return;
+		cache->generation = 0;
+		entry->ib_cache = cache;
+	}
+
+	if (cache->generation == generation)
+		return;
+
+	memset(cache->ib, 0, sizeof(cache->ib));
+	cache->next = 0;
+
+	/*
+	 * Read the generation before zapping, a fault in between leaves
+	 * the cache stale and unused.
+	 */
+	if (entry->cpu_mapping)
+		unmap_mapping_range(entry->cpu_mapping, entry->memdesc.gpuaddr,
+				    entry->memdesc.size, 1);
+	cache->generation = generation;
+}
+
+static void _ib_cache_add(struct kgsl_mem_entry *entry, uint gpuaddr,
+			  int sizedwords)
+{
+	struct kgsl_ib_cache *cache = entry->ib_cache;
+
+	if (cache == NULL || !_ib_cache_trackable(entry))
+		return;
+
+	cache->ib[cache->next].gpuaddr = gpuaddr;
+	cache->ib[cache->next].sizedwords = sizedwords;
+	cache->next = (cache->next + 1) % KGSL_IB_CACHE_SIZE;
+}
+
 static bool
-_handle_type3(struct kgsl_device_private *dev_priv, uint *hostaddr)
+_handle_type3(struct kgsl_device_private *dev_priv, uint *hostaddr,
+	      bool *nested)
 {
 	unsigned int opcode = cp_type3_opcode(*hostaddr);
 	switch (opcode) {
@@ -726,6 +833,7 @@ _handle_type3(struct kgsl_device_private *dev_priv, uint *hostaddr)
 	case CP_INDIRECT_BUFFER_PFE:
 	case CP_COND_INDIRECT_BUFFER_PFE:
 	case CP_COND_INDIRECT_BUFFER_PFD:
+		*nested = true;
 		return _parse_ibs(dev_priv, hostaddr[1], hostaddr[2]);
 	case CP_NOP:
 	case CP_WAIT_FOR_IDLE:
@@ -803,6 +911,7 @@ static bool _parse_ibs(struct kgsl_device_private *dev_priv,
 	uint *hostaddr, *hoststart;
 	int dwords_left = sizedwords; /* dwords left in the current command
 					 buffer */
+	bool nested = false; /* the buffer calls other command buffers */
 	struct kgsl_mem_entry *entry;
 
 	spin_lock(&dev_priv->process_priv->mem_lock);
@@ -822,6 +931,11 @@ static bool _parse_ibs(struct kgsl_device_private *dev_priv,
 		return false;
 	}
 
+	if (_ib_cache_lookup(entry, gpuaddr, sizedwords))
+		return true;
+
+	_ib_cache_protect(entry);
+
 	hoststart = hostaddr;
 
 	level++;
@@ -844,7 +958,7 @@ static bool _parse_ibs(struct kgsl_device_private *dev_priv,
 			break;
 		case 0x3: /* type-3 */
 			count = ((*hostaddr >> 16) & 0x3fff) + 2;
-			cur_ret = _handle_type3(dev_priv, hostaddr);
+			cur_ret = _handle_type3(dev_priv, hostaddr, &nested);
 			break;
 		default:
 			KGSL_CMD_ERR(dev_priv->device, "unexpected type: "
@@ -894,6 +1008,13 @@ static bool _parse_ibs(struct kgsl_device_private *dev_priv,
 		}
 	}
 
+	/*
+	 * The buffers called from this one are checked on their own, a
+	 * cached result here would skip them.
+	 */
+	if (!nested)
+		_ib_cache_add(entry, gpuaddr, sizedwords);
+
 	ret = true;
 done:
 	if (!ret)
@@ -906,6 +1027,57 @@ done:
 	return ret;
 }
 
+/**
+ * adreno_ringbuffer_throttle - hold back a background context
+ * @device - KGSL device the context submits to
+ * @context - context about to submit
+ *
+ * Contexts created by a task running at nice 0 or above may only have
+ * inflight_max submissions outstanding.  Beyond that the submitter sleeps
+ * in waittimestamp until the oldest of them retires.  The device mutex is
+ * dropped while it sleeps, so the compositor and other high priority
+ * contexts get into the ringbuffer ahead of it instead of queueing behind
+ * a deep backlog.  Throttling is best effort: on any wait error the
+ * submission just goes ahead.
+ *
+ * Returns -EINVAL if the context was destroyed while waiting, in which
+ * case it must not be touched any more.
+ */
+static int adreno_ringbuffer_throttle(struct kgsl_device *device,
+				      struct kgsl_context *context)
+{
+	struct adreno_device *adreno_dev = ADRENO_DEVICE(device);
+	struct adreno_context *drawctxt = context->devctxt;
+	unsigned int queued, retired, max;
+	int ret = 0;
+
+	max = adreno_dev->inflight_max;
+	if (!max || drawctxt->priority < 0)
+		return 0;
+
+	queued = kgsl_readtimestamp(device, context, KGSL_TIMESTAMP_QUEUED);
+	retired = kgsl_readtimestamp(device, context, KGSL_TIMESTAMP_RETIRED);
+	if (timestamp_cmp(queued, retired + max) < 0)
+		return 0;
+
+	/* Hold off suspend while the mutex is dropped, as for waittimestamp */
+	kgsl_context_get(context);
+	device->active_cnt++;
+
+	device->ftbl->waittimestamp(device, context, queued - max + 1,
+				    ADRENO_IDLE_TIMEOUT);
+
+	INIT_COMPLETION(device->suspend_gate);
+	device->active_cnt--;
+	complete(&device->suspend_gate);
+
+	if (context->devctxt == NULL)
+		ret = -EINVAL;
+	kgsl_context_put(context);
+
+	return ret;
+}
+
 int
 adreno_ringbuffer_issueibcmds(struct kgsl_device_private *dev_priv,
 				struct kgsl_context *context,
@@ -928,6 +1100,15 @@ adreno_ringbuffer_issueibcmds(struct kgsl_device_private *dev_priv,
 	      context == NULL || ibdesc == 0 || numibs == 0)
 		return -EINVAL;
 
+	if (adreno_ringbuffer_throttle(device, context))
+		return -EINVAL;
+
+	/* The device mutex may have been dropped while throttled */
+	if (device->state & KGSL_STATE_HUNG)
+		return -EBUSY;
+	if (!(adreno_dev->ringbuffer.flags & KGSL_FLAGS_STARTED))
+		return -EINVAL;
+
 	drawctxt = context->devctxt;
 
 	if (drawctxt->flags & CTXT_FLAGS_GPU_HANG) {
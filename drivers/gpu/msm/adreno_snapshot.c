@@ -479,6 +479,10 @@ static void ib_add_gpu_object(struct kgsl_device *device, unsigned int ptbase,
 	if (src == NULL)
 		return;
 
+	/* Out of time, keep the IB itself but don't look inside */
+	if (kgsl_snapshot_timed_out(device))
+		rem = 0;
+
 	for (i = 0; rem != 0; rem--, i++) {
 		int pktsize;
 
@@ -544,7 +548,7 @@ static int snapshot_rb(struct kgsl_device *device, void *snapshot,
 	struct adreno_device *adreno_dev = ADRENO_DEVICE(device);
 	struct adreno_ringbuffer *rb = &adreno_dev->ringbuffer;
 	unsigned int ptbase, rptr, *rbptr, ibbase;
-	int index, size, i;
+	int index, size, i, start, count, history;
 	int parse_ibs = 0, ib_parse_start;
 
 	/* Get the physical address of the MMU pagetable */
@@ -621,11 +625,20 @@ static int snapshot_rb(struct kgsl_device *device, void *snapshot,
 	ib_parse_start = index;
 
 	/*
-	 * Dump the entire ringbuffer - the parser can choose how much of it to
-	 * process
+	 * Dump from a little before the window up to the wptr.  Anything
+	 * older was executed long before the hang and is not worth the copy,
+	 * the header tells the parser where the dump starts.
 	 */
 
-	size = (rb->sizedwords << 2);
+	history = (ib_parse_start - (int) rb->wptr + rb->sizedwords) %
+		rb->sizedwords;
+	history = min(history, NUM_DWORDS_OF_RINGBUFFER_HISTORY);
+	start = (ib_parse_start - history + rb->sizedwords) % rb->sizedwords;
+	count = ((int) rb->wptr - start + rb->sizedwords) % rb->sizedwords;
+	if (count == 0)
+		count = rb->sizedwords;
+
+	size = (count << 2);
 
 	if (remain < size + sizeof(*header)) {
 		KGSL_DRV_ERR(device,
@@ -634,19 +647,20 @@ static int snapshot_rb(struct kgsl_device *device, void *snapshot,
 	}
 
 	/* Write the sub-header for the section */
-	header->start = rb->wptr;
+	header->start = start;
 	header->end = rb->wptr;
 	header->wptr = rb->wptr;
+	header->rptr = rptr;
 	header->rbsize = rb->sizedwords;
-	header->count = rb->sizedwords;
+	header->count = count;
 
 	/*
 	 * Loop through the RB, copying the data and looking for indirect
 	 * buffers and MMU pagetable changes
 	 */
 
-	index = rb->wptr;
-	for (i = 0; i < rb->sizedwords; i++) {
+	index = start;
+	for (i = 0; i < count; i++) {
 		*data = rbptr[index];
 
 		/*
@@ -860,13 +874,6 @@ void *adreno_snapshot(struct kgsl_device *device, void *snapshot, int *remain,
 			ibbase, ibsize);
 	}
 
-	/*
-	 * Go through the list of found objects and dump each one.  As the IBs
-	 * are parsed, more objects might be found, and objbufptr will increase
-	 */
-	for (i = 0; i < objbufptr; i++)
-		snapshot = dump_object(device, i, snapshot, remain);
-
 	/*
 	 * Only dump the istore on a hang - reading it on a running system
 	 * has a non 0 chance of hanging the GPU
@@ -878,11 +885,29 @@ void *adreno_snapshot(struct kgsl_device *device, void *snapshot, int *remain,
 			snapshot_istore, NULL);
 	}
 
-	/* Add GPU specific sections - registers mainly, but other stuff too */
+	/*
+	 * Add GPU specific sections - registers mainly, but other stuff too.
+	 * They go before the IBs so that they are in the snapshot even if
+	 * parsing the IBs runs out of time.
+	 */
 	if (adreno_dev->gpudev->snapshot)
 		snapshot = adreno_dev->gpudev->snapshot(adreno_dev, snapshot,
 			remain, hang);
 
+	/*
+	 * Go through the list of found objects and dump each one.  As the IBs
+	 * are parsed, more objects might be found, and objbufptr will increase
+	 */
+	for (i = 0; i < objbufptr; i++) {
+		if (kgsl_snapshot_timed_out(device)) {
+			KGSL_DRV_ERR(device,
+				"snapshot: out of time, %d IBs not dumped\n",
+				objbufptr - i);
+			break;
+		}
+		snapshot = dump_object(device, i, snapshot, remain);
+	}
+
 	if (snapshot_frozen_objsize)
 		KGSL_DRV_ERR(device, "GPU snapshot froze %dKb of GPU buffers\n",
 			snapshot_frozen_objsize / 1024);
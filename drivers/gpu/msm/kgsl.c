@@ -34,6 +34,7 @@
 #include "kgsl_cffdump.h"
 #include "kgsl_log.h"
 #include "kgsl_sharedmem.h"
+#include "kgsl_pool.h"
 #include "kgsl_device.h"
 #include "kgsl_trace.h"
 #include "kgsl_sync.h"
@@ -53,22 +54,25 @@ MODULE_PARM_DESC(ksgl_mmu_type,
 static struct ion_client *kgsl_ion_client;
 
 /**
- * kgsl_add_event - Add a new timstamp event for the KGSL device
+ * kgsl_add_event_flags - Add a new timstamp event for the KGSL device
  * @device - KGSL device for the new event
  * @ts - the timestamp to trigger the event on
  * @cb - callback function to call when the timestamp expires
  * @priv - private data for the specific event type
  * @owner - driver instance that owns this event
+ * @flags - KGSL_EVENT_NOMUTEX if @cb can run without device->mutex
+ *
+ * Must be called with device->mutex held.
  *
  * @returns - 0 on success or error code on failure
  */
 
-int kgsl_add_event(struct kgsl_device *device, u32 id, u32 ts,
+int kgsl_add_event_flags(struct kgsl_device *device, u32 id, u32 ts,
 	void (*cb)(struct kgsl_device *, void *, u32, u32), void *priv,
-	void *owner)
+	void *owner, unsigned int flags)
 {
-	struct kgsl_event *event;
-	struct list_head *n;
+	struct kgsl_event *event, *e;
+	struct list_head *head;
 	unsigned int cur_ts;
 	struct kgsl_context *context = NULL;
 
@@ -94,37 +98,82 @@ int kgsl_add_event(struct kgsl_device *device, u32 id, u32 ts,
 		return -ENOMEM;
 
 	event->context = context;
+	event->id = id;
 	event->timestamp = ts;
+	event->flags = flags;
 	event->priv = priv;
 	event->func = cb;
 	event->owner = owner;
 
-	/*
-	 * Add the event in order to the list.  Order is by context id
-	 * first and then by timestamp for that context.
-	 */
-
-	for (n = device->events.next ; n != &device->events; n = n->next) {
-		struct kgsl_event *e =
-			list_entry(n, struct kgsl_event, list);
+	head = context ? &context->events : &device->events;
 
-		if (e->context != context)
-			continue;
+	spin_lock(&device->event_lock);
 
-		if (timestamp_cmp(e->timestamp, ts) > 0) {
-			list_add(&event->list, n->prev);
+	/*
+	 * Keep the list in timestamp order so that expiring events only
+	 * ever looks at its head.  New events usually carry the newest
+	 * timestamp, so search from the tail.
+	 */
+	list_for_each_entry_reverse(e, head, list) {
+		if (timestamp_cmp(e->timestamp, ts) <= 0)
 			break;
-		}
 	}
+	list_add(&event->list, &e->list);
 
-	if (n == &device->events)
-		list_add_tail(&event->list, &device->events);
+	if (context && list_empty(&context->events_list))
+		list_add_tail(&context->events_list,
+			&device->events_pending_list);
+
+	device->events_rearm = true;
+	spin_unlock(&device->event_lock);
 
 	queue_work(device->work_queue, &device->ts_expired_ws);
 	return 0;
 }
+EXPORT_SYMBOL(kgsl_add_event_flags);
+
+/**
+ * kgsl_add_event - Add a new timstamp event for the KGSL device
+ * @device - KGSL device for the new event
+ * @ts - the timestamp to trigger the event on
+ * @cb - callback function to call when the timestamp expires
+ * @priv - private data for the specific event type
+ * @owner - driver instance that owns this event
+ *
+ * @cb is called with device->mutex held.
+ *
+ * @returns - 0 on success or error code on failure
+ */
+
+int kgsl_add_event(struct kgsl_device *device, u32 id, u32 ts,
+	void (*cb)(struct kgsl_device *, void *, u32, u32), void *priv,
+	void *owner)
+{
+	return kgsl_add_event_flags(device, id, ts, cb, priv, owner, 0);
+}
 EXPORT_SYMBOL(kgsl_add_event);
 
+/*
+ * Call the callback of each event on @list with @cur as the retired
+ * timestamp, or with the timestamp recorded when the event expired if
+ * @cur is NULL, and free the events.
+ */
+static void kgsl_run_events(struct kgsl_device *device,
+	struct list_head *list, unsigned int *cur)
+{
+	struct kgsl_event *event, *event_tmp;
+
+	list_for_each_entry_safe(event, event_tmp, list, list) {
+		list_del(&event->list);
+
+		if (event->func)
+			event->func(device, event->priv, event->id,
+				cur ? *cur : event->retired);
+
+		kfree(event);
+	}
+}
+
 /**
  * kgsl_cancel_events_ctxt - Cancel all events for a context
  * @device - KGSL device for the events to cancel
@@ -134,27 +183,32 @@ EXPORT_SYMBOL(kgsl_add_event);
 static void kgsl_cancel_events_ctxt(struct kgsl_device *device,
 	struct kgsl_context *context)
 {
-	struct kgsl_event *event, *event_tmp;
-	unsigned int id, cur;
+	LIST_HEAD(cancel);
+	unsigned int cur;
 
 	cur = kgsl_readtimestamp(device, context, KGSL_TIMESTAMP_RETIRED);
-	id = context->id;
 
-	list_for_each_entry_safe(event, event_tmp, &device->events, list) {
-		if (event->context != context)
-			continue;
+	spin_lock(&device->event_lock);
+	list_splice_init(&context->events, &cancel);
+	spin_unlock(&device->event_lock);
 
-		/*
-		 * "cancel" the events by calling their callback.
-		 * Currently, events are used for lock and memory
-		 * management, so if the process is dying the right
-		 * thing to do is release or free.
-		 */
-		if (event->func)
-			event->func(device, event->priv, id, cur);
+	/*
+	 * "cancel" the events by calling their callback.
+	 * Currently, events are used for lock and memory
+	 * management, so if the process is dying the right
+	 * thing to do is release or free.
+	 */
+	kgsl_run_events(device, &cancel, &cur);
+}
 
-		list_del(&event->list);
-		kfree(event);
+static void _kgsl_cancel_events(struct list_head *head, void *owner,
+	struct list_head *cancel)
+{
+	struct kgsl_event *event, *event_tmp;
+
+	list_for_each_entry_safe(event, event_tmp, head, list) {
+		if (event->owner == owner)
+			list_move_tail(&event->list, cancel);
 	}
 }
 
@@ -167,29 +221,27 @@ static void kgsl_cancel_events_ctxt(struct kgsl_device *device,
 void kgsl_cancel_events(struct kgsl_device *device,
 	void *owner)
 {
-	struct kgsl_event *event, *event_tmp;
-	unsigned int id, cur;
+	struct kgsl_event *event;
+	struct kgsl_context *context;
+	LIST_HEAD(cancel);
 
-	list_for_each_entry_safe(event, event_tmp, &device->events, list) {
-		if (event->owner != owner)
-			continue;
+	spin_lock(&device->event_lock);
+	_kgsl_cancel_events(&device->events, owner, &cancel);
+	list_for_each_entry(context, &device->events_pending_list, events_list)
+		_kgsl_cancel_events(&context->events, owner, &cancel);
+	spin_unlock(&device->event_lock);
 
-		cur = kgsl_readtimestamp(device, event->context,
+	list_for_each_entry(event, &cancel, list)
+		event->retired = kgsl_readtimestamp(device, event->context,
 					 KGSL_TIMESTAMP_RETIRED);
 
-		id = event->context ? event->context->id : KGSL_MEMSTORE_GLOBAL;
-		/*
-		 * "cancel" the events by calling their callback.
-		 * Currently, events are used for lock and memory
-		 * management, so if the process is dying the right
-		 * thing to do is release or free.
-		 */
-		if (event->func)
-			event->func(device, event->priv, id, cur);
-
-		list_del(&event->list);
-		kfree(event);
-	}
+	/*
+	 * "cancel" the events by calling their callback.
+	 * Currently, events are used for lock and memory
+	 * management, so if the process is dying the right
+	 * thing to do is release or free.
+	 */
+	kgsl_run_events(device, &cancel, NULL);
 }
 EXPORT_SYMBOL(kgsl_cancel_events);
 
@@ -231,10 +283,14 @@ kgsl_mem_entry_create(void)
 {
 	struct kgsl_mem_entry *entry = kzalloc(sizeof(*entry), GFP_KERNEL);
 
-	if (!entry)
+	if (!entry) {
 		KGSL_CORE_ERR("kzalloc(%d) failed\n", sizeof(*entry));
-	else
+	} else {
 		kref_init(&entry->refcount);
+		/* 0 is never a valid generation for the IB check cache */
+		atomic_set(&entry->cpu_generation, 1);
+		INIT_LIST_HEAD(&entry->purge_node);
+	}
 
 	return entry;
 }
@@ -260,6 +316,7 @@ kgsl_mem_entry_destroy(struct kref *kref)
 	}
 
 	kgsl_sharedmem_free(&entry->memdesc);
+	kfree(entry->ib_cache);
 
 	switch (entry->memtype) {
 	case KGSL_MEM_ENTRY_PMEM:
@@ -314,7 +371,8 @@ static void kgsl_mem_entry_detach_process(struct kgsl_mem_entry *entry)
 	if (entry == NULL)
 		return;
 
-	entry->priv->stats[entry->memtype].cur -= entry->memdesc.size;
+	kgsl_process_sub_stats(entry->priv, entry->memtype,
+			       entry->memdesc.size);
 	entry->priv = NULL;
 
 	kgsl_mmu_unmap(entry->memdesc.pagetable, &entry->memdesc);
@@ -322,6 +380,30 @@ static void kgsl_mem_entry_detach_process(struct kgsl_mem_entry *entry)
 	kgsl_mem_entry_put(entry);
 }
 
+/*
+ * Pages in allocations that userspace marked KGSL_MADV_DONTNEED, all of
+ * them can go to the shrinker once nothing but the process holds them.
+ */
+static atomic_t kgsl_purgeable_pages = ATOMIC_INIT(0);
+
+/* call with entry->priv->mem_lock locked */
+static void kgsl_mem_entry_set_purgeable(struct kgsl_mem_entry *entry,
+					 bool purgeable)
+{
+	int pages = PAGE_ALIGN(entry->memdesc.size) >> PAGE_SHIFT;
+
+	if (purgeable == !list_empty(&entry->purge_node))
+		return;
+
+	if (purgeable) {
+		list_add_tail(&entry->purge_node, &entry->priv->purgeable);
+		atomic_add(pages, &kgsl_purgeable_pages);
+	} else {
+		list_del_init(&entry->purge_node);
+		atomic_sub(pages, &kgsl_purgeable_pages);
+	}
+}
+
 /* Allocate a new context id */
 
 static struct kgsl_context *
@@ -367,6 +449,8 @@ kgsl_create_context(struct kgsl_device_private *dev_priv)
 	kref_init(&context->refcount);
 	context->id = id;
 	context->dev_priv = dev_priv;
+	INIT_LIST_HEAD(&context->events);
+	INIT_LIST_HEAD(&context->events_list);
 
 	if (kgsl_sync_timeline_create(context)) {
 		idr_remove(&dev_priv->device->context_idr, id);
@@ -398,6 +482,15 @@ kgsl_context_detach(struct kgsl_context *context)
 	trace_kgsl_context_detach(device, context);
 	id = context->id;
 
+	/*
+	 * The retire worker reads the timestamps of the contexts on the
+	 * pending list without device->mutex, so take this one off before
+	 * its devctxt goes away.
+	 */
+	spin_lock(&device->event_lock);
+	list_del_init(&context->events_list);
+	spin_unlock(&device->event_lock);
+
 	if (device->ftbl->drawctxt_destroy)
 		device->ftbl->drawctxt_destroy(device, context);
 	/*device specific drawctxt_destroy MUST clean up devctxt */
@@ -422,46 +515,114 @@ kgsl_context_destroy(struct kref *kref)
 	kfree(context);
 }
 
-void kgsl_timestamp_expired(struct work_struct *work)
+/*
+ * Move the expired events at the head of @head to @expired.  With @fast
+ * set, stop at the first expired event that needs device->mutex.
+ * Returns true if the mutex is needed, either for such an event or to
+ * send the new head of a context's list to the device.  Called with
+ * device->event_lock held.
+ */
+static bool _kgsl_expire_events(struct kgsl_device *device,
+	struct kgsl_context *context, struct list_head *head,
+	struct list_head *expired, bool fast)
 {
-	struct kgsl_device *device = container_of(work, struct kgsl_device,
-		ts_expired_ws);
 	struct kgsl_event *event, *event_tmp;
-	uint32_t ts_processed;
-	unsigned int id;
+	unsigned int retired;
+	bool moved = false;
 
-	mutex_lock(&device->mutex);
+	if (list_empty(head))
+		return false;
 
-	/* Process expired events */
-	list_for_each_entry_safe(event, event_tmp, &device->events, list) {
-		ts_processed = kgsl_readtimestamp(device, event->context,
-						  KGSL_TIMESTAMP_RETIRED);
-		if (timestamp_cmp(ts_processed, event->timestamp) < 0)
-			continue;
+	retired = kgsl_readtimestamp(device, context, KGSL_TIMESTAMP_RETIRED);
 
-		id = event->context ? event->context->id : KGSL_MEMSTORE_GLOBAL;
+	list_for_each_entry_safe(event, event_tmp, head, list) {
+		if (timestamp_cmp(retired, event->timestamp) < 0)
+			return moved && context;
 
-		if (event->func)
-			event->func(device, event->priv, id, ts_processed);
+		if (fast && !(event->flags & KGSL_EVENT_NOMUTEX))
+			return true;
 
-		list_del(&event->list);
-		kfree(event);
+		event->retired = retired;
+		list_move_tail(&event->list, expired);
+		moved = true;
 	}
 
-	/* Send the next pending event for each context to the device */
-	if (device->ftbl->next_event) {
-		unsigned int id = KGSL_MEMSTORE_GLOBAL;
+	return false;
+}
+
+static bool kgsl_expire_events(struct kgsl_device *device,
+	struct list_head *expired, bool fast)
+{
+	struct kgsl_context *context;
+	bool need_mutex;
 
-		list_for_each_entry(event, &device->events, list) {
+	spin_lock(&device->event_lock);
 
-			if (!event->context)
-				continue;
+	need_mutex = _kgsl_expire_events(device, NULL, &device->events,
+		expired, fast);
 
-			if (event->context->id != id) {
-				device->ftbl->next_event(device, event);
-				id = event->context->id;
-			}
+	list_for_each_entry(context, &device->events_pending_list,
+		events_list) {
+		if (_kgsl_expire_events(device, context, &context->events,
+			expired, fast))
+			need_mutex = true;
+	}
+
+	if (device->events_rearm) {
+		need_mutex = true;
+		if (!fast)
+			device->events_rearm = false;
+	}
+
+	spin_unlock(&device->event_lock);
+
+	return need_mutex;
+}
+
+void kgsl_timestamp_expired(struct work_struct *work)
+{
+	struct kgsl_device *device = container_of(work, struct kgsl_device,
+		ts_expired_ws);
+	struct kgsl_context *context, *context_tmp;
+	struct kgsl_event next;
+	LIST_HEAD(expired);
+	bool need_mutex;
+
+	/*
+	 * Events that can do without device->mutex are fired first, so
+	 * that fences signal even while a submission holds the mutex.
+	 * Contexts are only removed from events_pending_list under the
+	 * mutex and before their devctxt goes away, so reading their
+	 * timestamps under the event lock is safe.
+	 */
+	need_mutex = kgsl_expire_events(device, &expired, true);
+	kgsl_run_events(device, &expired, NULL);
+
+	if (!need_mutex)
+		return;
+
+	mutex_lock(&device->mutex);
+
+	/* Process the rest of the expired events */
+	kgsl_expire_events(device, &expired, false);
+	kgsl_run_events(device, &expired, NULL);
+
+	/* Send the next pending event for each context to the device */
+	list_for_each_entry_safe(context, context_tmp,
+		&device->events_pending_list, events_list) {
+
+		spin_lock(&device->event_lock);
+		if (list_empty(&context->events)) {
+			list_del_init(&context->events_list);
+			spin_unlock(&device->event_lock);
+			continue;
 		}
+		next = *list_first_entry(&context->events, struct kgsl_event,
+			list);
+		spin_unlock(&device->event_lock);
+
+		if (device->ftbl->next_event)
+			device->ftbl->next_event(device, &next);
 	}
 
 	mutex_unlock(&device->mutex);
@@ -720,6 +881,7 @@ kgsl_get_process_private(struct kgsl_device_private *cur_dev_priv)
 	private->refcnt = 1;
 	private->pid = task_tgid_nr(current);
 	private->mem_rb = RB_ROOT;
+	INIT_LIST_HEAD(&private->purgeable);
 
 	if (kgsl_mmu_enabled())
 	{
@@ -734,6 +896,15 @@ kgsl_get_process_private(struct kgsl_device_private *cur_dev_priv)
 		}
 	}
 
+	/*
+	 * The mm_struct has to outlive the allocations charged to it, which
+	 * can be freed after the process exited when the last file goes.
+	 */
+	if (current->mm) {
+		private->mm = current->mm;
+		atomic_inc(&private->mm->mm_count);
+	}
+
 	list_add(&private->list, &kgsl_driver.process_list);
 
 	kgsl_process_init_sysfs(private);
@@ -767,9 +938,12 @@ kgsl_put_process_private(struct kgsl_device *device,
 		node = rb_next(&entry->node);
 
 		rb_erase(&entry->node, &private->mem_rb);
+		kgsl_mem_entry_set_purgeable(entry, false);
 		kgsl_mem_entry_detach_process(entry);
 	}
 	kgsl_mmu_putpagetable(private->pagetable);
+	if (private->mm)
+		mmdrop(private->mm);
 	kfree(private);
 unlock:
 	mutex_unlock(&kgsl_driver.process_mutex);
@@ -1101,6 +1275,7 @@ static long kgsl_ioctl_rb_issueibcmds(struct kgsl_device_private *dev_priv,
 	struct kgsl_ringbuffer_issueibcmds *param = data;
 	struct kgsl_ibdesc *ibdesc;
 	struct kgsl_context *context;
+	ktime_t start;
 
 	context = kgsl_find_context(dev_priv, param->drawctxt_id);
 	if (context == NULL) {
@@ -1171,6 +1346,7 @@ static long kgsl_ioctl_rb_issueibcmds(struct kgsl_device_private *dev_priv,
 		param->numibs = 1;
 	}
 
+	start = ktime_get();
 	result = dev_priv->device->ftbl->issueibcmds(dev_priv,
 					     context,
 					     ibdesc,
@@ -1179,6 +1355,10 @@ static long kgsl_ioctl_rb_issueibcmds(struct kgsl_device_private *dev_priv,
 					     param->flags);
 
 	trace_kgsl_issueibcmds(dev_priv->device, param, ibdesc, result);
+	if (!result)
+		trace_kgsl_submit(dev_priv->device, context->id,
+				  param->timestamp, param->numibs,
+				  ktime_us_delta(ktime_get(), start));
 
 free_ibdesc:
 	kfree(ibdesc);
@@ -1250,6 +1430,11 @@ static long _cmdstream_freememontimestamp(struct kgsl_device_private *dev_priv,
 
 	spin_lock(&dev_priv->process_priv->mem_lock);
 	entry = kgsl_sharedmem_find(dev_priv->process_priv, gpuaddr);
+	/* the event keeps a pointer to the entry, it must not be purged */
+	if (entry) {
+		kgsl_mem_entry_set_purgeable(entry, false);
+		entry->flags |= KGSL_MEM_ENTRY_FREEING;
+	}
 	spin_unlock(&dev_priv->process_priv->mem_lock);
 
 	if (!entry) {
@@ -1356,8 +1541,10 @@ static long kgsl_ioctl_sharedmem_free(struct kgsl_device_private *dev_priv,
 
 	spin_lock(&private->mem_lock);
 	entry = kgsl_sharedmem_find(private, param->gpuaddr);
-	if (entry)
+	if (entry) {
 		rb_erase(&entry->node, &private->mem_rb);
+		kgsl_mem_entry_set_purgeable(entry, false);
+	}
 
 	spin_unlock(&private->mem_lock);
 
@@ -1885,7 +2072,8 @@ kgsl_ioctl_gpumem_alloc(struct kgsl_device_private *dev_priv,
 		kgsl_mem_entry_attach_process(entry, private);
 		param->gpuaddr = entry->memdesc.gpuaddr;
 
-		kgsl_process_add_stats(private, entry->memtype, param->size);
+		kgsl_process_add_stats(private, entry->memtype,
+				       entry->memdesc.size);
 		trace_kgsl_mem_alloc(entry);
 	} else
 		kfree(entry);
@@ -1893,6 +2081,118 @@ kgsl_ioctl_gpumem_alloc(struct kgsl_device_private *dev_priv,
 	kgsl_check_idle(dev_priv->device);
 	return result;
 }
+
+static long
+kgsl_ioctl_gpumem_madvise(struct kgsl_device_private *dev_priv,
+			  unsigned int cmd, void *data)
+{
+	struct kgsl_process_private *private = dev_priv->process_priv;
+	struct kgsl_gpumem_madvise *param = data;
+	struct kgsl_mem_entry *entry;
+	int result = 0;
+
+	if (param->state != KGSL_MADV_WILLNEED &&
+	    param->state != KGSL_MADV_DONTNEED)
+		return -EINVAL;
+
+	spin_lock(&private->mem_lock);
+	entry = kgsl_sharedmem_find(private, param->gpuaddr);
+	if (entry && entry->memdesc.gpuaddr != param->gpuaddr)
+		entry = NULL;
+
+	if (param->state == KGSL_MADV_WILLNEED) {
+		/* a purged allocation is gone, tell userspace to start over */
+		param->retained = entry != NULL;
+		if (entry)
+			kgsl_mem_entry_set_purgeable(entry, false);
+	} else if (entry && entry->memtype == KGSL_MEM_ENTRY_KERNEL &&
+		   !(entry->flags & KGSL_MEM_ENTRY_FREEING)) {
+		kgsl_mem_entry_set_purgeable(entry, true);
+		param->retained = 1;
+	} else {
+		result = -EINVAL;
+	}
+	spin_unlock(&private->mem_lock);
+
+	return result;
+}
+
+/*
+ * Free up to @nr_to_scan pages of purgeable allocations.  Holding every
+ * device mutex keeps command submission away from the entries, and the
+ * process mutex keeps the process structures around.  Only trylocks are
+ * taken since allocations under any of them can end up here.
+ */
+static void kgsl_purge(int nr_to_scan)
+{
+	struct kgsl_process_private *private;
+	struct kgsl_mem_entry *entry, *tmp;
+	int i, locked;
+
+	if (!mutex_trylock(&kgsl_driver.process_mutex))
+		return;
+	if (!mutex_trylock(&kgsl_driver.devlock)) {
+		mutex_unlock(&kgsl_driver.process_mutex);
+		return;
+	}
+
+	for (locked = 0; locked < KGSL_DEVICE_MAX; locked++) {
+		struct kgsl_device *device = kgsl_driver.devp[locked];
+
+		if (device && !mutex_trylock(&device->mutex))
+			goto unlock;
+	}
+
+	list_for_each_entry(private, &kgsl_driver.process_list, list) {
+		while (nr_to_scan > 0) {
+			spin_lock(&private->mem_lock);
+			entry = NULL;
+			list_for_each_entry(tmp, &private->purgeable,
+					    purge_node) {
+				/* not while mapped or looked at elsewhere */
+				if (atomic_read(&tmp->refcount.refcount) == 1) {
+					entry = tmp;
+					break;
+				}
+			}
+			if (entry) {
+				kgsl_mem_entry_set_purgeable(entry, false);
+				rb_erase(&entry->node, &private->mem_rb);
+			}
+			spin_unlock(&private->mem_lock);
+
+			if (entry == NULL)
+				break;
+
+			nr_to_scan -= PAGE_ALIGN(entry->memdesc.size) >>
+				      PAGE_SHIFT;
+			trace_kgsl_mem_free(entry);
+			kgsl_mem_entry_detach_process(entry);
+		}
+	}
+
+unlock:
+	for (i = 0; i < locked; i++)
+		if (kgsl_driver.devp[i])
+			mutex_unlock(&kgsl_driver.devp[i]->mutex);
+	mutex_unlock(&kgsl_driver.devlock);
+	mutex_unlock(&kgsl_driver.process_mutex);
+}
+
+static int kgsl_purge_shrink(struct shrinker *shrinker,
+			     struct shrink_control *sc)
+{
+	if (sc->nr_to_scan > 0)
+		kgsl_purge(sc->nr_to_scan);
+
+	return atomic_read(&kgsl_purgeable_pages);
+}
+
+static struct shrinker kgsl_purge_shrinker = {
+	.shrink = kgsl_purge_shrink,
+	.seeks = DEFAULT_SEEKS,
+};
+static bool kgsl_purge_shrinker_registered;
 static long kgsl_ioctl_cff_syncmem(struct kgsl_device_private *dev_priv,
 					unsigned int cmd, void *data)
 {
@@ -1995,8 +2295,9 @@ static int kgsl_add_genlock_event(struct kgsl_device *device,
 		return ret;
 	}
 
-	ret = kgsl_add_event(device, context_id, timestamp,
-			kgsl_genlock_event_cb, event, owner);
+	ret = kgsl_add_event_flags(device, context_id, timestamp,
+			kgsl_genlock_event_cb, event, owner,
+			KGSL_EVENT_NOMUTEX);
 	if (ret)
 		kfree(event);
 
@@ -2084,6 +2385,8 @@ static const struct {
 			kgsl_ioctl_sharedmem_flush_cache, 0),
 	KGSL_IOCTL_FUNC(IOCTL_KGSL_GPUMEM_ALLOC,
 			kgsl_ioctl_gpumem_alloc, 0),
+	KGSL_IOCTL_FUNC(IOCTL_KGSL_GPUMEM_MADVISE,
+			kgsl_ioctl_gpumem_madvise, 0),
 	KGSL_IOCTL_FUNC(IOCTL_KGSL_CFF_SYNCMEM,
 			kgsl_ioctl_cff_syncmem, 0),
 	KGSL_IOCTL_FUNC(IOCTL_KGSL_CFF_USER_EVENT,
@@ -2241,6 +2544,9 @@ kgsl_gpumem_vm_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 	if (!entry->memdesc.ops || !entry->memdesc.ops->vmfault)
 		return VM_FAULT_SIGBUS;
 
+	/* The CPU may write through the new pte, see _parse_ibs() */
+	atomic_inc(&entry->cpu_generation);
+
 	return entry->memdesc.ops->vmfault(&entry->memdesc, vma, vmf);
 }
 
@@ -2290,6 +2596,11 @@ static int kgsl_mmap(struct file *file, struct vm_area_struct *vma)
 
 	vma->vm_flags |= entry->memdesc.ops->vmflags(&entry->memdesc);
 
+	/* CPU writes can only be tracked through a single mapping */
+	if (entry->cpu_mapping && entry->cpu_mapping != file->f_mapping)
+		entry->flags |= KGSL_MEM_ENTRY_UNTRACKED;
+	entry->cpu_mapping = file->f_mapping;
+
 	vma->vm_private_data = entry;
 	vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
 	vma->vm_ops = &kgsl_gpumem_vm_ops;
@@ -2493,6 +2804,9 @@ int kgsl_device_platform_probe(struct kgsl_device *device)
 	/* Initialize common sysfs entries */
 	kgsl_pwrctrl_init_sysfs(device);
 
+	/* nothing else depends on the GPU being resumed */
+	device_enable_async_suspend(&pdev->dev);
+
 	return 0;
 
 error_close_mmu:
@@ -2628,6 +2942,11 @@ static void kgsl_core_exit(void)
 	kgsl_drm_exit();
 	kgsl_cffdump_destroy();
 	kgsl_core_debugfs_close();
+	kgsl_pool_exit();
+	if (kgsl_purge_shrinker_registered) {
+		unregister_shrinker(&kgsl_purge_shrinker);
+		kgsl_purge_shrinker_registered = false;
+	}
 
 	/*
 	 * We call kgsl_sharedmem_uninit_sysfs() and device_unregister()
@@ -2703,8 +3022,11 @@ static int __init kgsl_core_init(void)
 
 	kgsl_sharedmem_init_sysfs();
 	kgsl_cffdump_init();
+	kgsl_pool_init();
 
 	INIT_LIST_HEAD(&kgsl_driver.process_list);
+	register_shrinker(&kgsl_purge_shrinker);
+	kgsl_purge_shrinker_registered = true;
 
 	INIT_LIST_HEAD(&kgsl_driver.pagetable_list);
 
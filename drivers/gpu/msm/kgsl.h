@@ -107,6 +107,7 @@ struct kgsl_driver {
 		unsigned int coherent_max;
 		unsigned int mapped;
 		unsigned int mapped_max;
+		unsigned int page_pool;
 		unsigned int histogram[16];
 	} stats;
 };
@@ -152,6 +153,12 @@ struct kgsl_memdesc {
 /* List of flags */
 
 #define KGSL_MEM_ENTRY_FROZEN (1 << 0)
+/* mapped to userspace through more than one file */
+#define KGSL_MEM_ENTRY_UNTRACKED (1 << 1)
+/* freed by a timestamp event, can no longer be purged */
+#define KGSL_MEM_ENTRY_FREEING (1 << 2)
+
+struct kgsl_ib_cache;
 
 struct kgsl_mem_entry {
 	struct kref refcount;
@@ -164,6 +171,17 @@ struct kgsl_mem_entry {
 	/* back pointer to private structure under whose context this
 	* allocation is made */
 	struct kgsl_process_private *priv;
+	/*
+	 * Userspace mapping of the entry and a count of the CPU faults
+	 * into it.  After the mapping has been zapped, a changed count
+	 * tells that the CPU may have touched the memory.
+	 */
+	struct address_space *cpu_mapping;
+	atomic_t cpu_generation;
+	/* command streams in this entry that passed IB checking */
+	struct kgsl_ib_cache *ib_cache;
+	/* on priv->purgeable while userspace does not need the contents */
+	struct list_head purge_node;
 };
 
 #ifdef CONFIG_MSM_KGSL_MMU_PAGE_FAULT
@@ -186,6 +204,10 @@ int kgsl_add_event(struct kgsl_device *device, u32 id, u32 ts,
 	void (*cb)(struct kgsl_device *, void *, u32, u32), void *priv,
 	void *owner);
 
+int kgsl_add_event_flags(struct kgsl_device *device, u32 id, u32 ts,
+	void (*cb)(struct kgsl_device *, void *, u32, u32), void *priv,
+	void *owner, unsigned int flags);
+
 void kgsl_cancel_events(struct kgsl_device *device,
 	void *owner);
 
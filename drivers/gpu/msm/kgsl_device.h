@@ -14,6 +14,7 @@
 #define __KGSL_DEVICE_H
 
 #include <linux/idr.h>
+#include <linux/mm.h>
 #include <linux/pm_qos.h>
 #include <linux/earlysuspend.h>
 
@@ -126,9 +127,15 @@ struct kgsl_mh {
 	int              mpu_range;
 };
 
+/* The event callback does not need device->mutex */
+#define KGSL_EVENT_NOMUTEX	BIT(0)
+
 struct kgsl_event {
 	struct kgsl_context *context;
+	uint32_t id;
 	uint32_t timestamp;
+	uint32_t retired;
+	unsigned int flags;
 	void (*func)(struct kgsl_device *, void *, u32, u32);
 	void *priv;
 	struct list_head list;
@@ -180,6 +187,8 @@ struct kgsl_device {
 	int snapshot_frozen;	/* 1 if the snapshot output is frozen until
 				   it gets read by the user.  This avoids
 				   losing the output on multiple hangs  */
+	unsigned int snapshot_stall_ms;	/* Time allowed for a snapshot */
+	unsigned long snapshot_deadline; /* jiffies the snapshot must end */
 	struct kobject snapshot_kobj;
 
 	/*
@@ -198,7 +207,14 @@ struct kgsl_device {
 	struct kobject pwrscale_kobj;
 	struct pm_qos_request pm_qos_req_dma;
 	struct work_struct ts_expired_ws;
+	/* Events on the global timestamp, in timestamp order */
 	struct list_head events;
+	/* Contexts with per-context events */
+	struct list_head events_pending_list;
+	/* Protects the event lists and events_rearm */
+	spinlock_t event_lock;
+	/* An event was added that the device has not been told about */
+	bool events_rearm;
 	s64 on_time;
 
 	/* Postmortem Control switches */
@@ -218,6 +234,8 @@ void kgsl_timestamp_expired(struct work_struct *work);
 			kgsl_timestamp_expired),\
 	.context_idr = IDR_INIT((_dev).context_idr),\
 	.events = LIST_HEAD_INIT((_dev).events),\
+	.events_pending_list = LIST_HEAD_INIT((_dev).events_pending_list),\
+	.event_lock = __SPIN_LOCK_UNLOCKED((_dev).event_lock),\
 	.wait_queue = __WAIT_QUEUE_HEAD_INITIALIZER((_dev).wait_queue),\
 	.mutex = __MUTEX_INITIALIZER((_dev).mutex),\
 	.state = KGSL_STATE_INIT,\
@@ -244,6 +262,11 @@ struct kgsl_context {
 	 * sync_pt timestamp expires.
 	 */
 	struct sync_timeline *timeline;
+
+	/* Events on this context's timestamp, in timestamp order */
+	struct list_head events;
+	/* Entry in the device's events_pending_list */
+	struct list_head events_list;
 };
 
 struct kgsl_process_private {
@@ -254,6 +277,10 @@ struct kgsl_process_private {
 	struct kgsl_pagetable *pagetable;
 	struct list_head list;
 	struct kobject kobj;
+	/* charged for the page allocations, see kgsl_process_add_stats() */
+	struct mm_struct *mm;
+	/* allocations userspace marked KGSL_MADV_DONTNEED, oldest first */
+	struct list_head purgeable;
 
 	struct {
 		unsigned int cur;
@@ -279,6 +306,24 @@ static inline void kgsl_process_add_stats(struct kgsl_process_private *priv,
 	priv->stats[type].cur += size;
 	if (priv->stats[type].max < priv->stats[type].cur)
 		priv->stats[type].max = priv->stats[type].cur;
+
+	/*
+	 * Pages the driver allocated for the process are not in its rss,
+	 * count them so that the low memory killer sees them.
+	 */
+	if (type == KGSL_MEM_ENTRY_KERNEL && priv->mm)
+		add_mm_counter(priv->mm, MM_DRIVERPAGES,
+			       PAGE_ALIGN(size) >> PAGE_SHIFT);
+}
+
+static inline void kgsl_process_sub_stats(struct kgsl_process_private *priv,
+	unsigned int type, size_t size)
+{
+	priv->stats[type].cur -= size;
+
+	if (type == KGSL_MEM_ENTRY_KERNEL && priv->mm)
+		add_mm_counter(priv->mm, MM_DRIVERPAGES,
+			       -(long)(PAGE_ALIGN(size) >> PAGE_SHIFT));
 }
 
 static inline void kgsl_regread(struct kgsl_device *device,
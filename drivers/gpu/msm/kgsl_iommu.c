@@ -11,6 +11,7 @@
  *
  */
 #include <linux/types.h>
+#include <linux/bitmap.h>
 #include <linux/device.h>
 #include <linux/spinlock.h>
 #include <linux/genalloc.h>
@@ -36,6 +37,12 @@
 
 struct remote_iommu_petersons_spinlock kgsl_iommu_sync_lock_vars;
 
+/* ASIDs in use and freed pagetables, shared by all devices */
+static DEFINE_SPINLOCK(kgsl_iommu_pt_lock);
+static DECLARE_BITMAP(kgsl_iommu_asids, KGSL_IOMMU_ASID_MAX + 1);
+static LIST_HEAD(kgsl_iommu_pt_pool);
+static unsigned int kgsl_iommu_pt_pool_count;
+
 static struct kgsl_iommu_unit *get_iommu_unit(struct device *dev)
 {
 	int i, j, k;
@@ -290,27 +297,76 @@ static int kgsl_iommu_pt_equal(struct kgsl_pagetable *pt,
 }
 
 /*
- * kgsl_iommu_destroy_pagetable - Free up reaources help by a pagetable
- * @mmu_specific_pt - Pointer to pagetable which is to be freed
+ * kgsl_iommu_alloc_asid - Pick the ASID for a new pagetable
  *
- * Return - void
+ * Return - a free ASID, the shared one if there is none left or 0 if the
+ * IOMMU is not programmed with ASIDs by kgsl
  */
-static void kgsl_iommu_destroy_pagetable(void *mmu_specific_pt)
+static unsigned int kgsl_iommu_alloc_asid(void)
 {
-	struct kgsl_iommu_pt *iommu_pt = mmu_specific_pt;
+	unsigned int asid;
+
+	if (msm_soc_version_supports_iommu_v1())
+		return 0;
+
+	spin_lock(&kgsl_iommu_pt_lock);
+	asid = find_next_zero_bit(kgsl_iommu_asids, KGSL_IOMMU_ASID_MAX + 1,
+				KGSL_IOMMU_ASID_SHARED + 1);
+	if (asid > KGSL_IOMMU_ASID_MAX)
+		asid = KGSL_IOMMU_ASID_SHARED;
+	else
+		__set_bit(asid, kgsl_iommu_asids);
+	spin_unlock(&kgsl_iommu_pt_lock);
+	return asid;
+}
+
+static void kgsl_iommu_free_asid(unsigned int asid)
+{
+	if (asid <= KGSL_IOMMU_ASID_SHARED)
+		return;
+
+	spin_lock(&kgsl_iommu_pt_lock);
+	__clear_bit(asid, kgsl_iommu_asids);
+	spin_unlock(&kgsl_iommu_pt_lock);
+}
+
+static void kgsl_iommu_free_pagetable(struct kgsl_iommu_pt *iommu_pt)
+{
+	kgsl_iommu_free_asid(iommu_pt->asid);
 	if (iommu_pt->domain)
 		iommu_domain_free(iommu_pt->domain);
 	kfree(iommu_pt);
 }
 
 /*
- * kgsl_iommu_create_pagetable - Create a IOMMU pagetable
+ * kgsl_iommu_destroy_pagetable - Free up reaources help by a pagetable
+ * @mmu_specific_pt - Pointer to pagetable which is to be freed
  *
- * Allocate memory to hold a pagetable and allocate the IOMMU
- * domain which is the actual IOMMU pagetable
+ * Everything has been unmapped from the pagetable by now, so a few of them
+ * are kept with their domain and ASID for the next processes to start
  * Return - void
  */
-void *kgsl_iommu_create_pagetable(void)
+static void kgsl_iommu_destroy_pagetable(void *mmu_specific_pt)
+{
+	struct kgsl_iommu_pt *iommu_pt = mmu_specific_pt;
+
+	spin_lock(&kgsl_iommu_pt_lock);
+	if (kgsl_iommu_pt_pool_count < KGSL_IOMMU_PT_POOL_SIZE) {
+		list_add(&iommu_pt->pool_node, &kgsl_iommu_pt_pool);
+		kgsl_iommu_pt_pool_count++;
+		iommu_pt = NULL;
+	}
+	spin_unlock(&kgsl_iommu_pt_lock);
+
+	if (iommu_pt)
+		kgsl_iommu_free_pagetable(iommu_pt);
+}
+
+/*
+ * kgsl_iommu_alloc_pagetable - Allocate memory to hold a pagetable and
+ * allocate the IOMMU domain which is the actual IOMMU pagetable
+ */
+static struct kgsl_iommu_pt *kgsl_iommu_alloc_pagetable(void)
 {
 	struct kgsl_iommu_pt *iommu_pt;
 
@@ -330,10 +386,66 @@ void *kgsl_iommu_create_pagetable(void)
 		iommu_set_fault_handler(iommu_pt->domain,
 			kgsl_iommu_fault_handler);
 	}
+	iommu_pt->asid = kgsl_iommu_alloc_asid();
 
 	return iommu_pt;
 }
 
+/* take a pagetable out of the pool, NULL if it is empty */
+static struct kgsl_iommu_pt *kgsl_iommu_pt_pool_get(void)
+{
+	struct kgsl_iommu_pt *iommu_pt = NULL;
+
+	spin_lock(&kgsl_iommu_pt_lock);
+	if (!list_empty(&kgsl_iommu_pt_pool)) {
+		iommu_pt = list_first_entry(&kgsl_iommu_pt_pool,
+					struct kgsl_iommu_pt, pool_node);
+		list_del(&iommu_pt->pool_node);
+		kgsl_iommu_pt_pool_count--;
+	}
+	spin_unlock(&kgsl_iommu_pt_lock);
+	return iommu_pt;
+}
+
+/*
+ * kgsl_iommu_create_pagetable - Create a IOMMU pagetable
+ *
+ * Take a pagetable from the pool if there is one, else allocate a new one
+ * Return - void
+ */
+void *kgsl_iommu_create_pagetable(void)
+{
+	struct kgsl_iommu_pt *iommu_pt = kgsl_iommu_pt_pool_get();
+
+	return iommu_pt ? iommu_pt : kgsl_iommu_alloc_pagetable();
+}
+
+/*
+ * kgsl_iommu_fill_pt_pool - Create pagetables ahead of the processes that
+ * will use them, so that their first submission does not wait for it
+ */
+static void kgsl_iommu_fill_pt_pool(void)
+{
+#ifdef CONFIG_KGSL_PER_PROCESS_PAGE_TABLE
+	struct kgsl_iommu_pt *iommu_pt;
+
+	while (kgsl_iommu_pt_pool_count < KGSL_IOMMU_PT_POOL_SIZE) {
+		iommu_pt = kgsl_iommu_alloc_pagetable();
+		if (!iommu_pt)
+			break;
+		kgsl_iommu_destroy_pagetable(iommu_pt);
+	}
+#endif
+}
+
+static void kgsl_iommu_drain_pt_pool(void)
+{
+	struct kgsl_iommu_pt *iommu_pt;
+
+	while ((iommu_pt = kgsl_iommu_pt_pool_get()))
+		kgsl_iommu_free_pagetable(iommu_pt);
+}
+
 /*
  * kgsl_detach_pagetable_iommu_domain - Detach the IOMMU unit from a
  * pagetable
@@ -766,6 +878,12 @@ static unsigned int kgsl_iommu_pt_get_base_addr(struct kgsl_pagetable *pt)
 	return iommu_get_pt_base_addr(iommu_pt->domain);
 }
 
+static unsigned int kgsl_iommu_pt_get_asid(struct kgsl_pagetable *pt)
+{
+	struct kgsl_iommu_pt *iommu_pt = pt->priv;
+	return iommu_pt->asid;
+}
+
 /*
  * kgsl_iommu_get_pt_lsb - Return the lsb of the ttbr0 IOMMU register
  * @mmu - Pointer to mmu structure
@@ -805,8 +923,15 @@ static void kgsl_iommu_setstate(struct kgsl_mmu *mmu,
 			unsigned int flags = 0;
 			mmu->hwpagetable = pagetable;
 			flags |= kgsl_mmu_pt_get_flags(mmu->hwpagetable,
-							mmu->device->id) |
-							KGSL_MMUFLAGS_TLBFLUSH;
+							mmu->device->id);
+			/*
+			 * Entries tagged with a private ASID only go stale
+			 * when the pagetable changed, which sets its
+			 * tlb_flags, all others need a flush on every switch
+			 */
+			if (kgsl_iommu_pt_get_asid(pagetable) <=
+				KGSL_IOMMU_ASID_SHARED)
+				flags |= KGSL_MMUFLAGS_TLBFLUSH;
 			kgsl_setstate(mmu, context_id,
 				KGSL_MMUFLAGS_PTUPDATE | flags);
 		}
@@ -844,6 +969,8 @@ static int kgsl_iommu_init(struct kgsl_mmu *mmu)
 				KGSL_IOMMU_SETSTATE_NOP_OFFSET,
 				cp_nop_packet(1));
 
+	kgsl_iommu_fill_pt_pool();
+
 	dev_info(mmu->device->dev, "|%s| MMU type set for device is IOMMU\n",
 			__func__);
 done:
@@ -925,6 +1052,7 @@ static int kgsl_iommu_start(struct kgsl_mmu *mmu)
 	struct kgsl_device *device = mmu->device;
 	int status;
 	struct kgsl_iommu *iommu = mmu->priv;
+	unsigned int asid;
 	int i, j;
 
 	if (mmu->flags & KGSL_FLAGS_STARTED)
@@ -986,6 +1114,21 @@ static int kgsl_iommu_start(struct kgsl_mmu *mmu)
 						iommu_unit->dev[j].ctx_id,
 						TTBR0));
 	}
+	/*
+	 * The attach tagged the user context with an ASID of msm_iommu's,
+	 * switch it to the one of the defaultpagetable
+	 */
+	asid = kgsl_iommu_pt_get_asid(mmu->defaultpagetable);
+	if (asid) {
+		for (i = 0; i < iommu->unit_count; i++) {
+			void *base = iommu->iommu_units[i].reg_map.hostptr;
+			KGSL_IOMMU_SET_IOMMU_REG(base, KGSL_IOMMU_CONTEXT_USER,
+						CONTEXTIDR, asid);
+			KGSL_IOMMU_SET_IOMMU_REG(base, KGSL_IOMMU_CONTEXT_USER,
+						CTX_TLBIASID, asid);
+		}
+		mb();
+	}
 
 	kgsl_iommu_disable_clk_on_ts(mmu, 0, false);
 	mmu->flags |= KGSL_FLAGS_STARTED;
@@ -1105,6 +1248,7 @@ static int kgsl_iommu_close(struct kgsl_mmu *mmu)
 		kgsl_mmu_putpagetable(mmu->priv_bank_table);
 	if (mmu->defaultpagetable)
 		kgsl_mmu_putpagetable(mmu->defaultpagetable);
+	kgsl_iommu_drain_pt_pool();
 	kfree(iommu);
 
 	return 0;
@@ -1149,6 +1293,7 @@ static void kgsl_iommu_default_setstate(struct kgsl_mmu *mmu,
 	int i;
 	unsigned int pt_base = kgsl_iommu_pt_get_base_addr(
 					mmu->hwpagetable);
+	unsigned int asid = kgsl_iommu_pt_get_asid(mmu->hwpagetable);
 	unsigned int pt_val;
 
 	if (kgsl_iommu_enable_clk(mmu, KGSL_IOMMU_CONTEXT_USER)) {
@@ -1175,6 +1320,11 @@ static void kgsl_iommu_default_setstate(struct kgsl_mmu *mmu,
 						KGSL_IOMMU_CONTEXT_USER);
 			pt_val += pt_base;
 
+			if (asid)
+				KGSL_IOMMU_SET_IOMMU_REG(
+					iommu->iommu_units[i].reg_map.hostptr,
+					KGSL_IOMMU_CONTEXT_USER, CONTEXTIDR,
+					asid);
 			KGSL_IOMMU_SET_IOMMU_REG(
 				iommu->iommu_units[i].reg_map.hostptr,
 				KGSL_IOMMU_CONTEXT_USER, TTBR0, pt_val);
@@ -1188,10 +1338,16 @@ static void kgsl_iommu_default_setstate(struct kgsl_mmu *mmu,
 	/* Flush tlb */
 	if (flags & KGSL_MMUFLAGS_TLBFLUSH) {
 		for (i = 0; i < iommu->unit_count; i++) {
-			KGSL_IOMMU_SET_IOMMU_REG(
-				iommu->iommu_units[i].reg_map.hostptr,
-				KGSL_IOMMU_CONTEXT_USER, CTX_TLBIALL,
-				1);
+			if (asid)
+				KGSL_IOMMU_SET_IOMMU_REG(
+					iommu->iommu_units[i].reg_map.hostptr,
+					KGSL_IOMMU_CONTEXT_USER, CTX_TLBIASID,
+					asid);
+			else
+				KGSL_IOMMU_SET_IOMMU_REG(
+					iommu->iommu_units[i].reg_map.hostptr,
+					KGSL_IOMMU_CONTEXT_USER, CTX_TLBIALL,
+					1);
 			mb();
 		}
 	}
@@ -1264,4 +1420,5 @@ struct kgsl_mmu_pt_ops iommu_pt_ops = {
 	.mmu_destroy_pagetable = kgsl_iommu_destroy_pagetable,
 	.mmu_pt_equal = kgsl_iommu_pt_equal,
 	.mmu_pt_get_base_addr = kgsl_iommu_pt_get_base_addr,
+	.mmu_pt_get_asid = kgsl_iommu_pt_get_asid,
 };
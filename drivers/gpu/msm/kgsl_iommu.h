@@ -16,6 +16,7 @@
 #include <mach/iommu.h>
 
 /* IOMMU registers and masks */
+#define KGSL_IOMMU_CONTEXTIDR			0x008
 #define KGSL_IOMMU_TTBR0			0x10
 #define KGSL_IOMMU_TTBR1			0x14
 #define KGSL_IOMMU_FSR				0x20
@@ -23,6 +24,7 @@
 #define KGSL_IOMMU_TTBR0_PA_MASK		0x0003FFFF
 #define KGSL_IOMMU_TTBR0_PA_SHIFT		14
 #define KGSL_IOMMU_CTX_TLBIALL			0x800
+#define KGSL_IOMMU_CTX_TLBIASID			0x804
 #define KGSL_IOMMU_CTX_SHIFT			12
 
 /*
@@ -50,6 +52,18 @@
 		(pt_val & ~(KGSL_IOMMU_TTBR0_PA_MASK <<			\
 				KGSL_IOMMU_TTBR0_PA_SHIFT))
 
+/*
+ * ASIDs given to pagetables so that their TLB entries survive a switch.
+ * msm_iommu hands out ASIDs below the number of context banks, ours start
+ * well above that.  The first one is shared by the pagetables that found
+ * the others taken and is flushed whenever one of them is switched to.
+ */
+#define KGSL_IOMMU_ASID_SHARED		0x10
+#define KGSL_IOMMU_ASID_MAX		0xFF
+
+/* Number of freed pagetables kept around for new processes */
+#define KGSL_IOMMU_PT_POOL_SIZE		4
+
 /* offset at which a nop command is placed in setstate_memory */
 #define KGSL_IOMMU_SETSTATE_NOP_OFFSET	1024
 
@@ -120,10 +134,15 @@ struct kgsl_iommu {
  * struct kgsl_iommu_pt - Iommu pagetable structure private to kgsl driver
  * @domain: Pointer to the iommu domain that contains the iommu pagetable
  * @iommu: Pointer to iommu structure
+ * @asid: ASID the user context is tagged with while this pagetable is
+ * current, 0 if pagetable switches flush the whole TLB
+ * @pool_node: Entry in the pool of pagetables ready for reuse
  */
 struct kgsl_iommu_pt {
 	struct iommu_domain *domain;
 	struct kgsl_iommu *iommu;
+	unsigned int asid;
+	struct list_head pool_node;
 };
 
 #endif
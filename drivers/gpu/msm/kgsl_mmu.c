@@ -492,6 +492,8 @@ static struct kgsl_pagetable *kgsl_mmu_createpagetableobject(
 	pagetable->priv = pagetable->pt_ops->mmu_create_pagetable();
 	if (!pagetable->priv)
 		goto err_pool;
+	/* A reused IOMMU ASID may still have entries of its previous owner */
+	pagetable->tlb_flags = UINT_MAX;
 
 	status = kgsl_setup_pt(pagetable);
 	if (status)
@@ -630,7 +632,17 @@ kgsl_mmu_map(struct kgsl_pagetable *pagetable,
 	/* Allocate from kgsl pool if it exists for global mappings */
 	pool = _get_pool(pagetable, memdesc->priv);
 
-	memdesc->gpuaddr = gen_pool_alloc(pool, size);
+	/*
+	 * The IOMMU maps 64K and 1M runs of physically contiguous pages with
+	 * a single entry, which only works if the GPU address is aligned the
+	 * same way.  Fall back to any address if the pool is too fragmented.
+	 */
+	memdesc->gpuaddr = 0;
+	if (KGSL_MMU_TYPE_IOMMU == kgsl_mmu_get_mmutype() && size >= SZ_64K)
+		memdesc->gpuaddr = gen_pool_alloc_aligned(pool, size,
+				size >= SZ_1M ? ilog2(SZ_1M) : ilog2(SZ_64K));
+	if (memdesc->gpuaddr == 0)
+		memdesc->gpuaddr = gen_pool_alloc(pool, size);
 	if (memdesc->gpuaddr == 0) {
 		KGSL_CORE_ERR("gen_pool_alloc(%d) failed from pool: %s\n",
 			size,
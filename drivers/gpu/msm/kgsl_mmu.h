@@ -163,6 +163,8 @@ struct kgsl_mmu_pt_ops {
 			unsigned int pt_base);
 	unsigned int (*mmu_pt_get_base_addr)
 			(struct kgsl_pagetable *pt);
+	unsigned int (*mmu_pt_get_asid)
+			(struct kgsl_pagetable *pt);
 };
 
 #define KGSL_MMU_FLAGS_IOMMU_SYNC BIT(31)
@@ -267,6 +269,18 @@ static inline unsigned int kgsl_mmu_pt_get_base_addr(struct kgsl_pagetable *pt)
 		return pt->pt_ops->mmu_pt_get_base_addr(pt);
 }
 
+/*
+ * kgsl_mmu_pt_get_asid - Return the ASID the IOMMU is tagged with while
+ * @pt is current, or 0 if switching to it has to flush the whole TLB
+ */
+static inline unsigned int kgsl_mmu_pt_get_asid(struct kgsl_pagetable *pt)
+{
+	if (pt && pt->pt_ops && pt->pt_ops->mmu_pt_get_asid)
+		return pt->pt_ops->mmu_pt_get_asid(pt);
+	else
+		return 0;
+}
+
 static inline int kgsl_mmu_get_reg_map_desc(struct kgsl_mmu *mmu,
 						void **reg_map_desc)
 {
@@ -0,0 +1,250 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * Pages handed to the GPU have to be zeroed and flushed out of the CPU
+ * caches before userspace can see them, which makes allocating a large
+ * texture expensive for the thread doing it.  The pool keeps a reserve of
+ * pages that are already zeroed and flushed, both as single pages and as
+ * physically contiguous 64K and 1M chunks.  It is refilled by a worker
+ * after allocations drain it and given back to the system by a shrinker.
+ */
+
+#include <linux/module.h>
+#include <linux/mm.h>
+#include <linux/highmem.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/jiffies.h>
+#include <asm/cacheflush.h>
+
+#include "kgsl.h"
+#include "kgsl_pool.h"
+
+/* no refill for this long after the shrinker took pages away */
+#define KGSL_POOL_BACKOFF	(5 * HZ)
+
+struct kgsl_page_pool {
+	unsigned int order;
+	/* chunks that the refill worker keeps in the pool */
+	unsigned int reserve;
+	/* chunks in the pool, linked through page->lru */
+	unsigned int count;
+	struct list_head list;
+};
+
+/* largest chunks first, this is the order allocations try them in */
+#define KGSL_POOL(_idx, _order, _reserve) \
+	{ \
+		.order = _order, \
+		.reserve = _reserve, \
+		.list = LIST_HEAD_INIT(kgsl_pools[_idx].list), \
+	}
+
+static struct kgsl_page_pool kgsl_pools[] = {
+	KGSL_POOL(0, 8, 2),
+	KGSL_POOL(1, 4, 16),
+	KGSL_POOL(2, 0, 256),
+};
+
+module_param_named(pool_1m_reserve, kgsl_pools[0].reserve, uint, 0644);
+module_param_named(pool_64k_reserve, kgsl_pools[1].reserve, uint, 0644);
+module_param_named(pool_4k_reserve, kgsl_pools[2].reserve, uint, 0644);
+
+static DEFINE_SPINLOCK(kgsl_pool_lock);
+static unsigned long kgsl_pool_shrunk;
+static bool kgsl_pool_active;
+
+static void kgsl_pool_refill(struct work_struct *work);
+static DECLARE_WORK(kgsl_pool_refill_work, kgsl_pool_refill);
+
+static gfp_t kgsl_pool_gfp(unsigned int order)
+{
+	gfp_t gfp = GFP_KERNEL | __GFP_HIGHMEM | __GFP_NOWARN | __GFP_NORETRY;
+
+	/* chunks are only an optimization, don't push reclaim for them */
+	if (order)
+		gfp |= __GFP_NO_KSWAPD;
+	return gfp;
+}
+
+static void kgsl_pool_zero_chunk(struct page *page, unsigned int order)
+{
+	phys_addr_t paddr = page_to_phys(page);
+	unsigned int i;
+	void *ptr;
+
+	for (i = 0; i < (1 << order); i++) {
+		ptr = kmap_atomic(page + i);
+		memset(ptr, 0, PAGE_SIZE);
+		dmac_flush_range(ptr, ptr + PAGE_SIZE);
+		kunmap_atomic(ptr);
+	}
+	outer_flush_range(paddr, paddr + (PAGE_SIZE << order));
+}
+
+static void kgsl_pool_add(struct kgsl_page_pool *pool, struct page *page)
+{
+	spin_lock(&kgsl_pool_lock);
+	list_add_tail(&page->lru, &pool->list);
+	pool->count++;
+	kgsl_driver.stats.page_pool += PAGE_SIZE << pool->order;
+	spin_unlock(&kgsl_pool_lock);
+}
+
+static struct page *kgsl_pool_get(struct kgsl_page_pool *pool)
+{
+	struct page *page = NULL;
+
+	spin_lock(&kgsl_pool_lock);
+	if (!list_empty(&pool->list)) {
+		page = list_first_entry(&pool->list, struct page, lru);
+		list_del(&page->lru);
+		pool->count--;
+		kgsl_driver.stats.page_pool -= PAGE_SIZE << pool->order;
+	}
+	spin_unlock(&kgsl_pool_lock);
+	return page;
+}
+
+static bool kgsl_pool_wants_refill(struct kgsl_page_pool *pool)
+{
+	if (time_before(jiffies, kgsl_pool_shrunk + KGSL_POOL_BACKOFF))
+		return false;
+	return ACCESS_ONCE(pool->count) < ACCESS_ONCE(pool->reserve);
+}
+
+static void kgsl_pool_refill(struct work_struct *work)
+{
+	struct kgsl_page_pool *pool;
+	struct page *page;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(kgsl_pools); i++) {
+		pool = &kgsl_pools[i];
+		while (kgsl_pool_wants_refill(pool)) {
+			page = alloc_pages(kgsl_pool_gfp(pool->order),
+					   pool->order);
+			if (page == NULL)
+				break;
+			kgsl_pool_zero_chunk(page, pool->order);
+			kgsl_pool_add(pool, page);
+			cond_resched();
+		}
+	}
+}
+
+/**
+ * kgsl_pool_alloc_pages - allocate up to @count physically contiguous pages
+ * @pages: array the pages are stored in
+ * @count: maximum number of pages wanted
+ * @zeroed: set if the pages are already zeroed and flushed
+ *
+ * Returns the number of order 0 pages stored in @pages, which is the size
+ * of the largest chunk that fits in @count and could be allocated, or
+ * -ENOMEM.  Pooled chunks are used first, fresh ones from the page
+ * allocator are neither zeroed nor flushed.
+ */
+int kgsl_pool_alloc_pages(struct page **pages, unsigned int count,
+			  bool *zeroed)
+{
+	struct kgsl_page_pool *pool = NULL;
+	struct page *page = NULL;
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(kgsl_pools); i++) {
+		pool = &kgsl_pools[i];
+		if ((1 << pool->order) > count)
+			continue;
+
+		page = kgsl_pool_get(pool);
+		if (page != NULL) {
+			*zeroed = true;
+			break;
+		}
+		page = alloc_pages(kgsl_pool_gfp(pool->order), pool->order);
+		if (page != NULL) {
+			*zeroed = false;
+			break;
+		}
+	}
+
+	if (page == NULL)
+		return -ENOMEM;
+
+	if (kgsl_pool_active && kgsl_pool_wants_refill(pool))
+		schedule_work(&kgsl_pool_refill_work);
+
+	/* the chunk is freed page by page like any other allocation */
+	if (pool->order)
+		split_page(page, pool->order);
+	for (i = 0; i < (1 << pool->order); i++)
+		pages[i] = page + i;
+
+	return 1 << pool->order;
+}
+
+static int kgsl_pool_shrink(struct shrinker *shrinker,
+			    struct shrink_control *sc)
+{
+	struct kgsl_page_pool *pool;
+	struct page *page;
+	int nr = sc->nr_to_scan;
+	int i, total = 0;
+
+	if (nr > 0)
+		kgsl_pool_shrunk = jiffies;
+
+	for (i = 0; i < ARRAY_SIZE(kgsl_pools); i++) {
+		pool = &kgsl_pools[i];
+		while (nr > 0) {
+			page = kgsl_pool_get(pool);
+			if (page == NULL)
+				break;
+			__free_pages(page, pool->order);
+			nr -= 1 << pool->order;
+		}
+		total += ACCESS_ONCE(pool->count) << pool->order;
+	}
+
+	return total;
+}
+
+static struct shrinker kgsl_pool_shrinker = {
+	.shrink = kgsl_pool_shrink,
+	.seeks = DEFAULT_SEEKS,
+};
+
+void kgsl_pool_init(void)
+{
+	register_shrinker(&kgsl_pool_shrinker);
+	kgsl_pool_active = true;
+	schedule_work(&kgsl_pool_refill_work);
+}
+
+void kgsl_pool_exit(void)
+{
+	struct page *page;
+	int i;
+
+	if (!kgsl_pool_active)
+		return;
+
+	kgsl_pool_active = false;
+	unregister_shrinker(&kgsl_pool_shrinker);
+	cancel_work_sync(&kgsl_pool_refill_work);
+
+	for (i = 0; i < ARRAY_SIZE(kgsl_pools); i++)
+		while ((page = kgsl_pool_get(&kgsl_pools[i])) != NULL)
+			__free_pages(page, kgsl_pools[i].order);
+}
@@ -18,6 +18,8 @@
 #include <mach/msm_iomap.h>
 #include <mach/msm_bus.h>
 #include <linux/ktime.h>
+#include <linux/input.h>
+#include <linux/slab.h>
 
 #include "kgsl.h"
 #include "kgsl_pwrscale.h"
@@ -132,6 +134,35 @@ void kgsl_pwrctrl_pwrlevel_change(struct kgsl_device *device,
 }
 EXPORT_SYMBOL(kgsl_pwrctrl_pwrlevel_change);
 
+/**
+ * kgsl_pwrctrl_thermal_cap() - keep the 3D core @steps levels below its top
+ * @steps: number of power levels to give up, 0 to lift the cap
+ *
+ * For the kernel thermal monitor.  This sets the same limit as max_gpuclk
+ * does, so it replaces a limit set there.  Returns the level now in use
+ * as the cap or a negative error code.
+ */
+int kgsl_pwrctrl_thermal_cap(unsigned int steps)
+{
+	struct kgsl_device *device = kgsl_get_device(KGSL_DEVICE_3D0);
+	struct kgsl_pwrctrl *pwr;
+	unsigned int level;
+
+	if (device == NULL)
+		return -ENODEV;
+	pwr = &device->pwrctrl;
+
+	mutex_lock(&device->mutex);
+	level = min_t(unsigned int, steps, pwr->num_pwrlevels - 2);
+	pwr->thermal_pwrlevel = level;
+	if (pwr->active_pwrlevel < level)
+		kgsl_pwrctrl_pwrlevel_change(device, level);
+	mutex_unlock(&device->mutex);
+
+	return level;
+}
+EXPORT_SYMBOL(kgsl_pwrctrl_thermal_cap);
+
 static int __gpuclk_store(int max, struct device *dev,
 						  struct device_attribute *attr,
 						  const char *buf, size_t count)
@@ -349,6 +380,30 @@ static int kgsl_pwrctrl_gputop_show(struct device *dev,
 	return (unsigned int) (ptr - buf);
 }
 
+static int kgsl_pwrctrl_transitions_show(struct device *dev,
+					struct device_attribute *attr,
+					char *buf)
+{
+	struct kgsl_device *device = kgsl_device_from_dev(dev);
+	struct kgsl_pwr_transition_stats *stats;
+	int i, len = 0;
+
+	if (device == NULL)
+		return 0;
+
+	mutex_lock(&device->mutex);
+	for (i = 0; i < KGSL_PWR_TRANSITIONS; i++) {
+		stats = &device->pwrctrl.transitions[i];
+		len += snprintf(buf + len, PAGE_SIZE - len,
+			"%-12s %8u %8llu %8u\n",
+			kgsl_pwr_transition_to_str(i), stats->count,
+			stats->count ? div_u64(stats->total_us, stats->count) :
+			0, stats->max_us);
+	}
+	mutex_unlock(&device->mutex);
+	return len;
+}
+
 DEVICE_ATTR(gpuclk, 0644, kgsl_pwrctrl_gpuclk_show, kgsl_pwrctrl_gpuclk_store);
 DEVICE_ATTR(max_gpuclk, 0644, kgsl_pwrctrl_max_gpuclk_show,
 	kgsl_pwrctrl_max_gpuclk_store);
@@ -359,6 +414,8 @@ DEVICE_ATTR(gpubusy, 0444, kgsl_pwrctrl_gpubusy_show,
 	NULL);
 DEVICE_ATTR(gputop, 0444, kgsl_pwrctrl_gputop_show,
 	NULL);
+DEVICE_ATTR(transitions, 0444, kgsl_pwrctrl_transitions_show,
+	NULL);
 
 static const struct device_attribute *pwrctrl_attr_list[] = {
 	&dev_attr_gpuclk,
@@ -367,6 +424,7 @@ static const struct device_attribute *pwrctrl_attr_list[] = {
 	&dev_attr_idle_timer,
 	&dev_attr_gpubusy,
 	&dev_attr_gputop,
+	&dev_attr_transitions,
 	NULL
 };
 
@@ -506,8 +564,12 @@ void kgsl_pwrctrl_pwrrail(struct kgsl_device *device, int state)
 			trace_kgsl_rail(device, state);
 			if (pwr->gpu_cx)
 				regulator_disable(pwr->gpu_cx);
-			if (pwr->gpu_reg)
+			if (pwr->gpu_reg) {
 				regulator_disable(pwr->gpu_reg);
+				/* another vote may keep the core powered */
+				if (!regulator_is_enabled(pwr->gpu_reg))
+					pwr->rail_collapses++;
+			}
 		}
 	} else if (state == KGSL_PWRFLAGS_ON) {
 		if (!test_and_set_bit(KGSL_PWRFLAGS_POWER_ON,
@@ -556,6 +618,100 @@ void kgsl_pwrctrl_irq(struct kgsl_device *device, int state)
 }
 EXPORT_SYMBOL(kgsl_pwrctrl_irq);
 
+/*
+ * An input event usually means a frame is about to be drawn.  Bring the
+ * GPU out of nap or slumber from the work queue right away, so that the
+ * rails, clocks, bus vote and ringbuffer restart are done by the time
+ * the app submits instead of in front of its first command.  The idle
+ * timer puts the GPU back down if nothing is drawn after all.
+ *
+ * The first input after a quiet second also raises a slower power level,
+ * and with it the bus vote, to the default one.  The first frame of the
+ * interaction is then not rendered at the level the policy picked while
+ * idle; the policy scales down again from its next sample.
+ */
+static void kgsl_pwrctrl_input_wake(struct work_struct *work)
+{
+	struct kgsl_pwrctrl *pwr = container_of(work, struct kgsl_pwrctrl,
+						input_wake_ws);
+	struct kgsl_device *device = container_of(pwr, struct kgsl_device,
+						  pwrctrl);
+
+	mutex_lock(&device->mutex);
+	/* nobody to draw, or the display is off */
+	if (device->open_count && !pwr->restore_slumber &&
+	    (device->state & (KGSL_STATE_NAP | KGSL_STATE_SLEEP |
+			      KGSL_STATE_SLUMBER)))
+		kgsl_pwrctrl_wake(device);
+
+	if (pwr->input_boost) {
+		pwr->input_boost = false;
+		if (device->open_count && !pwr->restore_slumber &&
+		    pwr->active_pwrlevel > pwr->default_pwrlevel)
+			kgsl_pwrctrl_pwrlevel_change(device,
+						     pwr->default_pwrlevel);
+	}
+	mutex_unlock(&device->mutex);
+}
+
+static void kgsl_pwrctrl_input_event(struct input_handle *handle,
+		unsigned int type, unsigned int code, int value)
+{
+	struct kgsl_device *device = handle->handler->private;
+	struct kgsl_pwrctrl *pwr = &device->pwrctrl;
+	bool first = time_after(jiffies, pwr->input_jiffies + HZ);
+
+	pwr->input_jiffies = jiffies;
+	if (first)
+		pwr->input_boost = true;
+
+	if (first || (device->state & (KGSL_STATE_NAP | KGSL_STATE_SLEEP |
+				       KGSL_STATE_SLUMBER)))
+		queue_work(device->work_queue, &pwr->input_wake_ws);
+}
+
+static int kgsl_pwrctrl_input_connect(struct input_handler *handler,
+		struct input_dev *dev, const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int error;
+
+	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = handler->name;
+
+	error = input_register_handle(handle);
+	if (error)
+		goto err2;
+
+	error = input_open_device(handle);
+	if (error)
+		goto err1;
+
+	return 0;
+err1:
+	input_unregister_handle(handle);
+err2:
+	kfree(handle);
+	return error;
+}
+
+static void kgsl_pwrctrl_input_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+static const struct input_device_id kgsl_pwrctrl_input_ids[] = {
+	{ .driver_info = 1 },
+	{ },
+};
+
 int kgsl_pwrctrl_init(struct kgsl_device *device)
 {
 	int i, result = 0;
@@ -645,6 +801,18 @@ int kgsl_pwrctrl_init(struct kgsl_device *device)
 	}
 
 
+	INIT_WORK(&pwr->input_wake_ws, kgsl_pwrctrl_input_wake);
+	pwr->input_handler.event = kgsl_pwrctrl_input_event;
+	pwr->input_handler.connect = kgsl_pwrctrl_input_connect;
+	pwr->input_handler.disconnect = kgsl_pwrctrl_input_disconnect;
+	pwr->input_handler.name = device->name;
+	pwr->input_handler.id_table = kgsl_pwrctrl_input_ids;
+	pwr->input_handler.private = device;
+	if (input_register_handler(&pwr->input_handler)) {
+		KGSL_PWR_WARN(device, "input handler registration failed\n");
+		pwr->input_handler.private = NULL;
+	}
+
 	pm_runtime_enable(device->parentdev);
 	register_early_suspend(&device->display_off);
 	return result;
@@ -665,6 +833,12 @@ void kgsl_pwrctrl_close(struct kgsl_device *device)
 
 	KGSL_PWR_INFO(device, "close device %d\n", device->id);
 
+	if (pwr->input_handler.private) {
+		input_unregister_handler(&pwr->input_handler);
+		pwr->input_handler.private = NULL;
+	}
+	cancel_work_sync(&pwr->input_wake_ws);
+
 	pm_runtime_disable(device->parentdev);
 	unregister_early_suspend(&device->display_off);
 
@@ -891,9 +1065,62 @@ _slumber(struct kgsl_device *device)
 
 /******************************************************************/
 /* Caller must hold the device mutex. */
+static const char * const kgsl_pwr_transition_names[] = {
+	[KGSL_PWR_WAKE_NAP] = "wake_nap",
+	[KGSL_PWR_WAKE_SLEEP] = "wake_sleep",
+	[KGSL_PWR_WAKE_SLUMBER] = "wake_slumber",
+	[KGSL_PWR_TO_NAP] = "nap",
+	[KGSL_PWR_TO_SLEEP] = "sleep",
+	[KGSL_PWR_TO_SLUMBER] = "slumber",
+};
+
+const char *kgsl_pwr_transition_to_str(int transition)
+{
+	if (transition < 0 || transition >= KGSL_PWR_TRANSITIONS)
+		return "UNKNOWN";
+	return kgsl_pwr_transition_names[transition];
+}
+EXPORT_SYMBOL(kgsl_pwr_transition_to_str);
+
+/* Caller must hold the device mutex. */
+static void kgsl_pwrctrl_transition_done(struct kgsl_device *device,
+		unsigned int from, ktime_t start)
+{
+	struct kgsl_pwr_transition_stats *stats;
+	unsigned int to = device->state;
+	unsigned int us;
+	int i;
+
+	switch (to == KGSL_STATE_ACTIVE ? from : to) {
+	case KGSL_STATE_NAP:
+		i = KGSL_PWR_TO_NAP;
+		break;
+	case KGSL_STATE_SLEEP:
+		i = KGSL_PWR_TO_SLEEP;
+		break;
+	case KGSL_STATE_SLUMBER:
+		i = KGSL_PWR_TO_SLUMBER;
+		break;
+	default:
+		return;
+	}
+	/* the wake entries mirror the ones going down */
+	if (to == KGSL_STATE_ACTIVE)
+		i -= KGSL_PWR_TO_NAP - KGSL_PWR_WAKE_NAP;
+
+	us = ktime_us_delta(ktime_get(), start);
+	stats = &device->pwrctrl.transitions[i];
+	stats->count++;
+	stats->total_us += us;
+	stats->max_us = max(stats->max_us, us);
+	trace_kgsl_pwr_transition(device, from, to, us);
+}
+
 int kgsl_pwrctrl_sleep(struct kgsl_device *device)
 {
 	int status = 0;
+	unsigned int from = device->state;
+	ktime_t start = ktime_get();
 	KGSL_PWR_INFO(device, "sleep device %d\n", device->id);
 
 	/* Work through the legal state transitions */
@@ -915,6 +1142,8 @@ int kgsl_pwrctrl_sleep(struct kgsl_device *device)
 		status = -EINVAL;
 		break;
 	}
+	if (!status && device->state != from)
+		kgsl_pwrctrl_transition_done(device, from, start);
 	return status;
 }
 EXPORT_SYMBOL(kgsl_pwrctrl_sleep);
@@ -924,6 +1153,8 @@ EXPORT_SYMBOL(kgsl_pwrctrl_sleep);
 void kgsl_pwrctrl_wake(struct kgsl_device *device)
 {
 	int status;
+	unsigned int from = device->state;
+	ktime_t start = ktime_get();
 	kgsl_pwrctrl_request_state(device, KGSL_STATE_ACTIVE);
 	switch (device->state) {
 	case KGSL_STATE_SLUMBER:
@@ -957,6 +1188,8 @@ void kgsl_pwrctrl_wake(struct kgsl_device *device)
 		kgsl_pwrctrl_request_state(device, KGSL_STATE_NONE);
 		break;
 	}
+	if (device->state == KGSL_STATE_ACTIVE && from != KGSL_STATE_ACTIVE)
+		kgsl_pwrctrl_transition_done(device, from, start);
 }
 EXPORT_SYMBOL(kgsl_pwrctrl_wake);
 
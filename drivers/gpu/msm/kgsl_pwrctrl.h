@@ -13,6 +13,9 @@
 #ifndef __KGSL_PWRCTRL_H
 #define __KGSL_PWRCTRL_H
 
+#include <linux/input.h>
+#include <linux/workqueue.h>
+
 /*****************************************************************************
 ** power flags
 *****************************************************************************/
@@ -38,6 +41,23 @@ struct kgsl_clk_stats {
 	unsigned int elapsed_old;
 };
 
+/* power state changes timed by kgsl_pwrctrl_wake() and _sleep() */
+enum kgsl_pwr_transition {
+	KGSL_PWR_WAKE_NAP,
+	KGSL_PWR_WAKE_SLEEP,
+	KGSL_PWR_WAKE_SLUMBER,
+	KGSL_PWR_TO_NAP,
+	KGSL_PWR_TO_SLEEP,
+	KGSL_PWR_TO_SLUMBER,
+	KGSL_PWR_TRANSITIONS,
+};
+
+struct kgsl_pwr_transition_stats {
+	unsigned int count;
+	u64 total_us;
+	unsigned int max_us;
+};
+
 struct kgsl_pwrctrl {
 	int interrupt_num;
 	struct clk *ebi1_clk;
@@ -59,6 +79,14 @@ struct kgsl_pwrctrl {
 	s64 time;
 	unsigned int restore_slumber;
 	struct kgsl_clk_stats clk_stats;
+	/* times the core rail really dropped, i.e. GPU state was lost */
+	unsigned int rail_collapses;
+	/* protected by the device mutex */
+	struct kgsl_pwr_transition_stats transitions[KGSL_PWR_TRANSITIONS];
+	struct input_handler input_handler;
+	struct work_struct input_wake_ws;
+	unsigned long input_jiffies;	/* last input event */
+	bool input_boost;
 };
 
 void kgsl_pwrctrl_irq(struct kgsl_device *device, int state);
@@ -70,6 +98,7 @@ void kgsl_pre_hwaccess(struct kgsl_device *device);
 void kgsl_check_suspended(struct kgsl_device *device);
 int kgsl_pwrctrl_sleep(struct kgsl_device *device);
 void kgsl_pwrctrl_wake(struct kgsl_device *device);
+const char *kgsl_pwr_transition_to_str(int transition);
 void kgsl_pwrctrl_pwrlevel_change(struct kgsl_device *device,
 	unsigned int level);
 int kgsl_pwrctrl_init_sysfs(struct kgsl_device *device);
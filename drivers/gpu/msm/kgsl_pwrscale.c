@@ -50,6 +50,9 @@ static struct kgsl_pwrscale_policy *kgsl_pwrscale_policies[] = {
 #endif
 #ifdef CONFIG_MSM_DCVS
 	&kgsl_pwrscale_policy_msm,
+#endif
+#ifdef CONFIG_MSM_KGSL_PWRSCALE_DEADLINE
+	&kgsl_pwrscale_policy_deadline,
 #endif
 	NULL
 };
@@ -0,0 +1,293 @@
+/* Copyright (c) 2012, Code Aurora Forum. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * Frame deadline power policy.  Every vsync of the primary panel closes
+ * a frame: the GPU busy time of that frame is folded into a prediction
+ * for the next one, and the slowest power level that finishes the
+ * predicted work within target_load percent of the frame period is
+ * selected.  The bus vote follows the power level.  While the display
+ * is not refreshing, the same calculation is done over the idle timer
+ * interval instead of a frame.
+ */
+
+#include <linux/export.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/notifier.h>
+#include <linux/workqueue.h>
+#include <linux/msm_mdp.h>
+
+#include "kgsl.h"
+#include "kgsl_pwrscale.h"
+#include "kgsl_device.h"
+
+/* vsync intervals outside of this range restart the frame accounting */
+#define DEADLINE_MIN_PERIOD_US	5000
+#define DEADLINE_MAX_PERIOD_US	50000
+/* without vsyncs, decide at most this often */
+#define DEADLINE_IDLE_WINDOW_US	100000
+
+struct deadline_priv {
+	struct kgsl_device *device;
+	struct notifier_block vsync_nb;
+	struct delayed_work vsync_work;
+
+	spinlock_t lock;
+	s64 vsync_us;		/* time of the last vsync */
+	unsigned int period_us;	/* last vsync interval, 0 if unknown */
+
+	s64 window_start;	/* start of the current accounting window */
+	unsigned int busy_us;	/* GPU busy time in the current window */
+	unsigned int predict_us; /* expected busy time of the next frame */
+
+	unsigned int target_load;
+};
+
+/* Fold the busy time since the last call into the current window */
+static void deadline_sample(struct kgsl_device *device,
+			    struct deadline_priv *priv)
+{
+	struct kgsl_power_stats stats;
+
+	/* The busy counters can only be read with the clocks on */
+	if (device->state != KGSL_STATE_ACTIVE)
+		return;
+
+	device->ftbl->power_stats(device, &stats);
+	priv->busy_us += stats.busy_time;
+}
+
+/*
+ * Pick the slowest power level that gets the predicted work done within
+ * target_load percent of @window_us.
+ */
+static void deadline_update(struct kgsl_device *device,
+			    struct deadline_priv *priv,
+			    unsigned int window_us)
+{
+	struct kgsl_pwrctrl *pwr = &device->pwrctrl;
+	unsigned int busy = min(priv->busy_us, window_us);
+	u64 freq;
+	int level;
+
+	/* React to a heavier frame at once, to a lighter one gradually */
+	priv->predict_us = max(busy, (3 * priv->predict_us + busy) / 4);
+	priv->busy_us = 0;
+
+	freq = (u64) pwr->pwrlevels[pwr->active_pwrlevel].gpu_freq *
+		priv->predict_us * 100;
+	freq = div_u64(freq, window_us * priv->target_load);
+
+	for (level = pwr->num_pwrlevels - 2; level > pwr->thermal_pwrlevel;
+	     level--)
+		if (pwr->pwrlevels[level].gpu_freq >= freq)
+			break;
+
+	kgsl_pwrctrl_pwrlevel_change(device, level);
+}
+
+static void deadline_vsync_work(struct work_struct *work)
+{
+	struct deadline_priv *priv = container_of(work, struct deadline_priv,
+						  vsync_work.work);
+	struct kgsl_device *device = priv->device;
+	unsigned int period;
+	unsigned long flags;
+
+	/*
+	 * Never sleep on the mutex: the policy is closed with it held and
+	 * has to cancel this work.  Try again on the next tick instead.
+	 */
+	if (!mutex_trylock(&device->mutex)) {
+		queue_delayed_work(device->work_queue, &priv->vsync_work, 1);
+		return;
+	}
+
+	spin_lock_irqsave(&priv->lock, flags);
+	period = priv->period_us;
+	spin_unlock_irqrestore(&priv->lock, flags);
+
+	deadline_sample(device, priv);
+	if (period)
+		deadline_update(device, priv, period);
+	else
+		priv->busy_us = 0;
+	priv->window_start = ktime_to_us(ktime_get());
+	mutex_unlock(&device->mutex);
+}
+
+static int deadline_vsync_notify(struct notifier_block *nb,
+				 unsigned long action, void *data)
+{
+	struct deadline_priv *priv = container_of(nb, struct deadline_priv,
+						  vsync_nb);
+	s64 now = ktime_to_us(*(ktime_t *)data);
+	s64 delta;
+
+	spin_lock(&priv->lock);
+	delta = now - priv->vsync_us;
+	if (delta >= DEADLINE_MIN_PERIOD_US && delta <= DEADLINE_MAX_PERIOD_US)
+		priv->period_us = delta;
+	else
+		priv->period_us = 0;
+	priv->vsync_us = now;
+	spin_unlock(&priv->lock);
+
+	queue_delayed_work(priv->device->work_queue, &priv->vsync_work, 0);
+	return NOTIFY_OK;
+}
+
+static ssize_t deadline_target_load_show(struct kgsl_device *device,
+					 struct kgsl_pwrscale *pwrscale,
+					 char *buf)
+{
+	struct deadline_priv *priv = pwrscale->priv;
+
+	return snprintf(buf, PAGE_SIZE, "%u\n", priv->target_load);
+}
+
+static ssize_t deadline_target_load_store(struct kgsl_device *device,
+					  struct kgsl_pwrscale *pwrscale,
+					  const char *buf, size_t count)
+{
+	struct deadline_priv *priv = pwrscale->priv;
+	unsigned int val;
+
+	if (sscanf(buf, "%u", &val) != 1 || val < 10 || val > 100)
+		return -EINVAL;
+
+	mutex_lock(&device->mutex);
+	priv->target_load = val;
+	mutex_unlock(&device->mutex);
+
+	return count;
+}
+
+PWRSCALE_POLICY_ATTR(target_load, 0644, deadline_target_load_show,
+		     deadline_target_load_store);
+
+static struct attribute *deadline_attrs[] = {
+	&policy_attr_target_load.attr,
+	NULL
+};
+
+static struct attribute_group deadline_attr_group = {
+	.attrs = deadline_attrs,
+};
+
+static void deadline_idle(struct kgsl_device *device,
+			  struct kgsl_pwrscale *pwrscale,
+			  unsigned int ignore_idle)
+{
+	struct deadline_priv *priv = pwrscale->priv;
+	s64 now = ktime_to_us(ktime_get());
+	s64 vsync_us;
+	unsigned long flags;
+
+	deadline_sample(device, priv);
+
+	if (ignore_idle)
+		return;
+
+	/* Frames are being shown, the vsync work is in charge */
+	spin_lock_irqsave(&priv->lock, flags);
+	vsync_us = priv->vsync_us;
+	spin_unlock_irqrestore(&priv->lock, flags);
+	if (now - vsync_us < DEADLINE_MAX_PERIOD_US)
+		return;
+
+	if (now - priv->window_start >= DEADLINE_IDLE_WINDOW_US) {
+		deadline_update(device, priv, now - priv->window_start);
+		priv->window_start = now;
+	}
+}
+
+static void deadline_wake(struct kgsl_device *device,
+			  struct kgsl_pwrscale *pwrscale)
+{
+	struct deadline_priv *priv = pwrscale->priv;
+
+	/*
+	 * Coming out of slumber the counters start over, so drop what was
+	 * accounted before and keep the level that was last picked.
+	 */
+	if (device->state != KGSL_STATE_NAP) {
+		priv->busy_us = 0;
+		priv->window_start = ktime_to_us(ktime_get());
+	}
+}
+
+static void deadline_sleep(struct kgsl_device *device,
+			   struct kgsl_pwrscale *pwrscale)
+{
+	struct deadline_priv *priv = pwrscale->priv;
+
+	priv->predict_us = 0;
+}
+
+static int deadline_init(struct kgsl_device *device,
+			 struct kgsl_pwrscale *pwrscale)
+{
+	struct deadline_priv *priv;
+	int ret;
+
+	priv = pwrscale->priv = kzalloc(sizeof(struct deadline_priv),
+					GFP_KERNEL);
+	if (pwrscale->priv == NULL)
+		return -ENOMEM;
+
+	priv->device = device;
+	priv->target_load = 85;
+	priv->window_start = ktime_to_us(ktime_get());
+	spin_lock_init(&priv->lock);
+	INIT_DELAYED_WORK(&priv->vsync_work, deadline_vsync_work);
+
+	priv->vsync_nb.notifier_call = deadline_vsync_notify;
+	ret = msm_fb_register_vsync_notifier(&priv->vsync_nb);
+	if (ret) {
+		kfree(priv);
+		pwrscale->priv = NULL;
+		return ret;
+	}
+
+	kgsl_pwrscale_policy_add_files(device, pwrscale, &deadline_attr_group);
+
+	return 0;
+}
+
+static void deadline_close(struct kgsl_device *device,
+			   struct kgsl_pwrscale *pwrscale)
+{
+	struct deadline_priv *priv = pwrscale->priv;
+
+	msm_fb_unregister_vsync_notifier(&priv->vsync_nb);
+	cancel_delayed_work_sync(&priv->vsync_work);
+
+	kgsl_pwrscale_policy_remove_files(device, pwrscale,
+					  &deadline_attr_group);
+	kfree(pwrscale->priv);
+	pwrscale->priv = NULL;
+}
+
+struct kgsl_pwrscale_policy kgsl_pwrscale_policy_deadline = {
+	.name = "deadline",
+	.init = deadline_init,
+	.idle = deadline_idle,
+	.sleep = deadline_sleep,
+	.wake = deadline_wake,
+	.close = deadline_close
+};
+EXPORT_SYMBOL(kgsl_pwrscale_policy_deadline);
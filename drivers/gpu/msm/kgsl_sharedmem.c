@@ -21,6 +21,7 @@
 
 #include "kgsl.h"
 #include "kgsl_sharedmem.h"
+#include "kgsl_pool.h"
 #include "kgsl_cffdump.h"
 #include "kgsl_device.h"
 
@@ -225,6 +226,8 @@ static int kgsl_drv_memstat_show(struct device *dev,
 		val = kgsl_driver.stats.mapped;
 	else if (!strncmp(attr->attr.name, "mapped_max", 10))
 		val = kgsl_driver.stats.mapped_max;
+	else if (!strncmp(attr->attr.name, "page_pool", 9))
+		val = kgsl_driver.stats.page_pool;
 
 	return snprintf(buf, PAGE_SIZE, "%u\n", val);
 }
@@ -252,6 +255,7 @@ DEVICE_ATTR(coherent, 0444, kgsl_drv_memstat_show, NULL);
 DEVICE_ATTR(coherent_max, 0444, kgsl_drv_memstat_show, NULL);
 DEVICE_ATTR(mapped, 0444, kgsl_drv_memstat_show, NULL);
 DEVICE_ATTR(mapped_max, 0444, kgsl_drv_memstat_show, NULL);
+DEVICE_ATTR(page_pool, 0444, kgsl_drv_memstat_show, NULL);
 DEVICE_ATTR(histogram, 0444, kgsl_drv_histogram_show, NULL);
 
 static const struct device_attribute *drv_attr_list[] = {
@@ -263,6 +267,7 @@ static const struct device_attribute *drv_attr_list[] = {
 	&dev_attr_coherent_max,
 	&dev_attr_mapped,
 	&dev_attr_mapped_max,
+	&dev_attr_page_pool,
 	&dev_attr_histogram,
 	NULL
 };
@@ -307,10 +312,22 @@ static void outer_cache_range_op_sg(struct scatterlist *sg, int sglen, int op)
 	}
 }
 
+static void outer_cache_range_op_pages(struct page **pages, int count, int op)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		_outer_cache_range_op(op, page_to_phys(pages[i]), PAGE_SIZE);
+}
+
 #else
 static void outer_cache_range_op_sg(struct scatterlist *sg, int sglen, int op)
 {
 }
+
+static void outer_cache_range_op_pages(struct page **pages, int count, int op)
+{
+}
 #endif
 
 static int kgsl_page_alloc_vmfault(struct kgsl_memdesc *memdesc,
@@ -505,8 +522,11 @@ _kgsl_sharedmem_page_alloc(struct kgsl_memdesc *memdesc,
 			struct kgsl_pagetable *pagetable,
 			size_t size, unsigned int protflags)
 {
-	int i, order, ret = 0;
-	int sglen = PAGE_ALIGN(size) / PAGE_SIZE;
+	int i, j, n, order, ret = 0;
+	int npages = PAGE_ALIGN(size) / PAGE_SIZE;
+	int sglen = npages;
+	int nzero = 0;
+	bool zeroed;
 	struct page **pages = NULL;
 	pgprot_t page_prot = pgprot_writecombine(PAGE_KERNEL);
 	void *ptr;
@@ -538,6 +558,7 @@ _kgsl_sharedmem_page_alloc(struct kgsl_memdesc *memdesc,
 	 * This is an array of pointers so we can track 1024 pages per page of
 	 * allocation which means we can handle up to a 8MB buffer request with
 	 * two pages; well within the acceptable limits for using kmalloc.
+	 * Only the pages that still need to be zeroed end up in it.
 	 */
 
 	pages = kmalloc(sglen * sizeof(struct page *), GFP_KERNEL);
@@ -554,22 +575,28 @@ _kgsl_sharedmem_page_alloc(struct kgsl_memdesc *memdesc,
 	memdesc->sglen = sglen;
 	sg_init_table(memdesc->sg, sglen);
 
-	for (i = 0; i < PAGE_ALIGN(size) / PAGE_SIZE; i++) {
+	for (i = 0; i < npages; i += n) {
 
 		/*
-		 * Don't use GFP_ZERO here because it is faster to memset the
-		 * range ourselves (see below)
+		 * Take the largest physically contiguous chunk that fits,
+		 * preferably one that the page pool has already zeroed.
+		 * Fresh pages are not allocated with GFP_ZERO because it is
+		 * faster to memset the range ourselves (see below)
 		 */
 
-		pages[i] = alloc_page(GFP_KERNEL | __GFP_HIGHMEM |
-			__GFP_NOWARN | __GFP_NORETRY);
-		if (pages[i] == NULL) {
+		n = kgsl_pool_alloc_pages(&pages[nzero], npages - i, &zeroed);
+		if (n < 0) {
 			ret = -ENOMEM;
 			memdesc->sglen = i;
 			goto done;
 		}
 
-		sg_set_page(&memdesc->sg[i], pages[i], PAGE_SIZE, 0);
+		for (j = 0; j < n; j++)
+			sg_set_page(&memdesc->sg[i + j], pages[nzero + j],
+				PAGE_SIZE, 0);
+
+		if (!zeroed)
+			nzero += n;
 	}
 
 	/* ADd the guard page to the end of the sglist */
@@ -609,21 +636,22 @@ _kgsl_sharedmem_page_alloc(struct kgsl_memdesc *memdesc,
 	 * microseconds at best.  The only downside is that there needs to be
 	 * enough temporary space in vmalloc to accomodate the map. This
 	 * shouldn't be a problem, but if it happens, fall back to a much slower
-	 * path
+	 * path.  Pages that came out of the page pool were zeroed and flushed
+	 * ahead of time and are skipped.  The map is only needed for the
+	 * memset, so use vm_map_ram(): small ones come out of the per cpu
+	 * vmap blocks and none of them go through the global vmlist.
 	 */
 
-	ptr = vmap(pages, i, VM_IOREMAP, page_prot);
+	ptr = nzero ? vm_map_ram(pages, nzero, -1, page_prot) : NULL;
 
 	if (ptr != NULL) {
-		memset(ptr, 0, memdesc->size);
-		dmac_flush_range(ptr, ptr + memdesc->size);
-		vunmap(ptr);
+		memset(ptr, 0, nzero * PAGE_SIZE);
+		dmac_flush_range(ptr, ptr + nzero * PAGE_SIZE);
+		vm_unmap_ram(ptr, nzero);
 	} else {
-		int j;
-
 		/* Very, very, very slow path */
 
-		for (j = 0; j < i; j++) {
+		for (j = 0; j < nzero; j++) {
 			ptr = kmap_atomic(pages[j]);
 			memset(ptr, 0, PAGE_SIZE);
 			dmac_flush_range(ptr, ptr + PAGE_SIZE);
@@ -631,8 +659,7 @@ _kgsl_sharedmem_page_alloc(struct kgsl_memdesc *memdesc,
 		}
 	}
 
-	outer_cache_range_op_sg(memdesc->sg, memdesc->sglen,
-				KGSL_CACHE_OP_FLUSH);
+	outer_cache_range_op_pages(pages, nzero, KGSL_CACHE_OP_FLUSH);
 
 	ret = kgsl_mmu_map(pagetable, memdesc, protflags);
 
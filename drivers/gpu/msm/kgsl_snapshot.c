@@ -469,6 +469,21 @@ void *kgsl_snapshot_indexed_registers(struct kgsl_device *device,
 }
 EXPORT_SYMBOL(kgsl_snapshot_indexed_registers);
 
+/*
+ * kgsl_snapshot_timed_out - check for the end of the snapshot stall time
+ * @device - the device being snapshotted
+ *
+ * The GPU stays stalled while a hang snapshot is taken.  Device code dumps
+ * what only the hardware holds first and stops parsing command buffers for
+ * more objects once this returns true.
+ */
+bool kgsl_snapshot_timed_out(struct kgsl_device *device)
+{
+	return device->snapshot_stall_ms &&
+		time_after(jiffies, device->snapshot_deadline);
+}
+EXPORT_SYMBOL(kgsl_snapshot_timed_out);
+
 /*
  * kgsl_snapshot - construct a device snapshot
  * @device - device to snapshot
@@ -506,6 +521,9 @@ int kgsl_device_snapshot(struct kgsl_device *device, int hang)
 		return -ENOMEM;
 	}
 
+	device->snapshot_deadline = jiffies +
+		msecs_to_jiffies(device->snapshot_stall_ms);
+
 	header->magic = SNAPSHOT_MAGIC;
 
 	header->gpuid = kgsl_gpuid(device, &header->chipid);
@@ -621,6 +639,25 @@ static ssize_t timestamp_show(struct kgsl_device *device, char *buf)
 	return snprintf(buf, PAGE_SIZE, "%x\n", device->snapshot_timestamp);
 }
 
+/* Show the time a snapshot may take, 0 for no limit */
+static ssize_t stall_ms_show(struct kgsl_device *device, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%u\n", device->snapshot_stall_ms);
+}
+
+static ssize_t stall_ms_store(struct kgsl_device *device, const char *buf,
+	size_t count)
+{
+	unsigned int val;
+	int ret = kstrtouint(buf, 0, &val);
+
+	if (ret)
+		return ret;
+
+	device->snapshot_stall_ms = val;
+	return count;
+}
+
 /* manually trigger a new snapshot to be collected */
 static ssize_t trigger_store(struct kgsl_device *device, const char *buf,
 	size_t count)
@@ -650,6 +687,7 @@ struct kgsl_snapshot_attribute attr_##_name = { \
 
 SNAPSHOT_ATTR(trigger, 0600, NULL, trigger_store);
 SNAPSHOT_ATTR(timestamp, 0444, timestamp_show, NULL);
+SNAPSHOT_ATTR(stall_ms, 0644, stall_ms_show, stall_ms_store);
 
 static void snapshot_sysfs_release(struct kobject *kobj)
 {
@@ -715,6 +753,7 @@ int kgsl_device_snapshot_init(struct kgsl_device *device)
 
 	device->snapshot_maxsize = KGSL_SNAPSHOT_MEMSIZE;
 	device->snapshot_timestamp = 0;
+	device->snapshot_stall_ms = KGSL_SNAPSHOT_STALL_MS;
 
 	INIT_LIST_HEAD(&device->snapshot_obj_list);
 
@@ -732,6 +771,10 @@ int kgsl_device_snapshot_init(struct kgsl_device *device)
 		goto done;
 
 	ret  = sysfs_create_file(&device->snapshot_kobj, &attr_timestamp.attr);
+	if (ret)
+		goto done;
+
+	ret  = sysfs_create_file(&device->snapshot_kobj, &attr_stall_ms.attr);
 
 done:
 	return ret;
@@ -750,6 +793,7 @@ void kgsl_device_snapshot_close(struct kgsl_device *device)
 	sysfs_remove_bin_file(&device->snapshot_kobj, &snapshot_attr);
 	sysfs_remove_file(&device->snapshot_kobj, &attr_trigger.attr);
 	sysfs_remove_file(&device->snapshot_kobj, &attr_timestamp.attr);
+	sysfs_remove_file(&device->snapshot_kobj, &attr_stall_ms.attr);
 
 	kobject_put(&device->snapshot_kobj);
 
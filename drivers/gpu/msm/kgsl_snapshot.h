@@ -171,6 +171,9 @@ struct kgsl_snapshot_gpu_object {
 /* Allocate 512K for each device snapshot */
 #define KGSL_SNAPSHOT_MEMSIZE (512 * 1024)
 
+/* Default for how long the GPU may be kept stalled by a hang snapshot */
+#define KGSL_SNAPSHOT_STALL_MS 50
+
 struct kgsl_device;
 /*
  * A helper macro to print out "not enough memory functions" - this
@@ -293,5 +296,8 @@ void *kgsl_snapshot_indexed_registers(struct kgsl_device *device,
 int kgsl_snapshot_get_object(struct kgsl_device *device, unsigned int ptbase,
 	unsigned int gpuaddr, unsigned int size, unsigned int type);
 
+/* Check if the snapshot in progress has used up its stall time */
+bool kgsl_snapshot_timed_out(struct kgsl_device *device);
+
 #endif
 #endif
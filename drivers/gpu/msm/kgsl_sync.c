@@ -156,8 +156,8 @@ int kgsl_add_fence_event(struct kgsl_device *device,
 		goto fail_copy_fd;
 	}
 
-	ret = kgsl_add_event(device, context_id, timestamp,
-			kgsl_fence_event_cb, event, owner);
+	ret = kgsl_add_event_flags(device, context_id, timestamp,
+			kgsl_fence_event_cb, event, owner, KGSL_EVENT_NOMUTEX);
 	if (ret)
 		goto fail_event;
 
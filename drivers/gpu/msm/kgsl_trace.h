@@ -306,6 +306,73 @@ DEFINE_EVENT(kgsl_pwrstate_template, kgsl_pwr_request_state,
 	TP_ARGS(device, state)
 );
 
+TRACE_EVENT(kgsl_pwr_transition,
+
+	TP_PROTO(struct kgsl_device *device, unsigned int from,
+		 unsigned int to, unsigned int usecs),
+
+	TP_ARGS(device, from, to, usecs),
+
+	TP_STRUCT__entry(
+		__string(device_name, device->name)
+		__field(unsigned int, from)
+		__field(unsigned int, to)
+		__field(unsigned int, usecs)
+	),
+
+	TP_fast_assign(
+		__assign_str(device_name, device->name);
+		__entry->from = from;
+		__entry->to = to;
+		__entry->usecs = usecs;
+	),
+
+	TP_printk(
+		"d_name=%s %s -> %s usecs=%u",
+		__get_str(device_name),
+		kgsl_pwrstate_to_str(__entry->from),
+		kgsl_pwrstate_to_str(__entry->to),
+		__entry->usecs
+	)
+);
+
+/*
+ * Tracepoint for the time the ringbuffer took to accept a submission
+ */
+TRACE_EVENT(kgsl_submit,
+
+	TP_PROTO(struct kgsl_device *device, unsigned int context_id,
+		 unsigned int timestamp, unsigned int numibs,
+		 unsigned int usecs),
+
+	TP_ARGS(device, context_id, timestamp, numibs, usecs),
+
+	TP_STRUCT__entry(
+		__string(device_name, device->name)
+		__field(unsigned int, context_id)
+		__field(unsigned int, timestamp)
+		__field(unsigned int, numibs)
+		__field(unsigned int, usecs)
+	),
+
+	TP_fast_assign(
+		__assign_str(device_name, device->name);
+		__entry->context_id = context_id;
+		__entry->timestamp = timestamp;
+		__entry->numibs = numibs;
+		__entry->usecs = usecs;
+	),
+
+	TP_printk(
+		"d_name=%s ctx=%u timestamp=0x%x numibs=%u usecs=%u",
+		__get_str(device_name),
+		__entry->context_id,
+		__entry->timestamp,
+		__entry->numibs,
+		__entry->usecs
+	)
+);
+
 TRACE_EVENT(kgsl_mem_alloc,
 
 	TP_PROTO(struct kgsl_mem_entry *mem_entry),
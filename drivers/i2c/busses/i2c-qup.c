@@ -161,6 +161,7 @@ struct qup_i2c_dev {
 	int                          out_blk_sz;
 	int                          in_blk_sz;
 	int                          wr_sz;
+	bool                         rd_blk_mode;
 	struct msm_i2c_platform_data *pdata;
 	int                          suspended;
 	int                          clk_state;
@@ -188,6 +189,29 @@ static inline void qup_print_status(struct qup_i2c_dev *dev)
 }
 #endif
 
+/*
+ * Move the received bytes from the input FIFO into the message, each
+ * FIFO word holds two of them along with their tags.
+ */
+static void
+qup_i2c_read_fifo(struct qup_i2c_dev *dev)
+{
+	uint32_t dval = 0;
+	int i;
+
+	for (i = 0; dev->pos < dev->msg->len; i++, dev->pos++) {
+		if (i % 2 == 0) {
+			if (!(readl_relaxed(dev->base + QUP_OPERATIONAL) &
+				QUP_IN_NOT_EMPTY))
+				break;
+			dval = readl_relaxed(dev->base + QUP_IN_FIFO_BASE);
+			dev->msg->buf[dev->pos] = dval & 0xFF;
+		} else
+			dev->msg->buf[dev->pos] = (dval & 0xFF0000) >> 16;
+	}
+	dev->cnt -= i;
+}
+
 static irqreturn_t
 qup_i2c_interrupt(int irq, void *devid)
 {
@@ -252,6 +276,18 @@ qup_i2c_interrupt(int irq, void *devid)
 			 * exits
 			 */
 			mb();
+			/*
+			 * In block mode every block raises an interrupt.
+			 * Drain them here and wake up the transfer once the
+			 * read is done, rather than bouncing each block
+			 * through the waiting thread and a PAUSE/RUN cycle.
+			 */
+			if (dev->rd_blk_mode) {
+				qup_i2c_read_fifo(dev);
+				if (!(op_flgs & QUP_MX_INPUT_DONE) &&
+					dev->cnt > 0)
+					return IRQ_HANDLED;
+			}
 		} else
 			return IRQ_HANDLED;
 	}
@@ -614,6 +650,7 @@ qup_set_read_mode(struct qup_i2c_dev *dev, int rd_len)
 		dev_dbg(dev->dev, "HW limit: Breaking reads in chunk of 256\n");
 		rd_len = 256;
 	}
+	dev->rd_blk_mode = rd_len > dev->in_fifo_sz;
 	if (rd_len <= dev->in_fifo_sz) {
 		writel_relaxed(wr_mode | QUP_PACK_EN | QUP_UNPACK_EN,
 			dev->base + QUP_IO_MODE);
@@ -841,6 +878,7 @@ qup_i2c_xfer(struct i2c_adapter *adap, struct i2c_msg msgs[], int num)
 		dev->msg = msgs;
 
 		dev->wr_sz = dev->out_fifo_sz;
+		dev->rd_blk_mode = false;
 		dev->err = 0;
 		dev->complete = &complete;
 
@@ -999,29 +1037,9 @@ timeout_err:
 				ret = -dev->err;
 				goto out_err;
 			}
-			if (dev->msg->flags & I2C_M_RD) {
-				int i;
-				uint32_t dval = 0;
-				for (i = 0; dev->pos < dev->msg->len; i++,
-						dev->pos++) {
-					uint32_t rd_status =
-						readl_relaxed(dev->base
-							+ QUP_OPERATIONAL);
-					if (i % 2 == 0) {
-						if ((rd_status &
-							QUP_IN_NOT_EMPTY) == 0)
-							break;
-						dval = readl_relaxed(dev->base +
-							QUP_IN_FIFO_BASE);
-						dev->msg->buf[dev->pos] =
-							dval & 0xFF;
-					} else
-						dev->msg->buf[dev->pos] =
-							((dval & 0xFF0000) >>
-							 16);
-				}
-				dev->cnt -= i;
-			} else
+			if (dev->msg->flags & I2C_M_RD)
+				qup_i2c_read_fifo(dev);
+			else
 				filled = false; /* refill output FIFO */
 			dev_dbg(dev->dev, "pos:%d, len:%d, cnt:%d\n",
 					dev->pos, msgs->len, dev->cnt);
@@ -12,6 +12,10 @@
  * use for device orientation. A fuller version is available from the Meego
  * tree.
  *
+ * With batch_ms set the samples are collected in the FIFO of the chip
+ * and read out in bulk at most batch_ms apart, each with its timestamp
+ * reported as MSC_TIMESTAMP, instead of one wakeup per sample.
+ *
  * This program is based on bma023.c.
  *
  * This program is free software; you can redistribute it and/or modify
@@ -38,11 +42,13 @@
 #include <linux/i2c.h>
 #include <linux/input.h>
 #include <linux/delay.h>
+#include <linux/ktime.h>
 #include <linux/slab.h>
 #include <linux/pm_runtime.h>
 #include <linux/gpio.h>
 #include <linux/input/mpu3050.h>
 #include <linux/regulator/consumer.h>
+#include <asm/unaligned.h>
 
 #define MPU3050_CHIP_ID		0x69
 
@@ -55,18 +61,37 @@
 #define MPU3050_MAX_POLL_INTERVAL	250
 #define MPU3050_DEFAULT_POLL_INTERVAL	200
 #define MPU3050_DEFAULT_FS_RANGE	3
+#define MPU3050_MAX_BATCH_MS		1000
+
+#define MPU3050_FIFO_SIZE	512
+#define MPU3050_FIFO_SAMPLE	6
 
 /* Register map */
 #define MPU3050_CHIP_ID_REG	0x00
+#define MPU3050_FIFO_EN		0x12
 #define MPU3050_SMPLRT_DIV	0x15
 #define MPU3050_DLPF_FS_SYNC	0x16
 #define MPU3050_INT_CFG		0x17
 #define MPU3050_XOUT_H		0x1D
+#define MPU3050_FIFO_COUNTH	0x3A
+#define MPU3050_FIFO_R		0x3C
+#define MPU3050_USER_CTRL	0x3D
 #define MPU3050_PWR_MGM		0x3E
 #define MPU3050_PWR_MGM_POS	6
 
 /* Register bits */
 
+/* FIFO_EN */
+#define MPU3050_FIFO_EN_GYRO_XOUT	0x40
+#define MPU3050_FIFO_EN_GYRO_YOUT	0x20
+#define MPU3050_FIFO_EN_GYRO_ZOUT	0x10
+#define MPU3050_FIFO_EN_GYRO		(MPU3050_FIFO_EN_GYRO_XOUT | \
+					 MPU3050_FIFO_EN_GYRO_YOUT | \
+					 MPU3050_FIFO_EN_GYRO_ZOUT)
+/* USER_CTRL */
+#define MPU3050_USER_FIFO_EN		0x40
+#define MPU3050_USER_FIFO_RST		0x02
+
 /* DLPF_FS_SYNC */
 #define MPU3050_EXT_SYNC_NONE		0x00
 #define MPU3050_EXT_SYNC_TEMP		0x20
@@ -123,6 +148,10 @@ struct mpu3050_sensor {
 	struct delayed_work input_work;
 	u32    use_poll;
 	u32    poll_interval;
+	struct mutex lock;	/* batch_ms and opened */
+	u32    batch_ms;
+	bool   opened;
+	u8     fifo_buf[MPU3050_FIFO_SIZE];
 };
 
 struct sensor_regulator {
@@ -234,11 +263,62 @@ static ssize_t mpu3050_attr_set_polling_rate(struct device *dev,
 	return size;
 }
 
+static int mpu3050_set_batching(struct mpu3050_sensor *sensor);
+static unsigned long mpu3050_work_delay(struct mpu3050_sensor *sensor);
+
+/**
+ *	mpu3050_attr_get_batch	-	get the maximum report latency
+ */
+static ssize_t mpu3050_attr_get_batch(struct device *dev,
+				struct device_attribute *attr,
+				char *buf)
+{
+	struct mpu3050_sensor *sensor = dev_get_drvdata(dev);
+
+	return snprintf(buf, 8, "%u\n", sensor->batch_ms);
+}
+
+/**
+ *	mpu3050_attr_set_batch	-	set the maximum report latency
+ *
+ *	0 reports every sample as it is taken.
+ */
+static ssize_t mpu3050_attr_set_batch(struct device *dev,
+				struct device_attribute *attr,
+				const char *buf, size_t size)
+{
+	struct mpu3050_sensor *sensor = dev_get_drvdata(dev);
+	unsigned long batch_ms;
+	int error = 0;
+
+	if (kstrtoul(buf, 10, &batch_ms))
+		return -EINVAL;
+	if (batch_ms > MPU3050_MAX_BATCH_MS)
+		return -EINVAL;
+
+	mutex_lock(&sensor->lock);
+	if (sensor->opened)
+		cancel_delayed_work_sync(&sensor->input_work);
+	sensor->batch_ms = batch_ms;
+	if (sensor->opened) {
+		error = mpu3050_set_batching(sensor);
+		if (sensor->use_poll || sensor->batch_ms)
+			schedule_delayed_work(&sensor->input_work,
+				mpu3050_work_delay(sensor));
+	}
+	mutex_unlock(&sensor->lock);
+
+	return error < 0 ? error : size;
+}
+
 static struct device_attribute attributes[] = {
 
 	__ATTR(pollrate_ms, 0666,
 		mpu3050_attr_get_polling_rate,
 		mpu3050_attr_set_polling_rate),
+	__ATTR(batch_ms, 0664,
+		mpu3050_attr_get_batch,
+		mpu3050_attr_set_batch),
 };
 
 static int create_sysfs_interfaces(struct device *dev)
@@ -268,21 +348,22 @@ static int remove_sysfs_interfaces(struct device *dev)
 }
 
 /**
- *	mpu3050_xyz_read_reg	-	read the axes values
+ *	mpu3050_read_reg_block	-	read consecutive registers
+ *	@reg: first register to read
  *	@buffer: provide register addr and get register
  *	@length: length of register
  *
  *	Reads the register values in one transaction or returns a negative
  *	error code on failure.
  */
-static int mpu3050_xyz_read_reg(struct i2c_client *client,
+static int mpu3050_read_reg_block(struct i2c_client *client, u8 reg,
 			       u8 *buffer, int length)
 {
 	/*
 	 * Annoying we can't make this const because the i2c layer doesn't
 	 * declare input buffers const.
 	 */
-	char cmd = MPU3050_XOUT_H;
+	char cmd = reg;
 	struct i2c_msg msg[] = {
 		{
 			.addr = client->addr,
@@ -313,7 +394,7 @@ static void mpu3050_read_xyz(struct i2c_client *client,
 {
 	u16 buffer[3];
 
-	mpu3050_xyz_read_reg(client, (u8 *)buffer, 6);
+	mpu3050_read_reg_block(client, MPU3050_XOUT_H, (u8 *)buffer, 6);
 	coords->x = be16_to_cpu(buffer[0]);
 	coords->y = be16_to_cpu(buffer[1]);
 	coords->z = be16_to_cpu(buffer[2]);
@@ -364,18 +445,19 @@ static int mpu3050_input_open(struct input_dev *input)
 
 	pm_runtime_get_sync(sensor->dev);
 
-	/* Enable interrupts */
-	error = i2c_smbus_write_byte_data(sensor->client, MPU3050_INT_CFG,
-					MPU3050_ACTIVE_LOW |
-					MPU3050_OPEN_DRAIN |
-					MPU3050_RAW_RDY_EN);
+	mutex_lock(&sensor->lock);
+	/* Enable interrupts, or the FIFO */
+	error = mpu3050_set_batching(sensor);
 	if (error < 0) {
+		mutex_unlock(&sensor->lock);
 		pm_runtime_put(sensor->dev);
 		return error;
 	}
-	if (sensor->use_poll)
+	if (sensor->use_poll || sensor->batch_ms)
 		schedule_delayed_work(&sensor->input_work,
-			msecs_to_jiffies(sensor->poll_interval));
+			mpu3050_work_delay(sensor));
+	sensor->opened = true;
+	mutex_unlock(&sensor->lock);
 
 	return 0;
 }
@@ -391,12 +473,126 @@ static void mpu3050_input_close(struct input_dev *input)
 {
 	struct mpu3050_sensor *sensor = input_get_drvdata(input);
 
-	if (sensor->use_poll)
-		cancel_delayed_work_sync(&sensor->input_work);
+	mutex_lock(&sensor->lock);
+	sensor->opened = false;
+	cancel_delayed_work_sync(&sensor->input_work);
+	if (sensor->batch_ms) {
+		i2c_smbus_write_byte_data(sensor->client, MPU3050_USER_CTRL, 0);
+		i2c_smbus_write_byte_data(sensor->client, MPU3050_FIFO_EN, 0);
+	}
+	mutex_unlock(&sensor->lock);
 
 	pm_runtime_put(sensor->dev);
 }
 
+/**
+ *	mpu3050_set_batching	-	configure sample delivery
+ *	@sensor: the sensor
+ *
+ *	Without batching every sample raises the data ready interrupt.  With
+ *	batching the gyro axes are fed into the FIFO and the interrupt is
+ *	left off, the FIFO is read from the work instead.
+ *
+ *	Called with sensor->lock held.
+ */
+static int mpu3050_set_batching(struct mpu3050_sensor *sensor)
+{
+	struct i2c_client *client = sensor->client;
+	u8 int_cfg = MPU3050_ACTIVE_LOW | MPU3050_OPEN_DRAIN;
+	int error;
+
+	if (sensor->batch_ms) {
+		error = i2c_smbus_write_byte_data(client, MPU3050_FIFO_EN,
+						MPU3050_FIFO_EN_GYRO);
+		if (error < 0)
+			return error;
+		error = i2c_smbus_write_byte_data(client, MPU3050_USER_CTRL,
+						MPU3050_USER_FIFO_EN |
+						MPU3050_USER_FIFO_RST);
+	} else {
+		int_cfg |= MPU3050_RAW_RDY_EN;
+		error = i2c_smbus_write_byte_data(client, MPU3050_USER_CTRL, 0);
+		if (error < 0)
+			return error;
+		error = i2c_smbus_write_byte_data(client, MPU3050_FIFO_EN, 0);
+	}
+	if (error < 0)
+		return error;
+
+	return i2c_smbus_write_byte_data(client, MPU3050_INT_CFG, int_cfg);
+}
+
+/**
+ *	mpu3050_work_delay	-	time until the next poll or FIFO read
+ *	@sensor: the sensor
+ *
+ *	A batch is read early enough that the FIFO cannot overflow.
+ */
+static unsigned long mpu3050_work_delay(struct mpu3050_sensor *sensor)
+{
+	u32 full_ms;
+
+	if (!sensor->batch_ms)
+		return msecs_to_jiffies(sensor->poll_interval);
+
+	/* one sample every poll_interval, keep a couple spare */
+	full_ms = (MPU3050_FIFO_SIZE / MPU3050_FIFO_SAMPLE - 2) *
+		sensor->poll_interval;
+	return msecs_to_jiffies(min(sensor->batch_ms, full_ms));
+}
+
+/**
+ *	mpu3050_read_fifo	-	report the samples batched in the FIFO
+ *	@sensor: the sensor
+ *
+ *	All complete samples are read in one transfer.  The newest one gets
+ *	the current time, the older ones are a sample period apart.
+ */
+static void mpu3050_read_fifo(struct mpu3050_sensor *sensor)
+{
+	struct i2c_client *client = sensor->client;
+	s64 now, period_us;
+	__be16 count;
+	int i, n;
+
+	if (mpu3050_read_reg_block(client, MPU3050_FIFO_COUNTH,
+				   (u8 *)&count, 2) < 0)
+		return;
+
+	n = be16_to_cpu(count);
+	if (n >= MPU3050_FIFO_SIZE) {
+		/* overflowed, the sample boundaries are lost */
+		dev_dbg(&client->dev, "%s: FIFO overflow\n", __func__);
+		i2c_smbus_write_byte_data(client, MPU3050_USER_CTRL,
+					MPU3050_USER_FIFO_EN |
+					MPU3050_USER_FIFO_RST);
+		return;
+	}
+
+	n /= MPU3050_FIFO_SAMPLE;
+	if (!n)
+		return;
+	if (mpu3050_read_reg_block(client, MPU3050_FIFO_R, sensor->fifo_buf,
+				   n * MPU3050_FIFO_SAMPLE) < 0)
+		return;
+
+	now = ktime_to_us(ktime_get());
+	period_us = sensor->poll_interval * USEC_PER_MSEC;
+	for (i = 0; i < n; i++) {
+		u8 *sample = sensor->fifo_buf + i * MPU3050_FIFO_SAMPLE;
+
+		input_event(sensor->idev, EV_MSC, MSC_TIMESTAMP,
+			    (int)(now - (n - 1 - i) * period_us));
+		input_report_abs(sensor->idev, ABS_X,
+				 (s16)get_unaligned_be16(sample));
+		input_report_abs(sensor->idev, ABS_Y,
+				 (s16)get_unaligned_be16(sample + 2));
+		input_report_abs(sensor->idev, ABS_Z,
+				 (s16)get_unaligned_be16(sample + 4));
+		input_sync(sensor->idev);
+	}
+}
+
 /**
  *	mpu3050_interrupt_thread	-	handle an IRQ
  *	@irq: interrupt numner
@@ -435,6 +631,13 @@ static void mpu3050_input_work_fn(struct work_struct *work)
 	sensor = container_of((struct delayed_work *)work,
 				struct mpu3050_sensor, input_work);
 
+	if (sensor->batch_ms) {
+		mpu3050_read_fifo(sensor);
+		schedule_delayed_work(&sensor->input_work,
+			mpu3050_work_delay(sensor));
+		return;
+	}
+
 	mpu3050_read_xyz(sensor->client, &axis);
 
 	input_report_abs(sensor->idev, ABS_X, axis.x);
@@ -559,6 +762,8 @@ static int __devinit mpu3050_probe(struct i2c_client *client,
 	idev->close = mpu3050_input_close;
 
 	__set_bit(EV_ABS, idev->evbit);
+	__set_bit(EV_MSC, idev->evbit);
+	__set_bit(MSC_TIMESTAMP, idev->mscbit);
 	input_set_abs_params(idev, ABS_X,
 			     MPU3050_MIN_VALUE, MPU3050_MAX_VALUE, 0, 0);
 	input_set_abs_params(idev, ABS_Y,
@@ -574,9 +779,10 @@ static int __devinit mpu3050_probe(struct i2c_client *client,
 	if (error)
 		goto err_pm_set_suspended;
 
+	mutex_init(&sensor->lock);
+	INIT_DELAYED_WORK(&sensor->input_work, mpu3050_input_work_fn);
 	if (client->irq == 0) {
 		sensor->use_poll = 1;
-		INIT_DELAYED_WORK(&sensor->input_work, mpu3050_input_work_fn);
 	} else {
 		sensor->use_poll = 0;
 
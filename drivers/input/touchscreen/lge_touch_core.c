@@ -25,6 +25,9 @@
 #include <linux/slab.h>
 #include <linux/earlysuspend.h>
 #include <linux/jiffies.h>
+#include <linux/mutex.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <linux/sysdev.h>
 #include <linux/types.h>
 #include <linux/time.h>
@@ -35,6 +38,9 @@
 
 #include <linux/input/lge_touch_core.h>
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/lge_touch.h>
+
 struct touch_device_driver*     touch_device_func;
 struct workqueue_struct*        touch_wq;
 
@@ -72,6 +78,36 @@ struct timeval t_debug[TIME_PROFILE_MAX];
 
 #define MAX_RETRY_COUNT         3
 
+/*
+ * Latency of each stage of a sample since its interrupt, always kept.
+ * Bucket n counts latencies below 2^n us, the last one everything
+ * longer.  Read from debugfs lge_touch/latency, write to clear.
+ */
+enum {
+	TOUCH_LAT_READ,		/* touch_device_func->data() done */
+	TOUCH_LAT_FILTER,	/* accuracy and jitter filters done */
+	TOUCH_LAT_SYNC,		/* input_sync() called */
+	TOUCH_LAT_DELIVERED,	/* input_sync() returned, readers woken */
+	TOUCH_LAT_STAGES
+};
+
+#define TOUCH_LAT_BUCKETS	17
+
+static const char * const touch_lat_names[TOUCH_LAT_STAGES] = {
+	"read", "filter", "sync", "delivered",
+};
+static u32 touch_lat_hist[TOUCH_LAT_STAGES][TOUCH_LAT_BUCKETS];
+static struct dentry *touch_debugfs_dir;
+
+static s64 touch_lat_record(struct lge_touch_data *ts, int stage)
+{
+	s64 us = ktime_us_delta(ktime_get(), ts->irq_time);
+
+	touch_lat_hist[stage][min_t(int, fls64(max_t(s64, us, 0)),
+				    TOUCH_LAT_BUCKETS - 1)]++;
+	return us;
+}
+
 #ifdef LGE_TOUCH_POINT_DEBUG
 #define MAX_TRACE	500
 struct pointer_trace {
@@ -784,16 +820,23 @@ static void touch_input_report(struct lge_touch_data *ts)
 		}
 	}
 
+	/* the IRQ time, not the time this thread got to run */
+	input_event(ts->input_dev, EV_MSC, MSC_TIMESTAMP,
+		    (u32)ktime_to_us(ts->irq_time));
+	trace_touch_input_sync(touch_lat_record(ts, TOUCH_LAT_SYNC),
+			       ts->ts_data.total_num);
 	input_sync(ts->input_dev);
+	trace_touch_input_delivered(touch_lat_record(ts, TOUCH_LAT_DELIVERED),
+				    ts->ts_data.total_num);
 }
 
 /*
- * Touch work function
+ * Read, filter and report one sample.  Runs in the irq thread in
+ * interrupt mode and from touch_wq for polling and retries; the caller
+ * holds thread_lock.
  */
-static void touch_work_func(struct work_struct *work)
+static void touch_process(struct lge_touch_data *ts)
 {
-	struct lge_touch_data *ts =
-			container_of(work, struct lge_touch_data, work);
 	int int_pin = 0;
 	int next_work = 0;
 	int ret;
@@ -819,6 +862,8 @@ static void touch_work_func(struct work_struct *work)
 			return;
 		goto err_out_critical;
 	}
+	trace_touch_read_done(touch_lat_record(ts, TOUCH_LAT_READ),
+			      ts->ts_data.total_num);
 
 	if (likely(ts->pdata->role->operation_mode == INTERRUPT_MODE))
 		int_pin = gpio_get_value(ts->pdata->int_pin);
@@ -834,6 +879,8 @@ static void touch_work_func(struct work_struct *work)
 		if (jitter_filter_func(ts) < 0)
 			goto out;
 	}
+	trace_touch_filter_done(touch_lat_record(ts, TOUCH_LAT_FILTER),
+				ts->ts_data.total_num);
 
 	touch_input_report(ts);
 
@@ -874,6 +921,19 @@ err_out_critical:
 	return;
 }
 
+/*
+ * Touch work function
+ */
+static void touch_work_func(struct work_struct *work)
+{
+	struct lge_touch_data *ts =
+			container_of(work, struct lge_touch_data, work);
+
+	mutex_lock(&ts->thread_lock);
+	touch_process(ts);
+	mutex_unlock(&ts->thread_lock);
+}
+
 /* touch_fw_upgrade_func
  *
  * it used to upgrade the firmware of touch IC.
@@ -997,12 +1057,28 @@ static irqreturn_t touch_irq_handler(int irq, void *dev_id)
 	if (unlikely(atomic_read(&ts->device_init) != 1))
 		return IRQ_HANDLED;
 
+	ts->irq_time = ktime_get();
+	trace_touch_irq(irq);
 #ifdef LGE_TOUCH_TIME_DEBUG
 	do_gettimeofday(&t_debug[TIME_ISR_START]);
 #endif
 	atomic_inc(&ts->next_work);
 
-	queue_work(touch_wq, &ts->work);
+	return IRQ_WAKE_THREAD;
+}
+
+/* touch_thread_irq_handler
+ *
+ * Runs as a SCHED_FIFO irq thread with the interrupt masked, so the
+ * report does not wait behind other work on a busy CPU.
+ */
+static irqreturn_t touch_thread_irq_handler(int irq, void *dev_id)
+{
+	struct lge_touch_data *ts = (struct lge_touch_data *)dev_id;
+
+	mutex_lock(&ts->thread_lock);
+	touch_process(ts);
+	mutex_unlock(&ts->thread_lock);
 
 	return IRQ_HANDLED;
 }
@@ -1016,6 +1092,7 @@ static enum hrtimer_restart touch_timer_handler(struct hrtimer *timer)
 	struct lge_touch_data *ts =
 			container_of(timer, struct lge_touch_data, timer);
 
+	ts->irq_time = ktime_get();
 	atomic_inc(&ts->next_work);
 	queue_work(touch_wq, &ts->work);
 	hrtimer_start(&ts->timer,
@@ -1954,6 +2031,7 @@ static int touch_probe(struct i2c_client *client,
 	msleep(ts->pdata->role->booting_delay);
 
 	/* init work_queue */
+	mutex_init(&ts->thread_lock);
 	INIT_WORK(&ts->work, touch_work_func);
 
 	INIT_DELAYED_WORK(&ts->work_init, touch_init_func);
@@ -1971,6 +2049,7 @@ static int touch_probe(struct i2c_client *client,
 
 	set_bit(EV_SYN, ts->input_dev->evbit);
 	set_bit(EV_ABS, ts->input_dev->evbit);
+	input_set_capability(ts->input_dev, EV_MSC, MSC_TIMESTAMP);
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3, 0, 0))
 	set_bit(INPUT_PROP_DIRECT, ts->input_dev->propbit);
 #endif
@@ -2028,7 +2107,7 @@ static int touch_probe(struct i2c_client *client,
 		gpio_direction_input(ts->pdata->int_pin);
 
 		ret = request_threaded_irq(client->irq, touch_irq_handler,
-				NULL,
+				touch_thread_irq_handler,
 				ts->pdata->role->irqflags | IRQF_ONESHOT,
 				client->name, ts);
 
@@ -2092,6 +2171,8 @@ static int touch_probe(struct i2c_client *client,
 		goto err_lge_touch_sysfs_init_and_add;
 	}
 
+	device_enable_async_suspend(&client->dev);
+
 	if (likely(touch_debug_mask & DEBUG_BASE_INFO))
 		TOUCH_INFO_MSG("Touch driver is initialized\n");
 
@@ -2255,6 +2336,47 @@ static struct i2c_driver lge_touch_driver = {
 	},
 };
 
+static int touch_latency_show(struct seq_file *m, void *unused)
+{
+	int stage, b;
+
+	seq_printf(m, "%-10s", "us");
+	for (stage = 0; stage < TOUCH_LAT_STAGES; stage++)
+		seq_printf(m, " %10s", touch_lat_names[stage]);
+	seq_putc(m, '\n');
+
+	for (b = 0; b < TOUCH_LAT_BUCKETS; b++) {
+		if (b < TOUCH_LAT_BUCKETS - 1)
+			seq_printf(m, "<%-9u", 1U << b);
+		else
+			seq_printf(m, ">=%-8u", 1U << (b - 1));
+		for (stage = 0; stage < TOUCH_LAT_STAGES; stage++)
+			seq_printf(m, " %10u", touch_lat_hist[stage][b]);
+		seq_putc(m, '\n');
+	}
+	return 0;
+}
+
+static int touch_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, touch_latency_show, NULL);
+}
+
+static ssize_t touch_latency_write(struct file *file, const char __user *buf,
+				   size_t count, loff_t *ppos)
+{
+	memset(touch_lat_hist, 0, sizeof(touch_lat_hist));
+	return count;
+}
+
+static const struct file_operations touch_latency_fops = {
+	.open		= touch_latency_open,
+	.read		= seq_read,
+	.write		= touch_latency_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 int touch_driver_register(struct touch_device_driver* driver)
 {
 	int ret = 0;
@@ -2283,6 +2405,12 @@ int touch_driver_register(struct touch_device_driver* driver)
 		goto err_i2c_add_driver;
 	}
 
+	touch_debugfs_dir = debugfs_create_dir("lge_touch", NULL);
+	if (!IS_ERR_OR_NULL(touch_debugfs_dir))
+		debugfs_create_file("latency", S_IRUGO | S_IWUSR,
+				    touch_debugfs_dir, NULL,
+				    &touch_latency_fops);
+
 	return 0;
 
 err_i2c_add_driver:
@@ -2297,6 +2425,7 @@ void touch_driver_unregister(void)
 	if (unlikely(touch_debug_mask & DEBUG_TRACE))
 		TOUCH_DEBUG_MSG("\n");
 
+	debugfs_remove_recursive(touch_debugfs_dir);
 	i2c_del_driver(&lge_touch_driver);
 	touch_device_func = NULL;
 
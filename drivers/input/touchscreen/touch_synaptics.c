@@ -176,11 +176,36 @@ int synaptics_ts_get_data(struct i2c_client *client, struct t_data* data,
 	u32 finger_status=0;
 	u8 id=0;
 	u8 cnt;
+	u8 have = 0;
+	int state_len = sizeof(ts->ts_data.finger.finger_status_reg);
+	/* F11 data usually follows the two F01 data registers */
+	bool block = FINGER_STATE_REG == DEVICE_STATUS_REG + 2;
 
 	if (unlikely(touch_debug_mask & DEBUG_TRACE))
 		TOUCH_DEBUG_MSG("\n");
 
-	if (unlikely(touch_i2c_read(client, DEVICE_STATUS_REG,
+	if (likely(block)) {
+		/*
+		 * One transfer for both status registers, the finger state
+		 * and as many fingers as the last sample had, which is
+		 * all of them while a gesture goes on.
+		 */
+		have = ts->ts_data.block_fingers;
+		if (unlikely(touch_i2c_read(client, DEVICE_STATUS_REG,
+				2 + state_len +
+				NUM_OF_EACH_FINGER_DATA_REG * have,
+				ts->ts_data.block) < 0)) {
+			TOUCH_ERR_MSG("DEVICE_STATUS_REG read fail\n");
+			goto err_synaptics_getdata;
+		}
+		ts->ts_data.device_status_reg = ts->ts_data.block[0];
+		ts->ts_data.interrupt_status_reg = ts->ts_data.block[1];
+		memcpy(ts->ts_data.finger.finger_status_reg,
+		       &ts->ts_data.block[2], state_len);
+		memcpy(ts->ts_data.finger.finger_reg,
+		       &ts->ts_data.block[2 + state_len],
+		       NUM_OF_EACH_FINGER_DATA_REG * have);
+	} else if (unlikely(touch_i2c_read(client, DEVICE_STATUS_REG,
 			sizeof(ts->ts_data.device_status_reg),
 			&ts->ts_data.device_status_reg) < 0)) {
 		TOUCH_ERR_MSG("DEVICE_STATUS_REG read fail\n");
@@ -201,7 +226,7 @@ int synaptics_ts_get_data(struct i2c_client *client, struct t_data* data,
 		goto err_synaptics_device_damage;
 	}
 
-	if (unlikely(touch_i2c_read(client, INTERRUPT_STATUS_REG,
+	if (unlikely(!block && touch_i2c_read(client, INTERRUPT_STATUS_REG,
 			sizeof(ts->ts_data.interrupt_status_reg),
 			&ts->ts_data.interrupt_status_reg) < 0)) {
 		TOUCH_ERR_MSG("INTERRUPT_STATUS_REG read fail\n");
@@ -226,7 +251,7 @@ int synaptics_ts_get_data(struct i2c_client *client, struct t_data* data,
 
 	/* Finger */
 	if (likely(ts->ts_data.interrupt_status_reg & ts->interrupt_mask.abs)) {
-		if (unlikely(touch_i2c_read(client, FINGER_STATE_REG,
+		if (unlikely(!block && touch_i2c_read(client, FINGER_STATE_REG,
 				sizeof(ts->ts_data.finger.finger_status_reg),
 				ts->ts_data.finger.finger_status_reg) < 0)) {
 			TOUCH_ERR_MSG("FINGER_STATE_REG read fail\n");
@@ -247,13 +272,20 @@ int synaptics_ts_get_data(struct i2c_client *client, struct t_data* data,
 
 		if (finger_status) {
 			int max_id = get_highest_id(finger_status);
-			if (unlikely(touch_i2c_read(ts->client,
-					FINGER_DATA_REG_START,
-					NUM_OF_EACH_FINGER_DATA_REG * max_id,
-					ts->ts_data.finger.finger_reg[0]) < 0)) {
+			u8 *rest = ts->ts_data.finger.finger_reg[have];
+
+			/* only the fingers the block read did not cover */
+			if (max_id > have && unlikely(touch_i2c_read(ts->client,
+					FINGER_DATA_REG_START +
+					NUM_OF_EACH_FINGER_DATA_REG * have,
+					NUM_OF_EACH_FINGER_DATA_REG *
+					(max_id - have), rest) < 0)) {
 				TOUCH_ERR_MSG("FINGER_STATE_REG read fail\n");
 				goto err_synaptics_getdata;
 			}
+			ts->ts_data.block_fingers = max_id;
+		} else {
+			ts->ts_data.block_fingers = 0;
 		}
 
 		for (id = 0; id < ts->pdata->caps->max_id; id++) {
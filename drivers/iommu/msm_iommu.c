@@ -796,13 +796,65 @@ static unsigned int get_phys_addr(struct scatterlist *sg)
 	return pa;
 }
 
+/*
+ * Largest page size (4K, 64K or 1M) that can map the memory at @va/@pa,
+ * which lies @chunk_offset bytes into @sg: both addresses must be aligned
+ * to it and the next @len bytes of the list must be physically contiguous.
+ */
+static unsigned int msm_iommu_pgsize(unsigned int va, unsigned int pa,
+				     struct scatterlist *sg,
+				     unsigned int chunk_offset,
+				     unsigned int len)
+{
+	unsigned int want, run;
+
+	if (len >= SZ_1M && !((va | pa) & (SZ_1M - 1)))
+		want = SZ_1M;
+	else if (len >= SZ_64K && !((va | pa) & (SZ_64K - 1)))
+		want = SZ_64K;
+	else
+		return SZ_4K;
+
+	run = sg->length - chunk_offset;
+	while (run < want && !sg_is_last(sg)) {
+		sg = sg_next(sg);
+		if (get_phys_addr(sg) != pa + run)
+			break;
+		run += sg->length;
+	}
+
+	if (run >= want)
+		return want;
+	if (run >= SZ_64K)
+		return SZ_64K;
+	return SZ_4K;
+}
+
+/* Move on to the sg entry @chunk_offset points into */
+static int msm_iommu_sg_advance(struct scatterlist **sg,
+				unsigned int *chunk_offset,
+				unsigned int *chunk_pa)
+{
+	while (*chunk_offset >= (*sg)->length) {
+		*chunk_offset -= (*sg)->length;
+		*sg = sg_next(*sg);
+		*chunk_pa = get_phys_addr(*sg);
+		if (*chunk_pa == 0) {
+			pr_debug("No dma address for sg %p\n", *sg);
+			return -EINVAL;
+		}
+	}
+	return 0;
+}
+
 static int msm_iommu_map_range(struct iommu_domain *domain, unsigned int va,
 			       struct scatterlist *sg, unsigned int len,
 			       int prot)
 {
 	unsigned int pa;
 	unsigned int offset = 0;
-	unsigned int pgprot;
+	unsigned int pgprot, pgprot_sect;
+	unsigned int size;
 	unsigned long *fl_table;
 	unsigned long *fl_pte;
 	unsigned long fl_offset;
@@ -810,7 +862,7 @@ static int msm_iommu_map_range(struct iommu_domain *domain, unsigned int va,
 	unsigned long sl_offset, sl_start;
 	unsigned int chunk_offset = 0;
 	unsigned int chunk_pa;
-	int ret = 0;
+	int i, ret = 0;
 	struct msm_priv *priv;
 
 	mutex_lock(&msm_iommu_lock);
@@ -821,8 +873,9 @@ static int msm_iommu_map_range(struct iommu_domain *domain, unsigned int va,
 	fl_table = priv->pgtable;
 
 	pgprot = __get_pgprot(prot, SZ_4K);
+	pgprot_sect = __get_pgprot(prot, SZ_1M);
 
-	if (!pgprot) {
+	if (!pgprot || !pgprot_sect) {
 		ret = -EINVAL;
 		goto fail;
 	}
@@ -841,6 +894,28 @@ static int msm_iommu_map_range(struct iommu_domain *domain, unsigned int va,
 	}
 
 	while (offset < len) {
+		pa = chunk_pa + chunk_offset;
+
+		/* Map a whole section if the memory behind it is contiguous */
+		if (*fl_pte == 0 && msm_iommu_pgsize(va + offset, pa, sg,
+				chunk_offset, len - offset) == SZ_1M) {
+			*fl_pte = (pa & 0xFFF00000) | FL_NG | FL_TYPE_SECT |
+				  FL_SHARED | pgprot_sect;
+			clean_pte(fl_pte, fl_pte + 1, priv->redirect);
+
+			offset += SZ_1M;
+			chunk_offset += SZ_1M;
+			if (offset < len) {
+				ret = msm_iommu_sg_advance(&sg, &chunk_offset,
+							   &chunk_pa);
+				if (ret)
+					goto fail;
+			}
+			fl_pte++;
+			sl_offset = 0;
+			continue;
+		}
+
 		/* Set up a 2nd level page table if one doesn't exist */
 		if (*fl_pte == 0) {
 			sl_table = (unsigned long *)
@@ -859,6 +934,11 @@ static int msm_iommu_map_range(struct iommu_domain *domain, unsigned int va,
 			*fl_pte = ((((int)__pa(sl_table)) & FL_BASE_MASK) |
 							    FL_TYPE_TABLE);
 			clean_pte(fl_pte, fl_pte + 1, priv->redirect);
+		} else if ((*fl_pte & 0x03) != FL_TYPE_TABLE) {
+			pr_debug("VA %x is already mapped by a section\n",
+				 va + offset);
+			ret = -EBUSY;
+			goto fail;
 		} else
 			sl_table = (unsigned long *)
 					       __va(((*fl_pte) & FL_BASE_MASK));
@@ -871,28 +951,41 @@ static int msm_iommu_map_range(struct iommu_domain *domain, unsigned int va,
 		/* Build the 2nd level page table */
 		while (offset < len && sl_offset < NUM_SL_PTE) {
 			pa = chunk_pa + chunk_offset;
-			sl_table[sl_offset] = (pa & SL_BASE_MASK_SMALL) |
-				     pgprot | SL_NG | SL_SHARED | SL_TYPE_SMALL;
-			sl_offset++;
-			offset += SZ_4K;
-
-			chunk_offset += SZ_4K;
-
-			if (chunk_offset >= sg->length && offset < len) {
-				chunk_offset = 0;
-				sg = sg_next(sg);
-				chunk_pa = get_phys_addr(sg);
-				if (chunk_pa == 0) {
-					pr_debug("No dma address for sg %p\n",
-						 sg);
-					ret = -EINVAL;
-					goto fail;
-				}
+			size = SZ_4K;
+			if (!(sl_offset & 15))
+				size = min(msm_iommu_pgsize(va + offset, pa, sg,
+						chunk_offset, len - offset),
+					   (unsigned int) SZ_64K);
+
+			if (size == SZ_64K) {
+				for (i = 0; i < 16; i++)
+					sl_table[sl_offset + i] =
+						(pa & SL_BASE_MASK_LARGE) |
+						pgprot | SL_NG | SL_SHARED |
+						SL_TYPE_LARGE;
+				sl_offset += 16;
+			} else {
+				sl_table[sl_offset] =
+					(pa & SL_BASE_MASK_SMALL) |
+					pgprot | SL_NG | SL_SHARED |
+					SL_TYPE_SMALL;
+				sl_offset++;
+			}
+			offset += size;
+
+			chunk_offset += size;
+			if (offset < len) {
+				ret = msm_iommu_sg_advance(&sg, &chunk_offset,
+							   &chunk_pa);
+				if (ret)
+					break;
 			}
 		}
 
 		clean_pte(sl_table + sl_start, sl_table + sl_offset,
 			  priv->redirect);
+		if (ret)
+			goto fail;
 
 		fl_pte++;
 		sl_offset = 0;
@@ -929,6 +1022,17 @@ static int msm_iommu_unmap_range(struct iommu_domain *domain, unsigned int va,
 	sl_start = SL_OFFSET(va);
 
 	while (offset < len) {
+		/* Sections are only used for whole, aligned megabytes */
+		if ((*fl_pte & 0x03) == FL_TYPE_SECT) {
+			*fl_pte = 0;
+			clean_pte(fl_pte, fl_pte + 1, priv->redirect);
+
+			offset += SZ_1M;
+			sl_start = 0;
+			fl_pte++;
+			continue;
+		}
+
 		sl_table = (unsigned long *) __va(((*fl_pte) & FL_BASE_MASK));
 		sl_end = ((len - offset) / SZ_4K) + sl_start;
 
@@ -18,6 +18,7 @@
 
 #include <linux/module.h>
 #include <linux/device-mapper.h>
+#include <linux/vmalloc.h>
 #include <crypto/hash.h>
 
 #define DM_MSG_PREFIX			"verity"
@@ -54,6 +55,8 @@ struct dm_verity {
 	unsigned digest_size;	/* digest size for the current hash algorithm */
 	unsigned shash_descsize;/* the size of temporary space for crypto */
 	int hash_failed;	/* set to 1 if hash of any block failed */
+	void *initial_state;	/* hash state after init and a leading salt */
+	unsigned long *validated_blocks; /* data blocks checked once, or NULL */
 
 	mempool_t *io_mempool;	/* mempool of struct dm_verity_io */
 	mempool_t *vec_mempool;	/* mempool of bio vector */
@@ -174,6 +177,23 @@ static void verity_hash_at_level(struct dm_verity *v, sector_t block, int level,
 		*offset = idx << (v->hash_dev_block_bits - v->hash_per_block_bits);
 }
 
+/*
+ * Start a hash from the state saved by verity_ctr(), which already has
+ * the salt in it for version 1.
+ */
+static int verity_hash_init(struct dm_verity *v, struct shash_desc *desc)
+{
+	int r;
+
+	desc->tfm = v->tfm;
+	desc->flags = CRYPTO_TFM_REQ_MAY_SLEEP;
+	r = crypto_shash_import(desc, v->initial_state);
+	if (r < 0)
+		DMERR("crypto_shash_import failed: %d", r);
+
+	return r;
+}
+
 /*
  * Verify hash of a metadata block pertaining to the specified data block
  * ("block" argument) at a specified level ("level" argument).
@@ -214,21 +234,9 @@ static int verity_verify_level(struct dm_verity_io *io, sector_t block,
 		}
 
 		desc = io_hash_desc(v, io);
-		desc->tfm = v->tfm;
-		desc->flags = CRYPTO_TFM_REQ_MAY_SLEEP;
-		r = crypto_shash_init(desc);
-		if (r < 0) {
-			DMERR("crypto_shash_init failed: %d", r);
+		r = verity_hash_init(v, desc);
+		if (r < 0)
 			goto release_ret_r;
-		}
-
-		if (likely(v->version >= 1)) {
-			r = crypto_shash_update(desc, v->salt, v->salt_size);
-			if (r < 0) {
-				DMERR("crypto_shash_update failed: %d", r);
-				goto release_ret_r;
-			}
-		}
 
 		r = crypto_shash_update(desc, data, 1 << v->hash_dev_block_bits);
 		if (r < 0) {
@@ -273,6 +281,30 @@ release_ret_r:
 	return r;
 }
 
+/*
+ * Step over a data block of the io vector that has been checked before.
+ */
+static void verity_skip_block(struct dm_verity *v, struct dm_verity_io *io,
+			      unsigned *vector, unsigned *offset)
+{
+	unsigned todo = 1 << v->data_dev_block_bits;
+
+	do {
+		struct bio_vec *bv;
+		unsigned len;
+
+		BUG_ON(*vector >= io->io_vec_size);
+		bv = &io->io_vec[*vector];
+		len = min(bv->bv_len - *offset, todo);
+		*offset += len;
+		if (likely(*offset == bv->bv_len)) {
+			*offset = 0;
+			(*vector)++;
+		}
+		todo -= len;
+	} while (todo);
+}
+
 /*
  * Verify one "dm_verity_io" structure.
  */
@@ -289,6 +321,12 @@ static int verity_verify_io(struct dm_verity_io *io)
 		int r;
 		unsigned todo;
 
+		if (v->validated_blocks &&
+		    test_bit(io->block + b, v->validated_blocks)) {
+			verity_skip_block(v, io, &vector, &offset);
+			continue;
+		}
+
 		if (likely(v->levels)) {
 			/*
 			 * First, we try to get the requested hash for
@@ -314,21 +352,9 @@ static int verity_verify_io(struct dm_verity_io *io)
 
 test_block_hash:
 		desc = io_hash_desc(v, io);
-		desc->tfm = v->tfm;
-		desc->flags = CRYPTO_TFM_REQ_MAY_SLEEP;
-		r = crypto_shash_init(desc);
-		if (r < 0) {
-			DMERR("crypto_shash_init failed: %d", r);
+		r = verity_hash_init(v, desc);
+		if (r < 0)
 			return r;
-		}
-
-		if (likely(v->version >= 1)) {
-			r = crypto_shash_update(desc, v->salt, v->salt_size);
-			if (r < 0) {
-				DMERR("crypto_shash_update failed: %d", r);
-				return r;
-			}
-		}
 
 		todo = 1 << v->data_dev_block_bits;
 		do {
@@ -377,6 +403,9 @@ test_block_hash:
 			v->hash_failed = 1;
 			return -EIO;
 		}
+
+		if (v->validated_blocks)
+			set_bit(io->block + b, v->validated_blocks);
 	}
 	BUG_ON(vector != io->io_vec_size);
 	BUG_ON(offset);
@@ -544,6 +573,8 @@ static int verity_status(struct dm_target *ti, status_type_t type,
 		else
 			for (x = 0; x < v->salt_size; x++)
 				DMEMIT("%02x", v->salt[x]);
+		if (v->validated_blocks)
+			DMEMIT(" 1 check_at_most_once");
 		break;
 	}
 
@@ -616,6 +647,8 @@ static void verity_dtr(struct dm_target *ti)
 	if (v->bufio)
 		dm_bufio_client_destroy(v->bufio);
 
+	vfree(v->validated_blocks);
+	kfree(v->initial_state);
 	kfree(v->salt);
 	kfree(v->root_digest);
 
@@ -633,6 +666,40 @@ static void verity_dtr(struct dm_target *ti)
 	kfree(v);
 }
 
+/*
+ * Hash the salt of a version 1 table once and keep the resulting state,
+ * every block hash starts from it.
+ */
+static int verity_prepare_hash(struct dm_verity *v)
+{
+	struct shash_desc *desc;
+	int r;
+
+	v->initial_state = kmalloc(crypto_shash_statesize(v->tfm), GFP_KERNEL);
+	desc = kmalloc(v->shash_descsize, GFP_KERNEL);
+	if (!v->initial_state || !desc) {
+		r = -ENOMEM;
+		goto out;
+	}
+
+	desc->tfm = v->tfm;
+	desc->flags = CRYPTO_TFM_REQ_MAY_SLEEP;
+	r = crypto_shash_init(desc);
+	if (r < 0)
+		goto out;
+
+	if (likely(v->version >= 1)) {
+		r = crypto_shash_update(desc, v->salt, v->salt_size);
+		if (r < 0)
+			goto out;
+	}
+
+	r = crypto_shash_export(desc, v->initial_state);
+out:
+	kfree(desc);
+	return r;
+}
+
 /*
  * Target parameters:
  *	<version>	The current format is version 1.
@@ -646,6 +713,14 @@ static void verity_dtr(struct dm_target *ti)
  *	<algorithm>
  *	<digest>
  *	<salt>		Hex string or "-" if no salt.
+ *
+ * Optional feature arguments, preceded by their count:
+ *	check_at_most_once	Verify each data block only the first time
+ *				it is read.  The hash blocks are still
+ *				verified whenever dm-bufio reads them in.
+ *				This trades protection against a device
+ *				that changes data after it was read for
+ *				less CPU on repeated reads.
  */
 static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 {
@@ -656,6 +731,13 @@ static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 	int i;
 	sector_t hash_position;
 	char dummy;
+	struct dm_arg_set as;
+	const char *opt_string;
+	unsigned opt_params;
+
+	static struct dm_arg _args[] = {
+		{0, 1, "Invalid number of feature args"},
+	};
 
 	v = kzalloc(sizeof(struct dm_verity), GFP_KERNEL);
 	if (!v) {
@@ -671,8 +753,8 @@ static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 		goto bad;
 	}
 
-	if (argc != 10) {
-		ti->error = "Invalid argument count: exactly 10 arguments required";
+	if (argc < 10) {
+		ti->error = "Invalid argument count: at least 10 arguments required";
 		r = -EINVAL;
 		goto bad;
 	}
@@ -793,6 +875,44 @@ static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 		}
 	}
 
+	r = verity_prepare_hash(v);
+	if (r < 0) {
+		ti->error = "Cannot prepare hash state";
+		goto bad;
+	}
+
+	argv += 10;
+	argc -= 10;
+
+	/* Optional parameters */
+	if (argc) {
+		as.argc = argc;
+		as.argv = argv;
+
+		r = dm_read_arg_group(_args, &as, &opt_params, &ti->error);
+		if (r)
+			goto bad;
+
+		while (opt_params--) {
+			opt_string = dm_shift_arg(&as);
+			if (opt_string &&
+			    !strcasecmp(opt_string, "check_at_most_once")) {
+				v->validated_blocks = vzalloc(max_t(size_t, 1,
+					BITS_TO_LONGS(v->data_blocks)) *
+					sizeof(unsigned long));
+				if (!v->validated_blocks) {
+					ti->error = "Cannot allocate bitmap";
+					r = -ENOMEM;
+					goto bad;
+				}
+			} else {
+				ti->error = "Invalid feature arguments";
+				r = -EINVAL;
+				goto bad;
+			}
+		}
+	}
+
 	v->hash_per_block_bits =
 		fls((1 << v->hash_dev_block_bits) / v->digest_size) - 1;
 
@@ -875,7 +995,7 @@ bad:
 
 static struct target_type verity_target = {
 	.name		= "verity",
-	.version	= {1, 0, 0},
+	.version	= {1, 1, 0},
 	.module		= THIS_MODULE,
 	.ctr		= verity_ctr,
 	.dtr		= verity_dtr,
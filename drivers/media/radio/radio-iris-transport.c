@@ -189,7 +189,7 @@ static int radio_hci_smd_init(void)
 {
 	return radio_hci_smd_register_dev(&hs);
 }
-module_init(radio_hci_smd_init);
+deferred_module_init(radio_hci_smd_init);
 
 static void __exit radio_hci_smd_exit(void)
 {
@@ -3565,7 +3565,7 @@ static struct video_device *video_get_dev(void)
 	return priv_videodev;
 }
 
-static int __init iris_probe(struct platform_device *pdev)
+static int iris_probe(struct platform_device *pdev)
 {
 	struct iris_device *radio;
 	int retval;
@@ -3674,14 +3674,15 @@ static struct platform_driver iris_driver = {
 		.owner  = THIS_MODULE,
 		.name   = "iris_fm",
 	},
+	.probe = iris_probe,
 	.remove = __devexit_p(iris_remove),
 };
 
-static int __init iris_radio_init(void)
+static int iris_radio_init(void)
 {
-	return platform_driver_probe(&iris_driver, iris_probe);
+	return platform_driver_register(&iris_driver);
 }
-module_init(iris_radio_init);
+deferred_module_init(iris_radio_init);
 
 static void __exit iris_radio_exit(void)
 {
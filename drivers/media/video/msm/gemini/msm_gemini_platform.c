@@ -15,6 +15,7 @@
 #include <linux/clk.h>
 #include <mach/clk.h>
 #include <linux/io.h>
+#include <linux/mutex.h>
 #include <linux/android_pmem.h>
 #include <mach/camera.h>
 #include <mach/iommu_domains.h>
@@ -28,10 +29,63 @@
 #define MSM_SYSTEM_BUS_RATE	160000
 struct ion_client *gemini_client;
 
+#ifdef CONFIG_MSM_MULTIMEDIA_USE_ION
+/*
+ * A burst cycles through the same few input and output buffers, so the
+ * first GEMINI_MAP_CACHE_SIZE buffers of a session keep their iommu
+ * mapping (and the handle reference pinning it) until the device is
+ * released instead of being mapped and unmapped for every frame.
+ */
+#define GEMINI_MAP_CACHE_SIZE	16
+
+static struct gemini_map {
+	struct ion_handle *handle;
+	unsigned long paddr;
+	unsigned long size;
+} gemini_map_cache[GEMINI_MAP_CACHE_SIZE];
+static DEFINE_MUTEX(gemini_map_lock);
+
+static struct gemini_map *gemini_map_lookup(struct ion_handle *handle)
+{
+	int i;
+
+	for (i = 0; i < GEMINI_MAP_CACHE_SIZE; i++)
+		if (gemini_map_cache[i].handle == handle)
+			return &gemini_map_cache[i];
+	return NULL;
+}
+
+static void gemini_map_flush(void)
+{
+	struct gemini_map *map;
+	int i;
+
+	mutex_lock(&gemini_map_lock);
+	for (i = 0; i < GEMINI_MAP_CACHE_SIZE; i++) {
+		map = &gemini_map_cache[i];
+		if (!map->handle)
+			continue;
+		ion_unmap_iommu(gemini_client, map->handle, CAMERA_DOMAIN,
+			GEN_POOL);
+		ion_free(gemini_client, map->handle);
+		map->handle = NULL;
+	}
+	mutex_unlock(&gemini_map_lock);
+}
+#endif
+
 void msm_gemini_platform_p2v(struct file  *file,
 				struct ion_handle **ionhandle)
 {
 #ifdef CONFIG_MSM_MULTIMEDIA_USE_ION
+	mutex_lock(&gemini_map_lock);
+	if (gemini_map_lookup(*ionhandle)) {
+		/* the mapping stays until the device is released */
+		mutex_unlock(&gemini_map_lock);
+		*ionhandle = NULL;
+		return;
+	}
+	mutex_unlock(&gemini_map_lock);
 	ion_unmap_iommu(gemini_client, *ionhandle, CAMERA_DOMAIN, GEN_POOL);
 	ion_free(gemini_client, *ionhandle);
 	*ionhandle = NULL;
@@ -47,12 +101,41 @@ uint32_t msm_gemini_platform_v2p(int fd, uint32_t len, struct file **file_p,
 	unsigned long size;
 	int rc;
 #ifdef CONFIG_MSM_MULTIMEDIA_USE_ION
+	struct gemini_map *map;
+
 	*ionhandle = ion_import_dma_buf(gemini_client, fd);
 	if (IS_ERR_OR_NULL(*ionhandle))
 		return 0;
 
+	mutex_lock(&gemini_map_lock);
+	map = gemini_map_lookup(*ionhandle);
+	if (map) {
+		/*
+		 * Importing a buffer the client already holds returns the
+		 * same handle with one more reference; the cache keeps one.
+		 */
+		ion_free(gemini_client, *ionhandle);
+		paddr = map->paddr;
+		size = map->size;
+		mutex_unlock(&gemini_map_lock);
+		if (len > size) {
+			GMN_PR_ERR("%s: invalid offset + len\n", __func__);
+			return 0;
+		}
+		return paddr;
+	}
+
 	rc = ion_map_iommu(gemini_client, *ionhandle, CAMERA_DOMAIN, GEN_POOL,
 			SZ_4K, 0, &paddr, (unsigned long *)&size, UNCACHED, 0);
+	if (!rc && len <= size) {
+		map = gemini_map_lookup(NULL);
+		if (map) {
+			map->handle = *ionhandle;
+			map->paddr = paddr;
+			map->size = size;
+		}
+	}
+	mutex_unlock(&gemini_map_lock);
 #elif CONFIG_ANDROID_PMEM
 	unsigned long kvstart;
 	rc = get_pmem_file(fd, &paddr, &kvstart, &size, file_p);
@@ -247,6 +330,7 @@ int msm_gemini_platform_release(struct resource *mem, void *base, int irq,
 	iounmap(base);
 	release_mem_region(mem->start, resource_size(mem));
 #ifdef CONFIG_MSM_MULTIMEDIA_USE_ION
+	gemini_map_flush();
 	ion_client_destroy(gemini_client);
 #endif
 	GMN_DBG("%s:%d] success\n", __func__, __LINE__);
@@ -193,6 +193,8 @@ struct msm_frame_buffer {
 	enum v4l2_mbus_pixelcode  pxlcode;
 	enum msm_buffer_state state;
 	int active;
+	/* address of the first plane as programmed into the VFE */
+	uint32_t ch0_paddr;
 };
 
 struct msm_isp_color_fmt {
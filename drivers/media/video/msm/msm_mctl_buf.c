@@ -280,6 +280,27 @@ static int msm_vb2_ops_stop_streaming(struct vb2_queue *q)
 	return 0;
 }
 
+/*
+ * Frames come back from the VFE by address only.  The address is worked
+ * out once per queued buffer here, so the per frame lookups under
+ * vq_irqlock compare a single word instead of walking plane cookies.
+ */
+static uint32_t msm_mctl_buf_ch0_paddr(struct msm_cam_v4l2_dev_inst *pcam_inst,
+				       struct msm_frame_buffer *buf)
+{
+	struct videobuf2_contig_pmem *mem;
+	uint32_t buf_idx = buf->vidbuf.v4l2_buf.index;
+	uint32_t offset;
+
+	mem = vb2_plane_cookie(&buf->vidbuf, 0);
+	if (mem->buffer_type == VIDEOBUF2_MULTIPLE_PLANES)
+		offset = mem->offset.data_offset +
+			pcam_inst->buf_offset[buf_idx][0].data_offset;
+	else
+		offset = mem->offset.sp_off.y_off;
+	return (uint32_t)videobuf2_to_pmem_contig(&buf->vidbuf, 0) + offset;
+}
+
 static void msm_vb2_ops_buf_queue(struct vb2_buffer *vb)
 {
 	struct msm_cam_v4l2_dev_inst *pcam_inst = NULL;
@@ -301,6 +322,7 @@ static void msm_vb2_ops_buf_queue(struct vb2_buffer *vb)
 	D("%s pcam_inst=%p, idx=%d\n", __func__, pcam_inst,
 		vb->v4l2_buf.index);
 	buf = container_of(vb, struct msm_frame_buffer, vidbuf);
+	buf->ch0_paddr = msm_mctl_buf_ch0_paddr(pcam_inst, buf);
 	spin_lock_irqsave(&pcam_inst->vq_irqlock, flags);
 	/* we are returning a buffer to the queue */
 	list_add_tail(&buf->list, &pcam_inst->free_vq);
@@ -372,29 +394,13 @@ struct msm_frame_buffer *msm_mctl_buf_find(
 	struct msm_free_buf *fbuf)
 {
 	struct msm_frame_buffer *buf = NULL, *tmp;
-	uint32_t buf_phyaddr = 0;
 	unsigned long flags = 0;
-	uint32_t buf_idx, offset = 0;
-	struct videobuf2_contig_pmem *mem;
 
 	/* we actually need a list, not a queue */
 	spin_lock_irqsave(&pcam_inst->vq_irqlock, flags);
 	list_for_each_entry_safe(buf, tmp,
 			&pcam_inst->free_vq, list) {
-		buf_idx = buf->vidbuf.v4l2_buf.index;
-		mem = vb2_plane_cookie(&buf->vidbuf, 0);
-		if (mem->buffer_type ==	VIDEOBUF2_MULTIPLE_PLANES)
-			offset = mem->offset.data_offset +
-				pcam_inst->buf_offset[buf_idx][0].data_offset;
-		else
-			offset = mem->offset.sp_off.y_off;
-		buf_phyaddr = (unsigned long)
-				videobuf2_to_pmem_contig(&buf->vidbuf, 0) +
-				offset;
-		D("%s vb_idx=%d,vb_paddr=0x%x ch0=0x%x\n",
-			__func__, buf->vidbuf.v4l2_buf.index,
-			buf_phyaddr, fbuf->ch_paddr[0]);
-		if (fbuf->ch_paddr[0] == buf_phyaddr) {
+		if (fbuf->ch_paddr[0] == buf->ch0_paddr) {
 			if (del_buf)
 				list_del_init(&buf->list);
 			spin_unlock_irqrestore(&pcam_inst->vq_irqlock,
@@ -720,7 +726,6 @@ int msm_mctl_release_free_buf(struct msm_cam_media_controller *pmctl,
 {
 	unsigned long flags = 0;
 	struct msm_frame_buffer *buf = NULL;
-	uint32_t buf_phyaddr = 0;
 	int rc = -EINVAL;
 
 	if (!pcam_inst || !free_buf) {
@@ -731,9 +736,7 @@ int msm_mctl_release_free_buf(struct msm_cam_media_controller *pmctl,
 
 	spin_lock_irqsave(&pcam_inst->vq_irqlock, flags);
 	list_for_each_entry(buf, &pcam_inst->free_vq, list) {
-		buf_phyaddr =
-			(uint32_t) videobuf2_to_pmem_contig(&buf->vidbuf, 0);
-		if (free_buf->ch_paddr[0] == buf_phyaddr) {
+		if (free_buf->ch_paddr[0] == buf->ch0_paddr) {
 			D("%s Return buffer %d and mark it as QUEUED\n",
 				__func__, buf->vidbuf.v4l2_buf.index);
 			buf->state = MSM_BUFFER_STATE_QUEUED;
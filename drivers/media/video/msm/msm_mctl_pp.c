@@ -123,29 +123,13 @@ static int is_buf_in_queue(struct msm_cam_v4l2_device *pcam,
 	struct msm_frame_buffer *buf = NULL, *tmp;
 	struct msm_cam_v4l2_dev_inst *pcam_inst = NULL;
 	unsigned long flags = 0;
-	struct videobuf2_contig_pmem *mem;
-	uint32_t buf_idx, offset = 0;
-	uint32_t buf_phyaddr = 0;
 	int idx;
 	idx = pcam->mctl_node.dev_inst_map[image_mode]->my_index;
 	pcam_inst = pcam->mctl_node.dev_inst[idx];
 	spin_lock_irqsave(&pcam_inst->vq_irqlock, flags);
 	list_for_each_entry_safe(buf, tmp,
 	&pcam_inst->free_vq, list) {
-		buf_idx = buf->vidbuf.v4l2_buf.index;
-		mem = vb2_plane_cookie(&buf->vidbuf, 0);
-		if (mem->buffer_type ==	VIDEOBUF2_MULTIPLE_PLANES)
-			offset = mem->offset.data_offset +
-				pcam_inst->buf_offset[buf_idx][0].data_offset;
-		else
-			offset = mem->offset.sp_off.y_off;
-		buf_phyaddr = (unsigned long)
-			videobuf2_to_pmem_contig(&buf->vidbuf, 0) +
-			offset;
-		D("%s vb_idx=%d,vb_paddr=0x%x ch0=0x%x\n",
-		  __func__, buf->vidbuf.v4l2_buf.index,
-		  buf_phyaddr, fbuf->ch_paddr[0]);
-		if (fbuf->ch_paddr[0] == buf_phyaddr) {
+		if (fbuf->ch_paddr[0] == buf->ch0_paddr) {
 			spin_unlock_irqrestore(&pcam_inst->vq_irqlock, flags);
 			return 1;
 		}
@@ -71,6 +71,7 @@ void vpe_reset_state_variables(void)
 	/* initialize local variables for state control, etc.*/
 	vpe_ctrl->op_mode = 0;
 	vpe_ctrl->state = VPE_STATE_INIT;
+	msm_queue_drain(&vpe_ctrl->pending_q, list_vpe_frame);
 }
 
 static void vpe_config_axi_default(void)
@@ -463,7 +464,7 @@ static void vpe_send_outmsg(void)
 {
 	unsigned long flags;
 	struct v4l2_event v4l2_evt;
-	struct msm_queue_cmd *event_qcmd;
+	struct msm_queue_cmd *event_qcmd, *next;
 	spin_lock_irqsave(&vpe_ctrl->lock, flags);
 	if (vpe_ctrl->state == VPE_STATE_IDLE) {
 		pr_err("%s VPE is in IDLE state. Ignore the ack msg", __func__);
@@ -479,7 +480,18 @@ static void vpe_send_outmsg(void)
 	atomic_set(&event_qcmd->on_heap, 1);
 	event_qcmd->command = (void *)vpe_ctrl->pp_frame_info;
 	vpe_ctrl->pp_frame_info = NULL;
-	vpe_ctrl->state = VPE_STATE_INIT;   /* put it back to idle. */
+
+	/*
+	 * Hand the engine straight to the next queued job; it stays
+	 * ACTIVE so that a new ZOOM command queues behind it.
+	 */
+	next = msm_dequeue(&vpe_ctrl->pending_q, list_vpe_frame);
+	if (next) {
+		vpe_ctrl->pp_frame_info = next->command;
+		free_qcmd(next);
+	} else {
+		vpe_ctrl->state = VPE_STATE_INIT; /* put it back to idle. */
+	}
 
 	/* Enqueue the event payload. */
 	msm_enqueue(&vpe_ctrl->eventData_q, &event_qcmd->list_eventdata);
@@ -489,6 +501,11 @@ static void vpe_send_outmsg(void)
 	v4l2_event_queue(vpe_ctrl->subdev.devnode, &v4l2_evt);
 
 	spin_unlock_irqrestore(&vpe_ctrl->lock, flags);
+
+	if (next) {
+		msm_vpe_cfg_update(&vpe_ctrl->pp_frame_info->pp_frame_cmd.crop);
+		msm_send_frame_to_vpe();
+	}
 }
 
 static void vpe_do_tasklet(unsigned long data)
@@ -573,6 +590,7 @@ int vpe_disable(void)
 
 	disable_irq(vpe_ctrl->vpeirq->start);
 	tasklet_kill(&vpe_tasklet);
+	msm_queue_drain(&vpe_ctrl->pending_q, list_vpe_frame);
 	msm_cam_clk_enable(&vpe_ctrl->pdev->dev, vpe_clk_info,
 			vpe_ctrl->vpe_clk, ARRAY_SIZE(vpe_clk_info), 0);
 
@@ -587,15 +605,41 @@ static int msm_vpe_do_pp(struct msm_mctl_pp_frame_info *pp_frame_info)
 {
 	int rc = 0;
 	unsigned long flags;
+	struct msm_queue_cmd *qcmd;
 
 	spin_lock_irqsave(&vpe_ctrl->lock, flags);
-	if (vpe_ctrl->state == VPE_STATE_ACTIVE ||
-		 vpe_ctrl->state == VPE_STATE_IDLE) {
+	if (vpe_ctrl->state == VPE_STATE_IDLE) {
 		spin_unlock_irqrestore(&vpe_ctrl->lock, flags);
 		pr_err(" =====VPE in wrong state:%d!!!  Wrong!========\n",
 		vpe_ctrl->state);
 		return -EBUSY;
 	}
+	if (vpe_ctrl->state == VPE_STATE_ACTIVE) {
+		/*
+		 * Queue the job behind the one in flight, the tasklet
+		 * starts it as soon as the engine is done; its ack event
+		 * follows in submission order.
+		 */
+		if (vpe_ctrl->pending_q.len >= VPE_MAX_PENDING) {
+			spin_unlock_irqrestore(&vpe_ctrl->lock, flags);
+			return -EBUSY;
+		}
+		qcmd = kzalloc(sizeof(struct msm_queue_cmd), GFP_ATOMIC);
+		if (!qcmd) {
+			spin_unlock_irqrestore(&vpe_ctrl->lock, flags);
+			return -ENOMEM;
+		}
+		atomic_set(&qcmd->on_heap, 1);
+		qcmd->command = pp_frame_info;
+		msm_enqueue(&vpe_ctrl->pending_q, &qcmd->list_vpe_frame);
+		spin_unlock_irqrestore(&vpe_ctrl->lock, flags);
+		D("%s Queued frame idx %d id %d for VPE ", __func__,
+			pp_frame_info->src_frame.buf_idx,
+			pp_frame_info->src_frame.frame_id);
+		return 0;
+	}
+	/* claim the engine so that a concurrent job queues behind us */
+	vpe_ctrl->state = VPE_STATE_ACTIVE;
 	spin_unlock_irqrestore(&vpe_ctrl->lock, flags);
 	vpe_ctrl->pp_frame_info = pp_frame_info;
 	msm_vpe_cfg_update(
@@ -806,6 +850,8 @@ static int msm_vpe_process_vpe_cmd(struct msm_vpe_cfg_cmd *vpe_cmd)
 			break;
 		}
 		rc = msm_vpe_do_pp(zoom);
+		if (rc < 0)
+			kfree(zoom);
 		break;
 		}
 
@@ -956,6 +1002,7 @@ static int msm_vpe_subdev_close(struct v4l2_subdev *sd,
 	D("%s E ", __func__);
 	/* Drain the payload queue. */
 	msm_queue_drain(&vpe_ctrl->eventData_q, list_eventdata);
+	msm_queue_drain(&vpe_ctrl->pending_q, list_vpe_frame);
 	atomic_dec(&vpe_ctrl->active);
 	return 0;
 }
@@ -1041,6 +1088,7 @@ static int __devinit msm_vpe_probe(struct platform_device *pdev)
 	msm_cam_register_subdev_node(&vpe_ctrl->subdev, &sd_info);
 	vpe_ctrl->subdev.entity.revision = vpe_ctrl->subdev.devnode->num;
 	msm_queue_init(&vpe_ctrl->eventData_q, "ackevents");
+	msm_queue_init(&vpe_ctrl->pending_q, "pendingjobs");
 
 	return 0;
 
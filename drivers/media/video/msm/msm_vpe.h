@@ -81,6 +81,8 @@
 #define VPE_NORMAL_MODE_CLOCK_RATE   150000000
 #define VPE_TURBO_MODE_CLOCK_RATE    200000000
 #define VPE_SUBDEV_MAX_EVENTS        30
+/* jobs queued behind the one in flight */
+#define VPE_MAX_PENDING              8
 
 /**************************************************/
 /*********** End of command id ********************/
@@ -121,6 +123,7 @@ struct vpe_ctrl_type {
 	struct msm_mctl_pp_frame_info *pp_frame_info;
 	atomic_t active;
 	struct msm_device_queue eventData_q; /*V4L2 Event Payload Queue*/
+	struct msm_device_queue pending_q; /* jobs waiting for the engine */
 };
 
 /*
@@ -18,6 +18,7 @@
 #include <linux/atomic.h>
 #include <linux/regulator/consumer.h>
 #include <linux/clk.h>
+#include <linux/sched.h>
 #include <mach/irqs.h>
 #include <mach/camera.h>
 #include <media/v4l2-device.h>
@@ -28,6 +29,9 @@
 #include "msm_cam_server.h"
 #include "msm_vfe32.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/msm_vfe.h>
+
 atomic_t irq_cnt;
 
 #define VFE32_AXI_OFFSET 0x0050
@@ -53,12 +57,11 @@ static uint32_t vfe_clk_rate;
 static void vfe32_send_isp_msg(struct v4l2_subdev *sd,
 	uint32_t vfeFrameId, uint32_t isp_msg_id);
 
-
-struct vfe32_isr_queue_cmd {
-	struct list_head list;
-	uint32_t                           vfeInterruptStatus0;
-	uint32_t                           vfeInterruptStatus1;
-};
+/*
+ * Below the irq threads of the other drivers (MAX_USER_RT_PRIO / 2), so
+ * touch and audio interrupts are not held up by camera events.
+ */
+#define VFE32_IRQ_THREAD_PRIO (MAX_USER_RT_PRIO / 2 - 1)
 
 static struct vfe32_cmd_type vfe32_cmd[] = {
 /* 0*/	{VFE_CMD_DUMMY_0},
@@ -3512,6 +3515,8 @@ static void vfe_send_outmsg(
 	msg.buf.ch_paddr[2]	= ch2_paddr;
 	msg.frameCounter = axi_ctrl->share_ctrl->vfeFrameId;
 
+	trace_msm_vfe_frame_out(msgid, msg.frameCounter, ch0_paddr,
+		ktime_us_delta(ktime_get(), axi_ctrl->irq_time));
 	v4l2_subdev_notify(&axi_ctrl->subdev,
 			NOTIFY_VFE_MSG_OUT,
 			&msg);
@@ -4315,31 +4320,39 @@ static void vfe32_process_irq(
 	}
 }
 
-static void axi32_do_tasklet(unsigned long data)
+/*
+ * Runs in the irq thread.  Everything queued since the last wakeup is
+ * handled in one go; the queue entries are only copied out under the
+ * lock so the hard irq handler can keep adding to the queue meanwhile.
+ */
+static void axi32_do_irq_work(struct kthread_work *work)
 {
 	unsigned long flags;
-	struct axi_ctrl_t *axi_ctrl = (struct axi_ctrl_t *)data;
+	struct axi_ctrl_t *axi_ctrl = container_of(work, struct axi_ctrl_t,
+		irq_work);
 	struct vfe32_ctrl_type *vfe32_ctrl = axi_ctrl->share_ctrl->vfe32_ctrl;
-	struct vfe32_isr_queue_cmd *qcmd = NULL;
+	struct vfe32_isr_queue_cmd cmd, *qcmd = &cmd;
 	int stat_interrupt;
+	int batch = 0;
+	ktime_t start;
 
-	CDBG("=== axi32_do_tasklet start ===\n");
+	CDBG("=== axi32_do_irq_work start ===\n");
 
-	while (atomic_read(&irq_cnt)) {
-		spin_lock_irqsave(&axi_ctrl->tasklet_lock, flags);
-		qcmd = list_first_entry(&axi_ctrl->tasklet_q,
-			struct vfe32_isr_queue_cmd, list);
-		atomic_sub(1, &irq_cnt);
-
-		if (!qcmd) {
-			spin_unlock_irqrestore(&axi_ctrl->tasklet_lock,
-				flags);
-			return;
+	for (;;) {
+		spin_lock_irqsave(&axi_ctrl->irq_q_lock, flags);
+		if (axi_ctrl->irq_q_head == axi_ctrl->irq_q_tail) {
+			spin_unlock_irqrestore(&axi_ctrl->irq_q_lock, flags);
+			break;
 		}
+		cmd = axi_ctrl->irq_q[axi_ctrl->irq_q_tail &
+			(VFE32_IRQ_QUEUE_SIZE - 1)];
+		axi_ctrl->irq_q_tail++;
+		atomic_sub(1, &irq_cnt);
+		spin_unlock_irqrestore(&axi_ctrl->irq_q_lock, flags);
 
-		list_del(&qcmd->list);
-		spin_unlock_irqrestore(&axi_ctrl->tasklet_lock,
-			flags);
+		start = ktime_get();
+		axi_ctrl->irq_time = qcmd->irq_time;
+		batch++;
 
 		if (axi_ctrl->share_ctrl->stats_comp) {
 			stat_interrupt = (qcmd->vfeInterruptStatus0 &
@@ -4481,9 +4494,13 @@ static void axi32_do_tasklet(unsigned long data)
 			}
 		}
 		vfe32_ctrl->simultaneous_sof_stat = 0;
-		kfree(qcmd);
+		trace_msm_vfe_irq_handled(qcmd->vfeInterruptStatus0,
+			qcmd->vfeInterruptStatus1,
+			ktime_us_delta(start, qcmd->irq_time),
+			ktime_us_delta(ktime_get(), start));
 	}
-	CDBG("=== axi32_do_tasklet end ===\n");
+	trace_msm_vfe_batch(batch);
+	CDBG("=== axi32_do_irq_work end ===\n");
 }
 
 static irqreturn_t vfe32_parse_irq(int irq_num, void *data)
@@ -4492,6 +4509,8 @@ static irqreturn_t vfe32_parse_irq(int irq_num, void *data)
 	struct vfe32_irq_status irq;
 	struct vfe32_isr_queue_cmd *qcmd;
 	struct axi_ctrl_t *axi_ctrl = data;
+	ktime_t now = ktime_get();
+	uint32_t pending;
 
 	CDBG("vfe_parse_irq\n");
 
@@ -4502,13 +4521,6 @@ static irqreturn_t vfe32_parse_irq(int irq_num, void *data)
 		return IRQ_HANDLED;
 	}
 
-	qcmd = kzalloc(sizeof(struct vfe32_isr_queue_cmd),
-		GFP_ATOMIC);
-	if (!qcmd) {
-		pr_err("vfe_parse_irq: qcmd malloc failed!\n");
-		return IRQ_HANDLED;
-	}
-
 	spin_lock_irqsave(&axi_ctrl->share_ctrl->stop_flag_lock, flags);
 	if (axi_ctrl->share_ctrl->stop_ack_pending) {
 		irq.vfeIrqStatus0 &= VFE_IMASK_WHILE_STOPPING_0;
@@ -4519,15 +4531,28 @@ static irqreturn_t vfe32_parse_irq(int irq_num, void *data)
 	CDBG("vfe_parse_irq: Irq_status0 = 0x%x, Irq_status1 = 0x%x.\n",
 		irq.vfeIrqStatus0, irq.vfeIrqStatus1);
 
-	qcmd->vfeInterruptStatus0 = irq.vfeIrqStatus0;
-	qcmd->vfeInterruptStatus1 = irq.vfeIrqStatus1;
-
-	spin_lock_irqsave(&axi_ctrl->tasklet_lock, flags);
-	list_add_tail(&qcmd->list, &axi_ctrl->tasklet_q);
-
-	atomic_add(1, &irq_cnt);
-	spin_unlock_irqrestore(&axi_ctrl->tasklet_lock, flags);
-	tasklet_schedule(&axi_ctrl->vfe32_tasklet);
+	spin_lock_irqsave(&axi_ctrl->irq_q_lock, flags);
+	pending = axi_ctrl->irq_q_head - axi_ctrl->irq_q_tail;
+	if (pending == VFE32_IRQ_QUEUE_SIZE) {
+		/* the thread is far behind, fold into the newest entry */
+		qcmd = &axi_ctrl->irq_q[(axi_ctrl->irq_q_head - 1) &
+			(VFE32_IRQ_QUEUE_SIZE - 1)];
+		qcmd->vfeInterruptStatus0 |= irq.vfeIrqStatus0;
+		qcmd->vfeInterruptStatus1 |= irq.vfeIrqStatus1;
+	} else {
+		qcmd = &axi_ctrl->irq_q[axi_ctrl->irq_q_head &
+			(VFE32_IRQ_QUEUE_SIZE - 1)];
+		qcmd->vfeInterruptStatus0 = irq.vfeIrqStatus0;
+		qcmd->vfeInterruptStatus1 = irq.vfeIrqStatus1;
+		qcmd->irq_time = now;
+		axi_ctrl->irq_q_head++;
+		atomic_add(1, &irq_cnt);
+		pending++;
+	}
+	spin_unlock_irqrestore(&axi_ctrl->irq_q_lock, flags);
+
+	trace_msm_vfe_irq(irq.vfeIrqStatus0, irq.vfeIrqStatus1, pending);
+	queue_kthread_work(&axi_ctrl->irq_worker, &axi_ctrl->irq_work);
 	return IRQ_HANDLED;
 }
 
@@ -4865,8 +4890,9 @@ int msm_axi_subdev_init(struct v4l2_subdev *sd)
 		rc = -EINVAL;
 		goto mctl_failed;
 	}
-	spin_lock_init(&axi_ctrl->tasklet_lock);
-	INIT_LIST_HEAD(&axi_ctrl->tasklet_q);
+	spin_lock_init(&axi_ctrl->irq_q_lock);
+	axi_ctrl->irq_q_head = 0;
+	axi_ctrl->irq_q_tail = 0;
 	spin_lock_init(&axi_ctrl->share_ctrl->sd_notify_lock);
 
 	axi_ctrl->share_ctrl->vfebase = ioremap(axi_ctrl->vfemem->start,
@@ -4955,7 +4981,7 @@ void msm_axi_subdev_release(struct v4l2_subdev *sd)
 
 	CDBG("%s, free_irq\n", __func__);
 	disable_irq(axi_ctrl->vfeirq->start);
-	tasklet_kill(&axi_ctrl->vfe32_tasklet);
+	flush_kthread_worker(&axi_ctrl->irq_worker);
 	msm_cam_clk_enable(&axi_ctrl->pdev->dev, vfe32_clk_info,
 			axi_ctrl->vfe_clk, ARRAY_SIZE(vfe32_clk_info), 0);
 	if (axi_ctrl->fs_vfe)
@@ -5916,6 +5942,9 @@ static int __devinit vfe32_probe(struct platform_device *pdev)
 	struct vfe_share_ctrl_t *share_ctrl;
 	struct intr_table_entry irq_req;
 	struct msm_cam_subdev_info sd_info;
+	struct sched_param irq_param = {
+		.sched_priority = VFE32_IRQ_THREAD_PRIO,
+	};
 
 	CDBG("%s: device id = %d\n", __func__, pdev->id);
 
@@ -6022,6 +6051,19 @@ static int __devinit vfe32_probe(struct platform_device *pdev)
 	 * the IRQ Router hardware is not present on this target. We
 	 * have to request for the irq ourselves and register the
 	 * appropriate interrupt handler. */
+	init_kthread_worker(&axi_ctrl->irq_worker);
+	init_kthread_work(&axi_ctrl->irq_work, axi32_do_irq_work);
+	axi_ctrl->irq_thread = kthread_run(kthread_worker_fn,
+		&axi_ctrl->irq_worker, "vfe32_irq");
+	if (IS_ERR(axi_ctrl->irq_thread)) {
+		pr_err("%s: irq thread creation failed\n", __func__);
+		rc = PTR_ERR(axi_ctrl->irq_thread);
+		release_mem_region(axi_ctrl->vfemem->start,
+			resource_size(axi_ctrl->vfemem));
+		goto vfe32_no_resource;
+	}
+	sched_setscheduler(axi_ctrl->irq_thread, SCHED_FIFO, &irq_param);
+
 	irq_req.cam_hw_idx       = MSM_CAM_HW_VFE0;
 	irq_req.dev_name         = "vfe";
 	irq_req.irq_idx          = CAMERA_SS_IRQ_8;
@@ -6041,18 +6083,17 @@ static int __devinit vfe32_probe(struct platform_device *pdev)
 			release_mem_region(axi_ctrl->vfemem->start,
 				resource_size(axi_ctrl->vfemem));
 			pr_err("%s: irq request fail\n", __func__);
+			kthread_stop(axi_ctrl->irq_thread);
 			rc = -EBUSY;
 			goto vfe32_no_resource;
 		}
 		disable_irq(axi_ctrl->vfeirq->start);
 	} else if (rc < 0) {
 		pr_err("%s Error registering irq ", __func__);
+		kthread_stop(axi_ctrl->irq_thread);
 		goto vfe32_no_resource;
 	}
 
-	tasklet_init(&axi_ctrl->vfe32_tasklet,
-		axi32_do_tasklet, (unsigned long)axi_ctrl);
-
 	vfe32_ctrl->pdev = pdev;
 	/*disable bayer stats by default*/
 	vfe32_ctrl->ver_num.main = 0;
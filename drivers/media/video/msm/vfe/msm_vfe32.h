@@ -14,6 +14,8 @@
 #define __MSM_VFE32_H__
 
 #include <linux/bitops.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
 #include "msm_vfe_stats_buf.h"
 
 #define TRUE  1
@@ -974,12 +976,25 @@ struct vfe_share_ctrl_t {
 	atomic_t rdi2_update_ack_pending;
 };
 
+/* interrupts waiting for the irq thread, must be a power of two */
+#define VFE32_IRQ_QUEUE_SIZE 16
+
+struct vfe32_isr_queue_cmd {
+	uint32_t                           vfeInterruptStatus0;
+	uint32_t                           vfeInterruptStatus1;
+	ktime_t                            irq_time;
+};
+
 struct axi_ctrl_t {
 	struct v4l2_subdev subdev;
 	struct platform_device *pdev;
 	struct resource *vfeirq;
-	spinlock_t  tasklet_lock;
-	struct list_head tasklet_q;
+	spinlock_t  irq_q_lock;
+	struct vfe32_isr_queue_cmd irq_q[VFE32_IRQ_QUEUE_SIZE];
+	uint32_t irq_q_head;
+	uint32_t irq_q_tail;
+	/* hard irq time of the interrupt being handled by the irq thread */
+	ktime_t irq_time;
 
 	void *syncdata;
 
@@ -987,7 +1002,9 @@ struct axi_ctrl_t {
 	struct resource *vfeio;
 	struct regulator *fs_vfe;
 	struct clk *vfe_clk[3];
-	struct tasklet_struct vfe32_tasklet;
+	struct kthread_worker irq_worker;
+	struct kthread_work irq_work;
+	struct task_struct *irq_thread;
 	struct vfe_share_ctrl_t *share_ctrl;
 };
 
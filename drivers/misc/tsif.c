@@ -1284,7 +1284,7 @@ static struct msm_tsif_device *tsif_find_by_id(int id)
 	return NULL;
 }
 
-static int __devinit msm_tsif_probe(struct platform_device *pdev)
+static int msm_tsif_probe(struct platform_device *pdev)
 {
 	int rc = -ENODEV;
 	struct msm_tsif_platform_data *plat = pdev->dev.platform_data;
@@ -1437,7 +1437,7 @@ static struct platform_driver msm_tsif_driver = {
 	},
 };
 
-static int __init mod_init(void)
+static int mod_init(void)
 {
 	int rc = platform_driver_register(&msm_tsif_driver);
 	if (rc)
@@ -1594,7 +1594,7 @@ void tsif_reclaim_packets(void *cookie, int read_index)
 }
 EXPORT_SYMBOL(tsif_reclaim_packets);
 
-module_init(mod_init);
+deferred_module_init(mod_init);
 module_exit(mod_exit);
 
 MODULE_DESCRIPTION("TSIF (Transport Stream Interface)"
@@ -183,7 +183,7 @@ static void tsif_exit_one(struct tsif_chrdev *the_dev)
 
 struct tsif_chrdev the_devices[TSIF_NUM_DEVS];
 
-static int __init mod_init(void)
+static int mod_init(void)
 {
 	int rc;
 	int instance;
@@ -222,7 +222,7 @@ static void __exit mod_exit(void)
 	unregister_chrdev_region(tsif_dev, TSIF_NUM_DEVS);
 }
 
-module_init(mod_init);
+deferred_module_init(mod_init);
 module_exit(mod_exit);
 
 MODULE_DESCRIPTION("TSIF character device interface");
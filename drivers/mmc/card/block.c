@@ -121,6 +121,7 @@ struct mmc_blk_data {
 	struct device_attribute power_ro_lock;
 	int	area_type;
 	struct device_attribute num_wr_reqs_to_start_packing;
+	struct device_attribute bkops_idle_ms;
 };
 
 static DEFINE_MUTEX(open_lock);
@@ -305,6 +306,33 @@ num_wr_reqs_to_start_packing_store(struct device *dev,
 	return count;
 }
 
+static ssize_t
+bkops_idle_ms_show(struct device *dev, struct device_attribute *attr,
+		   char *buf)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	int ret;
+
+	ret = snprintf(buf, PAGE_SIZE, "%u\n", md->queue.idle_bkops_ms);
+
+	mmc_blk_put(md);
+	return ret;
+}
+
+static ssize_t
+bkops_idle_ms_store(struct device *dev, struct device_attribute *attr,
+		    const char *buf, size_t count)
+{
+	unsigned int value;
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+
+	if (sscanf(buf, "%u", &value) == 1)
+		md->queue.idle_bkops_ms = value;
+
+	mmc_blk_put(md);
+	return count;
+}
+
 static int mmc_blk_open(struct block_device *bdev, fmode_t mode)
 {
 	struct mmc_blk_data *md = mmc_blk_get(bdev->bd_disk);
@@ -857,12 +885,39 @@ static inline void mmc_blk_reset_success(struct mmc_blk_data *md, int type)
 	md->reset_done &= ~type;
 }
 
+/*
+ * Take the next queued request off the queue if it is a plain discard
+ * directly following sector @end and the combined erase stays within
+ * the queue's discard limit.
+ */
+static struct request *mmc_blk_next_discard(struct mmc_queue *mq,
+					    unsigned int end, unsigned int nr)
+{
+	struct request_queue *q = mq->queue;
+	struct request *next;
+
+	spin_lock_irq(q->queue_lock);
+	next = blk_peek_request(q);
+	if (next && (next->cmd_flags & REQ_DISCARD) &&
+	    !(next->cmd_flags & (REQ_SECURE | REQ_SANITIZE)) &&
+	    blk_rq_pos(next) == end &&
+	    nr + blk_rq_sectors(next) <= q->limits.max_discard_sectors)
+		blk_start_request(next);
+	else
+		next = NULL;
+	spin_unlock_irq(q->queue_lock);
+
+	return next;
+}
+
 static int mmc_blk_issue_discard_rq(struct mmc_queue *mq, struct request *req)
 {
 	struct mmc_blk_data *md = mq->data;
 	struct mmc_card *card = md->queue.card;
 	unsigned int from, nr, arg;
 	int err = 0, type = MMC_BLK_DISCARD;
+	struct request *next;
+	LIST_HEAD(batch);
 
 	if (!mmc_can_erase(card)) {
 		err = -EOPNOTSUPP;
@@ -872,6 +927,12 @@ static int mmc_blk_issue_discard_rq(struct mmc_queue *mq, struct request *req)
 	from = blk_rq_pos(req);
 	nr = blk_rq_sectors(req);
 
+	/* Erase contiguous discards queued behind this one in one go */
+	while ((next = mmc_blk_next_discard(mq, from + nr, nr))) {
+		list_add_tail(&next->queuelist, &batch);
+		nr += blk_rq_sectors(next);
+	}
+
 	if (mmc_can_discard(card))
 		arg = MMC_DISCARD_ARG;
 	else if (mmc_can_trim(card))
@@ -896,6 +957,11 @@ out:
 	if (!err)
 		mmc_blk_reset_success(md, type);
 	blk_end_request(req, err, blk_rq_bytes(req));
+	while (!list_empty(&batch)) {
+		next = list_entry_rq(batch.next);
+		list_del_init(&next->queuelist);
+		blk_end_request(next, err, blk_rq_bytes(next));
+	}
 
 	return err ? 0 : 1;
 }
@@ -1349,8 +1415,8 @@ static void mmc_blk_rw_rq_prep(struct mmc_queue_req *mqrq,
 	mmc_queue_bounce_pre(mqrq);
 }
 
-static void mmc_blk_write_packing_control(struct mmc_queue *mq,
-					  struct request *req)
+static void __mmc_blk_write_packing_control(struct mmc_queue *mq,
+					    struct request *req)
 {
 	struct mmc_host *host = mq->card->host;
 	int data_dir;
@@ -1396,6 +1462,23 @@ static void mmc_blk_write_packing_control(struct mmc_queue *mq,
 
 }
 
+static void mmc_blk_write_packing_control(struct mmc_queue *mq,
+					  struct request *req)
+{
+	struct request_queue *q = mq->queue;
+	bool was_enabled = mq->wr_packing_enabled;
+
+	__mmc_blk_write_packing_control(mq, req);
+
+	/* Let the I/O scheduler hand us writes in packable groups */
+	if (mq->wr_packing_enabled != was_enabled) {
+		spin_lock_irq(q->queue_lock);
+		elv_pack_hint(q, mq->wr_packing_enabled ?
+			      mq->card->ext_csd.max_packed_writes : 0);
+		spin_unlock_irq(q->queue_lock);
+	}
+}
+
 struct mmc_wr_pack_stats *mmc_blk_get_packed_statistics(struct mmc_card *card)
 {
 	if (!card)
@@ -1788,8 +1871,11 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 		} else
 			areq = NULL;
 		areq = mmc_start_req(card->host, areq, (int *) &status);
-		if (!areq)
+		if (!areq) {
+			if (status == MMC_BLK_NEW_REQUEST)
+				mq->flags |= MMC_QUEUE_NEW_REQUEST;
 			return 0;
+		}
 
 		mq_rq = container_of(areq, struct mmc_queue_req, mmc_active);
 		brq = &mq_rq->brq;
@@ -1948,6 +2034,7 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 	int ret;
 	struct mmc_blk_data *md = mq->data;
 	struct mmc_card *card = md->queue.card;
+	unsigned long flags;
 
 #ifdef CONFIG_MMC_BLOCK_DEFERRED_RESUME
 	if (mmc_bus_needs_resume(card->host)) {
@@ -1990,11 +2077,18 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 			mmc_blk_issue_rw_rq(mq, NULL);
 		ret = mmc_blk_issue_flush(mq, req);
 	} else {
+		if (!req && card->host->areq) {
+			spin_lock_irqsave(&card->host->context_info.lock,
+					  flags);
+			card->host->context_info.is_waiting_last_req = true;
+			spin_unlock_irqrestore(&card->host->context_info.lock,
+					       flags);
+		}
 		ret = mmc_blk_issue_rw_rq(mq, req);
 	}
 
 out:
-	if (!req)
+	if (!req && !(mq->flags & MMC_QUEUE_NEW_REQUEST))
 		/* release host only when there are no more requests */
 		mmc_release_host(card->host);
 	return ret;
@@ -2204,6 +2298,7 @@ static void mmc_blk_remove_req(struct mmc_blk_data *md)
 		card = md->queue.card;
 		device_remove_file(disk_to_dev(md->disk),
 				   &md->num_wr_reqs_to_start_packing);
+		device_remove_file(disk_to_dev(md->disk), &md->bkops_idle_ms);
 		if (md->disk->flags & GENHD_FL_UP) {
 			device_remove_file(disk_to_dev(md->disk), &md->force_ro);
 			if ((md->area_type & MMC_BLK_DATA_AREA_BOOT) &&
@@ -2284,8 +2379,20 @@ static int mmc_add_disk(struct mmc_blk_data *md)
 	if (ret)
 		goto power_ro_lock_fail;
 
+	md->bkops_idle_ms.show = bkops_idle_ms_show;
+	md->bkops_idle_ms.store = bkops_idle_ms_store;
+	sysfs_attr_init(&md->bkops_idle_ms.attr);
+	md->bkops_idle_ms.attr.name = "bkops_idle_ms";
+	md->bkops_idle_ms.attr.mode = S_IRUGO | S_IWUSR;
+	ret = device_create_file(disk_to_dev(md->disk), &md->bkops_idle_ms);
+	if (ret)
+		goto bkops_idle_fail;
+
 	return ret;
 
+bkops_idle_fail:
+		device_remove_file(disk_to_dev(md->disk),
+				   &md->num_wr_reqs_to_start_packing);
 power_ro_lock_fail:
 		device_remove_file(disk_to_dev(md->disk), &md->force_ro);
 force_ro_fail:
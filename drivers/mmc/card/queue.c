@@ -22,8 +22,6 @@
 
 #define MMC_QUEUE_BOUNCESZ	65536
 
-#define MMC_QUEUE_SUSPENDED	(1 << 0)
-
 /*
  * Based on benchmark tests the default num of requests to trigger the write
  * packing was determined, to keep the read latency as low as possible and
@@ -31,6 +29,12 @@
  */
 #define DEFAULT_NUM_REQS_TO_START_PACK 17
 
+/*
+ * Time the queue has to stay empty, with the screen off, before the card
+ * is told to run its background operations.
+ */
+#define DEFAULT_IDLE_BKOPS_MS 2000
+
 /*
  * Prepare a MMC request. This just filters out odd stuff.
  */
@@ -54,6 +58,62 @@ static int mmc_prep_request(struct request_queue *q, struct request *req)
 	return BLKPREP_OK;
 }
 
+/*
+ * Start the idle timer when the queue runs empty.  The timer is not
+ * pushed back by spurious wakeups, only cancelled when requests arrive.
+ * Only the queue thread arms and disarms it.
+ */
+static void mmc_queue_arm_idle(struct mmc_queue *mq)
+{
+	if (!mq->idle_bkops_ms || !mq->screen_off || mq->idle_armed)
+		return;
+
+	mq->idle_armed = true;
+	schedule_delayed_work(&mq->idle_work,
+			      msecs_to_jiffies(mq->idle_bkops_ms));
+}
+
+static void mmc_queue_disarm_idle(struct mmc_queue *mq)
+{
+	if (!mq->idle_armed)
+		return;
+
+	mq->idle_armed = false;
+	/* wait for a BKOPS start in progress, so it can be interrupted */
+	cancel_delayed_work_sync(&mq->idle_work);
+}
+
+static void mmc_queue_idle_work(struct work_struct *work)
+{
+	struct mmc_queue *mq = container_of(to_delayed_work(work),
+					    struct mmc_queue, idle_work);
+
+	if (!mq->screen_off || (mq->flags & MMC_QUEUE_SUSPENDED))
+		return;
+
+	mmc_start_idle_bkops(mq->card);
+}
+
+#ifdef CONFIG_HAS_EARLYSUSPEND
+static void mmc_queue_early_suspend(struct early_suspend *h)
+{
+	struct mmc_queue *mq = container_of(h, struct mmc_queue,
+					    early_suspend);
+
+	mq->screen_off = true;
+	/* the queue may already be idle, let the thread arm the timer */
+	wake_up_process(mq->thread);
+}
+
+static void mmc_queue_late_resume(struct early_suspend *h)
+{
+	struct mmc_queue *mq = container_of(h, struct mmc_queue,
+					    early_suspend);
+
+	mq->screen_off = false;
+}
+#endif
+
 static int mmc_queue_thread(void *d)
 {
 	struct mmc_queue *mq = d;
@@ -74,11 +134,22 @@ static int mmc_queue_thread(void *d)
 		spin_unlock_irq(q->queue_lock);
 
 		if (req || mq->mqrq_prev->req) {
+			set_current_state(TASK_RUNNING);
+
+			mmc_queue_disarm_idle(mq);
 			if (mmc_card_doing_bkops(mq->card))
 				mmc_interrupt_bkops(mq->card);
 
-			set_current_state(TASK_RUNNING);
 			mq->issue_fn(mq, req);
+			if (mq->flags & MMC_QUEUE_NEW_REQUEST) {
+				/*
+				 * A request arrived while the last one was
+				 * still in flight: fetch and prepare it now,
+				 * the in-flight request stays previous.
+				 */
+				mq->flags &= ~MMC_QUEUE_NEW_REQUEST;
+				continue;
+			}
 		} else {
 			if (kthread_should_stop()) {
 				set_current_state(TASK_RUNNING);
@@ -86,6 +157,7 @@ static int mmc_queue_thread(void *d)
 			}
 
 			mmc_start_bkops(mq->card);
+			mmc_queue_arm_idle(mq);
 			up(&mq->thread_sem);
 			schedule();
 			down(&mq->thread_sem);
@@ -112,7 +184,9 @@ static int mmc_queue_thread(void *d)
 static void mmc_request(struct request_queue *q)
 {
 	struct mmc_queue *mq = q->queuedata;
+	struct mmc_context_info *cntx;
 	struct request *req;
+	unsigned long flags;
 
 	if (!mq) {
 		while ((req = blk_fetch_request(q)) != NULL) {
@@ -122,7 +196,20 @@ static void mmc_request(struct request_queue *q)
 		return;
 	}
 
-	if (!mq->mqrq_cur->req && !mq->mqrq_prev->req)
+	cntx = &mq->card->host->context_info;
+	if (!mq->mqrq_cur->req && mq->mqrq_prev->req) {
+		/*
+		 * The thread may be waiting for the last in-flight request
+		 * with nothing fetched behind it; let it prepare this one
+		 * while the transfer is still running.
+		 */
+		spin_lock_irqsave(&cntx->lock, flags);
+		if (cntx->is_waiting_last_req) {
+			cntx->is_new_req = true;
+			wake_up_interruptible(&cntx->wait);
+		}
+		spin_unlock_irqrestore(&cntx->lock, flags);
+	} else if (!mq->mqrq_cur->req && !mq->mqrq_prev->req)
 		wake_up_process(mq->thread);
 }
 
@@ -201,6 +288,10 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
 	mq->mqrq_prev = mqrq_prev;
 	mq->queue->queuedata = mq;
 	mq->num_wr_reqs_to_start_packing = DEFAULT_NUM_REQS_TO_START_PACK;
+	mq->idle_bkops_ms = DEFAULT_IDLE_BKOPS_MS;
+	INIT_DELAYED_WORK(&mq->idle_work, mmc_queue_idle_work);
+	/* without screen state, idle time alone triggers maintenance */
+	mq->screen_off = !IS_ENABLED(CONFIG_HAS_EARLYSUSPEND);
 
 	blk_queue_prep_rq(mq->queue, mmc_prep_request);
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, mq->queue);
@@ -294,6 +385,13 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
 		goto free_bounce_sg;
 	}
 
+#ifdef CONFIG_HAS_EARLYSUSPEND
+	mq->early_suspend.level = EARLY_SUSPEND_LEVEL_BLANK_SCREEN;
+	mq->early_suspend.suspend = mmc_queue_early_suspend;
+	mq->early_suspend.resume = mmc_queue_late_resume;
+	register_early_suspend(&mq->early_suspend);
+#endif
+
 	return 0;
  free_bounce_sg:
 	kfree(mqrq_cur->bounce_sg);
@@ -326,8 +424,13 @@ void mmc_cleanup_queue(struct mmc_queue *mq)
 	/* Make sure the queue isn't suspended, as that will deadlock */
 	mmc_queue_resume(mq);
 
+#ifdef CONFIG_HAS_EARLYSUSPEND
+	unregister_early_suspend(&mq->early_suspend);
+#endif
+
 	/* Then terminate our worker thread */
 	kthread_stop(mq->thread);
+	cancel_delayed_work_sync(&mq->idle_work);
 
 	/* Empty the queue */
 	spin_lock_irqsave(q->queue_lock, flags);
@@ -378,6 +481,10 @@ void mmc_queue_suspend(struct mmc_queue *mq)
 		spin_unlock_irqrestore(q->queue_lock, flags);
 
 		down(&mq->thread_sem);
+
+		/* the thread is parked, take the idle timer over */
+		cancel_delayed_work_sync(&mq->idle_work);
+		mq->idle_armed = false;
 	}
 }
 
@@ -346,6 +346,53 @@ out:
 }
 EXPORT_SYMBOL(mmc_start_bkops);
 
+/**
+ *	mmc_start_idle_bkops - start BKOPS on an idle card
+ *	@card: MMC card to start BKOPS
+ *
+ *	Start background operations whenever the card reports any pending,
+ *	not only once they became urgent.  The operation is always started
+ *	without waiting for it, and only on cards supporting HPI, so that
+ *	mmc_interrupt_bkops() can stop it as soon as new requests arrive.
+ */
+void mmc_start_idle_bkops(struct mmc_card *card)
+{
+	int err;
+	unsigned long flags;
+
+	BUG_ON(!card);
+	if (!card->ext_csd.bkops_en || !(card->host->caps2 & MMC_CAP2_BKOPS))
+		return;
+
+	if (!card->ext_csd.hpi_en)
+		return;
+
+	mmc_claim_host(card->host);
+
+	if (mmc_card_doing_bkops(card))
+		goto out;
+
+	err = mmc_read_bkops_status(card);
+	if (err || !card->ext_csd.raw_bkops_status)
+		goto out;
+
+	err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
+			EXT_CSD_BKOPS_START, 1, 0);
+	if (err) {
+		pr_warning("%s: error %d starting idle bkops\n",
+			   mmc_hostname(card->host), err);
+		goto out;
+	}
+
+	spin_lock_irqsave(&card->host->lock, flags);
+	mmc_card_clr_need_bkops(card);
+	mmc_card_set_doing_bkops(card);
+	spin_unlock_irqrestore(&card->host->lock, flags);
+out:
+	mmc_release_host(card->host);
+}
+EXPORT_SYMBOL(mmc_start_idle_bkops);
+
 static void mmc_wait_done(struct mmc_request *mrq)
 {
 	complete(&mrq->completion);
@@ -364,6 +411,102 @@ static int __mmc_start_req(struct mmc_host *host, struct mmc_request *mrq)
 	return 0;
 }
 
+/*
+ * mmc_wait_data_done() - done callback for data request
+ * @mrq: done data request
+ *
+ * Wakes up mmc context, passed as a callback to host controller driver
+ */
+static void mmc_wait_data_done(struct mmc_request *mrq)
+{
+	struct mmc_context_info *context_info = &mrq->host->context_info;
+	unsigned long flags;
+
+	spin_lock_irqsave(&context_info->lock, flags);
+	context_info->is_done_rcv = true;
+	spin_unlock_irqrestore(&context_info->lock, flags);
+	wake_up_interruptible(&context_info->wait);
+}
+
+/*
+ *__mmc_start_data_req() - starts data request
+ * @host: MMC host to start the request
+ * @mrq: data request to start
+ *
+ * Sets the done callback to be called when request is completed by the card.
+ * Starts data mmc request execution
+ */
+static int __mmc_start_data_req(struct mmc_host *host, struct mmc_request *mrq)
+{
+	mrq->done = mmc_wait_data_done;
+	mrq->host = host;
+	if (mmc_card_removed(host->card)) {
+		mrq->cmd->error = -ENOMEDIUM;
+		mmc_wait_data_done(mrq);
+		return -ENOMEDIUM;
+	}
+	mmc_start_request(host, mrq);
+	return 0;
+}
+
+/*
+ * mmc_wait_for_data_req_done() - wait for request completed
+ * @host: MMC host to prepare the command.
+ * @mrq: MMC request to wait for
+ * @next_req: request prepared to be started once @mrq is done
+ *
+ * Blocks MMC context till host controller will ack end of data request
+ * execution or new request notification arrives from the block layer.
+ * Handles command retries.
+ *
+ * Returns enum mmc_blk_status after checking errors, or
+ * MMC_BLK_NEW_REQUEST if a new request was queued while nothing was
+ * prepared behind @mrq.
+ */
+static int mmc_wait_for_data_req_done(struct mmc_host *host,
+				      struct mmc_request *mrq,
+				      struct mmc_async_req *next_req)
+{
+	struct mmc_command *cmd;
+	struct mmc_context_info *context_info = &host->context_info;
+	unsigned long flags;
+	bool done, new_req;
+	int err;
+
+	while (1) {
+		wait_event_interruptible(context_info->wait,
+				(context_info->is_done_rcv ||
+				 context_info->is_new_req));
+		spin_lock_irqsave(&context_info->lock, flags);
+		done = context_info->is_done_rcv;
+		new_req = context_info->is_new_req;
+		context_info->is_waiting_last_req = false;
+		context_info->is_done_rcv = false;
+		context_info->is_new_req = false;
+		spin_unlock_irqrestore(&context_info->lock, flags);
+
+		if (done) {
+			cmd = mrq->cmd;
+			if (!cmd->error || !cmd->retries ||
+			    mmc_card_removed(host->card)) {
+				err = host->areq->err_check(host->card,
+							    host->areq);
+				break;
+			}
+
+			pr_debug("%s: req failed (CMD%u): %d, retrying...\n",
+				 mmc_hostname(host), cmd->opcode, cmd->error);
+			cmd->retries--;
+			cmd->error = 0;
+			host->ops->request(host, mrq);
+		} else if (new_req && !next_req) {
+			err = MMC_BLK_NEW_REQUEST;
+			break;
+		}
+	}
+	return err;
+}
+
 static void mmc_wait_for_req_done(struct mmc_host *host,
 				  struct mmc_request *mrq)
 {
@@ -440,6 +583,10 @@ static void mmc_post_req(struct mmc_host *host, struct mmc_request *mrq,
  *	Wait for the an ongoing request (previoulsy started) to complete and
  *	return the completed request. If there is no ongoing request, NULL
  *	is returned without waiting. NULL is not an error condition.
+ *
+ *	When called without @areq, the wait is cut short if the block layer
+ *	queues a new request meanwhile: NULL is returned, @error is set to
+ *	MMC_BLK_NEW_REQUEST and the ongoing request stays active.
  */
 struct mmc_async_req *mmc_start_req(struct mmc_host *host,
 				    struct mmc_async_req *areq, int *error)
@@ -453,12 +600,17 @@ struct mmc_async_req *mmc_start_req(struct mmc_host *host,
 		mmc_pre_req(host, areq->mrq, !host->areq);
 
 	if (host->areq) {
-		mmc_wait_for_req_done(host, host->areq->mrq);
-		err = host->areq->err_check(host->card, host->areq);
+		err = mmc_wait_for_data_req_done(host, host->areq->mrq, areq);
+		if (err == MMC_BLK_NEW_REQUEST) {
+			if (error)
+				*error = err;
+			/* The previous request is still running */
+			return NULL;
+		}
 	}
 
 	if (!err && areq)
-		start_err = __mmc_start_req(host, areq->mrq);
+		start_err = __mmc_start_data_req(host, areq->mrq);
 
 	if (host->areq)
 		mmc_post_req(host, host->areq->mrq, 0);
@@ -1124,8 +1124,13 @@ static int msmsdcc_sps_start_xfer(struct msmsdcc_host *host,
 		 */
 		len = sg_dma_len(sg);
 		addr = sg_dma_address(sg);
-		flags = 0;
 		while (len > 0) {
+			/*
+			 * Queue all but the last descriptor without
+			 * notifying the pipe, so the whole chain is handed
+			 * to the BAM with a single descriptor FIFO update.
+			 */
+			flags = SPS_IOVEC_FLAG_NO_SUBMIT;
 			if (len > SPS_MAX_DESC_SIZE) {
 				data_cnt = SPS_MAX_DESC_SIZE;
 			} else {
@@ -1152,6 +1157,8 @@ static int msmsdcc_sps_start_xfer(struct msmsdcc_host *host,
 	goto out;
 
 dma_map_err:
+	/* descriptors queued so far must not go out with the next request */
+	host->sps.reset_bam = true;
 	/* unmap sg buffers */
 	if (!data->host_cookie)
 		dma_unmap_sg(mmc_dev(host->mmc), host->sps.sg,
@@ -2434,7 +2441,7 @@ out:
 static int msmsdcc_setup_vreg(struct msmsdcc_host *host, bool enable,
 		bool is_init)
 {
-	int rc = 0, i;
+	int rc = 0, err, i;
 	struct msm_mmc_slot_reg_data *curr_slot;
 	struct msm_mmc_reg_data *vreg_table[2];
 
@@ -2447,6 +2454,8 @@ static int msmsdcc_setup_vreg(struct msmsdcc_host *host, bool enable,
 	vreg_table[0] = curr_slot->vdd_data;
 	vreg_table[1] = curr_slot->vdd_io_data;
 
+	/* send the mode, voltage and enable requests of both at once */
+	regulator_batch_begin();
 	for (i = 0; i < ARRAY_SIZE(vreg_table); i++) {
 		if (vreg_table[i]) {
 			if (enable)
@@ -2455,9 +2464,12 @@ static int msmsdcc_setup_vreg(struct msmsdcc_host *host, bool enable,
 				rc = msmsdcc_vreg_disable(vreg_table[i],
 						is_init);
 			if (rc)
-				goto out;
+				break;
 		}
 	}
+	err = regulator_batch_commit();
+	if (!rc)
+		rc = err;
 out:
 	return rc;
 }
@@ -6010,6 +6022,8 @@ msmsdcc_probe(struct platform_device *pdev)
 			(unsigned long)host);
 
 	mmc_add_host(mmc);
+	/* the card below only waits for its own host to resume */
+	device_enable_async_suspend(&pdev->dev);
 
 #ifdef CONFIG_HAS_EARLYSUSPEND
 	host->early_suspend.suspend = msmsdcc_early_suspend;
@@ -6658,7 +6672,8 @@ static void __exit msmsdcc_exit(void)
 #endif
 }
 
-module_init(msmsdcc_init);
+/* up to four controllers, each powering up and probing its card */
+async_module_init(msmsdcc_init);
 module_exit(msmsdcc_exit);
 
 MODULE_DESCRIPTION("Qualcomm Multimedia Card Interface driver");
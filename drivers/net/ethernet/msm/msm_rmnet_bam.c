@@ -64,6 +64,9 @@ module_param_named(debug_enable, msm_rmnet_bam_debug_mask,
 #define DEVICE_INACTIVE      0
 #define DEVICE_ACTIVE        1
 
+/* packets handed to the stack per NAPI poll */
+#define RMNET_NAPI_WEIGHT   64
+
 #define HEADROOM_FOR_BAM   8 /* for mux header */
 #define HEADROOM_FOR_QOS    8
 #define TAILROOM            8 /* for padding by mux layer */
@@ -81,6 +84,8 @@ struct rmnet_private {
 	spinlock_t lock;
 	spinlock_t tx_queue_lock;
 	struct tasklet_struct tsklt;
+	struct napi_struct napi;
+	struct sk_buff_head rx_queue;	/* received, not yet polled */
 	u32 operation_mode; /* IOCTL specified mode (protocol, QoS header) */
 	uint8_t device_up;
 	uint8_t in_reset;
@@ -244,6 +249,33 @@ static int count_this_packet(void *_hdr, int len)
 	return 1;
 }
 
+/*
+ * NAPI poll: hand the queued packets to the stack through GRO, which
+ * merges TCP segments of a flow and, with rps_cpus set for the device,
+ * steers each flow to a core of its own.
+ */
+static int rmnet_poll(struct napi_struct *napi, int budget)
+{
+	struct rmnet_private *p = container_of(napi, struct rmnet_private,
+					       napi);
+	struct sk_buff *skb;
+	int work = 0;
+
+	while (work < budget && (skb = skb_dequeue(&p->rx_queue))) {
+		napi_gro_receive(napi, skb);
+		work++;
+	}
+
+	if (work < budget) {
+		napi_complete(napi);
+		/* a packet queued after the last dequeue would be missed */
+		if (!skb_queue_empty(&p->rx_queue))
+			napi_schedule(napi);
+	}
+
+	return work;
+}
+
 /* Rx Callback, Called in Work Queue context */
 static void bam_recv_notify(void *dev, struct sk_buff *skb)
 {
@@ -261,10 +293,13 @@ static void bam_recv_notify(void *dev, struct sk_buff *skb)
 		if (RMNET_IS_MODE_IP(opmode)) {
 			/* Driver in IP mode */
 			skb->protocol = rmnet_ip_type_trans(skb, dev);
+			skb_reset_mac_header(skb);
 		} else {
 			/* Driver in Ethernet mode */
 			skb->protocol = eth_type_trans(skb, dev);
 		}
+		/* GRO and the RPS flow hash look for the L3 header here */
+		skb_reset_network_header(skb);
 		if (RMNET_IS_MODE_IP(opmode) ||
 		    count_this_packet(skb->data, skb->len)) {
 #ifdef CONFIG_MSM_RMNET_DEBUG
@@ -278,7 +313,13 @@ static void bam_recv_notify(void *dev, struct sk_buff *skb)
 			p->stats.rx_packets, skb->len);
 
 		/* Deliver to network stack */
-		netif_rx(skb);
+		if (skb_queue_len(&p->rx_queue) >= netdev_max_backlog) {
+			p->stats.rx_dropped++;
+			dev_kfree_skb_any(skb);
+			return;
+		}
+		skb_queue_tail(&p->rx_queue, skb);
+		napi_schedule(&p->napi);
 	} else
 		pr_err("[%s] %s: No skb received",
 			((struct net_device *)dev)->name, __func__);
@@ -408,14 +449,17 @@ static int __rmnet_open(struct net_device *dev)
 
 static int rmnet_open(struct net_device *dev)
 {
+	struct rmnet_private *p = netdev_priv(dev);
 	int rc = 0;
 
 	DBG0("[%s] rmnet_open()\n", dev->name);
 
 	rc = __rmnet_open(dev);
 
-	if (rc == 0)
+	if (rc == 0) {
+		napi_enable(&p->napi);
 		netif_start_queue(dev);
+	}
 
 	return rc;
 }
@@ -438,10 +482,15 @@ static int __rmnet_close(struct net_device *dev)
 
 static int rmnet_stop(struct net_device *dev)
 {
+	struct rmnet_private *p = netdev_priv(dev);
+
 	DBG0("[%s] rmnet_stop()\n", dev->name);
 
 	__rmnet_close(dev);
 	netif_stop_queue(dev);
+	/* the port stays open, drop what arrives while the device is down */
+	napi_disable(&p->napi);
+	skb_queue_purge(&p->rx_queue);
 
 	return 0;
 }
@@ -772,6 +821,8 @@ static int __init rmnet_init(void)
 		p->in_reset = 0;
 		spin_lock_init(&p->lock);
 		spin_lock_init(&p->tx_queue_lock);
+		skb_queue_head_init(&p->rx_queue);
+		netif_napi_add(dev, &p->napi, rmnet_poll, RMNET_NAPI_WEIGHT);
 #ifdef CONFIG_MSM_RMNET_DEBUG
 		p->timeout_us = timeout_us;
 		p->wakeups_xmit = p->wakeups_rcv = 0;
@@ -570,6 +570,8 @@ wcnss_wlan_probe(struct platform_device *pdev)
 		return -ENOMEM;
 	}
 	penv->pdev = pdev;
+	/* the WLAN driver resumes through the pm_ops it registered here */
+	device_enable_async_suspend(&pdev->dev);
 
 #ifdef MODULE
 
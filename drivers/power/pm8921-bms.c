@@ -140,7 +140,9 @@ struct pm8921_bms_chip {
 	int			shutdown_soc;
 	int			shutdown_iavg_ma;
 	struct delayed_work	calculate_soc_delayed_work;
+	struct work_struct	soc_irq_work;
 	struct timespec		t_soc_queried;
+	int			reported_calc_soc;
 	int			shutdown_soc_valid_limit;
 	int			ignore_shutdown_soc;
 	int			prev_iavg_ua;
@@ -185,6 +187,12 @@ module_param(last_charge_increase, int, 0644);
 
 static int calculated_soc = -EINVAL;
 static int last_soc = -EINVAL;
+/*
+ * A reported SOC is handed out again for this long, unless a new one was
+ * calculated in between, so that polling it does not read the ADC.
+ */
+static unsigned int soc_cache_ms = 5000;
+module_param(soc_cache_ms, uint, 0644);
 static int last_real_fcc_mah = -EINVAL;
 static int last_real_fcc_batt_temp = -EINVAL;
 
@@ -2244,6 +2252,16 @@ static void calculate_soc_work(struct work_struct *work)
 			(CALCULATE_SOC_MS)));
 }
 
+/* a new OCV or the CC threshold was hit, recalculate right away */
+static void calculate_soc_irq_work(struct work_struct *work)
+{
+	struct pm8921_bms_chip *chip = container_of(work,
+				struct pm8921_bms_chip, soc_irq_work);
+
+	cancel_delayed_work_sync(&chip->calculate_soc_delayed_work);
+	calculate_soc_work(&chip->calculate_soc_delayed_work.work);
+}
+
 static int report_state_of_charge(struct pm8921_bms_chip *chip)
 {
 	int soc = calculated_soc;
@@ -2253,6 +2271,15 @@ static int report_state_of_charge(struct pm8921_bms_chip *chip)
 	int batt_temp;
 	int rc;
 
+	do_posix_clock_monotonic_gettime(&now);
+	if (chip->t_soc_queried.tv_sec != 0 && soc == chip->reported_calc_soc) {
+		delta_time_us
+		= (now.tv_sec - chip->t_soc_queried.tv_sec) * USEC_PER_SEC
+			+ (now.tv_nsec - chip->t_soc_queried.tv_nsec) / 1000;
+		if (delta_time_us >= 0 && delta_time_us < soc_cache_ms * 1000)
+			return chip->last_reported_soc;
+	}
+
 	rc = pm8xxx_adc_read(the_chip->batt_temp_channel, &result);
 	if (rc) {
 		pr_err("error reading adc channel = %d, rc = %d\n",
@@ -2263,7 +2290,6 @@ static int report_state_of_charge(struct pm8921_bms_chip *chip)
 						result.measurement);
 	batt_temp = (int)result.physical;
 
-	do_posix_clock_monotonic_gettime(&now);
 	if (chip->t_soc_queried.tv_sec != 0) {
 		delta_time_us
 		= (now.tv_sec - chip->t_soc_queried.tv_sec) * USEC_PER_SEC
@@ -2322,6 +2348,7 @@ static int report_state_of_charge(struct pm8921_bms_chip *chip)
 	pr_debug("Reported SOC = %d\n", last_soc);
 	chip->t_soc_queried = now;
 	chip->last_reported_soc = last_soc;
+	chip->reported_calc_soc = calculated_soc;
 
 	return last_soc;
 }
@@ -2741,7 +2768,10 @@ static irqreturn_t pm8921_bms_sbi_write_ok_handler(int irq, void *data)
 
 static irqreturn_t pm8921_bms_cc_thr_handler(int irq, void *data)
 {
+	struct pm8921_bms_chip *chip = data;
+
 	pr_debug("irq = %d triggered", irq);
+	schedule_work(&chip->soc_irq_work);
 	return IRQ_HANDLED;
 }
 
@@ -2772,6 +2802,7 @@ static irqreturn_t pm8921_bms_good_ocv_handler(int irq, void *data)
 
 	pr_debug("irq = %d triggered", irq);
 	schedule_work(&chip->calib_hkadc_work);
+	schedule_work(&chip->soc_irq_work);
 	return IRQ_HANDLED;
 }
 
@@ -3364,6 +3395,7 @@ static int __devinit pm8921_bms_probe(struct platform_device *pdev)
 	chip->revision = pm8xxx_get_revision(chip->dev->parent);
 	chip->enable_fcc_learning = pdata->enable_fcc_learning;
 	chip->last_reported_soc = -EINVAL;
+	chip->reported_calc_soc = -EINVAL;
 	chip->eoc_check_soc = pdata->eoc_check_soc;
 	chip->soc_adjusted = 0;
 	chip->bms_support_wlc = pdata->bms_support_wlc;
@@ -3377,11 +3409,13 @@ static int __devinit pm8921_bms_probe(struct platform_device *pdev)
 
 	mutex_init(&chip->calib_mutex);
 	INIT_WORK(&chip->calib_hkadc_work, calibrate_hkadc_work);
-	INIT_DELAYED_WORK(&chip->calib_hkadc_delayed_work,
+	INIT_DELAYED_WORK_DEFERRABLE(&chip->calib_hkadc_delayed_work,
 				calibrate_hkadc_delayed_work);
 
-	INIT_DELAYED_WORK(&chip->calculate_soc_delayed_work,
+	/* only recalculate on the timer while awake, the irqs wake us up */
+	INIT_DELAYED_WORK_DEFERRABLE(&chip->calculate_soc_delayed_work,
 			calculate_soc_work);
+	INIT_WORK(&chip->soc_irq_work, calculate_soc_irq_work);
 
 	rc = request_irqs(chip, pdev);
 	if (rc) {
@@ -3436,6 +3470,8 @@ static int __devexit pm8921_bms_remove(struct platform_device *pdev)
 	struct pm8921_bms_chip *chip = platform_get_drvdata(pdev);
 
 	free_irqs(chip);
+	cancel_work_sync(&chip->soc_irq_work);
+	cancel_delayed_work_sync(&chip->calculate_soc_delayed_work);
 	kfree(chip->adjusted_fcc_temp_lut);
 	platform_set_drvdata(pdev, NULL);
 	the_chip = NULL;
@@ -291,6 +291,8 @@ struct pm8921_chg_chip {
 	int				recent_reported_soc;
 	unsigned int			ext_warm_i_limit;
 	int				eoc_check_soc;
+	int				vbat_cached_uv;
+	unsigned long			vbat_cached_jiffies;
 };
 
 /* user space parameter to limit usb current */
@@ -1415,6 +1417,31 @@ static int get_prop_battery_uvolts(struct pm8921_chg_chip *chip)
 	return (int)result.physical;
 }
 
+/*
+ * Userspace polls the battery voltage far more often than it changes,
+ * so power supply reads reuse a conversion that is less than
+ * vbat_cache_ms old instead of waking the ADC again.
+ */
+static unsigned int vbat_cache_ms = 5000;
+module_param(vbat_cache_ms, uint, 0644);
+
+static int get_prop_battery_uvolts_cached(struct pm8921_chg_chip *chip)
+{
+	int uv;
+
+	if (chip->vbat_cached_jiffies && time_before(jiffies,
+			chip->vbat_cached_jiffies +
+			msecs_to_jiffies(vbat_cache_ms)))
+		return chip->vbat_cached_uv;
+
+	uv = get_prop_battery_uvolts(chip);
+	if (uv > 0) {
+		chip->vbat_cached_uv = uv;
+		chip->vbat_cached_jiffies = jiffies;
+	}
+	return uv;
+}
+
 static unsigned int voltage_based_capacity(struct pm8921_chg_chip *chip)
 {
 	unsigned int current_voltage_uv = get_prop_battery_uvolts(chip);
@@ -1625,7 +1652,7 @@ static int pm_batt_power_get_property(struct power_supply *psy,
 		val->intval = chip->min_voltage_mv * 1000;
 		break;
 	case POWER_SUPPLY_PROP_VOLTAGE_NOW:
-		val->intval = get_prop_battery_uvolts(chip);
+		val->intval = get_prop_battery_uvolts_cached(chip);
 		break;
 	case POWER_SUPPLY_PROP_CAPACITY:
 		val->intval = get_prop_batt_capacity(chip);
@@ -4639,6 +4666,8 @@ static int __devinit pm8921_charger_probe(struct platform_device *pdev)
 				      round_jiffies_relative(msecs_to_jiffies
 							(chip->update_time)));
 	}
+	/* the ADC it talks to is back already, it resumes in the noirq phase */
+	device_enable_async_suspend(&pdev->dev);
 	return 0;
 
 free_irq:
@@ -21,6 +21,7 @@
 #include <linux/async.h>
 #include <linux/err.h>
 #include <linux/mutex.h>
+#include <linux/sched.h>
 #include <linux/suspend.h>
 #include <linux/delay.h>
 #include <linux/of.h>
@@ -57,6 +58,12 @@ static int suppress_info_printing;
 
 static struct dentry *debugfs_root;
 
+/* regulator_batch_begin() until regulator_batch_commit() */
+static DEFINE_MUTEX(regulator_batch_mutex);
+static LIST_HEAD(regulator_batch_list);
+static struct task_struct *regulator_batch_owner;
+static int regulator_batch_delay;	/* longest enable ramp, in us */
+
 /*
  * struct regulator_map
  *
@@ -1514,13 +1521,18 @@ static int _regulator_enable(struct regulator_dev *rdev)
 
 			trace_regulator_enable(rdev_get_name(rdev));
 
-			/* Allow the regulator to ramp; it would be useful
-			 * to extend this for bulk operations so that the
-			 * regulators can ramp together.  */
+			/* Allow the regulator to ramp; in a batch all
+			 * regulators ramp together once it is committed. */
 			ret = rdev->desc->ops->enable(rdev);
 			if (ret < 0)
 				return ret;
 
+			if (regulator_batch_owner == current) {
+				if (delay > regulator_batch_delay)
+					regulator_batch_delay = delay;
+				delay = 0;
+			}
+
 			trace_regulator_enable_delay(rdev_get_name(rdev));
 
 			if (delay >= 1000) {
@@ -1890,6 +1902,12 @@ static int _regulator_do_set_voltage(struct regulator_dev *rdev,
 	min_uV += rdev->constraints->uV_offset;
 	max_uV += rdev->constraints->uV_offset;
 
+	/* the hardware already has what all consumers together ask for */
+	if (min_uV == rdev->applied_min_uV && max_uV == rdev->applied_max_uV) {
+		trace_regulator_set_voltage_complete(rdev_get_name(rdev), -1);
+		return 0;
+	}
+
 	if (rdev->desc->ops->set_voltage) {
 		ret = rdev->desc->ops->set_voltage(rdev, min_uV, max_uV,
 						   &selector);
@@ -1957,9 +1975,14 @@ static int _regulator_do_set_voltage(struct regulator_dev *rdev,
 		udelay(delay);
 	}
 
-	if (ret == 0)
+	if (ret == 0) {
+		rdev->applied_min_uV = min_uV;
+		rdev->applied_max_uV = max_uV;
 		_notifier_call_chain(rdev, REGULATOR_EVENT_VOLTAGE_CHANGE,
 				     NULL);
+	} else {
+		rdev->applied_min_uV = rdev->applied_max_uV = 0;
+	}
 
 	trace_regulator_set_voltage_complete(rdev_get_name(rdev), selector);
 
@@ -2116,6 +2139,8 @@ int regulator_sync_voltage(struct regulator *regulator)
 	if (ret < 0)
 		goto out;
 
+	/* the hardware may have lost the setting, write it in any case */
+	rdev->applied_min_uV = rdev->applied_max_uV = 0;
 	ret = _regulator_do_set_voltage(rdev, min_uV, max_uV);
 
 out:
@@ -2405,6 +2430,13 @@ int regulator_set_optimum_mode(struct regulator *regulator, int uA_load)
 		goto out;
 	}
 
+	/* most load changes leave the mode as it is */
+	if (rdev->desc->ops->get_mode &&
+	    rdev->desc->ops->get_mode(rdev) == mode) {
+		ret = mode;
+		goto out;
+	}
+
 	ret = rdev->desc->ops->set_mode(rdev, mode);
 	if (ret < 0) {
 		rdev_err(rdev, "failed to set optimum mode %x\n", mode);
@@ -2417,6 +2449,87 @@ out:
 }
 EXPORT_SYMBOL_GPL(regulator_set_optimum_mode);
 
+/**
+ * regulator_batch_begin - start queueing regulator changes
+ *
+ * Until regulator_batch_commit(), drivers that registered batch
+ * operations may queue the requests made by the calling task instead of
+ * sending each to the hardware, enables do not wait for the regulator
+ * to ramp up.  The consumer calls work as usual otherwise, but their
+ * effect is only guaranteed once regulator_batch_commit() returns.  Only
+ * one task may batch at a time, others wait here.
+ */
+void regulator_batch_begin(void)
+{
+	struct regulator_batch_ops *ops;
+
+	mutex_lock(&regulator_batch_mutex);
+	regulator_batch_owner = current;
+	regulator_batch_delay = 0;
+	list_for_each_entry(ops, &regulator_batch_list, list)
+		ops->begin();
+}
+EXPORT_SYMBOL_GPL(regulator_batch_begin);
+
+/**
+ * regulator_batch_commit - apply the changes queued since the batch began
+ *
+ * Each driver sends all its queued requests in one operation, then the
+ * longest ramp time of the regulators enabled during the batch is waited
+ * for.  Returns 0 or the first error a driver reported, the requests of
+ * the other drivers are sent regardless.
+ */
+int regulator_batch_commit(void)
+{
+	struct regulator_batch_ops *ops;
+	int ret = 0, err;
+
+	if (WARN_ON(regulator_batch_owner != current))
+		return -EINVAL;
+
+	list_for_each_entry(ops, &regulator_batch_list, list) {
+		err = ops->commit();
+		if (err && !ret)
+			ret = err;
+	}
+
+	if (regulator_batch_delay >= 1000) {
+		mdelay(regulator_batch_delay / 1000);
+		udelay(regulator_batch_delay % 1000);
+	} else if (regulator_batch_delay) {
+		udelay(regulator_batch_delay);
+	}
+
+	regulator_batch_owner = NULL;
+	mutex_unlock(&regulator_batch_mutex);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(regulator_batch_commit);
+
+/**
+ * regulator_register_batch_ops - let a driver queue batched requests
+ * @ops: the driver's begin and commit operations
+ */
+void regulator_register_batch_ops(struct regulator_batch_ops *ops)
+{
+	mutex_lock(&regulator_batch_mutex);
+	list_add_tail(&ops->list, &regulator_batch_list);
+	mutex_unlock(&regulator_batch_mutex);
+}
+EXPORT_SYMBOL_GPL(regulator_register_batch_ops);
+
+/**
+ * regulator_unregister_batch_ops - stop batching for a driver
+ * @ops: operations passed to regulator_register_batch_ops()
+ */
+void regulator_unregister_batch_ops(struct regulator_batch_ops *ops)
+{
+	mutex_lock(&regulator_batch_mutex);
+	list_del(&ops->list);
+	mutex_unlock(&regulator_batch_mutex);
+}
+EXPORT_SYMBOL_GPL(regulator_unregister_batch_ops);
+
 /**
  * regulator_register_notifier - register regulator event notifier
  * @regulator: regulator source
@@ -63,6 +63,7 @@ static long alarm_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	int rv = 0;
 	unsigned long flags;
 	struct timespec new_alarm_time;
+	struct android_alarm_window window;
 	struct timespec new_rtc_time;
 	struct timespec tmp_time;
 	enum android_alarm_type alarm_type = ANDROID_ALARM_IOCTL_TO_TYPE(cmd);
@@ -147,6 +148,26 @@ from_old_alarm_set:
 		alarm_pending = 0;
 		spin_unlock_irqrestore(&alarm_slock, flags);
 		break;
+	case ANDROID_ALARM_SET_WINDOW(0):
+		if (copy_from_user(&window, (void __user *)arg,
+		    sizeof(window))) {
+			rv = -EFAULT;
+			goto err1;
+		}
+		if (timespec_compare(&window.earliest, &window.latest) > 0) {
+			rv = -EINVAL;
+			goto err1;
+		}
+		spin_lock_irqsave(&alarm_slock, flags);
+		pr_alarm(IO, "alarm %d set %ld.%09ld-%ld.%09ld\n", alarm_type,
+			window.earliest.tv_sec, window.earliest.tv_nsec,
+			window.latest.tv_sec, window.latest.tv_nsec);
+		alarm_enabled |= alarm_type_mask;
+		alarm_start_range(&alarms[alarm_type],
+			timespec_to_ktime(window.earliest),
+			timespec_to_ktime(window.latest));
+		spin_unlock_irqrestore(&alarm_slock, flags);
+		break;
 	case ANDROID_ALARM_SET_RTC:
 		if (copy_from_user(&new_rtc_time, (void __user *)arg,
 		    sizeof(new_rtc_time))) {
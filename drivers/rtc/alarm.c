@@ -59,6 +59,7 @@ struct alarm_queue {
 	ktime_t delta;
 	bool stopped;
 	ktime_t stopped_time;
+	int running;	/* callbacks of this queue being run */
 };
 
 static struct rtc_device *alarm_rtc_dev;
@@ -69,11 +70,27 @@ static struct platform_device *alarm_platform_dev;
 struct alarm_queue alarms[ANDROID_ALARM_TYPE_COUNT];
 static bool suspended;
 
+/*
+ * Wakeup alarm expiries, and how many alarms ran in them beyond the
+ * first, each a wakeup that coalescing windows saved.
+ */
+static unsigned int wakeup_count;
+static unsigned int coalesced_count;
+module_param_named(wakeups, wakeup_count, uint, S_IRUGO);
+module_param_named(coalesced, coalesced_count, uint, S_IRUGO);
+
+static bool alarm_queue_is_wakeup(struct alarm_queue *base)
+{
+	return base == &alarms[ANDROID_ALARM_RTC_WAKEUP] ||
+		base == &alarms[ANDROID_ALARM_ELAPSED_REALTIME_WAKEUP];
+}
+
 static void update_timer_locked(struct alarm_queue *base, bool head_removed)
 {
-	struct alarm *alarm;
-	bool is_wakeup = base == &alarms[ANDROID_ALARM_RTC_WAKEUP] ||
-			base == &alarms[ANDROID_ALARM_ELAPSED_REALTIME_WAKEUP];
+	struct alarm *alarm, *entry;
+	struct rb_node *node;
+	ktime_t softexpires;
+	bool is_wakeup = alarm_queue_is_wakeup(base);
 
 	if (base->stopped) {
 		pr_alarm(FLOW, "changed alarm while setting the wall time\n");
@@ -97,9 +114,24 @@ static void update_timer_locked(struct alarm_queue *base, bool head_removed)
 		return;
 	}
 
+	/*
+	 * The queue is ordered by expires, so the first alarm is the one
+	 * that must run first.  Every alarm whose window opens before that
+	 * runs with it, so let the timer fire early no sooner than the
+	 * latest of those windows opens.
+	 */
+	softexpires = alarm->softexpires;
+	for (node = rb_next(base->first); node; node = rb_next(node)) {
+		entry = rb_entry(node, struct alarm, node);
+		if (entry->softexpires.tv64 > alarm->expires.tv64)
+			break;
+		if (entry->softexpires.tv64 > softexpires.tv64)
+			softexpires = entry->softexpires;
+	}
+
 	hrtimer_try_to_cancel(&base->timer);
 	base->timer.node.expires = ktime_add(base->delta, alarm->expires);
-	base->timer._softexpires = ktime_add(base->delta, alarm->softexpires);
+	base->timer._softexpires = ktime_add(base->delta, softexpires);
 	hrtimer_start_expires(&base->timer, HRTIMER_MODE_ABS);
 }
 
@@ -216,7 +248,8 @@ int alarm_try_to_cancel(struct alarm *alarm)
 		pr_alarm(FLOW, "tried to cancel alarm, type %d, func %pF\n",
 			alarm->type, alarm->function);
 	spin_unlock_irqrestore(&alarm_slock, flags);
-	if (!ret && hrtimer_callback_running(&base->timer))
+	if (!ret && (hrtimer_callback_running(&base->timer) ||
+		     ACCESS_ONCE(base->running)))
 		ret = -1;
 	return ret;
 }
@@ -342,41 +375,97 @@ ktime_t alarm_get_elapsed_realtime(void)
 	return now;
 }
 
-static enum hrtimer_restart alarm_timer_triggered(struct hrtimer *timer)
+/*
+ * Run every alarm of @base whose window has opened by @now, not only a
+ * run at the head: the queue is ordered by expires, so a wide window may
+ * open before the windows of alarms queued ahead of it.  Returns the
+ * number of alarms run.  Drops alarm_slock around the callbacks.
+ */
+static int alarm_run_queue_locked(struct alarm_queue *base, ktime_t now,
+				  unsigned long *flags)
 {
-	struct alarm_queue *base;
+	struct rb_node *node = base->first;
 	struct alarm *alarm;
-	unsigned long flags;
-	ktime_t now;
-
-	spin_lock_irqsave(&alarm_slock, flags);
-
-	base = container_of(timer, struct alarm_queue, timer);
-	now = base->stopped ? base->stopped_time : hrtimer_cb_get_time(timer);
-	now = ktime_sub(now, base->delta);
-
-	pr_alarm(INT, "alarm_timer_triggered type %d at %lld\n",
-		base - alarms, ktime_to_ns(now));
+	int ran = 0;
 
-	while (base->first) {
-		alarm = container_of(base->first, struct alarm, node);
+	while (node) {
+		alarm = rb_entry(node, struct alarm, node);
 		if (alarm->softexpires.tv64 > now.tv64) {
 			pr_alarm(FLOW, "don't call alarm, %pF, %lld (s %lld)\n",
 				alarm->function, ktime_to_ns(alarm->expires),
 				ktime_to_ns(alarm->softexpires));
-			break;
+			node = rb_next(node);
+			continue;
 		}
-		base->first = rb_next(&alarm->node);
+		if (base->first == node)
+			base->first = rb_next(node);
 		rb_erase(&alarm->node, &base->alarms);
 		RB_CLEAR_NODE(&alarm->node);
 		pr_alarm(CALL, "call alarm, type %d, func %pF, %lld (s %lld)\n",
 			alarm->type, alarm->function,
 			ktime_to_ns(alarm->expires),
 			ktime_to_ns(alarm->softexpires));
-		spin_unlock_irqrestore(&alarm_slock, flags);
+		base->running++;
+		spin_unlock_irqrestore(&alarm_slock, *flags);
 		alarm->function(alarm);
-		spin_lock_irqsave(&alarm_slock, flags);
+		spin_lock_irqsave(&alarm_slock, *flags);
+		base->running--;
+		ran++;
+		/* the callback may have changed the queue */
+		node = base->first;
 	}
+	return ran;
+}
+
+static ktime_t alarm_queue_now(struct alarm_queue *base)
+{
+	ktime_t now;
+
+	now = base->stopped ? base->stopped_time :
+		hrtimer_cb_get_time(&base->timer);
+	return ktime_sub(now, base->delta);
+}
+
+static enum hrtimer_restart alarm_timer_triggered(struct hrtimer *timer)
+{
+	struct alarm_queue *base, *other;
+	unsigned long flags;
+	ktime_t now;
+	int ran;
+
+	spin_lock_irqsave(&alarm_slock, flags);
+
+	base = container_of(timer, struct alarm_queue, timer);
+	now = alarm_queue_now(base);
+
+	pr_alarm(INT, "alarm_timer_triggered type %d at %lld\n",
+		base - alarms, ktime_to_ns(now));
+
+	ran = alarm_run_queue_locked(base, now, &flags);
+
+	/*
+	 * The device is awake for this wakeup alarm anyway, so also run the
+	 * wakeup alarms of the other clock whose windows are open, instead
+	 * of waking up for them separately.
+	 */
+	if (alarm_queue_is_wakeup(base)) {
+		int other_ran;
+
+		other = base == &alarms[ANDROID_ALARM_RTC_WAKEUP] ?
+			&alarms[ANDROID_ALARM_ELAPSED_REALTIME_WAKEUP] :
+			&alarms[ANDROID_ALARM_RTC_WAKEUP];
+		other_ran = alarm_run_queue_locked(other,
+				alarm_queue_now(other), &flags);
+		if (other_ran)
+			update_timer_locked(other, true);
+		ran += other_ran;
+
+		if (ran) {
+			wakeup_count++;
+			coalesced_count += ran - 1;
+		}
+	}
+
 	if (!base->first)
 		pr_alarm(FLOW, "no more alarms of type %d\n", base - alarms);
 	update_timer_locked(base, true);
@@ -275,6 +275,10 @@ struct msm_slim_ctrl {
 	int			err;
 	int			ee;
 	struct completion	*wr_comp;
+	struct completion	tx_done;
+	bool			tx_posted;
+	u8			tx_posted_mc;
+	u8			tx_posted_la;
 	struct msm_slim_sat	*satd[MSM_MAX_NSATS];
 	struct msm_slim_endp	pipes[7];
 	struct msm_slim_sps_bam	bam;
@@ -753,12 +757,51 @@ static u32 *msm_get_msg_buf(struct slim_controller *ctrl, int len)
 {
 	struct msm_slim_ctrl *dev = slim_get_ctrldata(ctrl);
 	/*
-	 * Currently we block a transaction until the current one completes.
+	 * There is a single TX buffer: a transaction waits until the one
+	 * before it, posted or not, has been sent.
 	 * In case we need multiple transactions, use message Q
 	 */
 	return dev->tx_buf;
 }
 
+/*
+ * Value and information element writes need nothing back from the
+ * device, so they are posted: the caller returns once the message is in
+ * the TX buffer and the next transaction waits for it to go out.  Codec
+ * path setup is a long run of such register writes, which then overlaps
+ * the bus time of each write with the preparation of the next one.
+ */
+static bool msm_slim_tx_postable(struct slim_msg_txn *txn)
+{
+	u8 mc = (u8)(txn->mc & 0xFF);
+
+	return txn->mt == SLIM_MSG_MT_CORE && !txn->rbuf &&
+		txn->dt == SLIM_MSG_DEST_LOGICALADDR &&
+		(mc == SLIM_MSG_MC_CHANGE_VALUE ||
+		 mc == SLIM_MSG_MC_CLEAR_INFORMATION);
+}
+
+/*
+ * Wait for a posted write to leave the TX buffer, called with tx_lock
+ * held before the buffer is used again.  The sender has already
+ * returned, so a failure can only be reported here.
+ */
+static void msm_slim_tx_drain(struct msm_slim_ctrl *dev)
+{
+	if (!dev->tx_posted)
+		return;
+	dev->tx_posted = false;
+	if (!wait_for_completion_timeout(&dev->tx_done, HZ)) {
+		dev->wr_comp = NULL;
+		dev_err(dev->dev, "posted TX timed out:MC:0x%x,LA:0x%x",
+				dev->tx_posted_mc, dev->tx_posted_la);
+	} else if (dev->err) {
+		dev_err(dev->dev, "posted TX failed:MC:0x%x,LA:0x%x,err:%d",
+				dev->tx_posted_mc, dev->tx_posted_la, dev->err);
+	}
+	dev->err = 0;
+}
+
 static int msm_send_msg_buf(struct slim_controller *ctrl, u32 *buf, u8 len)
 {
 	int i;
@@ -793,6 +836,7 @@ static int msm_xfer_msg(struct slim_controller *ctrl, struct slim_msg_txn *txn)
 	if (!(txn->mc & SLIM_MSG_CLK_PAUSE_SEQ_FLG))
 		msgv = msm_slim_get_ctrl(dev);
 	mutex_lock(&dev->tx_lock);
+	msm_slim_tx_drain(dev);
 	if (dev->state == MSM_CTRL_ASLEEP ||
 		((!(txn->mc & SLIM_MSG_CLK_PAUSE_SEQ_FLG)) &&
 		dev->state == MSM_CTRL_SLEEPING)) {
@@ -886,6 +930,18 @@ static int msm_xfer_msg(struct slim_controller *ctrl, struct slim_msg_txn *txn)
 	if (txn->mt == SLIM_MSG_MT_CORE &&
 		mc == SLIM_MSG_MC_BEGIN_RECONFIGURATION)
 		dev->reconf_busy = true;
+	if (msm_slim_tx_postable(txn)) {
+		INIT_COMPLETION(dev->tx_done);
+		dev->tx_posted = true;
+		dev->tx_posted_mc = mc;
+		dev->tx_posted_la = la;
+		dev->wr_comp = &dev->tx_done;
+		msm_send_msg_buf(ctrl, pbuf, txn->rl);
+		mutex_unlock(&dev->tx_lock);
+		if (msgv >= 0)
+			msm_slim_put_ctrl(dev);
+		return 0;
+	}
 	dev->wr_comp = &done;
 	msm_send_msg_buf(ctrl, pbuf, txn->rl);
 	timeout = wait_for_completion_timeout(&done, HZ);
@@ -955,6 +1011,7 @@ static int msm_set_laddr(struct slim_controller *ctrl, const u8 *ea,
 retry_laddr:
 	init_completion(&done);
 	mutex_lock(&dev->tx_lock);
+	msm_slim_tx_drain(dev);
 	buf = msm_get_msg_buf(ctrl, 9);
 	buf[0] = SLIM_MSG_ASM_FIRST_WORD(9, SLIM_MSG_MT_CORE,
 					SLIM_MSG_MC_ASSIGN_LOGICAL_ADDRESS,
@@ -2024,6 +2081,7 @@ static int __devinit msm_slim_probe(struct platform_device *pdev)
 	dev->ctrl.sched.pending_msgsl = 30;
 
 	init_completion(&dev->reconf);
+	init_completion(&dev->tx_done);
 	mutex_init(&dev->tx_lock);
 	spin_lock_init(&dev->rx_lock);
 	dev->ee = 1;
@@ -2184,6 +2242,10 @@ static int __devexit msm_slim_remove(struct platform_device *pdev)
 	struct resource *slim_mem;
 	struct resource *slew_mem = dev->slew_mem;
 	int i;
+
+	mutex_lock(&dev->tx_lock);
+	msm_slim_tx_drain(dev);
+	mutex_unlock(&dev->tx_lock);
 	for (i = 0; i < dev->nsats; i++) {
 		struct msm_slim_sat *sat = dev->satd[i];
 		int j;
@@ -19,12 +19,14 @@
 #include <linux/fdtable.h>
 #include <linux/file.h>
 #include <linux/fs.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
 #include <linux/miscdevice.h>
 #include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/nsproxy.h>
+#include <linux/percpu.h>
 #include <linux/poll.h>
 #include <linux/debugfs.h>
 #include <linux/rbtree.h>
@@ -107,6 +109,19 @@ module_param_named(debug_mask, binder_debug_mask, uint, S_IWUSR | S_IRUGO);
 static bool binder_debug_no_lock;
 module_param_named(proc_no_lock, binder_debug_no_lock, bool, S_IWUSR | S_IRUGO);
 
+/* Pages mapped at mmap time, so that early transactions find them ready */
+static uint binder_prealloc_pages = 4;
+module_param_named(prealloc_pages, binder_prealloc_pages, uint,
+		   S_IWUSR | S_IRUGO);
+
+/*
+ * Percentage of a proc's async space that one sender may hold in oneway
+ * transactions, checked once more than that is in use; 100 disables it
+ */
+static uint binder_async_sender_percent = 50;
+module_param_named(async_sender_percent, binder_async_sender_percent, uint,
+		   S_IWUSR | S_IRUGO);
+
 static DECLARE_WAIT_QUEUE_HEAD(binder_user_error_wait);
 static int binder_stop_on_user_error;
 
@@ -166,6 +181,30 @@ static inline void binder_stats_created(enum binder_stat_types type)
 	binder_stats.obj_created[type]++;
 }
 
+/*
+ * Log2 histograms: bucket 0 counts zero values and bucket i counts
+ * values in [2^(i-1), 2^i), the last bucket also taking anything
+ * larger. Latencies are in microseconds, sizes in bytes.
+ */
+#define BINDER_HIST_BUCKETS 20
+
+enum binder_hist_types {
+	BINDER_HIST_QUEUE,	/* queued until read by the target thread */
+	BINDER_HIST_REPLY,	/* read by the target until it replied */
+	BINDER_HIST_SIZE,	/* data plus offsets sent */
+	BINDER_HIST_COUNT
+};
+
+struct binder_hist {
+	u32 bucket[BINDER_HIST_COUNT][BINDER_HIST_BUCKETS];
+};
+
+/*
+ * The global histogram is per-cpu. Node and thread histograms are only
+ * updated under binder_main_lock, which the callers already hold.
+ */
+static DEFINE_PER_CPU(struct binder_hist, binder_hist);
+
 struct binder_transaction_log_entry {
 	int debug_id;
 	int call_type;
@@ -200,6 +239,12 @@ static struct binder_transaction_log_entry *binder_transaction_log_add(
 	return e;
 }
 
+/* A scheduling policy and a kernel priority as in task->normal_prio */
+struct binder_priority {
+	unsigned int sched_policy;
+	int prio;
+};
+
 struct binder_work {
 	struct list_head entry;
 	enum {
@@ -234,6 +279,7 @@ struct binder_node {
 	unsigned accept_fds:1;
 	unsigned min_priority:8;
 	struct list_head async_todo;
+	struct binder_hist hist;
 };
 
 struct binder_ref_death {
@@ -270,11 +316,29 @@ struct binder_buffer {
 	struct binder_transaction *transaction;
 
 	struct binder_node *target_node;
+	int pid; /* of the sending proc */
 	size_t data_size;
 	size_t offsets_size;
 	uint8_t data[0];
 };
 
+/*
+ * A page of a proc's buffer area. Pages stay mapped in the kernel and
+ * in userspace when the buffers using them are freed; they are then
+ * kept on binder_lru until they are allocated again or the shrinker
+ * reclaims them.
+ */
+struct binder_lru_page {
+	struct list_head lru;
+	struct page *page_ptr;
+	struct binder_proc *proc;
+};
+
+static LIST_HEAD(binder_lru);
+static DEFINE_SPINLOCK(binder_lru_lock);
+static unsigned long binder_lru_count;
+static unsigned long binder_lru_to_scan;
+
 enum binder_deferred_state {
 	BINDER_DEFERRED_PUT_FILES    = 0x01,
 	BINDER_DEFERRED_FLUSH        = 0x02,
@@ -297,12 +361,21 @@ struct binder_proc {
 	void *buffer;
 	ptrdiff_t user_buffer_offset;
 
+	/*
+	 * alloc_lock protects the buffer allocator: buffers,
+	 * free_buffers, allocated_buffers, free_async_space,
+	 * async_throttled and pages.
+	 * It nests inside binder_main_lock, but senders also take it on
+	 * its own to allocate and fill a transaction buffer.
+	 */
+	struct mutex alloc_lock;
 	struct list_head buffers;
 	struct rb_root free_buffers;
 	struct rb_root allocated_buffers;
 	size_t free_async_space;
+	int async_throttled;
 
-	struct page **pages;
+	struct binder_lru_page *pages;
 	size_t buffer_size;
 	uint32_t buffer_free;
 	struct list_head todo;
@@ -313,8 +386,15 @@ struct binder_proc {
 	int requested_threads;
 	int requested_threads_started;
 	int ready_threads;
-	long default_priority;
+	struct binder_priority default_priority;
 	struct dentry *debugfs_entry;
+	/*
+	 * References that keep the allocator and the proc itself alive
+	 * after release, taken by senders that dropped binder_main_lock.
+	 * Both fields are protected by binder_main_lock.
+	 */
+	int tmp_ref;
+	int is_dead;
 };
 
 enum {
@@ -339,6 +419,7 @@ struct binder_thread {
 		/* we are also waiting on */
 	wait_queue_head_t wait;
 	struct binder_stats stats;
+	struct binder_hist hist;
 };
 
 struct binder_transaction {
@@ -355,13 +436,29 @@ struct binder_transaction {
 	struct binder_buffer *buffer;
 	unsigned int	code;
 	unsigned int	flags;
-	long	priority;
-	long	saved_priority;
+	struct binder_priority	priority;
+	struct binder_priority	saved_priority;
 	uid_t	sender_euid;
+	ktime_t	queue_time;
+	ktime_t	read_time;
 };
 
 static void
 binder_defer_work(struct binder_proc *proc, enum binder_deferred_state defer);
+static void binder_proc_dec_tmpref(struct binder_proc *proc);
+
+static void binder_hist_add(enum binder_hist_types type,
+			    struct binder_node *node,
+			    struct binder_thread *thread, s64 val)
+{
+	int i = val > 0 ? min(fls64(val), BINDER_HIST_BUCKETS - 1) : 0;
+
+	this_cpu_inc(binder_hist.bucket[type][i]);
+	if (node)
+		node->hist.bucket[type][i]++;
+	if (thread)
+		thread->hist.bucket[type][i]++;
+}
 
 /*
  * copied from get_unused_fd_flags
@@ -513,21 +610,97 @@ static inline void binder_unlock(const char *tag)
 	mutex_unlock(&binder_main_lock);
 }
 
-static void binder_set_nice(long nice)
+static bool binder_is_rt_policy(unsigned int policy)
+{
+	return policy == SCHED_FIFO || policy == SCHED_RR;
+}
+
+static bool binder_is_fair_policy(unsigned int policy)
+{
+	return policy == SCHED_NORMAL || policy == SCHED_BATCH;
+}
+
+/* Kernel priorities are 0..MAX_RT_PRIO-1 for RT, then nice -20..19 */
+static int binder_to_userspace_prio(unsigned int policy, int prio)
 {
-	long min_nice;
-	if (can_nice(current, nice)) {
-		set_user_nice(current, nice);
+	if (binder_is_fair_policy(policy))
+		return prio - MAX_RT_PRIO - 20;
+	return MAX_USER_RT_PRIO - 1 - prio;
+}
+
+static int binder_to_kernel_prio(unsigned int policy, int prio)
+{
+	if (binder_is_fair_policy(policy))
+		return prio + MAX_RT_PRIO + 20;
+	return MAX_USER_RT_PRIO - 1 - prio;
+}
+
+static struct binder_priority binder_current_priority(void)
+{
+	struct binder_priority prio = {
+		.sched_policy = current->policy,
+		.prio = current->normal_prio,
+	};
+
+	return prio;
+}
+
+/*
+ * Move current to @desired. Without CAP_SYS_NICE the result is capped by
+ * RLIMIT_RTPRIO and RLIMIT_NICE, as if the thread had asked for it with
+ * sched_setscheduler() and setpriority().
+ */
+static void binder_set_priority(struct binder_priority desired)
+{
+	unsigned int policy = desired.sched_policy;
+	int priority = binder_to_userspace_prio(policy, desired.prio);
+	struct sched_param params;
+
+	if (current->policy == policy && current->normal_prio == desired.prio)
 		return;
-	}
-	min_nice = 20 - current->signal->rlim[RLIMIT_NICE].rlim_cur;
-	binder_debug(BINDER_DEBUG_PRIORITY_CAP,
-		     "binder: %d: nice value %ld not allowed use "
-		     "%ld instead\n", current->pid, nice, min_nice);
-	set_user_nice(current, min_nice);
-	if (min_nice < 20)
+
+	if (!binder_is_rt_policy(policy) && !binder_is_fair_policy(policy))
 		return;
-	binder_user_error("binder: %d RLIMIT_NICE not set\n", current->pid);
+
+	if (!has_capability_noaudit(current, CAP_SYS_NICE)) {
+		if (binder_is_rt_policy(policy)) {
+			unsigned long max_rtprio =
+				task_rlimit(current, RLIMIT_RTPRIO);
+
+			if (max_rtprio == 0) {
+				policy = SCHED_NORMAL;
+				priority = -20;
+			} else if (priority > max_rtprio) {
+				priority = max_rtprio;
+			}
+		}
+		if (binder_is_fair_policy(policy)) {
+			long min_nice = 20 - (long)min_t(unsigned long,
+				task_rlimit(current, RLIMIT_NICE), 40);
+
+			if (min_nice >= 20) {
+				binder_user_error("binder: %d RLIMIT_NICE not "
+						  "set\n", current->pid);
+				return;
+			}
+			if (priority < min_nice)
+				priority = min_nice;
+		}
+		if (policy != desired.sched_policy ||
+		    binder_to_kernel_prio(policy, priority) != desired.prio)
+			binder_debug(BINDER_DEBUG_PRIORITY_CAP,
+				     "binder: %d: priority %d:%d not allowed "
+				     "use %u:%d instead\n", current->pid,
+				     desired.sched_policy, desired.prio,
+				     policy, binder_to_kernel_prio(policy,
+								   priority));
+	}
+
+	params.sched_priority = binder_is_rt_policy(policy) ? priority : 0;
+	sched_setscheduler_nocheck(current, policy | SCHED_RESET_ON_FORK,
+				   &params);
+	if (binder_is_fair_policy(policy))
+		set_user_nice(current, priority);
 }
 
 static size_t binder_buffer_size(struct binder_proc *proc,
@@ -601,13 +774,15 @@ static void binder_insert_allocated_buffer(struct binder_proc *proc,
 static struct binder_buffer *binder_buffer_lookup(struct binder_proc *proc,
 						  void __user *user_ptr)
 {
-	struct rb_node *n = proc->allocated_buffers.rb_node;
+	struct rb_node *n;
 	struct binder_buffer *buffer;
 	struct binder_buffer *kern_ptr;
 
 	kern_ptr = user_ptr - proc->user_buffer_offset
 		- offsetof(struct binder_buffer, data);
 
+	mutex_lock(&proc->alloc_lock);
+	n = proc->allocated_buffers.rb_node;
 	while (n) {
 		buffer = rb_entry(n, struct binder_buffer, rb_node);
 		BUG_ON(buffer->free);
@@ -617,9 +792,29 @@ static struct binder_buffer *binder_buffer_lookup(struct binder_proc *proc,
 		else if (kern_ptr > buffer)
 			n = n->rb_right;
 		else
-			return buffer;
+			break;
 	}
-	return NULL;
+	mutex_unlock(&proc->alloc_lock);
+	return n ? buffer : NULL;
+}
+
+static void binder_lru_add(struct binder_lru_page *page)
+{
+	BUG_ON(!page->page_ptr);
+	spin_lock(&binder_lru_lock);
+	BUG_ON(!list_empty(&page->lru));
+	list_add_tail(&page->lru, &binder_lru);
+	binder_lru_count++;
+	spin_unlock(&binder_lru_lock);
+}
+
+static void binder_lru_del(struct binder_lru_page *page)
+{
+	spin_lock(&binder_lru_lock);
+	BUG_ON(list_empty(&page->lru));
+	list_del_init(&page->lru);
+	binder_lru_count--;
+	spin_unlock(&binder_lru_lock);
 }
 
 static int binder_update_page_range(struct binder_proc *proc, int allocate,
@@ -629,8 +824,9 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 	void *page_addr;
 	unsigned long user_page_addr;
 	struct vm_struct tmp_area;
-	struct page **page;
-	struct mm_struct *mm;
+	struct binder_lru_page *page;
+	struct mm_struct *mm = NULL;
+	int need_map = 0;
 
 	binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
 		     "binder: %d: %s pages %p-%p\n", proc->pid,
@@ -641,9 +837,19 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 
 	trace_binder_update_page_range(proc, allocate, start, end);
 
-	if (vma)
-		mm = NULL;
-	else
+	if (allocate == 0)
+		goto free_range;
+
+	for (page_addr = start; page_addr < end; page_addr += PAGE_SIZE) {
+		page = &proc->pages[(page_addr - proc->buffer) / PAGE_SIZE];
+		if (!page->page_ptr) {
+			need_map = 1;
+			break;
+		}
+	}
+
+	/* Only pages that are not still mapped need the mm */
+	if (need_map && !vma)
 		mm = get_task_mm(proc->tsk);
 
 	if (mm) {
@@ -656,10 +862,7 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 		}
 	}
 
-	if (allocate == 0)
-		goto free_range;
-
-	if (vma == NULL) {
+	if (need_map && vma == NULL) {
 		printk(KERN_ERR "binder: %d: binder_alloc_buf failed to "
 		       "map pages in userspace, no vma\n", proc->pid);
 		goto err_no_vma;
@@ -670,16 +873,19 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 		struct page **page_array_ptr;
 		page = &proc->pages[(page_addr - proc->buffer) / PAGE_SIZE];
 
-		BUG_ON(*page);
-		*page = alloc_page(GFP_KERNEL | __GFP_ZERO);
-		if (*page == NULL) {
+		if (page->page_ptr) {
+			binder_lru_del(page);
+			continue;
+		}
+		page->page_ptr = alloc_page(GFP_KERNEL | __GFP_ZERO);
+		if (page->page_ptr == NULL) {
 			printk(KERN_ERR "binder: %d: binder_alloc_buf failed "
 			       "for page at %p\n", proc->pid, page_addr);
 			goto err_alloc_page_failed;
 		}
 		tmp_area.addr = page_addr;
 		tmp_area.size = PAGE_SIZE + PAGE_SIZE /* guard page? */;
-		page_array_ptr = page;
+		page_array_ptr = &page->page_ptr;
 		ret = map_vm_area(&tmp_area, PAGE_KERNEL, &page_array_ptr);
 		if (ret) {
 			printk(KERN_ERR "binder: %d: binder_alloc_buf failed "
@@ -689,7 +895,7 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 		}
 		user_page_addr =
 			(uintptr_t)page_addr + proc->user_buffer_offset;
-		ret = vm_insert_page(vma, user_page_addr, page[0]);
+		ret = vm_insert_page(vma, user_page_addr, page->page_ptr);
 		if (ret) {
 			printk(KERN_ERR "binder: %d: binder_alloc_buf failed "
 			       "to map page at %lx in userspace\n",
@@ -705,19 +911,23 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 	return 0;
 
 free_range:
-	for (page_addr = end - PAGE_SIZE; page_addr >= start;
-	     page_addr -= PAGE_SIZE) {
-		page = &proc->pages[(page_addr - proc->buffer) / PAGE_SIZE];
-		if (vma)
-			zap_page_range(vma, (uintptr_t)page_addr +
-				proc->user_buffer_offset, PAGE_SIZE, NULL);
+	/* Keep the pages mapped for the next allocation */
+	for (page_addr = start; page_addr < end; page_addr += PAGE_SIZE)
+		binder_lru_add(&proc->pages[(page_addr - proc->buffer) /
+					    PAGE_SIZE]);
+	return 0;
+
 err_vm_insert_page_failed:
-		unmap_kernel_range((unsigned long)page_addr, PAGE_SIZE);
+	unmap_kernel_range((unsigned long)page_addr, PAGE_SIZE);
 err_map_kernel_failed:
-		__free_page(*page);
-		*page = NULL;
+	__free_page(page->page_ptr);
+	page->page_ptr = NULL;
 err_alloc_page_failed:
-		;
+	/* The part of the range that is mapped is free again */
+	while (page_addr > start) {
+		page_addr -= PAGE_SIZE;
+		binder_lru_add(&proc->pages[(page_addr - proc->buffer) /
+					    PAGE_SIZE]);
 	}
 err_no_vma:
 	if (mm) {
@@ -727,9 +937,139 @@ err_no_vma:
 	return -ENOMEM;
 }
 
-static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
-					      size_t data_size,
-					      size_t offsets_size, int is_async)
+/*
+ * Unmap and free one idle page. Called with proc->alloc_lock held and
+ * the page already taken off binder_lru. The user mapping can only be
+ * zapped under mmap_sem; if the mm cannot be reached while the vma may
+ * still exist, the page is put back.
+ */
+static void binder_lru_free_page(struct binder_lru_page *page)
+{
+	struct binder_proc *proc = page->proc;
+	void *page_addr = proc->buffer +
+		(page - proc->pages) * PAGE_SIZE;
+	struct vm_area_struct *vma = NULL;
+	struct mm_struct *mm;
+
+	mm = get_task_mm(proc->tsk);
+	if (mm) {
+		down_read(&mm->mmap_sem);
+		vma = proc->vma;
+		if (vma && mm != proc->vma_vm_mm)
+			goto err_keep_page;
+	} else if (proc->vma) {
+		goto err_keep_page;
+	}
+
+	binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
+		     "binder: %d: reclaim page at %p\n", proc->pid, page_addr);
+	if (vma)
+		zap_page_range(vma, (uintptr_t)page_addr +
+			       proc->user_buffer_offset, PAGE_SIZE, NULL);
+	unmap_kernel_range((unsigned long)page_addr, PAGE_SIZE);
+	__free_page(page->page_ptr);
+	page->page_ptr = NULL;
+	goto out;
+
+err_keep_page:
+	binder_lru_add(page);
+out:
+	if (mm) {
+		up_read(&mm->mmap_sem);
+		mmput(mm);
+	}
+}
+
+/*
+ * Reclaim runs from a work item rather than from the shrinker itself,
+ * as it needs mmap_sem and may drop the last reference to an mm.
+ */
+static void binder_lru_work_func(struct work_struct *work)
+{
+	struct binder_lru_page *page;
+	struct binder_proc *proc;
+
+	spin_lock(&binder_lru_lock);
+	while (binder_lru_to_scan && !list_empty(&binder_lru)) {
+		binder_lru_to_scan--;
+		page = list_first_entry(&binder_lru, struct binder_lru_page,
+					lru);
+		proc = page->proc;
+		/* Held until done, this also keeps proc from being freed */
+		if (!mutex_trylock(&proc->alloc_lock)) {
+			list_move_tail(&page->lru, &binder_lru);
+			continue;
+		}
+		list_del_init(&page->lru);
+		binder_lru_count--;
+		spin_unlock(&binder_lru_lock);
+
+		binder_lru_free_page(page);
+		mutex_unlock(&proc->alloc_lock);
+		cond_resched();
+
+		spin_lock(&binder_lru_lock);
+	}
+	binder_lru_to_scan = 0;
+	spin_unlock(&binder_lru_lock);
+}
+static DECLARE_WORK(binder_lru_work, binder_lru_work_func);
+
+static int binder_shrink(struct shrinker *shrinker, struct shrink_control *sc)
+{
+	unsigned long count;
+
+	spin_lock(&binder_lru_lock);
+	if (sc->nr_to_scan)
+		binder_lru_to_scan = min(binder_lru_to_scan + sc->nr_to_scan,
+					 binder_lru_count);
+	count = binder_lru_count;
+	spin_unlock(&binder_lru_lock);
+
+	if (sc->nr_to_scan && count)
+		schedule_work(&binder_lru_work);
+	return min_t(unsigned long, count, INT_MAX);
+}
+
+static struct shrinker binder_shrinker = {
+	.shrink = binder_shrink,
+	.seeks = DEFAULT_SEEKS,
+};
+
+/*
+ * Would @pid hold more than its share of @proc's async space with @size
+ * more?  Only looked into once the space in use gets past that share.
+ */
+static bool binder_async_over_quota(struct binder_proc *proc, int pid,
+				    size_t size)
+{
+	size_t async_space = proc->buffer_size / 2;
+	size_t limit, held = size;
+	struct rb_node *n;
+
+	if (binder_async_sender_percent >= 100)
+		return false;
+	limit = async_space / 100 * binder_async_sender_percent;
+	if (async_space - proc->free_async_space + size <= limit)
+		return false;
+
+	for (n = rb_first(&proc->allocated_buffers); n; n = rb_next(n)) {
+		struct binder_buffer *buffer = rb_entry(n, struct binder_buffer,
+							rb_node);
+
+		if (!buffer->async_transaction || buffer->pid != pid)
+			continue;
+		held += ALIGN(buffer->data_size, sizeof(void *)) +
+			ALIGN(buffer->offsets_size, sizeof(void *)) +
+			sizeof(struct binder_buffer);
+	}
+	return held > limit;
+}
+
+static struct binder_buffer *__binder_alloc_buf(struct binder_proc *proc,
+						size_t data_size,
+						size_t offsets_size,
+						int is_async, int pid)
 {
 	struct rb_node *n = proc->free_buffers.rb_node;
 	struct binder_buffer *buffer;
@@ -762,6 +1102,16 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 		return NULL;
 	}
 
+	if (is_async && binder_async_over_quota(proc, pid,
+					size + sizeof(struct binder_buffer))) {
+		proc->async_throttled++;
+		if (printk_ratelimit())
+			printk(KERN_INFO "binder: %d: oneway transaction "
+			       "from %d throttled, sender over its share of "
+			       "the async space\n", proc->pid, pid);
+		return NULL;
+	}
+
 	while (n) {
 		buffer = rb_entry(n, struct binder_buffer, rb_node);
 		BUG_ON(!buffer->free);
@@ -822,6 +1172,9 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 	buffer->data_size = data_size;
 	buffer->offsets_size = offsets_size;
 	buffer->async_transaction = is_async;
+	buffer->pid = pid;
+	/* Not visible to BC_FREE_BUFFER until it has been delivered */
+	buffer->allow_user_free = 0;
 	if (is_async) {
 		proc->free_async_space -= size + sizeof(struct binder_buffer);
 		binder_debug(BINDER_DEBUG_BUFFER_ALLOC_ASYNC,
@@ -833,6 +1186,20 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 	return buffer;
 }
 
+static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
+					      size_t data_size,
+					      size_t offsets_size, int is_async,
+					      int pid)
+{
+	struct binder_buffer *buffer;
+
+	mutex_lock(&proc->alloc_lock);
+	buffer = __binder_alloc_buf(proc, data_size, offsets_size, is_async,
+				    pid);
+	mutex_unlock(&proc->alloc_lock);
+	return buffer;
+}
+
 static void *buffer_start_page(struct binder_buffer *buffer)
 {
 	return (void *)((uintptr_t)buffer & PAGE_MASK);
@@ -890,8 +1257,8 @@ static void binder_delete_free_buffer(struct binder_proc *proc,
 	}
 }
 
-static void binder_free_buf(struct binder_proc *proc,
-			    struct binder_buffer *buffer)
+static void __binder_free_buf(struct binder_proc *proc,
+			      struct binder_buffer *buffer)
 {
 	size_t size, buffer_size;
 
@@ -945,6 +1312,14 @@ static void binder_free_buf(struct binder_proc *proc,
 	binder_insert_free_buffer(proc, buffer);
 }
 
+static void binder_free_buf(struct binder_proc *proc,
+			    struct binder_buffer *buffer)
+{
+	mutex_lock(&proc->alloc_lock);
+	__binder_free_buf(proc, buffer);
+	mutex_unlock(&proc->alloc_lock);
+}
+
 static struct binder_node *binder_get_node(struct binder_proc *proc,
 					   void __user *ptr)
 {
@@ -1397,13 +1772,34 @@ static void binder_transaction_buffer_release(struct binder_proc *proc,
 	}
 }
 
+/*
+ * A nested call goes to the thread of the target process that is
+ * already waiting further down our transaction stack, if there is one.
+ */
+static struct binder_thread *
+binder_nested_target_thread(struct binder_thread *thread,
+			    struct binder_proc *target_proc)
+{
+	struct binder_transaction *tmp = thread->transaction_stack;
+	struct binder_thread *target_thread = NULL;
+
+	while (tmp) {
+		if (tmp->from && tmp->from->proc == target_proc)
+			target_thread = tmp->from;
+		tmp = tmp->from_parent;
+	}
+	return target_thread;
+}
+
 static void binder_transaction(struct binder_proc *proc,
 			       struct binder_thread *thread,
 			       struct binder_transaction_data *tr, int reply)
 {
 	struct binder_transaction *t;
 	struct binder_work *tcomplete;
+	struct binder_buffer *buffer;
 	size_t *offp, *off_end;
+	int copy_failed = 0;
 	struct binder_proc *target_proc;
 	struct binder_thread *target_thread = NULL;
 	struct binder_node *target_node = NULL;
@@ -1430,7 +1826,7 @@ static void binder_transaction(struct binder_proc *proc,
 			return_error = BR_FAILED_REPLY;
 			goto err_empty_call_stack;
 		}
-		binder_set_nice(in_reply_to->saved_priority);
+		binder_set_priority(in_reply_to->saved_priority);
 		if (in_reply_to->to_thread != thread) {
 			binder_user_error("binder: %d:%d got reply transaction "
 				"with bad transaction stack,"
@@ -1503,21 +1899,8 @@ static void binder_transaction(struct binder_proc *proc,
 				return_error = BR_FAILED_REPLY;
 				goto err_bad_call_stack;
 			}
-			while (tmp) {
-				if (tmp->from && tmp->from->proc == target_proc)
-					target_thread = tmp->from;
-				tmp = tmp->from_parent;
-			}
 		}
 	}
-	if (target_thread) {
-		e->to_thread = target_thread->pid;
-		target_list = &target_thread->todo;
-		target_wait = &target_thread->wait;
-	} else {
-		target_list = &target_proc->todo;
-		target_wait = &target_proc->wait;
-	}
 	e->to_proc = target_proc->pid;
 
 	/* TODO: reuse incoming transaction for reply */
@@ -1564,38 +1947,98 @@ static void binder_transaction(struct binder_proc *proc,
 	t->to_thread = target_thread;
 	t->code = tr->code;
 	t->flags = tr->flags;
-	t->priority = task_nice(current);
+	t->priority = binder_current_priority();
 
 	trace_binder_transaction(reply, t, target_node);
 
-	t->buffer = binder_alloc_buf(target_proc, tr->data_size,
-		tr->offsets_size, !reply && (t->flags & TF_ONE_WAY));
-	if (t->buffer == NULL) {
+	/*
+	 * Allocating the buffer, which may have to map new pages, and
+	 * copying the payload into it only need the target's allocator,
+	 * so do both without binder_main_lock. The node and the proc are
+	 * pinned meanwhile; a buffer that has not been delivered is not
+	 * visible to anyone else.
+	 */
+	if (target_node)
+		binder_inc_node(target_node, 1, 0, NULL);
+	target_proc->tmp_ref++;
+	binder_unlock(__func__);
+
+	buffer = binder_alloc_buf(target_proc, tr->data_size,
+		tr->offsets_size, !reply && (t->flags & TF_ONE_WAY), proc->pid);
+	if (buffer) {
+		offp = (size_t *)(buffer->data +
+				  ALIGN(tr->data_size, sizeof(void *)));
+		if (copy_from_user(buffer->data, tr->data.ptr.buffer,
+				   tr->data_size))
+			copy_failed = 1;
+		else if (copy_from_user(offp, tr->data.ptr.offsets,
+					tr->offsets_size))
+			copy_failed = 2;
+	}
+
+	binder_lock(__func__);
+
+	if (target_proc->is_dead) {
+		/*
+		 * Release dropped the local references on the target's
+		 * nodes and may have freed target_node, so only the buffer
+		 * is left to undo.
+		 */
+		if (buffer)
+			binder_free_buf(target_proc, buffer);
+		return_error = BR_DEAD_REPLY;
+		goto err_release_target;
+	}
+	if (buffer == NULL) {
 		return_error = BR_FAILED_REPLY;
 		goto err_binder_alloc_buf_failed;
 	}
-	t->buffer->allow_user_free = 0;
+	t->buffer = buffer;
 	t->buffer->debug_id = t->debug_id;
 	t->buffer->transaction = t;
 	t->buffer->target_node = target_node;
 	trace_binder_transaction_alloc_buf(t->buffer);
-	if (target_node)
-		binder_inc_node(target_node, 1, 0, NULL);
 
-	offp = (size_t *)(t->buffer->data + ALIGN(tr->data_size, sizeof(void *)));
-
-	if (copy_from_user(t->buffer->data, tr->data.ptr.buffer, tr->data_size)) {
+	if (copy_failed) {
 		binder_user_error("binder: %d:%d got transaction with invalid "
-			"data ptr\n", proc->pid, thread->pid);
+			"%s ptr\n", proc->pid, thread->pid,
+			copy_failed == 1 ? "data" : "offsets");
 		return_error = BR_FAILED_REPLY;
 		goto err_copy_data_failed;
 	}
-	if (copy_from_user(offp, tr->data.ptr.offsets, tr->offsets_size)) {
-		binder_user_error("binder: %d:%d got transaction with invalid "
-			"offsets ptr\n", proc->pid, thread->pid);
-		return_error = BR_FAILED_REPLY;
-		goto err_copy_data_failed;
+
+	/* Re-validate the target thread, it may have gone meanwhile */
+	if (reply) {
+		if (in_reply_to->from != target_thread) {
+			return_error = BR_DEAD_REPLY;
+			goto err_copy_data_failed;
+		}
+		if (target_thread->transaction_stack != in_reply_to) {
+			binder_user_error("binder: %d:%d got reply transaction "
+				"with bad target transaction stack %d, "
+				"expected %d\n",
+				proc->pid, thread->pid,
+				target_thread->transaction_stack ?
+				target_thread->transaction_stack->debug_id : 0,
+				in_reply_to->debug_id);
+			return_error = BR_FAILED_REPLY;
+			in_reply_to = NULL;
+			goto err_copy_data_failed;
+		}
+	} else if (!(tr->flags & TF_ONE_WAY) && thread->transaction_stack) {
+		target_thread = binder_nested_target_thread(thread,
+							    target_proc);
+	}
+	if (target_thread) {
+		e->to_thread = target_thread->pid;
+		target_list = &target_thread->todo;
+		target_wait = &target_thread->wait;
+	} else {
+		target_list = &target_proc->todo;
+		target_wait = &target_proc->wait;
 	}
+	t->to_thread = target_thread;
+
 	if (!IS_ALIGNED(tr->offsets_size, sizeof(size_t))) {
 		binder_user_error("binder: %d:%d got transaction with "
 			"invalid offsets size, %zd\n",
@@ -1746,7 +2189,18 @@ static void binder_transaction(struct binder_proc *proc,
 			goto err_bad_object_type;
 		}
 	}
+	binder_hist_add(BINDER_HIST_SIZE, target_node, thread,
+			t->buffer->data_size + t->buffer->offsets_size);
+	t->queue_time = ktime_get();
 	if (reply) {
+		s64 usecs = ktime_us_delta(t->queue_time,
+					   in_reply_to->read_time);
+
+		/* Without its buffer the node may be gone already */
+		trace_binder_reply_latency(in_reply_to, usecs);
+		binder_hist_add(BINDER_HIST_REPLY, in_reply_to->buffer ?
+				in_reply_to->buffer->target_node : NULL,
+				thread, usecs);
 		BUG_ON(t->buffer->async_transaction != 0);
 		binder_pop_transaction(target_thread, in_reply_to);
 	} else if (!(t->flags & TF_ONE_WAY)) {
@@ -1769,6 +2223,7 @@ static void binder_transaction(struct binder_proc *proc,
 	list_add_tail(&tcomplete->entry, &thread->todo);
 	if (target_wait)
 		wake_up_interruptible(target_wait);
+	binder_proc_dec_tmpref(target_proc);
 	return;
 
 err_get_unused_fd_failed:
@@ -1784,7 +2239,12 @@ err_copy_data_failed:
 	binder_transaction_buffer_release(target_proc, t->buffer, offp);
 	t->buffer->transaction = NULL;
 	binder_free_buf(target_proc, t->buffer);
+	goto err_release_target;
 err_binder_alloc_buf_failed:
+	if (target_node)
+		binder_dec_node(target_node, 1, 0);
+err_release_target:
+	binder_proc_dec_tmpref(target_proc);
 	kfree(tcomplete);
 	binder_stats_deleted(BINDER_STAT_TRANSACTION_COMPLETE);
 err_alloc_tcomplete_failed:
@@ -1815,6 +2275,26 @@ err_no_context_mgr_node:
 		thread->return_error = return_error;
 }
 
+/*
+ * Pick the next oneway transaction of @node, the first one not sent by
+ * @pid if there is one, so that one sender flooding the node does not
+ * keep the others waiting behind all of its transactions.
+ */
+static struct binder_work *binder_next_async_work(struct binder_node *node,
+						  int pid)
+{
+	struct binder_work *w;
+
+	list_for_each_entry(w, &node->async_todo, entry) {
+		struct binder_transaction *t;
+
+		t = container_of(w, struct binder_transaction, work);
+		if (t->buffer && t->buffer->pid != pid)
+			return w;
+	}
+	return list_first_entry(&node->async_todo, struct binder_work, entry);
+}
+
 int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 			void __user *buffer, int size, signed long *consumed)
 {
@@ -1994,7 +2474,10 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 				if (list_empty(&buffer->target_node->async_todo))
 					buffer->target_node->has_async_transaction = 0;
 				else
-					list_move_tail(buffer->target_node->async_todo.next, &thread->todo);
+					list_move_tail(&binder_next_async_work(
+						buffer->target_node,
+						buffer->pid)->entry,
+						&thread->todo);
 			}
 			trace_binder_transaction_buffer_release(buffer);
 			binder_transaction_buffer_release(proc, buffer, NULL);
@@ -2285,7 +2768,7 @@ retry:
 			wait_event_interruptible(binder_user_error_wait,
 						 binder_stop_on_user_error < 2);
 		}
-		binder_set_nice(proc->default_priority);
+		binder_set_priority(proc->default_priority);
 		if (non_block) {
 			if (!binder_has_proc_work(proc, thread))
 				ret = -EAGAIN;
@@ -2313,6 +2796,7 @@ retry:
 		struct binder_transaction_data tr;
 		struct binder_work *w;
 		struct binder_transaction *t = NULL;
+		s64 usecs;
 
 		if (!list_empty(&thread->todo))
 			w = list_first_entry(&thread->todo, struct binder_work, entry);
@@ -2451,13 +2935,24 @@ retry:
 			struct binder_node *target_node = t->buffer->target_node;
 			tr.target.ptr = target_node->ptr;
 			tr.cookie =  target_node->cookie;
-			t->saved_priority = task_nice(current);
-			if (t->priority < target_node->min_priority &&
-			    !(t->flags & TF_ONE_WAY))
-				binder_set_nice(t->priority);
+			struct binder_priority node_prio = {
+				.sched_policy = SCHED_NORMAL,
+				.prio = binder_to_kernel_prio(SCHED_NORMAL,
+						target_node->min_priority),
+			};
+
+			/*
+			 * Synchronous calls run at the caller's policy and
+			 * priority, but never below the node's minimum;
+			 * one-way calls only get the node's minimum.
+			 */
+			t->saved_priority = binder_current_priority();
+			if (!(t->flags & TF_ONE_WAY) &&
+			    t->priority.prio < node_prio.prio)
+				binder_set_priority(t->priority);
 			else if (!(t->flags & TF_ONE_WAY) ||
-				 t->saved_priority > target_node->min_priority)
-				binder_set_nice(target_node->min_priority);
+				 t->saved_priority.prio > node_prio.prio)
+				binder_set_priority(node_prio);
 			cmd = BR_TRANSACTION;
 		} else {
 			tr.target.ptr = NULL;
@@ -2493,6 +2988,11 @@ retry:
 
 		trace_binder_transaction_received(t);
 		binder_stat_br(proc, thread, cmd);
+		t->read_time = ktime_get();
+		usecs = ktime_us_delta(t->read_time, t->queue_time);
+		trace_binder_queue_latency(t, usecs);
+		binder_hist_add(BINDER_HIST_QUEUE, cmd == BR_TRANSACTION ?
+				t->buffer->target_node : NULL, thread, usecs);
 		binder_debug(BINDER_DEBUG_TRANSACTION,
 			     "binder: %d:%d %s %d %d:%d, cmd %d"
 			     "size %zd-%zd ptr %p-%p\n",
@@ -2841,6 +3341,8 @@ static int binder_mmap(struct file *filp, struct vm_area_struct *vma)
 	struct binder_proc *proc = filp->private_data;
 	const char *failure_string;
 	struct binder_buffer *buffer;
+	void *prealloc_end;
+	int i;
 
 	if ((vma->vm_end - vma->vm_start) > SZ_4M)
 		vma->vm_end = vma->vm_start + SZ_4M;
@@ -2890,6 +3392,10 @@ static int binder_mmap(struct file *filp, struct vm_area_struct *vma)
 		goto err_alloc_pages_failed;
 	}
 	proc->buffer_size = vma->vm_end - vma->vm_start;
+	for (i = 0; i < proc->buffer_size / PAGE_SIZE; i++) {
+		INIT_LIST_HEAD(&proc->pages[i].lru);
+		proc->pages[i].proc = proc;
+	}
 
 	vma->vm_ops = &binder_vm_ops;
 	vma->vm_private_data = proc;
@@ -2899,6 +3405,18 @@ static int binder_mmap(struct file *filp, struct vm_area_struct *vma)
 		failure_string = "alloc small buf";
 		goto err_alloc_small_buf_failed;
 	}
+	/*
+	 * Best effort: the shrinker cannot reclaim these before mmap_sem
+	 * is released, and by then proc->vma is set.
+	 */
+	prealloc_end = proc->buffer + PAGE_SIZE *
+		min_t(size_t, binder_prealloc_pages,
+		      proc->buffer_size / PAGE_SIZE);
+	if (prealloc_end > proc->buffer + PAGE_SIZE &&
+	    !binder_update_page_range(proc, 1, proc->buffer + PAGE_SIZE,
+				      prealloc_end, vma))
+		binder_update_page_range(proc, 0, proc->buffer + PAGE_SIZE,
+					 prealloc_end, NULL);
 	buffer = proc->buffer;
 	INIT_LIST_HEAD(&proc->buffers);
 	list_add(&buffer->entry, &proc->buffers);
@@ -2944,7 +3462,9 @@ static int binder_open(struct inode *nodp, struct file *filp)
 	proc->tsk = current;
 	INIT_LIST_HEAD(&proc->todo);
 	init_waitqueue_head(&proc->wait);
-	proc->default_priority = task_nice(current);
+	mutex_init(&proc->alloc_lock);
+	proc->tmp_ref = 1;
+	proc->default_priority = binder_current_priority();
 
 	binder_lock(__func__);
 
@@ -3006,9 +3526,8 @@ static int binder_release(struct inode *nodp, struct file *filp)
 static void binder_deferred_release(struct binder_proc *proc)
 {
 	struct hlist_node *pos;
-	struct binder_transaction *t;
 	struct rb_node *n;
-	int threads, nodes, incoming_refs, outgoing_refs, buffers, active_transactions, page_count;
+	int threads, nodes, incoming_refs, outgoing_refs, active_transactions;
 
 	BUG_ON(proc->vma);
 	BUG_ON(proc->files);
@@ -3074,8 +3593,29 @@ static void binder_deferred_release(struct binder_proc *proc)
 		binder_delete_ref(ref);
 	}
 	binder_release_work(&proc->todo);
-	buffers = 0;
 
+	binder_debug(BINDER_DEBUG_OPEN_CLOSE,
+		     "binder_release: %d threads %d, nodes %d (ref %d), "
+		     "refs %d, active transactions %d\n",
+		     proc->pid, threads, nodes, incoming_refs, outgoing_refs,
+		     active_transactions);
+
+	proc->is_dead = 1;
+	binder_proc_dec_tmpref(proc); /* may free proc */
+}
+
+/*
+ * Tear down the buffer allocator and free the proc once the last
+ * sender that was filling one of its buffers is done.
+ */
+static void binder_free_proc(struct binder_proc *proc)
+{
+	struct binder_transaction *t;
+	struct rb_node *n;
+	int buffers, page_count;
+
+	buffers = 0;
+	mutex_lock(&proc->alloc_lock);
 	while ((n = rb_first(&proc->allocated_buffers))) {
 		struct binder_buffer *buffer = rb_entry(n, struct binder_buffer,
 							rb_node);
@@ -3088,18 +3628,19 @@ static void binder_deferred_release(struct binder_proc *proc)
 			       proc->pid, t->debug_id);
 			/*BUG();*/
 		}
-		binder_free_buf(proc, buffer);
+		__binder_free_buf(proc, buffer);
 		buffers++;
 	}
 
-	binder_stats_deleted(BINDER_STAT_PROC);
-
 	page_count = 0;
 	if (proc->pages) {
 		int i;
 		for (i = 0; i < proc->buffer_size / PAGE_SIZE; i++) {
-			if (proc->pages[i]) {
+			if (proc->pages[i].page_ptr) {
 				void *page_addr = proc->buffer + i * PAGE_SIZE;
+				/* Pages holding buffer headers are not idle */
+				if (!list_empty(&proc->pages[i].lru))
+					binder_lru_del(&proc->pages[i]);
 				binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
 					     "binder_release: %d: "
 					     "page %d at %p not freed\n",
@@ -3107,26 +3648,33 @@ static void binder_deferred_release(struct binder_proc *proc)
 					     page_addr);
 				unmap_kernel_range((unsigned long)page_addr,
 					PAGE_SIZE);
-				__free_page(proc->pages[i]);
+				__free_page(proc->pages[i].page_ptr);
 				page_count++;
 			}
 		}
 		kfree(proc->pages);
 		vfree(proc->buffer);
 	}
+	mutex_unlock(&proc->alloc_lock);
+
+	binder_stats_deleted(BINDER_STAT_PROC);
 
 	put_task_struct(proc->tsk);
 
 	binder_debug(BINDER_DEBUG_OPEN_CLOSE,
-		     "binder_release: %d threads %d, nodes %d (ref %d), "
-		     "refs %d, active transactions %d, buffers %d, "
-		     "pages %d\n",
-		     proc->pid, threads, nodes, incoming_refs, outgoing_refs,
-		     active_transactions, buffers, page_count);
+		     "binder_release: %d buffers %d, pages %d\n",
+		     proc->pid, buffers, page_count);
 
 	kfree(proc);
 }
 
+static void binder_proc_dec_tmpref(struct binder_proc *proc)
+{
+	BUG_ON(proc->tmp_ref <= 0);
+	if (--proc->tmp_ref == 0)
+		binder_free_proc(proc);
+}
+
 static void binder_deferred_func(struct work_struct *work)
 {
 	struct binder_proc *proc;
@@ -3159,7 +3707,7 @@ static void binder_deferred_func(struct work_struct *work)
 			binder_deferred_flush(proc);
 
 		if (defer & BINDER_DEFERRED_RELEASE)
-			binder_deferred_release(proc); /* frees proc */
+			binder_deferred_release(proc); /* may free proc */
 
 		binder_unlock(__func__);
 		if (files)
@@ -3185,13 +3733,14 @@ static void print_binder_transaction(struct seq_file *m, const char *prefix,
 				     struct binder_transaction *t)
 {
 	seq_printf(m,
-		   "%s %d: %p from %d:%d to %d:%d code %x flags %x pri %ld r%d",
+		   "%s %d: %p from %d:%d to %d:%d code %x flags %x pri %u:%d r%d",
 		   prefix, t->debug_id, t,
 		   t->from ? t->from->proc->pid : 0,
 		   t->from ? t->from->pid : 0,
 		   t->to_proc ? t->to_proc->pid : 0,
 		   t->to_thread ? t->to_thread->pid : 0,
-		   t->code, t->flags, t->priority, t->need_reply);
+		   t->code, t->flags, t->priority.sched_policy,
+		   t->priority.prio, t->need_reply);
 	if (t->buffer == NULL) {
 		seq_puts(m, " buffer free\n");
 		return;
@@ -3207,10 +3756,11 @@ static void print_binder_transaction(struct seq_file *m, const char *prefix,
 static void print_binder_buffer(struct seq_file *m, const char *prefix,
 				struct binder_buffer *buffer)
 {
-	seq_printf(m, "%s %d: %p size %zd:%zd %s\n",
+	seq_printf(m, "%s %d: %p size %zd:%zd %s%s from %d\n",
 		   prefix, buffer->debug_id, buffer->data,
 		   buffer->data_size, buffer->offsets_size,
-		   buffer->transaction ? "active" : "delivered");
+		   buffer->async_transaction ? "async " : "",
+		   buffer->transaction ? "active" : "delivered", buffer->pid);
 }
 
 static void print_binder_work(struct seq_file *m, const char *prefix,
@@ -3342,9 +3892,11 @@ static void print_binder_proc(struct seq_file *m,
 			print_binder_ref(m, rb_entry(n, struct binder_ref,
 						     rb_node_desc));
 	}
+	mutex_lock(&proc->alloc_lock);
 	for (n = rb_first(&proc->allocated_buffers); n != NULL; n = rb_next(n))
 		print_binder_buffer(m, "  buffer",
 				    rb_entry(n, struct binder_buffer, rb_node));
+	mutex_unlock(&proc->alloc_lock);
 	list_for_each_entry(w, &proc->todo, entry)
 		print_binder_work(m, "  ", "  pending transaction", w);
 	list_for_each_entry(w, &proc->delivered_death, entry) {
@@ -3445,7 +3997,7 @@ static void print_binder_proc_stats(struct seq_file *m,
 {
 	struct binder_work *w;
 	struct rb_node *n;
-	int count, strong, weak;
+	int count, strong, weak, throttled;
 
 	seq_printf(m, "proc %d\n", proc->pid);
 	count = 0;
@@ -3474,9 +4026,13 @@ static void print_binder_proc_stats(struct seq_file *m,
 	seq_printf(m, "  refs: %d s %d w %d\n", count, strong, weak);
 
 	count = 0;
+	mutex_lock(&proc->alloc_lock);
 	for (n = rb_first(&proc->allocated_buffers); n != NULL; n = rb_next(n))
 		count++;
+	throttled = proc->async_throttled;
+	mutex_unlock(&proc->alloc_lock);
 	seq_printf(m, "  buffers: %d\n", count);
+	seq_printf(m, "  async throttled: %d\n", throttled);
 
 	count = 0;
 	list_for_each_entry(w, &proc->todo, entry) {
@@ -3538,6 +4094,86 @@ static int binder_stats_show(struct seq_file *m, void *unused)
 	return 0;
 }
 
+static const char * const binder_hist_strings[] = {
+	"queue_us",
+	"reply_us",
+	"size",
+};
+
+static void print_binder_hist(struct seq_file *m, const char *prefix,
+			      struct binder_hist *hist)
+{
+	int type, i;
+
+	BUILD_BUG_ON(ARRAY_SIZE(binder_hist_strings) != BINDER_HIST_COUNT);
+	for (type = 0; type < BINDER_HIST_COUNT; type++) {
+		int header = 0;
+
+		for (i = 0; i < BINDER_HIST_BUCKETS; i++) {
+			if (!hist->bucket[type][i])
+				continue;
+			if (!header) {
+				seq_printf(m, "%s%s:", prefix,
+					   binder_hist_strings[type]);
+				header = 1;
+			}
+			seq_printf(m, " %u:%u", i ? 1U << (i - 1) : 0,
+				   hist->bucket[type][i]);
+		}
+		if (header)
+			seq_puts(m, "\n");
+	}
+}
+
+static int binder_latency_show(struct seq_file *m, void *unused)
+{
+	struct binder_proc *proc;
+	struct binder_hist *total;
+	struct hlist_node *pos;
+	struct rb_node *n;
+	int do_lock = !binder_debug_no_lock;
+	int cpu, type, i;
+
+	total = kzalloc(sizeof(*total), GFP_KERNEL);
+	if (!total)
+		return -ENOMEM;
+	for_each_possible_cpu(cpu) {
+		struct binder_hist *hist = &per_cpu(binder_hist, cpu);
+
+		for (type = 0; type < BINDER_HIST_COUNT; type++)
+			for (i = 0; i < BINDER_HIST_BUCKETS; i++)
+				total->bucket[type][i] +=
+					hist->bucket[type][i];
+	}
+	seq_puts(m, "binder latency:\n");
+	print_binder_hist(m, "", total);
+	kfree(total);
+
+	if (do_lock)
+		binder_lock(__func__);
+	hlist_for_each_entry(proc, pos, &binder_procs, proc_node) {
+		seq_printf(m, "proc %d\n", proc->pid);
+		for (n = rb_first(&proc->nodes); n != NULL; n = rb_next(n)) {
+			struct binder_node *node = rb_entry(n,
+						struct binder_node, rb_node);
+
+			seq_printf(m, "  node %d: u%p c%p\n", node->debug_id,
+				   node->ptr, node->cookie);
+			print_binder_hist(m, "    ", &node->hist);
+		}
+		for (n = rb_first(&proc->threads); n != NULL; n = rb_next(n)) {
+			struct binder_thread *thread = rb_entry(n,
+						struct binder_thread, rb_node);
+
+			seq_printf(m, "  thread %d\n", thread->pid);
+			print_binder_hist(m, "    ", &thread->hist);
+		}
+	}
+	if (do_lock)
+		binder_unlock(__func__);
+	return 0;
+}
+
 static int binder_transactions_show(struct seq_file *m, void *unused)
 {
 	struct binder_proc *proc;
@@ -3613,6 +4249,7 @@ static struct miscdevice binder_miscdev = {
 BINDER_DEBUG_ENTRY(state);
 BINDER_DEBUG_ENTRY(stats);
 BINDER_DEBUG_ENTRY(transactions);
+BINDER_DEBUG_ENTRY(latency);
 BINDER_DEBUG_ENTRY(transaction_log);
 
 static int __init binder_init(void)
@@ -3628,6 +4265,8 @@ static int __init binder_init(void)
 		binder_debugfs_dir_entry_proc = debugfs_create_dir("proc",
 						 binder_debugfs_dir_entry_root);
 	ret = misc_register(&binder_miscdev);
+	if (!ret)
+		register_shrinker(&binder_shrinker);
 	if (binder_debugfs_dir_entry_root) {
 		debugfs_create_file("state",
 				    S_IRUGO,
@@ -3644,6 +4283,11 @@ static int __init binder_init(void)
 				    binder_debugfs_dir_entry_root,
 				    NULL,
 				    &binder_transactions_fops);
+		debugfs_create_file("latency",
+				    S_IRUGO,
+				    binder_debugfs_dir_entry_root,
+				    NULL,
+				    &binder_latency_fops);
 		debugfs_create_file("transaction_log",
 				    S_IRUGO,
 				    binder_debugfs_dir_entry_root,
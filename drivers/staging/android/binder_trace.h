@@ -144,6 +144,32 @@ TRACE_EVENT(binder_transaction_received,
 	TP_printk("transaction=%d", __entry->debug_id)
 );
 
+DECLARE_EVENT_CLASS(binder_latency_class,
+	TP_PROTO(struct binder_transaction *t, s64 usecs),
+	TP_ARGS(t, usecs),
+	TP_STRUCT__entry(
+		__field(int, debug_id)
+		__field(int, target_node)
+		__field(s64, usecs)
+	),
+	TP_fast_assign(
+		__entry->debug_id = t->debug_id;
+		__entry->target_node = t->buffer && t->buffer->target_node ?
+				       t->buffer->target_node->debug_id : 0;
+		__entry->usecs = usecs;
+	),
+	TP_printk("transaction=%d dest_node=%d usecs=%lld",
+		  __entry->debug_id, __entry->target_node, __entry->usecs)
+);
+
+DEFINE_EVENT(binder_latency_class, binder_queue_latency,
+	TP_PROTO(struct binder_transaction *t, s64 usecs),
+	TP_ARGS(t, usecs));
+
+DEFINE_EVENT(binder_latency_class, binder_reply_latency,
+	TP_PROTO(struct binder_transaction *t, s64 usecs),
+	TP_ARGS(t, usecs));
+
 TRACE_EVENT(binder_transaction_node_to_ref,
 	TP_PROTO(struct binder_transaction *t, struct binder_node *node,
 		 struct binder_ref *ref),
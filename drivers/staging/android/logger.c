@@ -25,10 +25,32 @@
 #include <linux/poll.h>
 #include <linux/slab.h>
 #include <linux/time.h>
+#include <linux/percpu.h>
+#include <linux/mm.h>
 #include "logger.h"
 
 #include <asm/ioctls.h>
 
+/* size of each per-cpu staging ring, a power of two above the largest entry */
+#define LOGGER_STAGING_SIZE	8192
+
+/*
+ * struct logger_staging - a per-cpu ring that writers append entries to
+ *
+ * Writers that picked the same cpu serialize on 'mutex', nothing else.  The
+ * entries between 'head' and 'tail' are merged into the log by whoever holds
+ * log->mutex, without taking 'mutex': 'tail' is published once an entry is
+ * completely copied in and 'head' once it has been copied out.  Both are free
+ * running byte counts.
+ */
+struct logger_staging {
+	struct mutex		mutex;	/* serializes writers */
+	unsigned char		*buffer;/* the staging ring itself */
+	size_t			head;	/* first entry not merged yet */
+	size_t			tail;	/* end of the committed entries */
+	size_t			end;	/* 'tail' when the merge started */
+};
+
 /*
  * struct logger_log - represents a specific log, such as 'main' or 'radio'
  *
@@ -45,6 +67,8 @@ struct logger_log {
 	size_t			w_off;	/* current write head offset */
 	size_t			head;	/* new readers start here */
 	size_t			size;	/* size of the log */
+	struct logger_staging __percpu *staging; /* not yet merged entries */
+	struct logger_map_info	*map_info; /* positions for mmap() readers */
 };
 
 /*
@@ -58,6 +82,7 @@ struct logger_reader {
 	struct list_head	list;	/* entry in logger_log's list */
 	size_t			r_off;	/* current read head offset */
 	bool			r_all;	/* reader can read all entries */
+	bool			r_batch; /* read() returns as many as fit */
 	int			r_ver;	/* reader ABI version */
 };
 
@@ -239,6 +264,8 @@ static size_t get_next_entry_by_uid(struct logger_log *log,
 	return off;
 }
 
+static void merge_staging(struct logger_log *log);
+
 /*
  * logger_read - our log's read() method
  *
@@ -246,7 +273,8 @@ static size_t get_next_entry_by_uid(struct logger_log *log,
  *
  *	- O_NONBLOCK works
  *	- If there are no log entries to read, blocks until log is written to
- *	- Atomically reads exactly one log entry
+ *	- Atomically reads exactly one log entry, or after LOGGER_SET_BATCH as
+ *	  many whole entries as fit into the buffer
  *
  * Will set errno to EINVAL if read
  * buffer is insufficient to hold next entry.
@@ -265,6 +293,7 @@ start:
 
 		prepare_to_wait(&log->wq, &wait, TASK_INTERRUPTIBLE);
 
+		merge_staging(log);
 		ret = (log->w_off == reader->r_off);
 		mutex_unlock(&log->mutex);
 		if (!ret)
@@ -289,6 +318,7 @@ start:
 
 	mutex_lock(&log->mutex);
 
+	merge_staging(log);
 	if (!reader->r_all)
 		reader->r_off = get_next_entry_by_uid(log,
 			reader->r_off, current_euid());
@@ -310,6 +340,27 @@ start:
 	/* get exactly one entry from the log */
 	ret = do_read_log_to_user(log, reader, buf, ret);
 
+	/* in batch mode, append more entries while they fit */
+	while (reader->r_batch && ret > 0) {
+		ssize_t len, nr;
+
+		if (!reader->r_all)
+			reader->r_off = get_next_entry_by_uid(log,
+				reader->r_off, current_euid());
+		if (log->w_off == reader->r_off)
+			break;
+
+		len = get_user_hdr_len(reader->r_ver) +
+			get_entry_msg_len(log, reader->r_off);
+		if (count - ret < len)
+			break;
+
+		nr = do_read_log_to_user(log, reader, buf + ret, len);
+		if (nr < 0)
+			break;
+		ret += nr;
+	}
+
 out:
 	mutex_unlock(&log->mutex);
 
@@ -407,57 +458,160 @@ static void do_write_log(struct logger_log *log, const void *buf, size_t count)
 }
 
 /*
- * do_write_log_user - writes 'len' bytes from the user-space buffer 'buf' to
- * the log 'log'
+ * staging_read - copies 'count' bytes at free running offset 'off' out of the
+ * staging ring 'st' into 'buf'
+ */
+static void staging_read(struct logger_staging *st, size_t off, void *buf,
+			 size_t count)
+{
+	size_t o = off & (LOGGER_STAGING_SIZE - 1);
+	size_t len = min(count, LOGGER_STAGING_SIZE - o);
+
+	memcpy(buf, st->buffer + o, len);
+	if (count != len)
+		memcpy(buf + len, st->buffer, count - len);
+}
+
+/*
+ * staging_write - copies 'count' bytes from 'buf' into the staging ring 'st'
+ * at free running offset 'off'
  *
- * The caller needs to hold log->mutex.
+ * The caller needs to hold st->mutex.
+ */
+static void staging_write(struct logger_staging *st, size_t off,
+			  const void *buf, size_t count)
+{
+	size_t o = off & (LOGGER_STAGING_SIZE - 1);
+	size_t len = min(count, LOGGER_STAGING_SIZE - o);
+
+	memcpy(st->buffer + o, buf, len);
+	if (count != len)
+		memcpy(st->buffer, buf + len, count - len);
+}
+
+/*
+ * staging_write_from_user - copies 'count' bytes from the user-space buffer
+ * 'buf' into the staging ring 'st' at free running offset 'off'
+ *
+ * The caller needs to hold st->mutex.
  *
  * Returns 'count' on success, negative error code on failure.
  */
-static ssize_t do_write_log_from_user(struct logger_log *log,
-				      const void __user *buf, size_t count)
+static ssize_t staging_write_from_user(struct logger_staging *st, size_t off,
+				       const void __user *buf, size_t count)
 {
-	size_t len;
+	size_t o = off & (LOGGER_STAGING_SIZE - 1);
+	size_t len = min(count, LOGGER_STAGING_SIZE - o);
 
-	len = min(count, log->size - log->w_off);
-	if (len && copy_from_user(log->buffer + log->w_off, buf, len))
+	if (len && copy_from_user(st->buffer + o, buf, len))
 		return -EFAULT;
 
 	if (count != len)
-		if (copy_from_user(log->buffer, buf + len, count - len))
-			/*
-			 * Note that by not updating w_off, this abandons the
-			 * portion of the new entry that *was* successfully
-			 * copied, just above.  This is intentional to avoid
-			 * message corruption from missing fragments.
-			 */
+		if (copy_from_user(st->buffer, buf + len, count - len))
 			return -EFAULT;
 
-	log->w_off = logger_offset(log, log->w_off + count);
-
 	return count;
 }
 
+/*
+ * update_map_info - publishes the log's positions to mmap() readers
+ *
+ * The caller needs to hold log->mutex.
+ */
+static void update_map_info(struct logger_log *log)
+{
+	struct logger_map_info *info = log->map_info;
+
+	info->seq++;
+	smp_wmb();
+	info->w_off = log->w_off;
+	info->head = log->head;
+	smp_wmb();
+	info->seq++;
+}
+
+/*
+ * merge_staging - moves the entries committed to the per-cpu staging rings
+ * so far into the log, oldest timestamp first
+ *
+ * Entries a writer commits while this runs are left for the next merge, so
+ * ordering is by timestamp within one merge.
+ *
+ * The caller needs to hold log->mutex.
+ */
+static void merge_staging(struct logger_log *log)
+{
+	struct logger_staging *st, *best;
+	struct logger_entry entry, best_entry;
+	unsigned char *chunk;
+	size_t len, off;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		st = per_cpu_ptr(log->staging, cpu);
+		st->end = ACCESS_ONCE(st->tail);
+	}
+	/* pairs with the barrier before a writer publishes 'tail' */
+	smp_rmb();
+
+	for (;;) {
+		best = NULL;
+		for_each_possible_cpu(cpu) {
+			st = per_cpu_ptr(log->staging, cpu);
+			if (st->head == st->end)
+				continue;
+			staging_read(st, st->head, &entry, sizeof(entry));
+			if (best && (entry.sec > best_entry.sec ||
+				     (entry.sec == best_entry.sec &&
+				      entry.nsec >= best_entry.nsec)))
+				continue;
+			best = st;
+			best_entry = entry;
+		}
+		if (!best)
+			break;
+
+		len = sizeof(struct logger_entry) + best_entry.len;
+		fix_up_readers(log, len);
+
+		/* copy in at most two pieces, the staging ring may wrap */
+		off = best->head & (LOGGER_STAGING_SIZE - 1);
+		chunk = best->buffer + off;
+		if (off + len > LOGGER_STAGING_SIZE) {
+			do_write_log(log, chunk, LOGGER_STAGING_SIZE - off);
+			do_write_log(log, best->buffer,
+				     off + len - LOGGER_STAGING_SIZE);
+		} else {
+			do_write_log(log, chunk, len);
+		}
+
+		/* the entry must be copied out before writers reuse it */
+		smp_mb();
+		best->head += len;
+	}
+
+	if (log->map_info->w_off != log->w_off)
+		update_map_info(log);
+}
+
 /*
  * logger_aio_write - our write method, implementing support for write(),
  * writev(), and aio_write(). Writes are our fast path, and we try to optimize
- * them above all else.
+ * them above all else: entries go to a per-cpu staging ring and are merged
+ * into the log when a reader asks for them, or when the ring is full.
  */
 ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 			 unsigned long nr_segs, loff_t ppos)
 {
 	struct logger_log *log = file_get_log(iocb->ki_filp);
-	size_t orig = log->w_off;
+	struct logger_staging *st;
 	struct logger_entry header;
 	struct timespec now;
+	size_t off, total;
 	ssize_t ret = 0;
 
-	now = current_kernel_time();
-
 	header.pid = current->tgid;
 	header.tid = current->pid;
-	header.sec = now.tv_sec;
-	header.nsec = now.tv_nsec;
 	header.euid = current_euid();
 	header.len = min_t(size_t, iocb->ki_left, LOGGER_ENTRY_MAX_PAYLOAD);
 	header.hdr_size = sizeof(struct logger_entry);
@@ -466,17 +620,32 @@ ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 	if (unlikely(!header.len))
 		return 0;
 
-	mutex_lock(&log->mutex);
+	total = sizeof(struct logger_entry) + header.len;
 
-	/*
-	 * Fix up any readers, pulling them forward to the first readable
-	 * entry after (what will be) the new write offset. We do this now
-	 * because if we partially fail, we can end up with clobbered log
-	 * entries that encroach on readable buffer.
-	 */
-	fix_up_readers(log, sizeof(struct logger_entry) + header.len);
+	/* migrating after this is fine, the ring has its own mutex */
+	st = per_cpu_ptr(log->staging, raw_smp_processor_id());
+	mutex_lock(&st->mutex);
+
+	/* make room by merging everything staged so far */
+	while (LOGGER_STAGING_SIZE - (st->tail - ACCESS_ONCE(st->head)) <
+	       total) {
+		mutex_unlock(&st->mutex);
+		mutex_lock(&log->mutex);
+		merge_staging(log);
+		mutex_unlock(&log->mutex);
+		mutex_lock(&st->mutex);
+	}
+	/* pairs with the barrier after the merge copied the space out */
+	smp_mb();
+
+	/* taken under the mutex, so each ring is in timestamp order */
+	now = current_kernel_time();
+	header.sec = now.tv_sec;
+	header.nsec = now.tv_nsec;
 
-	do_write_log(log, &header, sizeof(struct logger_entry));
+	off = st->tail;
+	staging_write(st, off, &header, sizeof(struct logger_entry));
+	off += sizeof(struct logger_entry);
 
 	while (nr_segs-- > 0) {
 		size_t len;
@@ -485,21 +654,27 @@ ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 		/* figure out how much of this vector we can keep */
 		len = min_t(size_t, iov->iov_len, header.len - ret);
 
-		/* write out this segment's payload */
-		nr = do_write_log_from_user(log, iov->iov_base, len);
+		/*
+		 * write out this segment's payload; on failure 'tail' is not
+		 * updated, which abandons the partially copied entry
+		 */
+		nr = staging_write_from_user(st, off, iov->iov_base, len);
 		if (unlikely(nr < 0)) {
-			log->w_off = orig;
-			mutex_unlock(&log->mutex);
+			mutex_unlock(&st->mutex);
 			return nr;
 		}
 
 		iov++;
+		off += nr;
 		ret += nr;
 	}
 
-	mutex_unlock(&log->mutex);
+	/* the entry must be complete before the merge can see it */
+	smp_wmb();
+	st->tail = off;
+	mutex_unlock(&st->mutex);
 
-	/* wake up any blocked readers */
+	/* wake up any blocked readers, they merge what they need */
 	wake_up_interruptible(&log->wq);
 
 	return ret;
@@ -534,12 +709,14 @@ static int logger_open(struct inode *inode, struct file *file)
 
 		reader->log = log;
 		reader->r_ver = 1;
+		reader->r_batch = false;
 		reader->r_all = in_egroup_p(inode->i_gid) ||
 			capable(CAP_SYSLOG);
 
 		INIT_LIST_HEAD(&reader->list);
 
 		mutex_lock(&log->mutex);
+		merge_staging(log);
 		reader->r_off = log->head;
 		list_add_tail(&reader->list, &log->readers);
 		mutex_unlock(&log->mutex);
@@ -596,6 +773,7 @@ static unsigned int logger_poll(struct file *file, poll_table *wait)
 	poll_wait(file, &log->wq, wait);
 
 	mutex_lock(&log->mutex);
+	merge_staging(log);
 	if (!reader->r_all)
 		reader->r_off = get_next_entry_by_uid(log,
 			reader->r_off, current_euid());
@@ -628,6 +806,7 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	void __user *argp = (void __user *) arg;
 
 	mutex_lock(&log->mutex);
+	merge_staging(log);
 
 	switch (cmd) {
 	case LOGGER_GET_LOG_BUF_SIZE:
@@ -669,6 +848,7 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		list_for_each_entry(reader, &log->readers, list)
 			reader->r_off = log->w_off;
 		log->head = log->w_off;
+		update_map_info(log);
 		ret = 0;
 		break;
 	case LOGGER_GET_VERSION:
@@ -687,6 +867,15 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		reader = file->private_data;
 		ret = logger_set_version(reader, argp);
 		break;
+	case LOGGER_SET_BATCH:
+		if (!(file->f_mode & FMODE_READ)) {
+			ret = -EBADF;
+			break;
+		}
+		reader = file->private_data;
+		reader->r_batch = !!arg;
+		ret = 0;
+		break;
 	}
 
 	mutex_unlock(&log->mutex);
@@ -694,9 +883,45 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	return ret;
 }
 
+/*
+ * logger_mmap - maps the logger_map_info page and behind it the ring buffer
+ * read-only, for readers that may read all entries
+ */
+static int logger_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct logger_reader *reader;
+	struct logger_log *log;
+	unsigned long size = vma->vm_end - vma->vm_start;
+	int ret;
+
+	if (!(file->f_mode & FMODE_READ))
+		return -EBADF;
+	reader = file->private_data;
+	log = reader->log;
+
+	if (!reader->r_all)
+		return -EPERM;
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	if (vma->vm_pgoff || size != PAGE_SIZE + PAGE_ALIGN(log->size))
+		return -EINVAL;
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	ret = remap_pfn_range(vma, vma->vm_start,
+			      virt_to_phys(log->map_info) >> PAGE_SHIFT,
+			      PAGE_SIZE, vma->vm_page_prot);
+	if (ret)
+		return ret;
+
+	return remap_pfn_range(vma, vma->vm_start + PAGE_SIZE,
+			       virt_to_phys(log->buffer) >> PAGE_SHIFT,
+			       size - PAGE_SIZE, vma->vm_page_prot);
+}
+
 static const struct file_operations logger_fops = {
 	.owner = THIS_MODULE,
 	.read = logger_read,
+	.mmap = logger_mmap,
 	.aio_write = logger_aio_write,
 	.poll = logger_poll,
 	.unlocked_ioctl = logger_ioctl,
@@ -711,7 +936,7 @@ static const struct file_operations logger_fops = {
  * (LOGGER_ENTRY_MAX_PAYLOAD + sizeof(struct logger_entry)).
  */
 #define DEFINE_LOGGER_DEVICE(VAR, NAME, SIZE) \
-static unsigned char _buf_ ## VAR[SIZE]; \
+static unsigned char _buf_ ## VAR[SIZE] __aligned(PAGE_SIZE); \
 static struct logger_log VAR = { \
 	.buffer = _buf_ ## VAR, \
 	.misc = { \
@@ -746,14 +971,48 @@ static struct logger_log *get_log_from_minor(int minor)
 	return NULL;
 }
 
+static void free_log_staging(struct logger_log *log)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		kfree(per_cpu_ptr(log->staging, cpu)->buffer);
+	free_percpu(log->staging);
+	log->staging = NULL;
+	free_page((unsigned long) log->map_info);
+	log->map_info = NULL;
+}
+
 static int __init init_log(struct logger_log *log)
 {
-	int ret;
+	struct logger_staging *st;
+	int ret, cpu;
+
+	log->map_info = (void *) get_zeroed_page(GFP_KERNEL);
+	if (unlikely(!log->map_info))
+		return -ENOMEM;
+	log->map_info->size = log->size;
+
+	log->staging = alloc_percpu(struct logger_staging);
+	if (unlikely(!log->staging)) {
+		free_page((unsigned long) log->map_info);
+		return -ENOMEM;
+	}
+	for_each_possible_cpu(cpu) {
+		st = per_cpu_ptr(log->staging, cpu);
+		mutex_init(&st->mutex);
+		st->buffer = kmalloc(LOGGER_STAGING_SIZE, GFP_KERNEL);
+		if (unlikely(!st->buffer)) {
+			free_log_staging(log);
+			return -ENOMEM;
+		}
+	}
 
 	ret = misc_register(&log->misc);
 	if (unlikely(ret)) {
 		printk(KERN_ERR "logger: failed to register misc "
 		       "device for log '%s'!\n", log->misc.name);
+		free_log_staging(log);
 		return ret;
 	}
 
@@ -58,6 +58,20 @@ struct logger_entry {
 
 #define LOGGER_ENTRY_MAX_PAYLOAD	4076
 
+/*
+ * The first page of a read-only mmap() of a log, the ring buffer follows it.
+ * Positions are offsets into the ring; 'seq' is odd while they are updated.
+ * Entries between 'head' and 'w_off' are valid in the v2 format; a reader
+ * that finds its position no longer in there after copying was lapped.
+ * Mapped readers wait for new entries with poll(), which publishes them.
+ */
+struct logger_map_info {
+	__u32		seq;		/* update count */
+	__u32		size;		/* size of the ring buffer */
+	__u32		w_off;		/* current write head offset */
+	__u32		head;		/* oldest entry still in the ring */
+};
+
 #define __LOGGERIO	0xAE
 
 #define LOGGER_GET_LOG_BUF_SIZE		_IO(__LOGGERIO, 1) /* size of log */
@@ -66,5 +80,6 @@ struct logger_entry {
 #define LOGGER_FLUSH_LOG		_IO(__LOGGERIO, 4) /* flush log */
 #define LOGGER_GET_VERSION		_IO(__LOGGERIO, 5) /* abi version */
 #define LOGGER_SET_VERSION		_IO(__LOGGERIO, 6) /* abi version */
+#define LOGGER_SET_BATCH		_IO(__LOGGERIO, 7) /* many per read */
 
 #endif /* _LINUX_LOGGER_H */
@@ -38,6 +38,11 @@
 #include <linux/rcupdate.h>
 #include <linux/notifier.h>
 #include <linux/swap.h>
+#include <linux/bitmap.h>
+#include <linux/err.h>
+#include <linux/pid.h>
+#include <linux/spinlock.h>
+#include <linux/vmpressure.h>
 
 static uint32_t lowmem_debug_level = 1;
 static int lowmem_adj[6] = {
@@ -55,6 +60,20 @@ static int lowmem_minfree[6] = {
 };
 static int lowmem_minfree_size = 4;
 static int lmk_fast_run = 1;
+/*
+ * Upper bound on the number of tasks killed by one shrinker call. Tasks
+ * keep being killed while the memory they free falls short of the
+ * minfree deficit and the limit has not been reached.
+ */
+static int lowmem_batch_kill_max = 1;
+/*
+ * Let the reclaim pressure of the zones an allocation can use gate the
+ * minfree levels. While reclaim still frees most of what it scans only
+ * the first level may kill, and once it is critical the last level
+ * applies on free memory alone, as page cache is evidently not coming
+ * back.
+ */
+static int lmk_vmpressure = 1;
 
 static unsigned long lowmem_deathpending_timeout;
 
@@ -141,20 +160,217 @@ void tune_lmk_param(int *other_free, int *other_file, struct shrink_control *sc)
 	}
 }
 
-static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
+static unsigned int lowmem_vmpressure(gfp_t gfp_mask)
+{
+	struct zonelist *zonelist = node_zonelist(0, gfp_mask);
+	enum zone_type high_zoneidx = gfp_zone(gfp_mask);
+	unsigned int pressure = 0;
+	struct zoneref *z;
+	struct zone *zone;
+
+	for_each_zone_zonelist(zone, z, zonelist, high_zoneidx)
+		pressure = max(pressure, zone_vmpressure(zone));
+	return pressure;
+}
+
+struct lowmem_victim {
+	struct task_struct *task;
+	int tasksize;
+	int oom_score_adj;
+};
+
+/*
+ * Compare @tsk with the best victim found so far and replace it if @tsk
+ * has a higher oom_score_adj, or the same one and a larger RSS. Returns
+ * -EBUSY if a task killed earlier is still exiting, in which case
+ * nobody else should be killed yet. Called under rcu_read_lock().
+ */
+static int lowmem_check_task(struct task_struct *tsk, int min_score_adj,
+			     bool in_batch, struct lowmem_victim *victim)
+{
+	struct task_struct *p;
+	int oom_score_adj;
+	int tasksize;
+
+	if (tsk->flags & PF_KTHREAD)
+		return 0;
+
+	p = find_lock_task_mm(tsk);
+	if (!p)
+		return 0;
+
+	if (test_tsk_thread_flag(p, TIF_MEMDIE)) {
+		/* Already killed earlier in this batch */
+		if (in_batch) {
+			task_unlock(p);
+			return 0;
+		}
+		if (time_before_eq(jiffies, lowmem_deathpending_timeout)) {
+			task_unlock(p);
+			return -EBUSY;
+		}
+	}
+	oom_score_adj = p->signal->oom_score_adj;
+	if (oom_score_adj < min_score_adj) {
+		task_unlock(p);
+		return 0;
+	}
+	/* GPU buffers of a task go away with it as well */
+	tasksize = get_mm_rss(p->mm) + get_mm_counter(p->mm, MM_DRIVERPAGES);
+	task_unlock(p);
+	if (tasksize <= 0)
+		return 0;
+	if (victim->task) {
+		if (oom_score_adj < victim->oom_score_adj)
+			return 0;
+		if (oom_score_adj == victim->oom_score_adj &&
+		    tasksize <= victim->tasksize)
+			return 0;
+	}
+	victim->task = p;
+	victim->tasksize = tasksize;
+	victim->oom_score_adj = oom_score_adj;
+	lowmem_print(2, "select %d (%s), adj %d, size %d, to kill\n",
+		     p->pid, p->comm, oom_score_adj, tasksize);
+	return 0;
+}
+
+#ifdef CONFIG_ANDROID_LMK_ADJ_INDEX
+/*
+ * Thread groups are kept in one bucket per oom_score_adj value, and a
+ * bitmap records which buckets are populated. Victim selection walks
+ * the populated buckets from the highest adj down and stops in the
+ * first one that yields a candidate, so it only looks at the tasks
+ * that could actually be picked instead of at every process.
+ */
+#define LMK_ADJ_BUCKETS	(OOM_SCORE_ADJ_MAX - OOM_SCORE_ADJ_MIN + 1)
+
+static DEFINE_SPINLOCK(lmk_adj_lock);
+static struct hlist_head lmk_adj_buckets[LMK_ADJ_BUCKETS];
+static DECLARE_BITMAP(lmk_adj_bitmap, LMK_ADJ_BUCKETS);
+
+static inline unsigned long lmk_adj_bucket(int oom_score_adj)
+{
+	return oom_score_adj - OOM_SCORE_ADJ_MIN;
+}
+
+static void __lmk_adj_index_add(struct signal_struct *sig)
+{
+	unsigned long bucket;
+
+	sig->lmk_adj = sig->oom_score_adj;
+	bucket = lmk_adj_bucket(sig->lmk_adj);
+	hlist_add_head(&sig->lmk_adj_node, &lmk_adj_buckets[bucket]);
+	__set_bit(bucket, lmk_adj_bitmap);
+}
+
+static void __lmk_adj_index_del(struct signal_struct *sig)
+{
+	unsigned long bucket = lmk_adj_bucket(sig->lmk_adj);
+
+	hlist_del_init(&sig->lmk_adj_node);
+	if (hlist_empty(&lmk_adj_buckets[bucket]))
+		__clear_bit(bucket, lmk_adj_bitmap);
+}
+
+void lmk_adj_index_add(struct task_struct *tsk)
+{
+	spin_lock(&lmk_adj_lock);
+	__lmk_adj_index_add(tsk->signal);
+	spin_unlock(&lmk_adj_lock);
+}
+
+void lmk_adj_index_del(struct task_struct *tsk)
+{
+	struct signal_struct *sig = tsk->signal;
+
+	spin_lock(&lmk_adj_lock);
+	if (!hlist_unhashed(&sig->lmk_adj_node))
+		__lmk_adj_index_del(sig);
+	spin_unlock(&lmk_adj_lock);
+}
+
+/*
+ * Called after oom_score_adj changed. Racing updates are harmless as
+ * each one files the group under the value current at that time.
+ */
+void lmk_adj_index_update(struct task_struct *tsk)
+{
+	struct signal_struct *sig = tsk->signal;
+
+	spin_lock(&lmk_adj_lock);
+	if (!hlist_unhashed(&sig->lmk_adj_node) &&
+	    sig->lmk_adj != sig->oom_score_adj) {
+		__lmk_adj_index_del(sig);
+		__lmk_adj_index_add(sig);
+	}
+	spin_unlock(&lmk_adj_lock);
+}
+
+static int lowmem_select_victim(int min_score_adj, bool in_batch,
+				struct lowmem_victim *victim)
+{
+	unsigned long min_bucket = lmk_adj_bucket(min_score_adj);
+	unsigned long limit = LMK_ADJ_BUCKETS;
+	unsigned long bucket;
+	struct signal_struct *sig;
+	struct hlist_node *pos;
+	int ret = 0;
+
+	spin_lock(&lmk_adj_lock);
+	while ((bucket = find_last_bit(lmk_adj_bitmap, limit)) < limit &&
+	       bucket >= min_bucket) {
+		hlist_for_each_entry(sig, pos, &lmk_adj_buckets[bucket],
+				     lmk_adj_node) {
+			struct task_struct *leader;
+
+			/* NULL while the group is being released */
+			leader = pid_task(sig->leader_pid, PIDTYPE_PID);
+			if (!leader)
+				continue;
+
+			ret = lowmem_check_task(leader, min_score_adj,
+						in_batch, victim);
+			if (ret)
+				goto out;
+		}
+		/* Lower buckets can only hold worse candidates */
+		if (victim->task)
+			break;
+		limit = bucket;
+	}
+out:
+	spin_unlock(&lmk_adj_lock);
+	return ret;
+}
+#else
+static int lowmem_select_victim(int min_score_adj, bool in_batch,
+				struct lowmem_victim *victim)
 {
 	struct task_struct *tsk;
-	struct task_struct *selected = NULL;
+	int ret;
+
+	for_each_process(tsk) {
+		ret = lowmem_check_task(tsk, min_score_adj, in_batch, victim);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+#endif
+
+static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
+{
+	struct lowmem_victim victim;
 	int rem = 0;
-	int tasksize;
 	int i;
 	int min_score_adj = OOM_SCORE_ADJ_MAX + 1;
-	int selected_tasksize = 0;
-	int selected_oom_score_adj;
+	int deficit = 0;
+	int nr_killed = 0;
 	int array_size = ARRAY_SIZE(lowmem_adj);
-	int other_free = global_page_state(NR_FREE_PAGES);
-	int other_file = global_page_state(NR_FILE_PAGES) -
-						global_page_state(NR_SHMEM);
+	int other_free = global_page_state_snapshot(NR_FREE_PAGES);
+	int other_file = global_page_state_snapshot(NR_FILE_PAGES) -
+					global_page_state_snapshot(NR_SHMEM);
 
 	tune_lmk_param(&other_free, &other_file, sc);
 
@@ -166,9 +382,27 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 		if (other_free < lowmem_minfree[i] &&
 		    other_file < lowmem_minfree[i]) {
 			min_score_adj = lowmem_adj[i];
+			deficit = lowmem_minfree[i] - other_free;
 			break;
 		}
 	}
+	if (lmk_vmpressure && sc->nr_to_scan > 0 && array_size > 0) {
+		unsigned int pressure = lowmem_vmpressure(sc->gfp_mask);
+
+		if (pressure < VMPRESSURE_LEVEL_MEDIUM && i > 0 &&
+		    i < array_size) {
+			lowmem_print(3, "lowmem_shrink pressure %u, defer %d\n",
+				     pressure, min_score_adj);
+			min_score_adj = OOM_SCORE_ADJ_MAX + 1;
+		} else if (pressure >= VMPRESSURE_LEVEL_CRITICAL &&
+			   i == array_size &&
+			   other_free < lowmem_minfree[array_size - 1]) {
+			min_score_adj = lowmem_adj[array_size - 1];
+			deficit = lowmem_minfree[array_size - 1] - other_free;
+			lowmem_print(3, "lowmem_shrink pressure %u, adj %d\n",
+				     pressure, min_score_adj);
+		}
+	}
 	if (sc->nr_to_scan > 0)
 		lowmem_print(3, "lowmem_shrink %lu, %x, ofree %d %d, ma %d\n",
 				sc->nr_to_scan, sc->gfp_mask, other_free,
@@ -182,57 +416,28 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 			     sc->nr_to_scan, sc->gfp_mask, rem);
 		return rem;
 	}
-	selected_oom_score_adj = min_score_adj;
 
 	rcu_read_lock();
-	for_each_process(tsk) {
-		struct task_struct *p;
-		int oom_score_adj;
-
-		if (tsk->flags & PF_KTHREAD)
-			continue;
-
-		p = find_lock_task_mm(tsk);
-		if (!p)
-			continue;
-
-		if (test_tsk_thread_flag(p, TIF_MEMDIE) &&
-		    time_before_eq(jiffies, lowmem_deathpending_timeout)) {
-			task_unlock(p);
+	do {
+		victim.task = NULL;
+		if (lowmem_select_victim(min_score_adj, nr_killed > 0,
+					 &victim)) {
 			rcu_read_unlock();
 			return 0;
 		}
-		oom_score_adj = p->signal->oom_score_adj;
-		if (oom_score_adj < min_score_adj) {
-			task_unlock(p);
-			continue;
-		}
-		tasksize = get_mm_rss(p->mm);
-		task_unlock(p);
-		if (tasksize <= 0)
-			continue;
-		if (selected) {
-			if (oom_score_adj < selected_oom_score_adj)
-				continue;
-			if (oom_score_adj == selected_oom_score_adj &&
-			    tasksize <= selected_tasksize)
-				continue;
-		}
-		selected = p;
-		selected_tasksize = tasksize;
-		selected_oom_score_adj = oom_score_adj;
-		lowmem_print(2, "select %d (%s), adj %d, size %d, to kill\n",
-			     p->pid, p->comm, oom_score_adj, tasksize);
-	}
-	if (selected) {
+		if (!victim.task)
+			break;
+
 		lowmem_print(1, "send sigkill to %d (%s), adj %d, size %d\n",
-			     selected->pid, selected->comm,
-			     selected_oom_score_adj, selected_tasksize);
+			     victim.task->pid, victim.task->comm,
+			     victim.oom_score_adj, victim.tasksize);
 		lowmem_deathpending_timeout = jiffies + HZ;
-		send_sig(SIGKILL, selected, 0);
-		set_tsk_thread_flag(selected, TIF_MEMDIE);
-		rem -= selected_tasksize;
-	}
+		send_sig(SIGKILL, victim.task, 0);
+		set_tsk_thread_flag(victim.task, TIF_MEMDIE);
+		rem -= victim.tasksize;
+		deficit -= victim.tasksize;
+		nr_killed++;
+	} while (deficit > 0 && nr_killed < lowmem_batch_kill_max);
 	lowmem_print(4, "lowmem_shrink %lu, %x, return %d\n",
 		     sc->nr_to_scan, sc->gfp_mask, rem);
 	rcu_read_unlock();
@@ -347,6 +552,9 @@ module_param_array_named(minfree, lowmem_minfree, uint, &lowmem_minfree_size,
 			 S_IRUGO | S_IWUSR);
 module_param_named(debug_level, lowmem_debug_level, uint, S_IRUGO | S_IWUSR);
 module_param_named(lmk_fast_run, lmk_fast_run, int, S_IRUGO | S_IWUSR);
+module_param_named(batch_kill_max, lowmem_batch_kill_max, int,
+		   S_IRUGO | S_IWUSR);
+module_param_named(lmk_vmpressure, lmk_vmpressure, int, S_IRUGO | S_IWUSR);
 
 module_init(lowmem_init);
 module_exit(lowmem_exit);
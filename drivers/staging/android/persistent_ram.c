@@ -19,6 +19,7 @@
 #include <linux/init.h>
 #include <linux/io.h>
 #include <linux/list.h>
+#include <linux/lzo.h>
 #include <linux/memblock.h>
 #include <linux/persistent_ram.h>
 #include <linux/rslib.h>
@@ -33,6 +34,20 @@ struct persistent_ram_buffer {
 };
 
 #define PERSISTENT_RAM_SIG (0x43474244) /* DBGC */
+/* data holds a compressed log that can no longer be appended to */
+#define PERSISTENT_RAM_SIG_LZO (0x5a474244) /* DBGZ */
+
+/* sanity limit on the size of a compressed log */
+#define PERSISTENT_RAM_LZO_MAX (4 << 20)
+
+/* what a compressed buffer starts with, followed by the lzo streams */
+struct persistent_ram_lzo_header {
+	uint32_t    nr_segs;
+	struct {
+		uint32_t ulen;
+		uint32_t clen;
+	} seg[2];
+};
 
 static __devinitdata LIST_HEAD(persistent_ram_list);
 
@@ -121,11 +136,18 @@ static int persistent_ram_decode_rs8(struct persistent_ram_zone *prz,
 				NULL, 0, NULL, 0, NULL);
 }
 
+/*
+ * Only blocks that the write filled up are encoded.  The one still
+ * being filled gets its ECC once the writes move past it, or from
+ * persistent_ram_flush_ecc(), so each block is encoded about once
+ * instead of on every line that goes into it.
+ */
 static void notrace persistent_ram_update_ecc(struct persistent_ram_zone *prz,
 	unsigned int start, unsigned int count)
 {
 	struct persistent_ram_buffer *buffer = prz->buffer;
 	uint8_t *buffer_end = buffer->data + prz->buffer_size;
+	uint8_t *end = buffer->data + start + count;
 	uint8_t *block;
 	uint8_t *par;
 	int ecc_block_size = prz->ecc_block_size;
@@ -138,13 +160,50 @@ static void notrace persistent_ram_update_ecc(struct persistent_ram_zone *prz,
 	block = buffer->data + (start & ~(ecc_block_size - 1));
 	par = prz->par_buffer + (start / ecc_block_size) * prz->ecc_size;
 
-	do {
+	while (block < end) {
 		if (block + ecc_block_size > buffer_end)
 			size = buffer_end - block;
+		if (block + size > end)
+			break;
 		persistent_ram_encode_rs8(prz, block, size, par);
 		block += ecc_block_size;
 		par += ecc_size;
-	} while (block < buffer->data + start + count);
+	}
+}
+
+/* the block the next write goes to, if it is partly written */
+static inline bool persistent_ram_tail_block(struct persistent_ram_zone *prz,
+	size_t *offset)
+{
+	size_t start = buffer_start(prz);
+
+	*offset = start & ~(prz->ecc_block_size - 1);
+	return start != *offset;
+}
+
+static void notrace persistent_ram_encode_block(struct persistent_ram_zone *prz,
+	size_t offset)
+{
+	uint8_t *block = prz->buffer->data + offset;
+	size_t size = min_t(size_t, prz->ecc_block_size,
+			    prz->buffer_size - offset);
+
+	persistent_ram_encode_rs8(prz, block, size, prz->par_buffer +
+				  offset / prz->ecc_block_size * prz->ecc_size);
+}
+
+/* Bring the ECC of a partly written block up to date. */
+void notrace persistent_ram_flush_ecc(struct persistent_ram_zone *prz)
+{
+	size_t offset;
+
+	if (!prz->ecc)
+		return;
+
+	if (persistent_ram_tail_block(prz, &offset))
+		persistent_ram_encode_block(prz, offset);
+	/* make it to memory before a reset */
+	wmb();
 }
 
 static void persistent_ram_update_header_ecc(struct persistent_ram_zone *prz)
@@ -163,15 +222,27 @@ static void persistent_ram_ecc_old(struct persistent_ram_zone *prz)
 	struct persistent_ram_buffer *buffer = prz->buffer;
 	uint8_t *block;
 	uint8_t *par;
+	uint8_t *tail = NULL;
+	size_t offset;
 
 	if (!prz->ecc)
 		return;
 
+	/*
+	 * Without a flush before the reset the ECC of the block that was
+	 * being written is stale, and correcting it would undo the last
+	 * few bytes written to it.
+	 */
+	if (persistent_ram_tail_block(prz, &offset))
+		tail = buffer->data + offset;
+
 	block = buffer->data;
 	par = prz->par_buffer;
 	while (block < buffer->data + buffer_size(prz)) {
 		int numerr;
 		int size = prz->ecc_block_size;
+		if (block == tail)
+			goto next;
 		if (block + size > buffer->data + prz->buffer_size)
 			size = buffer->data + prz->buffer_size - block;
 		numerr = persistent_ram_decode_rs8(prz, block, size, par);
@@ -184,6 +255,7 @@ static void persistent_ram_ecc_old(struct persistent_ram_zone *prz)
 				block);
 			prz->bad_blocks++;
 		}
+next:
 		block += prz->ecc_block_size;
 		par += prz->ecc_size;
 	}
@@ -267,6 +339,136 @@ static void notrace persistent_ram_update(struct persistent_ram_zone *prz,
 	persistent_ram_update_ecc(prz, start, count);
 }
 
+#ifdef CONFIG_ANDROID_PERSISTENT_RAM_COMPRESS
+static int __devinit
+persistent_ram_save_old_lzo(struct persistent_ram_zone *prz)
+{
+	struct persistent_ram_lzo_header hdr;
+	const uint8_t *src = prz->buffer->data + sizeof(hdr);
+	size_t size = buffer_size(prz) - sizeof(hdr);
+	size_t ulen = 0, clen = 0, len;
+	char *dest;
+	int i, ret;
+
+	if (buffer_size(prz) < sizeof(hdr))
+		return -EINVAL;
+	memcpy(&hdr, prz->buffer->data, sizeof(hdr));
+	if (hdr.nr_segs > ARRAY_SIZE(hdr.seg))
+		return -EINVAL;
+	for (i = 0; i < hdr.nr_segs; i++) {
+		ulen += hdr.seg[i].ulen;
+		clen += hdr.seg[i].clen;
+	}
+	if (clen > size || ulen > PERSISTENT_RAM_LZO_MAX)
+		return -EINVAL;
+
+	dest = vmalloc(ulen);
+	if (!dest)
+		return -ENOMEM;
+
+	ulen = 0;
+	for (i = 0; i < hdr.nr_segs; i++) {
+		len = hdr.seg[i].ulen;
+		ret = lzo1x_decompress_safe(src, hdr.seg[i].clen,
+					    dest + ulen, &len);
+		if (ret != LZO_E_OK || len != hdr.seg[i].ulen) {
+			vfree(dest);
+			return -EINVAL;
+		}
+		src += hdr.seg[i].clen;
+		ulen += len;
+	}
+
+	prz->old_log = dest;
+	prz->old_log_size = ulen;
+	prz->old_log_vmalloc = true;
+	return 0;
+}
+
+/*
+ * Called from a kmsg dumper on panic with the whole kernel log, which
+ * is usually several times what the ring holds.  If the log compresses
+ * into the buffer, it replaces the ring, and the zone takes no more
+ * writes.  Otherwise the ring is left as it is.
+ */
+void persistent_ram_compress_log(struct persistent_ram_zone *prz,
+	const char *s1, unsigned long l1, const char *s2, unsigned long l2)
+{
+	struct persistent_ram_lzo_header hdr = { 0 };
+	const char *src[2] = { s1, s2 };
+	unsigned long len[2] = { l1, l2 };
+	uint8_t *out = prz->lzo_buf;
+	size_t avail, clen;
+	int i;
+
+	if (!prz->lzo_buf || l1 + l2 <= buffer_size(prz) ||
+	    prz->buffer->sig != PERSISTENT_RAM_SIG)
+		return;
+
+	/* the newest part of the log is kept if it is too much */
+	if (l2 >= prz->lzo_max) {
+		src[1] += l2 - prz->lzo_max;
+		len[1] = prz->lzo_max;
+		len[0] = 0;
+	} else if (l1 + l2 > prz->lzo_max) {
+		src[0] += l1 + l2 - prz->lzo_max;
+		len[0] = prz->lzo_max - l2;
+	}
+
+	avail = prz->buffer_size - sizeof(hdr);
+	for (i = 0; i < ARRAY_SIZE(src); i++) {
+		if (!len[i])
+			continue;
+		if (lzo1x_1_compress((const unsigned char *)src[i], len[i],
+				     out, &clen, prz->lzo_wrkmem) != LZO_E_OK ||
+		    clen > avail)
+			return;
+		hdr.seg[hdr.nr_segs].ulen = len[i];
+		hdr.seg[hdr.nr_segs].clen = clen;
+		hdr.nr_segs++;
+		out += clen;
+		avail -= clen;
+	}
+	clen = out - (uint8_t *)prz->lzo_buf;
+
+	/* stop the console first, it writes the same memory */
+	prz->buffer->sig = PERSISTENT_RAM_SIG_LZO;
+	wmb();
+	memcpy(prz->buffer->data, &hdr, sizeof(hdr));
+	memcpy(prz->buffer->data + sizeof(hdr), prz->lzo_buf, clen);
+	atomic_set(&prz->buffer->size, sizeof(hdr) + clen);
+
+	/* let the last block be flushed, then mark it as not partly written */
+	atomic_set(&prz->buffer->start, sizeof(hdr) + clen);
+	persistent_ram_update_ecc(prz, 0, sizeof(hdr) + clen);
+	persistent_ram_flush_ecc(prz);
+	atomic_set(&prz->buffer->start, 0);
+	persistent_ram_update_header_ecc(prz);
+	wmb();
+}
+
+int __devinit persistent_ram_init_compress(struct persistent_ram_zone *prz,
+	size_t max)
+{
+	prz->lzo_wrkmem = vmalloc(LZO1X_1_MEM_COMPRESS);
+	prz->lzo_buf = vmalloc(lzo1x_worst_compress(max));
+	if (!prz->lzo_wrkmem || !prz->lzo_buf) {
+		vfree(prz->lzo_wrkmem);
+		vfree(prz->lzo_buf);
+		prz->lzo_wrkmem = NULL;
+		prz->lzo_buf = NULL;
+		return -ENOMEM;
+	}
+	prz->lzo_max = max;
+	return 0;
+}
+#else
+static inline int persistent_ram_save_old_lzo(struct persistent_ram_zone *prz)
+{
+	return -EINVAL;
+}
+#endif
+
 static void __devinit
 persistent_ram_save_old(struct persistent_ram_zone *prz)
 {
@@ -277,6 +479,12 @@ persistent_ram_save_old(struct persistent_ram_zone *prz)
 
 	persistent_ram_ecc_old(prz);
 
+	if (buffer->sig == PERSISTENT_RAM_SIG_LZO) {
+		if (persistent_ram_save_old_lzo(prz))
+			pr_err("persistent_ram: bad compressed buffer\n");
+		return;
+	}
+
 	dest = kmalloc(size, GFP_KERNEL);
 	if (dest == NULL) {
 		pr_err("persistent_ram: failed to allocate buffer\n");
@@ -319,6 +527,9 @@ int notrace persistent_ram_write(struct persistent_ram_zone *prz,
 
 	persistent_ram_update_header_ecc(prz);
 
+	/* the mapping is write-combined */
+	wmb();
+
 	return count;
 }
 
@@ -334,7 +545,11 @@ void *persistent_ram_old(struct persistent_ram_zone *prz)
 
 void persistent_ram_free_old(struct persistent_ram_zone *prz)
 {
-	kfree(prz->old_log);
+	if (prz->old_log_vmalloc)
+		vfree(prz->old_log);
+	else
+		kfree(prz->old_log);
+	prz->old_log_vmalloc = false;
 	prz->old_log = NULL;
 	prz->old_log_size = 0;
 }
@@ -351,7 +566,12 @@ static int persistent_ram_buffer_map(phys_addr_t start, phys_addr_t size,
 	page_start = start - offset_in_page(start);
 	page_count = DIV_ROUND_UP(size + offset_in_page(start), PAGE_SIZE);
 
-	prot = pgprot_noncached(PAGE_KERNEL);
+	/*
+	 * Writes only need to reach memory before a reset, which the
+	 * barriers after each update take care of, so they may be merged
+	 * on the way.
+	 */
+	prot = pgprot_writecombine(PAGE_KERNEL);
 
 	pages = kmalloc(sizeof(struct page *) * page_count, GFP_KERNEL);
 	if (!pages) {
@@ -427,7 +647,8 @@ struct persistent_ram_zone *__persistent_ram_init(struct device *dev, bool ecc)
 	if (ret)
 		goto err;
 
-	if (prz->buffer->sig == PERSISTENT_RAM_SIG) {
+	if (prz->buffer->sig == PERSISTENT_RAM_SIG ||
+	    prz->buffer->sig == PERSISTENT_RAM_SIG_LZO) {
 		if (buffer_size(prz) > prz->buffer_size ||
 		    buffer_start(prz) > buffer_size(prz))
 			pr_info("persistent_ram: found existing invalid buffer,"
@@ -15,6 +15,7 @@
 
 #include <linux/console.h>
 #include <linux/init.h>
+#include <linux/kmsg_dump.h>
 #include <linux/module.h>
 #include <linux/persistent_ram.h>
 #include <linux/platform_device.h>
@@ -42,6 +43,21 @@ static struct console ram_console = {
 	.index	= -1,
 };
 
+static void ram_console_dump(struct kmsg_dumper *dumper,
+	enum kmsg_dump_reason reason, const char *s1, unsigned long l1,
+	const char *s2, unsigned long l2)
+{
+	struct persistent_ram_zone *prz = ram_console_zone;
+
+	if (reason == KMSG_DUMP_PANIC)
+		persistent_ram_compress_log(prz, s1, l1, s2, l2);
+	persistent_ram_flush_ecc(prz);
+}
+
+static struct kmsg_dumper ram_console_dumper = {
+	.dump	= ram_console_dump,
+};
+
 void ram_console_enable_console(int enabled)
 {
 	if (enabled)
@@ -69,7 +85,13 @@ static int __devinit ram_console_probe(struct platform_device *pdev)
 	ram_console_zone = prz;
 	ram_console.data = prz;
 
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_COMPRESS
+	if (persistent_ram_init_compress(prz, 1 << CONFIG_LOG_BUF_SHIFT))
+		pr_err("ram_console: no memory for log compression\n");
+#endif
+
 	register_console(&ram_console);
+	kmsg_dump_register(&ram_console_dumper);
 
 	return 0;
 }
@@ -328,6 +328,13 @@ typedef enum
 #define CFG_SCAN_RESULT_AGE_TIME_CPS_MAX       ( 10000 )
 #define CFG_SCAN_RESULT_AGE_TIME_CPS_DEFAULT   ( 600 )
 
+/* A wildcard scan of every channel within this many ms of the last one
+   only visits the channels of the cached results, 0 always sweeps all */
+#define CFG_PARTIAL_SCAN_FULL_SWEEP_MS_NAME    "gPartialScanFullSweepMs"
+#define CFG_PARTIAL_SCAN_FULL_SWEEP_MS_MIN     ( 0 )
+#define CFG_PARTIAL_SCAN_FULL_SWEEP_MS_MAX     ( 600000 )
+#define CFG_PARTIAL_SCAN_FULL_SWEEP_MS_DEFAULT ( 30000 )
+
 #define CFG_RSSI_CATEGORY_GAP_NAME             "gRssiCatGap"
 #define CFG_RSSI_CATEGORY_GAP_MIN              ( 5 )  
 #define CFG_RSSI_CATEGORY_GAP_MAX              ( 100 )  
@@ -1183,6 +1190,13 @@ typedef enum
 #define CFG_MC_ADDR_LIST_FILTER_MIN                ( 0 )
 #define CFG_MC_ADDR_LIST_FILTER_MAX                ( 1 )
 #define CFG_MC_ADDR_LIST_FILTER_DEFAULT            ( 0 )
+
+/* Broadcast and multicast frames allowed to wake the host in suspend:
+   bit 0 ARP, bit 1 ICMPv6 (neighbour discovery), bit 2 mDNS */
+#define CFG_SUSPEND_WAKE_FILTER_NAME               "gSuspendWakeFilter"
+#define CFG_SUSPEND_WAKE_FILTER_MIN                ( 0 )
+#define CFG_SUSPEND_WAKE_FILTER_MAX                ( 7 )
+#define CFG_SUSPEND_WAKE_FILTER_DEFAULT            ( 7 )
 #endif
 
 /*
@@ -1414,6 +1428,7 @@ typedef struct
    v_U32_t       nScanAgeTimeNCPS;
    v_U32_t       nScanAgeTimeCNPS;
    v_U32_t       nScanAgeTimeCPS;
+   v_U32_t       nPartialScanFullSweepMs;
    v_U8_t        nRssiCatGap;
    v_U32_t       nStatTimerInterval;
    v_BOOL_t      fIsShortPreamble;
@@ -1620,6 +1635,7 @@ typedef struct
    v_U8_t                      thermalMitigationEnable;
 #ifdef WLAN_FEATURE_PACKET_FILTERING
    v_BOOL_t                    isMcAddrListFilter;
+   v_U8_t                      suspendWakeFilter;
 #endif
 #ifdef WLAN_FEATURE_11AC
    v_U8_t                      vhtChannelWidth;
@@ -72,6 +72,13 @@ typedef struct
    hdd_list_node_t anchor;
    struct sk_buff *skb;
    int userPriority;
+   /* Classified at enqueue while the frame header is still cache hot,
+      so the TX thread does not have to touch the payload in fetch */
+   v_U8_t isEapol;
+   v_U8_t isBcast;
+   v_U8_t isMcast;
+   /* Bytes accounted to the byte queue limit of the netdev TX queue */
+   v_U32_t txBytes;
 } skb_list_node_t;
 
 //FIXME Need a helper function to cleanup skbs in a queue. Required for cleanup/shutdown
@@ -185,6 +185,17 @@ typedef struct hdd_chip_reset_stats_s
    __u32    totalUnknownExceptions;
 } hdd_chip_reset_stats_t;
 
+/* Frames received while the host was suspended, by what they were */
+typedef struct hdd_wake_stats_s
+{
+   __u32    wakeUnicast;
+   __u32    wakeArp;
+   __u32    wakeIcmpv6;
+   __u32    wakeMdns;
+   __u32    wakeBcast;
+   __u32    wakeMcast;
+} hdd_wake_stats_t;
+
 typedef struct hdd_stats_s
 {
    tCsrSummaryStatsInfo       summary_stat;
@@ -195,6 +206,7 @@ typedef struct hdd_stats_s
    tCsrPerStaStatsInfo        perStaStats;
    hdd_tx_rx_stats_t          hddTxRxStats;
    hdd_chip_reset_stats_t     hddChipResetStats;
+   hdd_wake_stats_t           hddWakeStats;
 } hdd_stats_t;
 
 typedef enum
@@ -590,6 +602,12 @@ typedef struct hdd_scaninfo_s
 
    hdd_scan_pending_option_e scan_pending_option;
 
+   /* Channels of the cached scan results, indexed by channel number */
+   DECLARE_BITMAP(seenChannels, 256);
+
+   /* jiffies of the last scan that swept every channel, 0 if none */
+   unsigned long lastFullScan;
+
 }hdd_scaninfo_t;
 
 #define WLAN_HDD_ADAPTER_MAGIC 0x574c414e //ASCII "WLAN"
@@ -684,6 +702,16 @@ struct hdd_adapter_s
    hdd_wmm_status_t hddWmmStatus;
 /*************************************************************
  */
+/*************************************************************
+ *  Rx NAPI context
+ */
+   /** Frames received by TL, waiting for the NAPI poll */
+   struct sk_buff_head rx_queue;
+   struct napi_struct rx_napi;
+   /** Track whether rx_napi is enabled */
+   v_BOOL_t isRxNapiEnabled;
+/*************************************************************
+ */
 /*************************************************************
  * TODO - Remove it later
  */
@@ -761,6 +789,8 @@ typedef struct multicast_addr_list
    v_U8_t isFilterApplied;
    v_U8_t mc_cnt;
    v_U8_t addr[WLAN_HDD_MAX_MC_ADDR_LIST][ETH_ALEN];
+   /* gSuspendWakeFilter bits programmed as filters, after the above */
+   v_U8_t wakeFilterApplied;
 } t_multicast_add_list;
 #endif
 
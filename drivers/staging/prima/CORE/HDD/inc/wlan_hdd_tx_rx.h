@@ -39,6 +39,7 @@
 #include <wlan_hdd_includes.h>
 #include <vos_api.h>
 #include <linux/skbuff.h>
+#include <linux/netdevice.h>
 #include <wlan_qct_tl.h>
 
 /*--------------------------------------------------------------------------- 
@@ -64,6 +65,9 @@
 #define HDD_DEST_ADDR_OFFSET      6
 
 #define HDD_MAC_HDR_SIZE          6
+
+/* Frames handed to GRO per NAPI poll of a station adapter */
+#define HDD_RX_NAPI_WEIGHT        64
 /*--------------------------------------------------------------------------- 
   Type declarations
   -------------------------------------------------------------------------*/ 
@@ -188,6 +192,17 @@ extern VOS_STATUS hdd_tx_fetch_packet_cbk( v_VOID_t *vosContext,
 extern VOS_STATUS hdd_tx_low_resource_cbk( vos_pkt_t *pVosPacket, 
                                            v_VOID_t *userData );
 
+/**============================================================================
+  @brief hdd_rx_poll() - NAPI poll function of a station adapter. Passes
+  the frames queued by hdd_rx_packet_cbk() to GRO.
+
+  @param napi   : [in] NAPI context of the adapter
+  @param budget : [in] maximum number of frames to deliver
+
+  @return       : number of frames delivered
+  ===========================================================================*/
+extern int hdd_rx_poll( struct napi_struct *napi, int budget );
+
 /**============================================================================
   @brief hdd_rx_packet_cbk() - Receive callback registered with TL.
   TL will call this to notify the HDD when a packet was received 
@@ -391,6 +391,13 @@ REG_TABLE_ENTRY g_registry_table[] =
                  CFG_SCAN_RESULT_AGE_TIME_CPS_MIN, 
                  CFG_SCAN_RESULT_AGE_TIME_CPS_MAX ),
 
+   REG_VARIABLE( CFG_PARTIAL_SCAN_FULL_SWEEP_MS_NAME, WLAN_PARAM_Integer,
+                 hdd_config_t, nPartialScanFullSweepMs,
+                 VAR_FLAGS_OPTIONAL | VAR_FLAGS_RANGE_CHECK_ASSUME_DEFAULT,
+                 CFG_PARTIAL_SCAN_FULL_SWEEP_MS_DEFAULT,
+                 CFG_PARTIAL_SCAN_FULL_SWEEP_MS_MIN,
+                 CFG_PARTIAL_SCAN_FULL_SWEEP_MS_MAX ),
+
    REG_VARIABLE( CFG_RSSI_CATEGORY_GAP_NAME, WLAN_PARAM_Integer,
                  hdd_config_t, nRssiCatGap, 
                  VAR_FLAGS_OPTIONAL | VAR_FLAGS_RANGE_CHECK_ASSUME_DEFAULT, 
@@ -1561,6 +1568,13 @@ REG_VARIABLE( CFG_ALLOW_MCC_GO_DIFF_BI_NAME, WLAN_PARAM_Integer,
               CFG_MC_ADDR_LIST_FILTER_DEFAULT,
               CFG_MC_ADDR_LIST_FILTER_MIN,
               CFG_MC_ADDR_LIST_FILTER_MAX ),
+
+ REG_VARIABLE( CFG_SUSPEND_WAKE_FILTER_NAME, WLAN_PARAM_Integer,
+              hdd_config_t, suspendWakeFilter,
+              VAR_FLAGS_OPTIONAL | VAR_FLAGS_RANGE_CHECK_ASSUME_DEFAULT,
+              CFG_SUSPEND_WAKE_FILTER_DEFAULT,
+              CFG_SUSPEND_WAKE_FILTER_MIN,
+              CFG_SUSPEND_WAKE_FILTER_MAX ),
 #endif
   
 REG_VARIABLE( CFG_ENABLE_MODULATED_DTIM_NAME, WLAN_PARAM_Integer,
@@ -3160,13 +3160,15 @@ static struct cfg80211_bss* wlan_hdd_cfg80211_inform_bss(
 
 
 /*
- * FUNCTION: wlan_hdd_cfg80211_inform_bss_frame
- * This function is used to inform the BSS details to nl80211 interface.
+ * FUNCTION: wlan_hdd_cfg80211_inform_bss_desc
+ * Builds the probe response for bss_desc in mgmt, which must have room
+ * for its IEs, and informs nl80211 of it.
  */
-struct cfg80211_bss*
-wlan_hdd_cfg80211_inform_bss_frame( hdd_adapter_t *pAdapter,
-                                    tSirBssDescription *bss_desc
-                                    )
+static struct cfg80211_bss*
+wlan_hdd_cfg80211_inform_bss_desc( hdd_adapter_t *pAdapter,
+                                   tSirBssDescription *bss_desc,
+                                   struct ieee80211_mgmt *mgmt
+                                   )
 {
     /*
       cfg80211_inform_bss() is not updating ie field of bss entry, if entry
@@ -3186,9 +3188,6 @@ wlan_hdd_cfg80211_inform_bss_frame( hdd_adapter_t *pAdapter,
         ((ie_length != 0) ? (const char *)&bss_desc->ieFields: NULL);
     unsigned int freq;
     struct ieee80211_channel *chan;
-    struct ieee80211_mgmt *mgmt =
-        kzalloc((sizeof (struct ieee80211_mgmt) + ie_length), GFP_KERNEL);
-    struct cfg80211_bss *bss_status = NULL;
     size_t frame_len = sizeof (struct ieee80211_mgmt) + ie_length;
     int rssi = 0;
 #ifdef WLAN_OPEN_SOURCE
@@ -3197,9 +3196,7 @@ wlan_hdd_cfg80211_inform_bss_frame( hdd_adapter_t *pAdapter,
 
     ENTER();
 
-    if (!mgmt)
-        return NULL;
-
+    memset(mgmt, 0, sizeof (struct ieee80211_mgmt));
     memcpy(mgmt->bssid, bss_desc->bssId, ETH_ALEN);
 
 #ifdef WLAN_OPEN_SOURCE
@@ -3236,7 +3233,6 @@ wlan_hdd_cfg80211_inform_bss_frame( hdd_adapter_t *pAdapter,
     }
     else
     {
-        kfree(mgmt);
         return NULL;
     }
 #else
@@ -3261,8 +3257,28 @@ wlan_hdd_cfg80211_inform_bss_frame( hdd_adapter_t *pAdapter,
        rssi = (VOS_MIN ((bss_desc->rssi + bss_desc->sinr), 0))*100;
     }
 
-    bss_status = cfg80211_inform_bss_frame(wiphy, chan, mgmt,
+    return cfg80211_inform_bss_frame(wiphy, chan, mgmt,
             frame_len, rssi, GFP_KERNEL);
+}
+
+/*
+ * FUNCTION: wlan_hdd_cfg80211_inform_bss_frame
+ * This function is used to inform the BSS details to nl80211 interface.
+ */
+struct cfg80211_bss*
+wlan_hdd_cfg80211_inform_bss_frame( hdd_adapter_t *pAdapter,
+                                    tSirBssDescription *bss_desc
+                                    )
+{
+    int ie_length = GET_IE_LEN_IN_BSS_DESC( bss_desc->length );
+    struct ieee80211_mgmt *mgmt =
+        kmalloc((sizeof (struct ieee80211_mgmt) + ie_length), GFP_KERNEL);
+    struct cfg80211_bss *bss_status;
+
+    if (!mgmt)
+        return NULL;
+
+    bss_status = wlan_hdd_cfg80211_inform_bss_desc(pAdapter, bss_desc, mgmt);
     kfree(mgmt);
     return bss_status;
 }
@@ -3313,10 +3329,13 @@ static int wlan_hdd_cfg80211_update_bss( struct wiphy *wiphy,
                                         )
 {   
     tHalHandle hHal = WLAN_HDD_GET_HAL_CTX(pAdapter);
+    hdd_scaninfo_t *pScanInfo = &pAdapter->scan_info;
     tCsrScanResultInfo *pScanResult;
     eHalStatus status = 0;
     tScanResultHandle pResult;
     struct cfg80211_bss *bss_status = NULL;
+    struct ieee80211_mgmt *mgmt = NULL;
+    size_t mgmt_len = 0, frame_len;
 
     ENTER();
 
@@ -3326,6 +3345,9 @@ static int wlan_hdd_cfg80211_update_bss( struct wiphy *wiphy,
       return -EAGAIN;
     }
 
+    /* rebuilt from the results, for wlan_hdd_cfg80211_partial_scan() */
+    bitmap_zero(pScanInfo->seenChannels, 256);
+
     /*
      * start getting scan results and populate cgf80211 BSS database
      */
@@ -3351,11 +3373,32 @@ static int wlan_hdd_cfg80211_update_bss( struct wiphy *wiphy,
          * the mgmt(probe response) frame from PE, converting bss_desc to 
          * ieee80211_mgmt(probe response) and passing to c
          * fg80211_inform_bss_frame.
+         *
+         * Every result is handed over on each scan, cfg80211 expires the
+         * entries that were not, so the frames are built in one buffer
+         * that only grows for a BSS with more IEs than the ones before.
          * */
+        frame_len = sizeof (struct ieee80211_mgmt) +
+            GET_IE_LEN_IN_BSS_DESC(pScanResult->BssDescriptor.length);
+        if (frame_len > mgmt_len)
+        {
+            kfree(mgmt);
+            mgmt_len = max_t(size_t, frame_len, 512);
+            mgmt = kmalloc(mgmt_len, GFP_KERNEL);
+            if (NULL == mgmt)
+            {
+                hddLog(VOS_TRACE_LEVEL_ERROR,
+                        "%s: frame alloc failed\n", __func__);
+                break;
+            }
+        }
+
+        __set_bit(pScanResult->BssDescriptor.channelId,
+                  pScanInfo->seenChannels);
+
+        bss_status = wlan_hdd_cfg80211_inform_bss_desc(pAdapter,
+                &pScanResult->BssDescriptor, mgmt);
 
-        bss_status = wlan_hdd_cfg80211_inform_bss_frame(pAdapter,
-                &pScanResult->BssDescriptor);
-    
 
         if (NULL == bss_status)
         {
@@ -3370,6 +3413,7 @@ static int wlan_hdd_cfg80211_update_bss( struct wiphy *wiphy,
         pScanResult = sme_ScanResultGetNext(hHal, pResult);
     }
 
+    kfree(mgmt);
     sme_ScanResultPurge(hHal, pResult); 
 
     return 0; 
@@ -3569,6 +3613,74 @@ allow_suspend:
     return 0;
 }
 
+/*
+ * FUNCTION: wlan_hdd_cfg80211_all_channels
+ * Returns whether a request for numOfChannels channels covers every
+ * enabled channel of the wiphy, as a wildcard scan from the supplicant
+ * does when it was not given frequencies.
+ */
+static v_BOOL_t wlan_hdd_cfg80211_all_channels(struct wiphy *wiphy,
+                                               tANI_U32 numOfChannels)
+{
+    struct ieee80211_supported_band *sband;
+    tANI_U32 enabled = 0;
+    int band, i;
+
+    for (band = 0; band < IEEE80211_NUM_BANDS; band++)
+    {
+        sband = wiphy->bands[band];
+        if (NULL == sband)
+            continue;
+        for (i = 0; i < sband->n_channels; i++)
+        {
+            if (!(sband->channels[i].flags & IEEE80211_CHAN_DISABLED))
+                enabled++;
+        }
+    }
+
+    return numOfChannels >= enabled;
+}
+
+/*
+ * FUNCTION: wlan_hdd_cfg80211_partial_scan
+ * Within gPartialScanFullSweepMs of the last sweep of every channel,
+ * narrow the channel list of a scan to the channels the cached results
+ * were on.  SME keeps reporting the cached results of the others until
+ * they age out, and the next sweep finds whatever appeared there.
+ * Returns whether the list was narrowed.
+ */
+static v_BOOL_t wlan_hdd_cfg80211_partial_scan(hdd_adapter_t *pAdapter,
+                                               tCsrScanRequest *pScanRequest)
+{
+    hdd_scaninfo_t *pScanInfo = &pAdapter->scan_info;
+    hdd_config_t *cfg_param = (WLAN_HDD_GET_CTX(pAdapter))->cfg_ini;
+    tANI_U8 *channelList = pScanRequest->ChannelInfo.ChannelList;
+    tANI_U32 numOfChannels = pScanRequest->ChannelInfo.numOfChannels;
+    tANI_U32 i, n = 0;
+
+    if (!cfg_param->nPartialScanFullSweepMs || !pScanInfo->lastFullScan ||
+        time_after(jiffies, pScanInfo->lastFullScan +
+                   msecs_to_jiffies(cfg_param->nPartialScanFullSweepMs)))
+    {
+        return VOS_FALSE;
+    }
+
+    for (i = 0; i < numOfChannels; i++)
+    {
+        if (test_bit(channelList[i], pScanInfo->seenChannels))
+            channelList[n++] = channelList[i];
+    }
+
+    /* nothing was cached, look everywhere */
+    if (!n)
+        return VOS_FALSE;
+
+    hddLog(VOS_TRACE_LEVEL_INFO, "%s: scanning %lu of %lu channels",
+           __func__, n, numOfChannels);
+    pScanRequest->ChannelInfo.numOfChannels = n;
+    return VOS_TRUE;
+}
+
 /*
  * FUNCTION: wlan_hdd_cfg80211_scan
  * this scan respond to scan trigger and update cfg80211 scan database
@@ -3586,6 +3698,7 @@ int wlan_hdd_cfg80211_scan( struct wiphy *wiphy, struct net_device *dev,
     v_U32_t scanId = 0;
     int status = 0;
     hdd_scaninfo_t *pScanInfo = &pAdapter->scan_info;
+    v_BOOL_t fullSweep = VOS_FALSE;
 #ifdef WLAN_FEATURE_P2P
     v_U8_t* pP2pIe = NULL;
 #endif
@@ -3816,6 +3929,18 @@ int wlan_hdd_cfg80211_scan( struct wiphy *wiphy, struct net_device *dev,
         }
     }
 
+    /* Wildcard sweeps of every channel, as location services issue
+       them, visit only the recently seen channels between full ones */
+    if (channelList && 0 == request->n_ssids &&
+        WLAN_HDD_INFRA_STATION == pAdapter->device_mode &&
+#ifdef WLAN_FEATURE_P2P
+        !scanRequest.p2pSearch &&
+#endif
+        wlan_hdd_cfg80211_all_channels(wiphy, request->n_channels))
+    {
+        fullSweep = !wlan_hdd_cfg80211_partial_scan(pAdapter, &scanRequest);
+    }
+
     INIT_COMPLETION(pScanInfo->scan_req_completion_event);
 
     /* acquire the wakelock to avoid the apps suspend during the scan. To 
@@ -3851,6 +3976,8 @@ int wlan_hdd_cfg80211_scan( struct wiphy *wiphy, struct net_device *dev,
     pScanInfo->mScanPending = TRUE;
     pAdapter->request = request;
     pScanInfo->scanId = scanId;
+    if (fullSweep)
+        pScanInfo->lastFullScan = jiffies;
 
     complete(&pScanInfo->scan_req_completion_event);
 
@@ -119,6 +119,7 @@ extern tVOS_CON_MODE hdd_get_conparam ( void );
 
 #ifdef WLAN_FEATURE_PACKET_FILTERING
 extern void wlan_hdd_set_mc_addr_list(hdd_context_t *pHddCtx, v_U8_t set, v_U8_t sessionId);
+extern void wlan_hdd_set_wake_filter(hdd_context_t *pHddCtx, v_U8_t set, v_U8_t sessionId);
 #endif
 
 //Callback invoked by PMC to report status of standby request
@@ -901,6 +902,17 @@ static void hdd_conf_suspend_ind(hdd_context_t* pHddCtx,
               /*set the filter*/
               wlan_hdd_set_mc_addr_list(pHddCtx, TRUE, pAdapter->sessionId);
            }
+
+           /*Let ARP, neighbour discovery and mDNS through as well, also
+             when too many groups were joined for the address filters*/
+           if (((pAdapter->device_mode == WLAN_HDD_INFRA_STATION) ||
+                    (pAdapter->device_mode == WLAN_HDD_P2P_CLIENT))
+                 && pHddCtx->cfg_ini->suspendWakeFilter
+                 && (eConnectionState_Associated ==
+                    (WLAN_HDD_GET_STATION_CTX_PTR(pAdapter))->conn_info.connState))
+           {
+              wlan_hdd_set_wake_filter(pHddCtx, TRUE, pAdapter->sessionId);
+           }
         }
 #endif
     }
@@ -959,6 +971,10 @@ static void hdd_conf_resume_ind(hdd_context_t* pHddCtx, v_U8_t sessionId)
           /*Clear it here*/
           wlan_hdd_set_mc_addr_list(pHddCtx, FALSE, sessionId);
        }
+       if (pHddCtx->mc_addr_list.wakeFilterApplied)
+       {
+          wlan_hdd_set_wake_filter(pHddCtx, FALSE, sessionId);
+       }
     }
 #endif
 }
@@ -1139,6 +1139,10 @@ hdd_adapter_t* hdd_alloc_station_adapter( hdd_context_t *pHddCtx, tSirMacAddr ma
 
       hdd_set_station_ops( pAdapter->dev );
 
+      skb_queue_head_init(&pAdapter->rx_queue);
+      netif_napi_add(pWlanDev, &pAdapter->rx_napi, hdd_rx_poll,
+                     HDD_RX_NAPI_WEIGHT);
+
       pWlanDev->destructor = free_netdev;
 #ifdef CONFIG_CFG80211
       pWlanDev->ieee80211_ptr = &pAdapter->wdev ;
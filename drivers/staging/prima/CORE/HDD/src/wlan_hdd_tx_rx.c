@@ -40,6 +40,9 @@
 #include <linux/netdevice.h>
 #include <linux/skbuff.h>
 #include <linux/etherdevice.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+#include <linux/udp.h>
 
 #ifdef CONFIG_CFG80211
 #include <wlan_hdd_p2p.h>
@@ -146,6 +149,36 @@ static void transport_thread(hdd_adapter_t *pAdapter)
 #endif
 
 
+/**============================================================================
+  @brief hdd_tx_bql_completed() - Tell the byte queue limit of the netdev
+  TX queue that a frame queued by hdd_hard_start_xmit() is done with.
+  Must not be called with a wmm_tx_queue lock held.
+
+  @param skb : [in] pointer to OS packet (sk_buff)
+  @return    : None
+  ===========================================================================*/
+static void hdd_tx_bql_completed( struct sk_buff *skb )
+{
+#ifdef CONFIG_BQL
+   skb_list_node_t *pktNode = (skb_list_node_t *)&skb->cb;
+   struct netdev_queue *txq;
+   unsigned int pending;
+
+   if (unlikely(NULL == skb->dev))
+   {
+      return;
+   }
+   txq = netdev_get_tx_queue(skb->dev, skb_get_queue_mapping(skb));
+
+   //Serialize with other completions and with the accounting in xmit
+   __netif_tx_lock_bh(txq);
+   //Frames still in flight across a reset were accounted before it
+   pending = txq->dql.num_queued - txq->dql.num_completed;
+   netdev_tx_completed_queue(txq, 1, min_t(unsigned int, pktNode->txBytes, pending));
+   __netif_tx_unlock_bh(txq);
+#endif
+}
+
 /**============================================================================
   @brief hdd_flush_tx_queues() - Utility function to flush the TX queues
 
@@ -186,6 +219,12 @@ static VOS_STATUS hdd_flush_tx_queues( hdd_adapter_t *pAdapter )
       pAdapter->isTxSuspended[i] = VOS_FALSE;
    }
 
+   //The flushed frames will never complete, start the byte queue limits over
+   for (i = 0; i < NUM_TX_QUEUES; i++)
+   {
+      netdev_tx_reset_queue(netdev_get_tx_queue(pAdapter->dev, i));
+   }
+
    return status;
 }
 
@@ -542,6 +581,28 @@ int hdd_hard_start_xmit(struct sk_buff *skb, struct net_device *dev)
               "%s: Classified as ac %d up %d", __FUNCTION__, ac, up);
 #endif // HDD_WMM_DEBUG
 
+   //Use the skb->cb field to hold the list node information
+   pktNode = (skb_list_node_t *)&skb->cb;
+
+   //Stick the OS packet inside this node.
+   pktNode->skb = skb;
+
+   //Stick the User Priority inside this node 
+   pktNode->userPriority = up;
+
+   //Classify the frame for the TL meta info now, not in the fetch
+   pktNode->isEapol = ( skb_headlen(skb) >= HDD_ETHERTYPE_802_1_X_FRAME_OFFSET +
+                                            HDD_ETHERTYPE_802_1_X_SIZE ) &&
+      ( vos_be16_to_cpu( *(unsigned short*)&skb->data[HDD_ETHERTYPE_802_1_X_FRAME_OFFSET] )
+                                                    == HDD_ETHERTYPE_802_1_X );
+   pktNode->isBcast = vos_is_macaddr_broadcast( (v_MACADDR_t*)skb->data ) ? 1 : 0;
+   pktNode->isMcast = vos_is_macaddr_group( (v_MACADDR_t*)skb->data ) ? 1 : 0;
+   pktNode->txBytes = skb->len;
+
+   INIT_LIST_HEAD(&pktNode->anchor);
+
+   //Check for room and insert the OS packet into the appropriate AC
+   //queue under a single hold of the queue lock
    spin_lock(&pAdapter->wmm_tx_queue[ac].lock);
    /*For every increment of 10 pkts in the queue, we inform TL about pending pkts.
     * We check for +1 in the logic,to take care of Zero count which 
@@ -561,6 +622,10 @@ int hdd_hard_start_xmit(struct sk_buff *skb, struct net_device *dev)
       pAdapter->isTxSuspended[ac] = VOS_TRUE;
       txSuspended = VOS_TRUE;
    }
+   else
+   {
+      status = hdd_list_insert_back_size( &pAdapter->wmm_tx_queue[ac], &pktNode->anchor, &pktListSize );
+   }
 
    spin_unlock(&pAdapter->wmm_tx_queue[ac].lock);      
    if (VOS_TRUE == txSuspended)
@@ -571,23 +636,6 @@ int hdd_hard_start_xmit(struct sk_buff *skb, struct net_device *dev)
       return NETDEV_TX_BUSY;   
    }
 
-   //Use the skb->cb field to hold the list node information
-   pktNode = (skb_list_node_t *)&skb->cb;
-
-   //Stick the OS packet inside this node.
-   pktNode->skb = skb;
-
-   //Stick the User Priority inside this node 
-   pktNode->userPriority = up;
-
-
-   INIT_LIST_HEAD(&pktNode->anchor);
-
-   //Insert the OS packet into the appropriate AC queue
-   spin_lock(&pAdapter->wmm_tx_queue[ac].lock);
-   status = hdd_list_insert_back_size( &pAdapter->wmm_tx_queue[ac], &pktNode->anchor, &pktListSize );
-   spin_unlock(&pAdapter->wmm_tx_queue[ac].lock);
-
    if ( !VOS_IS_STATUS_SUCCESS( status ) )
    {
       VOS_TRACE( VOS_MODULE_ID_HDD, VOS_TRACE_LEVEL_ERROR,"%s:Insert Tx queue failed. Pkt dropped", __FUNCTION__);
@@ -601,6 +649,11 @@ int hdd_hard_start_xmit(struct sk_buff *skb, struct net_device *dev)
    ++pAdapter->hdd_stats.hddTxRxStats.txXmitQueued;
    ++pAdapter->hdd_stats.hddTxRxStats.txXmitQueuedAC[ac];
 
+   //Byte queue limits keep the HDD and TL queues of this AC short. The TX
+   //queue lock is held here, so no completion can be accounted before this.
+   netdev_tx_sent_queue(netdev_get_tx_queue(dev, skb_get_queue_mapping(skb)),
+                        pktNode->txBytes);
+
    //Make sure we have access to this access category
    if (likely(pAdapter->hddWmmStatus.wmmAcStatus[ac].wmmAcAccessAllowed) || 
            ( pHddStaCtx->conn_info.uIsAuthenticated == VOS_FALSE))
@@ -627,6 +680,8 @@ int hdd_hard_start_xmit(struct sk_buff *skb, struct net_device *dev)
          spin_lock(&pAdapter->wmm_tx_queue[ac].lock);
          status = hdd_list_remove_back( &pAdapter->wmm_tx_queue[ac], &anchor );
          spin_unlock(&pAdapter->wmm_tx_queue[ac].lock);
+         netdev_tx_completed_queue(netdev_get_tx_queue(dev, skb_get_queue_mapping(skb)),
+                                   1, pktNode->txBytes);
          ++pAdapter->stats.tx_dropped;
          ++pAdapter->hdd_stats.hddTxRxStats.txXmitDropped;
          ++pAdapter->hdd_stats.hddTxRxStats.txXmitDroppedAC[ac];
@@ -702,6 +757,14 @@ VOS_STATUS hdd_init_tx_rx( hdd_adapter_t *pAdapter )
       hdd_list_init( &pAdapter->wmm_tx_queue[i], HDD_TX_QUEUE_MAX_LEN);
    }
 
+   //The NAPI context exists for adapters allocated as station adapters,
+   //and init may be repeated when the device mode changes
+   if ( (NULL != pAdapter->rx_napi.poll) && !pAdapter->isRxNapiEnabled )
+   {
+      napi_enable(&pAdapter->rx_napi);
+      pAdapter->isRxNapiEnabled = VOS_TRUE;
+   }
+
    return status;
 }
 
@@ -726,6 +789,17 @@ VOS_STATUS hdd_deinit_tx_rx( hdd_adapter_t *pAdapter )
       hdd_list_destroy( &pAdapter->wmm_tx_queue[i] );
    }
 
+   //Wait for a running poll, then drop what it did not get to
+   if ( pAdapter->isRxNapiEnabled )
+   {
+      napi_disable(&pAdapter->rx_napi);
+      pAdapter->isRxNapiEnabled = VOS_FALSE;
+   }
+   if ( NULL != pAdapter->rx_napi.poll )
+   {
+      skb_queue_purge(&pAdapter->rx_queue);
+   }
+
    return status;
 }
 
@@ -854,6 +928,7 @@ VOS_STATUS hdd_tx_complete_cbk( v_VOID_t *vosContext,
       ++pAdapter->hdd_stats.hddTxRxStats.txCompleted;
    }
 
+   hdd_tx_bql_completed((struct sk_buff *)pOsPkt);
    kfree_skb((struct sk_buff *)pOsPkt); 
 
    //Return the VOS packet resources.
@@ -894,7 +969,6 @@ VOS_STATUS hdd_tx_fetch_packet_cbk( v_VOID_t *vosContext,
    skb_list_node_t *pktNode = NULL;
    struct sk_buff *skb = NULL;
    vos_pkt_t *pVosPacket = NULL;
-   v_MACADDR_t* pDestMacAddress = NULL;
    v_TIME_t timestamp;
    WLANTL_ACEnumType newAc;
    v_SIZE_t size = 0;
@@ -997,9 +1071,11 @@ VOS_STATUS hdd_tx_fetch_packet_cbk( v_VOID_t *vosContext,
       return VOS_STATUS_E_FAILURE;
    }
 
-   //Remove the packet from the queue
+   //Remove the packet from the queue, and see what is left behind it while
+   //the lock is held: the size read above is only a hint
    spin_lock_bh(&pAdapter->wmm_tx_queue[ac].lock);
    status = hdd_list_remove_front( &pAdapter->wmm_tx_queue[ac], &anchor );
+   size = pAdapter->wmm_tx_queue[ac].count;
    spin_unlock_bh(&pAdapter->wmm_tx_queue[ac].lock);
 
    if(VOS_STATUS_SUCCESS == status)
@@ -1007,6 +1083,8 @@ VOS_STATUS hdd_tx_fetch_packet_cbk( v_VOID_t *vosContext,
       //If success then we got a valid packet from some AC
       pktNode = list_entry(anchor, skb_list_node_t, anchor);
       skb = pktNode->skb;
+      //Count the packet just taken, as the checks below expect
+      size++;
    }
    else
    {
@@ -1025,6 +1103,7 @@ VOS_STATUS hdd_tx_fetch_packet_cbk( v_VOID_t *vosContext,
       vos_pkt_return_packet(pVosPacket);
       ++pAdapter->stats.tx_dropped;
       ++pAdapter->hdd_stats.hddTxRxStats.txFetchDequeueError;
+      hdd_tx_bql_completed(skb);
       kfree_skb(skb);
       return VOS_STATUS_E_FAILURE;
    }
@@ -1035,6 +1114,7 @@ VOS_STATUS hdd_tx_fetch_packet_cbk( v_VOID_t *vosContext,
       VOS_TRACE( VOS_MODULE_ID_HDD, VOS_TRACE_LEVEL_ERROR,"%s: VOS packet returned by VOSS is NULL", __FUNCTION__);
       ++pAdapter->stats.tx_dropped;
       ++pAdapter->hdd_stats.hddTxRxStats.txFetchDequeueError;
+      hdd_tx_bql_completed(skb);
       kfree_skb(skb);
       return VOS_STATUS_E_FAILURE;
    }
@@ -1050,7 +1130,7 @@ VOS_STATUS hdd_tx_fetch_packet_cbk( v_VOID_t *vosContext,
    if(pAdapter->sessionCtx.station.conn_info.uIsAuthenticated == VOS_TRUE)
       pPktMetaInfo->ucIsEapol = 0;       
    else 
-      pPktMetaInfo->ucIsEapol = hdd_IsEAPOLPacket( pVosPacket ) ? 1 : 0;
+      pPktMetaInfo->ucIsEapol = pktNode->isEapol;
 
 #ifdef FEATURE_WLAN_WAPI
    // Override usIsEapol value when its zero for WAPI case
@@ -1105,10 +1185,9 @@ VOS_STATUS hdd_tx_fetch_packet_cbk( v_VOID_t *vosContext,
        pPktMetaInfo->bMorePackets = 0;
    }
 
-   //Extract the destination address from ethernet frame
-   pDestMacAddress = (v_MACADDR_t*)skb->data;
-   pPktMetaInfo->ucBcast = vos_is_macaddr_broadcast( pDestMacAddress ) ? 1 : 0;
-   pPktMetaInfo->ucMcast = vos_is_macaddr_group( pDestMacAddress ) ? 1 : 0;
+   //Destination address was classified when the frame was queued
+   pPktMetaInfo->ucBcast = pktNode->isBcast;
+   pPktMetaInfo->ucMcast = pktNode->isMcast;
 
    
 
@@ -1250,6 +1329,151 @@ VOS_STATUS hdd_tx_low_resource_cbk( vos_pkt_t *pVosPacket,
 }
 
 
+/**============================================================================
+  @brief hdd_rx_poll() - NAPI poll function of a station adapter. Passes
+  the frames queued by hdd_rx_packet_cbk() to GRO, which merges the
+  segments of a TCP flow before they reach the stack.
+
+  @param napi   : [in] NAPI context of the adapter
+  @param budget : [in] maximum number of frames to deliver
+
+  @return       : number of frames delivered
+  ===========================================================================*/
+int hdd_rx_poll( struct napi_struct *napi, int budget )
+{
+   hdd_adapter_t *pAdapter = container_of(napi, hdd_adapter_t, rx_napi);
+   struct sk_buff *skb;
+   int work = 0;
+
+   while ( (work < budget) && (NULL != (skb = skb_dequeue(&pAdapter->rx_queue))) )
+   {
+      if (GRO_DROP == napi_gro_receive(napi, skb))
+      {
+         ++pAdapter->hdd_stats.hddTxRxStats.rxRefused;
+      }
+      else
+      {
+         ++pAdapter->hdd_stats.hddTxRxStats.rxDelivered;
+      }
+      work++;
+   }
+
+   if (work < budget)
+   {
+      napi_complete(napi);
+      //A frame queued after the last dequeue would be missed
+      if (!skb_queue_empty(&pAdapter->rx_queue))
+      {
+         napi_schedule(napi);
+      }
+   }
+
+   return work;
+}
+
+/**============================================================================
+  @brief hdd_rx_count_wake() - Account a frame received while the host is
+  suspended to what it was, to tell which traffic keeps waking it up.
+
+  @param pAdapter : [in] pointer to adapter context
+  @param skb      : [in] frame, already through eth_type_trans()
+  ===========================================================================*/
+static void hdd_rx_count_wake( hdd_adapter_t *pAdapter, struct sk_buff *skb )
+{
+   hdd_wake_stats_t *pWakeStats = &pAdapter->hdd_stats.hddWakeStats;
+   struct udphdr *udp = NULL;
+
+   if (PACKET_HOST == skb->pkt_type)
+   {
+      ++pWakeStats->wakeUnicast;
+      return;
+   }
+
+   if (htons(ETH_P_ARP) == skb->protocol)
+   {
+      ++pWakeStats->wakeArp;
+      return;
+   }
+
+   if ((htons(ETH_P_IPV6) == skb->protocol) &&
+       (skb_headlen(skb) >= sizeof(struct ipv6hdr)))
+   {
+      struct ipv6hdr *ip6 = (struct ipv6hdr *)skb->data;
+
+      if (IPPROTO_ICMPV6 == ip6->nexthdr)
+      {
+         ++pWakeStats->wakeIcmpv6;
+         return;
+      }
+      if ((IPPROTO_UDP == ip6->nexthdr) &&
+          (skb_headlen(skb) >= sizeof(*ip6) + sizeof(*udp)))
+      {
+         udp = (struct udphdr *)(ip6 + 1);
+      }
+   }
+   else if ((htons(ETH_P_IP) == skb->protocol) &&
+            (skb_headlen(skb) >= sizeof(struct iphdr)))
+   {
+      struct iphdr *ip = (struct iphdr *)skb->data;
+
+      if ((IPPROTO_UDP == ip->protocol) &&
+          (skb_headlen(skb) >= ip->ihl * 4 + sizeof(*udp)))
+      {
+         udp = (struct udphdr *)(skb->data + ip->ihl * 4);
+      }
+   }
+
+   if (udp && (htons(5353) == udp->dest))
+   {
+      ++pWakeStats->wakeMdns;
+   }
+   else if (PACKET_BROADCAST == skb->pkt_type)
+   {
+      ++pWakeStats->wakeBcast;
+   }
+   else
+   {
+      ++pWakeStats->wakeMcast;
+   }
+}
+
+/**============================================================================
+  @brief hdd_rx_deliver() - Hand the frames of one RX chain over to the
+  NAPI context of the adapter, taking the queue lock once for all of them.
+
+  @param pAdapter : [in] pointer to adapter context
+  @param rxList   : [in] frames to deliver, empty on return
+  ===========================================================================*/
+static void hdd_rx_deliver( hdd_adapter_t *pAdapter, struct sk_buff_head *rxList )
+{
+   v_U32_t dropped = 0;
+
+   if (skb_queue_empty(rxList))
+   {
+      return;
+   }
+
+   spin_lock_bh(&pAdapter->rx_queue.lock);
+   if (skb_queue_len(&pAdapter->rx_queue) < netdev_max_backlog)
+   {
+      skb_queue_splice_tail_init(rxList, &pAdapter->rx_queue);
+      //The poll runs when bottom halves are enabled again below
+      napi_schedule(&pAdapter->rx_napi);
+   }
+   else
+   {
+      dropped = skb_queue_len(rxList);
+   }
+   spin_unlock_bh(&pAdapter->rx_queue.lock);
+
+   if (dropped)
+   {
+      __skb_queue_purge(rxList);
+      pAdapter->hdd_stats.hddTxRxStats.rxRefused += dropped;
+      pAdapter->stats.rx_dropped += dropped;
+   }
+}
+
 /**============================================================================
   @brief hdd_rx_packet_cbk() - Receive callback registered with TL.
   TL will call this to notify the HDD when one or more packets were
@@ -1271,8 +1495,8 @@ VOS_STATUS hdd_rx_packet_cbk( v_VOID_t *vosContext,
    hdd_adapter_t *pAdapter = NULL;
    hdd_context_t *pHddCtx = NULL;
    VOS_STATUS status = VOS_STATUS_E_FAILURE;
-   int rxstat;
    struct sk_buff *skb = NULL;
+   struct sk_buff_head rxList;
    vos_pkt_t* pVosPacket;
    vos_pkt_t* pNextVosPacket;
 
@@ -1301,6 +1525,9 @@ VOS_STATUS hdd_rx_packet_cbk( v_VOID_t *vosContext,
 
    ++pAdapter->hdd_stats.hddTxRxStats.rxChains;
 
+   // the frames of the chain are collected here and delivered at once
+   __skb_queue_head_init(&rxList);
+
    // walk the chain until all are processed
    pVosPacket = pVosPacketChain;
    do
@@ -1314,6 +1541,7 @@ VOS_STATUS hdd_rx_packet_cbk( v_VOID_t *vosContext,
       {
          ++pAdapter->hdd_stats.hddTxRxStats.rxDropped;
          VOS_TRACE( VOS_MODULE_ID_HDD, VOS_TRACE_LEVEL_ERROR,"%s: Failure walking packet chain", __FUNCTION__);
+         hdd_rx_deliver(pAdapter, &rxList);
          return VOS_STATUS_E_FAILURE;
       }
 
@@ -1324,6 +1552,7 @@ VOS_STATUS hdd_rx_packet_cbk( v_VOID_t *vosContext,
       {
          ++pAdapter->hdd_stats.hddTxRxStats.rxDropped;
          VOS_TRACE( VOS_MODULE_ID_HDD, VOS_TRACE_LEVEL_ERROR,"%s: Failure extracting skb from vos pkt", __FUNCTION__);
+         hdd_rx_deliver(pAdapter, &rxList);
          return VOS_STATUS_E_FAILURE;
       }
 
@@ -1331,6 +1560,7 @@ VOS_STATUS hdd_rx_packet_cbk( v_VOID_t *vosContext,
       {
          VOS_TRACE(VOS_MODULE_ID_HDD, VOS_TRACE_LEVEL_FATAL,
            "Magic cookie(%x) for adapter sanity verification is invalid", pAdapter->magic);
+         __skb_queue_purge(&rxList);
          return eHAL_STATUS_FAILURE;
       }
 
@@ -1340,23 +1570,22 @@ VOS_STATUS hdd_rx_packet_cbk( v_VOID_t *vosContext,
       ++pAdapter->hdd_stats.hddTxRxStats.rxPackets;
       ++pAdapter->stats.rx_packets;
       pAdapter->stats.rx_bytes += skb->len;
+      if (pHddCtx->hdd_wlan_suspended)
+      {
+         hdd_rx_count_wake(pAdapter, skb);
+      }
 #ifdef WLAN_FEATURE_HOLD_RX_WAKELOCK
       wake_lock_timeout(&pHddCtx->rx_wake_lock, HDD_WAKE_LOCK_DURATION);
 #endif
-      rxstat = netif_rx_ni(skb);
-      if (NET_RX_SUCCESS == rxstat)
-      {
-         ++pAdapter->hdd_stats.hddTxRxStats.rxDelivered;
-      }
-      else
-      {
-         ++pAdapter->hdd_stats.hddTxRxStats.rxRefused;
-      }
+      __skb_queue_tail(&rxList, skb);
+
       // now process the next packet in the chain
       pVosPacket = pNextVosPacket;
 
    } while (pVosPacket);
 
+   hdd_rx_deliver(pAdapter, &rxList);
+
    //Return the entire VOS packet chain to the resource pool
    status = vos_pkt_return_packet( pVosPacketChain );
    if(!VOS_IS_STATUS_SUCCESS( status ))
@@ -188,6 +188,7 @@ static const hdd_freq_chan_map_t freq_chan_map[] = { {2412, 1}, {2417, 2},
 #ifdef WLAN_FEATURE_11AC
 #define WE_GET_RSSI          6
 #endif
+#define WE_GET_WAKE_STATS    7
 
 /* Private ioctls and their sub-ioctls */
 #define WLAN_PRIV_SET_NONE_GET_NONE   (SIOCIWFIRSTPRIV + 6)
@@ -318,6 +319,7 @@ static const hdd_freq_chan_map_t freq_chan_map[] = { {2412, 1}, {2417, 2},
 int wlan_hdd_set_filter(hdd_context_t *pHddCtx, tpPacketFilterCfg pRequest, 
                            v_U8_t sessionId);
 void wlan_hdd_set_mc_addr_list(hdd_context_t *pHddCtx, v_U8_t set, v_U8_t sessionId);
+void wlan_hdd_set_wake_filter(hdd_context_t *pHddCtx, v_U8_t set, v_U8_t sessionId);
 #endif
 
 #ifdef FEATURE_WLAN_NON_INTEGRATED_SOC
@@ -3923,6 +3925,26 @@ static int iw_get_char_setnone(struct net_device *dev, struct iw_request_info *i
             break;
         }
 
+        case WE_GET_WAKE_STATS:
+        {
+            hdd_wake_stats_t *pWakeStats = &pAdapter->hdd_stats.hddWakeStats;
+
+            snprintf(extra, WE_MAX_STR_LEN,
+                     "\nReceived while suspended"
+                     "\nunicast %u, arp %u, icmpv6 %u, mdns %u"
+                     "\nother broadcast %u, other multicast %u"
+                     "\n",
+                     pWakeStats->wakeUnicast,
+                     pWakeStats->wakeArp,
+                     pWakeStats->wakeIcmpv6,
+                     pWakeStats->wakeMdns,
+                     pWakeStats->wakeBcast,
+                     pWakeStats->wakeMcast
+                     );
+            wrqu->data.length = strlen(extra)+1;
+            break;
+        }
+
         case WE_GET_CFG:
         {
             hdd_cfg_get_config(WLAN_HDD_GET_CTX(pAdapter), extra, WE_MAX_STR_LEN);
@@ -5033,6 +5055,67 @@ void wlan_hdd_set_mc_addr_list(hdd_context_t *pHddCtx, v_U8_t set, v_U8_t sessio
     pHddCtx->mc_addr_list.isFilterApplied = set ? TRUE : FALSE;
 }
 
+/* Frames allowed to wake the host in suspend, one filter per
+   gSuspendWakeFilter bit, numbered after the multicast address filters */
+static const struct
+{
+    v_U8_t protocolLayer;
+    v_U8_t dataOffset;
+    v_U8_t dataLength;
+    v_U8_t compareData[2];
+} wlan_hdd_wake_filters[] =
+{
+    /* ARP: hardware type Ethernet */
+    { HDD_FILTER_PROTO_TYPE_ARP, 0, 2, { 0x00, 0x01 } },
+    /* IPv6: next header ICMPv6, which carries neighbour discovery */
+    { HDD_FILTER_PROTO_TYPE_IPV6, 6, 1, { 58 } },
+    /* UDP: destination port 5353, mDNS */
+    { HDD_FILTER_PROTO_TYPE_UDP, 2, 2, { 0x14, 0xe9 } },
+};
+
+void wlan_hdd_set_wake_filter(hdd_context_t *pHddCtx, v_U8_t set, v_U8_t sessionId)
+{
+    tPacketFilterCfg request;
+    v_U8_t mask;
+    v_U8_t i;
+
+    /* clear what was programmed, the setting may have changed since */
+    mask = set ? pHddCtx->cfg_ini->suspendWakeFilter :
+                 pHddCtx->mc_addr_list.wakeFilterApplied;
+
+    for (i = 0; i < ARRAY_SIZE(wlan_hdd_wake_filters); i++)
+    {
+        if (!(mask & (1 << i)))
+            continue;
+
+        memset(&request, 0, sizeof (tPacketFilterCfg));
+        request.filterId = WLAN_HDD_MAX_MC_ADDR_LIST + i;
+        if (set)
+        {
+            request.filterAction = HDD_RCV_FILTER_SET;
+            request.numParams = 1;
+            request.paramsData[0].protocolLayer =
+                wlan_hdd_wake_filters[i].protocolLayer;
+            request.paramsData[0].cmpFlag = HDD_FILTER_CMP_TYPE_EQUAL;
+            request.paramsData[0].dataOffset =
+                wlan_hdd_wake_filters[i].dataOffset;
+            request.paramsData[0].dataLength =
+                wlan_hdd_wake_filters[i].dataLength;
+            memcpy(request.paramsData[0].compareData,
+                   wlan_hdd_wake_filters[i].compareData,
+                   wlan_hdd_wake_filters[i].dataLength);
+        }
+        else
+        {
+            request.filterAction = HDD_RCV_FILTER_CLEAR;
+        }
+
+        if (wlan_hdd_set_filter(pHddCtx, &request, sessionId))
+            mask &= ~(1 << i);
+    }
+    pHddCtx->mc_addr_list.wakeFilterApplied = set ? mask : 0;
+}
+
 static int iw_set_packet_filter_params(struct net_device *dev, struct iw_request_info *info,
         union iwreq_data *wrqu, char *extra)
 {   
@@ -6099,6 +6182,10 @@ static const struct iw_priv_args we_private_args[] = {
         0,
         IW_PRIV_TYPE_CHAR| WE_MAX_STR_LEN,
         "getStats" },
+    {   WE_GET_WAKE_STATS,
+        0,
+        IW_PRIV_TYPE_CHAR| WE_MAX_STR_LEN,
+        "getWakeStats" },
     {   WE_GET_CFG,
         0,
         IW_PRIV_TYPE_CHAR| WE_MAX_STR_LEN,
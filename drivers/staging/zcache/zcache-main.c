@@ -7,14 +7,13 @@
  * Zcache provides an in-kernel "host implementation" for transcendent memory
  * and, thus indirectly, for cleancache and frontswap.  Zcache includes two
  * page-accessible memory [1] interfaces, both utilizing the crypto compression
- * API:
- * 1) "compression buddies" ("zbud") is used for ephemeral pages
- * 2) zsmalloc is used for persistent pages.
- * Xvmalloc (based on the TLSF allocator) has very low fragmentation
- * so maximizes space efficiency, while zbud allows pairs (and potentially,
- * in the future, more than a pair of) compressed pages to be closely linked
- * so that reclaiming can be done via the kernel's physical-page-oriented
- * "shrinker" interface.
+ * API and zsmalloc:
+ * 1) "zeph" is used for ephemeral pages, which are additionally kept on an
+ *    LRU list so that they can be evicted oldest first through the
+ *    kernel's "shrinker" interface
+ * 2) "zv" is used for persistent pages.
+ * zsmalloc packs compressed pages of any size densely, which matters most
+ * for the read-mostly clean page cache held by an ephemeral pool.
  *
  * [1] For a definition of page-accessible memory (aka PAM), see:
  *   http://marc.info/?l=linux-mm&m=127811271605009
@@ -31,6 +30,9 @@
 #include <linux/math64.h>
 #include <linux/crypto.h>
 #include <linux/string.h>
+#include <linux/mmzone.h>
+#include <linux/vmpressure.h>
+#include <linux/workqueue.h>
 #include "tmem.h"
 
 #include "../zsmalloc/zsmalloc.h"
@@ -63,6 +65,7 @@ MODULE_LICENSE("GPL");
 struct zcache_client {
 	struct tmem_pool *tmem_pools[MAX_POOLS_PER_CLIENT];
 	struct zs_pool *zspool;
+	struct zs_pool *eph_zspool;
 	bool allocated;
 	atomic_t refcount;
 };
@@ -116,544 +119,253 @@ static inline int zcache_comp_op(enum comp_op op,
 }
 
 /**********
- * Compression buddies ("zbud") provides for packing two (or, possibly
- * in the future, more) compressed ephemeral pages into a single "raw"
- * (physical) page and tracking them with data structures so that
- * the raw pages can be easily reclaimed.
+ * Ephemeral (cleancache) pages are compressed into a zsmalloc pool of
+ * their own.  zsmalloc objects cannot be reclaimed through the pageframe
+ * they live in, so each compressed page is tracked by a small descriptor
+ * ("zeph") kept on a global LRU list.  Eviction flushes the
+ * oldest descriptors through tmem, and zsmalloc hands a zspage back to the
+ * kernel once all objects in it are gone.
  *
- * A zbud page ("zbpg") is an aligned page containing a list_head,
- * a lock, and two "zbud headers".  The remainder of the physical
- * page is divided up into aligned 64-byte "chunks" which contain
- * the compressed data for zero, one, or two zbuds.  Each zbpg
- * resides on: (1) an "unused list" if it has no zbuds; (2) a
- * "buddied" list if it is fully populated  with two zbuds; or
- * (3) one of PAGE_SIZE/64 "unbuddied" lists indexed by how many chunks
- * the one unbuddied zbud uses.  The data inside a zbpg cannot be
- * read or written unless the zbpg's lock is held.
+ * The LRU is trimmed in the background whenever the compressed pages take
+ * more than zeph_max_percent of RAM, and by the zcache shrinker, which
+ * evicts much more aggressively once reclaim reaches the vmpressure levels
+ * at which the lowmemorykiller starts killing.
  */
 
-#define ZBH_SENTINEL  0x43214321
-#define ZBPG_SENTINEL  0xdeadbeef
+#define CHUNK_SHIFT	6
+#define CHUNK_SIZE	(1 << CHUNK_SHIFT)
+#define NCHUNKS		(PAGE_SIZE >> CHUNK_SHIFT)
 
-#define ZBUD_MAX_BUDS 2
+#define ZEPH_SENTINEL  0x43214321
 
-struct zbud_hdr {
-	uint16_t client_id;
-	uint16_t pool_id;
+/* pages evicted per pass when trimming the LRU down to its limit */
+#define ZEPH_EVICT_BATCH	32
+
+struct zeph {
+	struct list_head lru;
+	void *handle;
 	struct tmem_oid oid;
 	uint32_t index;
-	uint16_t size; /* compressed size in bytes, zero means unused */
+	uint16_t client_id;
+	uint16_t pool_id;
+	uint16_t size; /* compressed size in bytes */
 	DECL_SENTINEL
 };
 
-struct zbud_page {
-	struct list_head bud_list;
-	spinlock_t lock;
-	struct zbud_hdr buddy[ZBUD_MAX_BUDS];
-	DECL_SENTINEL
-	/* followed by NUM_CHUNK aligned CHUNK_SIZE-byte chunks */
-};
+/* least recently stored first; protects zcache_eph_zbytes too */
+static LIST_HEAD(zeph_lru);
+static DEFINE_SPINLOCK(zeph_lru_lock);
 
-#define CHUNK_SHIFT	6
-#define CHUNK_SIZE	(1 << CHUNK_SHIFT)
-#define CHUNK_MASK	(~(CHUNK_SIZE-1))
-#define NCHUNKS		(((PAGE_SIZE - sizeof(struct zbud_page)) & \
-				CHUNK_MASK) >> CHUNK_SHIFT)
-#define MAX_CHUNK	(NCHUNKS-1)
-
-static struct {
-	struct list_head list;
-	unsigned count;
-} zbud_unbuddied[NCHUNKS];
-/* list N contains pages with N chunks USED and NCHUNKS-N unused */
-/* element 0 is never used but optimizing that isn't worth it */
-static unsigned long zbud_cumul_chunk_counts[NCHUNKS];
-
-struct list_head zbud_buddied_list;
-static unsigned long zcache_zbud_buddied_count;
-
-/* protects the buddied list and all unbuddied lists */
-static DEFINE_SPINLOCK(zbud_budlists_spinlock);
-
-static LIST_HEAD(zbpg_unused_list);
-static unsigned long zcache_zbpg_unused_list_count;
-
-/* protects the unused page list */
-static DEFINE_SPINLOCK(zbpg_unused_list_spinlock);
-
-static atomic_t zcache_zbud_curr_raw_pages;
-static atomic_t zcache_zbud_curr_zpages;
-static unsigned long zcache_zbud_curr_zbytes;
-static unsigned long zcache_zbud_cumul_zpages;
-static unsigned long zcache_zbud_cumul_zbytes;
+/* compressed ephemeral pages may not take more than this percentage of RAM */
+static unsigned int zeph_max_percent = 10;
+
+static struct kmem_cache *zcache_zeph_cache;
+static unsigned long zcache_eph_zbytes;
+static unsigned long zcache_eph_cumul_zpages;
+static unsigned long zcache_evicted_eph_pages;
 static unsigned long zcache_compress_poor;
 static unsigned long zcache_mean_compress_poor;
 
 /* forward references */
-static void *zcache_get_free_page(void);
-static void zcache_free_page(void *p);
+static struct zeph *zcache_zeph_alloc(void);
+static struct tmem_pool *zcache_get_pool_by_id(uint16_t cli_id,
+						uint16_t poolid);
+static void zcache_put_pool(struct tmem_pool *pool);
+static void zeph_evict_work_fn(struct work_struct *work);
 
-/*
- * zbud helper functions
- */
+static DECLARE_WORK(zeph_evict_work, zeph_evict_work_fn);
 
-static inline unsigned zbud_max_buddy_size(void)
+static inline bool zeph_over_limit(void)
 {
-	return MAX_CHUNK << CHUNK_SHIFT;
+	return (ACCESS_ONCE(zcache_eph_zbytes) >> PAGE_SHIFT) >
+		(totalram_pages * zeph_max_percent) / 100;
 }
 
-static inline unsigned zbud_size_to_chunks(unsigned size)
+static struct zeph *zeph_create(struct zs_pool *zspool, uint16_t client_id,
+				uint16_t pool_id, struct tmem_oid *oid,
+				uint32_t index, void *cdata, unsigned clen)
 {
-	BUG_ON(size == 0 || size > zbud_max_buddy_size());
-	return (size + CHUNK_SIZE - 1) >> CHUNK_SHIFT;
-}
+	struct zeph *ze;
+	void *handle;
+	char *to;
 
-static inline int zbud_budnum(struct zbud_hdr *zh)
-{
-	unsigned offset = (unsigned long)zh & (PAGE_SIZE - 1);
-	struct zbud_page *zbpg = NULL;
-	unsigned budnum = -1U;
-	int i;
+	BUG_ON(!irqs_disabled());
+	handle = zs_malloc(zspool, clen);
+	if (!handle)
+		return NULL;
+	to = zs_map_object(zspool, handle);
+	memcpy(to, cdata, clen);
+	zs_unmap_object(zspool, handle);
 
-	for (i = 0; i < ZBUD_MAX_BUDS; i++)
-		if (offset == offsetof(typeof(*zbpg), buddy[i])) {
-			budnum = i;
-			break;
-		}
-	BUG_ON(budnum == -1U);
-	return budnum;
-}
+	ze = zcache_zeph_alloc();
+	SET_SENTINEL(ze, ZEPH);
+	ze->handle = handle;
+	ze->oid = *oid;
+	ze->index = index;
+	ze->client_id = client_id;
+	ze->pool_id = pool_id;
+	ze->size = clen;
 
-static char *zbud_data(struct zbud_hdr *zh, unsigned size)
-{
-	struct zbud_page *zbpg;
-	char *p;
-	unsigned budnum;
+	spin_lock(&zeph_lru_lock);
+	list_add_tail(&ze->lru, &zeph_lru);
+	zcache_eph_zbytes += clen;
+	zcache_eph_cumul_zpages++;
+	spin_unlock(&zeph_lru_lock);
 
-	ASSERT_SENTINEL(zh, ZBH);
-	budnum = zbud_budnum(zh);
-	BUG_ON(size == 0 || size > zbud_max_buddy_size());
-	zbpg = container_of(zh, struct zbud_page, buddy[budnum]);
-	ASSERT_SPINLOCK(&zbpg->lock);
-	p = (char *)zbpg;
-	if (budnum == 0)
-		p += ((sizeof(struct zbud_page) + CHUNK_SIZE - 1) &
-							CHUNK_MASK);
-	else if (budnum == 1)
-		p += PAGE_SIZE - ((size + CHUNK_SIZE - 1) & CHUNK_MASK);
-	return p;
+	if (zeph_over_limit())
+		schedule_work(&zeph_evict_work);
+	return ze;
 }
 
-/*
- * zbud raw page management
- */
-
-static struct zbud_page *zbud_alloc_raw_page(void)
+static void zeph_free(struct zs_pool *zspool, struct zeph *ze)
 {
-	struct zbud_page *zbpg = NULL;
-	struct zbud_hdr *zh0, *zh1;
-	bool recycled = 0;
-
-	/* if any pages on the zbpg list, use one */
-	spin_lock(&zbpg_unused_list_spinlock);
-	if (!list_empty(&zbpg_unused_list)) {
-		zbpg = list_first_entry(&zbpg_unused_list,
-				struct zbud_page, bud_list);
-		list_del_init(&zbpg->bud_list);
-		zcache_zbpg_unused_list_count--;
-		recycled = 1;
-	}
-	spin_unlock(&zbpg_unused_list_spinlock);
-	if (zbpg == NULL)
-		/* none on zbpg list, try to get a kernel page */
-		zbpg = zcache_get_free_page();
-	if (likely(zbpg != NULL)) {
-		INIT_LIST_HEAD(&zbpg->bud_list);
-		zh0 = &zbpg->buddy[0]; zh1 = &zbpg->buddy[1];
-		spin_lock_init(&zbpg->lock);
-		if (recycled) {
-			ASSERT_INVERTED_SENTINEL(zbpg, ZBPG);
-			SET_SENTINEL(zbpg, ZBPG);
-			BUG_ON(zh0->size != 0 || tmem_oid_valid(&zh0->oid));
-			BUG_ON(zh1->size != 0 || tmem_oid_valid(&zh1->oid));
-		} else {
-			atomic_inc(&zcache_zbud_curr_raw_pages);
-			INIT_LIST_HEAD(&zbpg->bud_list);
-			SET_SENTINEL(zbpg, ZBPG);
-			zh0->size = 0; zh1->size = 0;
-			tmem_oid_set_invalid(&zh0->oid);
-			tmem_oid_set_invalid(&zh1->oid);
-		}
-	}
-	return zbpg;
-}
+	unsigned long flags;
 
-static void zbud_free_raw_page(struct zbud_page *zbpg)
-{
-	struct zbud_hdr *zh0 = &zbpg->buddy[0], *zh1 = &zbpg->buddy[1];
+	ASSERT_SENTINEL(ze, ZEPH);
+	spin_lock(&zeph_lru_lock);
+	/* may already be off the LRU, see zeph_evict_pages() */
+	list_del_init(&ze->lru);
+	zcache_eph_zbytes -= ze->size;
+	spin_unlock(&zeph_lru_lock);
+	INVERT_SENTINEL(ze, ZEPH);
 
-	ASSERT_SENTINEL(zbpg, ZBPG);
-	BUG_ON(!list_empty(&zbpg->bud_list));
-	ASSERT_SPINLOCK(&zbpg->lock);
-	BUG_ON(zh0->size != 0 || tmem_oid_valid(&zh0->oid));
-	BUG_ON(zh1->size != 0 || tmem_oid_valid(&zh1->oid));
-	INVERT_SENTINEL(zbpg, ZBPG);
-	spin_unlock(&zbpg->lock);
-	spin_lock(&zbpg_unused_list_spinlock);
-	list_add(&zbpg->bud_list, &zbpg_unused_list);
-	zcache_zbpg_unused_list_count++;
-	spin_unlock(&zbpg_unused_list_spinlock);
-}
-
-/*
- * core zbud handling routines
- */
-
-static unsigned zbud_free(struct zbud_hdr *zh)
-{
-	unsigned size;
-
-	ASSERT_SENTINEL(zh, ZBH);
-	BUG_ON(!tmem_oid_valid(&zh->oid));
-	size = zh->size;
-	BUG_ON(zh->size == 0 || zh->size > zbud_max_buddy_size());
-	zh->size = 0;
-	tmem_oid_set_invalid(&zh->oid);
-	INVERT_SENTINEL(zh, ZBH);
-	zcache_zbud_curr_zbytes -= size;
-	atomic_dec(&zcache_zbud_curr_zpages);
-	return size;
-}
-
-static void zbud_free_and_delist(struct zbud_hdr *zh)
-{
-	unsigned chunks;
-	struct zbud_hdr *zh_other;
-	unsigned budnum = zbud_budnum(zh), size;
-	struct zbud_page *zbpg =
-		container_of(zh, struct zbud_page, buddy[budnum]);
-
-	spin_lock(&zbud_budlists_spinlock);
-	spin_lock(&zbpg->lock);
-	if (list_empty(&zbpg->bud_list)) {
-		/* ignore zombie page... see zbud_evict_pages() */
-		spin_unlock(&zbpg->lock);
-		spin_unlock(&zbud_budlists_spinlock);
-		return;
-	}
-	size = zbud_free(zh);
-	ASSERT_SPINLOCK(&zbpg->lock);
-	zh_other = &zbpg->buddy[(budnum == 0) ? 1 : 0];
-	if (zh_other->size == 0) { /* was unbuddied: unlist and free */
-		chunks = zbud_size_to_chunks(size) ;
-		BUG_ON(list_empty(&zbud_unbuddied[chunks].list));
-		list_del_init(&zbpg->bud_list);
-		zbud_unbuddied[chunks].count--;
-		spin_unlock(&zbud_budlists_spinlock);
-		zbud_free_raw_page(zbpg);
-	} else { /* was buddied: move remaining buddy to unbuddied list */
-		chunks = zbud_size_to_chunks(zh_other->size) ;
-		list_del_init(&zbpg->bud_list);
-		zcache_zbud_buddied_count--;
-		list_add_tail(&zbpg->bud_list, &zbud_unbuddied[chunks].list);
-		zbud_unbuddied[chunks].count++;
-		spin_unlock(&zbud_budlists_spinlock);
-		spin_unlock(&zbpg->lock);
-	}
-}
-
-static struct zbud_hdr *zbud_create(uint16_t client_id, uint16_t pool_id,
-					struct tmem_oid *oid,
-					uint32_t index, struct page *page,
-					void *cdata, unsigned size)
-{
-	struct zbud_hdr *zh0, *zh1, *zh = NULL;
-	struct zbud_page *zbpg = NULL, *ztmp;
-	unsigned nchunks;
-	char *to;
-	int i, found_good_buddy = 0;
-
-	nchunks = zbud_size_to_chunks(size) ;
-	for (i = MAX_CHUNK - nchunks + 1; i > 0; i--) {
-		spin_lock(&zbud_budlists_spinlock);
-		if (!list_empty(&zbud_unbuddied[i].list)) {
-			list_for_each_entry_safe(zbpg, ztmp,
-				    &zbud_unbuddied[i].list, bud_list) {
-				if (spin_trylock(&zbpg->lock)) {
-					found_good_buddy = i;
-					goto found_unbuddied;
-				}
-			}
-		}
-		spin_unlock(&zbud_budlists_spinlock);
-	}
-	/* didn't find a good buddy, try allocating a new page */
-	zbpg = zbud_alloc_raw_page();
-	if (unlikely(zbpg == NULL))
-		goto out;
-	/* ok, have a page, now compress the data before taking locks */
-	spin_lock(&zbud_budlists_spinlock);
-	spin_lock(&zbpg->lock);
-	list_add_tail(&zbpg->bud_list, &zbud_unbuddied[nchunks].list);
-	zbud_unbuddied[nchunks].count++;
-	zh = &zbpg->buddy[0];
-	goto init_zh;
-
-found_unbuddied:
-	ASSERT_SPINLOCK(&zbpg->lock);
-	zh0 = &zbpg->buddy[0]; zh1 = &zbpg->buddy[1];
-	BUG_ON(!((zh0->size == 0) ^ (zh1->size == 0)));
-	if (zh0->size != 0) { /* buddy0 in use, buddy1 is vacant */
-		ASSERT_SENTINEL(zh0, ZBH);
-		zh = zh1;
-	} else if (zh1->size != 0) { /* buddy1 in use, buddy0 is vacant */
-		ASSERT_SENTINEL(zh1, ZBH);
-		zh = zh0;
-	} else
-		BUG();
-	list_del_init(&zbpg->bud_list);
-	zbud_unbuddied[found_good_buddy].count--;
-	list_add_tail(&zbpg->bud_list, &zbud_buddied_list);
-	zcache_zbud_buddied_count++;
-
-init_zh:
-	SET_SENTINEL(zh, ZBH);
-	zh->size = size;
-	zh->index = index;
-	zh->oid = *oid;
-	zh->pool_id = pool_id;
-	zh->client_id = client_id;
-	to = zbud_data(zh, size);
-	memcpy(to, cdata, size);
-	spin_unlock(&zbpg->lock);
-	spin_unlock(&zbud_budlists_spinlock);
-
-	zbud_cumul_chunk_counts[nchunks]++;
-	atomic_inc(&zcache_zbud_curr_zpages);
-	zcache_zbud_cumul_zpages++;
-	zcache_zbud_curr_zbytes += size;
-	zcache_zbud_cumul_zbytes += size;
-out:
-	return zh;
+	local_irq_save(flags);
+	zs_free(zspool, ze->handle);
+	local_irq_restore(flags);
+	kmem_cache_free(zcache_zeph_cache, ze);
 }
 
-static int zbud_decompress(struct page *page, struct zbud_hdr *zh)
+static void zeph_decompress(struct page *page, struct zs_pool *zspool,
+				struct zeph *ze)
 {
-	struct zbud_page *zbpg;
-	unsigned budnum = zbud_budnum(zh);
 	unsigned int out_len = PAGE_SIZE;
 	char *to_va, *from_va;
-	unsigned size;
-	int ret = 0;
+	int ret;
 
-	zbpg = container_of(zh, struct zbud_page, buddy[budnum]);
-	spin_lock(&zbpg->lock);
-	if (list_empty(&zbpg->bud_list)) {
-		/* ignore zombie page... see zbud_evict_pages() */
-		ret = -EINVAL;
-		goto out;
-	}
-	ASSERT_SENTINEL(zh, ZBH);
-	BUG_ON(zh->size == 0 || zh->size > zbud_max_buddy_size());
+	ASSERT_SENTINEL(ze, ZEPH);
+	from_va = zs_map_object(zspool, ze->handle);
 	to_va = kmap_atomic(page);
-	size = zh->size;
-	from_va = zbud_data(zh, size);
-	ret = zcache_comp_op(ZCACHE_COMPOP_DECOMPRESS, from_va, size,
+	ret = zcache_comp_op(ZCACHE_COMPOP_DECOMPRESS, from_va, ze->size,
 				to_va, &out_len);
+	kunmap_atomic(to_va);
+	zs_unmap_object(zspool, ze->handle);
 	BUG_ON(ret);
 	BUG_ON(out_len != PAGE_SIZE);
-	kunmap_atomic(to_va);
-out:
-	spin_unlock(&zbpg->lock);
-	return ret;
 }
 
 /*
- * The following routines handle shrinking of ephemeral pages by evicting
- * pages "least valuable" first.
+ * Evict up to nr of the least recently stored ephemeral pages.  Only the
+ * tmem key is taken from the LRU under the lock; the page itself is then
+ * flushed like any other invalidation, which frees its zeph.  If the page
+ * was gotten or flushed in the meantime, the flush simply finds nothing.
  */
-
-static unsigned long zcache_evicted_raw_pages;
-static unsigned long zcache_evicted_buddied_pages;
-static unsigned long zcache_evicted_unbuddied_pages;
-
-static struct tmem_pool *zcache_get_pool_by_id(uint16_t cli_id,
-						uint16_t poolid);
-static void zcache_put_pool(struct tmem_pool *pool);
-
-/*
- * Flush and free all zbuds in a zbpg, then free the pageframe
- */
-static void zbud_evict_zbpg(struct zbud_page *zbpg)
+static unsigned long zeph_evict_pages(unsigned long nr)
 {
-	struct zbud_hdr *zh;
-	int i, j;
-	uint32_t pool_id[ZBUD_MAX_BUDS], client_id[ZBUD_MAX_BUDS];
-	uint32_t index[ZBUD_MAX_BUDS];
-	struct tmem_oid oid[ZBUD_MAX_BUDS];
+	struct zeph *ze;
 	struct tmem_pool *pool;
+	struct tmem_oid oid;
+	uint16_t client_id, pool_id;
+	uint32_t index;
+	unsigned long flags, evicted = 0;
 
-	ASSERT_SPINLOCK(&zbpg->lock);
-	BUG_ON(!list_empty(&zbpg->bud_list));
-	for (i = 0, j = 0; i < ZBUD_MAX_BUDS; i++) {
-		zh = &zbpg->buddy[i];
-		if (zh->size) {
-			client_id[j] = zh->client_id;
-			pool_id[j] = zh->pool_id;
-			oid[j] = zh->oid;
-			index[j] = zh->index;
-			j++;
-			zbud_free(zh);
+	while (evicted < nr) {
+		spin_lock_bh(&zeph_lru_lock);
+		if (list_empty(&zeph_lru)) {
+			spin_unlock_bh(&zeph_lru_lock);
+			break;
 		}
-	}
-	spin_unlock(&zbpg->lock);
-	for (i = 0; i < j; i++) {
-		pool = zcache_get_pool_by_id(client_id[i], pool_id[i]);
+		ze = list_first_entry(&zeph_lru, struct zeph, lru);
+		list_del_init(&ze->lru);
+		client_id = ze->client_id;
+		pool_id = ze->pool_id;
+		oid = ze->oid;
+		index = ze->index;
+		spin_unlock_bh(&zeph_lru_lock);
+
+		local_irq_save(flags);
+		pool = zcache_get_pool_by_id(client_id, pool_id);
 		if (pool != NULL) {
-			tmem_flush_page(pool, &oid[i], index[i]);
+			tmem_flush_page(pool, &oid, index);
 			zcache_put_pool(pool);
 		}
+		local_irq_restore(flags);
+		evicted++;
 	}
-	ASSERT_SENTINEL(zbpg, ZBPG);
-	spin_lock(&zbpg->lock);
-	zbud_free_raw_page(zbpg);
+	zcache_evicted_eph_pages += evicted;
+	return evicted;
+}
+
+static void zeph_evict_work_fn(struct work_struct *work)
+{
+	while (zeph_over_limit() && zeph_evict_pages(ZEPH_EVICT_BATCH))
+		cond_resched();
 }
 
 /*
- * Free nr pages.  This code is funky because we want to hold the locks
- * protecting various lists for as short a time as possible, and in some
- * circumstances the list may change asynchronously when the list lock is
- * not held.  In some cases we also trylock not only to avoid waiting on a
- * page in use by another cpu, but also to avoid potential deadlock due to
- * lock inversion.
+ * Highest reclaim pressure recently seen in the zones an allocation with
+ * gfp_mask may use; the lowmemorykiller bases its kill decisions on the
+ * same value.
  */
-static void zbud_evict_pages(int nr)
-{
-	struct zbud_page *zbpg;
-	int i;
-
-	/* first try freeing any pages on unused list */
-retry_unused_list:
-	spin_lock_bh(&zbpg_unused_list_spinlock);
-	if (!list_empty(&zbpg_unused_list)) {
-		/* can't walk list here, since it may change when unlocked */
-		zbpg = list_first_entry(&zbpg_unused_list,
-				struct zbud_page, bud_list);
-		list_del_init(&zbpg->bud_list);
-		zcache_zbpg_unused_list_count--;
-		atomic_dec(&zcache_zbud_curr_raw_pages);
-		spin_unlock_bh(&zbpg_unused_list_spinlock);
-		zcache_free_page(zbpg);
-		zcache_evicted_raw_pages++;
-		if (--nr <= 0)
-			goto out;
-		goto retry_unused_list;
-	}
-	spin_unlock_bh(&zbpg_unused_list_spinlock);
-
-	/* now try freeing unbuddied pages, starting with least space avail */
-	for (i = 0; i < MAX_CHUNK; i++) {
-retry_unbud_list_i:
-		spin_lock_bh(&zbud_budlists_spinlock);
-		if (list_empty(&zbud_unbuddied[i].list)) {
-			spin_unlock_bh(&zbud_budlists_spinlock);
-			continue;
-		}
-		list_for_each_entry(zbpg, &zbud_unbuddied[i].list, bud_list) {
-			if (unlikely(!spin_trylock(&zbpg->lock)))
-				continue;
-			list_del_init(&zbpg->bud_list);
-			zbud_unbuddied[i].count--;
-			spin_unlock(&zbud_budlists_spinlock);
-			zcache_evicted_unbuddied_pages++;
-			/* want budlists unlocked when doing zbpg eviction */
-			zbud_evict_zbpg(zbpg);
-			local_bh_enable();
-			if (--nr <= 0)
-				goto out;
-			goto retry_unbud_list_i;
-		}
-		spin_unlock_bh(&zbud_budlists_spinlock);
-	}
+static unsigned int zeph_vmpressure(gfp_t gfp_mask)
+{
+	struct zonelist *zonelist = node_zonelist(0, gfp_mask);
+	enum zone_type high_zoneidx = gfp_zone(gfp_mask);
+	unsigned int pressure = 0;
+	struct zoneref *z;
+	struct zone *zone;
 
-	/* as a last resort, free buddied pages */
-retry_bud_list:
-	spin_lock_bh(&zbud_budlists_spinlock);
-	if (list_empty(&zbud_buddied_list)) {
-		spin_unlock_bh(&zbud_budlists_spinlock);
-		goto out;
-	}
-	list_for_each_entry(zbpg, &zbud_buddied_list, bud_list) {
-		if (unlikely(!spin_trylock(&zbpg->lock)))
-			continue;
-		list_del_init(&zbpg->bud_list);
-		zcache_zbud_buddied_count--;
-		spin_unlock(&zbud_budlists_spinlock);
-		zcache_evicted_buddied_pages++;
-		/* want budlists unlocked when doing zbpg eviction */
-		zbud_evict_zbpg(zbpg);
-		local_bh_enable();
-		if (--nr <= 0)
-			goto out;
-		goto retry_bud_list;
-	}
-	spin_unlock_bh(&zbud_budlists_spinlock);
-out:
-	return;
+	for_each_zone_zonelist(zone, z, zonelist, high_zoneidx)
+		pressure = max(pressure, zone_vmpressure(zone));
+	return pressure;
 }
 
-static void zbud_init(void)
+#ifdef CONFIG_SYSFS
+static int zeph_show_pool_pages(char *buf)
 {
-	int i;
+	u64 total = 0;
 
-	INIT_LIST_HEAD(&zbud_buddied_list);
-	zcache_zbud_buddied_count = 0;
-	for (i = 0; i < NCHUNKS; i++) {
-		INIT_LIST_HEAD(&zbud_unbuddied[i].list);
-		zbud_unbuddied[i].count = 0;
-	}
+	if (zcache_host.eph_zspool)
+		total = zs_get_total_size_bytes(zcache_host.eph_zspool);
+	return sprintf(buf, "%llu\n", total >> PAGE_SHIFT);
 }
 
-#ifdef CONFIG_SYSFS
 /*
- * These sysfs routines show a nice distribution of how many zbpg's are
- * currently (and have ever been placed) in each unbuddied list.  It's fun
- * to watch but can probably go away before final merge.
+ * setting zeph_max_percent via sysfs sets the upper bound, as a
+ * percentage of totalram_pages, of the compressed size of all ephemeral
+ * (cleancache) pages.  Beyond it the least recently stored pages are
+ * evicted in the background.
  */
-static int zbud_show_unbuddied_list_counts(char *buf)
+static ssize_t zeph_max_percent_show(struct kobject *kobj,
+				     struct kobj_attribute *attr,
+				     char *buf)
 {
-	int i;
-	char *p = buf;
-
-	for (i = 0; i < NCHUNKS; i++)
-		p += sprintf(p, "%u ", zbud_unbuddied[i].count);
-	return p - buf;
+	return sprintf(buf, "%u\n", zeph_max_percent);
 }
 
-static int zbud_show_cumul_chunk_counts(char *buf)
+static ssize_t zeph_max_percent_store(struct kobject *kobj,
+				      struct kobj_attribute *attr,
+				      const char *buf, size_t count)
 {
-	unsigned long i, chunks = 0, total_chunks = 0, sum_total_chunks = 0;
-	unsigned long total_chunks_lte_21 = 0, total_chunks_lte_32 = 0;
-	unsigned long total_chunks_lte_42 = 0;
-	char *p = buf;
+	unsigned long val;
+	int err;
 
-	for (i = 0; i < NCHUNKS; i++) {
-		p += sprintf(p, "%lu ", zbud_cumul_chunk_counts[i]);
-		chunks += zbud_cumul_chunk_counts[i];
-		total_chunks += zbud_cumul_chunk_counts[i];
-		sum_total_chunks += i * zbud_cumul_chunk_counts[i];
-		if (i == 21)
-			total_chunks_lte_21 = total_chunks;
-		if (i == 32)
-			total_chunks_lte_32 = total_chunks;
-		if (i == 42)
-			total_chunks_lte_42 = total_chunks;
-	}
-	p += sprintf(p, "<=21:%lu <=32:%lu <=42:%lu, mean:%lu\n",
-		total_chunks_lte_21, total_chunks_lte_32, total_chunks_lte_42,
-		chunks == 0 ? 0 : sum_total_chunks / chunks);
-	return p - buf;
+	if (!capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	err = kstrtoul(buf, 10, &val);
+	if (err || val > 50)
+		return -EINVAL;
+	zeph_max_percent = val;
+	if (zeph_over_limit())
+		schedule_work(&zeph_evict_work);
+	return count;
 }
+
+static struct kobj_attribute zcache_zeph_max_percent_attr = {
+		.attr = { .name = "zeph_max_percent", .mode = 0644 },
+		.show = zeph_max_percent_show,
+		.store = zeph_max_percent_store,
+};
 #endif
 
 /**********
@@ -987,6 +699,11 @@ int zcache_new_client(uint16_t cli_id)
 	cli->zspool = zs_create_pool("zcache", ZCACHE_GFP_MASK);
 	if (cli->zspool == NULL)
 		goto out;
+#endif
+#ifdef CONFIG_CLEANCACHE
+	cli->eph_zspool = zs_create_pool("zcache_eph", ZCACHE_GFP_MASK);
+	if (cli->eph_zspool == NULL)
+		goto out;
 #endif
 	ret = 0;
 out:
@@ -994,7 +711,6 @@ out:
 }
 
 /* counters for debugging */
-static unsigned long zcache_failed_get_free_pages;
 static unsigned long zcache_failed_alloc;
 static unsigned long zcache_put_to_flush;
 
@@ -1016,7 +732,7 @@ static unsigned long zcache_curr_objnode_count_max;
  * actually do a malloc
  */
 struct zcache_preload {
-	void *page;
+	struct zeph *zeph;
 	struct tmem_obj *obj;
 	int nr;
 	struct tmem_objnode *objnodes[OBJNODE_TREE_MAX_PATH];
@@ -1028,7 +744,7 @@ static int zcache_do_preload(struct tmem_pool *pool)
 	struct zcache_preload *kp;
 	struct tmem_objnode *objnode;
 	struct tmem_obj *obj;
-	void *page;
+	struct zeph *zeph = NULL;
 	int ret = -ENOMEM;
 
 	if (unlikely(zcache_objnode_cache == NULL))
@@ -1058,11 +774,13 @@ static int zcache_do_preload(struct tmem_pool *pool)
 		zcache_failed_alloc++;
 		goto out;
 	}
-	page = (void *)__get_free_page(ZCACHE_GFP_MASK);
-	if (unlikely(page == NULL)) {
-		zcache_failed_get_free_pages++;
-		kmem_cache_free(zcache_obj_cache, obj);
-		goto out;
+	if (is_ephemeral(pool)) {
+		zeph = kmem_cache_alloc(zcache_zeph_cache, ZCACHE_GFP_MASK);
+		if (unlikely(zeph == NULL)) {
+			zcache_failed_alloc++;
+			kmem_cache_free(zcache_obj_cache, obj);
+			goto out;
+		}
 	}
 	preempt_disable();
 	kp = &__get_cpu_var(zcache_preloads);
@@ -1070,30 +788,27 @@ static int zcache_do_preload(struct tmem_pool *pool)
 		kp->obj = obj;
 	else
 		kmem_cache_free(zcache_obj_cache, obj);
-	if (kp->page == NULL)
-		kp->page = page;
-	else
-		free_page((unsigned long)page);
+	if (zeph != NULL) {
+		if (kp->zeph == NULL)
+			kp->zeph = zeph;
+		else
+			kmem_cache_free(zcache_zeph_cache, zeph);
+	}
 	ret = 0;
 out:
 	return ret;
 }
 
-static void *zcache_get_free_page(void)
+static struct zeph *zcache_zeph_alloc(void)
 {
 	struct zcache_preload *kp;
-	void *page;
+	struct zeph *zeph;
 
 	kp = &__get_cpu_var(zcache_preloads);
-	page = kp->page;
-	BUG_ON(page == NULL);
-	kp->page = NULL;
-	return page;
-}
-
-static void zcache_free_page(void *p)
-{
-	free_page((unsigned long)p);
+	zeph = kp->zeph;
+	BUG_ON(zeph == NULL);
+	kp->zeph = NULL;
+	return zeph;
 }
 
 /*
@@ -1189,12 +904,13 @@ static void *zcache_pampd_create(char *data, size_t size, bool raw, int eph,
 		ret = zcache_compress(page, &cdata, &clen);
 		if (ret == 0)
 			goto out;
-		if (clen == 0 || clen > zbud_max_buddy_size()) {
+		if (clen == 0 || clen > zv_max_zsize) {
 			zcache_compress_poor++;
 			goto out;
 		}
-		pampd = (void *)zbud_create(client_id, pool->pool_id, oid,
-						index, page, cdata, clen);
+		pampd = (void *)zeph_create(cli->eph_zspool, client_id,
+						pool->pool_id, oid, index,
+						cdata, clen);
 		if (pampd != NULL) {
 			count = atomic_inc_return(&zcache_curr_eph_pampd_count);
 			if (count > zcache_curr_eph_pampd_count_max)
@@ -1259,11 +975,12 @@ static int zcache_pampd_get_data_and_free(char *data, size_t *bufsize, bool raw,
 					void *pampd, struct tmem_pool *pool,
 					struct tmem_oid *oid, uint32_t index)
 {
+	struct zcache_client *cli = pool->client;
 	int ret = 0;
 
 	BUG_ON(!is_ephemeral(pool));
-	zbud_decompress((struct page *)(data), pampd);
-	zbud_free_and_delist((struct zbud_hdr *)pampd);
+	zeph_decompress((struct page *)(data), cli->eph_zspool, pampd);
+	zeph_free(cli->eph_zspool, pampd);
 	atomic_dec(&zcache_curr_eph_pampd_count);
 	return ret;
 }
@@ -1278,7 +995,7 @@ static void zcache_pampd_free(void *pampd, struct tmem_pool *pool,
 	struct zcache_client *cli = pool->client;
 
 	if (is_ephemeral(pool)) {
-		zbud_free_and_delist((struct zbud_hdr *)pampd);
+		zeph_free(cli->eph_zspool, pampd);
 		atomic_dec(&zcache_curr_eph_pampd_count);
 		BUG_ON(atomic_read(&zcache_curr_eph_pampd_count) < 0);
 	} else {
@@ -1399,9 +1116,9 @@ static int zcache_cpu_notifier(struct notifier_block *nb,
 			kmem_cache_free(zcache_obj_cache, kp->obj);
 			kp->obj = NULL;
 		}
-		if (kp->page) {
-			free_page((unsigned long)kp->page);
-			kp->page = NULL;
+		if (kp->zeph) {
+			kmem_cache_free(zcache_zeph_cache, kp->zeph);
+			kp->zeph = NULL;
 		}
 		break;
 	default:
@@ -1456,27 +1173,17 @@ ZCACHE_SYSFS_RO(flobj_total);
 ZCACHE_SYSFS_RO(flobj_found);
 ZCACHE_SYSFS_RO(failed_eph_puts);
 ZCACHE_SYSFS_RO(failed_pers_puts);
-ZCACHE_SYSFS_RO(zbud_curr_zbytes);
-ZCACHE_SYSFS_RO(zbud_cumul_zpages);
-ZCACHE_SYSFS_RO(zbud_cumul_zbytes);
-ZCACHE_SYSFS_RO(zbud_buddied_count);
-ZCACHE_SYSFS_RO(zbpg_unused_list_count);
-ZCACHE_SYSFS_RO(evicted_raw_pages);
-ZCACHE_SYSFS_RO(evicted_unbuddied_pages);
-ZCACHE_SYSFS_RO(evicted_buddied_pages);
-ZCACHE_SYSFS_RO(failed_get_free_pages);
+ZCACHE_SYSFS_RO(eph_zbytes);
+ZCACHE_SYSFS_RO(eph_cumul_zpages);
+ZCACHE_SYSFS_RO(evicted_eph_pages);
 ZCACHE_SYSFS_RO(failed_alloc);
 ZCACHE_SYSFS_RO(put_to_flush);
 ZCACHE_SYSFS_RO(compress_poor);
 ZCACHE_SYSFS_RO(mean_compress_poor);
-ZCACHE_SYSFS_RO_ATOMIC(zbud_curr_raw_pages);
-ZCACHE_SYSFS_RO_ATOMIC(zbud_curr_zpages);
+ZCACHE_SYSFS_RO_ATOMIC(curr_eph_pampd_count);
 ZCACHE_SYSFS_RO_ATOMIC(curr_obj_count);
 ZCACHE_SYSFS_RO_ATOMIC(curr_objnode_count);
-ZCACHE_SYSFS_RO_CUSTOM(zbud_unbuddied_list_counts,
-			zbud_show_unbuddied_list_counts);
-ZCACHE_SYSFS_RO_CUSTOM(zbud_cumul_chunk_counts,
-			zbud_show_cumul_chunk_counts);
+ZCACHE_SYSFS_RO_CUSTOM(eph_pool_pages, zeph_show_pool_pages);
 ZCACHE_SYSFS_RO_CUSTOM(zv_curr_dist_counts,
 			zv_curr_dist_counts_show);
 ZCACHE_SYSFS_RO_CUSTOM(zv_cumul_dist_counts,
@@ -1495,26 +1202,19 @@ static struct attribute *zcache_attrs[] = {
 	&zcache_failed_pers_puts_attr.attr,
 	&zcache_compress_poor_attr.attr,
 	&zcache_mean_compress_poor_attr.attr,
-	&zcache_zbud_curr_raw_pages_attr.attr,
-	&zcache_zbud_curr_zpages_attr.attr,
-	&zcache_zbud_curr_zbytes_attr.attr,
-	&zcache_zbud_cumul_zpages_attr.attr,
-	&zcache_zbud_cumul_zbytes_attr.attr,
-	&zcache_zbud_buddied_count_attr.attr,
-	&zcache_zbpg_unused_list_count_attr.attr,
-	&zcache_evicted_raw_pages_attr.attr,
-	&zcache_evicted_unbuddied_pages_attr.attr,
-	&zcache_evicted_buddied_pages_attr.attr,
-	&zcache_failed_get_free_pages_attr.attr,
+	&zcache_curr_eph_pampd_count_attr.attr,
+	&zcache_eph_pool_pages_attr.attr,
+	&zcache_eph_zbytes_attr.attr,
+	&zcache_eph_cumul_zpages_attr.attr,
+	&zcache_evicted_eph_pages_attr.attr,
 	&zcache_failed_alloc_attr.attr,
 	&zcache_put_to_flush_attr.attr,
-	&zcache_zbud_unbuddied_list_counts_attr.attr,
-	&zcache_zbud_cumul_chunk_counts_attr.attr,
 	&zcache_zv_curr_dist_counts_attr.attr,
 	&zcache_zv_cumul_dist_counts_attr.attr,
 	&zcache_zv_max_zsize_attr.attr,
 	&zcache_zv_max_mean_zsize_attr.attr,
 	&zcache_zv_page_count_policy_percent_attr.attr,
+	&zcache_zeph_max_percent_attr.attr,
 	NULL,
 };
 
@@ -1534,22 +1234,33 @@ static struct attribute_group zcache_attr_group = {
 static bool zcache_freeze;
 
 /*
- * zcache shrinker interface (only useful for ephemeral pages, so zbud only)
+ * zcache shrinker interface (only useful for ephemeral pages, so zeph only)
+ *
+ * Dropping a compressed clean page is far cheaper than losing a cached
+ * app, so once reclaim is under the pressure levels at which the
+ * lowmemorykiller stops deferring kills, each call evicts a multiple of
+ * its share from the LRU to give memory back before anything is killed.
  */
 static int shrink_zcache_memory(struct shrinker *shrink,
 				struct shrink_control *sc)
 {
 	int ret = -1;
-	int nr = sc->nr_to_scan;
+	unsigned long nr = sc->nr_to_scan;
 	gfp_t gfp_mask = sc->gfp_mask;
+	unsigned int pressure;
 
-	if (nr >= 0) {
+	if (sc->nr_to_scan > 0) {
 		if (!(gfp_mask & __GFP_FS))
 			/* does this case really need to be skipped? */
 			goto out;
-		zbud_evict_pages(nr);
+		pressure = zeph_vmpressure(gfp_mask);
+		if (pressure >= VMPRESSURE_LEVEL_CRITICAL)
+			nr <<= 4;
+		else if (pressure >= VMPRESSURE_LEVEL_MEDIUM)
+			nr <<= 2;
+		zeph_evict_pages(nr);
 	}
-	ret = (int)atomic_read(&zcache_zbud_curr_raw_pages);
+	ret = atomic_read(&zcache_curr_eph_pampd_count);
 out:
 	return ret;
 }
@@ -2047,6 +1758,8 @@ static int __init zcache_init(void)
 				sizeof(struct tmem_objnode), 0, 0, NULL);
 	zcache_obj_cache = kmem_cache_create("zcache_obj",
 				sizeof(struct tmem_obj), 0, 0, NULL);
+	zcache_zeph_cache = kmem_cache_create("zcache_zeph",
+				sizeof(struct zeph), 0, 0, NULL);
 	ret = zcache_new_client(LOCAL_CLIENT);
 	if (ret) {
 		pr_err("zcache: can't create client\n");
@@ -2057,11 +1770,10 @@ static int __init zcache_init(void)
 	if (zcache_enabled && use_cleancache) {
 		struct cleancache_ops old_ops;
 
-		zbud_init();
 		register_shrinker(&zcache_shrinker);
 		old_ops = zcache_cleancache_register_ops();
 		pr_info("zcache: cleancache enabled using kernel "
-			"transcendent memory and compression buddies\n");
+			"transcendent memory and zsmalloc\n");
 		if (old_ops.init_fs != NULL)
 			pr_warning("zcache: cleancache_ops overridden");
 	}
@@ -0,0 +1,565 @@
+/*
+ * Compressed RAM block device
+ *
+ * Compression benchmark on pages captured from the write path
+ *
+ * While 'capture' is set to N, every Nth full page written to any zram
+ * device is copied into a sample buffer of up to 'max_samples' pages.
+ * Writing to 'run' then replays the samples through the 'algorithm'
+ * compressor on each online CPU in turn and into a zsmalloc pool of
+ * their own, as zram_bvec_write() and zram_bvec_read() would, and
+ * 'result' reports the compression and decompression rates per CPU,
+ * the ratio by page type and its distribution, and the memory the pool
+ * took.  The pool lives until the next run, its class occupancy is in
+ * /sys/kernel/debug/zsmalloc/zram_bench/classes.
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+#define KMSG_COMPONENT "zram"
+#define pr_fmt(fmt) KMSG_COMPONENT ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/cpu.h>
+#include <linux/ctype.h>
+#include <linux/debugfs.h>
+#include <linux/err.h>
+#include <linux/fs.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
+
+#include "zram_drv.h"
+
+#define BENCH_RESULT_SIZE	(2 * PAGE_SIZE)
+#define BENCH_SIZE_BUCKETS	8	/* of PAGE_SIZE / 8 each */
+
+/* content classes the ratio is reported for */
+enum bench_page_type {
+	BENCH_ZERO,		/* all zeroes, never compressed by zram */
+	BENCH_FILLED,		/* one repeated word */
+	BENCH_TEXT,		/* mostly printable characters */
+	BENCH_BINARY,		/* anything else */
+	__NR_BENCH_TYPES,
+};
+
+static const char * const bench_type_names[] = {
+	"zero", "filled", "text", "binary",
+};
+
+/*
+ * struct bench_cpu_result - what one CPU measured
+ * @comp_ns:	time to compress all samples @loops times
+ * @decomp_ns:	time to decompress all stored objects @loops times
+ * @ret:	first error hit, if any
+ */
+struct bench_cpu_result {
+	s64 comp_ns;
+	s64 decomp_ns;
+	int ret;
+};
+
+/*
+ * struct zram_bench - captured samples and the state of a run
+ * @capture_lock:	protects @nr_samples and the sample slots
+ * @lock:		serializes runs and configuration changes
+ * @samples:		@max_samples pages of captured data
+ * @seen:		full pages written since capture was enabled
+ * @capture:		copy every @capture-th page, 0 when off
+ * @nr_run:		samples the current run covers
+ * @comp:		compressor of the current run
+ * @pool:		pool the compressed samples are stored in
+ * @handles:		object of each sample in @pool, NULL if not stored
+ * @sizes:		compressed size of each sample
+ * @scratch:		page samples are decompressed into
+ */
+static struct zram_bench {
+	spinlock_t capture_lock;
+	struct mutex lock;
+	unsigned char *samples;
+	u32 max_samples;
+	u32 nr_samples;
+	atomic_t seen;
+	u32 capture;
+	u32 loops;
+	char algorithm[10];
+
+	u32 nr_run;
+	struct zcomp *comp;
+	struct zs_pool *pool;
+	void **handles;
+	u16 *sizes;
+	unsigned char *scratch;
+	char *result;
+	struct dentry *root;
+} bench = {
+	.max_samples	= 1024,
+	.loops		= 4,
+	.algorithm	= "lzo",
+};
+
+void zram_bench_capture(const unsigned char *mem)
+{
+	u32 every = ACCESS_ONCE(bench.capture);
+
+	if (likely(!every) || atomic_inc_return(&bench.seen) % every)
+		return;
+
+	spin_lock(&bench.capture_lock);
+	if (bench.samples && bench.nr_samples < bench.max_samples)
+		memcpy(bench.samples + (size_t)bench.nr_samples++ * PAGE_SIZE,
+		       mem, PAGE_SIZE);
+	spin_unlock(&bench.capture_lock);
+}
+
+static unsigned char *bench_sample(u32 i)
+{
+	return bench.samples + (size_t)i * PAGE_SIZE;
+}
+
+static enum bench_page_type bench_classify(const unsigned char *mem)
+{
+	const unsigned long *word = (const unsigned long *)mem;
+	unsigned int i, printable = 0;
+
+	for (i = 1; i < PAGE_SIZE / sizeof(*word); i++)
+		if (word[i] != word[0])
+			break;
+	if (i == PAGE_SIZE / sizeof(*word))
+		return word[0] ? BENCH_FILLED : BENCH_ZERO;
+
+	for (i = 0; i < PAGE_SIZE; i++)
+		if (isprint(mem[i]) || isspace(mem[i]))
+			printable++;
+	return printable >= PAGE_SIZE / 10 * 9 ? BENCH_TEXT : BENCH_BINARY;
+}
+
+static void bench_free_run(void)
+{
+	u32 i;
+
+	if (bench.handles) {
+		for (i = 0; i < bench.nr_run; i++)
+			if (bench.handles[i])
+				zs_free(bench.pool, bench.handles[i]);
+	}
+	if (bench.pool)
+		zs_destroy_pool(bench.pool);
+	if (bench.comp)
+		zcomp_destroy(bench.comp);
+	vfree(bench.handles);
+	vfree(bench.sizes);
+	kfree(bench.scratch);
+	bench.pool = NULL;
+	bench.comp = NULL;
+	bench.handles = NULL;
+	bench.sizes = NULL;
+	bench.scratch = NULL;
+}
+
+/*
+ * Compress every sample once, store what zram would store in the pool
+ * and check that it decompresses to the original.
+ */
+static int bench_store_samples(void)
+{
+	struct zcomp_strm *zstrm;
+	unsigned char *cmem;
+	size_t clen;
+	u32 i;
+	int ret;
+
+	for (i = 0; i < bench.nr_run; i++) {
+		if (bench_classify(bench_sample(i)) == BENCH_ZERO)
+			continue;
+
+		zstrm = zcomp_strm_find(bench.comp);
+		ret = zcomp_compress(bench.comp, zstrm, bench_sample(i), &clen);
+		if (ret) {
+			zcomp_strm_release(bench.comp, zstrm);
+			return ret;
+		}
+		bench.sizes[i] = clen;
+		/* incompressible pages are kept as they are, not in the pool */
+		if (clen > max_zpage_size) {
+			bench.sizes[i] = PAGE_SIZE;
+			zcomp_strm_release(bench.comp, zstrm);
+			continue;
+		}
+
+		bench.handles[i] = zs_malloc(bench.pool, clen);
+		if (!bench.handles[i]) {
+			zcomp_strm_release(bench.comp, zstrm);
+			return -ENOMEM;
+		}
+		cmem = zs_map_object(bench.pool, bench.handles[i]);
+		memcpy(cmem, zstrm->buffer, clen);
+		zs_unmap_object(bench.pool, bench.handles[i]);
+		zcomp_strm_release(bench.comp, zstrm);
+
+		cmem = zs_map_object(bench.pool, bench.handles[i]);
+		ret = zcomp_decompress(bench.comp, cmem, clen, bench.scratch);
+		zs_unmap_object(bench.pool, bench.handles[i]);
+		if (ret || memcmp(bench.scratch, bench_sample(i), PAGE_SIZE)) {
+			pr_err("bench: sample %u does not decompress\n", i);
+			return ret ? ret : -EIO;
+		}
+	}
+	return 0;
+}
+
+/* runs bound to the CPU measured */
+static long bench_cpu(void *data)
+{
+	struct bench_cpu_result *res = data;
+	struct zcomp_strm *zstrm;
+	unsigned char *cmem;
+	ktime_t start;
+	size_t clen;
+	u32 loop, i;
+
+	zstrm = zcomp_strm_find(bench.comp);
+	start = ktime_get();
+	for (loop = 0; loop < bench.loops && !res->ret; loop++)
+		for (i = 0; i < bench.nr_run && !res->ret; i++)
+			if (bench.handles[i] || bench.sizes[i] == PAGE_SIZE)
+				res->ret = zcomp_compress(bench.comp, zstrm,
+						bench_sample(i), &clen);
+	res->comp_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	zcomp_strm_release(bench.comp, zstrm);
+
+	start = ktime_get();
+	for (loop = 0; loop < bench.loops && !res->ret; loop++) {
+		for (i = 0; i < bench.nr_run && !res->ret; i++) {
+			if (!bench.handles[i])
+				continue;
+			cmem = zs_map_object(bench.pool, bench.handles[i]);
+			res->ret = zcomp_decompress(bench.comp, cmem,
+					bench.sizes[i], bench.scratch);
+			zs_unmap_object(bench.pool, bench.handles[i]);
+		}
+	}
+	res->decomp_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	return 0;
+}
+
+/* MB/s for @pages pages in @ns */
+static u64 bench_mbps(u64 pages, s64 ns)
+{
+	return ns > 0 ? div64_u64(pages * PAGE_SIZE * 1000, ns) : 0;
+}
+
+static u64 bench_percent(u64 part, u64 whole)
+{
+	return whole ? div64_u64(part * 100, whole) : 0;
+}
+
+static int bench_run(void)
+{
+	struct bench_cpu_result res;
+	u32 type_pages[__NR_BENCH_TYPES] = { 0 };
+	u64 type_bytes[__NR_BENCH_TYPES] = { 0 };
+	u32 buckets[BENCH_SIZE_BUCKETS] = { 0 };
+	u32 nr_comp = 0, nr_decomp = 0, nr_huge = 0, i;
+	u64 stored = 0, pool_bytes;
+	char *p = bench.result;
+	size_t left = BENCH_RESULT_SIZE;
+	enum bench_page_type type;
+	int cpu, ret, len;
+
+	bench_free_run();
+
+	/* the samples stay put while they are replayed */
+	spin_lock(&bench.capture_lock);
+	bench.capture = 0;
+	bench.nr_run = bench.nr_samples;
+	spin_unlock(&bench.capture_lock);
+	if (!bench.nr_run)
+		return -ENODATA;
+
+	bench.comp = zcomp_create(bench.algorithm);
+	if (IS_ERR(bench.comp)) {
+		ret = PTR_ERR(bench.comp);
+		bench.comp = NULL;
+		return ret;
+	}
+	ret = -ENOMEM;
+	bench.pool = zs_create_pool("zram_bench", GFP_NOIO | __GFP_HIGHMEM);
+	bench.handles = vzalloc(bench.nr_run * sizeof(*bench.handles));
+	bench.sizes = vzalloc(bench.nr_run * sizeof(*bench.sizes));
+	bench.scratch = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!bench.pool || !bench.handles || !bench.sizes || !bench.scratch)
+		goto fail;
+
+	ret = bench_store_samples();
+	if (ret)
+		goto fail;
+
+	for (i = 0; i < bench.nr_run; i++) {
+		type = bench_classify(bench_sample(i));
+		type_pages[type]++;
+		type_bytes[type] += bench.sizes[i];
+		if (type == BENCH_ZERO)
+			continue;
+		nr_comp++;
+		if (bench.sizes[i] == PAGE_SIZE) {
+			nr_huge++;
+			continue;
+		}
+		nr_decomp++;
+		stored += bench.sizes[i];
+		buckets[min_t(u32, bench.sizes[i] * BENCH_SIZE_BUCKETS /
+			      PAGE_SIZE, BENCH_SIZE_BUCKETS - 1)]++;
+	}
+	pool_bytes = zs_get_total_size_bytes(bench.pool);
+
+	len = scnprintf(p, left, "algorithm %s samples %u loops %u\n"
+			"cpu comp_MBps decomp_MBps\n", bench.algorithm,
+			bench.nr_run, bench.loops);
+	get_online_cpus();
+	for_each_online_cpu(cpu) {
+		memset(&res, 0, sizeof(res));
+		work_on_cpu(cpu, bench_cpu, &res);
+		if (res.ret) {
+			ret = res.ret;
+			put_online_cpus();
+			goto fail;
+		}
+		len += scnprintf(p + len, left - len, "%3d %10llu %11llu\n",
+				 cpu, bench_mbps((u64)nr_comp * bench.loops,
+						 res.comp_ns),
+				 bench_mbps((u64)nr_decomp * bench.loops,
+					    res.decomp_ns));
+	}
+	put_online_cpus();
+
+	/* zero pages take no memory, their ratio is shown as 0 */
+	len += scnprintf(p + len, left - len, "type   pages ratio%%\n");
+	for (type = 0; type < __NR_BENCH_TYPES; type++)
+		len += scnprintf(p + len, left - len, "%-6s %5u %6llu\n",
+				 bench_type_names[type], type_pages[type],
+				 bench_percent(type_bytes[type],
+					(u64)type_pages[type] * PAGE_SIZE));
+
+	len += scnprintf(p + len, left - len, "compressed_size pages\n");
+	for (i = 0; i < BENCH_SIZE_BUCKETS; i++)
+		len += scnprintf(p + len, left - len, "%4lu-%-4lu %8u\n",
+				 i * PAGE_SIZE / BENCH_SIZE_BUCKETS,
+				 (i + 1) * PAGE_SIZE / BENCH_SIZE_BUCKETS - 1,
+				 buckets[i]);
+	len += scnprintf(p + len, left - len, "huge      %8u\n", nr_huge);
+
+	len += scnprintf(p + len, left - len,
+			 "pool objects %u compr_bytes %llu pool_bytes %llu\n",
+			 nr_decomp, stored, pool_bytes);
+	return 0;
+
+fail:
+	bench_free_run();
+	scnprintf(bench.result, BENCH_RESULT_SIZE, "failed %d\n", ret);
+	return ret;
+}
+
+static ssize_t bench_run_write(struct file *file, const char __user *buf,
+			       size_t count, loff_t *ppos)
+{
+	int ret;
+
+	mutex_lock(&bench.lock);
+	ret = bench_run();
+	mutex_unlock(&bench.lock);
+	return ret ? ret : count;
+}
+
+static const struct file_operations bench_run_fops = {
+	.open	= simple_open,
+	.write	= bench_run_write,
+	.llseek	= noop_llseek,
+};
+
+static ssize_t bench_result_read(struct file *file, char __user *buf,
+				 size_t count, loff_t *ppos)
+{
+	ssize_t ret;
+
+	mutex_lock(&bench.lock);
+	ret = simple_read_from_buffer(buf, count, ppos, bench.result,
+				      strlen(bench.result));
+	mutex_unlock(&bench.lock);
+	return ret;
+}
+
+static const struct file_operations bench_result_fops = {
+	.open	= simple_open,
+	.read	= bench_result_read,
+	.llseek	= default_llseek,
+};
+
+static ssize_t bench_algorithm_read(struct file *file, char __user *buf,
+				    size_t count, loff_t *ppos)
+{
+	char name[sizeof(bench.algorithm) + 1];
+	int len;
+
+	mutex_lock(&bench.lock);
+	len = scnprintf(name, sizeof(name), "%s\n", bench.algorithm);
+	mutex_unlock(&bench.lock);
+	return simple_read_from_buffer(buf, count, ppos, name, len);
+}
+
+static ssize_t bench_algorithm_write(struct file *file,
+				     const char __user *buf, size_t count,
+				     loff_t *ppos)
+{
+	char name[sizeof(bench.algorithm)];
+	size_t len = min(count, sizeof(name) - 1);
+
+	if (copy_from_user(name, buf, len))
+		return -EFAULT;
+	name[len] = '\0';
+	strim(name);
+	if (!zcomp_available_algorithm(name))
+		return -EINVAL;
+
+	mutex_lock(&bench.lock);
+	strcpy(bench.algorithm, name);
+	mutex_unlock(&bench.lock);
+	return count;
+}
+
+static const struct file_operations bench_algorithm_fops = {
+	.open	= simple_open,
+	.read	= bench_algorithm_read,
+	.write	= bench_algorithm_write,
+	.llseek	= default_llseek,
+};
+
+static int bench_capture_get(void *data, u64 *val)
+{
+	*val = bench.capture;
+	return 0;
+}
+
+/* the sample buffer is allocated when capture starts with none */
+static int bench_capture_set(void *data, u64 val)
+{
+	unsigned char *samples = NULL;
+
+	if (val > UINT_MAX)
+		return -EINVAL;
+
+	mutex_lock(&bench.lock);
+	if (val && !bench.samples) {
+		samples = vmalloc((size_t)bench.max_samples * PAGE_SIZE);
+		if (!samples) {
+			mutex_unlock(&bench.lock);
+			return -ENOMEM;
+		}
+		bench_free_run();
+		spin_lock(&bench.capture_lock);
+		bench.samples = samples;
+		bench.nr_samples = 0;
+		spin_unlock(&bench.capture_lock);
+	}
+	atomic_set(&bench.seen, 0);
+	bench.capture = val;
+	mutex_unlock(&bench.lock);
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(bench_capture_fops, bench_capture_get,
+			bench_capture_set, "%llu\n");
+
+static int bench_clear_set(void *data, u64 val)
+{
+	unsigned char *samples;
+
+	mutex_lock(&bench.lock);
+	bench.capture = 0;
+	bench_free_run();
+	spin_lock(&bench.capture_lock);
+	samples = bench.samples;
+	bench.samples = NULL;
+	bench.nr_samples = 0;
+	spin_unlock(&bench.capture_lock);
+	mutex_unlock(&bench.lock);
+	vfree(samples);
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(bench_clear_fops, NULL, bench_clear_set, "%llu\n");
+
+static int bench_max_samples_get(void *data, u64 *val)
+{
+	*val = bench.max_samples;
+	return 0;
+}
+
+/* the size of a sample buffer is fixed until it is cleared */
+static int bench_max_samples_set(void *data, u64 val)
+{
+	int ret = -EBUSY;
+
+	if (!val || val > totalram_pages / 4)
+		return -EINVAL;
+
+	mutex_lock(&bench.lock);
+	if (!bench.samples) {
+		bench.max_samples = val;
+		ret = 0;
+	}
+	mutex_unlock(&bench.lock);
+	return ret;
+}
+DEFINE_SIMPLE_ATTRIBUTE(bench_max_samples_fops, bench_max_samples_get,
+			bench_max_samples_set, "%llu\n");
+
+int zram_bench_init(void)
+{
+	spin_lock_init(&bench.capture_lock);
+	mutex_init(&bench.lock);
+
+	bench.result = kzalloc(BENCH_RESULT_SIZE, GFP_KERNEL);
+	if (!bench.result)
+		return -ENOMEM;
+
+	/* the benchmark is optional, zram works without it */
+	bench.root = debugfs_create_dir("zram_bench", NULL);
+	if (IS_ERR_OR_NULL(bench.root)) {
+		bench.root = NULL;
+		return 0;
+	}
+	debugfs_create_file("capture", S_IRUGO | S_IWUSR, bench.root, NULL,
+			    &bench_capture_fops);
+	debugfs_create_file("max_samples", S_IRUGO | S_IWUSR, bench.root,
+			    NULL, &bench_max_samples_fops);
+	debugfs_create_u32("nr_samples", S_IRUGO, bench.root,
+			   &bench.nr_samples);
+	debugfs_create_file("clear", S_IWUSR, bench.root, NULL,
+			    &bench_clear_fops);
+	debugfs_create_u32("loops", S_IRUGO | S_IWUSR, bench.root,
+			   &bench.loops);
+	debugfs_create_file("algorithm", S_IRUGO | S_IWUSR, bench.root, NULL,
+			    &bench_algorithm_fops);
+	debugfs_create_file("run", S_IWUSR, bench.root, NULL,
+			    &bench_run_fops);
+	debugfs_create_file("result", S_IRUGO, bench.root, NULL,
+			    &bench_result_fops);
+	return 0;
+}
+
+void zram_bench_exit(void)
+{
+	debugfs_remove_recursive(bench.root);
+	bench_clear_set(NULL, 0);
+	kfree(bench.result);
+}
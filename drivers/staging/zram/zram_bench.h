@@ -0,0 +1,26 @@
+/*
+ * Compressed RAM block device
+ *
+ * Compression benchmark on pages captured from the write path
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+#ifndef _ZRAM_BENCH_H_
+#define _ZRAM_BENCH_H_
+
+#ifdef CONFIG_ZRAM_BENCH
+void zram_bench_capture(const unsigned char *mem);
+int zram_bench_init(void);
+void zram_bench_exit(void);
+#else
+static inline void zram_bench_capture(const unsigned char *mem) {}
+static inline int zram_bench_init(void) { return 0; }
+static inline void zram_bench_exit(void) {}
+#endif
+
+#endif /* _ZRAM_BENCH_H_ */
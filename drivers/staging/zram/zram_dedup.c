@@ -0,0 +1,146 @@
+/*
+ * Compressed RAM block device
+ *
+ * Same-page deduplication of compressed objects
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+#define KMSG_COMPONENT "zram"
+#define pr_fmt(fmt) KMSG_COMPONENT ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/jhash.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include "zram_drv.h"
+
+u32 zram_dedup_checksum(unsigned char *mem)
+{
+	return jhash2((const u32 *)mem, PAGE_SIZE / sizeof(u32), 0);
+}
+
+/*
+ * Compare an existing object with the page being written. A checksum
+ * match is only a hint, so the candidate is decompressed into the
+ * caller's stream buffer and compared byte for byte.
+ */
+static bool zram_dedup_match(struct zram *zram, struct zram_dedup_entry *entry,
+		unsigned char *mem, struct zcomp_strm *zstrm)
+{
+	int ret;
+	unsigned char *cmem;
+
+	cmem = zs_map_object(zram->mem_pool, entry->handle);
+	ret = zcomp_decompress(zram->comp, cmem + sizeof(struct zobj_header),
+			       entry->len, zstrm->buffer);
+	zs_unmap_object(zram->mem_pool, entry->handle);
+
+	return !ret && !memcmp(mem, zstrm->buffer, PAGE_SIZE);
+}
+
+/*
+ * Returns an entry holding the same content as @mem with a reference
+ * taken on behalf of the caller, or NULL if there is none.
+ */
+struct zram_dedup_entry *zram_dedup_find(struct zram *zram,
+		unsigned char *mem, u32 checksum, struct zcomp_strm *zstrm)
+{
+	struct rb_node *rb_node;
+	struct zram_dedup_entry *entry = NULL;
+
+	spin_lock(&zram->dedup_lock);
+	rb_node = zram->dedup_tree.rb_node;
+	while (rb_node) {
+		struct zram_dedup_entry *cur;
+
+		cur = rb_entry(rb_node, struct zram_dedup_entry, rb_node);
+		if (checksum == cur->checksum) {
+			entry = cur;
+			entry->refcount++;
+			break;
+		}
+
+		if (checksum < cur->checksum)
+			rb_node = rb_node->rb_left;
+		else
+			rb_node = rb_node->rb_right;
+	}
+	spin_unlock(&zram->dedup_lock);
+
+	if (!entry)
+		return NULL;
+
+	if (zram_dedup_match(zram, entry, mem, zstrm))
+		return entry;
+
+	/* Checksum collision: keep the page unshared */
+	zram_dedup_put(zram, entry);
+	return NULL;
+}
+
+struct zram_dedup_entry *zram_dedup_insert(struct zram *zram, u32 checksum,
+		void *handle, u16 len)
+{
+	struct rb_node **rb_node, *parent = NULL;
+	struct zram_dedup_entry *entry;
+
+	entry = kmalloc(sizeof(*entry), GFP_NOIO);
+	if (!entry)
+		return NULL;
+
+	entry->checksum = checksum;
+	entry->refcount = 1;
+	entry->handle = handle;
+	entry->len = len;
+
+	spin_lock(&zram->dedup_lock);
+	rb_node = &zram->dedup_tree.rb_node;
+	while (*rb_node) {
+		struct zram_dedup_entry *cur;
+
+		parent = *rb_node;
+		cur = rb_entry(parent, struct zram_dedup_entry, rb_node);
+		/* Colliding checksums are kept, ordered to the right */
+		if (checksum < cur->checksum)
+			rb_node = &parent->rb_left;
+		else
+			rb_node = &parent->rb_right;
+	}
+	rb_link_node(&entry->rb_node, parent, rb_node);
+	rb_insert_color(&entry->rb_node, &zram->dedup_tree);
+	spin_unlock(&zram->dedup_lock);
+
+	return entry;
+}
+
+/*
+ * Drop one reference. Returns true if this was the last one, in which
+ * case the compressed object itself has been freed.
+ */
+bool zram_dedup_put(struct zram *zram, struct zram_dedup_entry *entry)
+{
+	spin_lock(&zram->dedup_lock);
+	if (--entry->refcount) {
+		spin_unlock(&zram->dedup_lock);
+		return false;
+	}
+	rb_erase(&entry->rb_node, &zram->dedup_tree);
+	spin_unlock(&zram->dedup_lock);
+
+	zs_free(zram->mem_pool, entry->handle);
+	kfree(entry);
+
+	return true;
+}
+
+void zram_dedup_init(struct zram *zram)
+{
+	zram->dedup_tree = RB_ROOT;
+	spin_lock_init(&zram->dedup_lock);
+}
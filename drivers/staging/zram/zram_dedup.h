@@ -0,0 +1,44 @@
+/*
+ * Compressed RAM block device
+ *
+ * Same-page deduplication of compressed objects
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+#ifndef _ZRAM_DEDUP_H_
+#define _ZRAM_DEDUP_H_
+
+#include <linux/rbtree.h>
+#include <linux/types.h>
+
+struct zram;
+struct zcomp_strm;
+
+/*
+ * One entry exists per unique compressed object. Every table slot
+ * that stores this content points to the entry, and the zsmalloc
+ * handle is only freed once the last of them goes away.
+ */
+struct zram_dedup_entry {
+	struct rb_node rb_node;
+	u32 checksum;
+	unsigned long refcount;
+	void *handle;
+	u16 len;
+};
+
+u32 zram_dedup_checksum(unsigned char *mem);
+struct zram_dedup_entry *zram_dedup_find(struct zram *zram,
+		unsigned char *mem, u32 checksum, struct zcomp_strm *zstrm);
+struct zram_dedup_entry *zram_dedup_insert(struct zram *zram, u32 checksum,
+		void *handle, u16 len);
+bool zram_dedup_put(struct zram *zram, struct zram_dedup_entry *entry);
+
+void zram_dedup_init(struct zram *zram);
+
+#endif /* _ZRAM_DEDUP_H_ */
@@ -29,7 +29,7 @@
 #include <linux/genhd.h>
 #include <linux/highmem.h>
 #include <linux/slab.h>
-#include <linux/lzo.h>
+#include <linux/err.h>
 #include <linux/string.h>
 #include <linux/vmalloc.h>
 
@@ -104,6 +104,129 @@ static int page_zero_filled(void *ptr)
 	return 1;
 }
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+static bool zram_wb_enabled(struct zram *zram)
+{
+	return zram->bdev != NULL;
+}
+
+/* Block 0 is never handed out so that 0 can mean "no block" */
+static unsigned long zram_alloc_bdev_block(struct zram *zram)
+{
+	unsigned long blk_idx;
+
+	do {
+		blk_idx = find_next_zero_bit(zram->bitmap,
+					     zram->nr_bdev_pages, 1);
+		if (blk_idx >= zram->nr_bdev_pages)
+			return 0;
+	} while (test_and_set_bit(blk_idx, zram->bitmap));
+
+	return blk_idx;
+}
+
+static void zram_free_bdev_block(struct zram *zram, unsigned long blk_idx)
+{
+	WARN_ON_ONCE(!test_and_clear_bit(blk_idx, zram->bitmap));
+}
+
+static void zram_bdev_end_io(struct bio *bio, int err)
+{
+	complete(bio->bi_private);
+}
+
+static int zram_bdev_rw(struct zram *zram, struct page *page,
+			unsigned long blk_idx, int rw)
+{
+	DECLARE_COMPLETION_ONSTACK(done);
+	struct bio *bio;
+	int ret = 0;
+
+	bio = bio_alloc(GFP_NOIO, 1);
+	if (!bio)
+		return -ENOMEM;
+
+	bio->bi_sector = blk_idx << SECTORS_PER_PAGE_SHIFT;
+	bio->bi_bdev = zram->bdev;
+	bio->bi_end_io = zram_bdev_end_io;
+	bio->bi_private = &done;
+	if (!bio_add_page(bio, page, PAGE_SIZE, 0)) {
+		bio_put(bio);
+		return -EIO;
+	}
+
+	submit_bio(rw, bio);
+	wait_for_completion(&done);
+	if (!test_bit(BIO_UPTODATE, &bio->bi_flags))
+		ret = -EIO;
+	bio_put(bio);
+
+	zram_stat64_inc(zram, rw == READ ? &zram->stats.bd_reads :
+					   &zram->stats.bd_writes);
+	return ret;
+}
+
+struct zram_bdev_read_work {
+	struct work_struct work;
+	struct zram *zram;
+	struct page *page;
+	unsigned long blk_idx;
+	int ret;
+};
+
+static void zram_bdev_read_fn(struct work_struct *work)
+{
+	struct zram_bdev_read_work *rw = container_of(work,
+			struct zram_bdev_read_work, work);
+
+	rw->ret = zram_bdev_rw(rw->zram, rw->page, rw->blk_idx, READ);
+}
+
+/*
+ * Bios submitted from zram_make_request() context are only dispatched
+ * after it returns (see current->bio_list), so waiting for one there
+ * would never finish. Bounce the read to a worker instead.
+ */
+static int zram_read_from_bdev(struct zram *zram, struct page *page,
+			       unsigned long blk_idx)
+{
+	struct zram_bdev_read_work rw = {
+		.zram = zram,
+		.page = page,
+		.blk_idx = blk_idx,
+	};
+
+	INIT_WORK_ONSTACK(&rw.work, zram_bdev_read_fn);
+	queue_work(system_unbound_wq, &rw.work);
+	flush_work(&rw.work);
+	destroy_work_on_stack(&rw.work);
+
+	return rw.ret;
+}
+
+static void zram_reset_bdev(struct zram *zram)
+{
+	if (!zram->bdev)
+		return;
+
+	blkdev_put(zram->bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+	vfree(zram->bitmap);
+	zram->bdev = NULL;
+	zram->bitmap = NULL;
+	zram->nr_bdev_pages = 0;
+}
+#else
+static inline bool zram_wb_enabled(struct zram *zram) { return false; }
+static inline void zram_free_bdev_block(struct zram *zram,
+					unsigned long blk_idx) {}
+static inline int zram_read_from_bdev(struct zram *zram, struct page *page,
+				      unsigned long blk_idx)
+{
+	return -EIO;
+}
+static inline void zram_reset_bdev(struct zram *zram) {}
+#endif
+
 static void zram_set_disksize(struct zram *zram, size_t totalram_bytes)
 {
 	if (!zram->disksize) {
@@ -137,6 +260,10 @@ static void zram_free_page(struct zram *zram, size_t index)
 {
 	void *handle = zram->table[index].handle;
 
+	/* Whatever replaces this slot is neither idle nor being written back */
+	zram_clear_flag(zram, index, ZRAM_IDLE);
+	zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+
 	if (unlikely(!handle)) {
 		/*
 		 * No memory is allocated for zero filled pages.
@@ -156,7 +283,25 @@ static void zram_free_page(struct zram *zram, size_t index)
 		goto out;
 	}
 
-	zs_free(zram->mem_pool, handle);
+	if (zram_test_flag(zram, index, ZRAM_WB)) {
+		zram_free_bdev_block(zram, (unsigned long)handle);
+		zram_clear_flag(zram, index, ZRAM_WB);
+		zram_stat_dec(&zram->stats.bd_count);
+		goto out;
+	}
+
+	if (zram->table[index].dentry) {
+		struct zram_dedup_entry *dentry = zram->table[index].dentry;
+
+		zram->table[index].dentry = NULL;
+		if (!zram_dedup_put(zram, dentry)) {
+			/* Object is still in use by other slots */
+			zram_stat_dec(&zram->stats.pages_dup);
+			goto out_shared;
+		}
+	} else {
+		zs_free(zram->mem_pool, handle);
+	}
 
 	if (zram->table[index].size <= PAGE_SIZE / 2)
 		zram_stat_dec(&zram->stats.good_compress);
@@ -164,6 +309,7 @@ static void zram_free_page(struct zram *zram, size_t index)
 out:
 	zram_stat64_sub(zram, &zram->stats.compr_size,
 			zram->table[index].size);
+out_shared:
 	zram_stat_dec(&zram->stats.pages_stored);
 
 	zram->table[index].handle = NULL;
@@ -203,11 +349,50 @@ static inline int is_partial_io(struct bio_vec *bvec)
 	return bvec->bv_len != PAGE_SIZE;
 }
 
+static int handle_bdev_page(struct zram *zram, struct bio_vec *bvec,
+			    u32 index, int offset)
+{
+	int ret;
+	struct page *page = bvec->bv_page, *tmp;
+	unsigned long blk_idx = (unsigned long)zram->table[index].handle;
+	unsigned char *user_mem, *mem;
+
+	if (!is_partial_io(bvec)) {
+		ret = zram_read_from_bdev(zram, page, blk_idx);
+		goto out;
+	}
+
+	tmp = alloc_page(GFP_NOIO);
+	if (!tmp)
+		return -ENOMEM;
+
+	ret = zram_read_from_bdev(zram, tmp, blk_idx);
+	if (!ret) {
+		user_mem = kmap_atomic(page);
+		mem = kmap_atomic(tmp);
+		memcpy(user_mem + bvec->bv_offset, mem + offset,
+		       bvec->bv_len);
+		kunmap_atomic(mem);
+		kunmap_atomic(user_mem);
+	}
+	__free_page(tmp);
+
+out:
+	if (unlikely(ret)) {
+		pr_err("Backing device read failed! err=%d, page=%u\n",
+		       ret, index);
+		zram_stat64_inc(zram, &zram->stats.failed_reads);
+		return ret;
+	}
+
+	flush_dcache_page(page);
+	return 0;
+}
+
 static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 			  u32 index, int offset, struct bio *bio)
 {
 	int ret;
-	size_t clen;
 	struct page *page;
 	struct zobj_header *zheader;
 	unsigned char *user_mem, *cmem, *uncmem = NULL;
@@ -227,12 +412,18 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 		return 0;
 	}
 
+	if (zram_test_flag(zram, index, ZRAM_IDLE))
+		zram_clear_flag(zram, index, ZRAM_IDLE);
+
 	/* Page is stored uncompressed since it's incompressible */
 	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
 		handle_uncompressed_page(zram, bvec, index, offset);
 		return 0;
 	}
 
+	if (zram_test_flag(zram, index, ZRAM_WB))
+		return handle_bdev_page(zram, bvec, index, offset);
+
 	if (is_partial_io(bvec)) {
 		/* Use  a temporary buffer to decompress the page */
 		uncmem = kmalloc(PAGE_SIZE, GFP_KERNEL);
@@ -245,13 +436,11 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 	user_mem = kmap_atomic(page);
 	if (!is_partial_io(bvec))
 		uncmem = user_mem;
-	clen = PAGE_SIZE;
 
 	cmem = zs_map_object(zram->mem_pool, zram->table[index].handle);
 
-	ret = lzo1x_decompress_safe(cmem + sizeof(*zheader),
-				    zram->table[index].size,
-				    uncmem, &clen);
+	ret = zcomp_decompress(zram->comp, cmem + sizeof(*zheader),
+			       zram->table[index].size, uncmem);
 
 	if (is_partial_io(bvec)) {
 		memcpy(user_mem + bvec->bv_offset, uncmem + offset,
@@ -263,7 +452,7 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 	kunmap_atomic(user_mem);
 
 	/* Should NEVER happen. Return bio error if it does. */
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
 		zram_stat64_inc(zram, &zram->stats.failed_reads);
 		return ret;
@@ -277,7 +466,6 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 static int zram_read_before_write(struct zram *zram, char *mem, u32 index)
 {
 	int ret;
-	size_t clen = PAGE_SIZE;
 	struct zobj_header *zheader;
 	unsigned char *cmem;
 
@@ -287,22 +475,37 @@ static int zram_read_before_write(struct zram *zram, char *mem, u32 index)
 		return 0;
 	}
 
-	cmem = zs_map_object(zram->mem_pool, zram->table[index].handle);
-
 	/* Page is stored uncompressed since it's incompressible */
 	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
+		cmem = kmap_atomic(zram->table[index].handle);
 		memcpy(mem, cmem, PAGE_SIZE);
 		kunmap_atomic(cmem);
 		return 0;
 	}
 
-	ret = lzo1x_decompress_safe(cmem + sizeof(*zheader),
-				    zram->table[index].size,
-				    mem, &clen);
+	if (zram_test_flag(zram, index, ZRAM_WB)) {
+		struct page *tmp = alloc_page(GFP_NOIO);
+
+		if (!tmp)
+			return -ENOMEM;
+		ret = zram_read_from_bdev(zram, tmp,
+				(unsigned long)zram->table[index].handle);
+		if (!ret) {
+			cmem = kmap_atomic(tmp);
+			memcpy(mem, cmem, PAGE_SIZE);
+			kunmap_atomic(cmem);
+		}
+		__free_page(tmp);
+		return ret;
+	}
+
+	cmem = zs_map_object(zram->mem_pool, zram->table[index].handle);
+	ret = zcomp_decompress(zram->comp, cmem + sizeof(*zheader),
+			       zram->table[index].size, mem);
 	zs_unmap_object(zram->mem_pool, zram->table[index].handle);
 
 	/* Should NEVER happen. Return bio error if it does. */
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
 		zram_stat64_inc(zram, &zram->stats.failed_reads);
 		return ret;
@@ -311,19 +514,25 @@ static int zram_read_before_write(struct zram *zram, char *mem, u32 index)
 	return 0;
 }
 
+/*
+ * Compression runs outside zram->lock on a per-CPU stream, so writers on
+ * different CPUs compress in parallel; the lock is only taken to swap
+ * the new object into the table.
+ */
 static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			   int offset)
 {
-	int ret;
-	u32 store_offset;
+	int ret = 0;
 	size_t clen;
+	u32 checksum = 0;
 	void *handle;
 	struct zobj_header *zheader;
-	struct page *page, *page_store;
+	struct page *page, *page_store = NULL;
+	struct zram_dedup_entry *dentry = NULL;
+	struct zcomp_strm *zstrm = NULL;
 	unsigned char *user_mem, *cmem, *src, *uncmem = NULL;
 
 	page = bvec->bv_page;
-	src = zram->compress_buffer;
 
 	if (is_partial_io(bvec)) {
 		/*
@@ -336,21 +545,15 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			ret = -ENOMEM;
 			goto out;
 		}
+		down_read(&zram->lock);
 		ret = zram_read_before_write(zram, uncmem, index);
-		if (ret) {
-			kfree(uncmem);
+		up_read(&zram->lock);
+		if (ret)
 			goto out;
-		}
 	}
 
-	/*
-	 * System overwrites unused sectors. Free memory associated
-	 * with this sector now.
-	 */
-	if (zram->table[index].handle ||
-	    zram_test_flag(zram, index, ZRAM_ZERO))
-		zram_free_page(zram, index);
-
+	/* May sleep, so must be taken before kmap_atomic() */
+	zstrm = zcomp_strm_find(zram->comp);
 	user_mem = kmap_atomic(page);
 
 	if (is_partial_io(bvec))
@@ -359,24 +562,48 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 	else
 		uncmem = user_mem;
 
+	zram_bench_capture(uncmem);
+
 	if (page_zero_filled(uncmem)) {
 		kunmap_atomic(user_mem);
-		if (is_partial_io(bvec))
-			kfree(uncmem);
+		zcomp_strm_release(zram->comp, zstrm);
+		zstrm = NULL;
+
+		down_write(&zram->lock);
+		zram_free_page(zram, index);
 		zram_stat_inc(&zram->stats.pages_zero);
 		zram_set_flag(zram, index, ZRAM_ZERO);
-		ret = 0;
+		up_write(&zram->lock);
 		goto out;
 	}
 
-	ret = lzo1x_1_compress(uncmem, PAGE_SIZE, src, &clen,
-			       zram->compress_workmem);
+	if (zram->use_dedup) {
+		checksum = zram_dedup_checksum(uncmem);
+		dentry = zram_dedup_find(zram, uncmem, checksum, zstrm);
+		if (dentry) {
+			kunmap_atomic(user_mem);
+			zcomp_strm_release(zram->comp, zstrm);
+			zstrm = NULL;
+
+			down_write(&zram->lock);
+			zram_free_page(zram, index);
+			zram->table[index].handle = dentry->handle;
+			zram->table[index].size = dentry->len;
+			zram->table[index].dentry = dentry;
+			zram_stat_inc(&zram->stats.pages_dup);
+			zram_stat_inc(&zram->stats.pages_stored);
+			up_write(&zram->lock);
+			goto out;
+		}
+	}
+
+	ret = zcomp_compress(zram->comp, zstrm, uncmem, &clen);
 
 	kunmap_atomic(user_mem);
-	if (is_partial_io(bvec))
-			kfree(uncmem);
+	if (!is_partial_io(bvec))
+		uncmem = NULL;
 
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Compression failed! err=%d\n", ret);
 		goto out;
 	}
@@ -396,60 +623,229 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			goto out;
 		}
 
-		store_offset = 0;
-		zram_set_flag(zram, index, ZRAM_UNCOMPRESSED);
-		zram_stat_inc(&zram->stats.pages_expand);
 		handle = page_store;
-		src = kmap_atomic(page);
 		cmem = kmap_atomic(page_store);
-		goto memstore;
+		src = uncmem ? uncmem : kmap_atomic(page);
+		memcpy(cmem, src, PAGE_SIZE);
+		if (!uncmem)
+			kunmap_atomic(src);
+		kunmap_atomic(cmem);
+	} else {
+		handle = zs_malloc(zram->mem_pool, clen + sizeof(*zheader));
+		if (!handle) {
+			pr_info("Error allocating memory for compressed "
+				"page: %u, size=%zu\n", index, clen);
+			ret = -ENOMEM;
+			goto out;
+		}
+		cmem = zs_map_object(zram->mem_pool, handle);
+		memcpy(cmem, zstrm->buffer, clen);
+		zs_unmap_object(zram->mem_pool, handle);
 	}
 
-	handle = zs_malloc(zram->mem_pool, clen + sizeof(*zheader));
-	if (!handle) {
-		pr_info("Error allocating memory for compressed "
-			"page: %u, size=%zu\n", index, clen);
-		ret = -ENOMEM;
-		goto out;
-	}
-	cmem = zs_map_object(zram->mem_pool, handle);
+	zcomp_strm_release(zram->comp, zstrm);
+	zstrm = NULL;
 
-memstore:
-#if 0
-	/* Back-reference needed for memory defragmentation */
-	if (!zram_test_flag(zram, index, ZRAM_UNCOMPRESSED)) {
-		zheader = (struct zobj_header *)cmem;
-		zheader->table_idx = index;
-		cmem += sizeof(*zheader);
-	}
-#endif
+	/* Failing to track the object only costs a missed future match */
+	if (zram->use_dedup && !page_store)
+		dentry = zram_dedup_insert(zram, checksum, handle, clen);
 
-	memcpy(cmem, src, clen);
+	/*
+	 * System overwrites unused sectors. Free memory associated
+	 * with this sector now.
+	 */
+	down_write(&zram->lock);
+	zram_free_page(zram, index);
 
-	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
-		kunmap_atomic(cmem);
-		kunmap_atomic(src);
-	} else {
-		zs_unmap_object(zram->mem_pool, handle);
+	if (page_store) {
+		zram_set_flag(zram, index, ZRAM_UNCOMPRESSED);
+		zram_stat_inc(&zram->stats.pages_expand);
 	}
 
 	zram->table[index].handle = handle;
 	zram->table[index].size = clen;
+	zram->table[index].dentry = dentry;
 
 	/* Update stats */
 	zram_stat64_add(zram, &zram->stats.compr_size, clen);
 	zram_stat_inc(&zram->stats.pages_stored);
 	if (clen <= PAGE_SIZE / 2)
 		zram_stat_inc(&zram->stats.good_compress);
+	up_write(&zram->lock);
 
-	return 0;
+#ifdef CONFIG_ZRAM_WRITEBACK
+	/* Incompressible pages are not worth keeping in RAM */
+	if (page_store && zram_wb_enabled(zram))
+		zram_request_writeback(zram, ZRAM_WB_HUGE);
+#endif
 
 out:
+	if (zstrm)
+		zcomp_strm_release(zram->comp, zstrm);
+	if (is_partial_io(bvec))
+		kfree(uncmem);
 	if (ret)
 		zram_stat64_inc(zram, &zram->stats.failed_writes);
 	return ret;
 }
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+/*
+ * Snapshot the contents of a writeback candidate into @mem and mark the
+ * slot ZRAM_UNDER_WB. Any write or free of the slot clears that flag,
+ * which tells zram_writeback_work() to discard the copy it wrote.
+ */
+static bool zram_writeback_prepare(struct zram *zram, size_t index,
+				   unsigned long mode, char *mem)
+{
+	bool ret = false;
+
+	down_write(&zram->lock);
+	if (!zram->table[index].handle ||
+	    zram_test_flag(zram, index, ZRAM_WB) ||
+	    zram_test_flag(zram, index, ZRAM_UNDER_WB))
+		goto out;
+
+	if (!((mode & ZRAM_WB_HUGE) &&
+	      zram_test_flag(zram, index, ZRAM_UNCOMPRESSED)) &&
+	    !((mode & ZRAM_WB_IDLE) &&
+	      zram_test_flag(zram, index, ZRAM_IDLE)))
+		goto out;
+
+	if (zram_read_before_write(zram, mem, index))
+		goto out;
+
+	zram_set_flag(zram, index, ZRAM_UNDER_WB);
+	ret = true;
+out:
+	up_write(&zram->lock);
+	return ret;
+}
+
+static void zram_writeback_work(struct work_struct *work)
+{
+	struct zram *zram = container_of(work, struct zram, wb_work);
+	unsigned long mode;
+	size_t index, num_pages;
+	struct page *page;
+
+	/* Device is being reset or initialised; the request is dropped */
+	if (!down_read_trylock(&zram->init_lock))
+		return;
+
+	if (!zram->init_done || !zram_wb_enabled(zram))
+		goto out_unlock;
+
+	page = alloc_page(GFP_NOIO);
+	if (!page)
+		goto out_unlock;
+
+	num_pages = zram->disksize >> PAGE_SHIFT;
+	while ((mode = xchg(&zram->wb_request, 0))) {
+		for (index = 0; index < num_pages; index++) {
+			unsigned long blk_idx;
+			u8 flags = zram->table[index].flags;
+
+			/* Cheap unlocked filter, rechecked under the lock */
+			if (!(((mode & ZRAM_WB_HUGE) &&
+			       (flags & BIT(ZRAM_UNCOMPRESSED))) ||
+			      ((mode & ZRAM_WB_IDLE) &&
+			       (flags & BIT(ZRAM_IDLE)))))
+				continue;
+
+			if (!zram_writeback_prepare(zram, index, mode,
+						    page_address(page)))
+				continue;
+
+			blk_idx = zram_alloc_bdev_block(zram);
+			if (blk_idx &&
+			    zram_bdev_rw(zram, page, blk_idx, WRITE)) {
+				zram_free_bdev_block(zram, blk_idx);
+				blk_idx = 0;
+			}
+
+			down_write(&zram->lock);
+			if (blk_idx &&
+			    zram_test_flag(zram, index, ZRAM_UNDER_WB)) {
+				zram_free_page(zram, index);
+				zram_set_flag(zram, index, ZRAM_WB);
+				zram->table[index].handle = (void *)blk_idx;
+				zram_stat_inc(&zram->stats.pages_stored);
+				zram_stat_inc(&zram->stats.bd_count);
+				blk_idx = 0;
+			}
+			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+			up_write(&zram->lock);
+
+			/* Slot changed under us; its disk copy is stale */
+			if (blk_idx)
+				zram_free_bdev_block(zram, blk_idx);
+		}
+	}
+
+	__free_page(page);
+out_unlock:
+	up_read(&zram->init_lock);
+}
+
+/*
+ * Queue asynchronous writeback of the slots selected by @mode (a mask
+ * of ZRAM_WB_HUGE and ZRAM_WB_IDLE) to the backing device.
+ */
+int zram_request_writeback(struct zram *zram, unsigned long mode)
+{
+	unsigned long bit;
+
+	if (!zram_wb_enabled(zram))
+		return -ENODEV;
+
+	for_each_set_bit(bit, &mode, BITS_PER_LONG)
+		set_bit(bit, &zram->wb_request);
+	schedule_work(&zram->wb_work);
+
+	return 0;
+}
+
+/* Mark every stored slot idle; any later access clears the mark */
+void zram_mark_idle(struct zram *zram)
+{
+	size_t index;
+
+	down_write(&zram->lock);
+	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
+		if (zram->table[index].handle &&
+		    !zram_test_flag(zram, index, ZRAM_WB))
+			zram_set_flag(zram, index, ZRAM_IDLE);
+	}
+	up_write(&zram->lock);
+}
+
+int zram_set_backing_dev(struct zram *zram, const char *path)
+{
+	struct block_device *bdev;
+	unsigned long nr_pages, *bitmap;
+
+	bdev = blkdev_get_by_path(path, FMODE_READ | FMODE_WRITE | FMODE_EXCL,
+				  zram);
+	if (IS_ERR(bdev))
+		return PTR_ERR(bdev);
+
+	nr_pages = i_size_read(bdev->bd_inode) >> PAGE_SHIFT;
+	bitmap = vzalloc(BITS_TO_LONGS(nr_pages) * sizeof(long));
+	if (!bitmap) {
+		blkdev_put(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+		return -ENOMEM;
+	}
+
+	zram_reset_bdev(zram);
+	zram->bdev = bdev;
+	zram->bitmap = bitmap;
+	zram->nr_bdev_pages = nr_pages;
+
+	return 0;
+}
+#endif
+
 static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 			int offset, struct bio *bio, int rw)
 {
@@ -460,9 +856,7 @@ static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 		ret = zram_bvec_read(zram, bvec, index, offset, bio);
 		up_read(&zram->lock);
 	} else {
-		down_write(&zram->lock);
 		ret = zram_bvec_write(zram, bvec, index, offset);
-		up_write(&zram->lock);
 	}
 
 	return ret;
@@ -583,12 +977,16 @@ void __zram_reset_device(struct zram *zram)
 
 	zram->init_done = 0;
 
-	/* Free various per-device buffers */
-	kfree(zram->compress_workmem);
-	free_pages((unsigned long)zram->compress_buffer, 1);
+#ifdef CONFIG_ZRAM_WRITEBACK
+	/* The work backs off while init_lock is held for write */
+	cancel_work_sync(&zram->wb_work);
+	zram->wb_request = 0;
+#endif
 
-	zram->compress_workmem = NULL;
-	zram->compress_buffer = NULL;
+	/* Free per-CPU compression streams */
+	if (zram->comp)
+		zcomp_destroy(zram->comp);
+	zram->comp = NULL;
 
 	/* Free all pages that are still in this zram device */
 	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
@@ -598,6 +996,10 @@ void __zram_reset_device(struct zram *zram)
 
 		if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED)))
 			__free_page(handle);
+		else if (zram_test_flag(zram, index, ZRAM_WB))
+			continue;
+		else if (zram->table[index].dentry)
+			zram_dedup_put(zram, zram->table[index].dentry);
 		else
 			zs_free(zram->mem_pool, handle);
 	}
@@ -608,6 +1010,8 @@ void __zram_reset_device(struct zram *zram)
 	zs_destroy_pool(zram->mem_pool);
 	zram->mem_pool = NULL;
 
+	zram_reset_bdev(zram);
+
 	/* Reset stats */
 	memset(&zram->stats, 0, sizeof(zram->stats));
 
@@ -635,18 +1039,12 @@ int zram_init_device(struct zram *zram)
 
 	zram_set_disksize(zram, totalram_pages << PAGE_SHIFT);
 
-	zram->compress_workmem = kzalloc(LZO1X_MEM_COMPRESS, GFP_KERNEL);
-	if (!zram->compress_workmem) {
-		pr_err("Error allocating compressor working memory!\n");
-		ret = -ENOMEM;
-		goto fail_no_table;
-	}
-
-	zram->compress_buffer =
-		(void *)__get_free_pages(GFP_KERNEL | __GFP_ZERO, 1);
-	if (!zram->compress_buffer) {
-		pr_err("Error allocating compressor buffer space\n");
-		ret = -ENOMEM;
+	zram->comp = zcomp_create(zram->compressor);
+	if (IS_ERR(zram->comp)) {
+		pr_err("Cannot initialise %s compressing backend\n",
+			zram->compressor);
+		ret = PTR_ERR(zram->comp);
+		zram->comp = NULL;
 		goto fail_no_table;
 	}
 
@@ -663,7 +1061,8 @@ int zram_init_device(struct zram *zram)
 	/* zram devices sort of resembles non-rotational disks */
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, zram->disk->queue);
 
-	zram->mem_pool = zs_create_pool("zram", GFP_NOIO | __GFP_HIGHMEM);
+	zram->mem_pool = zs_create_pool(zram->disk->disk_name,
+					GFP_NOIO | __GFP_HIGHMEM);
 	if (!zram->mem_pool) {
 		pr_err("Error creating memory pool\n");
 		ret = -ENOMEM;
@@ -708,6 +1107,12 @@ static int create_device(struct zram *zram, int device_id)
 	init_rwsem(&zram->lock);
 	init_rwsem(&zram->init_lock);
 	spin_lock_init(&zram->stat64_lock);
+	strlcpy(zram->compressor, default_compressor,
+		sizeof(zram->compressor));
+	zram_dedup_init(zram);
+#ifdef CONFIG_ZRAM_WRITEBACK
+	INIT_WORK(&zram->wb_work, zram_writeback_work);
+#endif
 
 	zram->queue = blk_alloc_queue(GFP_KERNEL);
 	if (!zram->queue) {
@@ -719,6 +1124,8 @@ static int create_device(struct zram *zram, int device_id)
 
 	blk_queue_make_request(zram->queue, zram_make_request);
 	zram->queue->queuedata = zram;
+	/* a read is a decompression, swap readahead would only waste it */
+	zram->queue->backing_dev_info.capabilities |= BDI_CAP_SYNCHRONOUS_IO;
 
 	 /* gendisk structure */
 	zram->disk = alloc_disk(1);
@@ -821,6 +1228,10 @@ static int __init zram_init(void)
 			goto free_devices;
 	}
 
+	ret = zram_bench_init();
+	if (ret)
+		goto free_devices;
+
 	return 0;
 
 free_devices:
@@ -838,12 +1249,16 @@ static void __exit zram_exit(void)
 	int i;
 	struct zram *zram;
 
+	zram_bench_exit();
+
 	for (i = 0; i < num_devices; i++) {
 		zram = &zram_devices[i];
 
 		destroy_device(zram);
 		if (zram->init_done)
 			zram_reset_device(zram);
+		else
+			zram_reset_bdev(zram);
 	}
 
 	unregister_blkdev(zram_major, "zram");
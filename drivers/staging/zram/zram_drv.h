@@ -17,8 +17,12 @@
 
 #include <linux/spinlock.h>
 #include <linux/mutex.h>
+#include <linux/workqueue.h>
 
 #include "../zsmalloc/zsmalloc.h"
+#include "zcomp.h"
+#include "zram_dedup.h"
+#include "zram_bench.h"
 
 /*
  * Some arbitrary value. This is just to catch
@@ -55,6 +59,9 @@ static const size_t max_zpage_size = PAGE_SIZE / 4 * 3;
  * otherwise, xv_malloc() would always return failure.
  */
 
+/* Default compression algorithm, selectable via comp_algorithm attribute */
+static const char * const default_compressor = "lzo";
+
 /*-- End of configurable params */
 
 #define SECTOR_SHIFT		9
@@ -74,6 +81,15 @@ enum zram_pageflags {
 	/* Page consists entirely of zeros */
 	ZRAM_ZERO,
 
+	/* Page was written back; handle is its block on the backing device */
+	ZRAM_WB,
+
+	/* Slot has not been accessed since it was last marked idle */
+	ZRAM_IDLE,
+
+	/* Slot is being written back; cleared if it changes meanwhile */
+	ZRAM_UNDER_WB,
+
 	__NR_ZRAM_PAGEFLAGS,
 };
 
@@ -82,6 +98,7 @@ enum zram_pageflags {
 /* Allocated for each disk page */
 struct table {
 	void *handle;
+	struct zram_dedup_entry *dentry;	/* shared object, if deduped */
 	u16 size;	/* object size (excluding header) */
 	u8 count;	/* object ref count (not yet used) */
 	u8 flags;
@@ -99,16 +116,19 @@ struct zram_stats {
 	u32 pages_stored;	/* no. of pages currently stored */
 	u32 good_compress;	/* % of pages with compression ratio<=50% */
 	u32 pages_expand;	/* % of incompressible pages */
+	u32 pages_dup;		/* no. of pages sharing another's object */
+	u32 bd_count;		/* no. of pages on the backing device */
+	u64 bd_reads;		/* no. of reads from the backing device */
+	u64 bd_writes;		/* no. of writes to the backing device */
 };
 
 struct zram {
 	struct zs_pool *mem_pool;
-	void *compress_workmem;
-	void *compress_buffer;
+	struct zcomp *comp;
 	struct table *table;
 	spinlock_t stat64_lock;	/* protect 64-bit stats */
-	struct rw_semaphore lock; /* protect compression buffers and table
-				   * against concurrent read and writes */
+	struct rw_semaphore lock; /* protect table and 32-bit stats against
+				   * concurrent read and writes */
 	struct request_queue *queue;
 	struct gendisk *disk;
 	int init_done;
@@ -121,8 +141,27 @@ struct zram {
 	u64 disksize;	/* bytes */
 
 	struct zram_stats stats;
+	char compressor[10];
+
+	/* Same-page deduplication of compressed objects */
+	bool use_dedup;
+	spinlock_t dedup_lock;	/* protect dedup_tree and entry refcounts */
+	struct rb_root dedup_tree;
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+	/* Backing device that idle and incompressible pages are moved to */
+	struct block_device *bdev;
+	unsigned long nr_bdev_pages;
+	unsigned long *bitmap;	/* in-use blocks of the backing device */
+	unsigned long wb_request; /* pending ZRAM_WB_* modes */
+	struct work_struct wb_work;
+#endif
 };
 
+/* Writeback modes, see zram_request_writeback() */
+#define ZRAM_WB_HUGE	(1UL << 0)	/* pages stored uncompressed */
+#define ZRAM_WB_IDLE	(1UL << 1)	/* pages marked ZRAM_IDLE */
+
 extern struct zram *zram_devices;
 unsigned int zram_get_num_devices(void);
 #ifdef CONFIG_SYSFS
@@ -132,4 +171,10 @@ extern struct attribute_group zram_disk_attr_group;
 extern int zram_init_device(struct zram *zram);
 extern void __zram_reset_device(struct zram *zram);
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+extern int zram_set_backing_dev(struct zram *zram, const char *path);
+extern void zram_mark_idle(struct zram *zram);
+extern int zram_request_writeback(struct zram *zram, unsigned long mode);
+#endif
+
 #endif
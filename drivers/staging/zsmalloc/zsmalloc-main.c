@@ -17,16 +17,16 @@
 #include <linux/module.h>
 #include <linux/kernel.h>
 #include <linux/bitops.h>
+#include <linux/bit_spinlock.h>
+#include <linux/debugfs.h>
 #include <linux/errno.h>
 #include <linux/highmem.h>
 #include <linux/init.h>
+#include <linux/seq_file.h>
 #include <linux/string.h>
 #include <linux/slab.h>
-#include <asm/tlbflush.h>
-#include <asm/pgtable.h>
 #include <linux/cpumask.h>
 #include <linux/cpu.h>
-#include <linux/vmalloc.h>
 
 #include "zsmalloc.h"
 #include "zsmalloc_int.h"
@@ -40,9 +40,15 @@
 #define CLASS_IDX_MASK	((1 << CLASS_IDX_BITS) - 1)
 #define FULLNESS_MASK	((1 << FULLNESS_BITS) - 1)
 
-/* per-cpu VM mapping areas for zspage accesses that cross page boundaries */
+/*
+ * per-cpu bounce buffers for zspage accesses that cross page boundaries;
+ * copying keeps zsmalloc free of arch specific pte and tlb handling
+ */
 static DEFINE_PER_CPU(struct mapping_area, zs_map_area);
 
+static struct kmem_cache *zs_handle_cachep;
+static struct dentry *zs_stat_root;
+
 static int is_first_page(struct page *page)
 {
 	return test_bit(PG_private, &page->flags);
@@ -230,30 +236,62 @@ static struct page *get_next_page(struct page *page)
 	return next;
 }
 
-/* Encode <page, obj_idx> as a single handle value */
-static void *obj_location_to_handle(struct page *page, unsigned long obj_idx)
+/* Encode <page, obj_idx> as a single object location */
+static void *obj_location_to_obj(struct page *page, unsigned long obj_idx)
 {
-	unsigned long handle;
+	unsigned long obj;
 
 	if (!page) {
 		BUG_ON(obj_idx);
 		return NULL;
 	}
 
-	handle = page_to_pfn(page) << OBJ_INDEX_BITS;
-	handle |= (obj_idx & OBJ_INDEX_MASK);
+	obj = page_to_pfn(page) << OBJ_INDEX_BITS;
+	obj |= (obj_idx & OBJ_INDEX_MASK);
+	obj <<= OBJ_TAG_BITS;
 
-	return (void *)handle;
+	return (void *)obj;
 }
 
-/* Decode <page, obj_idx> pair from the given object handle */
-static void obj_handle_to_location(void *handle, struct page **page,
+/* Decode <page, obj_idx> pair from the given object location */
+static void obj_to_location(void *obj, struct page **page,
 				unsigned long *obj_idx)
 {
-	unsigned long hval = (unsigned long)handle;
+	unsigned long oval = (unsigned long)obj >> OBJ_TAG_BITS;
+
+	*page = pfn_to_page(oval >> OBJ_INDEX_BITS);
+	*obj_idx = oval & OBJ_INDEX_MASK;
+}
+
+static unsigned long *alloc_handle(struct zs_pool *pool)
+{
+	return kmem_cache_alloc(zs_handle_cachep,
+				pool->flags & ~(__GFP_HIGHMEM | __GFP_MOVABLE));
+}
 
-	*page = pfn_to_page(hval >> OBJ_INDEX_BITS);
-	*obj_idx = hval & OBJ_INDEX_MASK;
+static void free_handle(unsigned long *handle)
+{
+	kmem_cache_free(zs_handle_cachep, handle);
+}
+
+static void *handle_to_obj(unsigned long *handle)
+{
+	return (void *)(*handle & ~((_AC(1, UL) << OBJ_TAG_BITS) - 1));
+}
+
+static void pin_tag(unsigned long *handle)
+{
+	bit_spin_lock(HANDLE_PIN_BIT, handle);
+}
+
+static int trypin_tag(unsigned long *handle)
+{
+	return bit_spin_trylock(HANDLE_PIN_BIT, handle);
+}
+
+static void unpin_tag(unsigned long *handle)
+{
+	bit_spin_unlock(HANDLE_PIN_BIT, handle);
 }
 
 static unsigned long obj_idx_to_offset(struct page *page,
@@ -330,7 +368,7 @@ static void init_zspage(struct page *first_page, struct size_class *class)
 		for (i = 1; i <= objs_on_page; i++) {
 			off += class->size;
 			if (off < PAGE_SIZE) {
-				link->next = obj_location_to_handle(page, i);
+				link->next = obj_location_to_obj(page, i);
 				link += class->size / sizeof(*link);
 			}
 		}
@@ -341,7 +379,7 @@ static void init_zspage(struct page *first_page, struct size_class *class)
 		 * page (if present)
 		 */
 		next_page = get_next_page(page);
-		link->next = obj_location_to_handle(next_page, 0);
+		link->next = obj_location_to_obj(next_page, 0);
 		kunmap_atomic(link);
 		page = next_page;
 		off = (off + class->size) % PAGE_SIZE;
@@ -396,9 +434,9 @@ static struct page *alloc_zspage(struct size_class *class, gfp_t flags)
 
 	init_zspage(first_page, class);
 
-	first_page->freelist = obj_location_to_handle(first_page, 0);
+	first_page->freelist = obj_location_to_obj(first_page, 0);
 	/* Maximum number of objects we can store in this zspage */
-	first_page->objects = class->zspage_order * PAGE_SIZE / class->size;
+	first_page->objects = class->objs_per_zspage;
 
 	error = 0; /* Success */
 
@@ -425,6 +463,350 @@ static struct page *find_get_zspage(struct size_class *class)
 	return page;
 }
 
+/*
+ * Take a free object off @first_page's freelist for @handle, which is
+ * recorded at its start.  Called with class->lock held.
+ */
+static void *obj_malloc(struct page *first_page, struct size_class *class,
+			unsigned long handle)
+{
+	struct link_free *link;
+	struct page *m_page;
+	unsigned long m_objidx, m_offset;
+	void *obj;
+
+	obj = first_page->freelist;
+	obj_to_location(obj, &m_page, &m_objidx);
+	m_offset = obj_idx_to_offset(m_page, m_objidx, class->size);
+
+	link = (struct link_free *)kmap_atomic(m_page) +
+					m_offset / sizeof(*link);
+	first_page->freelist = link->next;
+	link->handle = handle | OBJ_ALLOCATED_TAG;
+	kunmap_atomic(link);
+
+	first_page->inuse++;
+	class->objs_inuse++;
+	return obj;
+}
+
+/* Put @obj back on @first_page's freelist, called with class->lock held */
+static void obj_free(struct page *first_page, struct size_class *class,
+		     void *obj)
+{
+	struct link_free *link;
+	struct page *f_page;
+	unsigned long f_objidx, f_offset;
+
+	obj_to_location(obj, &f_page, &f_objidx);
+	f_offset = obj_idx_to_offset(f_page, f_objidx, class->size);
+
+	link = (struct link_free *)((unsigned char *)kmap_atomic(f_page)
+							+ f_offset);
+	link->next = first_page->freelist;
+	kunmap_atomic(link);
+	first_page->freelist = obj;
+
+	first_page->inuse--;
+	class->objs_inuse--;
+}
+
+/*
+ * Copy the object at @off in @page, which may continue at the start of
+ * the next page of the zspage, between the zspage and @buf.
+ */
+static void zs_copy_object(struct page *page, unsigned long off, int size,
+			   char *buf, bool to_buf)
+{
+	struct page *pages[2];
+	int sizes[2];
+	char *addr;
+	int i;
+
+	sizes[0] = min_t(int, size, PAGE_SIZE - off);
+	sizes[1] = size - sizes[0];
+	pages[0] = page;
+	pages[1] = sizes[1] ? get_next_page(page) : NULL;
+	BUG_ON(sizes[1] && !pages[1]);
+
+	for (i = 0; i < 2 && sizes[i]; i++) {
+		addr = kmap_atomic(pages[i]);
+		if (to_buf)
+			memcpy(buf, addr + off, sizes[i]);
+		else
+			memcpy(addr + off, buf, sizes[i]);
+		kunmap_atomic(addr);
+		buf += sizes[i];
+		off = 0;
+	}
+}
+
+/*
+ * Compaction moves the objects of sparsely used zspages into the free
+ * slots of densely used ones of the same class, so that the sparse
+ * zspages become empty and can be freed.  A mapped object stays where
+ * it is, and with it the rest of its zspage.
+ */
+
+/* pages that could be freed if the objects of @class were packed */
+static unsigned long zs_can_compact(struct size_class *class)
+{
+	unsigned long capacity, free;
+
+	capacity = (unsigned long)class->pages_allocated /
+		   class->zspage_order * class->objs_per_zspage;
+	if (capacity <= class->objs_inuse)
+		return 0;
+	free = capacity - class->objs_inuse;
+	return free / class->objs_per_zspage * class->zspage_order;
+}
+
+/* take a zspage off its fullness list, sources sparse, targets dense */
+static struct page *isolate_zspage(struct size_class *class, bool source)
+{
+	static const enum fullness_group order[2][2] = {
+		{ ZS_ALMOST_FULL, ZS_ALMOST_EMPTY },	/* target */
+		{ ZS_ALMOST_EMPTY, ZS_ALMOST_FULL },	/* source */
+	};
+	struct page *page;
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		page = class->fullness_list[order[source][i]];
+		if (page) {
+			remove_zspage(page, class, order[source][i]);
+			return page;
+		}
+	}
+	return NULL;
+}
+
+static void putback_zspage(struct size_class *class, struct page *first_page)
+{
+	enum fullness_group fullness = get_fullness_group(first_page);
+
+	insert_zspage(first_page, class, fullness);
+	set_zspage_mapping(first_page, class->index, fullness);
+}
+
+/* the handle of the object at @off in @page, or 0 if it is free */
+static unsigned long obj_allocated(struct page *page, unsigned long off)
+{
+	struct link_free *link;
+	unsigned long val;
+
+	link = (struct link_free *)((unsigned char *)kmap_atomic(page) + off);
+	val = link->handle;
+	kunmap_atomic(link);
+
+	return val & OBJ_ALLOCATED_TAG ? val & ~OBJ_ALLOCATED_TAG : 0;
+}
+
+/*
+ * Move the objects of @src to @dst until either is done with.  Returns
+ * 0 once @src is empty, -ENOSPC once @dst is full and -EBUSY for an
+ * object that is in use.  Called with class->lock held, both zspages
+ * isolated.
+ */
+static int migrate_zspage(struct size_class *class, struct page *src,
+			  struct page *dst, char *buf)
+{
+	struct page *page, *d_page;
+	unsigned long off, start, handle, d_idx;
+	void *obj;
+	int idx = 0;
+
+	for (page = src; page && src->inuse; page = get_next_page(page)) {
+		start = is_first_page(page) ? 0 : page->index;
+		for (off = start; off < PAGE_SIZE && idx < src->objects;
+		     off += class->size, idx++) {
+			handle = obj_allocated(page, off);
+			if (!handle)
+				continue;
+			if (dst->inuse == dst->objects)
+				return -ENOSPC;
+			if (!trypin_tag((unsigned long *)handle))
+				return -EBUSY;
+
+			zs_copy_object(page, off, class->size, buf, true);
+			obj = obj_malloc(dst, class, handle);
+			obj_to_location(obj, &d_page, &d_idx);
+			zs_copy_object(d_page, obj_idx_to_offset(d_page, d_idx,
+					class->size), class->size, buf, false);
+
+			/* the pin stays set until the old copy is gone */
+			*(unsigned long *)handle = (unsigned long)obj |
+						   (1 << HANDLE_PIN_BIT);
+			obj_free(src, class, obj_location_to_obj(page,
+					(off - start) / class->size));
+			unpin_tag((unsigned long *)handle);
+		}
+	}
+	return src->inuse ? -ENOSPC : 0;
+}
+
+static unsigned long zs_compact_class(struct size_class *class)
+{
+	struct page *src, *dst;
+	struct mapping_area *area;
+	unsigned long freed = 0;
+	int ret;
+
+	spin_lock(&class->lock);
+	while (zs_can_compact(class)) {
+		src = isolate_zspage(class, true);
+		if (!src)
+			break;
+
+		ret = -ENOSPC;
+		area = &get_cpu_var(zs_map_area);
+		while (ret == -ENOSPC && (dst = isolate_zspage(class, false))) {
+			ret = migrate_zspage(class, src, dst, area->vm_buf);
+			putback_zspage(class, dst);
+		}
+		put_cpu_var(zs_map_area);
+
+		if (ret) {
+			putback_zspage(class, src);
+			break;
+		}
+
+		class->pages_allocated -= class->zspage_order;
+		freed += class->zspage_order;
+		spin_unlock(&class->lock);
+		free_zspage(src);
+		cond_resched();
+		spin_lock(&class->lock);
+	}
+	spin_unlock(&class->lock);
+
+	return freed;
+}
+
+/**
+ * zs_compact - free zspages by packing objects into fewer of them
+ * @pool: pool to compact
+ *
+ * Returns the number of pages freed.  May sleep.
+ */
+unsigned long zs_compact(struct zs_pool *pool)
+{
+	unsigned long freed = 0;
+	int i;
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++)
+		freed += zs_compact_class(&pool->size_class[i]);
+
+	atomic_long_add(freed, &pool->pages_compacted);
+	return freed;
+}
+EXPORT_SYMBOL_GPL(zs_compact);
+
+unsigned long zs_get_num_compacted(struct zs_pool *pool)
+{
+	return atomic_long_read(&pool->pages_compacted);
+}
+EXPORT_SYMBOL_GPL(zs_get_num_compacted);
+
+static int zs_shrinker_fn(struct shrinker *shrinker, struct shrink_control *sc)
+{
+	struct zs_pool *pool = container_of(shrinker, struct zs_pool, shrinker);
+	unsigned long pages = 0;
+	int i;
+
+	/* compaction neither allocates nor does I/O, any context will do */
+	if (sc->nr_to_scan)
+		zs_compact(pool);
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++)
+		pages += zs_can_compact(&pool->size_class[i]);
+
+	return min_t(unsigned long, pages, INT_MAX);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int zs_stats_classes_show(struct seq_file *s, void *v)
+{
+	struct zs_pool *pool = s->private;
+	struct size_class *class;
+	struct page *head, *page;
+	unsigned long inuse, capacity, pages, freeable;
+	int i, fg, nr[_ZS_NR_FULLNESS_GROUPS];
+
+	seq_printf(s, " %5s %5s %11s %12s %13s %10s %10s %16s %8s\n",
+		   "class", "size", "almost_full", "almost_empty",
+		   "obj_allocated", "obj_used", "pages_used",
+		   "pages_per_zspage", "freeable");
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		class = &pool->size_class[i];
+
+		spin_lock(&class->lock);
+		for (fg = 0; fg < _ZS_NR_FULLNESS_GROUPS; fg++) {
+			nr[fg] = 0;
+			head = class->fullness_list[fg];
+			if (!head)
+				continue;
+			nr[fg] = 1;
+			list_for_each_entry(page, &head->lru, lru)
+				nr[fg]++;
+		}
+		pages = class->pages_allocated;
+		inuse = class->objs_inuse;
+		freeable = zs_can_compact(class);
+		spin_unlock(&class->lock);
+
+		if (!pages)
+			continue;
+		capacity = pages / class->zspage_order * class->objs_per_zspage;
+		seq_printf(s, " %5u %5u %11d %12d %13lu %10lu %10lu %16d %8lu\n",
+			   i, class->size, nr[ZS_ALMOST_FULL],
+			   nr[ZS_ALMOST_EMPTY], capacity, inuse, pages,
+			   class->zspage_order, freeable);
+	}
+	return 0;
+}
+
+static int zs_stats_classes_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, zs_stats_classes_show, inode->i_private);
+}
+
+static const struct file_operations zs_stats_classes_fops = {
+	.open		= zs_stats_classes_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void zs_pool_stat_create(struct zs_pool *pool)
+{
+	if (IS_ERR_OR_NULL(zs_stat_root))
+		return;
+
+	/* pools sharing a name go without */
+	pool->stat_dentry = debugfs_create_dir(pool->name, zs_stat_root);
+	if (IS_ERR_OR_NULL(pool->stat_dentry)) {
+		pool->stat_dentry = NULL;
+		return;
+	}
+	debugfs_create_file("classes", S_IRUGO, pool->stat_dentry, pool,
+			    &zs_stats_classes_fops);
+}
+
+static void zs_pool_stat_destroy(struct zs_pool *pool)
+{
+	debugfs_remove_recursive(pool->stat_dentry);
+}
+#else
+static void zs_pool_stat_create(struct zs_pool *pool)
+{
+}
+
+static void zs_pool_stat_destroy(struct zs_pool *pool)
+{
+}
+#endif
 
 /*
  * If this becomes a separate module, register zs_init() with
@@ -441,18 +823,17 @@ static int zs_cpu_notifier(struct notifier_block *nb, unsigned long action,
 	switch (action) {
 	case CPU_UP_PREPARE:
 		area = &per_cpu(zs_map_area, cpu);
-		if (area->vm)
+		if (area->vm_buf)
 			break;
-		area->vm = alloc_vm_area(2 * PAGE_SIZE, area->vm_ptes);
-		if (!area->vm)
+		area->vm_buf = (char *)__get_free_page(GFP_KERNEL);
+		if (!area->vm_buf)
 			return notifier_from_errno(-ENOMEM);
 		break;
 	case CPU_DEAD:
 	case CPU_UP_CANCELED:
 		area = &per_cpu(zs_map_area, cpu);
-		if (area->vm)
-			free_vm_area(area->vm);
-		area->vm = NULL;
+		free_page((unsigned long)area->vm_buf);
+		area->vm_buf = NULL;
 		break;
 	}
 
@@ -470,6 +851,12 @@ static void zs_exit(void)
 	for_each_online_cpu(cpu)
 		zs_cpu_notifier(NULL, CPU_DEAD, (void *)(long)cpu);
 	unregister_cpu_notifier(&zs_cpu_nb);
+
+	debugfs_remove_recursive(zs_stat_root);
+	zs_stat_root = NULL;
+	if (zs_handle_cachep)
+		kmem_cache_destroy(zs_handle_cachep);
+	zs_handle_cachep = NULL;
 }
 
 static int zs_init(void)
@@ -482,6 +869,15 @@ static int zs_init(void)
 		if (notifier_to_errno(ret))
 			goto fail;
 	}
+
+	zs_handle_cachep = kmem_cache_create("zs_handle", ZS_HANDLE_SIZE,
+					     0, 0, NULL);
+	if (!zs_handle_cachep) {
+		ret = notifier_from_errno(-ENOMEM);
+		goto fail;
+	}
+
+	zs_stat_root = debugfs_create_dir("zsmalloc", NULL);
 	return 0;
 fail:
 	zs_exit();
@@ -514,6 +910,7 @@ struct zs_pool *zs_create_pool(const char *name, gfp_t flags)
 		class->index = i;
 		spin_lock_init(&class->lock);
 		class->zspage_order = get_zspage_order(size);
+		class->objs_per_zspage = class->zspage_order * PAGE_SIZE / size;
 
 	}
 
@@ -523,21 +920,20 @@ struct zs_pool *zs_create_pool(const char *name, gfp_t flags)
 	*/
 	if (!zs_initialized) {
 		error = zs_init();
-		if (error)
-			goto cleanup;
+		if (error) {
+			kfree(pool);
+			return NULL;
+		}
 		zs_initialized = 1;
 	}
 
 	pool->flags = flags;
 	pool->name = name;
 
-	error = 0; /* Success */
-
-cleanup:
-	if (error) {
-		zs_destroy_pool(pool);
-		pool = NULL;
-	}
+	pool->shrinker.shrink = zs_shrinker_fn;
+	pool->shrinker.seeks = DEFAULT_SEEKS;
+	register_shrinker(&pool->shrinker);
+	zs_pool_stat_create(pool);
 
 	return pool;
 }
@@ -547,6 +943,9 @@ void zs_destroy_pool(struct zs_pool *pool)
 {
 	int i;
 
+	zs_pool_stat_destroy(pool);
+	unregister_shrinker(&pool->shrinker);
+
 	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
 		int fg;
 		struct size_class *class = &pool->size_class[i];
@@ -567,28 +966,29 @@ EXPORT_SYMBOL_GPL(zs_destroy_pool);
  * zs_malloc - Allocate block of given size from pool.
  * @pool: pool to allocate from
  * @size: size of block to allocate
- * @page: page no. that holds the object
- * @offset: location of object within page
  *
- * On success, <page, offset> identifies block allocated
- * and 0 is returned. On failure, <page, offset> is set to
- * 0 and -ENOMEM is returned.
+ * On success, a handle to the allocated block is returned, which must
+ * be mapped with zs_map_object() to get at the block.  On failure NULL
+ * is returned.
  *
- * Allocation requests with size > ZS_MAX_ALLOC_SIZE will fail.
+ * The handle is stored in front of the block, so allocation requests
+ * with size > ZS_MAX_ALLOC_SIZE - ZS_HANDLE_SIZE will fail.
  */
 void *zs_malloc(struct zs_pool *pool, size_t size)
 {
-	void *obj;
-	struct link_free *link;
+	unsigned long *handle;
 	int class_idx;
 	struct size_class *class;
+	struct page *first_page;
 
-	struct page *first_page, *m_page;
-	unsigned long m_objidx, m_offset;
+	if (unlikely(!size || size > ZS_MAX_ALLOC_SIZE - ZS_HANDLE_SIZE))
+		return NULL;
 
-	if (unlikely(!size || size > ZS_MAX_ALLOC_SIZE))
+	handle = alloc_handle(pool);
+	if (!handle)
 		return NULL;
 
+	size += ZS_HANDLE_SIZE;
 	class_idx = get_size_class_index(size);
 	class = &pool->size_class[class_idx];
 	BUG_ON(class_idx != class->index);
@@ -599,75 +999,69 @@ void *zs_malloc(struct zs_pool *pool, size_t size)
 	if (!first_page) {
 		spin_unlock(&class->lock);
 		first_page = alloc_zspage(class, pool->flags);
-		if (unlikely(!first_page))
+		if (unlikely(!first_page)) {
+			free_handle(handle);
 			return NULL;
+		}
 
 		set_zspage_mapping(first_page, class->index, ZS_EMPTY);
 		spin_lock(&class->lock);
 		class->pages_allocated += class->zspage_order;
 	}
 
-	obj = first_page->freelist;
-	obj_handle_to_location(obj, &m_page, &m_objidx);
-	m_offset = obj_idx_to_offset(m_page, m_objidx, class->size);
-
-	link = (struct link_free *)kmap_atomic(m_page) +
-					m_offset / sizeof(*link);
-	first_page->freelist = link->next;
-	memset(link, POISON_INUSE, sizeof(*link));
-	kunmap_atomic(link);
-
-	first_page->inuse++;
+	/* the handle is not out yet, compaction sees it under class->lock */
+	*handle = (unsigned long)obj_malloc(first_page, class,
+					    (unsigned long)handle);
 	/* Now move the zspage to another fullness group, if required */
 	fix_fullness_group(pool, first_page);
 	spin_unlock(&class->lock);
 
-	return obj;
+	return handle;
 }
 EXPORT_SYMBOL_GPL(zs_malloc);
 
-void zs_free(struct zs_pool *pool, void *obj)
+void zs_free(struct zs_pool *pool, void *handle)
 {
-	struct link_free *link;
 	struct page *first_page, *f_page;
-	unsigned long f_objidx, f_offset;
+	unsigned long f_objidx;
+	void *obj;
 
 	int class_idx;
 	struct size_class *class;
 	enum fullness_group fullness;
 
-	if (unlikely(!obj))
+	if (unlikely(!handle))
 		return;
 
-	obj_handle_to_location(obj, &f_page, &f_objidx);
+	/* keeps compaction from moving the object under us */
+	pin_tag(handle);
+	obj = handle_to_obj(handle);
+	obj_to_location(obj, &f_page, &f_objidx);
 	first_page = get_first_page(f_page);
 
 	get_zspage_mapping(first_page, &class_idx, &fullness);
 	class = &pool->size_class[class_idx];
-	f_offset = obj_idx_to_offset(f_page, f_objidx, class->size);
 
 	spin_lock(&class->lock);
-
-	/* Insert this object in containing zspage's freelist */
-	link = (struct link_free *)((unsigned char *)kmap_atomic(f_page)
-							+ f_offset);
-	link->next = first_page->freelist;
-	kunmap_atomic(link);
-	first_page->freelist = obj;
-
-	first_page->inuse--;
+	obj_free(first_page, class, obj);
 	fullness = fix_fullness_group(pool, first_page);
 
 	if (fullness == ZS_EMPTY)
 		class->pages_allocated -= class->zspage_order;
 
 	spin_unlock(&class->lock);
+	unpin_tag(handle);
+	free_handle(handle);
 
 	if (fullness == ZS_EMPTY)
 		free_zspage(first_page);
 }
 EXPORT_SYMBOL_GPL(zs_free);
 
+/*
+ * The object stays pinned, and cannot be moved by compaction, until
+ * zs_unmap_object().
+ */
 void *zs_map_object(struct zs_pool *pool, void *handle)
 {
 	struct page *page;
@@ -680,7 +1074,8 @@ void *zs_map_object(struct zs_pool *pool, void *handle)
 
 	BUG_ON(!handle);
 
-	obj_handle_to_location(handle, &page, &obj_idx);
+	pin_tag(handle);
+	obj_to_location(handle_to_obj(handle), &page, &obj_idx);
 	get_zspage_mapping(get_first_page(page), &class_idx, &fg);
 	class = &pool->size_class[class_idx];
 	off = obj_idx_to_offset(page, obj_idx, class->size);
@@ -688,23 +1083,16 @@ void *zs_map_object(struct zs_pool *pool, void *handle)
 	area = &get_cpu_var(zs_map_area);
 	if (off + class->size <= PAGE_SIZE) {
 		/* this object is contained entirely within a page */
+		area->huge = false;
 		area->vm_addr = kmap_atomic(page);
-	} else {
-		/* this object spans two pages */
-		struct page *nextp;
-
-		nextp = get_next_page(page);
-		BUG_ON(!nextp);
-
-
-		set_pte(area->vm_ptes[0], mk_pte(page, PAGE_KERNEL));
-		set_pte(area->vm_ptes[1], mk_pte(nextp, PAGE_KERNEL));
-
-		/* We pre-allocated VM area so mapping can never fail */
-		area->vm_addr = area->vm->addr;
+		return area->vm_addr + off + ZS_HANDLE_SIZE;
 	}
 
-	return area->vm_addr + off;
+	/* this object spans two pages, hand out a contiguous copy */
+	area->huge = true;
+	area->vm_addr = area->vm_buf;
+	zs_copy_object(page, off, class->size, area->vm_buf, true);
+	return area->vm_addr + ZS_HANDLE_SIZE;
 }
 EXPORT_SYMBOL_GPL(zs_map_object);
 
@@ -720,21 +1108,21 @@ void zs_unmap_object(struct zs_pool *pool, void *handle)
 
 	BUG_ON(!handle);
 
-	obj_handle_to_location(handle, &page, &obj_idx);
-	get_zspage_mapping(get_first_page(page), &class_idx, &fg);
-	class = &pool->size_class[class_idx];
-	off = obj_idx_to_offset(page, obj_idx, class->size);
-
 	area = &__get_cpu_var(zs_map_area);
-	if (off + class->size <= PAGE_SIZE) {
+	if (!area->huge) {
 		kunmap_atomic(area->vm_addr);
-	} else {
-		set_pte(area->vm_ptes[0], __pte(0));
-		set_pte(area->vm_ptes[1], __pte(0));
-		__flush_tlb_one((unsigned long)area->vm_addr);
-		__flush_tlb_one((unsigned long)area->vm_addr + PAGE_SIZE);
+		goto out;
 	}
+
+	/* callers may have written through the mapping: copy it back */
+	obj_to_location(handle_to_obj(handle), &page, &obj_idx);
+	get_zspage_mapping(get_first_page(page), &class_idx, &fg);
+	class = &pool->size_class[class_idx];
+	off = obj_idx_to_offset(page, obj_idx, class->size);
+	zs_copy_object(page, off, class->size, area->vm_buf, false);
+out:
 	put_cpu_var(zs_map_area);
+	unpin_tag(handle);
 }
 EXPORT_SYMBOL_GPL(zs_unmap_object);
 
@@ -25,6 +25,8 @@
 #include <linux/io.h>
 #include <linux/err.h>
 #include <linux/pm.h>
+#include <linux/mutex.h>
+#include <linux/notifier.h>
 
 #include <mach/msm_iomap.h>
 #include <mach/socinfo.h>
@@ -165,6 +167,10 @@ struct tsens_tm_device {
 
 struct tsens_tm_device *tmdev;
 
+/* kernel users of the lower and upper thresholds, see tsens_set_window() */
+static BLOCKING_NOTIFIER_HEAD(tsens_window_notifier);
+static DEFINE_MUTEX(tsens_threshold_lock);
+
 /* Temperature on y axis and ADC-code on x-axis */
 static int tsens_tz_code_to_degC(int adc_code, int sensor_num)
 {
@@ -617,9 +623,10 @@ static void tsens_scheduler_fn(struct work_struct *work)
 					tsens_work);
 	unsigned int threshold, threshold_low, i, code, reg, sensor, mask;
 	unsigned int sensor_addr;
-	bool upper_th_x, lower_th_x;
+	bool upper_th_x, lower_th_x, crossed = false;
 	int adc_code;
 
+	mutex_lock(&tsens_threshold_lock);
 	if (tmdev->hw_type == APQ_8064) {
 		reg = readl_relaxed(TSENS_8064_STATUS_CNTL);
 		writel_relaxed(reg | TSENS_LOWER_STATUS_CLR |
@@ -658,6 +665,7 @@ static void tsens_scheduler_fn(struct work_struct *work)
 			if (lower_th_x)
 				mask |= TSENS_LOWER_STATUS_CLR;
 			if (upper_th_x || lower_th_x) {
+				crossed = true;
 				/* Notify user space */
 				schedule_work(&tm->sensor[i].work);
 				adc_code = readl_relaxed(sensor_addr);
@@ -673,7 +681,83 @@ static void tsens_scheduler_fn(struct work_struct *work)
 	else
 	writel_relaxed(reg & mask, TSENS_CNTL_ADDR);
 	mb();
+	mutex_unlock(&tsens_threshold_lock);
+
+	if (crossed)
+		blocking_notifier_call_chain(&tsens_window_notifier, 0, NULL);
+}
+
+/**
+ * tsens_set_window() - interrupt when any sensor leaves [lo_degC, hi_degC]
+ * @lo_degC: lower threshold, at or below which the upper one is ignored
+ * @hi_degC: upper threshold
+ *
+ * The thresholds are shared by all sensors, so the codes are chosen such
+ * that every sensor's window lies within the one asked for.  A crossing
+ * calls the chain set up with tsens_register_window_notifier(), from
+ * process context.  This reprograms the stage 1 and 2 trips of the
+ * thermal zones and is not meant to be used together with them.
+ */
+int tsens_set_window(long lo_degC, long hi_degC)
+{
+	unsigned int reg_th, reg_cntl, addr, lo_code, hi_code, min, max;
+	unsigned int i;
+
+	if (!tmdev || lo_degC >= hi_degC)
+		return -EINVAL;
+
+	lo_code = TSENS_THRESHOLD_MIN_CODE;
+	hi_code = TSENS_THRESHOLD_MAX_CODE;
+	for (i = 0; i < tmdev->tsens_num_sensor; i++) {
+		lo_code = max_t(unsigned int, lo_code,
+				tsens_tz_degC_to_code(lo_degC, i));
+		hi_code = min_t(unsigned int, hi_code,
+				tsens_tz_degC_to_code(hi_degC, i));
+	}
+
+	mutex_lock(&tsens_threshold_lock);
+	reg_th = readl_relaxed(TSENS_THRESHOLD_ADDR);
+	min = (reg_th & TSENS_THRESHOLD_MIN_LIMIT_MASK)
+				>> TSENS_THRESHOLD_MIN_LIMIT_SHIFT;
+	max = (reg_th & TSENS_THRESHOLD_MAX_LIMIT_MASK)
+				>> TSENS_THRESHOLD_MAX_LIMIT_SHIFT;
+	/* stay between the min and max trips, which are left alone */
+	lo_code = clamp(lo_code, min + 1, max - 2);
+	hi_code = clamp(hi_code, lo_code + 1, max - 1);
+
+	reg_th &= ~(TSENS_THRESHOLD_LOWER_LIMIT_MASK |
+		    TSENS_THRESHOLD_UPPER_LIMIT_MASK);
+	reg_th |= lo_code << TSENS_THRESHOLD_LOWER_LIMIT_SHIFT;
+	reg_th |= hi_code << TSENS_THRESHOLD_UPPER_LIMIT_SHIFT;
+	writel_relaxed(reg_th, TSENS_THRESHOLD_ADDR);
+
+	/* clear what the old window latched, then unmask both */
+	addr = (tmdev->hw_type == APQ_8064) ?
+		(unsigned int) TSENS_8064_STATUS_CNTL :
+		(unsigned int) TSENS_CNTL_ADDR;
+	reg_cntl = readl_relaxed(addr);
+	writel_relaxed(reg_cntl | TSENS_LOWER_STATUS_CLR |
+		       TSENS_UPPER_STATUS_CLR, addr);
+	writel_relaxed(reg_cntl & ~(TSENS_LOWER_STATUS_CLR |
+		       TSENS_UPPER_STATUS_CLR), addr);
+	mb();
+	mutex_unlock(&tsens_threshold_lock);
+
+	return 0;
+}
+EXPORT_SYMBOL(tsens_set_window);
+
+int tsens_register_window_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_register(&tsens_window_notifier, nb);
+}
+EXPORT_SYMBOL(tsens_register_window_notifier);
+
+int tsens_unregister_window_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_unregister(&tsens_window_notifier, nb);
 }
+EXPORT_SYMBOL(tsens_unregister_window_notifier);
 
 static irqreturn_t tsens_isr(int irq, void *data)
 {
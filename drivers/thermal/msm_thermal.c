@@ -26,6 +26,8 @@
 #include <linux/of.h>
 #include <mach/cpufreq.h>
 #include <linux/reboot.h>
+#include <linux/math64.h>
+#include <linux/msm_kgsl.h>
 
 /*
  * Controls
@@ -101,6 +103,335 @@ static int update_cpu_max_freq(int cpu, uint32_t max_freq)
 	return ret;
 }
 
+/*
+ * PID control
+ *
+ * Instead of stepping all cores down past throttle_temp, the hottest
+ * sensor is held at throttle_temp by a PID loop on the temperature and
+ * its trend.  Its output is how much power to shed, in thousandths of a
+ * core at the top frequency, where a core at frequency f is estimated to
+ * take (f / fmax)^3 of that.  Power is shed from the hottest cores first,
+ * then by capping the GPU and last by taking cores offline.
+ */
+#define PID_UNIT		1000
+#define PID_MAX_LEVELS		32
+#define PID_GPU_STEPS		3
+
+static bool pid_control = true;
+module_param(pid_control, bool, 0644);
+MODULE_PARM_DESC(pid_control, "msm_thermal PID control instead of steps (Y/N)");
+
+/* per-mille of a core per C, per C second and per C/s above the limit */
+static unsigned int pid_kp = 60;
+static unsigned int pid_ki = 8;
+static unsigned int pid_kd = 250;
+module_param(pid_kp, uint, 0644);
+module_param(pid_ki, uint, 0644);
+module_param(pid_kd, uint, 0644);
+
+/* power of one GPU level in per-mille of a core, 0 to leave the GPU be */
+static unsigned int gpu_step_power = 150;
+module_param(gpu_step_power, uint, 0644);
+static bool core_offline = true;
+module_param(core_offline, bool, 0644);
+/* cores have their own sensors, numbered from sensor_id */
+static bool per_core_sensors = true;
+module_param(per_core_sensors, bool, 0644);
+
+static struct {
+	long integral;		/* C ms above the limit */
+	long trend;		/* C per second, times 16 */
+	long prev_temp;
+	unsigned long prev_jiffies;
+	unsigned int nr_levels;
+	unsigned int power[PID_MAX_LEVELS];	/* per frequency index */
+	uint32_t max_freq[NR_CPUS];	/* limit last set on each core */
+	unsigned int gpu_steps;
+	cpumask_t offlined;
+	bool active;
+} pid;
+
+static void pid_init(void)
+{
+	u64 fmax;
+	unsigned int i;
+	int cpu;
+
+	pid.nr_levels = min_t(unsigned int, limit_idx_high + 1,
+			      PID_MAX_LEVELS);
+	fmax = table[pid.nr_levels - 1].frequency / 1000;
+	fmax = fmax * fmax * fmax;
+	for (i = 0; i < pid.nr_levels; i++) {
+		u64 f = table[i].frequency / 1000;
+
+		pid.power[i] = div64_u64(f * f * f * PID_UNIT, fmax);
+	}
+
+	for_each_possible_cpu(cpu)
+		pid.max_freq[cpu] = MSM_CPUFREQ_NO_LIMIT;
+}
+
+static long pid_core_temp(int cpu, long fallback)
+{
+	struct tsens_device tsens_dev;
+	unsigned long temp;
+
+	tsens_dev.sensor_num = msm_thermal_info.sensor_id + cpu;
+	if (!per_core_sensors || tsens_dev.sensor_num >= TSENS_MAX_SENSORS ||
+	    tsens_get_temp(&tsens_dev, &temp))
+		return fallback;
+
+	return temp;
+}
+
+static unsigned int pid_full_power(void)
+{
+	return num_possible_cpus() * PID_UNIT +
+		PID_GPU_STEPS * gpu_step_power;
+}
+
+/* Power to shed for @temp, the hottest sensor */
+static unsigned int pid_update(long temp)
+{
+	unsigned long now = jiffies;
+	unsigned int dt = jiffies_to_msecs(now - pid.prev_jiffies);
+	long full = pid_full_power();
+	long err = temp - throttle_temp;
+	long out;
+
+	if (pid.active && dt) {
+		long slope = (temp - pid.prev_temp) * 16 * 1000 / (long) dt;
+
+		pid.trend = (3 * pid.trend + slope) / 4;
+		pid.integral += err * dt;
+		/* no credit for time spent cool and no windup past full */
+		if (pid.integral < 0)
+			pid.integral = 0;
+		if (pid_ki && pid.integral > full * 1000 / pid_ki)
+			pid.integral = full * 1000 / pid_ki;
+	}
+	pid.prev_temp = temp;
+	pid.prev_jiffies = now;
+	pid.active = true;
+
+	out = (long) pid_kp * err + (long) pid_ki * pid.integral / 1000 +
+		(long) pid_kd * pid.trend / 16;
+
+	return clamp(out, 0L, full);
+}
+
+static void pid_set_offline(unsigned int nr)
+{
+	int cpu;
+
+	/* one core per sample, either way */
+	if (nr > cpumask_weight(&pid.offlined)) {
+		for (cpu = nr_cpu_ids - 1; cpu > 0; cpu--) {
+			if (!cpu_online(cpu))
+				continue;
+			if (!cpu_down(cpu))
+				cpumask_set_cpu(cpu, &pid.offlined);
+			break;
+		}
+	} else if (nr < cpumask_weight(&pid.offlined)) {
+		cpu = cpumask_first(&pid.offlined);
+		cpumask_clear_cpu(cpu, &pid.offlined);
+		cpu_up(cpu);
+	}
+}
+
+static void pid_apply(unsigned int *level, unsigned int gpu_steps,
+		      unsigned int offline)
+{
+	unsigned int top = pid.nr_levels - 1;
+	uint32_t max_freq;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		max_freq = level[cpu] >= top ? MSM_CPUFREQ_NO_LIMIT :
+			table[level[cpu]].frequency;
+		if (max_freq == pid.max_freq[cpu])
+			continue;
+		/* offline cores keep the limit for when they come back */
+		if (update_cpu_max_freq(cpu, max_freq) && thermal_debug)
+			pr_info("msm_thermal: unable to limit cpu%d max freq to %d\n",
+				cpu, max_freq);
+		pid.max_freq[cpu] = max_freq;
+	}
+
+	if (gpu_steps != pid.gpu_steps &&
+	    kgsl_pwrctrl_thermal_cap(gpu_steps) >= 0)
+		pid.gpu_steps = gpu_steps;
+
+	pid_set_offline(offline);
+}
+
+/*
+ * Shed @shed from the configuration with every core at the top frequency,
+ * taking a step off the core whose temperature less the steps already
+ * taken off it is highest, so the hottest core gives up most.
+ */
+static void pid_mitigate(unsigned int shed, long *temps)
+{
+	unsigned int level[NR_CPUS];
+	unsigned int top = pid.nr_levels - 1;
+	unsigned int lowest = min(min_freq_index, top);
+	unsigned int gpu_steps = 0, offline = 0;
+	int cpu, best;
+	long rank, best_rank = 0;
+
+	for_each_possible_cpu(cpu)
+		level[cpu] = top;
+
+	while (shed) {
+		unsigned int saved;
+
+		best = -1;
+		for_each_online_cpu(cpu) {
+			if (level[cpu] <= lowest)
+				continue;
+			rank = temps[cpu] - (long) (top - level[cpu]);
+			if (best < 0 || rank > best_rank) {
+				best = cpu;
+				best_rank = rank;
+			}
+		}
+		if (best < 0)
+			break;
+
+		saved = pid.power[level[best]] - pid.power[level[best] - 1];
+		level[best]--;
+		shed -= min(shed, saved);
+	}
+
+	if (shed && gpu_step_power) {
+		gpu_steps = min_t(unsigned int, PID_GPU_STEPS,
+				  DIV_ROUND_UP(shed, gpu_step_power));
+		shed -= min(shed, gpu_steps * gpu_step_power);
+	}
+
+	if (shed && core_offline && pid.power[lowest])
+		offline = min(DIV_ROUND_UP(shed, pid.power[lowest]),
+			      num_possible_cpus() - 1);
+
+	if (thermal_debug)
+		pr_info("msm_thermal: pid shed %u left, gpu %u, offline %u\n",
+			shed, gpu_steps, offline);
+
+	pid_apply(level, gpu_steps, offline);
+}
+
+/* Returns true when the temperature is close enough to poll faster */
+static bool check_temp_pid(long temp)
+{
+	long temps[NR_CPUS];
+	long hottest = temp;
+	unsigned int shed;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		temps[cpu] = cpu_online(cpu) ? pid_core_temp(cpu, temp) : temp;
+		hottest = max(hottest, temps[cpu]);
+	}
+
+	if (hottest >= MAX_THROTTLE_TEMP) {
+		if (!throttle_on)
+			pr_info("msm_thermal: PID at max temp, CPU temp is %ldC\n",
+				hottest);
+		shed = pid_full_power();
+	} else {
+		shed = pid_update(hottest);
+	}
+
+	if (thermal_debug)
+		pr_info("msm_thermal: pid temp %ldC trend %ld/16 C/s shed %u\n",
+			hottest, pid.trend, shed);
+
+	if (shed && !throttle_on)
+		pr_info("msm_thermal: throttling ON - CPU temp is %ldC\n",
+			hottest);
+	else if (!shed && throttle_on)
+		pr_info("msm_thermal: throttling OFF, CPU temp is %ldC\n",
+			hottest);
+	throttle_on = shed != 0;
+
+	pid_mitigate(shed, temps);
+
+	return hottest >= throttle_temp - msm_thermal_info.temp_hysteresis_degC;
+}
+
+/* Undo whatever the PID controller limited */
+static void pid_release(void)
+{
+	unsigned int level[NR_CPUS];
+	int cpu;
+
+	if (!pid.active)
+		return;
+
+	for_each_possible_cpu(cpu)
+		level[cpu] = pid.nr_levels - 1;
+	pid_apply(level, 0, 0);
+	while (!cpumask_empty(&pid.offlined))
+		pid_set_offline(0);
+
+	pid.integral = 0;
+	pid.trend = 0;
+	pid.active = false;
+}
+
+/*
+ * Threshold interrupts
+ *
+ * Below the mitigation band there is nothing to do but watch, so instead
+ * of polling, the tsens lower and upper thresholds are set to a window
+ * of window_degC around the current temperature, capped at the start of
+ * the band, and check_temp runs again when a sensor leaves it.
+ */
+static bool irq_mode = true;
+module_param(irq_mode, bool, 0644);
+MODULE_PARM_DESC(irq_mode, "msm_thermal use tsens thresholds when cool (Y/N)");
+static unsigned int window_degC = 5;
+module_param(window_degC, uint, 0644);
+
+static bool window_armed;
+
+static int msm_thermal_window_notify(struct notifier_block *nb,
+				     unsigned long action, void *data)
+{
+	if (window_armed && enabled) {
+		window_armed = false;
+		schedule_delayed_work(&check_temp_work, 0);
+	}
+	return NOTIFY_OK;
+}
+
+static struct notifier_block msm_thermal_window_nb = {
+	.notifier_call = msm_thermal_window_notify,
+};
+
+/* Returns true if check_temp does not need to be polled */
+static bool msm_thermal_arm_window(unsigned long temp, bool mitigating)
+{
+	long band = throttle_temp - msm_thermal_info.temp_hysteresis_degC;
+	long window = max(window_degC, 1U);
+
+	if (!irq_mode || mitigating || (long) temp >= band)
+		return false;
+
+	window_armed = true;
+	if (tsens_set_window(temp - window, min((long) temp + window, band))) {
+		window_armed = false;
+		return false;
+	}
+
+	if (thermal_debug)
+		pr_info("msm_thermal: CPU temp %luC, waiting for %ldC..%ldC\n",
+			temp, (long) temp - window,
+			min((long) temp + window, band));
+	return true;
+}
+
 static void check_temp(struct work_struct *work)
 {
 	static int limit_init;
@@ -129,7 +460,14 @@ static void check_temp(struct work_struct *work)
 			goto reschedule;
 		else
 			limit_init = 1;
+		pid_init();
+	}
+
+	if (pid_control) {
+		poll_faster = check_temp_pid(temp);
+		goto reschedule;
 	}
+	pid_release();
 	
 	/* max throttle exceeded - go direct to teh low step until it is under control */
 	if (temp >= MAX_THROTTLE_TEMP) {
@@ -200,6 +538,12 @@ setmaxfreq:
 	}
 
 reschedule:
+	/* Cool and nothing limited: wait for the thresholds instead */
+	if (enabled && limit_init && !ret && msm_thermal_arm_window(temp,
+	    pid_control ? throttle_on || !cpumask_empty(&pid.offlined) :
+	    limit_idx != limit_idx_high))
+		return;
+
 	/* Reschedule next poll adjusting polling time (ms) on current situation */
 	if (enabled) {
 		if (temp > COOL_TEMP) {
@@ -231,6 +575,7 @@ static void disable_msm_thermal(void)
 	cancel_delayed_work(&check_temp_work);
 	flush_scheduled_work();
 
+	pid_release();
 	if (limited_max_freq == MSM_CPUFREQ_NO_LIMIT)
 		return;
 
@@ -344,6 +689,7 @@ int __devinit msm_thermal_init(struct msm_thermal_data *pdata)
 
 	enabled = 1;
 	INIT_DELAYED_WORK(&check_temp_work, check_temp);
+	tsens_register_window_notifier(&msm_thermal_window_nb);
 	schedule_delayed_work(&check_temp_work, 0);
 
 	return ret;
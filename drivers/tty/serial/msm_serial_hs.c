@@ -67,6 +67,10 @@ static int hs_serial_debug_mask = 1;
 module_param_named(debug_mask, hs_serial_debug_mask,
 		   int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/* RX DMA buffer size, taken when a port is probed */
+static int hs_serial_rx_buf_size = 512;
+module_param_named(rx_buf_size, hs_serial_rx_buf_size, int, S_IRUGO);
+
 enum flush_reason {
 	FLUSH_NONE,
 	FLUSH_DATA_READY,
@@ -115,8 +119,16 @@ struct msm_hs_rx {
 	u32 *command_ptr_ptr;
 	dma_addr_t mapped_cmd_ptr;
 	wait_queue_head_t wait;
+	/*
+	 * DMA goes to buffer.  The spare is re-armed by the tasklet before
+	 * it copies buffer to the tty, so that reception does not stop
+	 * for the copy.
+	 */
 	dma_addr_t rbuffer;
 	unsigned char *buffer;
+	dma_addr_t spare_rbuffer;
+	unsigned char *spare_buffer;
+	unsigned int buf_size;
 	unsigned int buffer_pending;
 	struct dma_pool *pool;
 	struct wake_lock wake_lock;
@@ -131,6 +143,11 @@ enum buffer_states {
 	CHARS_NORMAL = 0x4,
 };
 
+/* with CHARS_NORMAL, buffer_pending also holds the chars left to copy */
+#define PENDING_OFFSET_SHIFT	3
+#define PENDING_OFFSET_BMSK	0xFFF8
+#define PENDING_COUNT_SHIFT	16
+
 /* optional low power wakeup, typically on a GPIO RX irq */
 struct msm_hs_wakeup {
 	int irq;  /* < 0 indicates low power wakeup disabled */
@@ -172,7 +189,8 @@ struct msm_hs_port {
 
 #define MSM_UARTDM_BURST_SIZE 16   /* DM burst size (in bytes) */
 #define UARTDM_TX_BUF_SIZE UART_XMIT_SIZE
-#define UARTDM_RX_BUF_SIZE 512
+#define UARTDM_RX_BUF_MIN 512
+#define UARTDM_RX_BUF_MAX 4096
 #define RETRY_TIMEOUT 5
 #define UARTDM_NR 5
 
@@ -412,6 +430,8 @@ static int __devexit msm_hs_remove(struct platform_device *pdev)
 			 DMA_TO_DEVICE);
 	dma_pool_free(msm_uport->rx.pool, msm_uport->rx.buffer,
 		      msm_uport->rx.rbuffer);
+	dma_pool_free(msm_uport->rx.pool, msm_uport->rx.spare_buffer,
+		      msm_uport->rx.spare_rbuffer);
 	dma_pool_destroy(msm_uport->rx.pool);
 
 	dma_unmap_single(dev, msm_uport->rx.cmdptr_dmaaddr, sizeof(u32),
@@ -913,8 +933,12 @@ static void msm_hs_start_rx_locked(struct uart_port *uport)
 		printk(KERN_ERR "Error: rx started in buffer state = %x",
 		       buffer_pending);
 
+	msm_uport->rx.command_ptr->dst_row_addr = msm_uport->rx.rbuffer;
+	dma_sync_single_for_device(uport->dev, msm_uport->rx.mapped_cmd_ptr,
+				   sizeof(dmov_box), DMA_TO_DEVICE);
+
 	msm_hs_write(uport, UARTDM_CR_ADDR, RESET_STALE_INT);
-	msm_hs_write(uport, UARTDM_DMRX_ADDR, UARTDM_RX_BUF_SIZE);
+	msm_hs_write(uport, UARTDM_DMRX_ADDR, msm_uport->rx.buf_size);
 	msm_hs_write(uport, UARTDM_CR_ADDR, STALE_EVENT_ENABLE);
 	msm_uport->imr_reg |= UARTDM_ISR_RXLEV_BMSK;
 
@@ -962,15 +986,17 @@ static void flip_insert_work(struct work_struct *work)
 	}
 	if (msm_uport->rx.buffer_pending & CHARS_NORMAL) {
 		int rx_count, rx_offset;
-		rx_count = (msm_uport->rx.buffer_pending & 0xFFFF0000) >> 16;
-		rx_offset = (msm_uport->rx.buffer_pending & 0xFFD0) >> 5;
+		rx_count = msm_uport->rx.buffer_pending >> PENDING_COUNT_SHIFT;
+		rx_offset = (msm_uport->rx.buffer_pending &
+			     PENDING_OFFSET_BMSK) >> PENDING_OFFSET_SHIFT;
 		retval = tty_insert_flip_string(tty, msm_uport->rx.buffer +
 						rx_offset, rx_count);
 		msm_uport->rx.buffer_pending &= (FIFO_OVERRUN |
 						 PARITY_ERROR);
 		if (retval != rx_count)
 			msm_uport->rx.buffer_pending |= CHARS_NORMAL |
-				retval << 8 | (rx_count - retval) << 16;
+				(rx_offset + retval) << PENDING_OFFSET_SHIFT |
+				(rx_count - retval) << PENDING_COUNT_SHIFT;
 	}
 	if (msm_uport->rx.buffer_pending)
 		schedule_delayed_work(&msm_uport->rx.flip_insert_work,
@@ -1000,6 +1026,8 @@ static void msm_serial_hs_rx_tlet(unsigned long tlet_ptr)
 	struct msm_hs_port *msm_uport;
 	unsigned int flush;
 	struct tty_struct *tty;
+	unsigned char *buffer;
+	dma_addr_t rbuffer;
 
 	msm_uport = container_of((struct tasklet_struct *)tlet_ptr,
 				 struct msm_hs_port, rx.tlet);
@@ -1058,19 +1086,36 @@ static void msm_serial_hs_rx_tlet(unsigned long tlet_ptr)
 	/* order the read of rx.buffer */
 	rmb();
 
+	buffer = msm_uport->rx.buffer;
+	/*
+	 * If the tty can take it all, receive into the spare buffer while
+	 * this one is copied.  Otherwise reception waits for the tty to
+	 * drain and auto RFR holds off the sender meanwhile.
+	 */
+	if (!msm_uport->rx.buffer_pending &&
+	    (!(uport->read_status_mask & CREAD) ||
+	     tty_buffer_request_room(tty, rx_count) >= rx_count)) {
+		rbuffer = msm_uport->rx.rbuffer;
+		msm_uport->rx.buffer = msm_uport->rx.spare_buffer;
+		msm_uport->rx.rbuffer = msm_uport->rx.spare_rbuffer;
+		msm_uport->rx.spare_buffer = buffer;
+		msm_uport->rx.spare_rbuffer = rbuffer;
+		msm_hs_start_rx_locked(uport);
+	}
+
 	if (0 != (uport->read_status_mask & CREAD)) {
-		retval = tty_insert_flip_string(tty, msm_uport->rx.buffer,
-						rx_count);
+		retval = tty_insert_flip_string(tty, buffer, rx_count);
 		if (retval != rx_count) {
 			msm_uport->rx.buffer_pending |= CHARS_NORMAL |
-				retval << 5 | (rx_count - retval) << 16;
+				retval << PENDING_OFFSET_SHIFT |
+				(rx_count - retval) << PENDING_COUNT_SHIFT;
 		}
 	}
 
 	/* order the read of rx.buffer and the start of next rx xfer */
 	wmb();
 
-	if (!msm_uport->rx.buffer_pending)
+	if (!msm_uport->rx.buffer_pending && buffer == msm_uport->rx.buffer)
 		msm_hs_start_rx_locked(uport);
 
 out:
@@ -1792,8 +1837,11 @@ static int uartdm_init_port(struct uart_port *uport)
 	tasklet_init(&tx->tlet, msm_serial_hs_tx_tlet,
 			(unsigned long) &tx->tlet);
 
+	rx->buf_size = clamp(roundup(hs_serial_rx_buf_size,
+				     MSM_UARTDM_BURST_SIZE),
+			     UARTDM_RX_BUF_MIN, UARTDM_RX_BUF_MAX);
 	rx->pool = dma_pool_create("rx_buffer_pool", uport->dev,
-				   UARTDM_RX_BUF_SIZE, 16, 0);
+				   rx->buf_size, 16, 0);
 	if (!rx->pool) {
 		pr_err("%s(): cannot allocate rx_buffer_pool", __func__);
 		ret = -ENOMEM;
@@ -1807,12 +1855,20 @@ static int uartdm_init_port(struct uart_port *uport)
 		goto free_pool;
 	}
 
+	rx->spare_buffer = dma_pool_alloc(rx->pool, GFP_KERNEL,
+					  &rx->spare_rbuffer);
+	if (!rx->spare_buffer) {
+		pr_err("%s(): cannot allocate rx->spare_buffer", __func__);
+		ret = -ENOMEM;
+		goto free_rx_buffer;
+	}
+
 	/* Allocate the command pointer. Needs to be 64 bit aligned */
 	rx->command_ptr = kmalloc(sizeof(dmov_box), GFP_KERNEL | __GFP_DMA);
 	if (!rx->command_ptr) {
 		pr_err("%s(): cannot allocate rx->command_ptr", __func__);
 		ret = -ENOMEM;
-		goto free_rx_buffer;
+		goto free_rx_spare_buffer;
 	}
 
 	rx->command_ptr_ptr = kmalloc(sizeof(u32), GFP_KERNEL | __GFP_DMA);
@@ -1822,8 +1878,8 @@ static int uartdm_init_port(struct uart_port *uport)
 		goto free_rx_command_ptr;
 	}
 
-	rx->command_ptr->num_rows = ((UARTDM_RX_BUF_SIZE >> 4) << 16) |
-					 (UARTDM_RX_BUF_SIZE >> 4);
+	rx->command_ptr->num_rows = ((rx->buf_size >> 4) << 16) |
+					 (rx->buf_size >> 4);
 
 	rx->command_ptr->dst_row_addr = rx->rbuffer;
 
@@ -1856,6 +1912,10 @@ static int uartdm_init_port(struct uart_port *uport)
 free_rx_command_ptr:
 	kfree(rx->command_ptr);
 
+free_rx_spare_buffer:
+	dma_pool_free(msm_uport->rx.pool, msm_uport->rx.spare_buffer,
+			msm_uport->rx.spare_rbuffer);
+
 free_rx_buffer:
 	dma_pool_free(msm_uport->rx.pool, msm_uport->rx.buffer,
 			msm_uport->rx.rbuffer);
@@ -144,7 +144,7 @@
  *
  *
  * Requirements are modest; only a bulk-in and a bulk-out endpoint are
- * needed.  The memory requirement amounts to two 16K buffers, size
+ * needed.  The memory requirement amounts to a number of 64K buffers
  * configurable by a parameter.  Support is included for both
  * full-speed and high-speed operation.
  *
@@ -163,7 +163,8 @@
  * files will simulate ejecting/loading the medium (writing an empty
  * line means eject) and adjusting a write-enable tab.  Changes to the
  * ro setting are not allowed when the medium is loaded or if CD-ROM
- * emulation is being used.
+ * emulation is being used.  Writing 1 to the "direct_io" attribute file
+ * makes block devices loaded from then on bypass the page cache.
  *
  * When a LUN receive an "eject" SCSI request (Start/Stop Unit),
  * if the LUN is removable, the backing file is released to simulate
@@ -308,6 +309,9 @@ static const char fsg_string_interface[] = "Mass Storage";
 #define FSG_NO_OTG               1
 #define FSG_NO_INTR_EP           1
 
+/* large buffers let a single vfs_read()/vfs_write() keep the eMMC busy */
+#define FSG_BUFLEN		((u32)65536)
+
 #include "storage_common.c"
 
 #ifdef CONFIG_USB_CSW_HACK
@@ -894,6 +898,9 @@ static int do_write(struct fsg_common *common)
 	unsigned int		amount;
 	ssize_t			nwritten;
 	int			rc;
+	struct fsg_buffhd	*next;
+	struct iovec		iov[FSG_MAX_NUM_BUFFERS];
+	int			niov;
 
 #ifdef CONFIG_USB_CSW_HACK
 	int			i;
@@ -1037,14 +1044,45 @@ static int do_write(struct fsg_common *common)
 			if (amount == 0)
 				goto empty_write;
 
+			/*
+			 * Coalesce the buffers received behind this one that
+			 * are complete and go right after it in the file, so
+			 * a thread that fell behind catches up with one write.
+			 */
+			iov[0].iov_base = bh->buf;
+			iov[0].iov_len = amount;
+			niov = 1;
+			while (niov < fsg_num_buffers &&
+			       amount == bh->bulk_out_intended_length) {
+				next = common->next_buffhd_to_drain;
+				if (next->state != BUF_STATE_FULL)
+					break;
+				smp_rmb();
+				if (next->outreq->status != 0 ||
+				    next->outreq->actual <
+						next->bulk_out_intended_length ||
+				    amount + next->bulk_out_intended_length >
+						amount_left_to_write ||
+				    curlun->file_length - file_offset <
+					amount + next->bulk_out_intended_length)
+					break;
+
+				common->next_buffhd_to_drain = next->next;
+				next->state = BUF_STATE_EMPTY;
+				bh = next;
+				iov[niov].iov_base = bh->buf;
+				iov[niov].iov_len = bh->bulk_out_intended_length;
+				amount += iov[niov++].iov_len;
+			}
+
 			/* Perform the write */
 			file_offset_tmp = file_offset;
 #ifdef CONFIG_USB_MSC_PROFILING
 			start = ktime_get();
 #endif
-			nwritten = vfs_write(curlun->filp,
-					     (char __user *)bh->buf,
-					     amount, &file_offset_tmp);
+			nwritten = vfs_writev(curlun->filp,
+					      (struct iovec __user *)iov,
+					      niov, &file_offset_tmp);
 			VLDBG(curlun, "file write %u @ %llu -> %d\n", amount,
 			      (unsigned long long)file_offset, (int)nwritten);
 #ifdef CONFIG_USB_MSC_PROFILING
@@ -2787,12 +2825,40 @@ static int fsg_main_thread(void *common_)
 }
 
 
+static ssize_t fsg_show_direct_io(struct device *dev,
+				  struct device_attribute *attr, char *buf)
+{
+	struct fsg_lun	*curlun = fsg_lun_from_dev(dev);
+
+	return sprintf(buf, "%u\n", curlun->direct_io);
+}
+
+/* takes effect when the next backing file is opened */
+static ssize_t fsg_store_direct_io(struct device *dev,
+				   struct device_attribute *attr,
+				   const char *buf, size_t count)
+{
+	struct fsg_lun	*curlun = fsg_lun_from_dev(dev);
+	unsigned	direct_io;
+	int		ret;
+
+	ret = kstrtouint(buf, 2, &direct_io);
+	if (ret)
+		return ret;
+
+	curlun->direct_io = direct_io;
+
+	return count;
+}
+
+
 /*************************** DEVICE ATTRIBUTES ***************************/
 
 /* Write permission is checked per LUN in store_*() functions. */
 static DEVICE_ATTR(ro, 0644, fsg_show_ro, fsg_store_ro);
 static DEVICE_ATTR(nofua, 0644, fsg_show_nofua, fsg_store_nofua);
 static DEVICE_ATTR(file, 0644, fsg_show_file, fsg_store_file);
+static DEVICE_ATTR(direct_io, 0644, fsg_show_direct_io, fsg_store_direct_io);
 #ifdef CONFIG_USB_MSC_PROFILING
 static DEVICE_ATTR(perf, 0644, fsg_show_perf, fsg_store_perf);
 #endif
@@ -2911,6 +2977,9 @@ static struct fsg_common *fsg_common_init(struct fsg_common *common,
 		rc = device_create_file(&curlun->dev, &dev_attr_nofua);
 		if (rc)
 			goto error_luns;
+		rc = device_create_file(&curlun->dev, &dev_attr_direct_io);
+		if (rc)
+			goto error_luns;
 #ifdef CONFIG_USB_MSC_PROFILING
 		rc = device_create_file(&curlun->dev, &dev_attr_perf);
 		if (rc)
@@ -3048,6 +3117,7 @@ static void fsg_common_release(struct kref *ref)
 #ifdef CONFIG_USB_MSC_PROFILING
 			device_remove_file(&lun->dev, &dev_attr_perf);
 #endif
+			device_remove_file(&lun->dev, &dev_attr_direct_io);
 			device_remove_file(&lun->dev, &dev_attr_nofua);
 			device_remove_file(&lun->dev, &dev_attr_ro);
 			device_remove_file(&lun->dev, &dev_attr_file);
@@ -67,6 +67,18 @@
  *   - MS-Windows drivers sometimes emit undocumented requests.
  */
 
+/*
+ * Number of packets put into one transfer to the host, if its
+ * MaxTransferSize has room for them.  One disables aggregation.
+ */
+static unsigned int rndis_dl_max_pkt_per_xfer = TX_SKB_HOLD_THRESHOLD;
+module_param(rndis_dl_max_pkt_per_xfer, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rndis_dl_max_pkt_per_xfer,
+	"max packets per transfer to the host");
+
+/* an ethernet frame behind a packet message header, as u_ether sends it */
+#define RNDIS_DL_PKT_SIZE	(ETH_FRAME_LEN + 44 + 22)
+
 struct f_rndis {
 	struct gether			port;
 	u8				ctrl_id, data_id;
@@ -461,12 +473,18 @@ static void rndis_command_complete(struct usb_ep *ep, struct usb_request *req)
 	buf = (rndis_init_msg_type *)req->buf;
 
 	if (buf->MessageType == REMOTE_NDIS_INITIALIZE_MSG) {
-		if (buf->MaxTransferSize > 2048)
-			rndis->port.multi_pkt_xfer = 1;
-		else
-			rndis->port.multi_pkt_xfer = 0;
+		u32 max_xfer = le32_to_cpu(buf->MaxTransferSize);
+		u32 pkts;
+
+		/* as many full sized packets as the host takes at once */
+		pkts = max_xfer / RNDIS_DL_PKT_SIZE;
+		pkts = min(pkts, rndis_dl_max_pkt_per_xfer);
+		rndis->port.multi_pkt_xfer = pkts > 1;
+		rndis->port.dl_max_pkts_per_xfer = pkts;
+		rndis->port.ul_max_pkts_per_xfer =
+			rndis_get_max_pkt_xfer(rndis->config);
 		DBG(cdev, "%s: MaxTransferSize: %d : Multi_pkt_txr: %s\n",
-				__func__, buf->MaxTransferSize,
+				__func__, max_xfer,
 				rndis->port.multi_pkt_xfer ? "enabled" :
 							    "disabled");
 	}
@@ -199,6 +199,7 @@ struct fsg_lun {
 	unsigned int	registered:1;
 	unsigned int	info_valid:1;
 	unsigned int	nofua:1;
+	unsigned int	direct_io:1;	/* open block devices with O_DIRECT */
 
 	u32		sense_data;
 	u32		sense_data_info;
@@ -232,8 +233,13 @@ static struct fsg_lun *fsg_lun_from_dev(struct device *dev)
 #define EP0_BUFSIZE	256
 #define DELAYED_STATUS	(EP0_BUFSIZE + 999)	/* An impossibly large value */
 
+/* limits of the number of pipeline buffers */
+#define FSG_MIN_NUM_BUFFERS	2
+#define FSG_MAX_NUM_BUFFERS	32
+
 #ifdef CONFIG_USB_CSW_HACK
-#define fsg_num_buffers		4
+#define fsg_num_buffers	\
+	max(4, CONFIG_USB_GADGET_STORAGE_NUM_BUFFERS)
 #else
 #ifdef CONFIG_USB_GADGET_DEBUG_FILES
 
@@ -255,15 +261,18 @@ MODULE_PARM_DESC(num_buffers, "Number of pipeline buffers");
 /* check if fsg_num_buffers is within a valid range */
 static inline int fsg_num_buffers_validate(void)
 {
-	if (fsg_num_buffers >= 2 && fsg_num_buffers <= 4)
+	if (fsg_num_buffers >= FSG_MIN_NUM_BUFFERS &&
+	    fsg_num_buffers <= FSG_MAX_NUM_BUFFERS)
 		return 0;
 	pr_err("fsg_num_buffers %u is out of range (%d to %d)\n",
-	       fsg_num_buffers, 2 ,4);
+	       fsg_num_buffers, FSG_MIN_NUM_BUFFERS, FSG_MAX_NUM_BUFFERS);
 	return -EINVAL;
 }
 
-/* Default size of buffer length. */
+/* Default size of buffer length, the including driver may override it. */
+#ifndef FSG_BUFLEN
 #define FSG_BUFLEN	((u32)16384)
+#endif
 
 /* Maximal number of LUNs supported in mass storage function */
 #define FSG_MAX_LUNS	8
@@ -722,6 +731,32 @@ static int fsg_lun_open(struct fsg_lun *curlun, const char *filename)
 		goto out;
 	}
 
+	/*
+	 * Bypass the page cache if asked to, as fcntl(F_SETFL) would.  Only
+	 * block devices are switched: the buffers and offsets are aligned
+	 * to their logical block size, but not necessarily to a file
+	 * system's block size.
+	 */
+	if (curlun->direct_io && S_ISBLK(inode->i_mode) &&
+	    filp->f_mapping->a_ops && filp->f_mapping->a_ops->direct_IO) {
+		spin_lock(&filp->f_lock);
+		filp->f_flags |= O_DIRECT;
+		spin_unlock(&filp->f_lock);
+	}
+
+	/*
+	 * Hosts read the medium front to back most of the time, so read
+	 * ahead as for POSIX_FADV_SEQUENTIAL, and at least enough to fill
+	 * all pipeline buffers.
+	 */
+	if (filp->f_mapping->backing_dev_info) {
+		spin_lock(&filp->f_lock);
+		filp->f_ra.ra_pages = max_t(unsigned long,
+			filp->f_mapping->backing_dev_info->ra_pages * 2,
+			fsg_num_buffers * FSG_BUFLEN / PAGE_SIZE);
+		spin_unlock(&filp->f_lock);
+	}
+
 	get_file(filp);
 	curlun->ro = ro;
 	curlun->filp = filp;
@@ -56,6 +56,10 @@ struct gether {
 /* Max number of SKB packets to be used to create Multi Packet RNDIS */
 #define TX_SKB_HOLD_THRESHOLD		3
 	bool				multi_pkt_xfer;
+	/* packets per transfer to the host, with multi_pkt_xfer set */
+	u32				dl_max_pkts_per_xfer;
+	/* packets per transfer the host may send, 0 or 1 for one */
+	u32				ul_max_pkts_per_xfer;
 	struct sk_buff			*(*wrap)(struct gether *port,
 						struct sk_buff *skb);
 	int				(*unwrap)(struct gether *port,
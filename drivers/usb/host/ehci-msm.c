@@ -34,12 +34,25 @@
 
 static struct usb_phy *phy;
 
+/*
+ * Interrupt threshold of the OTG host in log2 microframes (0 - 6).
+ * Transfers of any type that complete within one threshold window are
+ * reported, and their URBs given back, from a single interrupt. EHCI has
+ * one threshold per controller and it must not change while the schedule
+ * runs, so a new value takes effect when the host is started next.
+ */
+static int otg_log2_irq_thresh = 3;
+module_param(otg_log2_irq_thresh, int, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(otg_log2_irq_thresh,
+		 "OTG host log2 IRQ latency, 1-64 microframes");
+
 static int ehci_msm_reset(struct usb_hcd *hcd)
 {
 	struct ehci_hcd *ehci = hcd_to_ehci(hcd);
 	int retval;
 
 	ehci->caps = USB_CAPLENGTH;
+	ehci->log2_irq_thresh = clamp(otg_log2_irq_thresh, 0, 6);
 	hcd->has_tt = 1;
 
 	retval = ehci_setup(hcd);
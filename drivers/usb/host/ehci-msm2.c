@@ -737,8 +737,13 @@ static irqreturn_t msm_ehci_host_wakeup_irq(int irq, void *data)
 static int msm_ehci_reset(struct usb_hcd *hcd)
 {
 	struct ehci_hcd *ehci = hcd_to_ehci(hcd);
+	const struct msm_usb_host_platform_data *pdata;
 	int retval;
 
+	pdata = hcd->self.controller->platform_data;
+	if (pdata)
+		ehci->log2_irq_thresh = pdata->log2_irq_thresh;
+
 	ehci->caps = USB_CAPLENGTH;
 	ehci->regs = USB_CAPLENGTH +
 		HC_LENGTH(ehci, ehci_readl(ehci, &ehci->caps->hc_capbase));
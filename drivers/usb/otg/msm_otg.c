@@ -88,6 +88,18 @@ static struct regulator *vbus_otg;
 static struct regulator *mhl_usb_hs_switch;
 static struct power_supply *psy;
 
+/*
+ * Audio and video class accessories stream isochronous data in bursts.
+ * Such a device directly on the port gets a longer autosuspend delay, so
+ * that neither it nor the controller (which follows the root hub) drops
+ * into low power mode between bursts and pays for the wakeup on the next
+ * one. 0 leaves the usbcore default.
+ */
+static unsigned int isoc_autosuspend_ms = 10000;
+module_param(isoc_autosuspend_ms, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(isoc_autosuspend_ms,
+		 "autosuspend delay of isochronous devices in ms");
+
 static bool aca_id_turned_on;
 static inline bool aca_enabled(void)
 {
@@ -1187,6 +1199,31 @@ static void msm_otg_start_host(struct usb_otg *otg, int on)
 	}
 }
 
+static bool msm_otg_udev_has_isoc(struct usb_device *udev)
+{
+	struct usb_host_config *config = udev->actconfig;
+	struct usb_host_interface *alt;
+	struct usb_interface *intf;
+	int i, j, k;
+
+	if (!config)
+		return false;
+
+	for (i = 0; i < config->desc.bNumInterfaces; i++) {
+		intf = config->interface[i];
+		if (!intf)
+			continue;
+		for (j = 0; j < intf->num_altsetting; j++) {
+			alt = &intf->altsetting[j];
+			for (k = 0; k < alt->desc.bNumEndpoints; k++)
+				if (usb_endpoint_xfer_isoc(
+						&alt->endpoint[k].desc))
+					return true;
+		}
+	}
+	return false;
+}
+
 static int msm_otg_usbdev_notify(struct notifier_block *self,
 			unsigned long action, void *priv)
 {
@@ -1231,6 +1268,9 @@ static int msm_otg_usbdev_notify(struct notifier_block *self,
 			motg->mA_port = udev->actconfig->desc.bMaxPower * 2;
 		else
 			motg->mA_port = IUNIT;
+		if (isoc_autosuspend_ms && msm_otg_udev_has_isoc(udev))
+			pm_runtime_set_autosuspend_delay(&udev->dev,
+							 isoc_autosuspend_ms);
 		if (otg->phy->state == OTG_STATE_B_HOST)
 			msm_otg_del_timer(motg);
 		break;
@@ -1929,6 +1929,33 @@ static boolean check_edid_header(const uint8 *edid_buf)
 		&& (edid_buf[6] == 0xff) && (edid_buf[7] == 0x00);
 }
 
+/*
+ * Raw EDID blocks of the last sink.  Block 0 carries the manufacturer,
+ * product and serial number, so when it reads back unchanged on a
+ * re-plug the extension blocks are taken from here rather than over DDC.
+ */
+static struct {
+	uint8 data[5][0x80];
+	uint32 valid;
+} hdmi_edid_cache;
+
+static int hdmi_common_read_edid_ext(int block, uint8 *edid_buf)
+{
+	int status;
+
+	if (hdmi_edid_cache.valid & BIT(block)) {
+		memcpy(edid_buf, hdmi_edid_cache.data[block], 0x80);
+		return 0;
+	}
+
+	status = hdmi_common_read_edid_block(block, edid_buf);
+	if (!status) {
+		memcpy(hdmi_edid_cache.data[block], edid_buf, 0x80);
+		hdmi_edid_cache.valid |= BIT(block);
+	}
+	return status;
+}
+
 int hdmi_common_read_edid(void)
 {
 	int status = 0;
@@ -1964,8 +1991,16 @@ int hdmi_common_read_edid(void)
 			status,
 			edid_buf[0], edid_buf[1], edid_buf[2], edid_buf[3],
 			edid_buf[4], edid_buf[5], edid_buf[6], edid_buf[7]);
+		hdmi_edid_cache.valid = 0;
 		goto error;
 	}
+	if ((hdmi_edid_cache.valid & BIT(0)) &&
+	    !memcmp(hdmi_edid_cache.data[0], edid_buf, 0x80)) {
+		DEV_DBG("EDID: block(0) unchanged, using cached blocks\n");
+	} else {
+		memcpy(hdmi_edid_cache.data[0], edid_buf, 0x80);
+		hdmi_edid_cache.valid = BIT(0);
+	}
 	hdmi_edid_extract_vendor_id(edid_buf, vendor_id);
 
 	/* EDID_CEA_EXTENSION_FLAG[0x7E] - CEC extension byte */
@@ -1981,7 +2016,7 @@ int hdmi_common_read_edid(void)
 			external_common_state->hdmi_sink ? "no" : "yes");
 		break;
 	case 1: /* Read block 1 */
-		status = hdmi_common_read_edid_block(1, &edid_buf[0x80]);
+		status = hdmi_common_read_edid_ext(1, &edid_buf[0x80]);
 		if (status) {
 			DEV_ERR("%s: ddc read block(1) failed: %d\n", __func__,
 				status);
@@ -2009,7 +2044,7 @@ int hdmi_common_read_edid(void)
 	case 4:
 		for (i = 1; i <= num_og_cea_blocks; i++) {
 			if (!(i % 2)) {
-					status = hdmi_common_read_edid_block(i,
+					status = hdmi_common_read_edid_ext(i,
 								edid_buf+0x00);
 					if (status) {
 						DEV_ERR("%s: ddc read block(%d)"
@@ -2018,7 +2053,7 @@ int hdmi_common_read_edid(void)
 						goto error;
 					}
 			} else {
-				status = hdmi_common_read_edid_block(i,
+				status = hdmi_common_read_edid_ext(i,
 							edid_buf+0x80);
 				if (status) {
 					DEV_ERR("%s: ddc read block(%d)"
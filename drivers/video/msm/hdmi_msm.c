@@ -59,6 +59,11 @@ static int msm_hdmi_sample_rate = MSM_HDMI_SAMPLE_RATE_48KHZ;
 #define HDMI_DDC_CTRL		0x020C
 
 struct workqueue_struct *hdmi_work_queue;
+/*
+ * Hotplug has a queue of its own so that a connect or disconnect is not
+ * held up behind HDCP authentication, which sleeps for seconds.
+ */
+static struct workqueue_struct *hdmi_hpd_work_queue;
 struct hdmi_msm_state_type *hdmi_msm_state;
 
 DEFINE_MUTEX(hdmi_msm_state_mutex);
@@ -4226,7 +4231,7 @@ static void hdmi_msm_turn_on(void)
 
 static void hdmi_msm_hpd_state_timer(unsigned long data)
 {
-	queue_work(hdmi_work_queue, &hdmi_msm_state->hpd_state_work);
+	queue_work(hdmi_hpd_work_queue, &hdmi_msm_state->hpd_state_work);
 }
 
 #ifdef CONFIG_FB_MSM_HDMI_MSM_PANEL_HDCP_SUPPORT
@@ -4844,6 +4849,11 @@ static int __init hdmi_msm_init(void)
 	 * allocs and returns ptr
 	*/
 	hdmi_work_queue = create_workqueue("hdmi_hdcp");
+	hdmi_hpd_work_queue = create_singlethread_workqueue("hdmi_hpd");
+	if (!hdmi_work_queue || !hdmi_hpd_work_queue) {
+		rc = -ENOMEM;
+		goto init_exit;
+	}
 	external_common_state->hpd_feature = hdmi_msm_hpd_feature;
 
 	rc = platform_driver_register(&this_driver);
@@ -4896,6 +4906,12 @@ static int __init hdmi_msm_init(void)
 	return 0;
 
 init_exit:
+	if (hdmi_hpd_work_queue)
+		destroy_workqueue(hdmi_hpd_work_queue);
+	if (hdmi_work_queue)
+		destroy_workqueue(hdmi_work_queue);
+	hdmi_hpd_work_queue = NULL;
+	hdmi_work_queue = NULL;
 	kfree(hdmi_msm_state);
 	hdmi_msm_state = NULL;
 
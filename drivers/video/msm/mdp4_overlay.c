@@ -1578,6 +1578,26 @@ int mdp4_mixer_info(int mixer_num, struct mdp_mixer_info *info)
 	return cnt;
 }
 
+/*
+ * mdp4_mixer_stage_single: return the pipe if it is the only one
+ * staged on the mixer, NULL otherwise
+ */
+struct mdp4_overlay_pipe *mdp4_mixer_stage_single(int mixer)
+{
+	struct mdp4_overlay_pipe *pipe, *single = NULL;
+	int i;
+
+	for (i = MDP4_MIXER_STAGE_BASE; i < MDP4_MIXER_STAGE_MAX; i++) {
+		pipe = ctrl->stage[mixer][i];
+		if (pipe == NULL)
+			continue;
+		if (single)
+			return NULL;
+		single = pipe;
+	}
+	return single;
+}
+
 void mdp4_mixer_stage_commit(int mixer)
 {
 	struct mdp4_overlay_pipe *pipe;
@@ -2836,6 +2856,22 @@ void mdp4_overlay_mdp_perf_upd(struct msm_fb_data_type *mfd,
 	return;
 }
 
+/*
+ * mdp4_overlay_mdp_perf_drop:
+ * true if mdp4_overlay_mdp_perf_upd(mfd, 0) would lower the clock or
+ * bandwidth, which is only safe once the new frame is on the panel
+ */
+static int mdp4_overlay_mdp_perf_drop(struct msm_fb_data_type *mfd)
+{
+	struct mdp4_overlay_perf *perf_req = &perf_request;
+	struct mdp4_overlay_perf *perf_cur = &perf_current;
+
+	return perf_req->mdp_clk_rate < perf_cur->mdp_clk_rate ||
+		perf_req->mdp_bw > perf_cur->mdp_bw ||
+		(mfd->panel_info.pdest == DISPLAY_1 &&
+		 !perf_req->use_ov0_blt && perf_cur->use_ov0_blt);
+}
+
 static int get_img(struct msmfb_data *img, struct fb_info *info,
 	struct mdp4_overlay_pipe *pipe, unsigned int plane,
 	unsigned long *start, unsigned long *len, struct file **srcp_file,
@@ -3426,6 +3462,7 @@ int mdp4_overlay_commit(struct fb_info *info)
 {
 	struct msm_fb_data_type *mfd = (struct msm_fb_data_type *)info->par;
 	int mixer;
+	int queued = 0;
 
 	if (mfd == NULL)
 		return -ENODEV;
@@ -3449,8 +3486,15 @@ int mdp4_overlay_commit(struct fb_info *info)
 			/* cndx = 0 */
 			mdp4_dsi_cmd_pipe_commit(0, 1);
 		} else if (ctrl->panel_mode & MDP4_PANEL_DSI_VIDEO) {
-			/* cndx = 0 */
-			mdp4_dsi_video_pipe_commit(0, 1);
+			/*
+			 * cndx = 0, do not wait for the frame to be
+			 * latched unless the clocks go down after it,
+			 * its release fences are signalled at latch time
+			 */
+			if (mdp4_overlay_mdp_perf_drop(mfd))
+				mdp4_dsi_video_pipe_commit(0, 1);
+			else
+				queued = mdp4_dsi_video_pipe_commit_async(0);
 		} else if (ctrl->panel_mode & MDP4_PANEL_LCDC) {
 			/* cndx = 0 */
 			mdp4_lcdc_pipe_commit(0, 1);
@@ -3459,7 +3503,10 @@ int mdp4_overlay_commit(struct fb_info *info)
 		if (ctrl->panel_mode & MDP4_PANEL_DTV)
 			mdp4_dtv_pipe_commit(0, 1);
 	}
-	msm_fb_signal_timeline(mfd);
+	if (queued > 0)
+		msm_fb_queue_timeline(mfd);
+	else
+		msm_fb_signal_timeline(mfd);
 
 	mdp4_overlay_mdp_perf_upd(mfd, 0);
 
@@ -74,6 +74,8 @@ static struct vsycn_ctrl {
 	int new_update;
 	ktime_t vsync_time;
 	struct work_struct clk_work;
+	struct mdp_rect roi;	/* partial update window, w == 0 if none */
+	int roi_ndx;		/* pipe cropped to the window */
 } vsync_ctrl_db[MAX_CONTROLLER];
 
 static void vsync_irq_enable(int intr, int term)
@@ -250,6 +252,75 @@ void mdp4_dsi_cmd_pipe_queue(int cndx, struct mdp4_overlay_pipe *pipe)
 
 static void mdp4_dsi_cmd_blt_ov_update(struct mdp4_overlay_pipe *pipe);
 
+/*
+ * A frame made of a single unscaled rgb layer covering the whole panel
+ * can be sent for the dirty rectangle only: the layer, the overlay,
+ * dma_p and the dsi stream are shrunk to it and the panel is given the
+ * matching column and page window.  Anything else goes out full frame.
+ */
+static void mdp4_dsi_cmd_roi_update(struct vsycn_ctrl *vctrl, int mixer)
+{
+	struct msm_fb_data_type *mfd = vctrl->mfd;
+	struct mdp4_overlay_pipe *pipe, tmp;
+	struct mdp_rect roi;
+	char *overlay_base = MDP_BASE + MDP4_OVERLAYPROC0_BASE;
+	int xres, yres;
+
+	if (mfd == NULL)
+		return;
+	xres = mfd->panel_info.xres;
+	yres = mfd->panel_info.yres;
+
+	memset(&roi, 0, sizeof(roi));
+	pipe = mdp4_mixer_stage_single(mixer);
+	if (pipe && mfd->dirty_roi.w && !vctrl->base_pipe->ov_blt_addr &&
+	    pipe->pipe_type == OVERLAY_TYPE_RGB &&
+	    !(pipe->op_mode & (MDP4_OP_FLIP_LR | MDP4_OP_FLIP_UD)) &&
+	    pipe->src_w == pipe->dst_w && pipe->src_h == pipe->dst_h &&
+	    pipe->dst_x == 0 && pipe->dst_y == 0 &&
+	    pipe->dst_w == xres && pipe->dst_h == yres &&
+	    (mfd->dirty_roi.w < xres || mfd->dirty_roi.h < yres))
+		roi = mfd->dirty_roi;
+
+	if (roi.w == 0 && vctrl->roi.w == 0)
+		return;		/* full frame, nothing to restore */
+
+	if (roi.w) {
+		tmp = *pipe;
+		tmp.src_x += roi.x;
+		tmp.src_y += roi.y;
+		tmp.src_w = roi.w;
+		tmp.src_h = roi.h;
+		tmp.dst_w = roi.w;
+		tmp.dst_h = roi.h;
+		mdp4_overlay_rgb_setup(&tmp);
+		mdp4_overlay_reg_flush(&tmp, 1);
+		vctrl->roi_ndx = pipe->pipe_ndx;
+	} else {
+		/* undo the crop of the layer sent partially last time */
+		pipe = mdp4_overlay_ndx2pipe(vctrl->roi_ndx);
+		if (pipe && pipe->pipe_used) {
+			mdp4_overlay_rgb_setup(pipe);
+			mdp4_overlay_reg_flush(pipe, 1);
+		}
+		roi.w = xres;
+		roi.h = yres;
+	}
+
+	pr_debug("%s: x=%u y=%u w=%u h=%u\n", __func__,
+			roi.x, roi.y, roi.w, roi.h);
+
+	outpdw(overlay_base + 0x0008, (roi.h << 16) | roi.w); /* ROI */
+	MDP_OUTP(MDP_BASE + 0x90004, (roi.h << 16) | roi.w); /* dma_p src */
+	MDP_OUTP(MDP_BASE + 0x90010, 0);	/* dma_p dest */
+	mipi_dsi_cmd_window(roi.x, roi.y, roi.w, roi.h);
+
+	if (roi.w == xres && roi.h == yres)
+		memset(&vctrl->roi, 0, sizeof(vctrl->roi));
+	else
+		vctrl->roi = roi;
+}
+
 int mdp4_dsi_cmd_pipe_commit(int cndx, int wait)
 {
 	int  i, undx;
@@ -352,6 +423,8 @@ int mdp4_dsi_cmd_pipe_commit(int cndx, int wait)
 		}
 	}
 
+	mdp4_dsi_cmd_roi_update(vctrl, mixer);
+
 	/* tx dcs command if had any */
 	mipi_dsi_cmdlist_commit(1);
 
@@ -1009,6 +1082,8 @@ int mdp4_dsi_cmd_on(struct platform_device *pdev)
 	vctrl = &vsync_ctrl_db[cndx];
 	vctrl->mfd = mfd;
 	vctrl->dev = mfd->fbi->dev;
+	/* the panel and the stream start out full frame */
+	memset(&vctrl->roi, 0, sizeof(vctrl->roi));
 
 	mdp_clk_ctrl(1);
 	mdp4_overlay_update_dsi_cmd(mfd);
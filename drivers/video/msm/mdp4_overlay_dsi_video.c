@@ -68,6 +68,10 @@ static struct vsycn_ctrl {
 	struct vsync_update vlist[2];
 	int vsync_irq_enabled;
 	ktime_t vsync_time;
+	struct completion *koff_comp;	/* done when the kickoff is latched */
+	int koff_retire;		/* kickoff advances the fb timeline */
+	int retire_cnt;
+	struct work_struct retire_work;
 } vsync_ctrl_db[MAX_CONTROLLER];
 
 static void vsync_irq_enable(int intr, int term)
@@ -148,7 +152,60 @@ static void mdp4_dsi_video_blt_ov_update(struct mdp4_overlay_pipe *pipe);
 static void mdp4_dsi_video_wait4dmap(int cndx);
 static void mdp4_dsi_video_wait4ov(int cndx);
 
-int mdp4_dsi_video_pipe_commit(int cndx, int wait)
+/*
+ * mdp4_dsi_video_retire:
+ * the last kickoff made it to the panel, called with spin_lock held
+ */
+static void mdp4_dsi_video_retire(struct vsycn_ctrl *vctrl)
+{
+	vctrl->koff_comp = NULL;
+	if (vctrl->koff_retire) {
+		vctrl->koff_retire = 0;
+		vctrl->retire_cnt++;
+		schedule_work(&vctrl->retire_work);
+	}
+}
+
+static void mdp4_dsi_video_retire_work(struct work_struct *work)
+{
+	struct vsycn_ctrl *vctrl =
+		container_of(work, struct vsycn_ctrl, retire_work);
+	unsigned long flags;
+	int cnt;
+
+	spin_lock_irqsave(&vctrl->spin_lock, flags);
+	cnt = vctrl->retire_cnt;
+	vctrl->retire_cnt = 0;
+	spin_unlock_irqrestore(&vctrl->spin_lock, flags);
+
+	if (cnt)
+		msm_fb_retire_timeline(vctrl->mfd, cnt);
+}
+
+/*
+ * mdp4_dsi_video_wait4koff:
+ * wait until the previous kickoff has been latched, its registers
+ * and buffers can not be replaced before that
+ */
+static void mdp4_dsi_video_wait4koff(int cndx)
+{
+	struct vsycn_ctrl *vctrl;
+	struct completion *comp;
+	unsigned long flags;
+
+	vctrl = &vsync_ctrl_db[cndx];
+
+	spin_lock_irqsave(&vctrl->spin_lock, flags);
+	comp = vctrl->koff_comp;
+	spin_unlock_irqrestore(&vctrl->spin_lock, flags);
+
+	if (comp == NULL || atomic_read(&vctrl->suspend) > 0)
+		return;
+
+	wait_for_completion(comp);
+}
+
+static int mdp4_dsi_video_commit(int cndx, int wait, int async)
 {
 
 	int  i, undx;
@@ -183,6 +240,8 @@ int mdp4_dsi_video_pipe_commit(int cndx, int wait)
 	}
 	mutex_unlock(&vctrl->update_lock);
 
+	mdp4_dsi_video_wait4koff(cndx);
+
 	/* free previous committed iommu back to pool */
 	mdp4_overlay_iommu_unmap_freelist(mixer);
 
@@ -248,6 +307,9 @@ int mdp4_dsi_video_pipe_commit(int cndx, int wait)
 		INIT_COMPLETION(vctrl->dmap_comp);
 		vsync_irq_enable(INTR_DMA_P_DONE, MDP_DMAP_TERM);
 	}
+	vctrl->koff_comp = pipe->ov_blt_addr ? &vctrl->ov_comp :
+					       &vctrl->dmap_comp;
+	vctrl->koff_retire = async;
 	spin_unlock_irqrestore(&vctrl->spin_lock, flags);
 
 	mdp4_stat.overlay_commit[pipe->mixer_num]++;
@@ -262,6 +324,22 @@ int mdp4_dsi_video_pipe_commit(int cndx, int wait)
 	return cnt;
 }
 
+int mdp4_dsi_video_pipe_commit(int cndx, int wait)
+{
+	return mdp4_dsi_video_commit(cndx, wait, 0);
+}
+
+/*
+ * mdp4_dsi_video_pipe_commit_async:
+ * kick off the queued pipes without waiting for them to be latched.
+ * Returns the number of pipes committed; when non zero, the fb timeline
+ * is advanced by msm_fb_retire_timeline() once the frame is on the panel.
+ */
+int mdp4_dsi_video_pipe_commit_async(int cndx)
+{
+	return mdp4_dsi_video_commit(cndx, 0, 1);
+}
+
 void mdp4_dsi_video_vsync_ctrl(struct fb_info *info, int enable)
 {
 	struct vsycn_ctrl *vctrl;
@@ -438,6 +516,7 @@ void mdp4_dsi_vsync_init(int cndx, struct msm_fb_data_type *mfd)
 	init_completion(&vctrl->vsync_comp);
 	init_completion(&vctrl->dmap_comp);
 	init_completion(&vctrl->ov_comp);
+	INIT_WORK(&vctrl->retire_work, mdp4_dsi_video_retire_work);
 	atomic_set(&vctrl->suspend, 1);
 	atomic_set(&vctrl->vsync_resume, 1);
 	spin_lock_init(&vctrl->spin_lock);
@@ -722,6 +801,14 @@ int mdp4_dsi_video_off(struct platform_device *pdev)
 
 	MDP_OUTP(MDP_BASE + DSI_VIDEO_BASE, 0);
 
+	/* the last kickoff will not be latched any more, release it */
+	spin_lock_irqsave(&vctrl->spin_lock, flags);
+	if (vctrl->koff_comp) {
+		complete_all(vctrl->koff_comp);
+		mdp4_dsi_video_retire(vctrl);
+	}
+	spin_unlock_irqrestore(&vctrl->spin_lock, flags);
+
 	dsi_video_enabled = 0;
 
 	mdp_histogram_ctrl_all(FALSE);
@@ -927,6 +1014,7 @@ void mdp4_primary_vsync_dsi_video(void)
 	vctrl = &vsync_ctrl_db[cndx];
 	pr_debug("%s: cpu=%d\n", __func__, smp_processor_id());
 	vctrl->vsync_time = ktime_get();
+	msm_fb_vsync_notify(vctrl->vsync_time);
 
 	spin_lock(&vctrl->spin_lock);
 	if (vctrl->wait_vsync_cnt) {
@@ -977,6 +1065,8 @@ void mdp4_dmap_done_dsi_video(int cndx)
 	}
 
 	complete_all(&vctrl->dmap_comp);
+	if (vctrl->koff_comp == &vctrl->dmap_comp)
+		mdp4_dsi_video_retire(vctrl);
 	mdp4_overlay_dma_commit(cndx);
 	spin_unlock(&vctrl->spin_lock);
 }
@@ -996,6 +1086,8 @@ void mdp4_overlay0_done_dsi_video(int cndx)
 	vsync_irq_disable(INTR_OVERLAY0_DONE, MDP_OVERLAY0_TERM);
 	vctrl->ov_done++;
 	complete_all(&vctrl->ov_comp);
+	if (vctrl->koff_comp == &vctrl->ov_comp)
+		mdp4_dsi_video_retire(vctrl);
 
 	if (pipe == NULL) {
 		spin_unlock(&vctrl->spin_lock);
@@ -802,6 +802,7 @@ void mdp4_primary_vsync_lcdc(void)
 	vctrl = &vsync_ctrl_db[cndx];
 	pr_debug("%s: cpu=%d\n", __func__, smp_processor_id());
 	vctrl->vsync_time = ktime_get();
+	msm_fb_vsync_notify(vctrl->vsync_time);
 
 	spin_lock(&vctrl->spin_lock);
 	if (vctrl->wait_vsync_cnt) {
@@ -48,6 +48,14 @@ enum {
 static struct mdp4_overlay_pipe *writeback_pipe;
 static struct msm_fb_data_type *writeback_mfd;
 static int busy_wait_cnt;
+/* buffer the MDP is writing into, cleared by the overlay done irq */
+static struct msmfb_writeback_data_list *writeback_inflight;
+
+static int writeback_iommu_domain(void)
+{
+	return mdp_iommu_split_domain ? DISPLAY_WRITE_DOMAIN :
+		DISPLAY_READ_DOMAIN;
+}
 
 int mdp4_overlay_writeback_on(struct platform_device *pdev)
 {
@@ -219,6 +227,7 @@ void mdp4_overlay1_done_writeback(struct mdp_dma_data *dma)
 {
 	spin_lock(&mdp_spin_lock);
 	dma->busy = FALSE;
+	writeback_inflight = NULL;
 	if (busy_wait_cnt)
 		busy_wait_cnt = 0;
 	mdp_disable_irq_nosync(MDP_OVERLAY2_TERM);
@@ -227,6 +236,26 @@ void mdp4_overlay1_done_writeback(struct mdp_dma_data *dma)
 	pr_debug("%s ovdone interrupt\n", __func__);
 
 }
+static void mdp4_writeback_set_inflight(struct msmfb_writeback_data_list *node)
+{
+	unsigned long flag;
+
+	spin_lock_irqsave(&mdp_spin_lock, flag);
+	writeback_inflight = node;
+	spin_unlock_irqrestore(&mdp_spin_lock, flag);
+}
+
+static bool mdp4_writeback_is_inflight(struct msmfb_writeback_data_list *node)
+{
+	unsigned long flag;
+	bool ret;
+
+	spin_lock_irqsave(&mdp_spin_lock, flag);
+	ret = writeback_inflight == node;
+	spin_unlock_irqrestore(&mdp_spin_lock, flag);
+	return ret;
+}
+
 void mdp4_writeback_overlay_kickoff(struct msm_fb_data_type *mfd,
 				    struct mdp4_overlay_pipe *pipe)
 {
@@ -292,12 +321,13 @@ void mdp4_writeback_kickoff_video(struct msm_fb_data_type *mfd,
 
 	mdp4_mixer_stage_commit(pipe->mixer_num);
 
+	mdp4_writeback_set_inflight(node);
 	mdp4_writeback_overlay_kickoff(mfd, pipe);
 
 	mutex_lock(&mfd->writeback_mutex);
 	list_add_tail(&node->active_entry, &mfd->writeback_busy_queue);
-	mutex_unlock(&mfd->writeback_mutex);
 	mfd->writeback_active_cnt--;
+	mutex_unlock(&mfd->writeback_mutex);
 	mutex_unlock(&mfd->unregister_mutex);
 	wake_up(&mfd->wait_q);
 }
@@ -359,6 +389,7 @@ void mdp4_writeback_overlay(struct msm_fb_data_type *mfd)
 
 		pr_debug("%s: in writeback pan display 0x%x\n", __func__,
 				(unsigned int)writeback_pipe->ov_blt_addr);
+		mdp4_writeback_set_inflight(node);
 		mdp4_writeback_kickoff_ui(mfd, writeback_pipe);
 		mdp4_iommu_unmap(writeback_pipe);
 
@@ -396,20 +427,39 @@ static struct msmfb_writeback_data_list *get_if_registered(
 			struct msm_fb_data_type *mfd, struct msmfb_data *data)
 {
 	struct msmfb_writeback_data_list *temp;
+	struct ion_handle *srcp_ihdl = NULL;
 	bool found = false;
-	int domain;
+
+	/*
+	 * An ION buffer is known by its handle, which importing the same
+	 * buffer again returns, so its IOMMU mapping is made once and kept
+	 * while the buffer cycles through the queues.
+	 */
+	if (!data->iova && mfd->iclient) {
+		srcp_ihdl = ion_import_dma_buf(mfd->iclient, data->memory_id);
+		if (IS_ERR_OR_NULL(srcp_ihdl)) {
+			pr_err("%s: ion import fd failed\n", __func__);
+			return NULL;
+		}
+	}
 
 	if (!list_empty(&mfd->writeback_register_queue)) {
 		list_for_each_entry(temp,
 				&mfd->writeback_register_queue,
 				registered_entry) {
-			if (temp && temp->buf_info.iova == data->iova) {
+			if (srcp_ihdl ? temp->ihdl == srcp_ihdl &&
+				temp->buf_info.offset == data->offset :
+				temp->buf_info.iova == data->iova) {
 				found = true;
 				break;
 			}
 		}
 	}
-	if (!found) {
+	if (found) {
+		/* drop the reference the import above took */
+		if (srcp_ihdl)
+			ion_free(mfd->iclient, srcp_ihdl);
+	} else {
 		temp = kzalloc(sizeof(struct msmfb_writeback_data_list),
 				GFP_KERNEL);
 		if (temp == NULL) {
@@ -419,24 +469,12 @@ static struct msmfb_writeback_data_list *get_if_registered(
 		temp->ihdl = NULL;
 		if (data->iova)
 			temp->addr = (void *)(data->iova + data->offset);
-		else if (mfd->iclient) {
-			struct ion_handle *srcp_ihdl;
+		else if (srcp_ihdl) {
 			ulong len;
-			srcp_ihdl = ion_import_dma_buf(mfd->iclient,
-						  data->memory_id);
-			if (IS_ERR_OR_NULL(srcp_ihdl)) {
-				pr_err("%s: ion import fd failed\n", __func__);
-				goto register_ion_fail;
-			}
-
-			if (mdp_iommu_split_domain)
-				domain = DISPLAY_WRITE_DOMAIN;
-			else
-				domain = DISPLAY_READ_DOMAIN;
 
 			if (ion_map_iommu(mfd->iclient,
 					  srcp_ihdl,
-					  domain,
+					  writeback_iommu_domain(),
 					  GEN_POOL,
 					  SZ_4K,
 					  0,
@@ -444,7 +482,6 @@ static struct msmfb_writeback_data_list *get_if_registered(
 					  (ulong *)&len,
 					  0,
 					  ION_IOMMU_UNMAP_DELAYED)) {
-				ion_free(mfd->iclient, srcp_ihdl);
 				pr_err("%s: unable to get ion mapping addr\n",
 				       __func__);
 				goto register_ion_fail;
@@ -467,6 +504,8 @@ static struct msmfb_writeback_data_list *get_if_registered(
  register_ion_fail:
 	kfree(temp);
  register_alloc_fail:
+	if (srcp_ihdl)
+		ion_free(mfd->iclient, srcp_ihdl);
 	return NULL;
 }
 int mdp4_writeback_start(
@@ -515,7 +554,7 @@ int mdp4_writeback_dequeue_buffer(struct fb_info *info, struct msmfb_data *data)
 {
 	struct msm_fb_data_type *mfd = (struct msm_fb_data_type *)info->par;
 	struct msmfb_writeback_data_list *node = NULL;
-	int rc = 0, domain;
+	int rc = 0;
 
 	rc = wait_event_interruptible(mfd->wait_q, is_buffer_ready(mfd));
 	if (rc) {
@@ -535,25 +574,19 @@ int mdp4_writeback_dequeue_buffer(struct fb_info *info, struct msmfb_data *data)
 		list_del(&node->active_entry);
 		node->state = WITH_CLIENT;
 		memcpy(data, &node->buf_info, sizeof(struct msmfb_data));
-		if (!data->iova)
-			if (mfd->iclient && node->ihdl) {
-				if (mdp_iommu_split_domain)
-					domain = DISPLAY_WRITE_DOMAIN;
-				else
-					domain = DISPLAY_READ_DOMAIN;
-
-				ion_unmap_iommu(mfd->iclient,
-						node->ihdl,
-						domain,
-						GEN_POOL);
-				ion_free(mfd->iclient,
-					 node->ihdl);
-			}
 	} else {
 		pr_err("node is NULL. Somebody else dequeued?\n");
 		rc = -ENOBUFS;
 	}
 	mutex_unlock(&mfd->writeback_mutex);
+
+	/*
+	 * Buffers are queued for the client when their writeback is
+	 * kicked off; the one still being written is only handed over
+	 * once the overlay done interrupt says it is complete.
+	 */
+	if (node && mdp4_writeback_is_inflight(node))
+		mdp4_writeback_dma_busy_wait(mfd);
 	return rc;
 }
 
@@ -616,6 +649,12 @@ int mdp4_writeback_terminate(struct fb_info *info)
 					struct msmfb_writeback_data_list,
 					registered_entry);
 			list_del(&temp->registered_entry);
+			if (mfd->iclient && temp->ihdl) {
+				ion_unmap_iommu(mfd->iclient, temp->ihdl,
+						writeback_iommu_domain(),
+						GEN_POOL);
+				ion_free(mfd->iclient, temp->ihdl);
+			}
 			kfree(temp);
 		}
 	}
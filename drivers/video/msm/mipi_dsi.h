@@ -189,6 +189,8 @@ struct dsi_clk_desc {
 #define DSI_HDR_WC(wc)		((wc) & 0x0ffff)
 
 #define DSI_BUF_SIZE	64
+/* tx buffer for panels whose init sequence is sent in a few DMAs */
+#define DSI_BATCH_BUF_SIZE	1024
 #define MIPI_DSI_MRPS	0x04	/* Maximum Return Packet Size */
 
 #define MIPI_DSI_LEN 8 /* 4 x 4 - 6 - 2, bytes dcs header+crc-align  */
@@ -345,6 +347,7 @@ int mipi_dsi_cmdlist_put(struct dcs_cmd_req *cmdreq);
 struct dcs_cmd_req *mipi_dsi_cmdlist_get(void);
 void mipi_dsi_cmdlist_commit(int from_mdp);
 void mipi_dsi_cmd_mdp_busy(void);
+void mipi_dsi_cmd_window(int x, int y, int w, int h);
 
 #ifdef CONFIG_FB_MSM_MDP303
 void update_lane_config(struct msm_panel_info *pinfo);
@@ -1131,6 +1131,62 @@ int mipi_dsi_cmd_reg_tx(uint32 data)
 	return 4;
 }
 
+/* bytes @cm takes in the command DMA buffer */
+static int mipi_dsi_cmd_dma_len(struct dsi_cmd_desc *cm)
+{
+	if (cm->dtype == DTYPE_GEN_LWRITE || cm->dtype == DTYPE_DCS_LWRITE)
+		return DSI_HOST_HDR_SIZE + ((cm->dlen + 3) & ~0x03);
+	return DSI_HOST_HDR_SIZE;
+}
+
+/*
+ * Put @cm behind the packets already in @tp.  The packet builders work
+ * from tp->data, so it is moved past the queued packets and back.
+ */
+static void mipi_dsi_cmd_dma_append(struct dsi_buf *tp,
+				    struct dsi_cmd_desc *cm, int last)
+{
+	struct dsi_cmd_desc desc = *cm;
+	char *start = tp->data;
+	int len = tp->len;
+
+	desc.last = last;
+	tp->data += len;
+	tp->len = 0;
+	mipi_dsi_cmd_dma_add(tp, &desc);
+	tp->data = start;
+	tp->len += len;
+}
+
+/*
+ * In command mode the link is ours, so commands are sent as many packets
+ * per DMA as fit in the buffer, with DSI_HDR_LAST on the final one only.
+ * A command that has to be followed by a delay ends the batch.
+ */
+static void mipi_dsi_cmds_tx_batched(struct dsi_buf *tp,
+				     struct dsi_cmd_desc *cmds, int cnt)
+{
+	struct dsi_cmd_desc *cm = cmds;
+	int i, room, last;
+
+	mipi_dsi_buf_init(tp);
+	room = tp->end - tp->data;
+	for (i = 0; i < cnt; i++, cm++) {
+		last = cm->wait || i == cnt - 1 ||
+			tp->len + mipi_dsi_cmd_dma_len(cm) +
+			mipi_dsi_cmd_dma_len(cm + 1) > room;
+		mipi_dsi_cmd_dma_append(tp, cm, last);
+		if (!last)
+			continue;
+
+		mipi_dsi_enable_irq(DSI_CMD_TERM);
+		mipi_dsi_cmd_dma_tx(tp);
+		if (cm->wait)
+			msleep(cm->wait);
+		mipi_dsi_buf_init(tp);
+	}
+}
+
 /*
  * mipi_dsi_cmds_tx:
  * thread context only
@@ -1160,14 +1216,18 @@ int mipi_dsi_cmds_tx(struct dsi_buf *tp, struct dsi_cmd_desc *cmds, int cnt)
 
 	cm = cmds;
 	mipi_dsi_buf_init(tp);
-	for (i = 0; i < cnt; i++) {
-		mipi_dsi_enable_irq(DSI_CMD_TERM);
-		mipi_dsi_buf_init(tp);
-		mipi_dsi_cmd_dma_add(tp, cm);
-		mipi_dsi_cmd_dma_tx(tp);
-		if (cm->wait)
-			msleep(cm->wait);
-		cm++;
+	if (!video_mode) {
+		mipi_dsi_cmds_tx_batched(tp, cmds, cnt);
+	} else {
+		for (i = 0; i < cnt; i++) {
+			mipi_dsi_enable_irq(DSI_CMD_TERM);
+			mipi_dsi_buf_init(tp);
+			mipi_dsi_cmd_dma_add(tp, cm);
+			mipi_dsi_cmd_dma_tx(tp);
+			if (cm->wait)
+				msleep(cm->wait);
+			cm++;
+		}
 	}
 
 	if (video_mode)
@@ -1619,6 +1679,56 @@ void mipi_dsi_cmdlist_commit(int from_mdp)
 	mutex_unlock(&cmd_mutex);
 }
 
+/*
+ * mipi_dsi_cmd_window: restrict the following command mode frames to
+ * the window at x, y of w * h pixels.  The stream is resized to the
+ * window and the panel gets the column and page address for it.  Must
+ * be called while no frame is being transferred.
+ */
+void mipi_dsi_cmd_window(int x, int y, int w, int h)
+{
+	char col[5], page[5];
+	struct dsi_cmd_desc cmds[] = {
+		{DTYPE_DCS_LWRITE, 0, 0, 0, 0, sizeof(col), col},
+		{DTYPE_DCS_LWRITE, 1, 0, 0, 0, sizeof(page), page},
+	};
+	u32 ctrl, total, bpp;
+
+	col[0] = 0x2a;	/* set_column_address */
+	col[1] = x >> 8;
+	col[2] = x & 0xff;
+	col[3] = (x + w - 1) >> 8;
+	col[4] = (x + w - 1) & 0xff;
+	page[0] = 0x2b;	/* set_page_address */
+	page[1] = y >> 8;
+	page[2] = y & 0xff;
+	page[3] = (y + h - 1) >> 8;
+	page[4] = (y + h - 1) & 0xff;
+
+	mutex_lock(&cmd_mutex);
+	mipi_dsi_clk_cfg(1);
+
+	/* keep the pixel size and virtual channel of the stream */
+	ctrl = MIPI_INP(MIPI_DSI_BASE + 0x5c);
+	total = MIPI_INP(MIPI_DSI_BASE + 0x60);
+	bpp = ((ctrl >> 16) - 1) / (total & 0xffff);
+	ctrl = ((w * bpp + 1) << 16) | (ctrl & 0xffff);
+	total = (h << 16) | w;
+	/* DSI_COMMAND_MODE_MDP_STREAM_CTRL */
+	MIPI_OUTP(MIPI_DSI_BASE + 0x5c, ctrl);
+	MIPI_OUTP(MIPI_DSI_BASE + 0x54, ctrl);
+	/* DSI_COMMAND_MODE_MDP_STREAM_TOTAL */
+	MIPI_OUTP(MIPI_DSI_BASE + 0x60, total);
+	MIPI_OUTP(MIPI_DSI_BASE + 0x58, total);
+	wmb();
+
+	mipi_dsi_buf_init(&dsi_tx_buf);
+	mipi_dsi_cmds_tx(&dsi_tx_buf, cmds, ARRAY_SIZE(cmds));
+
+	mipi_dsi_clk_cfg(0);
+	mutex_unlock(&cmd_mutex);
+}
+
 int mipi_dsi_cmdlist_put(struct dcs_cmd_req *cmdreq)
 {
 	struct dcs_cmd_req *req;
@@ -20,6 +20,8 @@
 #include <linux/string.h>
 #include <linux/gpio.h>
 #include <linux/syscore_ops.h>
+#include <linux/jiffies.h>
+#include <linux/workqueue.h>
 
 #include "msm_fb.h"
 #include "mipi_dsi.h"
@@ -32,6 +34,18 @@ static struct dsi_buf lgit_tx_buf;
 static struct dsi_buf lgit_rx_buf;
 static int skip_init;
 
+/*
+ * Brightness ramps come in faster than the panel refreshes.  A level is
+ * written right away if the last write was at least a frame ago, else
+ * only the latest one is written a frame after the previous write.
+ */
+#define LGIT_BL_FRAME_MS	16
+static DEFINE_MUTEX(lgit_bl_lock);
+static int lgit_bl_level;
+static unsigned long lgit_bl_written;
+static void lgit_bl_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(lgit_bl_work, lgit_bl_work_fn);
+
 #ifdef CONFIG_GAMMA_CONTROL
 static DEFINE_MUTEX(color_lock);
 struct dsi_cmd_desc new_color_vals[33];
@@ -44,6 +58,14 @@ int get_saturation(void);
 int get_greys(void);
 #endif
 
+/*
+ * Gamma changes are sent to the panel a frame after the first one of a
+ * burst, so that setting several values costs a single transmission
+ * and the writer does not wait for it.
+ */
+static void lgit_color_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(lgit_color_work, lgit_color_work_fn);
+
 #define DSV_ONBST 57
 
 static int lgit_external_dsv_onoff(uint8_t on_off)
@@ -142,6 +164,9 @@ static int mipi_lgit_lcd_off(struct platform_device *pdev)
 
 	pr_info("%s started\n", __func__);
 
+	cancel_delayed_work_sync(&lgit_bl_work);
+	/* power on sends the current gamma anyway */
+	cancel_delayed_work_sync(&lgit_color_work);
 	if (mipi_lgit_pdata->bl_pwm_disable)
 		mipi_lgit_pdata->bl_pwm_disable();
 
@@ -219,12 +244,35 @@ static int mipi_lgit_backlight_on_status(void)
 	return (mipi_lgit_pdata->bl_on_status());
 }
 
-static void mipi_lgit_set_backlight_board(struct msm_fb_data_type *mfd)
+static void lgit_bl_write(void)
 {
-	int level;
+	mipi_lgit_pdata->backlight_level(lgit_bl_level, 0, 0);
+	lgit_bl_written = jiffies;
+}
+
+static void lgit_bl_work_fn(struct work_struct *work)
+{
+	mutex_lock(&lgit_bl_lock);
+	lgit_bl_write();
+	mutex_unlock(&lgit_bl_lock);
+}
 
-	level = (int)mfd->bl_level;
-	mipi_lgit_pdata->backlight_level(level, 0, 0);
+static void mipi_lgit_set_backlight_board(struct msm_fb_data_type *mfd)
+{
+	unsigned long next;
+
+	mutex_lock(&lgit_bl_lock);
+	lgit_bl_level = (int)mfd->bl_level;
+	next = lgit_bl_written + msecs_to_jiffies(LGIT_BL_FRAME_MS);
+	/* turning the backlight off is never delayed */
+	if (!lgit_bl_level ||
+	    !time_in_range(jiffies, lgit_bl_written, next)) {
+		cancel_delayed_work(&lgit_bl_work);
+		lgit_bl_write();
+	} else if (!delayed_work_pending(&lgit_bl_work)) {
+		schedule_delayed_work(&lgit_bl_work, next - jiffies);
+	}
+	mutex_unlock(&lgit_bl_lock);
 }
 
 /******************* begin faux123 sysfs interface *******************/
@@ -569,23 +617,36 @@ static ssize_t kgamma_blue_show(struct device *dev, struct device_attribute *att
 		kgamma[8], kgamma[9]);
 }
 
+static void lgit_color_work_fn(struct work_struct *work)
+{
+	int ret;
+
+	mutex_lock(&color_lock);
+	MIPI_OUTP(MIPI_DSI_BASE + 0x38, 0x10000000);
+	ret = mipi_dsi_cmds_tx(&lgit_tx_buf,
+			new_color_vals,
+			mipi_lgit_pdata->power_on_set_size_1);
+	MIPI_OUTP(MIPI_DSI_BASE + 0x38, 0x14000000);
+	mutex_unlock(&color_lock);
+	if (ret < 0)
+		pr_err("%s: failed to transmit power_on_set_1 cmds\n", __func__);
+}
+
+static void lgit_color_update(void)
+{
+	/* a pending update will send this change too */
+	schedule_delayed_work(&lgit_color_work,
+			      msecs_to_jiffies(LGIT_BL_FRAME_MS));
+}
+
 void refresh_screen_go (struct device *dev, struct device_attribute *attr,
 		char *buf) {
 
 	unsigned int i = 0;
-	int ret = 0;
 
 	sscanf(buf, "%i", &i);
-	if (i == 1) {
-		msleep(20);
-		MIPI_OUTP(MIPI_DSI_BASE + 0x38, 0x10000000);
-		ret = mipi_dsi_cmds_tx(&lgit_tx_buf,
-				new_color_vals,
-					mipi_lgit_pdata->power_on_set_size_1);
-			MIPI_OUTP(MIPI_DSI_BASE + 0x38, 0x14000000);
-			if (ret < 0)
-				pr_err("%s: failed to transmit power_on_set_1 cmds\n", __func__);
-	}
+	if (i == 1)
+		lgit_color_update();
 }
 
 static ssize_t refresh_screen_show(struct device *dev, struct device_attribute *attr,
@@ -606,7 +667,6 @@ static DEVICE_ATTR(refresh_screen, 0644, refresh_screen_show, refresh_screen_go)
 void update_vals(int array_pos)
 {
 	int val = 0;
-	int ret = 0;
 	int i;
 
 	switch(array_pos) {
@@ -636,21 +696,14 @@ void update_vals(int array_pos)
 			return;
 	}
 	
-	for (i = 5; i <= 10; i++)
-		new_color_vals[i].payload[array_pos] = val;
-
 	pr_info("%s - Updating display GAMMA settings.\n", __FUNCTION__);
-	
+
 	mutex_lock(&color_lock);
-	msleep(20);
-	MIPI_OUTP(MIPI_DSI_BASE + 0x38, 0x10000000);
-	ret = mipi_dsi_cmds_tx(&lgit_tx_buf,
-			new_color_vals,
-			mipi_lgit_pdata->power_on_set_size_1);
-	MIPI_OUTP(MIPI_DSI_BASE + 0x38, 0x14000000);
-	if (ret < 0)
-		pr_err("%s: failed to transmit power_on_set_1 cmds\n", __func__);
+	for (i = 5; i <= 10; i++)
+		new_color_vals[i].payload[array_pos] = val;
 	mutex_unlock(&color_lock);
+
+	lgit_color_update();
 }
 
 EXPORT_SYMBOL(update_vals);
@@ -767,7 +820,7 @@ err_device_put:
 
 static int __init mipi_lgit_lcd_init(void)
 {
-	mipi_dsi_buf_alloc(&lgit_tx_buf, DSI_BUF_SIZE);
+	mipi_dsi_buf_alloc(&lgit_tx_buf, DSI_BATCH_BUF_SIZE);
 	mipi_dsi_buf_alloc(&lgit_rx_buf, DSI_BUF_SIZE);
 
 	return platform_driver_register(&this_driver);
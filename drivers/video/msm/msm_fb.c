@@ -44,6 +44,9 @@
 #include <linux/sync.h>
 #include <linux/sw_sync.h>
 #include <linux/file.h>
+#include <linux/notifier.h>
+#include <linux/eventfd.h>
+#include <linux/math64.h>
 
 #define MSM_FB_C
 #include "msm_fb.h"
@@ -115,6 +118,9 @@ static int mdp_bl_scale_config(struct msm_fb_data_type *mfd,
 static void msm_fb_scale_bl(__u32 *bl_lvl);
 static void msm_fb_commit_wq_handler(struct work_struct *work);
 static int msm_fb_pan_idle(struct msm_fb_data_type *mfd);
+static void msm_fb_vsync_timing(struct msmfb_vsync_timing *timing);
+static int msm_fb_vsync_eventfd(struct fb_info *info, int fd);
+static void msm_fb_vsync_release(struct fb_info *info);
 
 #ifdef CONFIG_LGE_DISP_FBREAD
 static ssize_t msm_fb_read(struct fb_info *info, char __user *buf,
@@ -1766,6 +1772,8 @@ static int msm_fb_release(struct fb_info *info, int user)
 	}
 	msm_fb_pan_idle(mfd);
 	mfd->ref_cnt--;
+	if (!mfd->ref_cnt)
+		msm_fb_vsync_release(info);
 
 	if ((!mfd->ref_cnt) && (mfd->op_enable)) {
 		if ((ret =
@@ -1809,6 +1817,29 @@ int msm_fb_signal_timeline(struct msm_fb_data_type *mfd)
 	return 0;
 }
 
+/*
+ * A frame has been kicked off but is not on the panel yet.  Fences
+ * created from now on already count it, the timeline itself only
+ * advances in msm_fb_retire_timeline() once the frame is latched.
+ */
+void msm_fb_queue_timeline(struct msm_fb_data_type *mfd)
+{
+	mutex_lock(&mfd->sync_mutex);
+	if (mfd->timeline)
+		mfd->timeline_value++;
+	mfd->last_rel_fence = mfd->cur_rel_fence;
+	mfd->cur_rel_fence = 0;
+	mutex_unlock(&mfd->sync_mutex);
+}
+
+void msm_fb_retire_timeline(struct msm_fb_data_type *mfd, int count)
+{
+	mutex_lock(&mfd->sync_mutex);
+	if (mfd->timeline)
+		sw_sync_timeline_inc(mfd->timeline, count);
+	mutex_unlock(&mfd->sync_mutex);
+}
+
 DEFINE_SEMAPHORE(msm_fb_pan_sem);
 static int msm_fb_pan_idle(struct msm_fb_data_type *mfd)
 {
@@ -2025,6 +2056,34 @@ static int msm_fb_pan_display_sub(struct fb_var_screeninfo *var,
 	return 0;
 }
 
+/*
+ * Overlay commits may carry the "UPDT" dirty rectangle of the pan
+ * display path, panels that can be updated partially use it.
+ */
+static void msm_fb_commit_dirty_roi(struct msm_fb_data_type *mfd,
+	struct fb_var_screeninfo *var)
+{
+	struct mdp_rect *roi = &mfd->dirty_roi;
+	u32 x, y, x2, y2;
+
+	memset(roi, 0, sizeof(*roi));
+	if (var->reserved[0] != 0x54445055)
+		return;
+
+	x = var->reserved[1] & 0xffff;
+	y = (var->reserved[1] >> 16) & 0xffff;
+	x2 = var->reserved[2] & 0xffff;
+	y2 = (var->reserved[2] >> 16) & 0xffff;
+	if (x2 <= x || y2 <= y || x2 > mfd->panel_info.xres ||
+	    y2 > mfd->panel_info.yres)
+		return;
+
+	roi->x = x;
+	roi->y = y;
+	roi->w = x2 - x;
+	roi->h = y2 - y;
+}
+
 static void msm_fb_commit_wq_handler(struct work_struct *work)
 {
 	struct msm_fb_data_type *mfd;
@@ -2037,6 +2096,8 @@ static void msm_fb_commit_wq_handler(struct work_struct *work)
 	info = &fb_backup->info;
 	if (fb_backup->disp_commit.flags &
 		MDP_DISPLAY_COMMIT_OVERLAY) {
+			msm_fb_commit_dirty_roi(mfd,
+				&fb_backup->disp_commit.var);
 			mdp4_overlay_commit(info);
 	} else {
 		var = &fb_backup->disp_commit.var;
@@ -3753,8 +3814,13 @@ static int msm_fb_ioctl(struct fb_info *info, unsigned int cmd,
 	struct mdp_page_protection fb_page_protection;
 	struct msmfb_mdp_pp mdp_pp;
 	struct mdp_buf_sync buf_sync;
+	struct msmfb_vsync_timing vsync_timing;
+	int vsync_fd;
 	int ret = 0;
-	msm_fb_pan_idle(mfd);
+
+	/* do not make the vsync timing wait for a commit in flight */
+	if (cmd != MSMFB_VSYNC_TIMING)
+		msm_fb_pan_idle(mfd);
 
 	switch (cmd) {
 #ifdef CONFIG_FB_MSM_OVERLAY
@@ -4045,6 +4111,21 @@ static int msm_fb_ioctl(struct fb_info *info, unsigned int cmd,
 			ret = copy_to_user(argp, &buf_sync, sizeof(buf_sync));
 		break;
 
+	case MSMFB_VSYNC_TIMING:
+		msm_fb_vsync_timing(&vsync_timing);
+		ret = copy_to_user(argp, &vsync_timing, sizeof(vsync_timing));
+		if (ret)
+			ret = -EFAULT;
+		break;
+
+	case MSMFB_VSYNC_EVENTFD:
+		ret = copy_from_user(&vsync_fd, argp, sizeof(vsync_fd));
+		if (ret)
+			return -EFAULT;
+
+		ret = msm_fb_vsync_eventfd(info, vsync_fd);
+		break;
+
 	case MSMFB_DISPLAY_COMMIT:
 		ret = msmfb_display_commit(info, argp);
 		break;
@@ -4063,6 +4144,159 @@ static int msm_fb_register_driver(void)
 	return platform_driver_register(&msm_fb_driver);
 }
 
+static ATOMIC_NOTIFIER_HEAD(msm_fb_vsync_notifier_list);
+
+int msm_fb_register_vsync_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_register(&msm_fb_vsync_notifier_list, nb);
+}
+EXPORT_SYMBOL(msm_fb_register_vsync_notifier);
+
+int msm_fb_unregister_vsync_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_unregister(&msm_fb_vsync_notifier_list,
+						nb);
+}
+EXPORT_SYMBOL(msm_fb_unregister_vsync_notifier);
+
+/* vsyncs further apart than this restart the period estimate */
+#define MSM_FB_VSYNC_MAX_PERIOD	(50 * NSEC_PER_MSEC)
+
+/*
+ * The vsync interrupt is taken with a varying latency.  The phase and
+ * period of the vsyncs are tracked by a simple loop filter so that the
+ * prediction handed to userspace does not carry that jitter.
+ */
+static struct {
+	spinlock_t lock;
+	s64 last;		/* last vsync interrupt */
+	s64 base;		/* filtered time of the last vsync */
+	u32 period;		/* filtered period, 0 if unknown */
+	u32 count;
+	struct eventfd_ctx *eventfd;
+	struct fb_info *owner;
+} msm_fb_vsync = {
+	.lock = __SPIN_LOCK_UNLOCKED(msm_fb_vsync.lock),
+};
+
+static void msm_fb_vsync_track(s64 now)
+{
+	s64 delta = now - msm_fb_vsync.last;
+	s32 err;
+	u32 n;
+
+	if (!msm_fb_vsync.count || delta <= 0 ||
+	    delta > MSM_FB_VSYNC_MAX_PERIOD) {
+		/* first vsync after the interrupt was off, keep the period */
+		msm_fb_vsync.base = now;
+		return;
+	}
+
+	if (!msm_fb_vsync.period) {
+		msm_fb_vsync.period = delta;
+		msm_fb_vsync.base = now;
+		return;
+	}
+
+	/* vsyncs are not reported while the interrupt is masked */
+	n = div_u64(delta + msm_fb_vsync.period / 2, msm_fb_vsync.period);
+	if (!n)
+		n = 1;
+	err = now - (msm_fb_vsync.base + (s64) n * msm_fb_vsync.period);
+
+	if (abs(err) > msm_fb_vsync.period / 4) {
+		/* lost track, e.g. after a refresh rate change */
+		msm_fb_vsync.period = div_u64(delta, n);
+		msm_fb_vsync.base = now;
+		return;
+	}
+
+	msm_fb_vsync.base = now - err + err / 8;
+	msm_fb_vsync.period += err / (32 * (s32) n);
+}
+
+void msm_fb_vsync_notify(ktime_t vsync_time)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&msm_fb_vsync.lock, flags);
+	msm_fb_vsync_track(ktime_to_ns(vsync_time));
+	msm_fb_vsync.last = ktime_to_ns(vsync_time);
+	msm_fb_vsync.count++;
+	if (msm_fb_vsync.eventfd)
+		eventfd_signal(msm_fb_vsync.eventfd, 1);
+	spin_unlock_irqrestore(&msm_fb_vsync.lock, flags);
+
+	atomic_notifier_call_chain(&msm_fb_vsync_notifier_list, 0,
+				   &vsync_time);
+}
+
+static void msm_fb_vsync_timing(struct msmfb_vsync_timing *timing)
+{
+	s64 now = ktime_to_ns(ktime_get());
+	unsigned long flags;
+	u64 n;
+
+	spin_lock_irqsave(&msm_fb_vsync.lock, flags);
+	timing->timestamp = msm_fb_vsync.last;
+	timing->period = msm_fb_vsync.period;
+	timing->count = msm_fb_vsync.count;
+	timing->predicted = 0;
+	if (msm_fb_vsync.period) {
+		n = 1;
+		if (now > msm_fb_vsync.base)
+			n += div_u64(now - msm_fb_vsync.base,
+				     msm_fb_vsync.period);
+		timing->predicted = msm_fb_vsync.base +
+			n * msm_fb_vsync.period;
+	}
+	spin_unlock_irqrestore(&msm_fb_vsync.lock, flags);
+}
+
+/*
+ * Signal the eventfd @fd on every vsync, a negative @fd stops it.  Only
+ * one eventfd is kept, it is dropped when @info is closed for the last
+ * time.
+ */
+static int msm_fb_vsync_eventfd(struct fb_info *info, int fd)
+{
+	struct eventfd_ctx *ctx = NULL, *old;
+	unsigned long flags;
+
+	if (fd >= 0) {
+		ctx = eventfd_ctx_fdget(fd);
+		if (IS_ERR(ctx))
+			return PTR_ERR(ctx);
+	}
+
+	spin_lock_irqsave(&msm_fb_vsync.lock, flags);
+	old = msm_fb_vsync.eventfd;
+	msm_fb_vsync.eventfd = ctx;
+	msm_fb_vsync.owner = ctx ? info : NULL;
+	spin_unlock_irqrestore(&msm_fb_vsync.lock, flags);
+
+	if (old)
+		eventfd_ctx_put(old);
+	return 0;
+}
+
+static void msm_fb_vsync_release(struct fb_info *info)
+{
+	struct eventfd_ctx *old = NULL;
+	unsigned long flags;
+
+	spin_lock_irqsave(&msm_fb_vsync.lock, flags);
+	if (msm_fb_vsync.owner == info) {
+		old = msm_fb_vsync.eventfd;
+		msm_fb_vsync.eventfd = NULL;
+		msm_fb_vsync.owner = NULL;
+	}
+	spin_unlock_irqrestore(&msm_fb_vsync.lock, flags);
+
+	if (old)
+		eventfd_ctx_put(old);
+}
+
 #ifdef CONFIG_FB_MSM_WRITEBACK_MSM_PANEL
 struct fb_info *msm_fb_get_writeback_fb(void)
 {
@@ -202,6 +202,7 @@ struct msm_fb_data_type {
 	struct completion commit_comp;
 	u32 is_committing;
 	struct work_struct commit_work;
+	struct mdp_rect dirty_roi;	/* w == 0 for a full update */
 	void *msm_fb_backup;
 	boolean panel_driver_on;
 };
@@ -229,6 +230,8 @@ int msm_fb_detect_client(const char *name);
 int calc_fb_offset(struct msm_fb_data_type *mfd, struct fb_info *fbi, int bpp);
 int msm_fb_wait_for_fence(struct msm_fb_data_type *mfd);
 int msm_fb_signal_timeline(struct msm_fb_data_type *mfd);
+void msm_fb_queue_timeline(struct msm_fb_data_type *mfd);
+void msm_fb_retire_timeline(struct msm_fb_data_type *mfd, int count);
 #ifdef CONFIG_FB_BACKLIGHT
 void msm_fb_config_backlight(struct msm_fb_data_type *mfd);
 #endif
@@ -1429,10 +1429,16 @@ static u32 vid_dec_msg_pending(struct video_client_ctx *client_ctx)
 	return !islist_empty;
 }
 
-static int vid_dec_get_next_msg(struct video_client_ctx *client_ctx,
-				struct vdec_msginfo *vdec_msg_info)
+/*
+ * Wait for a message, then take up to *count pending ones so a client
+ * can collect a burst of frame done events with a single ioctl.
+ */
+static int vid_dec_get_next_msgs(struct video_client_ctx *client_ctx,
+				 struct vdec_msginfo *vdec_msg_info,
+				 u32 *count)
 {
 	int rc;
+	u32 n = 0;
 	struct vid_dec_msg *vid_dec_msg = NULL;
 
 	if (!client_ctx)
@@ -1449,19 +1455,28 @@ static int vid_dec_get_next_msg(struct video_client_ctx *client_ctx,
 	}
 
 	mutex_lock(&client_ctx->msg_queue_lock);
-	if (!list_empty(&client_ctx->msg_queue)) {
+	while (n < *count && !list_empty(&client_ctx->msg_queue)) {
 		DBG("%s(): After Wait\n", __func__);
 		vid_dec_msg = list_first_entry(&client_ctx->msg_queue,
 					       struct vid_dec_msg, list);
 		list_del(&vid_dec_msg->list);
-		memcpy(vdec_msg_info, &vid_dec_msg->vdec_msg_info,
+		memcpy(&vdec_msg_info[n++], &vid_dec_msg->vdec_msg_info,
 		       sizeof(struct vdec_msginfo));
 		kfree(vid_dec_msg);
 	}
 	mutex_unlock(&client_ctx->msg_queue_lock);
+	*count = n;
 	return 0;
 }
 
+static int vid_dec_get_next_msg(struct video_client_ctx *client_ctx,
+				struct vdec_msginfo *vdec_msg_info)
+{
+	u32 count = 1;
+
+	return vid_dec_get_next_msgs(client_ctx, vdec_msg_info, &count);
+}
+
 static long vid_dec_ioctl(struct file *file,
 			 unsigned cmd, unsigned long u_arg)
 {
@@ -1729,6 +1744,41 @@ static long vid_dec_ioctl(struct file *file,
 			return -EIO;
 		break;
 	}
+	case VDEC_IOCTL_FILL_OUTPUT_BUFFERS:
+	{
+		struct vdec_fillbuffer_cmds cmds;
+		struct vdec_fillbuffer_cmd *fill_buffer_cmd;
+		u32 i;
+		DBG("VDEC_IOCTL_FILL_OUTPUT_BUFFERS\n");
+		if (copy_from_user(&vdec_msg, arg, sizeof(vdec_msg)))
+			return -EFAULT;
+		if (copy_from_user(&cmds, vdec_msg.in, sizeof(cmds)))
+			return -EFAULT;
+		if (!cmds.count || cmds.count > VDEC_MAX_BATCH)
+			return -EINVAL;
+		fill_buffer_cmd = kmalloc(cmds.count *
+					  sizeof(*fill_buffer_cmd),
+					  GFP_KERNEL);
+		if (!fill_buffer_cmd)
+			return -ENOMEM;
+		if (copy_from_user(fill_buffer_cmd, cmds.cmds,
+				   cmds.count * sizeof(*fill_buffer_cmd))) {
+			kfree(fill_buffer_cmd);
+			return -EFAULT;
+		}
+		for (i = 0; i < cmds.count; i++)
+			if (!vid_dec_fill_output_buffer(client_ctx,
+							&fill_buffer_cmd[i]))
+				break;
+		kfree(fill_buffer_cmd);
+		rc = (i < cmds.count) ? -EIO : 0;
+		cmds.count = i;
+		if (copy_to_user(vdec_msg.in, &cmds, sizeof(cmds)))
+			return -EFAULT;
+		if (rc)
+			return rc;
+		break;
+	}
 	case VDEC_IOCTL_CMD_FLUSH:
 	{
 		enum vdec_bufferflush flush_dir;
@@ -1757,6 +1807,32 @@ static long vid_dec_ioctl(struct file *file,
 			return -EFAULT;
 		break;
 	}
+	case VDEC_IOCTL_GET_NEXT_MSGS:
+	{
+		struct vdec_msginfos msgs;
+		struct vdec_msginfo *msg_info;
+		DBG("VDEC_IOCTL_GET_NEXT_MSGS\n");
+		if (copy_from_user(&vdec_msg, arg, sizeof(vdec_msg)))
+			return -EFAULT;
+		if (copy_from_user(&msgs, vdec_msg.out, sizeof(msgs)))
+			return -EFAULT;
+		if (!msgs.count || msgs.count > VDEC_MAX_BATCH)
+			return -EINVAL;
+		msg_info = kmalloc(msgs.count * sizeof(*msg_info),
+				   GFP_KERNEL);
+		if (!msg_info)
+			return -ENOMEM;
+		rc = vid_dec_get_next_msgs(client_ctx, msg_info,
+					   &msgs.count);
+		if (!rc && (copy_to_user(msgs.msgs, msg_info,
+				msgs.count * sizeof(*msg_info)) ||
+			    copy_to_user(vdec_msg.out, &msgs, sizeof(msgs))))
+			rc = -EFAULT;
+		kfree(msg_info);
+		if (rc)
+			return rc;
+		break;
+	}
 	case VDEC_IOCTL_STOP_NEXT_MSG:
 	{
 		DBG("VDEC_IOCTL_STOP_NEXT_MSG\n");
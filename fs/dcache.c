@@ -119,6 +119,14 @@ struct dentry_stat_t dentry_stat = {
 
 static DEFINE_PER_CPU(unsigned int, nr_dentry);
 
+DEFINE_PER_CPU(struct dentry_lookup_stat, dentry_lookup_stat);
+
+/*
+ * Negative dentries of read-only filesystems cannot go stale, keep them
+ * through one more pass of the shrinker than other unused dentries.
+ */
+int sysctl_dentry_ro_negative_keep __read_mostly = 1;
+
 #if defined(CONFIG_SYSCTL) && defined(CONFIG_PROC_FS)
 static int get_nr_dentry(void)
 {
@@ -135,6 +143,26 @@ int proc_nr_dentry(ctl_table *table, int write, void __user *buffer,
 	dentry_stat.nr_dentry = get_nr_dentry();
 	return proc_dointvec(table, write, buffer, lenp, ppos);
 }
+
+/* hits on positive dentries, hits on negative ones, misses */
+int proc_dentry_lookup(ctl_table *table, int write, void __user *buffer,
+		       size_t *lenp, loff_t *ppos)
+{
+	unsigned long sum[3] = { 0, 0, 0 };
+	struct dentry_lookup_stat *st;
+	ctl_table t = *table;
+	int i;
+
+	for_each_possible_cpu(i) {
+		st = &per_cpu(dentry_lookup_stat, i);
+		sum[0] += st->hit;
+		sum[1] += st->negative;
+		sum[2] += st->miss;
+	}
+	t.data = sum;
+	t.maxlen = sizeof(sum);
+	return proc_doulongvec_minmax(&t, write, buffer, lenp, ppos);
+}
 #endif
 
 /*
@@ -863,7 +891,14 @@ relock:
 		}
 
 		if (dentry->d_flags & DCACHE_REFERENCED) {
-			dentry->d_flags &= ~DCACHE_REFERENCED;
+			dentry->d_flags &= ~(DCACHE_REFERENCED |
+					     DCACHE_NEG_AGED);
+			list_move(&dentry->d_lru, &referenced);
+			spin_unlock(&dentry->d_lock);
+		} else if (!dentry->d_inode && (sb->s_flags & MS_RDONLY) &&
+			   sysctl_dentry_ro_negative_keep &&
+			   !(dentry->d_flags & DCACHE_NEG_AGED)) {
+			dentry->d_flags |= DCACHE_NEG_AGED;
 			list_move(&dentry->d_lru, &referenced);
 			spin_unlock(&dentry->d_lock);
 		} else {
@@ -3003,7 +3038,7 @@ ino_t find_inode_number(struct dentry *dir, struct qstr *name)
 }
 EXPORT_SYMBOL(find_inode_number);
 
-static __initdata unsigned long dhash_entries;
+static __initdata unsigned long dhash_entries = CONFIG_DCACHE_HASH_ENTRIES;
 static int __init set_dhash_entries(char *str)
 {
 	if (!str)
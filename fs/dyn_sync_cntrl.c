@@ -19,10 +19,30 @@
 #include <linux/sysfs.h>
 #include <linux/earlysuspend.h>
 #include <linux/mutex.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/slab.h>
+#include <linux/reboot.h>
+#include <linux/suspend.h>
+#include <linux/workqueue.h>
 
 #include <linux/writeback.h>
 
-#define DYN_FSYNC_VERSION 1
+#define DYN_FSYNC_VERSION 2
+
+/*
+ * While the screen is on, fsync() requests are not dropped but queued and
+ * committed together once the commit window has passed.  The number of
+ * files waiting for a commit is bounded; past that callers sync directly.
+ */
+#define DYN_FSYNC_COMMIT_MSEC	200
+#define DYN_FSYNC_MAX_PENDING	128
+
+struct dyn_fsync_entry {
+	struct list_head list;
+	struct file *file;
+	int datasync;
+};
 
 /*
  * fsync_mutex protects dyn_fsync_active during early suspend / lat resume transitions
@@ -30,7 +50,96 @@
 static DEFINE_MUTEX(fsync_mutex);
 
 bool early_suspend_active = false;
-static bool dyn_fsync_active = true;
+bool dyn_fsync_active = true;
+
+static unsigned int dyn_fsync_commit_ms = DYN_FSYNC_COMMIT_MSEC;
+
+/* dyn_fsync_lock protects dyn_fsync_list and dyn_fsync_pending */
+static DEFINE_SPINLOCK(dyn_fsync_lock);
+static LIST_HEAD(dyn_fsync_list);
+static unsigned int dyn_fsync_pending;
+
+static void dyn_fsync_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(dyn_fsync_work, dyn_fsync_work_fn);
+
+/*
+ * Commit every queued fsync.  The list is taken off in one go, so an
+ * fsync issued while the commit runs gets a fresh entry and a later
+ * commit covering whatever it dirtied in the meantime.
+ */
+static void dyn_fsync_flush(void)
+{
+	struct dyn_fsync_entry *e, *tmp;
+	LIST_HEAD(list);
+	int ret;
+
+	spin_lock(&dyn_fsync_lock);
+	list_splice_init(&dyn_fsync_list, &list);
+	dyn_fsync_pending = 0;
+	spin_unlock(&dyn_fsync_lock);
+
+	list_for_each_entry_safe(e, tmp, &list, list) {
+		ret = e->file->f_op->fsync(e->file, 0, LLONG_MAX, e->datasync);
+		if (ret)
+			pr_warn("%s: deferred fsync failed: %d\n",
+				__FUNCTION__, ret);
+		fput(e->file);
+		kfree(e);
+	}
+}
+
+static void dyn_fsync_work_fn(struct work_struct *work)
+{
+	dyn_fsync_flush();
+}
+
+/*
+ * Called from vfs_fsync_range().  Returns true if the fsync on @file has
+ * been queued for the next group commit, false if the caller has to sync
+ * it now: dynamic fsync is off, the screen is off, the commit window is
+ * zero or the queue is full.
+ */
+bool dyn_fsync_defer(struct file *file, int datasync)
+{
+	struct inode *inode = file->f_mapping->host;
+	struct dyn_fsync_entry *e, *new;
+
+	if (!dyn_fsync_active || early_suspend_active || !dyn_fsync_commit_ms)
+		return false;
+	if (!file->f_op || !file->f_op->fsync)
+		return false;
+
+	new = kmalloc(sizeof(*new), GFP_NOFS);
+	if (!new)
+		return false;
+
+	spin_lock(&dyn_fsync_lock);
+	list_for_each_entry(e, &dyn_fsync_list, list) {
+		if (e->file->f_mapping->host == inode) {
+			/* the queued commit covers this request as well */
+			e->datasync &= datasync;
+			spin_unlock(&dyn_fsync_lock);
+			kfree(new);
+			return true;
+		}
+	}
+	if (dyn_fsync_pending >= DYN_FSYNC_MAX_PENDING) {
+		spin_unlock(&dyn_fsync_lock);
+		kfree(new);
+		return false;
+	}
+
+	get_file(file);
+	new->file = file;
+	new->datasync = datasync;
+	list_add_tail(&new->list, &dyn_fsync_list);
+	if (!dyn_fsync_pending++)
+		schedule_delayed_work(&dyn_fsync_work,
+				      msecs_to_jiffies(dyn_fsync_commit_ms));
+	spin_unlock(&dyn_fsync_lock);
+
+	return true;
+}
 
 static ssize_t dyn_fsync_active_show(struct kobject *kobj, struct kobj_attribute *attr, char *buf)
 {
@@ -49,6 +158,7 @@ static ssize_t dyn_fsync_active_store(struct kobject *kobj, struct kobj_attribut
 		else if (data == 0) {
 			pr_info("%s: dyanamic fsync disabled\n", __FUNCTION__);
 			dyn_fsync_active = false;
+			dyn_fsync_flush();
 		}
 		else
 			pr_info("%s: bad value: %u\n", __FUNCTION__, data);
@@ -68,6 +178,40 @@ static ssize_t dyn_fsync_earlysuspend_show(struct kobject *kobj, struct kobj_att
 	return sprintf(buf, "early suspend active: %u\n", early_suspend_active);
 }
 
+static ssize_t dyn_fsync_commit_ms_show(struct kobject *kobj, struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", dyn_fsync_commit_ms);
+}
+
+static ssize_t dyn_fsync_commit_ms_store(struct kobject *kobj, struct kobj_attribute *attr, const char *buf, size_t count)
+{
+	unsigned int data;
+
+	if (sscanf(buf, "%u\n", &data) == 1) {
+		if (data <= 5000) {
+			dyn_fsync_commit_ms = data;
+			if (!data)
+				dyn_fsync_flush();
+		} else
+			pr_info("%s: bad value: %u\n", __FUNCTION__, data);
+	} else
+		pr_info("%s: unknown input!\n", __FUNCTION__);
+
+	return count;
+}
+
+static ssize_t dyn_fsync_pending_show(struct kobject *kobj, struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", dyn_fsync_pending);
+}
+
+static ssize_t dyn_fsync_flush_store(struct kobject *kobj, struct kobj_attribute *attr, const char *buf, size_t count)
+{
+	dyn_fsync_flush();
+
+	return count;
+}
+
 static struct kobj_attribute dyn_fsync_active_attribute = 
 	__ATTR(Dyn_fsync_active, 0666, dyn_fsync_active_show, dyn_fsync_active_store);
 
@@ -77,11 +221,23 @@ static struct kobj_attribute dyn_fsync_version_attribute =
 static struct kobj_attribute dyn_fsync_earlysuspend_attribute = 
 	__ATTR(Dyn_fsync_earlysuspend, 0444 , dyn_fsync_earlysuspend_show, NULL);
 
+static struct kobj_attribute dyn_fsync_commit_ms_attribute = 
+	__ATTR(Dyn_fsync_commit_ms, 0666, dyn_fsync_commit_ms_show, dyn_fsync_commit_ms_store);
+
+static struct kobj_attribute dyn_fsync_pending_attribute = 
+	__ATTR(Dyn_fsync_pending, 0444, dyn_fsync_pending_show, NULL);
+
+static struct kobj_attribute dyn_fsync_flush_attribute = 
+	__ATTR(Dyn_fsync_flush, 0200, NULL, dyn_fsync_flush_store);
+
 static struct attribute *dyn_fsync_active_attrs[] =
 	{
 		&dyn_fsync_active_attribute.attr,
 		&dyn_fsync_version_attribute.attr,
 		&dyn_fsync_earlysuspend_attribute.attr,
+		&dyn_fsync_commit_ms_attribute.attr,
+		&dyn_fsync_pending_attribute.attr,
+		&dyn_fsync_flush_attribute.attr,
 		NULL,
 	};
 
@@ -97,6 +253,7 @@ static void dyn_fsync_early_suspend(struct early_suspend *h)
 	mutex_lock(&fsync_mutex);
 	if (dyn_fsync_active) {
 		early_suspend_active = true;
+		dyn_fsync_flush();
 #if 1
 		/* flush all outstanding buffers */
 		wakeup_flusher_threads(0, WB_REASON_SYNC);
@@ -121,11 +278,41 @@ static struct early_suspend dyn_fsync_early_suspend_handler =
 		.resume = dyn_fsync_late_resume,
 	};
 
+/*
+ * Queued fsyncs must reach the disk before the system goes down or
+ * suspends, e.g. on a low battery shutdown.
+ */
+static int dyn_fsync_reboot_notify(struct notifier_block *nb,
+				   unsigned long event, void *unused)
+{
+	cancel_delayed_work_sync(&dyn_fsync_work);
+	dyn_fsync_flush();
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block dyn_fsync_reboot_nb = {
+	.notifier_call = dyn_fsync_reboot_notify,
+};
+
+static int dyn_fsync_pm_notify(struct notifier_block *nb,
+			       unsigned long event, void *unused)
+{
+	if (event == PM_SUSPEND_PREPARE || event == PM_HIBERNATION_PREPARE)
+		dyn_fsync_flush();
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block dyn_fsync_pm_nb = {
+	.notifier_call = dyn_fsync_pm_notify,
+};
+
 static int dyn_fsync_init(void)
 {
 	int sysfs_result;
 
 	register_early_suspend(&dyn_fsync_early_suspend_handler);
+	register_reboot_notifier(&dyn_fsync_reboot_nb);
+	register_pm_notifier(&dyn_fsync_pm_nb);
 
 	dyn_fsync_kobj = kobject_create_and_add("dyn_fsync", kernel_kobj);
 	if (!dyn_fsync_kobj) {
@@ -145,6 +332,11 @@ static int dyn_fsync_init(void)
 static void dyn_fsync_exit(void)
 {
 	unregister_early_suspend(&dyn_fsync_early_suspend_handler);
+	unregister_reboot_notifier(&dyn_fsync_reboot_nb);
+	unregister_pm_notifier(&dyn_fsync_pm_nb);
+
+	cancel_delayed_work_sync(&dyn_fsync_work);
+	dyn_fsync_flush();
 
 	if (dyn_fsync_kobj != NULL)
 		kobject_put(dyn_fsync_kobj);
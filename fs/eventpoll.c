@@ -33,6 +33,7 @@
 #include <linux/bitops.h>
 #include <linux/mutex.h>
 #include <linux/anon_inodes.h>
+#include <linux/hrtimer.h>
 #include <asm/uaccess.h>
 #include <asm/io.h>
 #include <asm/mman.h>
@@ -199,6 +200,9 @@ struct eventpoll {
 
 	struct file *file;
 
+	/* Wakes up sys_epoll_wait() at the end of a batch_wakeup_us window */
+	struct hrtimer batch_timer;
+
 	/* used to optimize loop detection check */
 	int visited;
 	struct list_head visited_list_link;
@@ -239,6 +243,12 @@ struct ep_send_events_data {
  */
 /* Maximum number of epoll watched descriptors, per user */
 static long max_user_watches __read_mostly;
+/*
+ * If not zero, a waiter in sys_epoll_wait() is woken up at most this many
+ * microseconds after the first event of a burst instead of on every
+ * event, so that the whole burst is collected with one wakeup.
+ */
+static int batch_wakeup_us __read_mostly;
 
 /*
  * This mutex is used to serialize ep_free() and eventpoll_release_file().
@@ -275,6 +285,8 @@ static LIST_HEAD(tfile_check_list);
 
 static long zero;
 static long long_max = LONG_MAX;
+static int int_zero;
+static int batch_wakeup_us_max = 10000;
 
 ctl_table epoll_table[] = {
 	{
@@ -286,6 +298,15 @@ ctl_table epoll_table[] = {
 		.extra1		= &zero,
 		.extra2		= &long_max,
 	},
+	{
+		.procname	= "batch_wakeup_us",
+		.data		= &batch_wakeup_us,
+		.maxlen		= sizeof(batch_wakeup_us),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &int_zero,
+		.extra2		= &batch_wakeup_us_max,
+	},
 	{ }
 };
 #endif /* CONFIG_SYSCTL */
@@ -704,6 +725,8 @@ static void ep_free(struct eventpoll *ep)
 	}
 
 	mutex_unlock(&epmutex);
+	/* no callback is left to arm it again */
+	hrtimer_cancel(&ep->batch_timer);
 	mutex_destroy(&ep->mtx);
 	free_uid(ep->user);
 	kfree(ep);
@@ -815,6 +838,20 @@ void eventpoll_release_file(struct file *file)
 	mutex_unlock(&epmutex);
 }
 
+static enum hrtimer_restart ep_batch_timer_fn(struct hrtimer *timer)
+{
+	struct eventpoll *ep = container_of(timer, struct eventpoll,
+					    batch_timer);
+	unsigned long flags;
+
+	spin_lock_irqsave(&ep->lock, flags);
+	if (waitqueue_active(&ep->wq))
+		wake_up_locked(&ep->wq);
+	spin_unlock_irqrestore(&ep->lock, flags);
+
+	return HRTIMER_NORESTART;
+}
+
 static int ep_alloc(struct eventpoll **pep)
 {
 	int error;
@@ -835,6 +872,8 @@ static int ep_alloc(struct eventpoll **pep)
 	ep->rbr = RB_ROOT;
 	ep->ovflist = EP_UNACTIVE_PTR;
 	ep->user = user;
+	hrtimer_init(&ep->batch_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	ep->batch_timer.function = ep_batch_timer_fn;
 
 	*pep = ep;
 
@@ -937,10 +976,20 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 
 	/*
 	 * Wake up ( if active ) both the eventpoll wait list and the ->poll()
-	 * wait list.
+	 * wait list. With batching, the first event of a burst arms the batch
+	 * timer and the ones after it just queue up behind it.
 	 */
-	if (waitqueue_active(&ep->wq))
-		wake_up_locked(&ep->wq);
+	if (waitqueue_active(&ep->wq)) {
+		unsigned long batch_ns = ACCESS_ONCE(batch_wakeup_us) *
+					 NSEC_PER_USEC;
+
+		if (!batch_ns)
+			wake_up_locked(&ep->wq);
+		else if (!hrtimer_active(&ep->batch_timer))
+			hrtimer_start_range_ns(&ep->batch_timer,
+					       ns_to_ktime(batch_ns),
+					       batch_ns / 4, HRTIMER_MODE_REL);
+	}
 	if (waitqueue_active(&ep->poll_wait))
 		pwake++;
 
@@ -136,6 +136,14 @@
  * the smallest multiple of the stripe value (sbi->s_stripe) which is
  * greater than the default mb_group_prealloc.
  *
+ * With /sys/fs/ext4/<partition>/mb_cpu_windows set, which is the default on
+ * non-rotational devices, every locality group also keeps its own window:
+ * its preallocations are carved out one after the other, starting from a
+ * different part of the file system for each CPU.  Small files written in
+ * parallel then neither meet in the same block groups nor interleave on
+ * disk, and each CPU writes sequentially.  Mounting with stripe= set to the
+ * erase block size keeps the windows erase block aligned.
+ *
  * The regular allocator (using the buddy cache) supports a few tunables.
  *
  * /sys/fs/ext4/<partition>/mb_min_to_scan
@@ -1512,6 +1520,12 @@ static void ext4_mb_use_best_found(struct ext4_allocation_context *ac,
 		sbi->s_mb_last_start = ac->ac_f_ex.fe_start;
 		spin_unlock(&sbi->s_md_lock);
 	}
+	/* the next window of the locality group follows this one */
+	if ((ac->ac_flags & EXT4_MB_HINT_GROUP_ALLOC) && sbi->s_mb_cpu_windows) {
+		ac->ac_lg->lg_goal_group = ac->ac_b_ex.fe_group;
+		ac->ac_lg->lg_goal_start = ac->ac_b_ex.fe_start +
+					   ac->ac_b_ex.fe_len;
+	}
 }
 
 /*
@@ -2451,6 +2465,8 @@ int ext4_mb_init(struct super_block *sb, int needs_recovery)
 		sbi->s_mb_group_prealloc = roundup(
 			sbi->s_mb_group_prealloc, sbi->s_stripe);
 	}
+	/* seek free devices get a window per CPU, see the top of this file */
+	sbi->s_mb_cpu_windows = blk_queue_nonrot(bdev_get_queue(sb->s_bdev));
 
 	sbi->s_locality_groups = alloc_percpu(struct ext4_locality_group);
 	if (sbi->s_locality_groups == NULL) {
@@ -2464,6 +2480,9 @@ int ext4_mb_init(struct super_block *sb, int needs_recovery)
 		for (j = 0; j < PREALLOC_TB_SIZE; j++)
 			INIT_LIST_HEAD(&lg->lg_prealloc_list[j]);
 		spin_lock_init(&lg->lg_prealloc_lock);
+		/* spread the windows of the CPUs over the file system */
+		lg->lg_goal_group = ext4_get_groups_count(sb) / nr_cpu_ids * i;
+		lg->lg_goal_start = 0;
 	}
 
 	/* init file for buddy data */
@@ -2843,6 +2862,20 @@ static void ext4_mb_normalize_group_request(struct ext4_allocation_context *ac)
 
 	BUG_ON(lg == NULL);
 	ac->ac_g_ex.fe_len = EXT4_SB(sb)->s_mb_group_prealloc;
+	/* lg_mutex is held, it serializes the window as well */
+	if (EXT4_SB(sb)->s_mb_cpu_windows) {
+		if (lg->lg_goal_start >= EXT4_CLUSTERS_PER_GROUP(sb)) {
+			lg->lg_goal_group++;
+			lg->lg_goal_start = 0;
+		}
+		/* the file system may have been resized */
+		if (lg->lg_goal_group >= ext4_get_groups_count(sb)) {
+			lg->lg_goal_group = 0;
+			lg->lg_goal_start = 0;
+		}
+		ac->ac_g_ex.fe_group = lg->lg_goal_group;
+		ac->ac_g_ex.fe_start = lg->lg_goal_start;
+	}
 	mb_debug(1, "#%u: goal %u blocks for locality group\n",
 		current->pid, ac->ac_g_ex.fe_len);
 }
@@ -162,6 +162,9 @@ struct ext4_locality_group {
 	/* list of preallocations */
 	struct list_head	lg_prealloc_list[PREALLOC_TB_SIZE];
 	spinlock_t		lg_prealloc_lock;
+	/* where the next preallocation goes with s_mb_cpu_windows */
+	ext4_group_t		lg_goal_group;
+	ext4_grpblk_t		lg_goal_start;
 };
 
 struct ext4_allocation_context {
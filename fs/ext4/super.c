@@ -84,13 +84,14 @@ static int ext4_feature_set_ok(struct super_block *sb, int readonly);
 static void ext4_destroy_lazyinit_thread(void);
 static void ext4_unregister_li_request(struct super_block *sb);
 static void ext4_clear_request_list(void);
+static void ext4_kill_sb(struct super_block *sb);
 
 #if !defined(CONFIG_EXT2_FS) && !defined(CONFIG_EXT2_FS_MODULE) && defined(CONFIG_EXT4_USE_FOR_EXT23)
 static struct file_system_type ext2_fs_type = {
 	.owner		= THIS_MODULE,
 	.name		= "ext2",
 	.mount		= ext4_mount,
-	.kill_sb	= kill_block_super,
+	.kill_sb	= ext4_kill_sb,
 	.fs_flags	= FS_REQUIRES_DEV,
 };
 #define IS_EXT2_SB(sb) ((sb)->s_bdev->bd_holder == &ext2_fs_type)
@@ -104,7 +105,7 @@ static struct file_system_type ext3_fs_type = {
 	.owner		= THIS_MODULE,
 	.name		= "ext3",
 	.mount		= ext4_mount,
-	.kill_sb	= kill_block_super,
+	.kill_sb	= ext4_kill_sb,
 	.fs_flags	= FS_REQUIRES_DEV,
 };
 #define IS_EXT3_SB(sb) ((sb)->s_bdev->bd_holder == &ext3_fs_type)
@@ -1186,6 +1187,7 @@ enum {
 	Opt_inode_readahead_blks, Opt_journal_ioprio,
 	Opt_dioread_nolock, Opt_dioread_lock,
 	Opt_discard, Opt_nodiscard, Opt_init_itable, Opt_noinit_itable,
+	Opt_cleancache, Opt_nocleancache,
 };
 
 static const match_table_t tokens = {
@@ -1259,6 +1261,8 @@ static const match_table_t tokens = {
 	{Opt_init_itable, "init_itable=%u"},
 	{Opt_init_itable, "init_itable"},
 	{Opt_noinit_itable, "noinit_itable"},
+	{Opt_cleancache, "cleancache"},
+	{Opt_nocleancache, "nocleancache"},
 	{Opt_removed, "check=none"},	/* mount option from ext2/3 */
 	{Opt_removed, "nocheck"},	/* mount option from ext2/3 */
 	{Opt_removed, "reservation"},	/* mount option from ext2/3 */
@@ -1400,6 +1404,8 @@ static const struct mount_opts {
 	{Opt_noauto_da_alloc, EXT4_MOUNT_NO_AUTO_DA_ALLOC, MOPT_SET},
 	{Opt_auto_da_alloc, EXT4_MOUNT_NO_AUTO_DA_ALLOC, MOPT_CLEAR},
 	{Opt_noinit_itable, EXT4_MOUNT_INIT_INODE_TABLE, MOPT_CLEAR},
+	{Opt_cleancache, EXT4_MOUNT_CLEANCACHE, MOPT_SET},
+	{Opt_nocleancache, EXT4_MOUNT_CLEANCACHE, MOPT_CLEAR},
 	{Opt_commit, 0, MOPT_GTE0},
 	{Opt_max_batch_time, 0, MOPT_GTE0},
 	{Opt_min_batch_time, 0, MOPT_GTE0},
@@ -1805,6 +1811,19 @@ static const struct file_operations ext4_seq_options_fops = {
 	.release = single_release,
 };
 
+/*
+ * Clean page cache pages are only handed to cleancache on file systems
+ * mounted with "cleancache", which is meant for read-mostly ones such as
+ * the system partition.
+ */
+static void ext4_setup_cleancache(struct super_block *sb)
+{
+	if (!test_opt(sb, CLEANCACHE))
+		cleancache_invalidate_fs(sb);
+	else if (sb->cleancache_poolid < 0)
+		cleancache_init_fs(sb);
+}
+
 static int ext4_setup_super(struct super_block *sb, struct ext4_super_block *es,
 			    int read_only)
 {
@@ -1858,7 +1877,7 @@ done:
 			EXT4_INODES_PER_GROUP(sb),
 			sbi->s_mount_opt, sbi->s_mount_opt2);
 
-	cleancache_init_fs(sb);
+	ext4_setup_cleancache(sb);
 	return res;
 }
 
@@ -2022,6 +2041,69 @@ static int ext4_check_descriptors(struct super_block *sb,
 	return 1;
 }
 
+/*
+ * Drop the references ext4_orphan_cleanup() kept on deleted inodes, which
+ * completes their deletion.  Returns the number of inodes deleted.
+ */
+static int ext4_put_deferred_orphans(struct super_block *sb)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_inode_info *ei;
+	struct inode *inode;
+	int nr = 0;
+
+	for (;;) {
+		inode = NULL;
+		mutex_lock(&sbi->s_orphan_lock);
+		list_for_each_entry(ei, &sbi->s_orphan, i_orphan) {
+			inode = &ei->vfs_inode;
+			if (ext4_test_inode_state(inode,
+						  EXT4_STATE_ORPHAN_DEFERRED)) {
+				ext4_clear_inode_state(inode,
+						EXT4_STATE_ORPHAN_DEFERRED);
+				break;
+			}
+			inode = NULL;
+		}
+		mutex_unlock(&sbi->s_orphan_lock);
+		if (!inode)
+			break;
+		iput(inode);  /* takes it off the orphan list */
+		nr++;
+		cond_resched();
+	}
+	return nr;
+}
+
+static void ext4_orphan_work(struct work_struct *work)
+{
+	struct ext4_sb_info *sbi = container_of(work, struct ext4_sb_info,
+						s_orphan_work.work);
+	int nr = ext4_put_deferred_orphans(sbi->s_sb);
+
+	if (nr)
+		ext4_msg(sbi->s_sb, KERN_INFO, "%d deferred orphan inode%s "
+			 "deleted", nr, nr == 1 ? "" : "s");
+}
+
+/*
+ * Finish off deferred orphan deletion before the file system goes away or
+ * read-only, iput() must not find it in either state.
+ */
+static void ext4_flush_deferred_orphans(struct super_block *sb)
+{
+	cancel_delayed_work_sync(&EXT4_SB(sb)->s_orphan_work);
+	ext4_orphan_work(&EXT4_SB(sb)->s_orphan_work.work);
+}
+
+static void ext4_kill_sb(struct super_block *sb)
+{
+	/* no s_fs_info if the mount failed */
+	if (sb->s_fs_info)
+		ext4_flush_deferred_orphans(sb);
+	kill_block_super(sb);
+}
+
 /* ext4_orphan_cleanup() walks a singly-linked list of inodes (starting at
  * the superblock) which were deleted from all directories, but held open by
  * a process at the time of a crash.  We walk the list and try to delete these
@@ -2038,12 +2120,22 @@ static int ext4_check_descriptors(struct super_block *sb,
  * ext4_free_inode().  The only reason we would point at a wrong inode is if
  * e2fsck was run on this filesystem, and it must have already done the orphan
  * inode cleanup for us, so we can safely abort without any further action.
+ *
+ * Deleted inodes are only unreachable disk space, so on a read-write mount
+ * the iput() that deletes them, which can mean freeing the blocks of large
+ * files, is left to a work item running a little later.  The mount holds a
+ * reference on each of them until then.  Inodes that were being truncated
+ * are still visible and are truncated right away.
  */
+#define EXT4_ORPHAN_DEFER_DELAY	(5 * HZ)
+
 static void ext4_orphan_cleanup(struct super_block *sb,
 				struct ext4_super_block *es)
 {
 	unsigned int s_flags = sb->s_flags;
-	int nr_orphans = 0, nr_truncates = 0;
+	int nr_orphans = 0, nr_truncates = 0, nr_deferred = 0;
+	bool defer = !(s_flags & MS_RDONLY);
+	unsigned int ino;
 #ifdef CONFIG_QUOTA
 	int i;
 #endif
@@ -2084,7 +2176,11 @@ static void ext4_orphan_cleanup(struct super_block *sb,
 	/* Turn on quotas so that they are updated correctly */
 	for (i = 0; i < MAXQUOTAS; i++) {
 		if (EXT4_SB(sb)->s_qf_names[i]) {
-			int ret = ext4_quota_on_mount(sb, i);
+			/* the quota is only on for the time of the cleanup */
+			int ret;
+
+			defer = false;
+			ret = ext4_quota_on_mount(sb, i);
 			if (ret < 0)
 				ext4_msg(sb, KERN_ERR,
 					"Cannot turn on journaled "
@@ -2093,16 +2189,26 @@ static void ext4_orphan_cleanup(struct super_block *sb,
 	}
 #endif
 
-	while (es->s_last_orphan) {
+	/*
+	 * Deferred inodes stay on the orphan list, so walk it instead of
+	 * waiting for each inode to be taken off its head.  They are kept in
+	 * on-disk order on s_orphan, which is what ext4_orphan_del() needs
+	 * to unlink the ones behind them.
+	 */
+	ino = le32_to_cpu(es->s_last_orphan);
+	while (ino) {
 		struct inode *inode;
 
-		inode = ext4_orphan_get(sb, le32_to_cpu(es->s_last_orphan));
+		inode = ext4_orphan_get(sb, ino);
 		if (IS_ERR(inode)) {
-			es->s_last_orphan = 0;
+			/* deferred inodes still point to the bad one */
+			if (!nr_deferred)
+				es->s_last_orphan = 0;
 			break;
 		}
 
-		list_add(&EXT4_I(inode)->i_orphan, &EXT4_SB(sb)->s_orphan);
+		ino = NEXT_ORPHAN(inode);
+		list_add_tail(&EXT4_I(inode)->i_orphan, &EXT4_SB(sb)->s_orphan);
 		dquot_initialize(inode);
 		if (inode->i_nlink) {
 			ext4_msg(sb, KERN_DEBUG,
@@ -2118,6 +2224,12 @@ static void ext4_orphan_cleanup(struct super_block *sb,
 				__func__, inode->i_ino);
 			jbd_debug(2, "deleting unreferenced inode %lu\n",
 				  inode->i_ino);
+			if (defer) {
+				ext4_set_inode_state(inode,
+						     EXT4_STATE_ORPHAN_DEFERRED);
+				nr_deferred++;
+				continue;
+			}
 			nr_orphans++;
 		}
 		iput(inode);  /* The delete magic happens here! */
@@ -2131,6 +2243,12 @@ static void ext4_orphan_cleanup(struct super_block *sb,
 	if (nr_truncates)
 		ext4_msg(sb, KERN_INFO, "%d truncate%s cleaned up",
 		       PLURAL(nr_truncates));
+	if (nr_deferred) {
+		ext4_msg(sb, KERN_INFO, "deleting %d orphan inode%s later",
+		       PLURAL(nr_deferred));
+		queue_delayed_work(system_long_wq, &EXT4_SB(sb)->s_orphan_work,
+				   EXT4_ORPHAN_DEFER_DELAY);
+	}
 #ifdef CONFIG_QUOTA
 	/* Turn quotas off */
 	for (i = 0; i < MAXQUOTAS; i++) {
@@ -2432,6 +2550,7 @@ EXT4_RW_ATTR_SBI_UI(mb_min_to_scan, s_mb_min_to_scan);
 EXT4_RW_ATTR_SBI_UI(mb_order2_req, s_mb_order2_reqs);
 EXT4_RW_ATTR_SBI_UI(mb_stream_req, s_mb_stream_request);
 EXT4_RW_ATTR_SBI_UI(mb_group_prealloc, s_mb_group_prealloc);
+EXT4_RW_ATTR_SBI_UI(mb_cpu_windows, s_mb_cpu_windows);
 EXT4_RW_ATTR_SBI_UI(max_writeback_mb_bump, s_max_writeback_mb_bump);
 
 static struct attribute *ext4_attrs[] = {
@@ -2446,6 +2565,7 @@ static struct attribute *ext4_attrs[] = {
 	ATTR_LIST(mb_order2_req),
 	ATTR_LIST(mb_stream_req),
 	ATTR_LIST(mb_group_prealloc),
+	ATTR_LIST(mb_cpu_windows),
 	ATTR_LIST(max_writeback_mb_bump),
 	NULL,
 };
@@ -3459,6 +3579,8 @@ static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 
 	INIT_LIST_HEAD(&sbi->s_orphan); /* unlinked but open files */
 	mutex_init(&sbi->s_orphan_lock);
+	INIT_DELAYED_WORK(&sbi->s_orphan_work, ext4_orphan_work);
+	sbi->s_sb = sb;
 	sbi->s_resize_flags = 0;
 
 	sb->s_root = NULL;
@@ -4238,6 +4360,9 @@ static int ext4_remount(struct super_block *sb, int *flags, char *data)
 #endif
 	char *orig_data = kstrdup(data, GFP_KERNEL);
 
+	if ((*flags & MS_RDONLY) && !(sb->s_flags & MS_RDONLY))
+		ext4_flush_deferred_orphans(sb);
+
 	/* Store the original options */
 	lock_super(sb);
 	old_sb_flags = sb->s_flags;
@@ -4380,6 +4505,7 @@ static int ext4_remount(struct super_block *sb, int *flags, char *data)
 	ext4_setup_system_zone(sb);
 	if (sbi->s_journal == NULL)
 		ext4_commit_super(sb, 1);
+	ext4_setup_cleancache(sb);
 
 #ifdef CONFIG_QUOTA
 	/* Release old quota file names */
@@ -4849,7 +4975,7 @@ static struct file_system_type ext4_fs_type = {
 	.owner		= THIS_MODULE,
 	.name		= "ext4",
 	.mount		= ext4_mount,
-	.kill_sb	= kill_block_super,
+	.kill_sb	= ext4_kill_sb,
 	.fs_flags	= FS_REQUIRES_DEV,
 };
 
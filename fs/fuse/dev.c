@@ -209,6 +209,10 @@ void fuse_put_request(struct fuse_conn *fc, struct fuse_req *req)
 		if (req->waiting)
 			atomic_dec(&fc->num_waiting);
 
+		/* not taken over by the opener */
+		if (req->passthrough_filp)
+			fput(req->passthrough_filp);
+
 		if (req->stolen_file)
 			put_reserved_req(fc, req);
 		else
@@ -238,17 +242,33 @@ static u64 fuse_get_unique(struct fuse_conn *fc)
 	return fc->reqctr;
 }
 
+/* The pending queue of the current CPU, called with fc->lock held */
+static struct fuse_pqueue *fuse_local_pqueue(struct fuse_conn *fc)
+{
+	return &fc->pq[smp_processor_id() % FUSE_NR_PQUEUES];
+}
+
 static void queue_request(struct fuse_conn *fc, struct fuse_req *req)
 {
+	struct fuse_pqueue *pq = fuse_local_pqueue(fc);
+
 	req->in.h.len = sizeof(struct fuse_in_header) +
 		len_args(req->in.numargs, (struct fuse_arg *) req->in.args);
-	list_add_tail(&req->list, &fc->pending);
+	list_add_tail(&req->list, &pq->pending);
+	fc->num_pending++;
 	req->state = FUSE_REQ_PENDING;
 	if (!req->waiting) {
 		req->waiting = 1;
 		atomic_inc(&fc->num_waiting);
 	}
-	wake_up(&fc->waitq);
+	/*
+	 * Readers wait on fc->waitq and on the queue of their CPU, so a
+	 * reader on this CPU is woken in preference to any other.
+	 */
+	if (waitqueue_active(&pq->waitq))
+		wake_up(&pq->waitq);
+	else
+		wake_up(&fc->waitq);
 	kill_fasync(&fc->fasync, SIGIO, POLL_IN);
 }
 
@@ -377,6 +397,7 @@ __acquires(fc->lock)
 		/* Request is not yet in userspace, bail out */
 		if (req->state == FUSE_REQ_PENDING) {
 			list_del(&req->list);
+			fc->num_pending--;
 			__fuse_put_request(req);
 			req->out.h.error = -EINTR;
 			return;
@@ -917,18 +938,52 @@ static int forget_pending(struct fuse_conn *fc)
 
 static int request_pending(struct fuse_conn *fc)
 {
-	return !list_empty(&fc->pending) || !list_empty(&fc->interrupts) ||
+	return fc->num_pending || !list_empty(&fc->interrupts) ||
 		forget_pending(fc);
 }
 
+/*
+ * Pick the next pending request: the head of the local queue, unless
+ * that has been done FUSE_PQUEUE_BATCH times in a row or the local
+ * queue is empty.  Then the oldest request of all queues is taken, so
+ * requests queued on CPUs without a reader of their own are not
+ * starved.
+ */
+#define FUSE_PQUEUE_BATCH 16
+
+static struct fuse_req *next_pending(struct fuse_conn *fc)
+{
+	struct fuse_pqueue *pq = fuse_local_pqueue(fc);
+	struct fuse_req *req, *oldest = NULL;
+	int i;
+
+	if (!list_empty(&pq->pending) && fc->pending_batch-- > 0)
+		return list_entry(pq->pending.next, struct fuse_req, list);
+
+	fc->pending_batch = FUSE_PQUEUE_BATCH;
+	for (i = 0; i < FUSE_NR_PQUEUES; i++) {
+		if (list_empty(&fc->pq[i].pending))
+			continue;
+		req = list_entry(fc->pq[i].pending.next, struct fuse_req, list);
+		/* unique ids are handed out in queueing order */
+		if (!oldest ||
+		    (s64) (req->in.h.unique - oldest->in.h.unique) < 0)
+			oldest = req;
+	}
+	return oldest;
+}
+
 /* Wait until a request is available on the pending list */
 static void request_wait(struct fuse_conn *fc)
 __releases(fc->lock)
 __acquires(fc->lock)
 {
 	DECLARE_WAITQUEUE(wait, current);
+	DECLARE_WAITQUEUE(local_wait, current);
+	struct fuse_pqueue *pq = fuse_local_pqueue(fc);
 
 	add_wait_queue_exclusive(&fc->waitq, &wait);
+	add_wait_queue_exclusive(&pq->waitq, &local_wait);
 	while (fc->connected && !request_pending(fc)) {
 		set_current_state(TASK_INTERRUPTIBLE);
 		if (signal_pending(current))
@@ -939,6 +994,7 @@ __acquires(fc->lock)
 		spin_lock(&fc->lock);
 	}
 	set_current_state(TASK_RUNNING);
+	remove_wait_queue(&pq->waitq, &local_wait);
 	remove_wait_queue(&fc->waitq, &wait);
 }
 
@@ -1133,16 +1189,17 @@ static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
 	}
 
 	if (forget_pending(fc)) {
-		if (list_empty(&fc->pending) || fc->forget_batch-- > 0)
+		if (!fc->num_pending || fc->forget_batch-- > 0)
 			return fuse_read_forget(fc, cs, nbytes);
 
 		if (fc->forget_batch <= -8)
 			fc->forget_batch = 16;
 	}
 
-	req = list_entry(fc->pending.next, struct fuse_req, list);
+	req = next_pending(fc);
 	req->state = FUSE_REQ_READING;
 	list_move(&req->list, &fc->io);
+	fc->num_pending--;
 
 	in = &req->in;
 	reqsize = in->h.len;
@@ -1781,6 +1838,10 @@ static ssize_t fuse_dev_do_write(struct fuse_conn *fc,
 	err = copy_out_args(cs, &req->out, nbytes);
 	fuse_copy_finish(cs);
 
+	/* the daemon's file table is only reachable from here */
+	if (!err && !oh.error)
+		fuse_passthrough_setup(fc, req);
+
 	spin_lock(&fc->lock);
 	req->locked = 0;
 	if (!err) {
@@ -1894,10 +1955,15 @@ static unsigned fuse_dev_poll(struct file *file, poll_table *wait)
 {
 	unsigned mask = POLLOUT | POLLWRNORM;
 	struct fuse_conn *fc = fuse_get_conn(file);
+	int i;
+
 	if (!fc)
 		return POLLERR;
 
 	poll_wait(file, &fc->waitq, wait);
+	/* requests only wake the local queue if a reader waits there */
+	for (i = 0; i < FUSE_NR_PQUEUES; i++)
+		poll_wait(file, &fc->pq[i].waitq, wait);
 
 	spin_lock(&fc->lock);
 	if (!fc->connected)
@@ -1968,9 +2034,13 @@ static void end_queued_requests(struct fuse_conn *fc)
 __releases(fc->lock)
 __acquires(fc->lock)
 {
+	int i;
+
 	fc->max_background = UINT_MAX;
 	flush_bg_queue(fc);
-	end_requests(fc, &fc->pending);
+	for (i = 0; i < FUSE_NR_PQUEUES; i++)
+		end_requests(fc, &fc->pq[i].pending);
+	fc->num_pending = 0;
 	end_requests(fc, &fc->processing);
 	while (forget_pending(fc))
 		kfree(dequeue_forget(fc, 1, NULL));
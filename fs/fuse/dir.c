@@ -50,8 +50,11 @@ static u64 fuse_dentry_time(struct dentry *entry)
 /*
  * Calculate the time in jiffies until a dentry/attributes are valid
  */
-static u64 time_to_jiffies(unsigned long sec, unsigned long nsec)
+static u64 time_to_jiffies(struct fuse_conn *fc, unsigned long sec,
+			   unsigned long nsec)
 {
+	if (fc->flags & FUSE_NOTIFY_CACHE)
+		return ~0ULL;
 	if (sec || nsec) {
 		struct timespec ts = {sec, nsec};
 		return get_jiffies_64() + timespec_to_jiffies(&ts);
@@ -67,17 +70,18 @@ static void fuse_change_entry_timeout(struct dentry *entry,
 				      struct fuse_entry_out *o)
 {
 	fuse_dentry_settime(entry,
-		time_to_jiffies(o->entry_valid, o->entry_valid_nsec));
+		time_to_jiffies(get_fuse_conn_super(entry->d_sb),
+				o->entry_valid, o->entry_valid_nsec));
 }
 
-static u64 attr_timeout(struct fuse_attr_out *o)
+static u64 attr_timeout(struct fuse_conn *fc, struct fuse_attr_out *o)
 {
-	return time_to_jiffies(o->attr_valid, o->attr_valid_nsec);
+	return time_to_jiffies(fc, o->attr_valid, o->attr_valid_nsec);
 }
 
-static u64 entry_attr_timeout(struct fuse_entry_out *o)
+static u64 entry_attr_timeout(struct fuse_conn *fc, struct fuse_entry_out *o)
 {
-	return time_to_jiffies(o->attr_valid, o->attr_valid_nsec);
+	return time_to_jiffies(fc, o->attr_valid, o->attr_valid_nsec);
 }
 
 /*
@@ -215,7 +219,7 @@ static int fuse_dentry_revalidate(struct dentry *entry, struct nameidata *nd)
 			return 0;
 
 		fuse_change_attributes(inode, &outarg.attr,
-				       entry_attr_timeout(&outarg),
+				       entry_attr_timeout(fc, &outarg),
 				       attr_version);
 		fuse_change_entry_timeout(entry, &outarg);
 	}
@@ -300,7 +304,7 @@ int fuse_lookup_name(struct super_block *sb, u64 nodeid, struct qstr *name,
 		goto out_put_forget;
 
 	*inode = fuse_iget(sb, outarg->nodeid, outarg->generation,
-			   &outarg->attr, entry_attr_timeout(outarg),
+			   &outarg->attr, entry_attr_timeout(fc, outarg),
 			   attr_version);
 	err = -ENOMEM;
 	if (!*inode) {
@@ -350,7 +354,8 @@ static struct dentry *fuse_lookup(struct inode *dir, struct dentry *entry,
 	}
 
 	entry = newent ? newent : entry;
-	if (outarg_valid)
+	/* with FUSE_NOTIFY_CACHE negative entries are kept as well */
+	if (outarg_valid || (fc->flags & FUSE_NOTIFY_CACHE))
 		fuse_change_entry_timeout(entry, &outarg);
 	else
 		fuse_invalidate_entry_cache(entry);
@@ -438,12 +443,14 @@ static int fuse_create_open(struct inode *dir, struct dentry *entry,
 	if (!S_ISREG(outentry.attr.mode) || invalid_nodeid(outentry.nodeid))
 		goto out_free_ff;
 
+	ff->passthrough_filp = req->passthrough_filp;
+	req->passthrough_filp = NULL;
 	fuse_put_request(fc, req);
 	ff->fh = outopen.fh;
 	ff->nodeid = outentry.nodeid;
 	ff->open_flags = outopen.open_flags;
 	inode = fuse_iget(dir->i_sb, outentry.nodeid, outentry.generation,
-			  &outentry.attr, entry_attr_timeout(&outentry), 0);
+			  &outentry.attr, entry_attr_timeout(fc, &outentry), 0);
 	if (!inode) {
 		flags &= ~(O_CREAT | O_EXCL | O_TRUNC);
 		fuse_sync_release(ff, flags);
@@ -512,7 +519,7 @@ static int create_new_entry(struct fuse_conn *fc, struct fuse_req *req,
 		goto out_put_forget_req;
 
 	inode = fuse_iget(dir->i_sb, outarg.nodeid, outarg.generation,
-			  &outarg.attr, entry_attr_timeout(&outarg), 0);
+			  &outarg.attr, entry_attr_timeout(fc, &outarg), 0);
 	if (!inode) {
 		fuse_queue_forget(fc, forget, outarg.nodeid, 1);
 		return -ENOMEM;
@@ -838,7 +845,7 @@ static int fuse_do_getattr(struct inode *inode, struct kstat *stat,
 			err = -EIO;
 		} else {
 			fuse_change_attributes(inode, &outarg.attr,
-					       attr_timeout(&outarg),
+					       attr_timeout(fc, &outarg),
 					       attr_version);
 			if (stat)
 				fuse_fillattr(inode, &outarg.attr, stat);
@@ -1412,7 +1419,7 @@ static int fuse_do_setattr(struct dentry *entry, struct iattr *attr,
 
 	spin_lock(&fc->lock);
 	fuse_change_attributes_common(inode, &outarg.attr,
-				      attr_timeout(&outarg));
+				      attr_timeout(fc, &outarg));
 	oldsize = inode->i_size;
 	i_size_write(inode, outarg.attr.size);
 
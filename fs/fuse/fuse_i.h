@@ -26,6 +26,12 @@
 /** Max number of pages that can be used in a single read request */
 #define FUSE_MAX_PAGES_PER_REQ 32
 
+/** s_magic of fuse and fuseblk super blocks */
+#define FUSE_SUPER_MAGIC 0x65735546
+
+/** Number of pending request queues, CPUs share them beyond this */
+#define FUSE_NR_PQUEUES (NR_CPUS < 8 ? NR_CPUS : 8)
+
 /** Bias for fi->writectr, meaning new writepages must not be sent */
 #define FUSE_NOWRITE INT_MIN
 
@@ -44,6 +50,12 @@
     doing the mount will be allowed to access the filesystem */
 #define FUSE_ALLOW_OTHER         (1 << 1)
 
+/** If the FUSE_NOTIFY_CACHE flag is given, entries (negative ones
+    too) and attributes are cached regardless of the timeouts in the
+    replies, until the filesystem invalidates them with a notification
+    or they are changed through this mount */
+#define FUSE_NOTIFY_CACHE        (1 << 2)
+
 /** List of active connections */
 extern struct list_head fuse_conn_list;
 
@@ -138,6 +150,9 @@ struct fuse_file {
 
 	/** Has flock been performed on this file? */
 	bool flock:1;
+
+	/** File of the daemon that read, write and mmap go to, or NULL */
+	struct file *passthrough_filp;
 };
 
 /** One input argument of a request */
@@ -299,6 +314,9 @@ struct fuse_req {
 	/** File used in the request (or NULL) */
 	struct fuse_file *ff;
 
+	/** Passthrough file from an OPEN or CREATE reply (or NULL) */
+	struct file *passthrough_filp;
+
 	/** Inode used in the request or NULL */
 	struct inode *inode;
 
@@ -312,6 +330,20 @@ struct fuse_req {
 	struct file *stolen_file;
 };
 
+/**
+ * A queue of requests waiting to be read by the daemon
+ *
+ * Requests are queued on the queue of the CPU they are submitted on
+ * and preferably read by a daemon thread waiting on the same CPU.
+ */
+struct fuse_pqueue {
+	/** The list of pending requests */
+	struct list_head pending;
+
+	/** Readers running on CPUs using this queue wait here as well */
+	wait_queue_head_t waitq;
+} ____cacheline_aligned_in_smp;
+
 /**
  * A Fuse connection.
  *
@@ -347,8 +379,14 @@ struct fuse_conn {
 	/** Readers of the connection are waiting on this */
 	wait_queue_head_t waitq;
 
-	/** The list of pending requests */
-	struct list_head pending;
+	/** Pending requests, queued on the submitting CPU's queue */
+	struct fuse_pqueue pq[FUSE_NR_PQUEUES];
+
+	/** Number of requests on all pending queues */
+	unsigned num_pending;
+
+	/** Dequeues from the local queue before the oldest is served */
+	int pending_batch;
 
 	/** The list of requests being processed */
 	struct list_head processing;
@@ -478,6 +516,9 @@ struct fuse_conn {
 	/** Are BSD file locking primitives not implemented by fs? */
 	unsigned no_flock:1;
 
+	/** May open replies pass a file through? */
+	unsigned passthrough:1;
+
 	/** The number of requests waiting for completion */
 	atomic_t num_waiting;
 
@@ -778,4 +819,21 @@ int fuse_dev_release(struct inode *inode, struct file *file);
 
 void fuse_write_update_size(struct inode *inode, loff_t pos);
 
+/**
+ * Passthrough of read, write, splice and mmap to a file opened by the daemon
+ */
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_req *req);
+bool fuse_passthrough_write_ok(struct file *file);
+ssize_t fuse_passthrough_aio_read(struct kiocb *iocb, const struct iovec *iov,
+				  unsigned long nr_segs, loff_t pos);
+ssize_t fuse_passthrough_aio_write(struct kiocb *iocb, const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos);
+ssize_t fuse_passthrough_splice_read(struct file *in, loff_t *ppos,
+				     struct pipe_inode_info *pipe, size_t len,
+				     unsigned int flags);
+ssize_t fuse_passthrough_splice_write(struct pipe_inode_info *pipe,
+				      struct file *out, loff_t *ppos,
+				      size_t len, unsigned int flags);
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma);
+
 #endif /* _FS_FUSE_I_H */
@@ -0,0 +1,228 @@
+/*
+  FUSE: Filesystem in Userspace
+
+  Passthrough: a daemon that answers OPEN or CREATE with
+  FOPEN_PASSTHROUGH hands over one of its own open files in
+  passthrough_fd.  Reads, writes, splices and mmaps of the FUSE file
+  then go to that file inside the kernel instead of out to the daemon,
+  so access control stays with the daemon, which decided at open time.
+
+  This program can be distributed under the terms of the GNU GPL.
+  See the file COPYING.
+*/
+
+#include "fuse_i.h"
+
+#include <linux/aio.h>
+#include <linux/file.h>
+#include <linux/fs_stack.h>
+#include <linux/fsnotify.h>
+#include <linux/mm.h>
+#include <linux/pipe_fs_i.h>
+#include <linux/security.h>
+#include <linux/uio.h>
+
+/*
+ * Called while the daemon writes an OPEN or CREATE reply, the only
+ * time its file table can be looked at.  The file is kept on the
+ * request until the opener takes it over.
+ */
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_req *req)
+{
+	struct fuse_open_out *outarg;
+	struct file *filp;
+	struct inode *inode;
+
+	if (!fc->passthrough)
+		return;
+	if (req->in.h.opcode != FUSE_OPEN && req->in.h.opcode != FUSE_CREATE)
+		return;
+
+	/* the open reply is the last argument of both */
+	outarg = req->out.args[req->out.numargs - 1].value;
+	if (!(outarg->open_flags & FOPEN_PASSTHROUGH))
+		return;
+
+	filp = fget(outarg->passthrough_fd);
+	if (!filp) {
+		pr_debug("fuse: bad passthrough fd %d\n",
+			 outarg->passthrough_fd);
+		return;
+	}
+
+	inode = filp->f_path.dentry->d_inode;
+	if (!S_ISREG(inode->i_mode) || !filp->f_op ||
+	    !filp->f_op->aio_read || !filp->f_op->aio_write ||
+	    inode->i_sb->s_magic == FUSE_SUPER_MAGIC) {
+		/* stacking onto another FUSE file could loop back here */
+		pr_debug("fuse: passthrough fd %d not usable\n",
+			 outarg->passthrough_fd);
+		fput(filp);
+		return;
+	}
+
+	req->passthrough_filp = filp;
+}
+
+/*
+ * Appends cannot be passed through unless the daemon's file appends
+ * too, fcntl() may have changed either since open.
+ */
+bool fuse_passthrough_write_ok(struct file *file)
+{
+	struct fuse_file *ff = file->private_data;
+
+	return ff->passthrough_filp &&
+	       !((file->f_flags ^ ff->passthrough_filp->f_flags) & O_APPEND);
+}
+
+/* the daemon's open mode still applies */
+static int fuse_passthrough_permission(struct file *lower, int rw)
+{
+	if (!(lower->f_mode & (rw == WRITE ? FMODE_WRITE : FMODE_READ)))
+		return -EBADF;
+	return security_file_permission(lower, rw == WRITE ? MAY_WRITE :
+							     MAY_READ);
+}
+
+static ssize_t fuse_passthrough_rw(struct kiocb *iocb,
+				   const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos, int rw)
+{
+	struct file *file = iocb->ki_filp;
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough_filp;
+	struct inode *inode = file->f_path.dentry->d_inode;
+	struct inode *lower_inode = lower->f_path.dentry->d_inode;
+	size_t count = iov_length(iov, nr_segs);
+	struct kiocb kiocb;
+	ssize_t ret;
+
+	ret = fuse_passthrough_permission(lower, rw);
+	if (ret)
+		return ret;
+	if (!count)
+		return 0;
+
+	init_sync_kiocb(&kiocb, lower);
+	kiocb.ki_pos = pos;
+	kiocb.ki_left = count;
+	kiocb.ki_nbytes = count;
+
+	if (rw == WRITE)
+		ret = lower->f_op->aio_write(&kiocb, iov, nr_segs, pos);
+	else
+		ret = lower->f_op->aio_read(&kiocb, iov, nr_segs, pos);
+	if (ret == -EIOCBQUEUED)
+		ret = wait_on_sync_kiocb(&kiocb);
+	if (ret <= 0)
+		return ret;
+
+	iocb->ki_pos = kiocb.ki_pos;
+	if (rw == WRITE) {
+		fsnotify_modify(lower);
+		fuse_write_update_size(inode, kiocb.ki_pos);
+		fsstack_copy_attr_times(inode, lower_inode);
+	} else {
+		fsnotify_access(lower);
+		fsstack_copy_attr_atime(inode, lower_inode);
+	}
+	return ret;
+}
+
+ssize_t fuse_passthrough_aio_read(struct kiocb *iocb, const struct iovec *iov,
+				  unsigned long nr_segs, loff_t pos)
+{
+	return fuse_passthrough_rw(iocb, iov, nr_segs, pos, READ);
+}
+
+ssize_t fuse_passthrough_aio_write(struct kiocb *iocb, const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos)
+{
+	return fuse_passthrough_rw(iocb, iov, nr_segs, pos, WRITE);
+}
+
+/*
+ * Splicing from the daemon's file hands its page cache pages to the
+ * pipe, so sendfile() of a passthrough file copies nothing.
+ */
+ssize_t fuse_passthrough_splice_read(struct file *in, loff_t *ppos,
+				     struct pipe_inode_info *pipe, size_t len,
+				     unsigned int flags)
+{
+	struct fuse_file *ff = in->private_data;
+	struct file *lower = ff->passthrough_filp;
+	ssize_t ret;
+
+	ret = fuse_passthrough_permission(lower, READ);
+	if (ret)
+		return ret;
+
+	if (lower->f_op->splice_read)
+		ret = lower->f_op->splice_read(lower, ppos, pipe, len, flags);
+	else
+		ret = default_file_splice_read(lower, ppos, pipe, len, flags);
+	if (ret > 0) {
+		fsnotify_access(lower);
+		fsstack_copy_attr_atime(in->f_path.dentry->d_inode,
+					lower->f_path.dentry->d_inode);
+	}
+	return ret;
+}
+
+ssize_t fuse_passthrough_splice_write(struct pipe_inode_info *pipe,
+				      struct file *out, loff_t *ppos,
+				      size_t len, unsigned int flags)
+{
+	struct fuse_file *ff = out->private_data;
+	struct file *lower = ff->passthrough_filp;
+	struct inode *inode = out->f_path.dentry->d_inode;
+	ssize_t ret;
+
+	ret = fuse_passthrough_permission(lower, WRITE);
+	if (ret)
+		return ret;
+
+	if (lower->f_op->splice_write)
+		ret = lower->f_op->splice_write(pipe, lower, ppos, len, flags);
+	else
+		ret = default_file_splice_write(pipe, lower, ppos, len, flags);
+	if (ret > 0) {
+		fsnotify_modify(lower);
+		fuse_write_update_size(inode, *ppos);
+		fsstack_copy_attr_times(inode, lower->f_path.dentry->d_inode);
+	}
+	return ret;
+}
+
+/*
+ * The mapping is set up on the daemon's file, so faults never reach
+ * the FUSE page cache.
+ */
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough_filp;
+	int err;
+
+	if (!lower->f_op->mmap)
+		return -ENODEV;
+
+	if ((vma->vm_flags & VM_SHARED) && !(lower->f_mode & FMODE_WRITE)) {
+		if (vma->vm_flags & VM_WRITE)
+			return -EACCES;
+		vma->vm_flags &= ~VM_MAYWRITE;
+	}
+
+	vma->vm_file = lower;
+	get_file(lower);
+	err = lower->f_op->mmap(lower, vma);
+	if (err) {
+		vma->vm_file = file;
+		fput(lower);
+		return err;
+	}
+	/* mmap_region() took a reference to the FUSE file for vm_file */
+	fput(file);
+	return 0;
+}
@@ -489,6 +489,9 @@ EXPORT_SYMBOL(__remove_inode_hash);
 void end_writeback(struct inode *inode)
 {
 	might_sleep();
+	/* Not every filesystem truncates a mapping without pages */
+	if (inode->i_data.nrshadows)
+		truncate_inode_pages(&inode->i_data, 0);
 	/*
 	 * We have to cycle tree_lock here because reclaim can be still in the
 	 * process of removing the last page (in __delete_from_page_cache())
@@ -1616,7 +1619,7 @@ static void __wait_on_freeing_inode(struct inode *inode)
 	spin_lock(&inode_hash_lock);
 }
 
-static __initdata unsigned long ihash_entries;
+static __initdata unsigned long ihash_entries = CONFIG_INODE_HASH_ENTRIES;
 static int __init set_ihash_entries(char *str)
 {
 	if (!str)
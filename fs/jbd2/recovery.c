@@ -63,7 +63,8 @@ static void journal_brelse_array(struct buffer_head *b[], int n)
  *
  * This is not so critical that we need to be enormously clever about
  * the readahead size, though.  128K is a purely arbitrary, good-enough
- * fixed value.
+ * fixed value.  The batches are submitted under one plug so that they
+ * reach the device as a few large reads.
  */
 
 #define MAXBUF 8
@@ -75,6 +76,7 @@ static int do_readahead(journal_t *journal, unsigned int start)
 	struct buffer_head *bh;
 
 	struct buffer_head * bufs[MAXBUF];
+	struct blk_plug plug;
 
 	/* Do up to 128K of readahead */
 	max = start + (128 * 1024 / journal->j_blocksize);
@@ -85,6 +87,7 @@ static int do_readahead(journal_t *journal, unsigned int start)
 	 * a time to the block device IO layer. */
 
 	nbufs = 0;
+	blk_start_plug(&plug);
 
 	for (next = start; next < max; next++) {
 		err = jbd2_journal_bmap(journal, next, &blocknr);
@@ -119,6 +122,7 @@ static int do_readahead(journal_t *journal, unsigned int start)
 failed:
 	if (nbufs)
 		journal_brelse_array(bufs, nbufs);
+	blk_finish_plug(&plug);
 	return err;
 }
 
@@ -1180,6 +1180,10 @@ static int do_lookup(struct nameidata *nd, struct qstr *name,
 			goto unlazy;
 		if (unlikely(path->dentry->d_flags & DCACHE_NEED_AUTOMOUNT))
 			goto unlazy;
+		if (*inode)
+			dentry_lookup_count(hit);
+		else
+			dentry_lookup_count(negative);
 		return 0;
 unlazy:
 		if (unlazy_walk(nd, dentry))
@@ -1208,6 +1212,10 @@ unlazy:
 			goto need_lookup;
 		}
 	}
+	if (dentry->d_inode)
+		dentry_lookup_count(hit);
+	else
+		dentry_lookup_count(negative);
 done:
 	path->mnt = mnt;
 	path->dentry = dentry;
@@ -1223,6 +1231,7 @@ done:
 
 need_lookup:
 	BUG_ON(nd->inode != parent->d_inode);
+	dentry_lookup_count(miss);
 
 	mutex_lock(&parent->d_inode->i_mutex);
 	dentry = __lookup_hash(name, parent, nd);
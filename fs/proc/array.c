@@ -81,6 +81,8 @@
 #include <linux/pid_namespace.h>
 #include <linux/ptrace.h>
 #include <linux/tracehook.h>
+#include <linux/init.h>
+#include <linux/proc_task_stats.h>
 
 #include <asm/pgtable.h>
 #include <asm/processor.h>
@@ -556,3 +558,163 @@ int proc_pid_statm(struct seq_file *m, struct pid_namespace *ns,
 
 	return 0;
 }
+
+/*
+ * /proc/task_stats: a fixed size binary record for every process, so
+ * that monitors can sample all of them with a few reads instead of
+ * formatting and parsing /proc/<pid>/stat and status for each one.
+ * Only what /proc/<pid>/stat shows without ptrace access is included,
+ * and no mm lock is taken.
+ */
+struct task_stats_iter {
+	struct pid_namespace *ns;
+	unsigned int tgid;
+};
+
+/* the first thread group leader at or after iter->tgid, with a reference */
+static struct task_struct *task_stats_find(struct task_stats_iter *iter)
+{
+	struct task_struct *task;
+	struct pid *pid;
+
+	rcu_read_lock();
+	for (;;) {
+		task = NULL;
+		pid = find_ge_pid(iter->tgid, iter->ns);
+		if (!pid)
+			break;
+		iter->tgid = pid_nr_ns(pid, iter->ns);
+		task = pid_task(pid, PIDTYPE_PID);
+		if (task && has_group_leader_pid(task)) {
+			get_task_struct(task);
+			break;
+		}
+		iter->tgid++;
+	}
+	rcu_read_unlock();
+	return task;
+}
+
+static void *task_stats_start(struct seq_file *m, loff_t *pos)
+{
+	struct task_stats_iter *iter = m->private;
+	struct task_struct *task;
+
+	if (*pos >= PID_MAX_LIMIT)
+		return NULL;
+	iter->tgid = max_t(loff_t, *pos, 1);
+	task = task_stats_find(iter);
+	if (task)
+		*pos = iter->tgid;
+	return task;
+}
+
+static void *task_stats_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	struct task_stats_iter *iter = m->private;
+	struct task_struct *task;
+
+	put_task_struct(v);
+	iter->tgid++;
+	task = task_stats_find(iter);
+	*pos = task ? iter->tgid : PID_MAX_LIMIT;
+	return task;
+}
+
+static void task_stats_stop(struct seq_file *m, void *v)
+{
+	if (v)
+		put_task_struct(v);
+}
+
+static int task_stats_show(struct seq_file *m, void *v)
+{
+	struct task_stats_iter *iter = m->private;
+	struct pid_namespace *ns = iter->ns;
+	struct task_struct *task = v, *t;
+	struct proc_task_stats rec;
+	struct mm_struct *mm;
+	cputime_t utime = 0, stime = 0;
+	unsigned long flags;
+	u64 start_time;
+
+	/* hidepid= applies here as it does to /proc/<pid> */
+	if (ns->hide_pid && !in_group_p(ns->pid_gid) &&
+	    !ptrace_may_access(task, PTRACE_MODE_READ))
+		return 0;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.size = sizeof(rec);
+	rec.pid = iter->tgid;
+	rec.uid = task_uid(task);
+	rec.state = *get_task_state(task);
+	rec.nice = task_nice(task);
+	get_task_comm(rec.comm, task);
+
+	if (lock_task_sighand(task, &flags)) {
+		struct signal_struct *sig = task->signal;
+
+		rec.ppid = task_tgid_nr_ns(task->real_parent, ns);
+		rec.oom_score_adj = sig->oom_score_adj;
+		rec.num_threads = get_nr_threads(task);
+		t = task;
+		do {
+			rec.min_flt += t->min_flt;
+			rec.maj_flt += t->maj_flt;
+			t = next_thread(t);
+		} while (t != task);
+		rec.min_flt += sig->min_flt;
+		rec.maj_flt += sig->maj_flt;
+		thread_group_times(task, &utime, &stime);
+		unlock_task_sighand(task, &flags);
+	}
+	rec.utime = cputime_to_clock_t(utime);
+	rec.stime = cputime_to_clock_t(stime);
+
+	start_time = (u64)task->real_start_time.tv_sec * NSEC_PER_SEC +
+		     task->real_start_time.tv_nsec;
+	rec.start_time = nsec_to_clock_t(start_time);
+
+	mm = get_task_mm(task);
+	if (mm) {
+		rec.vsize = task_vsize(mm);
+		rec.rss = get_mm_rss(mm);
+		mmput(mm);
+	}
+
+	/* an overflow is noticed by seq_read(), which retries the record */
+	seq_write(m, &rec, sizeof(rec));
+	return 0;
+}
+
+static const struct seq_operations task_stats_op = {
+	.start	= task_stats_start,
+	.next	= task_stats_next,
+	.stop	= task_stats_stop,
+	.show	= task_stats_show,
+};
+
+static int task_stats_open(struct inode *inode, struct file *file)
+{
+	struct task_stats_iter *iter;
+
+	iter = __seq_open_private(file, &task_stats_op, sizeof(*iter));
+	if (!iter)
+		return -ENOMEM;
+	iter->ns = inode->i_sb->s_fs_info;
+	return 0;
+}
+
+static const struct file_operations proc_task_stats_operations = {
+	.open		= task_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= seq_release_private,
+};
+
+static int __init proc_task_stats_init(void)
+{
+	proc_create("task_stats", 0444, NULL, &proc_task_stats_operations);
+	return 0;
+}
+module_init(proc_task_stats_init);
@@ -25,11 +25,15 @@
 #include <linux/mutex.h>
 #include <linux/slab.h>
 #include <linux/buffer_head.h>
+#include <linux/cpumask.h>
+#include <linux/kconfig.h>
+#include <linux/smp.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
 #include "decompressor.h"
 #include "squashfs.h"
+#include "page_actor.h"
 
 /*
  * This file (and decompressor.h) implements a decompressor framework for
@@ -83,11 +87,40 @@ const struct squashfs_decompressor *squashfs_lookup_decompressor(int id)
 }
 
 
-void *squashfs_decompressor_init(struct super_block *sb, unsigned short flags)
+/*
+ * Blocks being read on different CPUs are decompressed in parallel, each
+ * with the stream of its CPU.  A reader that moved CPUs meanwhile just
+ * waits its turn on the stream it picked.
+ */
+int squashfs_max_decompressors(void)
+{
+	return IS_ENABLED(CONFIG_SQUASHFS_DECOMP_MULTI_PERCPU) ? nr_cpu_ids : 1;
+}
+
+
+void squashfs_decompressor_free(struct squashfs_sb_info *msblk,
+	struct squashfs_stream *stream)
+{
+	int i;
+
+	if (stream == NULL)
+		return;
+
+	for (i = 0; i < squashfs_max_decompressors(); i++)
+		if (stream[i].stream)
+			msblk->decompressor->free(stream[i].stream);
+	kfree(stream);
+}
+
+
+struct squashfs_stream *squashfs_decompressor_init(struct super_block *sb,
+	unsigned short flags)
 {
 	struct squashfs_sb_info *msblk = sb->s_fs_info;
+	struct squashfs_stream *stream;
+	struct squashfs_page_actor actor;
 	void *strm, *buffer = NULL;
-	int length = 0;
+	int i, length = 0;
 
 	/*
 	 * Read decompressor specific options from file system if present
@@ -97,20 +130,54 @@ void *squashfs_decompressor_init(struct super_block *sb, unsigned short flags)
 		if (buffer == NULL)
 			return ERR_PTR(-ENOMEM);
 
-		length = squashfs_read_data(sb, &buffer,
-			sizeof(struct squashfs_super_block), 0, NULL,
-			PAGE_CACHE_SIZE, 1);
+		squashfs_page_actor_init(&actor, &buffer, 1, 0);
+		length = squashfs_read_data(sb,
+			sizeof(struct squashfs_super_block), 0, NULL, &actor);
 
 		if (length < 0) {
-			strm = ERR_PTR(length);
+			stream = ERR_PTR(length);
 			goto finished;
 		}
 	}
 
-	strm = msblk->decompressor->init(msblk, buffer, length);
+	stream = kcalloc(squashfs_max_decompressors(), sizeof(*stream),
+		GFP_KERNEL);
+	if (stream == NULL) {
+		stream = ERR_PTR(-ENOMEM);
+		goto finished;
+	}
+
+	for (i = 0; i < squashfs_max_decompressors(); i++) {
+		strm = msblk->decompressor->init(msblk, buffer, length);
+		if (IS_ERR(strm)) {
+			squashfs_decompressor_free(msblk, stream);
+			stream = strm;
+			goto finished;
+		}
+		stream[i].stream = strm;
+		mutex_init(&stream[i].mutex);
+	}
 
 finished:
 	kfree(buffer);
 
-	return strm;
+	return stream;
+}
+
+
+int squashfs_decompress(struct squashfs_sb_info *msblk, struct buffer_head **bh,
+	int b, int offset, int length, struct squashfs_page_actor *output)
+{
+	struct squashfs_stream *stream;
+	int res;
+
+	stream = &msblk->stream[raw_smp_processor_id() %
+		squashfs_max_decompressors()];
+
+	mutex_lock(&stream->mutex);
+	res = msblk->decompressor->decompress(msblk, stream->stream, bh, b,
+		offset, length, output);
+	mutex_unlock(&stream->mutex);
+
+	return res;
 }
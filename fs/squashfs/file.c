@@ -52,6 +52,7 @@
 #include "squashfs_fs_sb.h"
 #include "squashfs_fs_i.h"
 #include "squashfs.h"
+#include "page_actor.h"
 
 /*
  * Locate cache slot in range [offset, index] for specified inode.  If
@@ -371,6 +372,83 @@ static int read_blocklist(struct inode *inode, int index, u64 *block)
 }
 
 
+/*
+ * Decompress the datablock at @block straight into the page cache pages
+ * it covers, instead of into the read_page cache and copying it out from
+ * there.  That needs every one of those pages, so -EAGAIN is returned if
+ * any of them is busy or already up to date, and the caller falls back to
+ * the cache.  @target_page is left locked on failure.
+ */
+static int squashfs_readpage_block(struct page *target_page, u64 block,
+	int bsize)
+{
+	struct inode *inode = target_page->mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int file_end = (i_size_read(inode) - 1) >> PAGE_CACHE_SHIFT;
+	int mask = (1 << (msblk->block_log - PAGE_CACHE_SHIFT)) - 1;
+	int start_index = target_page->index & ~mask;
+	int end_index = min(start_index | mask, file_end);
+	int pages = end_index - start_index + 1;
+	struct squashfs_page_actor actor;
+	struct page **page;
+	void *pageaddr;
+	int i, n, avail, res = -EAGAIN;
+
+	page = kmalloc(pages * sizeof(*page), GFP_KERNEL);
+	if (page == NULL)
+		return -EAGAIN;
+
+	for (i = 0, n = start_index; n <= end_index; i++, n++) {
+		page[i] = (n == target_page->index) ? target_page :
+			grab_cache_page_nowait(target_page->mapping, n);
+
+		if (page[i] == NULL)
+			goto release_pages;
+
+		if (PageUptodate(page[i])) {
+			i++;
+			goto release_pages;
+		}
+	}
+
+	squashfs_page_actor_init_special(&actor, page, pages, 0);
+	res = squashfs_read_data(inode->i_sb, block, bsize, NULL, &actor);
+	if (res < 0) {
+		i = pages;
+		goto release_pages;
+	}
+
+	for (i = 0; i < pages; i++) {
+		/* zero whatever the block did not reach */
+		avail = clamp(res - i * (int) PAGE_CACHE_SIZE, 0,
+			(int) PAGE_CACHE_SIZE);
+		if (avail < PAGE_CACHE_SIZE) {
+			pageaddr = kmap_atomic(page[i]);
+			memset(pageaddr + avail, 0, PAGE_CACHE_SIZE - avail);
+			kunmap_atomic(pageaddr);
+		}
+		flush_dcache_page(page[i]);
+		SetPageUptodate(page[i]);
+		unlock_page(page[i]);
+		if (page[i] != target_page)
+			page_cache_release(page[i]);
+	}
+
+	kfree(page);
+	return 0;
+
+release_pages:
+	while (--i >= 0) {
+		if (page[i] == target_page)
+			continue;
+		unlock_page(page[i]);
+		page_cache_release(page[i]);
+	}
+	kfree(page);
+	return res;
+}
+
+
 static int squashfs_readpage(struct file *file, struct page *page)
 {
 	struct inode *inode = page->mapping->host;
@@ -410,8 +488,19 @@ static int squashfs_readpage(struct file *file, struct page *page)
 			sparse = 1;
 		} else {
 			/*
-			 * Read and decompress datablock.
+			 * Read and decompress datablock, straight into the
+			 * page cache if all of its pages can be had.
 			 */
+			int res = squashfs_readpage_block(page, block, bsize);
+
+			if (res == 0)
+				return 0;
+			if (res != -EAGAIN) {
+				ERROR("Unable to read page, block %llx, size %x"
+					"\n", block, bsize);
+				goto error_out;
+			}
+
 			buffer = squashfs_get_datablock(inode->i_sb,
 								block, bsize);
 			if (buffer->error) {
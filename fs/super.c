@@ -33,6 +33,7 @@
 #include <linux/rculist_bl.h>
 #include <linux/cleancache.h>
 #include <linux/fsnotify.h>
+#include <linux/async.h>
 #include "internal.h"
 
 
@@ -557,6 +558,81 @@ void iterate_supers(void (*f)(struct super_block *, void *), void *arg)
 	spin_unlock(&sb_lock);
 }
 
+struct iterate_supers_work {
+	struct super_block *sb;
+	void (*f)(struct super_block *, void *);
+	void *arg;
+};
+
+static void iterate_one_super(struct super_block *sb,
+			      void (*f)(struct super_block *, void *),
+			      void *arg)
+{
+	down_read(&sb->s_umount);
+	if (sb->s_root && (sb->s_flags & MS_BORN))
+		f(sb, arg);
+	up_read(&sb->s_umount);
+}
+
+static void iterate_one_super_async(void *data, async_cookie_t cookie)
+{
+	struct iterate_supers_work *w = data;
+
+	iterate_one_super(w->sb, w->f, w->arg);
+	put_super(w->sb);
+	kfree(w);
+}
+
+/**
+ *	iterate_supers_parallel - call function for all active superblocks at once
+ *	@f: function to call
+ *	@arg: argument to pass to it
+ *
+ *	Like iterate_supers(), but every call runs from its own async thread,
+ *	so that superblocks on different devices are processed concurrently.
+ *	Returns when all calls have finished.
+ */
+void iterate_supers_parallel(void (*f)(struct super_block *, void *),
+			     void *arg)
+{
+	struct super_block *sb, *p = NULL;
+	struct iterate_supers_work *w;
+	LIST_HEAD(domain);
+
+	spin_lock(&sb_lock);
+	list_for_each_entry(sb, &super_blocks, s_list) {
+		if (hlist_unhashed(&sb->s_instances))
+			continue;
+		sb->s_count++;
+		spin_unlock(&sb_lock);
+
+		w = kmalloc(sizeof(*w), GFP_KERNEL);
+		if (w) {
+			/* the async call holds its own reference */
+			spin_lock(&sb_lock);
+			sb->s_count++;
+			spin_unlock(&sb_lock);
+			w->sb = sb;
+			w->f = f;
+			w->arg = arg;
+			async_schedule_domain(iterate_one_super_async, w,
+					      &domain);
+		} else {
+			iterate_one_super(sb, f, arg);
+		}
+
+		spin_lock(&sb_lock);
+		if (p)
+			__put_super(p);
+		p = sb;
+	}
+	if (p)
+		__put_super(p);
+	spin_unlock(&sb_lock);
+
+	async_synchronize_full_domain(&domain);
+}
+
 /**
  *	iterate_supers_type - call function for superblocks of given type
  *	@type: fs type
@@ -19,6 +19,8 @@
 
 #ifdef CONFIG_DYNAMIC_FSYNC
 extern bool early_suspend_active;
+extern bool dyn_fsync_active;
+extern bool dyn_fsync_defer(struct file *file, int datasync);
 #endif
 
 #define VALID_FLAGS (SYNC_FILE_RANGE_WAIT_BEFORE|SYNC_FILE_RANGE_WRITE| \
@@ -92,11 +94,13 @@ static void sync_one_sb(struct super_block *sb, void *arg)
 }
 /*
  * Sync all the data for all the filesystems (called by sys_sync() and
- * emergency sync)
+ * emergency sync).  Each superblock is handled from its own async thread
+ * so the flushers of all bdis work at the same time; the pass only
+ * returns once every superblock is done.
  */
 void sync_filesystems(int wait)
 {
-	iterate_supers(sync_one_sb, &wait);
+	iterate_supers_parallel(sync_one_sb, &wait);
 }
 
 /*
@@ -182,7 +186,7 @@ int vfs_fsync_range(struct file *file, loff_t start, loff_t end, int datasync)
 		return 0;
 #endif
 #ifdef CONFIG_DYNAMIC_FSYNC
-	if (!early_suspend_active)
+	if (dyn_fsync_defer(file, datasync))
 		return 0;
 #endif
 	if (!file->f_op || !file->f_op->fsync)
@@ -263,10 +267,6 @@ int generic_write_sync(struct file *file, loff_t pos, loff_t count)
 	if (!fsynccontrol_fsync_enabled())
 	    return 0;
 #endif
-#ifdef CONFIG_DYNAMIC_FSYNC
-	if (!early_suspend_active)
-		return 0;
-#endif
 
 	if (!(file->f_flags & O_DSYNC) && !IS_SYNC(file->f_mapping->host))
 		return 0;
@@ -337,7 +337,7 @@ SYSCALL_DEFINE(sync_file_range)(int fd, loff_t offset, loff_t nbytes,
 	    return 0;
 #endif
 #ifdef CONFIG_DYNAMIC_FSYNC
-	if (!early_suspend_active)
+	if (dyn_fsync_active && !early_suspend_active)
 		return 0;
 #endif
 
@@ -430,7 +430,7 @@ SYSCALL_DEFINE(sync_file_range2)(int fd, unsigned int flags,
 				 loff_t offset, loff_t nbytes)
 {
 #ifdef CONFIG_DYNAMIC_FSYNC
-	if (!early_suspend_active)
+	if (dyn_fsync_active && !early_suspend_active)
 		return 0;
 #endif
 	return sys_sync_file_range(fd, offset, nbytes, flags);
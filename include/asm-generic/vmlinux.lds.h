@@ -168,6 +168,10 @@
 	MEM_KEEP(init.data)						\
 	MEM_KEEP(exit.data)						\
 	*(.data.unlikely)						\
+	. = ALIGN(8);							\
+	VMLINUX_SYMBOL(__deferred_initcall_start) = .;			\
+	*(.deferred_initcall)						\
+	VMLINUX_SYMBOL(__deferred_initcall_end) = .;			\
 	STRUCT_ALIGN();							\
 	*(__tracepoints)						\
 	/* implement dynamic printk debug */				\
@@ -633,7 +637,10 @@
 		INIT_CALLS_LEVEL(rootfs)				\
 		INIT_CALLS_LEVEL(6)					\
 		INIT_CALLS_LEVEL(7)					\
-		VMLINUX_SYMBOL(__initcall_end) = .;
+		VMLINUX_SYMBOL(__initcall_end) = .;			\
+		VMLINUX_SYMBOL(__initcall_async_start) = .;		\
+		*(.initcallasync.init)					\
+		VMLINUX_SYMBOL(__initcall_async_end) = .;
 
 #define CON_INITCALL							\
 		VMLINUX_SYMBOL(__con_initcall_start) = .;		\
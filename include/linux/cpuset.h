@@ -14,6 +14,9 @@
 #include <linux/cgroup.h>
 #include <linux/mm.h>
 
+/* cpuset_boost() duration that lasts until cpuset_boost(0) */
+#define CPUSET_BOOST_HOLD	UINT_MAX
+
 #ifdef CONFIG_CPUSETS
 
 extern int number_of_cpusets;	/* How many cpusets are defined in system? */
@@ -23,6 +26,7 @@ extern void cpuset_init_smp(void);
 extern void cpuset_update_active_cpus(void);
 extern void cpuset_cpus_allowed(struct task_struct *p, struct cpumask *mask);
 extern void cpuset_cpus_allowed_fallback(struct task_struct *p);
+extern void cpuset_boost(unsigned int msecs);
 extern nodemask_t cpuset_mems_allowed(struct task_struct *p);
 #define cpuset_current_mems_allowed (current->mems_allowed)
 void cpuset_init_current_mems_allowed(void);
@@ -139,6 +143,8 @@ static inline void cpuset_cpus_allowed_fallback(struct task_struct *p)
 {
 }
 
+static inline void cpuset_boost(unsigned int msecs) {}
+
 static inline nodemask_t cpuset_mems_allowed(struct task_struct *p)
 {
 	return node_possible_map;
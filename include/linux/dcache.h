@@ -176,6 +176,8 @@ struct dentry_operations {
 #define DCACHE_CANT_MOUNT	0x0100
 #define DCACHE_GENOCIDE		0x0200
 #define DCACHE_SHRINK_LIST	0x0400
+#define DCACHE_NEG_AGED		0x0800
+     /* negative dentry of a read-only fs already spared by the shrinker */
 
 #define DCACHE_NFSFS_RENAMED	0x1000
      /* this dentry has been "silly renamed" and has to be deleted on the last
@@ -193,6 +195,17 @@ struct dentry_operations {
 
 extern seqlock_t rename_lock;
 
+/* path walk lookups answered from the dcache, or not */
+struct dentry_lookup_stat {
+	unsigned long hit;
+	unsigned long negative;
+	unsigned long miss;
+};
+DECLARE_PER_CPU(struct dentry_lookup_stat, dentry_lookup_stat);
+#define dentry_lookup_count(field)	this_cpu_inc(dentry_lookup_stat.field)
+
+extern int sysctl_dentry_ro_negative_keep;
+
 static inline int dname_external(struct dentry *dentry)
 {
 	return dentry->d_name.name != dentry->d_iname;
@@ -210,6 +210,23 @@ extern bool initcall_debug;
 #define late_initcall(fn)		__define_initcall("7",fn,7)
 #define late_initcall_sync(fn)		__define_initcall("7s",fn,7s)
 
+/*
+ * Async device initcalls run in parallel with the other device
+ * initcalls, and all of them are done before the late initcalls start.
+ * No other device initcall may depend on them.
+ */
+#define device_initcall_async(fn)	__define_initcall("async",fn,async)
+
+/*
+ * Deferred initcalls are not needed to bring up the user interface.  They
+ * run once userspace writes to /proc/deferred_initcalls, or a minute after
+ * boot at the latest, so they must not be __init and must not call __init
+ * code either.
+ */
+#define deferred_initcall(fn) \
+	static initcall_t __initcall_##fn##deferred __used \
+	__attribute__((__section__(".deferred_initcall"))) = fn
+
 #define __initcall(fn) device_initcall(fn)
 
 #define __exitcall(fn) \
@@ -266,6 +283,18 @@ void __init parse_early_options(char *cmdline);
  */
 #define module_init(x)	__initcall(x);
 
+/**
+ * async_module_init() - module_init() run in parallel with other drivers
+ * @x: function to be run at kernel boot time or module insertion
+ */
+#define async_module_init(x)	device_initcall_async(x);
+
+/**
+ * deferred_module_init() - module_init() run only after boot
+ * @x: function to be run after boot or at module insertion
+ */
+#define deferred_module_init(x)	deferred_initcall(x);
+
 /**
  * module_exit() - driver exit entry point
  * @x: function to be run when driver is removed
@@ -292,6 +321,9 @@ void __init parse_early_options(char *cmdline);
 
 #define security_initcall(fn)		module_init(fn)
 
+#define async_module_init(fn)		module_init(fn)
+#define deferred_module_init(fn)	module_init(fn)
+
 /* Each module must use one module_init(). */
 #define module_init(initfn)					\
 	static inline initcall_t __inittest(void)		\
@@ -861,6 +861,7 @@ struct input_keymap_entry {
 #define MSC_GESTURE		0x02
 #define MSC_RAW			0x03
 #define MSC_SCAN		0x04
+#define MSC_TIMESTAMP		0x05	/* time of the sample, in us */
 #define MSC_MAX			0x07
 #define MSC_CNT			(MSC_MAX+1)
 
@@ -18,6 +18,9 @@
 #ifndef LGE_TOUCH_CORE_H
 #define LGE_TOUCH_CORE_H
 
+#include <linux/ktime.h>
+#include <linux/mutex.h>
+
 //#define LGE_TOUCH_TIME_DEBUG
 
 #define MAX_FINGER	10
@@ -202,6 +205,8 @@ struct lge_touch_data {
 	struct i2c_client               *client;
 	struct input_dev                *input_dev;
 	struct hrtimer                  timer;
+	ktime_t                         irq_time;	/* sample latched */
+	struct mutex                    thread_lock;	/* thread irq vs work */
 	struct work_struct              work;
 	struct delayed_work             work_init;
 	struct delayed_work             work_touch_lock;
@@ -50,6 +50,9 @@ struct cur_touch_data {
 	u8	button_data_reg;
 	struct finger_data	finger;
 	struct button_data	button;
+	/* device status to finger data, read in one transfer */
+	u8	block[2 + sizeof(struct finger_data)];
+	u8	block_fingers;	/* fingers to read along, from last sample */
 };
 
 struct interrupt_bit_mask {
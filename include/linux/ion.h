@@ -138,6 +138,7 @@ struct ion_heap;
 struct ion_mapper;
 struct ion_client;
 struct ion_buffer;
+struct device;
 
 /* This should be removed some day when phys_addr_t's are fully
    plumbed in the kernel, and all instances of ion_phys_addr_t should
@@ -188,6 +189,9 @@ struct ion_platform_heap {
  * @virt_addr:		Virtual address used when using fmem.
  * @iommu_map_all:	Indicates whether we should map whole heap into IOMMU.
  * @iommu_2x_map_domain: Indicates the domain to use for overmapping.
+ * @cma_dev:	If set, the heap is the CMA area of this device. The memory
+ *		is only taken from the page allocator while the heap has
+ *		buffers or is protected. Not used together with @reusable.
  * @request_region:	function to be called when the number of allocations
  *			goes from 0 -> 1
  * @release_region:	function to be called when the number of allocations
@@ -206,6 +210,7 @@ struct ion_cp_heap_pdata {
 	int iommu_map_all;
 	int iommu_2x_map_domain;
 	ion_virt_addr_t *virt_addr;
+	struct device *cma_dev;
 	int (*request_region)(void *);
 	int (*release_region)(void *);
 	void *(*setup_region)(void);
@@ -198,6 +198,9 @@ struct vm_fault {
 					 * is set (which is also implied by
 					 * VM_FAULT_ERROR).
 					 */
+	/* for ->map_pages() only */
+	pgoff_t max_pgoff;		/* map pages up to this offset */
+	pte_t *pte;			/* pte entry of virtual_address */
 };
 
 /*
@@ -210,6 +213,12 @@ struct vm_operations_struct {
 	void (*close)(struct vm_area_struct * area);
 	int (*fault)(struct vm_area_struct *vma, struct vm_fault *vmf);
 
+	/*
+	 * map the pages from vmf->pgoff to vmf->max_pgoff that are ready
+	 * without sleeping, called with the page table lock held
+	 */
+	void (*map_pages)(struct vm_area_struct *vma, struct vm_fault *vmf);
+
 	/* notification that a previously read-only page is about to become
 	 * writable, if an error is returned it will cause a SIGBUS */
 	int (*page_mkwrite)(struct vm_area_struct *vma, struct vm_fault *vmf);
@@ -1419,6 +1428,7 @@ extern void truncate_inode_pages_range(struct address_space *,
 
 /* generic vm_area_ops exported for stackable file systems */
 extern int filemap_fault(struct vm_area_struct *, struct vm_fault *);
+extern void filemap_map_pages(struct vm_area_struct *, struct vm_fault *);
 
 /* mm/page-writeback.c */
 int write_one_page(struct page *page, int wait);
@@ -1428,6 +1438,20 @@ void task_dirty_inc(struct task_struct *tsk);
 #define VM_MAX_READAHEAD	1024	/* kbytes */
 #define VM_MIN_READAHEAD	16	/* kbytes (includes current page) */
 
+extern int sysctl_fault_around_pages;
+extern int sysctl_vmap_lazy_max_pages;
+
+#ifdef CONFIG_READAHEAD_REPLAY
+extern int sysctl_readahead_replay;
+void ra_replay_record(struct address_space *mapping, pgoff_t offset,
+		      unsigned long nr);
+void ra_replay_open(struct file *file);
+#else
+static inline void ra_replay_record(struct address_space *mapping,
+				    pgoff_t offset, unsigned long nr) { }
+static inline void ra_replay_open(struct file *file) { }
+#endif
+
 int force_page_cache_readahead(struct address_space *mapping, struct file *filp,
 			pgoff_t offset, unsigned long nr_to_read);
 
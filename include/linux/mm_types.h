@@ -269,6 +269,7 @@ enum {
 	MM_FILEPAGES,
 	MM_ANONPAGES,
 	MM_SWAPENTS,
+	MM_DRIVERPAGES,		/* allocated by drivers for the task */
 	NR_MM_COUNTERS
 };
 
@@ -388,6 +389,10 @@ struct mm_struct {
 #ifdef CONFIG_CPUMASK_OFFSTACK
 	struct cpumask cpumask_allocation;
 #endif
+#ifdef CONFIG_FUTEX_PRIVATE_HASH
+	/* buckets for the process private futexes, see futex_mm_init() */
+	struct futex_hash_bucket *futex_hash;
+#endif
 };
 
 static inline void mm_init_cpumask(struct mm_struct *mm)
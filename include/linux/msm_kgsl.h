@@ -474,7 +474,36 @@ struct kgsl_timestamp_event_fence {
 #define IOCTL_KGSL_TIMESTAMP_EVENT \
 	_IOWR(KGSL_IOC_TYPE, 0x33, struct kgsl_timestamp_event)
 
+/*
+ * Tell the kernel whether the contents of an IOCTL_KGSL_GPUMEM_ALLOC
+ * allocation are needed.  Under memory pressure an allocation marked
+ * KGSL_MADV_DONTNEED may be freed as if by IOCTL_KGSL_SHAREDMEM_FREE.
+ * Marking it KGSL_MADV_WILLNEED again returns retained = 0 if that
+ * happened, and gpuaddr may then belong to a newer allocation.
+ */
+
+#define KGSL_MADV_WILLNEED	0
+#define KGSL_MADV_DONTNEED	1
+
+struct kgsl_gpumem_madvise {
+	unsigned int gpuaddr;
+	unsigned int state;
+	unsigned int retained;
+};
+
+#define IOCTL_KGSL_GPUMEM_MADVISE \
+	_IOWR(KGSL_IOC_TYPE, 0x34, struct kgsl_gpumem_madvise)
+
 #ifdef __KERNEL__
+#ifdef CONFIG_MSM_KGSL
+int kgsl_pwrctrl_thermal_cap(unsigned int steps);
+#else
+static inline int kgsl_pwrctrl_thermal_cap(unsigned int steps)
+{
+	return -ENODEV;
+}
+#endif
+
 #ifdef CONFIG_MSM_KGSL_DRM
 int kgsl_gem_obj_addr(int drm_fd, int handle, unsigned long *start,
 			unsigned long *len);
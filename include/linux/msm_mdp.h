@@ -74,6 +74,9 @@
 
 #define MSMFB_DISPLAY_COMMIT      _IOW(MSMFB_IOCTL_MAGIC, 164, \
 						struct mdp_display_commit)
+#define MSMFB_VSYNC_TIMING	_IOR(MSMFB_IOCTL_MAGIC, 165, \
+						struct msmfb_vsync_timing)
+#define MSMFB_VSYNC_EVENTFD	_IOW(MSMFB_IOCTL_MAGIC, 166, int)
 
 #define FB_TYPE_3D_PANEL 0x10101010
 #define MDP_IMGTYPE2_START 0x10000
@@ -515,6 +518,18 @@ struct mdp_display_commit {
 	struct mdp_buf_fence buf_fence;
 };
 
+/*
+ * Vsync timing of the primary panel, times are CLOCK_MONOTONIC in ns.
+ * predicted is the next vsync as extrapolated from the filtered vsync
+ * phase and period, it is 0 while the period is not known yet.
+ */
+struct msmfb_vsync_timing {
+	uint64_t timestamp;	/* last vsync interrupt */
+	uint64_t predicted;	/* next vsync */
+	uint32_t period;	/* filtered vsync period */
+	uint32_t count;		/* vsyncs seen */
+};
+
 struct mdp_page_protection {
 	uint32_t page_protection;
 };
@@ -555,6 +570,16 @@ int msm_fb_writeback_dequeue_buffer(struct fb_info *info,
 		struct msmfb_data *data);
 int msm_fb_writeback_stop(struct fb_info *info);
 int msm_fb_writeback_terminate(struct fb_info *info);
+
+/*
+ * Vsync of the primary panel, called from interrupt context with a
+ * pointer to the ktime_t of the vsync.  Only delivered while vsync
+ * interrupts are enabled, i.e. while someone is drawing.
+ */
+struct notifier_block;
+int msm_fb_register_vsync_notifier(struct notifier_block *nb);
+int msm_fb_unregister_vsync_notifier(struct notifier_block *nb);
+void msm_fb_vsync_notify(ktime_t vsync_time);
 #endif
 
 #endif /*_MSM_MDP_H_*/
@@ -12,6 +12,8 @@
 		_IOW(MSM_ROTATOR_IOCTL_MAGIC, 2, struct msm_rotator_data_info)
 #define MSM_ROTATOR_IOCTL_FINISH   \
 		_IOW(MSM_ROTATOR_IOCTL_MAGIC, 3, int)
+#define MSM_ROTATOR_IOCTL_BUFFER_SYNC   \
+		_IOWR(MSM_ROTATOR_IOCTL_MAGIC, 4, struct msm_rotator_buf_sync)
 
 #define ROTATOR_VERSION_01	0xA5B4C301
 
@@ -43,6 +45,19 @@ struct msm_rotator_data_info {
 	struct msmfb_data dst_chroma;
 };
 
+/*
+ * Arms the next MSM_ROTATOR_IOCTL_ROTATE of the session: it returns as
+ * soon as the job is queued, the hardware waits for acq_fen_fd (-1 for
+ * none) before reading the source, and rel_fen_fd is signalled once the
+ * destination is written and the source is no longer used.
+ */
+struct msm_rotator_buf_sync {
+	unsigned int session_id;
+	unsigned int flags;	/* must be 0 */
+	int acq_fen_fd;
+	int rel_fen_fd;
+};
+
 struct msm_rot_clocks {
 	const char *clk_name;
 	enum rotator_clk_type clk_type;
@@ -18,6 +18,8 @@
 #ifndef __MSM_TSENS_H
 #define __MSM_TSENS_H
 
+#include <linux/errno.h>
+
 enum platform_type {
 	MSM_8660 = 0,
 	MSM_8960,
@@ -42,4 +44,25 @@ struct tsens_device {
 int32_t tsens_get_temp(struct tsens_device *dev, unsigned long *temp);
 int msm_tsens_early_init(struct tsens_platform_data *pdata);
 
+struct notifier_block;
+
+#ifdef CONFIG_THERMAL_TSENS8960
+int tsens_set_window(long lo_degC, long hi_degC);
+int tsens_register_window_notifier(struct notifier_block *nb);
+int tsens_unregister_window_notifier(struct notifier_block *nb);
+#else
+static inline int tsens_set_window(long lo_degC, long hi_degC)
+{
+	return -ENODEV;
+}
+static inline int tsens_register_window_notifier(struct notifier_block *nb)
+{
+	return -ENODEV;
+}
+static inline int tsens_unregister_window_notifier(struct notifier_block *nb)
+{
+	return -ENODEV;
+}
+#endif
+
 #endif /*MSM_TSENS_H */
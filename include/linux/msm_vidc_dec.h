@@ -210,6 +210,18 @@ struct vdec_ioctl_msg {
 #define VDEC_IOCTL_SET_PERF_CLK \
 	_IOR(VDEC_IOCTL_MAGIC, 38, struct vdec_ioctl_msg)
 
+/* CMD params: InputParam - struct vdec_fillbuffer_cmds, OutputParam - NULL
+   count is set to the number of buffers queued */
+#define VDEC_IOCTL_FILL_OUTPUT_BUFFERS \
+	_IOW(VDEC_IOCTL_MAGIC, 39, struct vdec_ioctl_msg)
+
+/*IOCTL params: InputParam - NULL, OutputParam - struct vdec_msginfos
+  waits for a message, then returns all pending ones up to count */
+#define VDEC_IOCTL_GET_NEXT_MSGS \
+	_IOWR(VDEC_IOCTL_MAGIC, 40, struct vdec_ioctl_msg)
+
+#define VDEC_MAX_BATCH 32
+
 enum vdec_picture {
 	PICTURE_TYPE_I,
 	PICTURE_TYPE_P,
@@ -549,6 +561,16 @@ struct vdec_msginfo {
 	size_t msgdatasize;
 };
 
+struct vdec_fillbuffer_cmds {
+	uint32_t count;
+	struct vdec_fillbuffer_cmd *cmds;
+};
+
+struct vdec_msginfos {
+	uint32_t count;
+	struct vdec_msginfo *msgs;
+};
+
 struct vdec_framerate {
 	unsigned long fps_denominator;
 	unsigned long fps_numerator;
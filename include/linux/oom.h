@@ -30,6 +30,22 @@ struct notifier_block;
 struct mem_cgroup;
 struct task_struct;
 
+#ifdef CONFIG_ANDROID_LMK_ADJ_INDEX
+/*
+ * Keep the lowmemorykiller's per-oom_score_adj index of thread groups
+ * up to date. None of these may be called with tasklist_lock, siglock
+ * or task_lock held, since victim selection takes those under the
+ * index lock.
+ */
+extern void lmk_adj_index_add(struct task_struct *tsk);
+extern void lmk_adj_index_del(struct task_struct *tsk);
+extern void lmk_adj_index_update(struct task_struct *tsk);
+#else
+static inline void lmk_adj_index_add(struct task_struct *tsk) {}
+static inline void lmk_adj_index_del(struct task_struct *tsk) {}
+static inline void lmk_adj_index_update(struct task_struct *tsk) {}
+#endif
+
 /*
  * Types of limitations to the nodes from which allocations may occur
  */
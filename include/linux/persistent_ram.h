@@ -63,7 +63,13 @@ struct persistent_ram_zone {
 	char *old_log;
 	size_t old_log_size;
 	size_t old_log_footer_size;
+	bool old_log_vmalloc;
 	bool early;
+
+	/* panic time compression of the kernel log */
+	void *lzo_wrkmem;
+	void *lzo_buf;
+	size_t lzo_max;
 };
 
 int persistent_ram_early_init(struct persistent_ram *ram);
@@ -73,6 +79,23 @@ struct persistent_ram_zone *persistent_ram_init_ringbuffer(struct device *dev,
 
 int persistent_ram_write(struct persistent_ram_zone *prz, const void *s,
 	unsigned int count);
+void persistent_ram_flush_ecc(struct persistent_ram_zone *prz);
+
+#ifdef CONFIG_ANDROID_PERSISTENT_RAM_COMPRESS
+int persistent_ram_init_compress(struct persistent_ram_zone *prz, size_t max);
+void persistent_ram_compress_log(struct persistent_ram_zone *prz,
+	const char *s1, unsigned long l1, const char *s2, unsigned long l2);
+#else
+static inline int persistent_ram_init_compress(struct persistent_ram_zone *prz,
+	size_t max)
+{
+	return -ENODEV;
+}
+static inline void persistent_ram_compress_log(struct persistent_ram_zone *prz,
+	const char *s1, unsigned long l1, const char *s2, unsigned long l2)
+{
+}
+#endif
 
 size_t persistent_ram_old_size(struct persistent_ram_zone *prz);
 void *persistent_ram_old(struct persistent_ram_zone *prz);
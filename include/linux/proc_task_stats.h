@@ -0,0 +1,30 @@
+#ifndef _LINUX_PROC_TASK_STATS_H
+#define _LINUX_PROC_TASK_STATS_H
+
+#include <linux/types.h>
+
+/*
+ * /proc/task_stats is a sequence of these records, one per process of
+ * the reader's pid namespace in pid order.  New fields are only ever
+ * added at the end, so readers step through the file by @size.
+ */
+struct proc_task_stats {
+	__u32	size;		/* of this record */
+	__u32	pid;
+	__u32	ppid;
+	__u32	uid;
+	__s32	oom_score_adj;
+	__s32	nice;
+	__u32	num_threads;
+	__u32	state;		/* state letter, as in /proc/<pid>/stat */
+	__u64	utime;		/* clock ticks of the whole process */
+	__u64	stime;
+	__u64	start_time;	/* clock ticks after boot */
+	__u64	min_flt;
+	__u64	maj_flt;
+	__u64	vsize;		/* bytes */
+	__u64	rss;		/* pages */
+	char	comm[16];
+};
+
+#endif /* _LINUX_PROC_TASK_STATS_H */
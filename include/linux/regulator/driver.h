@@ -208,8 +208,30 @@ struct regulator_dev {
 	void *reg_data;		/* regulator_dev data */
 
 	struct dentry *debugfs;
+
+	/* voltage range last set, to skip setting it again */
+	int applied_min_uV;
+	int applied_max_uV;
+};
+
+/**
+ * struct regulator_batch_ops - operations of a driver that batches requests
+ *
+ * @begin: The task calling it starts a batch, its requests may be queued.
+ * @commit: Send the queued requests.  Returns 0 or negative errno.
+ * @list: Used by the regulator core.
+ *
+ * See regulator_batch_begin().
+ */
+struct regulator_batch_ops {
+	void (*begin)(void);
+	int (*commit)(void);
+	struct list_head list;
 };
 
+void regulator_register_batch_ops(struct regulator_batch_ops *ops);
+void regulator_unregister_batch_ops(struct regulator_batch_ops *ops);
+
 struct regulator_dev *regulator_register(struct regulator_desc *regulator_desc,
 	struct device *dev, const struct regulator_init_data *init_data,
 	void *driver_data, struct device_node *of_node);
@@ -29,3 +29,7 @@ struct rq_data {
 extern spinlock_t rq_lock;
 extern struct rq_data rq_info;
 extern struct workqueue_struct *rq_wq;
+
+/* both restart their averaging window, see msm_rq_stats.c */
+unsigned int report_load_at_max_freq(void);
+unsigned int report_rq_avg(void);
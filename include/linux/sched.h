@@ -137,6 +137,7 @@ extern int nr_threads;
 DECLARE_PER_CPU(unsigned long, process_counts);
 extern int nr_processes(void);
 extern unsigned long nr_running(void);
+extern unsigned long nr_boosted_running(void);
 extern unsigned long nr_uninterruptible(void);
 extern unsigned long nr_iowait(void);
 extern unsigned long nr_iowait_cpu(int cpu);
@@ -274,6 +275,7 @@ extern int runqueue_is_locked(int cpu);
 extern void select_nohz_load_balancer(int stop_tick);
 extern void set_cpu_sd_state_idle(void);
 extern int get_nohz_timer_target(void);
+extern int get_unpinned_timer_target(void);
 #else
 static inline void select_nohz_load_balancer(int stop_tick) { }
 static inline void set_cpu_sd_state_idle(void) { }
@@ -664,6 +666,10 @@ struct signal_struct {
 	int oom_score_adj;	/* OOM kill score adjustment */
 	int oom_score_adj_min;	/* OOM kill score adjustment minimum value.
 				 * Only settable by CAP_SYS_RESOURCE. */
+#ifdef CONFIG_ANDROID_LMK_ADJ_INDEX
+	struct hlist_node lmk_adj_node;	/* lowmemorykiller adj bucket */
+	int lmk_adj;			/* oom_score_adj of that bucket */
+#endif
 
 	struct mutex cred_guard_mutex;	/* guard against foreign influences on
 					 * credential calculations
@@ -1217,11 +1223,19 @@ struct sched_entity {
 
 	u64			nr_migrations;
 
+#ifdef CONFIG_SMP
+	/* runtime at the last wakeup and average run per wakeup, in ns */
+	u64			wake_runtime;
+	u64			avg_burst;
+#endif
+
 #ifdef CONFIG_SCHEDSTATS
 	struct sched_statistics statistics;
 #endif
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
+	/* task was counted in rq->nr_boosted when it was enqueued */
+	unsigned int		boosted;
 	struct sched_entity	*parent;
 	/* rq on which this entity is (to be) queued: */
 	struct cfs_rq		*cfs_rq;
@@ -1316,6 +1330,9 @@ struct task_struct {
 #if defined(CONFIG_SCHEDSTATS) || defined(CONFIG_TASK_DELAY_ACCT)
 	struct sched_info sched_info;
 #endif
+#ifdef CONFIG_SCHED_WAKEUP_HIST
+	u64 wakeup_ts;		/* rq clock at wakeup, 0 once running */
+#endif
 
 	struct list_head tasks;
 #ifdef CONFIG_SMP
@@ -2011,6 +2028,21 @@ extern void sched_exec(void);
 #define sched_exec()   {}
 #endif
 
+/*
+ * Load change notifications for frequency governors.  The hook is called
+ * with the runqueue lock or the task's pi_lock held and interrupts off,
+ * so it may only record what happened and act on it later.
+ */
+#define SCHED_LOAD_RISE		0	/* load of @cpu grew a lot */
+#define SCHED_LOAD_DROP		1	/* load of @cpu shrank a lot */
+#define SCHED_LOAD_MIGRATE	2	/* a task moved from @src_cpu to @cpu */
+#define SCHED_LOAD_BOOST	3	/* a boosted group's task woke on @cpu */
+
+typedef void (*sched_load_hook_t)(int cpu, int event, int src_cpu);
+
+extern int sched_register_load_hook(sched_load_hook_t hook);
+extern void sched_unregister_load_hook(sched_load_hook_t hook);
+
 extern void sched_clock_idle_sleep_event(void);
 extern void sched_clock_idle_wakeup_event(u64 delta_ns);
 
@@ -2030,6 +2062,13 @@ extern unsigned int sysctl_sched_latency;
 extern unsigned int sysctl_sched_min_granularity;
 extern unsigned int sysctl_sched_wakeup_granularity;
 extern unsigned int sysctl_sched_child_runs_first;
+#ifdef CONFIG_SMP
+extern unsigned int sysctl_sched_energy_pack;
+extern unsigned int sysctl_sched_small_task_ns;
+
+/* relative cost of running one more task on @cpu, 0 if unknown */
+extern unsigned long arch_cpu_power_cost(int cpu);
+#endif
 
 enum sched_tunable_scaling {
 	SCHED_TUNABLESCALING_NONE,
@@ -2043,24 +2082,23 @@ extern enum sched_tunable_scaling sysctl_sched_tunable_scaling;
 extern unsigned int sysctl_sched_migration_cost;
 extern unsigned int sysctl_sched_nr_migrate;
 extern unsigned int sysctl_sched_time_avg;
-extern unsigned int sysctl_timer_migration;
 extern unsigned int sysctl_sched_shares_window;
 
 int sched_proc_update_handler(struct ctl_table *table, int write,
 		void __user *buffer, size_t *length,
 		loff_t *ppos);
 #endif
-#ifdef CONFIG_SCHED_DEBUG
+/*
+ * 0: timers stay where they are armed, 1: timers armed on an idle CPU go
+ * to a busy one, 2: in addition, timers go to the housekeeping CPU while
+ * it is busy.  Pinned timers never move.
+ */
+extern unsigned int sysctl_timer_migration;
+
 static inline unsigned int get_sysctl_timer_migration(void)
 {
 	return sysctl_timer_migration;
 }
-#else
-static inline unsigned int get_sysctl_timer_migration(void)
-{
-	return 1;
-}
-#endif
 extern unsigned int sysctl_sched_rt_period;
 extern int sysctl_sched_rt_runtime;
 
@@ -49,7 +49,7 @@ struct kmem_cache_cpu {
 	struct page *page;	/* The slab from which we are allocating */
 	struct page *partial;	/* Partially allocated frozen slabs */
 	int node;		/* The node of the page (or -1 for debug) */
-#ifdef CONFIG_SLUB_STATS
+#ifdef CONFIG_SYSFS
 	unsigned stat[NR_SLUB_STAT_ITEMS];
 #endif
 };
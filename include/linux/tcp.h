@@ -391,6 +391,9 @@ struct tcp_sock {
 				 * receiver in Recovery. */
 	u32	prr_out;	/* Total number of pkts sent during Recovery. */
 
+	unsigned long	tsq_flags;	/* TCP Small Queues state, see tsq_flags */
+	struct list_head tsq_node;	/* anchor in tsq_tasklet.head list */
+
  	u32	rcv_wnd;	/* Current receiver window		*/
 	u32	write_seq;	/* Tail(+1) of data held in tcp send buffer */
 	u32	pushed_seq;	/* Last pushed seq, required to talk to windows */
@@ -475,6 +478,12 @@ struct tcp_sock {
 	struct tcp_cookie_values  *cookie_values;
 };
 
+enum tsq_flags {
+	TSQ_THROTTLED,	/* output stopped on too many bytes below tcp */
+	TSQ_QUEUED,	/* socket is on the tsq tasklet list */
+	TSQ_OWNED,	/* tasklet found the socket owned by the user */
+};
+
 static inline struct tcp_sock *tcp_sk(const struct sock *sk)
 {
 	return (struct tcp_sock *)sk;
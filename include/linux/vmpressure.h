@@ -0,0 +1,60 @@
+#ifndef __LINUX_VMPRESSURE_H
+#define __LINUX_VMPRESSURE_H
+
+#include <linux/mutex.h>
+#include <linux/list.h>
+#include <linux/workqueue.h>
+#include <linux/gfp.h>
+#include <linux/types.h>
+#include <linux/jiffies.h>
+#include <linux/mmzone.h>
+
+/*
+ * Pressure values are percentages of scanned pages that reclaim failed
+ * to free, 0 meaning everything scanned was reclaimed.
+ */
+#define VMPRESSURE_LEVEL_MEDIUM		60
+#define VMPRESSURE_LEVEL_CRITICAL	95
+
+struct vmpressure {
+	unsigned long scanned;
+	unsigned long reclaimed;
+	/* The lock is used to keep the scanned/reclaimed above in sync. */
+	spinlock_t sr_lock;
+
+	/* The list of vmpressure_event structs. */
+	struct list_head events;
+	/* Have to grab the lock on events traversal or modifications. */
+	struct mutex events_lock;
+
+	struct work_struct work;
+};
+
+struct mem_cgroup;
+struct eventfd_ctx;
+
+extern void vmpressure(gfp_t gfp, struct mem_cgroup *memcg,
+		       struct zone *zone,
+		       unsigned long scanned, unsigned long reclaimed);
+extern void vmpressure_prio(gfp_t gfp, struct mem_cgroup *memcg, int prio);
+
+extern void vmpressure_init(struct vmpressure *vmpr);
+extern void vmpressure_cleanup(struct vmpressure *vmpr);
+extern int vmpressure_register_event(struct mem_cgroup *memcg,
+				     struct eventfd_ctx *eventfd,
+				     const char *args);
+extern void vmpressure_unregister_event(struct mem_cgroup *memcg,
+					struct eventfd_ctx *eventfd);
+
+/*
+ * Pressure of @zone over the last complete reclaim window, or 0 if
+ * the zone has not been reclaimed from recently.
+ */
+static inline unsigned int zone_vmpressure(struct zone *zone)
+{
+	if (time_after(jiffies, zone->vmpressure_stamp + HZ))
+		return 0;
+	return ACCESS_ONCE(zone->vmpressure_level);
+}
+
+#endif /* __LINUX_VMPRESSURE_H */
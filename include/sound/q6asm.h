@@ -161,6 +161,11 @@ struct audio_client {
 	uint64_t         time_stamp;
 	atomic_t         cmd_response;
 	bool             perf_mode;
+
+	/* preallocated pp params packet, see q6asm_set_volume_nowait() */
+	struct mutex	 pp_lock;
+	void		 *pp_cmd;
+	atomic_t	 pp_nowait_cnt;
 };
 
 void q6asm_audio_client_free(struct audio_client *ac);
@@ -303,6 +308,16 @@ int q6asm_equalizer(struct audio_client *ac, void *eq);
 /* Send Volume Command */
 int q6asm_set_volume(struct audio_client *ac, int volume);
 
+/*
+ * Like the above, but return once the command is sent; the ack is
+ * passed to the client callback as APR_BASIC_RSP_RESULT.
+ */
+int q6asm_equalizer_nowait(struct audio_client *ac, void *eq);
+int q6asm_set_volume_nowait(struct audio_client *ac, int volume);
+int q6asm_set_lrgain_nowait(struct audio_client *ac, int left_gain,
+			    int right_gain);
+int q6asm_set_mute_nowait(struct audio_client *ac, int muteflag);
+
 /* Set SoftPause Params */
 int q6asm_set_softpause(struct audio_client *ac,
 			struct asm_softpause_params *param);
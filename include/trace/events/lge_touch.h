@@ -0,0 +1,71 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM lge_touch
+
+#if !defined(_TRACE_LGE_TOUCH_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_LGE_TOUCH_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(touch_irq,
+
+	TP_PROTO(int irq),
+
+	TP_ARGS(irq),
+
+	TP_STRUCT__entry(
+		__field(int, irq)
+	),
+
+	TP_fast_assign(
+		__entry->irq = irq;
+	),
+
+	TP_printk("irq=%d", __entry->irq)
+);
+
+/* One stage of a sample, @latency_us after its interrupt */
+DECLARE_EVENT_CLASS(touch_stage,
+
+	TP_PROTO(s64 latency_us, int fingers),
+
+	TP_ARGS(latency_us, fingers),
+
+	TP_STRUCT__entry(
+		__field(s64, latency_us)
+		__field(int, fingers)
+	),
+
+	TP_fast_assign(
+		__entry->latency_us = latency_us;
+		__entry->fingers = fingers;
+	),
+
+	TP_printk("latency=%lldus fingers=%d",
+		  __entry->latency_us, __entry->fingers)
+);
+
+DEFINE_EVENT(touch_stage, touch_read_done,
+	TP_PROTO(s64 latency_us, int fingers),
+	TP_ARGS(latency_us, fingers)
+);
+
+DEFINE_EVENT(touch_stage, touch_filter_done,
+	TP_PROTO(s64 latency_us, int fingers),
+	TP_ARGS(latency_us, fingers)
+);
+
+DEFINE_EVENT(touch_stage, touch_input_sync,
+	TP_PROTO(s64 latency_us, int fingers),
+	TP_ARGS(latency_us, fingers)
+);
+
+/* input_sync() returned, evdev has woken up its readers */
+DEFINE_EVENT(touch_stage, touch_input_delivered,
+	TP_PROTO(s64 latency_us, int fingers),
+	TP_ARGS(latency_us, fingers)
+);
+
+#endif /* _TRACE_LGE_TOUCH_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,99 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM msm_vfe
+
+#if !defined(_TRACE_MSM_VFE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_MSM_VFE_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(msm_vfe_irq,
+	    TP_PROTO(u32 status0, u32 status1, int pending),
+
+	    TP_ARGS(status0, status1, pending),
+
+	    TP_STRUCT__entry(
+		    __field(u32, status0)
+		    __field(u32, status1)
+		    __field(int, pending)
+		    ),
+
+	    TP_fast_assign(
+		    __entry->status0 = status0;
+		    __entry->status1 = status1;
+		    __entry->pending = pending;
+		    ),
+
+	    TP_printk("status0=0x%08x status1=0x%08x pending=%d",
+		      __entry->status0, __entry->status1, __entry->pending)
+);
+
+TRACE_EVENT(msm_vfe_irq_handled,
+	    TP_PROTO(u32 status0, u32 status1, s64 latency_us,
+		     s64 handle_us),
+
+	    TP_ARGS(status0, status1, latency_us, handle_us),
+
+	    TP_STRUCT__entry(
+		    __field(u32, status0)
+		    __field(u32, status1)
+		    __field(s64, latency_us)
+		    __field(s64, handle_us)
+		    ),
+
+	    TP_fast_assign(
+		    __entry->status0 = status0;
+		    __entry->status1 = status1;
+		    __entry->latency_us = latency_us;
+		    __entry->handle_us = handle_us;
+		    ),
+
+	    TP_printk("status0=0x%08x status1=0x%08x latency=%lldus handle=%lldus",
+		      __entry->status0, __entry->status1,
+		      __entry->latency_us, __entry->handle_us)
+);
+
+TRACE_EVENT(msm_vfe_batch,
+	    TP_PROTO(int count),
+
+	    TP_ARGS(count),
+
+	    TP_STRUCT__entry(
+		    __field(int, count)
+		    ),
+
+	    TP_fast_assign(
+		    __entry->count = count;
+		    ),
+
+	    TP_printk("count=%d", __entry->count)
+);
+
+TRACE_EVENT(msm_vfe_frame_out,
+	    TP_PROTO(u8 output_id, u32 frame_id, u32 ch0_paddr,
+		     s64 latency_us),
+
+	    TP_ARGS(output_id, frame_id, ch0_paddr, latency_us),
+
+	    TP_STRUCT__entry(
+		    __field(u8, output_id)
+		    __field(u32, frame_id)
+		    __field(u32, ch0_paddr)
+		    __field(s64, latency_us)
+		    ),
+
+	    TP_fast_assign(
+		    __entry->output_id = output_id;
+		    __entry->frame_id = frame_id;
+		    __entry->ch0_paddr = ch0_paddr;
+		    __entry->latency_us = latency_us;
+		    ),
+
+	    TP_printk("output=%u frame=%u paddr=0x%08x latency=%lldus",
+		      __entry->output_id, __entry->frame_id,
+		      __entry->ch0_paddr, __entry->latency_us)
+);
+
+#endif /* if !defined(_TRACE_MSM_VFE_H) || defined(TRACE_HEADER_MULTI_READ) */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -4,6 +4,7 @@
 #if !defined(_TRACE_POWER_H) || defined(TRACE_HEADER_MULTI_READ)
 #define _TRACE_POWER_H
 
+#include <linux/device.h>
 #include <linux/ktime.h>
 #include <linux/tracepoint.h>
 
@@ -65,6 +66,65 @@ TRACE_EVENT(machine_suspend,
 	TP_printk("state=%lu", (unsigned long)__entry->state)
 );
 
+/*
+ * System suspend and resume callbacks of a device.  With asynchronous
+ * suspend and resume the callbacks of several devices overlap, the
+ * parent a device waited for tells which of them were on the critical
+ * path.
+ */
+TRACE_EVENT(device_pm_callback_start,
+
+	TP_PROTO(struct device *dev, const char *pm_ops, const char *verb),
+
+	TP_ARGS(dev, pm_ops, verb),
+
+	TP_STRUCT__entry(
+		__string(	device,		dev_name(dev)		)
+		__string(	driver,		dev_driver_string(dev)	)
+		__string(	parent,		dev->parent ?
+						dev_name(dev->parent) : "none")
+		__string(	pm_ops,		pm_ops ? pm_ops : ""	)
+		__string(	verb,		verb			)
+		__field(	bool,		async			)
+	),
+
+	TP_fast_assign(
+		__assign_str(device, dev_name(dev));
+		__assign_str(driver, dev_driver_string(dev));
+		__assign_str(parent,
+			     dev->parent ? dev_name(dev->parent) : "none");
+		__assign_str(pm_ops, pm_ops ? pm_ops : "");
+		__assign_str(verb, verb);
+		__entry->async = dev->power.async_suspend;
+	),
+
+	TP_printk("%s %s, parent: %s, %s%s%s", __get_str(driver),
+		  __get_str(device), __get_str(parent), __get_str(pm_ops),
+		  __get_str(verb), __entry->async ? " async" : "")
+);
+
+TRACE_EVENT(device_pm_callback_end,
+
+	TP_PROTO(struct device *dev, int error),
+
+	TP_ARGS(dev, error),
+
+	TP_STRUCT__entry(
+		__string(	device,		dev_name(dev)		)
+		__string(	driver,		dev_driver_string(dev)	)
+		__field(	int,		error			)
+	),
+
+	TP_fast_assign(
+		__assign_str(device, dev_name(dev));
+		__assign_str(driver, dev_driver_string(dev));
+		__entry->error = error;
+	),
+
+	TP_printk("%s %s, err=%d", __get_str(driver), __get_str(device),
+		  __entry->error)
+);
+
 #ifdef CONFIG_EVENT_POWER_TRACING_DEPRECATED
 
 /*
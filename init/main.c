@@ -68,6 +68,7 @@
 #include <linux/shmem_fs.h>
 #include <linux/slab.h>
 #include <linux/perf_event.h>
+#include <linux/seq_file.h>
 
 #include <asm/io.h>
 #include <asm/bugs.h>
@@ -655,9 +656,8 @@ static void __init do_ctors(void)
 bool initcall_debug;
 core_param(initcall_debug, initcall_debug, bool, 0644);
 
-static char msgbuf[64];
-
-static int __init_or_module do_one_initcall_debug(initcall_t fn)
+/* not __init, deferred initcalls run after the init sections are gone */
+static int do_one_initcall_debug(initcall_t fn)
 {
 	ktime_t calltime, delta, rettime;
 	unsigned long long duration;
@@ -675,9 +675,10 @@ static int __init_or_module do_one_initcall_debug(initcall_t fn)
 	return ret;
 }
 
-int __init_or_module do_one_initcall(initcall_t fn)
+int do_one_initcall(initcall_t fn)
 {
 	int count = preempt_count();
+	char msgbuf[64];	/* async initcalls run concurrently */
 	int ret;
 
 	if (initcall_debug)
@@ -716,6 +717,8 @@ extern initcall_t __initcall5_start[];
 extern initcall_t __initcall6_start[];
 extern initcall_t __initcall7_start[];
 extern initcall_t __initcall_end[];
+extern initcall_t __initcall_async_start[];
+extern initcall_t __initcall_async_end[];
 
 static initcall_t *initcall_levels[] __initdata = {
 	__initcall0_start,
@@ -740,6 +743,11 @@ static char *initcall_level_names[] __initdata = {
 	"late parameters",
 };
 
+static void __init do_async_initcall(void *data, async_cookie_t cookie)
+{
+	do_one_initcall(*(initcall_t *)data);
+}
+
 static void __init do_initcall_level(int level)
 {
 	extern const struct kernel_param __start___param[], __stop___param[];
@@ -752,8 +760,17 @@ static void __init do_initcall_level(int level)
 		   level, level,
 		   repair_env_string);
 
+	/* the async device initcalls overlap with the other device initcalls */
+	if (level == 6)
+		for (fn = __initcall_async_start; fn < __initcall_async_end;
+		     fn++)
+			async_schedule(do_async_initcall, fn);
+
 	for (fn = initcall_levels[level]; fn < initcall_levels[level+1]; fn++)
 		do_one_initcall(*fn);
+
+	if (level == 6)
+		async_synchronize_full();
 }
 
 static void __init do_initcalls(void)
@@ -783,6 +800,71 @@ static void __init do_basic_setup(void)
 	do_initcalls();
 }
 
+extern initcall_t __deferred_initcall_start[];
+extern initcall_t __deferred_initcall_end[];
+
+/* if userspace never asks for the deferred initcalls, run them anyway */
+#define DEFERRED_INITCALL_TIMEOUT	(60 * HZ)
+
+static DEFINE_MUTEX(deferred_initcall_lock);
+static bool deferred_initcall_done;
+
+static void do_deferred_initcalls(struct work_struct *work)
+{
+	initcall_t *fn;
+
+	mutex_lock(&deferred_initcall_lock);
+	if (!deferred_initcall_done) {
+		for (fn = __deferred_initcall_start;
+		     fn < __deferred_initcall_end; fn++)
+			do_one_initcall(*fn);
+		deferred_initcall_done = true;
+	}
+	mutex_unlock(&deferred_initcall_lock);
+}
+static DECLARE_DELAYED_WORK(deferred_initcall_work, do_deferred_initcalls);
+
+static int deferred_initcalls_show(struct seq_file *m, void *v)
+{
+	seq_printf(m, "%d\n", deferred_initcall_done);
+	return 0;
+}
+
+static int deferred_initcalls_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, deferred_initcalls_show, NULL);
+}
+
+/* any write runs the deferred initcalls and returns once they are done */
+static ssize_t deferred_initcalls_write(struct file *file,
+					const char __user *buf, size_t count,
+					loff_t *ppos)
+{
+	do_deferred_initcalls(NULL);
+	return count;
+}
+
+static const struct file_operations deferred_initcalls_fops = {
+	.open		= deferred_initcalls_open,
+	.read		= seq_read,
+	.write		= deferred_initcalls_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init deferred_initcall_init(void)
+{
+	if (__deferred_initcall_start == __deferred_initcall_end)
+		return 0;
+
+	proc_create("deferred_initcalls", S_IRUSR | S_IWUSR, NULL,
+		    &deferred_initcalls_fops);
+	queue_delayed_work(system_long_wq, &deferred_initcall_work,
+			   DEFERRED_INITCALL_TIMEOUT);
+	return 0;
+}
+late_initcall(deferred_initcall_init);
+
 static void __init do_pre_smp_initcalls(void)
 {
 	initcall_t *fn;
@@ -17,10 +17,12 @@
 #include <linux/export.h>
 #include <linux/slab.h>
 #include <linux/cgroup.h>
+#include <linux/eventfd.h>
 #include <linux/fs.h>
 #include <linux/uaccess.h>
 #include <linux/freezer.h>
 #include <linux/seq_file.h>
+#include <linux/workqueue.h>
 
 enum freezer_state {
 	CGROUP_THAWED = 0,
@@ -32,6 +34,14 @@ struct freezer {
 	struct cgroup_subsys_state css;
 	enum freezer_state state;
 	spinlock_t lock; /* protects _writes_ to state */
+	bool lazy;	/* leave sleeping tasks asleep while freezing */
+	struct list_head events;	/* eventfds signalled on FROZEN */
+	struct work_struct frozen_work;
+};
+
+struct freezer_event {
+	struct eventfd_ctx *eventfd;
+	struct list_head list;
 };
 
 static inline struct freezer *cgroup_freezer(
@@ -80,6 +90,11 @@ static const char *freezer_state_strs[] = {
  *    ^ ^                    |                     |
  *    | \_______THAWED_______/                     |
  *    \__________________________THAWED____________/
+ *
+ * With freezer.lazy set, FROZEN goes back to FREEZING when a parked task
+ * wakes up, until it has entered the refrigerator as well.  Every time
+ * FROZEN is reached, the eventfds registered on freezer.state through
+ * cgroup.event_control are signalled.
  */
 
 struct cgroup_subsys freezer_subsys;
@@ -104,6 +119,12 @@ struct cgroup_subsys freezer_subsys;
  * freezer->lock
  *  sighand->siglock (if the cgroup is freezing)
  *
+ * freezer_frozen_work() (no cgroup_mutex, freezer_destroy() waits for it):
+ * freezer->lock
+ *  write_lock css_set_lock (cgroup iterator start)
+ *   task->alloc_lock
+ *  read_lock css_set_lock (cgroup iterator start)
+ *
  * freezer_read():
  * cgroup_mutex
  *  freezer->lock
@@ -128,6 +149,8 @@ struct cgroup_subsys freezer_subsys;
  *    task->alloc_lock (inside __thaw_task(), prevents race with refrigerator())
  *     sighand->siglock
  */
+static void freezer_frozen_work(struct work_struct *work);
+
 static struct cgroup_subsys_state *freezer_create(struct cgroup *cgroup)
 {
 	struct freezer *freezer;
@@ -138,6 +161,8 @@ static struct cgroup_subsys_state *freezer_create(struct cgroup *cgroup)
 
 	spin_lock_init(&freezer->lock);
 	freezer->state = CGROUP_THAWED;
+	INIT_LIST_HEAD(&freezer->events);
+	INIT_WORK(&freezer->frozen_work, freezer_frozen_work);
 	return &freezer->css;
 }
 
@@ -145,16 +170,22 @@ static void freezer_destroy(struct cgroup *cgroup)
 {
 	struct freezer *freezer = cgroup_freezer(cgroup);
 
+	cancel_work_sync(&freezer->frozen_work);
 	if (freezer->state != CGROUP_THAWED)
 		atomic_dec(&system_freezing_cnt);
 	kfree(freezer);
 }
 
 /* task is frozen or will freeze immediately when next it gets woken */
-static bool is_task_frozen_enough(struct task_struct *task)
+static bool is_task_frozen_enough(struct task_struct *task, bool lazy)
 {
-	return frozen(task) ||
-		(task_is_stopped_or_traced(task) && freezing(task));
+	if (frozen(task))
+		return true;
+	if (task_is_stopped_or_traced(task) && freezing(task))
+		return true;
+	/* parked by freeze_task_lazy() and still asleep */
+	return lazy && !(task->flags & PF_KTHREAD) &&
+	       task->state == TASK_INTERRUPTIBLE && signal_pending(task);
 }
 
 /*
@@ -205,14 +236,27 @@ static void freezer_fork(struct task_struct *task)
 		return;
 
 	spin_lock_irq(&freezer->lock);
-	BUG_ON(freezer->state == CGROUP_FROZEN);
+	/* only a parked task that woke up can get this far in FROZEN */
+	BUG_ON(freezer->state == CGROUP_FROZEN && !freezer->lazy);
 
 	/* Locking avoids race with FREEZING -> THAWED transitions. */
-	if (freezer->state == CGROUP_FREEZING)
+	if (freezer->state != CGROUP_THAWED) {
+		freezer->state = CGROUP_FREEZING;
 		freeze_task(task);
+	}
 	spin_unlock_irq(&freezer->lock);
 }
 
+/* a task that has left may have been the last one in the way of FROZEN */
+static void freezer_exit(struct cgroup *cgroup, struct cgroup *old_cgroup,
+			 struct task_struct *task)
+{
+	struct freezer *freezer = cgroup_freezer(old_cgroup);
+
+	if (freezer->state == CGROUP_FREEZING && !list_empty(&freezer->events))
+		queue_work(system_nrt_wq, &freezer->frozen_work);
+}
+
 /*
  * caller must hold freezer->lock
  */
@@ -227,7 +271,7 @@ static void update_if_frozen(struct cgroup *cgroup,
 	cgroup_iter_start(cgroup, &it);
 	while ((task = cgroup_iter_next(cgroup, &it))) {
 		ntotal++;
-		if (freezing(task) && is_task_frozen_enough(task))
+		if (freezing(task) && is_task_frozen_enough(task, freezer->lazy))
 			nfrozen++;
 	}
 
@@ -236,11 +280,48 @@ static void update_if_frozen(struct cgroup *cgroup,
 	} else if (old_state == CGROUP_FREEZING) {
 		if (nfrozen == ntotal)
 			freezer->state = CGROUP_FROZEN;
-	} else { /* old_state == CGROUP_FROZEN */
-		BUG_ON(nfrozen != ntotal);
+	} else if (nfrozen != ntotal) { /* old_state == CGROUP_FROZEN */
+		BUG_ON(!freezer->lazy);
+		freezer->state = CGROUP_FREEZING;
 	}
 
 	cgroup_iter_end(cgroup, &it);
+
+	if (old_state != CGROUP_FROZEN && freezer->state == CGROUP_FROZEN) {
+		struct freezer_event *ev;
+
+		list_for_each_entry(ev, &freezer->events, list)
+			eventfd_signal(ev->eventfd, 1);
+	}
+}
+
+static void freezer_frozen_work(struct work_struct *work)
+{
+	struct freezer *freezer = container_of(work, struct freezer,
+					       frozen_work);
+
+	spin_lock_irq(&freezer->lock);
+	if (freezer->state == CGROUP_FREEZING)
+		update_if_frozen(freezer->css.cgroup, freezer);
+	spin_unlock_irq(&freezer->lock);
+}
+
+/**
+ * cgroup_freezer_frozen - @task has entered the refrigerator
+ * @task: the task, which is current
+ *
+ * Has the state brought up to date if anyone waits for FROZEN, so that
+ * userspace is told without polling freezer.state.
+ */
+void cgroup_freezer_frozen(struct task_struct *task)
+{
+	struct freezer *freezer;
+
+	rcu_read_lock();
+	freezer = task_freezer(task);
+	if (freezer->state == CGROUP_FREEZING && !list_empty(&freezer->events))
+		queue_work(system_nrt_wq, &freezer->frozen_work);
+	rcu_read_unlock();
 }
 
 static int freezer_read(struct cgroup *cgroup, struct cftype *cft,
@@ -255,7 +336,7 @@ static int freezer_read(struct cgroup *cgroup, struct cftype *cft,
 	freezer = cgroup_freezer(cgroup);
 	spin_lock_irq(&freezer->lock);
 	state = freezer->state;
-	if (state == CGROUP_FREEZING) {
+	if (state != CGROUP_THAWED) {
 		/* We change from FREEZING to FROZEN lazily if the cgroup was
 		 * only partially frozen when we exitted write. */
 		update_if_frozen(cgroup, freezer);
@@ -277,9 +358,17 @@ static int try_to_freeze_cgroup(struct cgroup *cgroup, struct freezer *freezer)
 
 	cgroup_iter_start(cgroup, &it);
 	while ((task = cgroup_iter_next(cgroup, &it))) {
+		/*
+		 * Waking every sleeping thread of a large process just to
+		 * have it enter the refrigerator is most of the cost of a
+		 * freeze.  Lazily, they are only flagged and get there
+		 * whenever they wake up on their own.
+		 */
+		if (freezer->lazy && freeze_task_lazy(task))
+			continue;
 		if (!freeze_task(task))
 			continue;
-		if (is_task_frozen_enough(task))
+		if (is_task_frozen_enough(task, freezer->lazy))
 			continue;
 		if (!freezing(task) && !freezer_should_skip(task))
 			num_cant_freeze_now++;
@@ -324,6 +413,8 @@ static int freezer_change_state(struct cgroup *cgroup,
 			atomic_inc(&system_freezing_cnt);
 		freezer->state = CGROUP_FREEZING;
 		retval = try_to_freeze_cgroup(cgroup, freezer);
+		if (!retval)
+			update_if_frozen(cgroup, freezer);
 		break;
 	default:
 		BUG();
@@ -355,11 +446,81 @@ static int freezer_write(struct cgroup *cgroup,
 	return retval;
 }
 
+static u64 freezer_lazy_read(struct cgroup *cgroup, struct cftype *cft)
+{
+	return cgroup_freezer(cgroup)->lazy;
+}
+
+static int freezer_lazy_write(struct cgroup *cgroup, struct cftype *cft,
+			      u64 val)
+{
+	struct freezer *freezer = cgroup_freezer(cgroup);
+	int retval = 0;
+
+	if (val > 1)
+		return -EINVAL;
+
+	if (!cgroup_lock_live_group(cgroup))
+		return -ENODEV;
+	spin_lock_irq(&freezer->lock);
+	/* FROZEN means something else for a lazy freezer */
+	if (freezer->state != CGROUP_THAWED)
+		retval = -EBUSY;
+	else
+		freezer->lazy = val;
+	spin_unlock_irq(&freezer->lock);
+	cgroup_unlock();
+	return retval;
+}
+
+static int freezer_register_event(struct cgroup *cgroup, struct cftype *cft,
+				  struct eventfd_ctx *eventfd, const char *args)
+{
+	struct freezer *freezer = cgroup_freezer(cgroup);
+	struct freezer_event *ev;
+
+	ev = kmalloc(sizeof(*ev), GFP_KERNEL);
+	if (!ev)
+		return -ENOMEM;
+	ev->eventfd = eventfd;
+
+	spin_lock_irq(&freezer->lock);
+	list_add(&ev->list, &freezer->events);
+	/* already frozen, tell the waiter right away */
+	if (freezer->state == CGROUP_FROZEN)
+		eventfd_signal(eventfd, 1);
+	spin_unlock_irq(&freezer->lock);
+	return 0;
+}
+
+static void freezer_unregister_event(struct cgroup *cgroup, struct cftype *cft,
+				     struct eventfd_ctx *eventfd)
+{
+	struct freezer *freezer = cgroup_freezer(cgroup);
+	struct freezer_event *ev, *tmp;
+
+	spin_lock_irq(&freezer->lock);
+	list_for_each_entry_safe(ev, tmp, &freezer->events, list) {
+		if (ev->eventfd == eventfd) {
+			list_del(&ev->list);
+			kfree(ev);
+		}
+	}
+	spin_unlock_irq(&freezer->lock);
+}
+
 static struct cftype files[] = {
 	{
 		.name = "state",
 		.read_seq_string = freezer_read,
 		.write_string = freezer_write,
+		.register_event = freezer_register_event,
+		.unregister_event = freezer_unregister_event,
+	},
+	{
+		.name = "lazy",
+		.read_u64 = freezer_lazy_read,
+		.write_u64 = freezer_lazy_write,
 	},
 };
 
@@ -378,4 +539,5 @@ struct cgroup_subsys freezer_subsys = {
 	.subsys_id	= freezer_subsys_id,
 	.can_attach	= freezer_can_attach,
 	.fork		= freezer_fork,
+	.exit		= freezer_exit,
 };
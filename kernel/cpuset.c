@@ -93,6 +93,7 @@ struct cpuset {
 
 	unsigned long flags;		/* "unsigned long" so bitops work */
 	cpumask_var_t cpus_allowed;	/* CPUs allowed to tasks in cpuset */
+	cpumask_var_t boost_cpus;	/* subset used while boosted */
 	nodemask_t mems_allowed;	/* Memory Nodes allowed to tasks */
 
 	struct cpuset *parent;		/* my parent */
@@ -291,6 +292,41 @@ static void guarantee_online_cpus(const struct cpuset *cs,
 	BUG_ON(!cpumask_intersects(pmask, cpu_online_mask));
 }
 
+/*
+ * While a boost is in effect the tasks of a cpuset with a non-empty
+ * boost_cpus run on just those of its cpus, so that the background
+ * groups can be squeezed onto a core or two while the foreground app
+ * launches or is being touched.  cpuset_boosted is what the tasks
+ * currently have; it is written holding both cgroup_mutex and
+ * callback_mutex.  Requests land in cpuset_boost_held and
+ * cpuset_boost_until under cpuset_boost_lock and are applied from
+ * cpuset_boost_work.
+ */
+static bool cpuset_boosted;
+static bool cpuset_boost_held;
+static unsigned long cpuset_boost_until;
+static DEFINE_SPINLOCK(cpuset_boost_lock);
+
+/*
+ * Narrow *pmask to the boost cpus of cs while a boost is in effect,
+ * unless none of the boost cpus in *pmask are active.
+ *
+ * Call with cgroup_mutex or callback_mutex held.
+ */
+static void cpuset_boost_cpus(const struct cpuset *cs, struct cpumask *pmask)
+{
+	int cpu;
+
+	if (!cpuset_boosted)
+		return;
+	for_each_cpu_and(cpu, cs->boost_cpus, pmask) {
+		if (cpu_active(cpu)) {
+			cpumask_and(pmask, pmask, cs->boost_cpus);
+			return;
+		}
+	}
+}
+
 /*
  * Return in *pmask the portion of a cpusets's mems_allowed that
  * are online, with memory.  If none are online with memory, walk
@@ -367,7 +403,13 @@ static struct cpuset *alloc_trial_cpuset(const struct cpuset *cs)
 		kfree(trial);
 		return NULL;
 	}
+	if (!alloc_cpumask_var(&trial->boost_cpus, GFP_KERNEL)) {
+		free_cpumask_var(trial->cpus_allowed);
+		kfree(trial);
+		return NULL;
+	}
 	cpumask_copy(trial->cpus_allowed, cs->cpus_allowed);
+	cpumask_copy(trial->boost_cpus, cs->boost_cpus);
 
 	return trial;
 }
@@ -378,6 +420,7 @@ static struct cpuset *alloc_trial_cpuset(const struct cpuset *cs)
  */
 static void free_trial_cpuset(struct cpuset *trial)
 {
+	free_cpumask_var(trial->boost_cpus);
 	free_cpumask_var(trial->cpus_allowed);
 	kfree(trial);
 }
@@ -797,62 +840,57 @@ void rebuild_sched_domains(void)
 	do_rebuild_sched_domains(NULL);
 }
 
-/**
- * cpuset_test_cpumask - test a task's cpus_allowed versus its cpuset's
- * @tsk: task to test
- * @scan: struct cgroup_scanner contained in its struct cpuset_hotplug_scanner
- *
- * Call with cgroup_mutex held.  May take callback_mutex during call.
- * Called for each task in a cgroup by cgroup_scan_tasks().
- * Return nonzero if this tasks's cpus_allowed mask should be changed (in other
- * words, if its mask is not equal to its cpuset's mask).
- */
-static int cpuset_test_cpumask(struct task_struct *tsk,
-			       struct cgroup_scanner *scan)
-{
-	return !cpumask_equal(&tsk->cpus_allowed,
-			(cgroup_cs(scan->cg))->cpus_allowed);
-}
+/* Tasks collected per pass of update_tasks_cpumask() */
+#define CPUSET_UPDATE_BATCH	32
 
-/**
- * cpuset_change_cpumask - make a task's cpus_allowed the same as its cpuset's
- * @tsk: task to test
- * @scan: struct cgroup_scanner containing the cgroup of the task
- *
- * Called by cgroup_scan_tasks() for each task in a cgroup whose
- * cpus_allowed mask needs to be changed.
- *
- * We don't need to re-check for the cgroup/cpuset membership, since we're
- * holding cgroup_lock() at this point.
- */
-static void cpuset_change_cpumask(struct task_struct *tsk,
-				  struct cgroup_scanner *scan)
-{
-	set_cpus_allowed_ptr(tsk, ((cgroup_cs(scan->cg))->cpus_allowed));
-}
+/* The mask update_tasks_cpumask() hands out; protected by cgroup_mutex */
+static cpumask_var_t cpus_update;
 
 /**
  * update_tasks_cpumask - Update the cpumasks of tasks in the cpuset.
  * @cs: the cpuset in which each task's cpus_allowed mask needs to be changed
- * @heap: if NULL, defer allocating heap memory to cgroup_scan_tasks()
  *
  * Called with cgroup_mutex held
  *
- * The cgroup_scan_tasks() function will scan all the tasks in a cgroup,
- * calling callback functions for each.
- *
- * No return value. It's guaranteed that cgroup_scan_tasks() always returns 0
- * if @heap != NULL.
+ * Tasks whose mask differs are collected a batch at a time by a plain
+ * walk of the cgroup's css_sets, then moved with the css_set lock
+ * dropped.  Unlike cgroup_scan_tasks() there is no heap to allocate and
+ * no sort by start time, and a task that already has the mask costs a
+ * compare, so flipping a large background group is cheap.  cgroup_mutex
+ * keeps tasks from joining or leaving the cpuset meanwhile.  A full
+ * batch in which no task took the mask ends the walk, rather than
+ * retrying the same tasks forever.
  */
-static void update_tasks_cpumask(struct cpuset *cs, struct ptr_heap *heap)
+static void update_tasks_cpumask(struct cpuset *cs)
 {
-	struct cgroup_scanner scan;
+	struct task_struct *batch[CPUSET_UPDATE_BATCH];
+	struct cgroup *cgrp = cs->css.cgroup;
+	struct cgroup_iter it;
+	struct task_struct *tsk;
+	int i, n, moved;
+
+	cpumask_copy(cpus_update, cs->cpus_allowed);
+	cpuset_boost_cpus(cs, cpus_update);
+
+	do {
+		n = 0;
+		cgroup_iter_start(cgrp, &it);
+		while (n < CPUSET_UPDATE_BATCH &&
+		       (tsk = cgroup_iter_next(cgrp, &it))) {
+			if (cpumask_equal(&tsk->cpus_allowed, cpus_update))
+				continue;
+			get_task_struct(tsk);
+			batch[n++] = tsk;
+		}
+		cgroup_iter_end(cgrp, &it);
 
-	scan.cg = cs->css.cgroup;
-	scan.test_task = cpuset_test_cpumask;
-	scan.process_task = cpuset_change_cpumask;
-	scan.heap = heap;
-	cgroup_scan_tasks(&scan);
+		moved = 0;
+		for (i = 0; i < n; i++) {
+			if (!set_cpus_allowed_ptr(batch[i], cpus_update))
+				moved++;
+			put_task_struct(batch[i]);
+		}
+	} while (n == CPUSET_UPDATE_BATCH && moved);
 }
 
 /**
@@ -863,7 +901,6 @@ static void update_tasks_cpumask(struct cpuset *cs, struct ptr_heap *heap)
 static int update_cpumask(struct cpuset *cs, struct cpuset *trialcs,
 			  const char *buf)
 {
-	struct ptr_heap heap;
 	int retval;
 	int is_load_balanced;
 
@@ -895,10 +932,6 @@ static int update_cpumask(struct cpuset *cs, struct cpuset *trialcs,
 	if (cpumask_equal(cs->cpus_allowed, trialcs->cpus_allowed))
 		return 0;
 
-	retval = heap_init(&heap, PAGE_SIZE, GFP_KERNEL, NULL);
-	if (retval)
-		return retval;
-
 	is_load_balanced = is_sched_load_balance(trialcs);
 
 	mutex_lock(&callback_mutex);
@@ -909,15 +942,144 @@ static int update_cpumask(struct cpuset *cs, struct cpuset *trialcs,
 	 * Scan tasks in the cpuset, and update the cpumasks of any
 	 * that need an update.
 	 */
-	update_tasks_cpumask(cs, &heap);
-
-	heap_free(&heap);
+	update_tasks_cpumask(cs);
 
 	if (is_load_balanced)
 		async_rebuild_sched_domains();
 	return 0;
 }
 
+/**
+ * update_boost_cpumask - update the boost_cpus mask of a cpuset
+ * @cs: the cpuset to consider
+ * @buf: buffer of cpu numbers written to this cpuset
+ *
+ * An empty list leaves the cpuset alone while boosted.  The list is
+ * not tied to 'cpus', whatever of it is outside them is ignored.
+ */
+static int update_boost_cpumask(struct cpuset *cs, struct cpuset *trialcs,
+				const char *buf)
+{
+	int retval;
+
+	if (cs == &top_cpuset)
+		return -EACCES;
+
+	if (!*buf) {
+		cpumask_clear(trialcs->boost_cpus);
+	} else {
+		retval = cpulist_parse(buf, trialcs->boost_cpus);
+		if (retval < 0)
+			return retval;
+
+		if (!cpumask_subset(trialcs->boost_cpus, cpu_possible_mask))
+			return -EINVAL;
+	}
+
+	if (cpumask_equal(cs->boost_cpus, trialcs->boost_cpus))
+		return 0;
+
+	mutex_lock(&callback_mutex);
+	cpumask_copy(cs->boost_cpus, trialcs->boost_cpus);
+	mutex_unlock(&callback_mutex);
+
+	if (cpuset_boosted)
+		update_tasks_cpumask(cs);
+	return 0;
+}
+
+/*
+ * Give the tasks of every cpuset with boost cpus the mask that goes
+ * with the current boost state.  Called with cgroup_mutex held.
+ */
+static void update_boost_cpusets(void)
+{
+	LIST_HEAD(queue);
+	struct cpuset *cp;	/* scans cpusets being updated */
+	struct cpuset *child;	/* scans child cpusets of cp */
+	struct cgroup *cont;
+
+	list_add_tail(&top_cpuset.stack_list, &queue);
+
+	while (!list_empty(&queue)) {
+		cp = list_first_entry(&queue, struct cpuset, stack_list);
+		list_del(queue.next);
+		list_for_each_entry(cont, &cp->css.cgroup->children, sibling) {
+			child = cgroup_cs(cont);
+			list_add_tail(&child->stack_list, &queue);
+		}
+
+		if (!cpumask_empty(cp->boost_cpus))
+			update_tasks_cpumask(cp);
+	}
+}
+
+static void cpuset_boost_workfn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(cpuset_boost_work, cpuset_boost_workfn);
+
+static void cpuset_boost_workfn(struct work_struct *work)
+{
+	unsigned long flags;
+	long left;
+	bool boost;
+
+	spin_lock_irqsave(&cpuset_boost_lock, flags);
+	left = (long)(cpuset_boost_until - jiffies);
+	boost = cpuset_boost_held || left > 0;
+	spin_unlock_irqrestore(&cpuset_boost_lock, flags);
+
+	/* come back when the pulse runs out, even under a hold */
+	if (left > 0)
+		queue_delayed_work(cpuset_wq, &cpuset_boost_work, left);
+
+	cgroup_lock();
+	if (boost != cpuset_boosted) {
+		mutex_lock(&callback_mutex);
+		cpuset_boosted = boost;
+		mutex_unlock(&callback_mutex);
+		update_boost_cpusets();
+	}
+	cgroup_unlock();
+}
+
+/**
+ * cpuset_boost - move the boosted cpusets onto their boost cpus
+ * @msecs: how long for, CPUSET_BOOST_HOLD until a later call with 0
+ *
+ * A call with 0 only drops the hold; pulses run out on their own.  May
+ * be called from atomic context, the tasks are moved from the cpuset
+ * workqueue and only when the boost state changes, so pulses that land
+ * while a boost is in effect just push its end out.
+ */
+void cpuset_boost(unsigned int msecs)
+{
+	unsigned long flags, until;
+	bool was, now;
+
+	if (!cpuset_wq)
+		return;
+
+	spin_lock_irqsave(&cpuset_boost_lock, flags);
+	was = cpuset_boost_held || time_before(jiffies, cpuset_boost_until);
+	if (msecs == CPUSET_BOOST_HOLD) {
+		cpuset_boost_held = true;
+	} else if (!msecs) {
+		cpuset_boost_held = false;
+	} else {
+		until = jiffies + msecs_to_jiffies(msecs);
+		if (!was || time_after(until, cpuset_boost_until))
+			cpuset_boost_until = until;
+	}
+	now = cpuset_boost_held || time_before(jiffies, cpuset_boost_until);
+	spin_unlock_irqrestore(&cpuset_boost_lock, flags);
+
+	if (now != was) {
+		cancel_delayed_work(&cpuset_boost_work);
+		queue_delayed_work(cpuset_wq, &cpuset_boost_work, 0);
+	}
+}
+EXPORT_SYMBOL_GPL(cpuset_boost);
+
 /*
  * cpuset_migrate_mm
  *
@@ -1400,8 +1562,10 @@ static int cpuset_can_attach(struct cgroup *cgrp, struct cgroup_taskset *tset)
 	/* prepare for attach */
 	if (cs == &top_cpuset)
 		cpumask_copy(cpus_attach, cpu_possible_mask);
-	else
+	else {
 		guarantee_online_cpus(cs, cpus_attach);
+		cpuset_boost_cpus(cs, cpus_attach);
+	}
 
 	guarantee_online_mems(cs, &cpuset_attach_nodemask_to);
 
@@ -1449,6 +1613,7 @@ static void cpuset_attach(struct cgroup *cgrp, struct cgroup_taskset *tset)
 typedef enum {
 	FILE_MEMORY_MIGRATE,
 	FILE_CPULIST,
+	FILE_BOOST_CPULIST,
 	FILE_MEMLIST,
 	FILE_CPU_EXCLUSIVE,
 	FILE_MEM_EXCLUSIVE,
@@ -1459,6 +1624,7 @@ typedef enum {
 	FILE_MEMORY_PRESSURE,
 	FILE_SPREAD_PAGE,
 	FILE_SPREAD_SLAB,
+	FILE_BOOST,
 } cpuset_filetype_t;
 
 static int cpuset_write_u64(struct cgroup *cgrp, struct cftype *cft, u64 val)
@@ -1489,6 +1655,9 @@ static int cpuset_write_u64(struct cgroup *cgrp, struct cftype *cft, u64 val)
 	case FILE_MEMORY_PRESSURE_ENABLED:
 		cpuset_memory_pressure_enabled = !!val;
 		break;
+	case FILE_BOOST:
+		cpuset_boost(val ? CPUSET_BOOST_HOLD : 0);
+		break;
 	case FILE_MEMORY_PRESSURE:
 		retval = -EACCES;
 		break;
@@ -1550,6 +1719,9 @@ static int cpuset_write_resmask(struct cgroup *cgrp, struct cftype *cft,
 	case FILE_CPULIST:
 		retval = update_cpumask(cs, trialcs, buf);
 		break;
+	case FILE_BOOST_CPULIST:
+		retval = update_boost_cpumask(cs, trialcs, buf);
+		break;
 	case FILE_MEMLIST:
 		retval = update_nodemask(cs, trialcs, buf);
 		break;
@@ -1587,6 +1759,17 @@ static size_t cpuset_sprintf_cpulist(char *page, struct cpuset *cs)
 	return count;
 }
 
+static size_t cpuset_sprintf_boost_cpulist(char *page, struct cpuset *cs)
+{
+	size_t count;
+
+	mutex_lock(&callback_mutex);
+	count = cpulist_scnprintf(page, PAGE_SIZE, cs->boost_cpus);
+	mutex_unlock(&callback_mutex);
+
+	return count;
+}
+
 static size_t cpuset_sprintf_memlist(char *page, struct cpuset *cs)
 {
 	size_t count;
@@ -1619,6 +1802,9 @@ static ssize_t cpuset_common_file_read(struct cgroup *cont,
 	case FILE_CPULIST:
 		s += cpuset_sprintf_cpulist(s, cs);
 		break;
+	case FILE_BOOST_CPULIST:
+		s += cpuset_sprintf_boost_cpulist(s, cs);
+		break;
 	case FILE_MEMLIST:
 		s += cpuset_sprintf_memlist(s, cs);
 		break;
@@ -1657,6 +1843,8 @@ static u64 cpuset_read_u64(struct cgroup *cont, struct cftype *cft)
 		return is_spread_page(cs);
 	case FILE_SPREAD_SLAB:
 		return is_spread_slab(cs);
+	case FILE_BOOST:
+		return cpuset_boosted;
 	default:
 		BUG();
 	}
@@ -1694,6 +1882,14 @@ static struct cftype files[] = {
 		.private = FILE_CPULIST,
 	},
 
+	{
+		.name = "boost_cpus",
+		.read = cpuset_common_file_read,
+		.write_string = cpuset_write_resmask,
+		.max_write_len = (100U + 6 * NR_CPUS),
+		.private = FILE_BOOST_CPULIST,
+	},
+
 	{
 		.name = "mems",
 		.read = cpuset_common_file_read,
@@ -1774,6 +1970,13 @@ static struct cftype cft_memory_pressure_enabled = {
 	.private = FILE_MEMORY_PRESSURE_ENABLED,
 };
 
+static struct cftype cft_boost = {
+	.name = "boost",
+	.read_u64 = cpuset_read_u64,
+	.write_u64 = cpuset_write_u64,
+	.private = FILE_BOOST,
+};
+
 static int cpuset_populate(struct cgroup_subsys *ss, struct cgroup *cont)
 {
 	int err;
@@ -1781,10 +1984,12 @@ static int cpuset_populate(struct cgroup_subsys *ss, struct cgroup *cont)
 	err = cgroup_add_files(cont, ss, files, ARRAY_SIZE(files));
 	if (err)
 		return err;
-	/* memory_pressure_enabled is in root cpuset only */
+	/* memory_pressure_enabled and boost are in root cpuset only */
 	if (!cont->parent)
 		err = cgroup_add_file(cont, ss,
 				      &cft_memory_pressure_enabled);
+	if (!err && !cont->parent)
+		err = cgroup_add_file(cont, ss, &cft_boost);
 	return err;
 }
 
@@ -1846,6 +2051,11 @@ static struct cgroup_subsys_state *cpuset_create(struct cgroup *cont)
 		kfree(cs);
 		return ERR_PTR(-ENOMEM);
 	}
+	if (!alloc_cpumask_var(&cs->boost_cpus, GFP_KERNEL)) {
+		free_cpumask_var(cs->cpus_allowed);
+		kfree(cs);
+		return ERR_PTR(-ENOMEM);
+	}
 
 	cs->flags = 0;
 	if (is_spread_page(parent))
@@ -1854,6 +2064,7 @@ static struct cgroup_subsys_state *cpuset_create(struct cgroup *cont)
 		set_bit(CS_SPREAD_SLAB, &cs->flags);
 	set_bit(CS_SCHED_LOAD_BALANCE, &cs->flags);
 	cpumask_clear(cs->cpus_allowed);
+	cpumask_clear(cs->boost_cpus);
 	nodes_clear(cs->mems_allowed);
 	fmeter_init(&cs->fmeter);
 	cs->relax_domain_level = -1;
@@ -1877,6 +2088,7 @@ static void cpuset_destroy(struct cgroup *cont)
 		update_flag(CS_SCHED_LOAD_BALANCE, cs, 0);
 
 	number_of_cpusets--;
+	free_cpumask_var(cs->boost_cpus);
 	free_cpumask_var(cs->cpus_allowed);
 	kfree(cs);
 }
@@ -1905,6 +2117,8 @@ int __init cpuset_init(void)
 
 	if (!alloc_cpumask_var(&top_cpuset.cpus_allowed, GFP_KERNEL))
 		BUG();
+	if (!zalloc_cpumask_var(&top_cpuset.boost_cpus, GFP_KERNEL))
+		BUG();
 
 	cpumask_setall(top_cpuset.cpus_allowed);
 	nodes_setall(top_cpuset.mems_allowed);
@@ -1919,6 +2133,8 @@ int __init cpuset_init(void)
 
 	if (!alloc_cpumask_var(&cpus_attach, GFP_KERNEL))
 		BUG();
+	if (!alloc_cpumask_var(&cpus_update, GFP_KERNEL))
+		BUG();
 
 	number_of_cpusets = 1;
 	return 0;
@@ -2053,7 +2269,7 @@ static void scan_for_empty_cpusets(struct cpuset *root)
 		     nodes_empty(cp->mems_allowed))
 			remove_tasks_in_empty_cpuset(cp);
 		else {
-			update_tasks_cpumask(cp, NULL);
+			update_tasks_cpumask(cp);
 			update_tasks_nodemask(cp, &oldmems, NULL);
 		}
 	}
@@ -2158,6 +2374,7 @@ void cpuset_cpus_allowed(struct task_struct *tsk, struct cpumask *pmask)
 	mutex_lock(&callback_mutex);
 	task_lock(tsk);
 	guarantee_online_cpus(task_cs(tsk), pmask);
+	cpuset_boost_cpus(task_cs(tsk), pmask);
 	task_unlock(tsk);
 	mutex_unlock(&callback_mutex);
 }
@@ -2178,7 +2395,7 @@ void cpuset_cpus_allowed_fallback(struct task_struct *tsk)
 	 * But we used cs && cs->cpus_allowed lockless and thus can
 	 * race with cgroup_attach_task() or update_cpumask() and get
 	 * the wrong tsk->cpus_allowed. However, both cases imply the
-	 * subsequent cpuset_change_cpumask()->set_cpus_allowed_ptr()
+	 * subsequent update_tasks_cpumask()->set_cpus_allowed_ptr()
 	 * which takes task_rq_lock().
 	 *
 	 * If we are called after it dropped the lock we must see all
@@ -201,6 +201,8 @@ repeat:
 	}
 
 	write_unlock_irq(&tasklist_lock);
+	if (thread_group_leader(p))
+		lmk_adj_index_del(p);
 	release_thread(p);
 	call_rcu(&p->rcu, delayed_put_task_struct);
 
@@ -68,6 +68,8 @@ bool __refrigerator(bool check_kthr_stop)
 
 		if (!(current->flags & PF_FROZEN))
 			break;
+		if (!was_frozen)
+			cgroup_freezer_frozen(current);
 		was_frozen = true;
 		schedule();
 	}
@@ -132,6 +134,38 @@ bool freeze_task(struct task_struct *p)
 	return true;
 }
 
+/**
+ * freeze_task_lazy - send a freeze request without waking @p
+ * @p: task to send the request to
+ *
+ * A user task in interruptible sleep only gets the fake signal flagged
+ * and is left asleep.  It enters the refrigerator on its way back to
+ * user space once something else wakes it.
+ *
+ * RETURNS:
+ * %true, if @p was left asleep; %false, if it needs freeze_task()
+ */
+bool freeze_task_lazy(struct task_struct *p)
+{
+	unsigned long flags, sflags;
+	bool parked = false;
+
+	if (p->flags & PF_KTHREAD)
+		return false;
+
+	spin_lock_irqsave(&freezer_lock, flags);
+	if (freezing(p) && !frozen(p) && lock_task_sighand(p, &sflags)) {
+		/* any later wakeup sees the flag, as after signal_wake_up() */
+		if (p->state == TASK_INTERRUPTIBLE) {
+			set_tsk_thread_flag(p, TIF_SIGPENDING);
+			parked = true;
+		}
+		unlock_task_sighand(p, &sflags);
+	}
+	spin_unlock_irqrestore(&freezer_lock, flags);
+	return parked;
+}
+
 void __thaw_task(struct task_struct *p)
 {
 	unsigned long flags;
@@ -60,6 +60,8 @@
 #include <linux/pid.h>
 #include <linux/nsproxy.h>
 #include <linux/ptrace.h>
+#include <linux/bootmem.h>
+#include <linux/log2.h>
 
 #include <asm/futex.h>
 
@@ -67,7 +69,9 @@
 
 int __read_mostly futex_cmpxchg_enabled;
 
-#define FUTEX_HASHBITS (CONFIG_BASE_SMALL ? 4 : 8)
+/* buckets of the global table per possible cpu, and per process */
+#define FUTEX_HASH_PER_CPU	256
+#define FUTEX_PRIVATE_HASHBITS	5
 
 /*
  * Futex flags used to encode options to functions and preserve them across
@@ -148,19 +152,72 @@ struct futex_hash_bucket {
 	struct plist_head chain;
 };
 
-static struct futex_hash_bucket futex_queues[1<<FUTEX_HASHBITS];
+static struct futex_hash_bucket *futex_queues;
+static unsigned int futex_hashsize;
 
 /*
  * We hash on the keys returned from get_futex_key (see below).
+ * Process private futexes go to the table of their mm, if it has one.
  */
 static struct futex_hash_bucket *hash_futex(union futex_key *key)
 {
 	u32 hash = jhash2((u32*)&key->both.word,
 			  (sizeof(key->both.word)+sizeof(key->both.ptr))/4,
 			  key->both.offset);
-	return &futex_queues[hash & ((1 << FUTEX_HASHBITS)-1)];
+#ifdef CONFIG_FUTEX_PRIVATE_HASH
+	if (!(key->both.offset & (FUT_OFF_INODE | FUT_OFF_MMSHARED)) &&
+	    key->private.mm) {
+		struct futex_hash_bucket *fh =
+			ACCESS_ONCE(key->private.mm->futex_hash);
+
+		if (fh)
+			return &fh[hash & ((1 << FUTEX_PRIVATE_HASHBITS) - 1)];
+	}
+#endif
+	return &futex_queues[hash & (futex_hashsize - 1)];
+}
+
+static void futex_hash_init(struct futex_hash_bucket *fh, unsigned int size)
+{
+	unsigned int i;
+
+	for (i = 0; i < size; i++) {
+		plist_head_init(&fh[i].chain);
+		spin_lock_init(&fh[i].lock);
+	}
+}
+
+#ifdef CONFIG_FUTEX_PRIVATE_HASH
+/**
+ * futex_mm_init() - give a process its own table for private futexes
+ * @mm:		the mm of the current task, about to get a second user
+ *
+ * Private futexes can only be waited on by users of the mm, so while the
+ * current task is the only one nothing can be queued on the global table
+ * yet and the table can be switched.  Without memory the global table
+ * keeps being used.
+ */
+void futex_mm_init(struct mm_struct *mm)
+{
+	struct futex_hash_bucket *fh;
+
+	if (mm->futex_hash || atomic_read(&mm->mm_users) != 1)
+		return;
+
+	fh = kmalloc(sizeof(*fh) << FUTEX_PRIVATE_HASHBITS, GFP_KERNEL);
+	if (!fh)
+		return;
+	futex_hash_init(fh, 1 << FUTEX_PRIVATE_HASHBITS);
+	mm->futex_hash = fh;
 }
 
+void futex_mm_free(struct mm_struct *mm)
+{
+	kfree(mm->futex_hash);
+	mm->futex_hash = NULL;
+}
+#endif
+
 /*
  * Return 1 if two futex_keys are equal, 0 otherwise.
  */
@@ -2709,8 +2766,8 @@ SYSCALL_DEFINE6(futex, u32 __user *, uaddr, int, op, u32, val,
 
 static int __init futex_init(void)
 {
+	unsigned int futex_shift = 4;
 	u32 curval;
-	int i;
 
 	/*
 	 * This will fail and we want it. Some arch implementations do
@@ -2725,10 +2782,22 @@ static int __init futex_init(void)
 	if (cmpxchg_futex_value_locked(&curval, NULL, 0, 0) == -EFAULT)
 		futex_cmpxchg_enabled = 1;
 
-	for (i = 0; i < ARRAY_SIZE(futex_queues); i++) {
-		plist_head_init(&futex_queues[i].chain);
-		spin_lock_init(&futex_queues[i].lock);
-	}
+	/*
+	 * One bucket per 64k of low memory, but no more than
+	 * FUTEX_HASH_PER_CPU per possible cpu.
+	 */
+#if CONFIG_BASE_SMALL
+	futex_hashsize = 16;
+#else
+	futex_hashsize = roundup_pow_of_two(FUTEX_HASH_PER_CPU *
+					    num_possible_cpus());
+#endif
+	futex_queues = alloc_large_system_hash("futex",
+					       sizeof(*futex_queues), 0, 16,
+					       HASH_SMALL, &futex_shift, NULL,
+					       futex_hashsize);
+	futex_hashsize = 1U << futex_shift;
+	futex_hash_init(futex_queues, futex_hashsize);
 
 	return 0;
 }
@@ -159,8 +159,8 @@ struct hrtimer_clock_base *lock_hrtimer_base(const struct hrtimer *timer,
 static int hrtimer_get_target(int this_cpu, int pinned)
 {
 #ifdef CONFIG_NO_HZ
-	if (!pinned && get_sysctl_timer_migration() && idle_cpu(this_cpu))
-		return get_nohz_timer_target();
+	if (!pinned && get_sysctl_timer_migration())
+		return get_unpinned_timer_target();
 #endif
 	return this_cpu;
 }
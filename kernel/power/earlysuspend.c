@@ -13,10 +13,13 @@
  *
  */
 
+#include <linux/debugfs.h>
 #include <linux/earlysuspend.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/rtc.h>
+#include <linux/seq_file.h>
 #include <linux/wakelock.h>
 #include <linux/workqueue.h>
 
@@ -30,6 +33,10 @@ enum {
 static int debug_mask = DEBUG_USER_STATE;
 module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/* handlers of the same level run concurrently, see early_suspend_call_all() */
+static bool parallel = true;
+module_param(parallel, bool, S_IRUGO | S_IWUSR | S_IWGRP);
+
 static DEFINE_MUTEX(early_suspend_lock);
 static LIST_HEAD(early_suspend_handlers);
 static void early_suspend(struct work_struct *work);
@@ -44,10 +51,67 @@ enum {
 };
 static int state;
 
+static void early_suspend_call(struct work_struct *work)
+{
+	struct early_suspend *h = container_of(work, struct early_suspend,
+					       work);
+	ktime_t start = ktime_get();
+
+	if (h->resuming) {
+		if (debug_mask & DEBUG_VERBOSE)
+			pr_info("late_resume: calling %pf\n", h->resume);
+		h->resume(h);
+		h->resume_us = ktime_us_delta(ktime_get(), start);
+	} else {
+		if (debug_mask & DEBUG_VERBOSE)
+			pr_info("early_suspend: calling %pf\n", h->suspend);
+		h->suspend(h);
+		h->suspend_us = ktime_us_delta(ktime_get(), start);
+	}
+}
+
+/*
+ * Call the suspend hooks in increasing level order, or the resume hooks in
+ * decreasing level order.  The handlers of one level are called at the same
+ * time from the unbound workqueue, and all of them finish before the next
+ * level starts.  Called with early_suspend_lock held.
+ */
+static void early_suspend_call_all(bool resume)
+{
+	struct list_head *head = &early_suspend_handlers;
+	struct list_head *p, *q, *start = NULL;
+	struct early_suspend *h;
+
+	for (p = resume ? head->prev : head->next; ;
+	     p = resume ? p->prev : p->next) {
+		h = list_entry(p, struct early_suspend, link);
+		if (start && (p == head || h->level !=
+		    list_entry(start, struct early_suspend, link)->level)) {
+			for (q = start; q != p; q = resume ? q->prev : q->next)
+				flush_work(&list_entry(q, struct early_suspend,
+						       link)->work);
+			start = NULL;
+		}
+		if (p == head)
+			break;
+		if (!(resume ? h->resume : h->suspend))
+			continue;
+
+		h->resuming = resume;
+		if (!start)
+			start = p;
+		if (parallel)
+			queue_work(system_unbound_wq, &h->work);
+		else
+			early_suspend_call(&h->work);
+	}
+}
+
 void register_early_suspend(struct early_suspend *handler)
 {
 	struct list_head *pos;
 
+	INIT_WORK(&handler->work, early_suspend_call);
 	mutex_lock(&early_suspend_lock);
 	list_for_each(pos, &early_suspend_handlers) {
 		struct early_suspend *e;
@@ -72,7 +136,6 @@ EXPORT_SYMBOL(unregister_early_suspend);
 
 static void early_suspend(struct work_struct *work)
 {
-	struct early_suspend *pos;
 	unsigned long irqflags;
 	int abort = 0;
 
@@ -93,13 +156,7 @@ static void early_suspend(struct work_struct *work)
 
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("early_suspend: call handlers\n");
-	list_for_each_entry(pos, &early_suspend_handlers, link) {
-		if (pos->suspend != NULL) {
-			if (debug_mask & DEBUG_VERBOSE)
-				pr_info("early_suspend: calling %pf\n", pos->suspend);
-			pos->suspend(pos);
-		}
-	}
+	early_suspend_call_all(false);
 	mutex_unlock(&early_suspend_lock);
 
 	suspend_sys_sync_queue();
@@ -112,7 +169,6 @@ abort:
 
 static void late_resume(struct work_struct *work)
 {
-	struct early_suspend *pos;
 	unsigned long irqflags;
 	int abort = 0;
 
@@ -131,14 +187,7 @@ static void late_resume(struct work_struct *work)
 	}
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: call handlers\n");
-	list_for_each_entry_reverse(pos, &early_suspend_handlers, link) {
-		if (pos->resume != NULL) {
-			if (debug_mask & DEBUG_VERBOSE)
-				pr_info("late_resume: calling %pf\n", pos->resume);
-
-			pos->resume(pos);
-		}
-	}
+	early_suspend_call_all(true);
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: done\n");
 abort:
@@ -181,3 +230,40 @@ suspend_state_t get_suspend_state(void)
 {
 	return requested_suspend_state;
 }
+
+#ifdef CONFIG_DEBUG_FS
+static int early_suspend_stats_show(struct seq_file *s, void *unused)
+{
+	struct early_suspend *pos;
+
+	seq_puts(s, "level  suspend_us   resume_us  handler\n");
+	mutex_lock(&early_suspend_lock);
+	list_for_each_entry(pos, &early_suspend_handlers, link)
+		seq_printf(s, "%5d  %10u  %10u  %pf\n", pos->level,
+			   pos->suspend_us, pos->resume_us,
+			   pos->suspend ? (void *)pos->suspend :
+					  (void *)pos->resume);
+	mutex_unlock(&early_suspend_lock);
+	return 0;
+}
+
+static int early_suspend_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, early_suspend_stats_show, NULL);
+}
+
+static const struct file_operations early_suspend_stats_fops = {
+	.open		= early_suspend_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init early_suspend_debugfs_init(void)
+{
+	debugfs_create_file("early_suspend_stats", S_IFREG | S_IRUGO, NULL,
+			    NULL, &early_suspend_stats_fops);
+	return 0;
+}
+late_initcall(early_suspend_debugfs_init);
+#endif
@@ -42,7 +42,10 @@ module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 
 static DEFINE_SPINLOCK(list_lock);
 static LIST_HEAD(inactive_locks);
+/* active locks without a timeout */
 static struct list_head active_wake_locks[WAKE_LOCK_TYPE_COUNT];
+/* active locks with a timeout, sorted by expiry */
+static struct list_head timed_wake_locks[WAKE_LOCK_TYPE_COUNT];
 static int current_event_num;
 static int suspend_sys_sync_count;
 static DEFINE_SPINLOCK(suspend_sys_sync_lock);
@@ -56,9 +59,21 @@ static struct wake_lock suspend_backoff_lock;
 
 #define SUSPEND_BACKOFF_THRESHOLD	10
 #define SUSPEND_BACKOFF_INTERVAL	10000
+/* first delay after the same wake lock aborted two suspends in a row */
+#define SUSPEND_ABORT_BACKOFF_MIN	100
 
 static unsigned suspend_short_count;
 
+/*
+ * The first suspend lock taken while pm_suspend() runs is what aborted
+ * it, if it fails.  The lock that aborted the last attempts and how many
+ * times in a row it did set the next suspend_abort_backoff() delay.
+ */
+static bool suspend_attempt;
+static struct wake_lock *suspend_abort_source;
+static struct wake_lock *last_abort_source;
+static unsigned suspend_abort_streak;
+
 #ifdef CONFIG_WAKELOCK_STAT
 static struct wake_lock deleted_wake_locks;
 static ktime_t last_sleep_time_update;
@@ -140,6 +155,38 @@ static int wakelock_stats_show(struct seq_file *m, void *unused)
 	for (type = 0; type < WAKE_LOCK_TYPE_COUNT; type++) {
 		list_for_each_entry(lock, &active_wake_locks[type], link)
 			ret = print_lock_stat(m, lock);
+		list_for_each_entry(lock, &timed_wake_locks[type], link)
+			ret = print_lock_stat(m, lock);
+	}
+	spin_unlock_irqrestore(&list_lock, irqflags);
+	return 0;
+}
+
+static void print_lock_aborts(struct seq_file *m, struct wake_lock *lock)
+{
+	if (lock->stat.abort_count)
+		seq_printf(m, "\"%s\"\t%d\n", lock->name,
+			   lock->stat.abort_count);
+}
+
+static int suspend_aborts_show(struct seq_file *m, void *unused)
+{
+	unsigned long irqflags;
+	struct wake_lock *lock;
+	int type;
+
+	spin_lock_irqsave(&list_lock, irqflags);
+	seq_printf(m, "streak\t%u\t\"%s\"\n", suspend_abort_streak,
+		   !suspend_abort_streak ? "" :
+		   last_abort_source ? last_abort_source->name : "unknown");
+	seq_puts(m, "name\tabort_count\n");
+	list_for_each_entry(lock, &inactive_locks, link)
+		print_lock_aborts(m, lock);
+	for (type = 0; type < WAKE_LOCK_TYPE_COUNT; type++) {
+		list_for_each_entry(lock, &active_wake_locks[type], link)
+			print_lock_aborts(m, lock);
+		list_for_each_entry(lock, &timed_wake_locks[type], link)
+			print_lock_aborts(m, lock);
 	}
 	spin_unlock_irqrestore(&list_lock, irqflags);
 	return 0;
@@ -171,29 +218,38 @@ static void wake_unlock_stat_locked(struct wake_lock *lock, int expired)
 	}
 }
 
+static void update_sleep_wait_stats_lock(struct wake_lock *lock, int done,
+					 ktime_t elapsed)
+{
+	ktime_t etime, add;
+	int expired;
+
+	expired = get_expired_time(lock, &etime);
+	if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND) {
+		if (expired)
+			add = ktime_sub(etime, last_sleep_time_update);
+		else
+			add = elapsed;
+		lock->stat.prevent_suspend_time = ktime_add(
+			lock->stat.prevent_suspend_time, add);
+	}
+	if (done || expired)
+		lock->flags &= ~WAKE_LOCK_PREVENTING_SUSPEND;
+	else
+		lock->flags |= WAKE_LOCK_PREVENTING_SUSPEND;
+}
+
 static void update_sleep_wait_stats_locked(int done)
 {
 	struct wake_lock *lock;
-	ktime_t now, etime, elapsed, add;
-	int expired;
+	ktime_t now, elapsed;
 
 	now = ktime_get();
 	elapsed = ktime_sub(now, last_sleep_time_update);
-	list_for_each_entry(lock, &active_wake_locks[WAKE_LOCK_SUSPEND], link) {
-		expired = get_expired_time(lock, &etime);
-		if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND) {
-			if (expired)
-				add = ktime_sub(etime, last_sleep_time_update);
-			else
-				add = elapsed;
-			lock->stat.prevent_suspend_time = ktime_add(
-				lock->stat.prevent_suspend_time, add);
-		}
-		if (done || expired)
-			lock->flags &= ~WAKE_LOCK_PREVENTING_SUSPEND;
-		else
-			lock->flags |= WAKE_LOCK_PREVENTING_SUSPEND;
-	}
+	list_for_each_entry(lock, &active_wake_locks[WAKE_LOCK_SUSPEND], link)
+		update_sleep_wait_stats_lock(lock, done, elapsed);
+	list_for_each_entry(lock, &timed_wake_locks[WAKE_LOCK_SUSPEND], link)
+		update_sleep_wait_stats_lock(lock, done, elapsed);
 	last_sleep_time_update = now;
 }
 #endif
@@ -219,38 +275,56 @@ static void print_active_locks(int type)
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
 	list_for_each_entry(lock, &active_wake_locks[type], link) {
-		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
-			long timeout = lock->expires - jiffies;
-			if (timeout > 0)
-				pr_info("active wake lock %s, time left %ld\n",
-					lock->name, timeout);
-			else if (print_expired)
-				pr_info("wake lock %s, expired\n", lock->name);
-		} else {
-			pr_info("active wake lock %s\n", lock->name);
-			if (!(debug_mask & DEBUG_EXPIRE))
-				print_expired = false;
-		}
+		pr_info("active wake lock %s\n", lock->name);
+		if (!(debug_mask & DEBUG_EXPIRE))
+			print_expired = false;
+	}
+	list_for_each_entry(lock, &timed_wake_locks[type], link) {
+		long timeout = lock->expires - jiffies;
+		if (timeout > 0)
+			pr_info("active wake lock %s, time left %ld\n",
+				lock->name, timeout);
+		else if (print_expired)
+			pr_info("wake lock %s, expired\n", lock->name);
 	}
 }
 
+/* Expire the timed locks whose timeout has passed, oldest first */
+static void expire_wake_locks_locked(int type)
+{
+	struct wake_lock *lock;
+
+	while (!list_empty(&timed_wake_locks[type])) {
+		lock = list_first_entry(&timed_wake_locks[type],
+					struct wake_lock, link);
+		if ((long)(lock->expires - jiffies) > 0)
+			break;
+		expire_wake_lock(lock);
+	}
+}
+
+/*
+ * Only the list heads are looked at: any lock without a timeout keeps the
+ * system awake for good, otherwise the timed lock that expires last
+ * decides.  Locks expire from expire_timer, or here once all of them have.
+ */
 static long has_wake_lock_locked(int type)
 {
-	struct wake_lock *lock, *n;
-	long max_timeout = 0;
+	struct wake_lock *lock;
+	long timeout;
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
-	list_for_each_entry_safe(lock, n, &active_wake_locks[type], link) {
-		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
-			long timeout = lock->expires - jiffies;
-			if (timeout <= 0)
-				expire_wake_lock(lock);
-			else if (timeout > max_timeout)
-				max_timeout = timeout;
-		} else
-			return -1;
-	}
-	return max_timeout;
+	if (!list_empty(&active_wake_locks[type]))
+		return -1;
+	if (list_empty(&timed_wake_locks[type]))
+		return 0;
+
+	lock = list_entry(timed_wake_locks[type].prev, struct wake_lock, link);
+	timeout = lock->expires - jiffies;
+	if (timeout > 0)
+		return timeout;
+	expire_wake_locks_locked(type);
+	return 0;
 }
 
 long has_wake_lock(int type)
@@ -336,11 +410,51 @@ static void suspend_backoff(void)
 			  msecs_to_jiffies(SUSPEND_BACKOFF_INTERVAL));
 }
 
+/*
+ * Called with the result of pm_suspend() and the lock that was taken
+ * first while it ran.  A lock that aborts suspend again and again keeps
+ * getting taken right after it is released, so retrying as soon as it
+ * is released only cycles through the device suspend callbacks.  Hold the
+ * system awake for an exponentially growing time instead, until that
+ * lock lets a suspend through.
+ */
+static long suspend_abort_backoff_locked(int ret, struct wake_lock *source)
+{
+	unsigned int delay;
+
+	if (!ret) {
+		suspend_abort_streak = 0;
+		last_abort_source = NULL;
+		return 0;
+	}
+
+#ifdef CONFIG_WAKELOCK_STAT
+	if (source)
+		source->stat.abort_count++;
+#endif
+	if (suspend_abort_streak && source == last_abort_source) {
+		suspend_abort_streak++;
+	} else {
+		suspend_abort_streak = 1;
+		last_abort_source = source;
+	}
+	if (suspend_abort_streak < 2)
+		return 0;
+
+	delay = SUSPEND_ABORT_BACKOFF_MIN << min(suspend_abort_streak - 2, 7U);
+	delay = min(delay, (unsigned int)SUSPEND_BACKOFF_INTERVAL);
+	pr_info("suspend: aborted %u times by %s, back off %u ms\n",
+		suspend_abort_streak, source ? source->name : "a device", delay);
+	return msecs_to_jiffies(delay);
+}
+
 static void suspend(struct work_struct *work)
 {
 	int ret;
 	int entry_event_num;
 	struct timespec ts_entry, ts_exit;
+	unsigned long irqflags;
+	long backoff;
 
 	if (has_wake_lock(WAKE_LOCK_SUSPEND)) {
 		if (debug_mask & DEBUG_SUSPEND)
@@ -353,7 +467,15 @@ static void suspend(struct work_struct *work)
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("suspend: enter suspend\n");
 	getnstimeofday(&ts_entry);
+	spin_lock_irqsave(&list_lock, irqflags);
+	suspend_attempt = true;
+	suspend_abort_source = NULL;
+	spin_unlock_irqrestore(&list_lock, irqflags);
 	ret = pm_suspend(requested_suspend_state);
+	spin_lock_irqsave(&list_lock, irqflags);
+	suspend_attempt = false;
+	backoff = suspend_abort_backoff_locked(ret, suspend_abort_source);
+	spin_unlock_irqrestore(&list_lock, irqflags);
 	getnstimeofday(&ts_exit);
 
 	if (debug_mask & DEBUG_EXIT_SUSPEND) {
@@ -381,9 +503,33 @@ static void suspend(struct work_struct *work)
 			pr_info("suspend: pm_suspend returned with no event\n");
 		wake_lock_timeout(&unknown_wakeup, HZ / 2);
 	}
+	if (backoff)
+		wake_lock_timeout(&suspend_backoff_lock, backoff);
 }
 static DECLARE_WORK(suspend_work, suspend);
 
+static void expire_wake_locks(unsigned long data);
+static DEFINE_TIMER(expire_timer, expire_wake_locks, 0, 0);
+
+/* Keep expire_timer set to the first timeout of a suspend lock */
+static void update_expire_timer_locked(const char *who)
+{
+	struct list_head *timed = &timed_wake_locks[WAKE_LOCK_SUSPEND];
+	struct wake_lock *first;
+
+	if (list_empty(timed)) {
+		if (del_timer(&expire_timer) && (debug_mask & DEBUG_EXPIRE))
+			pr_info("%s, stop expire timer\n", who);
+		return;
+	}
+
+	first = list_first_entry(timed, struct wake_lock, link);
+	if (debug_mask & DEBUG_EXPIRE)
+		pr_info("%s, start expire timer, %ld\n", who,
+			(long)(first->expires - jiffies));
+	mod_timer(&expire_timer, first->expires);
+}
+
 static void expire_wake_locks(unsigned long data)
 {
 	long has_lock;
@@ -393,14 +539,16 @@ static void expire_wake_locks(unsigned long data)
 	spin_lock_irqsave(&list_lock, irqflags);
 	if (debug_mask & DEBUG_SUSPEND)
 		print_active_locks(WAKE_LOCK_SUSPEND);
+	expire_wake_locks_locked(WAKE_LOCK_SUSPEND);
 	has_lock = has_wake_lock_locked(WAKE_LOCK_SUSPEND);
 	if (debug_mask & DEBUG_EXPIRE)
 		pr_info("expire_wake_locks: done, has_lock %ld\n", has_lock);
 	if (has_lock == 0)
 		queue_work(suspend_work_queue, &suspend_work);
+	else
+		update_expire_timer_locked("expire_wake_locks");
 	spin_unlock_irqrestore(&list_lock, irqflags);
 }
-static DEFINE_TIMER(expire_timer, expire_wake_locks, 0, 0);
 
 static int power_suspend_late(struct device *dev)
 {
@@ -439,6 +587,7 @@ void wake_lock_init(struct wake_lock *lock, int type, const char *name)
 	lock->stat.count = 0;
 	lock->stat.expire_count = 0;
 	lock->stat.wakeup_count = 0;
+	lock->stat.abort_count = 0;
 	lock->stat.total_time = ktime_set(0, 0);
 	lock->stat.prevent_suspend_time = ktime_set(0, 0);
 	lock->stat.max_time = ktime_set(0, 0);
@@ -464,6 +613,7 @@ void wake_lock_destroy(struct wake_lock *lock)
 	if (lock->stat.count) {
 		deleted_wake_locks.stat.count += lock->stat.count;
 		deleted_wake_locks.stat.expire_count += lock->stat.expire_count;
+		deleted_wake_locks.stat.abort_count += lock->stat.abort_count;
 		deleted_wake_locks.stat.total_time =
 			ktime_add(deleted_wake_locks.stat.total_time,
 				  lock->stat.total_time);
@@ -475,6 +625,12 @@ void wake_lock_destroy(struct wake_lock *lock)
 				  lock->stat.max_time);
 	}
 #endif
+	if (suspend_abort_source == lock)
+		suspend_abort_source = NULL;
+	if (last_abort_source == lock) {
+		last_abort_source = NULL;
+		suspend_abort_streak = 0;
+	}
 	list_del(&lock->link);
 	spin_unlock_irqrestore(&list_lock, irqflags);
 }
@@ -485,7 +641,7 @@ static void wake_lock_internal(
 {
 	int type;
 	unsigned long irqflags;
-	long expire_in;
+	struct wake_lock *pos;
 
 	spin_lock_irqsave(&list_lock, irqflags);
 	type = lock->flags & WAKE_LOCK_TYPE_MASK;
@@ -518,7 +674,11 @@ static void wake_lock_internal(
 				(timeout % HZ) * MSEC_PER_SEC / HZ);
 		lock->expires = jiffies + timeout;
 		lock->flags |= WAKE_LOCK_AUTO_EXPIRE;
-		list_add_tail(&lock->link, &active_wake_locks[type]);
+		/* new timeouts mostly end last, search from the tail */
+		list_for_each_entry_reverse(pos, &timed_wake_locks[type], link)
+			if ((long)(pos->expires - lock->expires) <= 0)
+				break;
+		list_add(&lock->link, &pos->link);
 	} else {
 		if (debug_mask & DEBUG_WAKE_LOCK)
 			pr_info("wake_lock: %s, type %d\n", lock->name, type);
@@ -528,28 +688,18 @@ static void wake_lock_internal(
 	}
 	if (type == WAKE_LOCK_SUSPEND) {
 		current_event_num++;
+		if (suspend_attempt && !suspend_abort_source)
+			suspend_abort_source = lock;
 #ifdef CONFIG_WAKELOCK_STAT
 		if (lock == &main_wake_lock)
 			update_sleep_wait_stats_locked(1);
 		else if (!wake_lock_active(&main_wake_lock))
 			update_sleep_wait_stats_locked(0);
 #endif
-		if (has_timeout)
-			expire_in = has_wake_lock_locked(type);
-		else
-			expire_in = -1;
-		if (expire_in > 0) {
-			if (debug_mask & DEBUG_EXPIRE)
-				pr_info("wake_lock: %s, start expire timer, "
-					"%ld\n", lock->name, expire_in);
-			mod_timer(&expire_timer, jiffies + expire_in);
-		} else {
-			if (del_timer(&expire_timer))
-				if (debug_mask & DEBUG_EXPIRE)
-					pr_info("wake_lock: %s, stop expire timer\n",
-						lock->name);
-			if (expire_in == 0)
+		if (has_timeout) {
+			if (has_wake_lock_locked(type) == 0)
 				queue_work(suspend_work_queue, &suspend_work);
+			update_expire_timer_locked(lock->name);
 		}
 	}
 	spin_unlock_irqrestore(&list_lock, irqflags);
@@ -582,20 +732,9 @@ void wake_unlock(struct wake_lock *lock)
 	list_del(&lock->link);
 	list_add(&lock->link, &inactive_locks);
 	if (type == WAKE_LOCK_SUSPEND) {
-		long has_lock = has_wake_lock_locked(type);
-		if (has_lock > 0) {
-			if (debug_mask & DEBUG_EXPIRE)
-				pr_info("wake_unlock: %s, start expire timer, "
-					"%ld\n", lock->name, has_lock);
-			mod_timer(&expire_timer, jiffies + has_lock);
-		} else {
-			if (del_timer(&expire_timer))
-				if (debug_mask & DEBUG_EXPIRE)
-					pr_info("wake_unlock: %s, stop expire "
-						"timer\n", lock->name);
-			if (has_lock == 0)
-				queue_work(suspend_work_queue, &suspend_work);
-		}
+		if (has_wake_lock_locked(type) == 0)
+			queue_work(suspend_work_queue, &suspend_work);
+		update_expire_timer_locked(lock->name);
 		if (lock == &main_wake_lock) {
 			if (debug_mask & DEBUG_SUSPEND)
 				print_active_locks(WAKE_LOCK_SUSPEND);
@@ -627,13 +766,28 @@ static const struct file_operations wakelock_stats_fops = {
 	.release = single_release,
 };
 
+static int suspend_aborts_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, suspend_aborts_show, NULL);
+}
+
+static const struct file_operations suspend_aborts_fops = {
+	.owner = THIS_MODULE,
+	.open = suspend_aborts_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int __init wakelocks_init(void)
 {
 	int ret;
 	int i;
 
-	for (i = 0; i < ARRAY_SIZE(active_wake_locks); i++)
+	for (i = 0; i < ARRAY_SIZE(active_wake_locks); i++) {
 		INIT_LIST_HEAD(&active_wake_locks[i]);
+		INIT_LIST_HEAD(&timed_wake_locks[i]);
+	}
 
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_lock_init(&deleted_wake_locks, WAKE_LOCK_SUSPEND,
@@ -672,6 +826,7 @@ static int __init wakelocks_init(void)
 
 #ifdef CONFIG_WAKELOCK_STAT
 	proc_create("wakelocks", S_IRUGO, NULL, &wakelock_stats_fops);
+	proc_create("suspend_aborts", S_IRUGO, NULL, &suspend_aborts_fops);
 #endif
 
 	return 0;
@@ -694,6 +849,7 @@ err_platform_device_register:
 static void  __exit wakelocks_exit(void)
 {
 #ifdef CONFIG_WAKELOCK_STAT
+	remove_proc_entry("suspend_aborts", NULL);
 	remove_proc_entry("wakelocks", NULL);
 #endif
 	destroy_workqueue(suspend_work_queue);
@@ -17,6 +17,7 @@
  */
 
 #include <linux/kernel.h>
+#include <linux/kthread.h>
 #include <linux/mm.h>
 #include <linux/tty.h>
 #include <linux/tty_driver.h>
@@ -759,6 +760,15 @@ module_param_named(time, printk_time, bool, S_IRUGO | S_IWUSR);
 static bool always_kmsg_dump;
 module_param_named(always_kmsg_dump, always_kmsg_dump, bool, S_IRUGO | S_IWUSR);
 
+#if defined(CONFIG_PRINTK_ASYNC)
+static bool printk_async = 1;
+#else
+static bool printk_async = 0;
+#endif
+module_param_named(async, printk_async, bool, S_IRUGO | S_IWUSR);
+
+static bool printk_defer_console(int level);
+
 /* Check if we have any console registered that can be called early in boot. */
 static int have_callable_console(void)
 {
@@ -1024,8 +1034,13 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 	 * The console_trylock_for_printk() function
 	 * will release 'logbuf_lock' regardless of whether it
 	 * actually gets the semaphore or not.
+	 *
+	 * Unless the console thread is going to print it instead.
 	 */
-	if (console_trylock_for_printk(this_cpu))
+	if (printk_defer_console(current_log_level)) {
+		printk_cpu = UINT_MAX;
+		raw_spin_unlock(&logbuf_lock);
+	} else if (console_trylock_for_printk(this_cpu))
 		console_unlock();
 
 	lockdep_on();
@@ -1300,10 +1315,69 @@ int is_console_locked(void)
 
 #define PRINTK_PENDING_WAKEUP	0x01
 #define PRINTK_PENDING_SCHED	0x02
+#define PRINTK_PENDING_CONSOLE	0x04
 
 static DEFINE_PER_CPU(int, printk_pending);
 static DEFINE_PER_CPU(char [PRINTK_BUF_SIZE], printk_sched_buf);
 
+#ifdef CONFIG_PRINTK
+static struct task_struct *console_thread;
+static DECLARE_WAIT_QUEUE_HEAD(console_wait);
+
+/*
+ * Called from vprintk() with logbuf_lock held, where nothing can be
+ * woken up safely: the thread is woken from the next tick instead.
+ * KERN_EMERG messages go out right away, they may be the last ones.
+ */
+static bool printk_defer_console(int level)
+{
+	if (!printk_async || !console_thread || oops_in_progress ||
+	    system_state != SYSTEM_RUNNING || level == 0)
+		return false;
+
+	this_cpu_or(printk_pending, PRINTK_PENDING_CONSOLE);
+	return true;
+}
+
+static int console_thread_fn(void *data)
+{
+	set_user_nice(current, 19);
+
+	while (!kthread_should_stop()) {
+		wait_event_interruptible(console_wait,
+					 con_start != log_end ||
+					 kthread_should_stop());
+		console_lock();
+		console_unlock();
+	}
+	return 0;
+}
+
+static int __init console_thread_init(void)
+{
+	struct task_struct *t;
+
+	t = kthread_run(console_thread_fn, NULL, "kconsole");
+	if (IS_ERR(t)) {
+		pr_err("printk: cannot start console thread, printing "
+		       "synchronously\n");
+		return PTR_ERR(t);
+	}
+	console_thread = t;
+	return 0;
+}
+late_initcall(console_thread_init);
+
+static void wake_up_console_thread(void)
+{
+	wake_up_interruptible(&console_wait);
+}
+#else
+static inline void wake_up_console_thread(void)
+{
+}
+#endif
+
 void printk_tick(void)
 {
 	if (__this_cpu_read(printk_pending)) {
@@ -1314,6 +1388,8 @@ void printk_tick(void)
 		}
 		if (pending & PRINTK_PENDING_WAKEUP)
 			wake_up_interruptible(&log_wait);
+		if (pending & PRINTK_PENDING_CONSOLE)
+			wake_up_console_thread();
 	}
 }
 
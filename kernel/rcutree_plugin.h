@@ -74,7 +74,8 @@ static void __init rcu_bootup_announce_oddness(void)
 
 #ifdef CONFIG_TREE_PREEMPT_RCU
 
-struct rcu_state rcu_preempt_state = RCU_STATE_INITIALIZER(rcu_preempt);
+struct rcu_state rcu_preempt_state =
+	RCU_STATE_INITIALIZER(rcu_preempt, call_rcu);
 DEFINE_PER_CPU(struct rcu_data, rcu_preempt_data);
 static struct rcu_state *rcu_state = &rcu_preempt_state;
 
@@ -1969,20 +1970,24 @@ static void rcu_prepare_for_idle(int cpu)
  *	permitted to sleep in dyntick-idle mode with only lazy RCU
  *	callbacks pending.  Setting this too high can OOM your system.
  *
- * The values below work well in practice.  If future workloads require
- * adjustment, they can be converted into kernel config parameters, though
- * making the state machine smarter might be a better option.
+ * The two delays are the defaults of the rcu_idle_gp_delay and
+ * rcu_idle_lazy_gp_delay module parameters, so that platforms whose
+ * idle states are expensive to leave can trade grace-period latency
+ * for fewer wakeups.
  */
 #define RCU_IDLE_FLUSHES 5		/* Number of dyntick-idle tries. */
 #define RCU_IDLE_OPT_FLUSHES 3		/* Optional dyntick-idle tries. */
 #define RCU_IDLE_GP_DELAY 6		/* Roughly one grace period. */
 #define RCU_IDLE_LAZY_GP_DELAY (6 * HZ)	/* Roughly six seconds. */
 
+static int rcu_idle_gp_delay = RCU_IDLE_GP_DELAY;
+module_param(rcu_idle_gp_delay, int, 0644);
+static int rcu_idle_lazy_gp_delay = RCU_IDLE_LAZY_GP_DELAY;
+module_param(rcu_idle_lazy_gp_delay, int, 0644);
+
 static DEFINE_PER_CPU(int, rcu_dyntick_drain);
 static DEFINE_PER_CPU(unsigned long, rcu_dyntick_holdoff);
 static DEFINE_PER_CPU(struct hrtimer, rcu_idle_gp_timer);
-static ktime_t rcu_idle_gp_wait;	/* If some non-lazy callbacks. */
-static ktime_t rcu_idle_lazy_gp_wait;	/* If only lazy callbacks. */
 
 /*
  * Allow the CPU to enter dyntick-idle mode if either: (1) There are no
@@ -2062,19 +2067,22 @@ static enum hrtimer_restart rcu_idle_gp_timer_func(struct hrtimer *hrtp)
  */
 static void rcu_prepare_for_idle_init(int cpu)
 {
-	static int firsttime = 1;
 	struct hrtimer *hrtp = &per_cpu(rcu_idle_gp_timer, cpu);
 
 	hrtimer_init(hrtp, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
 	hrtp->function = rcu_idle_gp_timer_func;
-	if (firsttime) {
-		unsigned int upj = jiffies_to_usecs(RCU_IDLE_GP_DELAY);
+}
 
-		rcu_idle_gp_wait = ns_to_ktime(upj * (u64)1000);
-		upj = jiffies_to_usecs(RCU_IDLE_LAZY_GP_DELAY);
-		rcu_idle_lazy_gp_wait = ns_to_ktime(upj * (u64)1000);
-		firsttime = 0;
-	}
+/*
+ * Start the timer that pulls this CPU out of dyntick-idle mode after
+ * @delay jiffies.
+ */
+static void rcu_idle_gp_timer_start(int cpu, int delay)
+{
+	unsigned int upj = jiffies_to_usecs(max(delay, 1));
+
+	hrtimer_start(&per_cpu(rcu_idle_gp_timer, cpu),
+		      ns_to_ktime(upj * (u64)1000), HRTIMER_MODE_REL);
 }
 
 /*
@@ -2140,11 +2148,9 @@ static void rcu_prepare_for_idle(int cpu)
 		per_cpu(rcu_dyntick_drain, cpu) = 0;
 		per_cpu(rcu_dyntick_holdoff, cpu) = jiffies;
 		if (rcu_cpu_has_nonlazy_callbacks(cpu))
-			hrtimer_start(&per_cpu(rcu_idle_gp_timer, cpu),
-				      rcu_idle_gp_wait, HRTIMER_MODE_REL);
+			rcu_idle_gp_timer_start(cpu, rcu_idle_gp_delay);
 		else
-			hrtimer_start(&per_cpu(rcu_idle_gp_timer, cpu),
-				      rcu_idle_lazy_gp_wait, HRTIMER_MODE_REL);
+			rcu_idle_gp_timer_start(cpu, rcu_idle_lazy_gp_delay);
 		return; /* Nothing more to do immediately. */
 	} else if (--per_cpu(rcu_dyntick_drain, cpu) <= 0) {
 		/* We have hit the limit, so time to give up. */
@@ -2299,3 +2305,199 @@ static void increment_cpu_stall_ticks(void)
 }
 
 #endif /* #else #ifdef CONFIG_RCU_CPU_STALL_INFO */
+
+#ifdef CONFIG_RCU_NOCB_CPU
+
+/*
+ * Offload callback processing from the CPUs in rcu_nocb_mask.  Their
+ * callbacks go on a separate lockless list which a per-CPU, per-flavor
+ * "rcuo" kthread empties: it waits for a grace period with the
+ * flavor's own call_rcu() and then invokes the whole batch, all on
+ * the CPUs outside the mask.  An offloaded CPU therefore never has
+ * callbacks of its own and can stay in dyntick-idle mode, though it
+ * still reports quiescent states as usual.
+ *
+ * CPU 0 is never offloaded, it runs the kthreads and queues their
+ * grace-period callbacks.
+ */
+static cpumask_t rcu_nocb_mask;
+static cpumask_t rcu_nocb_housekeeping_mask;
+
+/* Parse the boot-time rcu_nocbs= CPU list. */
+static int __init rcu_nocb_setup(char *str)
+{
+	cpulist_parse(str, &rcu_nocb_mask);
+	return 1;
+}
+__setup("rcu_nocbs=", rcu_nocb_setup);
+
+/* Is the specified CPU a no-CBs CPU? */
+static bool is_nocb_cpu(int cpu)
+{
+	return cpumask_test_cpu(cpu, &rcu_nocb_mask);
+}
+
+/*
+ * Enqueue the specified callback onto the specified rcu_data structure's
+ * no-CBs list and wake up its kthread if the list was empty.  Returns
+ * false if the callback is to be handled by the caller as usual.  The
+ * caller must have disabled interrupts.
+ */
+static bool __call_rcu_nocb(struct rcu_data *rdp, struct rcu_head *rhp,
+			    bool lazy)
+{
+	struct rcu_head **old_rhpp;
+	struct task_struct *t;
+	long c, cl;
+
+	/*
+	 * The kthread waits for its grace period with a callback of its
+	 * own, which would never be invoked if it went on its own list.
+	 */
+	if (!is_nocb_cpu(rdp->cpu) || current == rdp->nocb_kthread)
+		return false;
+
+	old_rhpp = xchg(&rdp->nocb_tail, &rhp->next);
+	ACCESS_ONCE(*old_rhpp) = rhp;
+	c = atomic_long_inc_return(&rdp->nocb_q_count);
+	if (lazy)
+		atomic_long_inc(&rdp->nocb_q_count_lazy);
+	cl = atomic_long_read(&rdp->nocb_q_count_lazy);
+
+	if (__is_kfree_rcu_offset((unsigned long)rhp->func))
+		trace_rcu_kfree_callback(rdp->rsp->name, rhp,
+					 (unsigned long)rhp->func, cl, c);
+	else
+		trace_rcu_callback(rdp->rsp->name, rhp, cl, c);
+
+	/* Callbacks queued before the kthreads exist wait for them. */
+	t = ACCESS_ONCE(rdp->nocb_kthread);
+	if (t && old_rhpp == &rdp->nocb_head)
+		wake_up(&rdp->nocb_wq);
+	return true;
+}
+
+/*
+ * Per-rcu_data kthread that waits for callbacks, waits for a grace
+ * period on their behalf and then invokes them.
+ */
+static int rcu_nocb_kthread(void *arg)
+{
+	struct rcu_data *rdp = arg;
+	struct rcu_head *list;
+	struct rcu_head *next;
+	struct rcu_head **tail;
+	long c, cl;
+
+	for (;;) {
+		wait_event_interruptible(rdp->nocb_wq,
+					 ACCESS_ONCE(rdp->nocb_head));
+		list = ACCESS_ONCE(rdp->nocb_head);
+		if (!list) {
+			flush_signals(current);
+			continue;
+		}
+
+		/* Take the whole list, later callbacks start a new one. */
+		ACCESS_ONCE(rdp->nocb_head) = NULL;
+		tail = xchg(&rdp->nocb_tail, &rdp->nocb_head);
+		c = atomic_long_xchg(&rdp->nocb_q_count, 0);
+		cl = atomic_long_xchg(&rdp->nocb_q_count_lazy, 0);
+
+		wait_rcu_gp(rdp->rsp->call);
+
+		trace_rcu_batch_start(rdp->rsp->name, cl, c, -1);
+		c = cl = 0;
+		while (list) {
+			next = list->next;
+			/* An enqueue may still be linking in the last one. */
+			while (next == NULL && &list->next != tail) {
+				schedule_timeout_interruptible(1);
+				next = ACCESS_ONCE(list->next);
+			}
+			debug_rcu_head_unqueue(list);
+			local_bh_disable();
+			if (__rcu_reclaim(rdp->rsp->name, list))
+				cl++;
+			c++;
+			local_bh_enable();
+			list = next;
+		}
+		trace_rcu_batch_end(rdp->rsp->name, c, 0, 0, 0, 0);
+		rdp->n_cbs_invoked += c;
+	}
+	return 0;
+}
+
+/* Initialize the no-CBs list of the specified rcu_data structure. */
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp)
+{
+	rdp->nocb_tail = &rdp->nocb_head;
+	init_waitqueue_head(&rdp->nocb_wq);
+}
+
+/* Settle the set of no-CBs CPUs, before any callback is queued. */
+static void __init rcu_init_nocb(void)
+{
+#ifdef CONFIG_RCU_NOCB_CPU_ALL
+	if (cpumask_empty(&rcu_nocb_mask))
+		cpumask_copy(&rcu_nocb_mask, cpu_possible_mask);
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU_ALL */
+	cpumask_and(&rcu_nocb_mask, &rcu_nocb_mask, cpu_possible_mask);
+	cpumask_clear_cpu(0, &rcu_nocb_mask);
+	cpumask_andnot(&rcu_nocb_housekeeping_mask, cpu_possible_mask,
+		       &rcu_nocb_mask);
+	if (!cpumask_empty(&rcu_nocb_mask)) {
+		char buf[32];
+
+		cpulist_scnprintf(buf, sizeof(buf), &rcu_nocb_mask);
+		pr_info("\tOffload RCU callbacks from CPUs: %s.\n", buf);
+	}
+}
+
+/* Create the no-CBs kthreads of one RCU flavor. */
+static void __init rcu_spawn_nocb_kthreads(struct rcu_state *rsp)
+{
+	struct rcu_data *rdp;
+	struct task_struct *t;
+	int cpu;
+
+	for_each_cpu(cpu, &rcu_nocb_mask) {
+		rdp = per_cpu_ptr(rsp->rda, cpu);
+		t = kthread_create(rcu_nocb_kthread, rdp, "rcuo%c/%d",
+				   rsp->name[4], cpu);
+		BUG_ON(IS_ERR(t));
+		set_cpus_allowed_ptr(t, &rcu_nocb_housekeeping_mask);
+		ACCESS_ONCE(rdp->nocb_kthread) = t;
+		wake_up_process(t);
+	}
+}
+
+static int __init rcu_spawn_nocb_kthreads_all(void)
+{
+	rcu_spawn_nocb_kthreads(&rcu_sched_state);
+	rcu_spawn_nocb_kthreads(&rcu_bh_state);
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	rcu_spawn_nocb_kthreads(&rcu_preempt_state);
+#endif /* #ifdef CONFIG_TREE_PREEMPT_RCU */
+	return 0;
+}
+early_initcall(rcu_spawn_nocb_kthreads_all);
+
+#else /* #ifdef CONFIG_RCU_NOCB_CPU */
+
+static bool __call_rcu_nocb(struct rcu_data *rdp, struct rcu_head *rhp,
+			    bool lazy)
+{
+	return false;
+}
+
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp)
+{
+}
+
+static void __init rcu_init_nocb(void)
+{
+}
+
+#endif /* #else #ifdef CONFIG_RCU_NOCB_CPU */
@@ -569,6 +569,27 @@ unlock:
 	rcu_read_unlock();
 	return cpu;
 }
+
+/*
+ * CPU to queue a timer that is not pinned on.  With timer_migration set
+ * to 2 the first online CPU, which hotplug takes down last, keeps these
+ * timers whenever it is busy anyway, so the other cores are only woken
+ * for their own work.  Otherwise a timer stays on this CPU unless it is
+ * idle.
+ */
+int get_unpinned_timer_target(void)
+{
+	int cpu = smp_processor_id();
+	int hk;
+
+	if (get_sysctl_timer_migration() > 1) {
+		hk = cpumask_first(cpu_online_mask);
+		if (hk != cpu && !idle_cpu(hk))
+			return hk;
+	}
+	return idle_cpu(cpu) ? get_nohz_timer_target() : cpu;
+}
+
 /*
  * When add_timer_on() enqueues a timer into the timer wheel of an
  * idle CPU then this timer might expire before the next timer event
@@ -1082,6 +1103,36 @@ void check_preempt_curr(struct rq *rq, struct task_struct *p, int flags)
 		rq->skip_clock_update = 1;
 }
 
+sched_load_hook_t sched_load_hook __read_mostly;
+
+/**
+ * sched_register_load_hook - get told about large cpu load changes
+ * @hook: called on a large change of a runqueue's load and whenever a
+ *	  fair task migrates; see SCHED_LOAD_* in linux/sched.h
+ *
+ * Only one hook can be registered at a time.
+ */
+int sched_register_load_hook(sched_load_hook_t hook)
+{
+	if (cmpxchg(&sched_load_hook, NULL, hook))
+		return -EBUSY;
+	return 0;
+}
+EXPORT_SYMBOL_GPL(sched_register_load_hook);
+
+/**
+ * sched_unregister_load_hook - stop calling @hook
+ * @hook: hook passed to sched_register_load_hook()
+ *
+ * On return no cpu is running @hook any more.
+ */
+void sched_unregister_load_hook(sched_load_hook_t hook)
+{
+	if (cmpxchg(&sched_load_hook, hook, NULL) == hook)
+		synchronize_sched();
+}
+EXPORT_SYMBOL_GPL(sched_unregister_load_hook);
+
 #ifdef CONFIG_SMP
 void set_task_cpu(struct task_struct *p, unsigned int new_cpu)
 {
@@ -1114,6 +1165,9 @@ void set_task_cpu(struct task_struct *p, unsigned int new_cpu)
 	if (task_cpu(p) != new_cpu) {
 		p->se.nr_migrations++;
 		perf_sw_event(PERF_COUNT_SW_CPU_MIGRATIONS, 1, NULL, 0);
+		if (p->sched_class == &fair_sched_class)
+			sched_load_notify(new_cpu, SCHED_LOAD_MIGRATE,
+					  task_cpu(p));
 	}
 
 	__set_task_cpu(p, new_cpu);
@@ -1416,6 +1470,10 @@ ttwu_do_wakeup(struct rq *rq, struct task_struct *p, int wake_flags)
 	check_preempt_curr(rq, p, wake_flags);
 
 	p->state = TASK_RUNNING;
+#ifdef CONFIG_SCHED_WAKEUP_HIST
+	if (p != rq->curr)
+		p->wakeup_ts = rq->clock;
+#endif
 #ifdef CONFIG_SMP
 	if (p->sched_class->task_woken)
 		p->sched_class->task_woken(rq, p);
@@ -1458,6 +1516,8 @@ static int ttwu_remote(struct task_struct *p, int wake_flags)
 
 	rq = __task_rq_lock(p);
 	if (p->on_rq) {
+		/* nothing is enqueued, so the clock has not been updated */
+		update_rq_clock(rq);
 		ttwu_do_wakeup(rq, p, wake_flags);
 		ret = 1;
 	}
@@ -1713,8 +1773,15 @@ static void __sched_fork(struct task_struct *p)
 	p->se.sum_exec_runtime		= 0;
 	p->se.prev_sum_exec_runtime	= 0;
 	p->se.nr_migrations		= 0;
+#ifdef CONFIG_SMP
+	p->se.wake_runtime		= 0;
+	p->se.avg_burst			= 0;
+#endif
 	p->se.vruntime			= 0;
 	INIT_LIST_HEAD(&p->se.group_node);
+#ifdef CONFIG_SCHED_WAKEUP_HIST
+	p->wakeup_ts			= 0;
+#endif
 
 #ifdef CONFIG_SCHEDSTATS
 	memset(&p->se.statistics, 0, sizeof(p->se.statistics));
@@ -2112,6 +2179,17 @@ unsigned long nr_running(void)
 	return sum;
 }
 
+/* like nr_running(), but only the tasks of groups with cpu.boost set */
+unsigned long nr_boosted_running(void)
+{
+	unsigned long i, sum = 0;
+
+	for_each_online_cpu(i)
+		sum += cpu_rq(i)->nr_boosted;
+
+	return sum;
+}
+
 unsigned long nr_uninterruptible(void)
 {
 	unsigned long i, sum = 0;
@@ -3173,6 +3251,37 @@ pick_next_task(struct rq *rq)
 /*
  * __schedule() is the main scheduler function.
  */
+#ifdef CONFIG_SCHED_WAKEUP_HIST
+/*
+ * Account the time @next waited since its wakeup.  Only the first run
+ * after a wakeup counts; a task that is preempted, or that was woken
+ * before it got to sleep, waits for no wakeup.
+ */
+static inline void wakeup_hist_account(struct rq *rq, struct task_struct *prev,
+				       struct task_struct *next)
+{
+	struct wakeup_hist *hist;
+	u64 delta;
+	int bucket;
+
+	prev->wakeup_ts = 0;
+	if (!next->wakeup_ts)
+		return;
+
+	delta = rq->clock - next->wakeup_ts;
+	next->wakeup_ts = 0;
+	bucket = clamp(fls64(delta) - 10, 0, WAKEUP_HIST_BUCKETS - 1);
+
+	hist = this_cpu_ptr(task_group(next)->wakeup_hist);
+	hist->count[rt_task(next) ? WAKEUP_HIST_RT : WAKEUP_HIST_FAIR][bucket]++;
+}
+#else
+static inline void wakeup_hist_account(struct rq *rq, struct task_struct *prev,
+				       struct task_struct *next)
+{
+}
+#endif
+
 static void __sched __schedule(void)
 {
 	struct task_struct *prev, *next;
@@ -3227,6 +3336,7 @@ need_resched:
 	next = pick_next_task(rq);
 	clear_tsk_need_resched(prev);
 	rq->skip_clock_update = 0;
+	wakeup_hist_account(rq, prev, next);
 
 	if (likely(prev != next)) {
 		rq->nr_switches++;
@@ -6891,7 +7001,7 @@ void __init sched_init_smp(void)
 }
 #endif /* CONFIG_SMP */
 
-const_debug unsigned int sysctl_timer_migration = 1;
+unsigned int __read_mostly sysctl_timer_migration = 2;
 
 int in_sched_functions(unsigned long addr)
 {
@@ -6964,6 +7074,11 @@ void __init sched_init(void)
 	INIT_LIST_HEAD(&root_task_group.children);
 	INIT_LIST_HEAD(&root_task_group.siblings);
 	autogroup_init(&init_task);
+#ifdef CONFIG_SCHED_WAKEUP_HIST
+	root_task_group.wakeup_hist = alloc_percpu(struct wakeup_hist);
+	/* Too early, not expected to fail */
+	BUG_ON(!root_task_group.wakeup_hist);
+#endif
 
 #endif /* CONFIG_CGROUP_SCHED */
 
@@ -7254,6 +7369,9 @@ static void free_sched_group(struct task_group *tg)
 	free_fair_sched_group(tg);
 	free_rt_sched_group(tg);
 	autogroup_free(tg);
+#ifdef CONFIG_SCHED_WAKEUP_HIST
+	free_percpu(tg->wakeup_hist);
+#endif
 	kfree(tg);
 }
 
@@ -7273,6 +7391,12 @@ struct task_group *sched_create_group(struct task_group *parent)
 	if (!alloc_rt_sched_group(tg, parent))
 		goto err;
 
+#ifdef CONFIG_SCHED_WAKEUP_HIST
+	tg->wakeup_hist = alloc_percpu(struct wakeup_hist);
+	if (!tg->wakeup_hist)
+		goto err;
+#endif
+
 	spin_lock_irqsave(&task_group_lock, flags);
 	list_add_rcu(&tg->list, &task_groups);
 
@@ -7738,6 +7862,27 @@ static u64 cpu_shares_read_u64(struct cgroup *cgrp, struct cftype *cft)
 	return (u64) scale_load_down(tg->shares);
 }
 
+/*
+ * Tasks of a boosted group preempt the tasks of other groups on wakeup,
+ * ask the frequency governor for a fast cpu and count twice towards the
+ * run queue average used for hotplug.  Allowed on the root group too,
+ * which is where Android keeps the foreground.
+ */
+static int cpu_boost_write_u64(struct cgroup *cgrp, struct cftype *cftype,
+			       u64 boost)
+{
+	if (boost > 1)
+		return -EINVAL;
+
+	cgroup_tg(cgrp)->boost = boost;
+	return 0;
+}
+
+static u64 cpu_boost_read_u64(struct cgroup *cgrp, struct cftype *cft)
+{
+	return cgroup_tg(cgrp)->boost;
+}
+
 #ifdef CONFIG_CFS_BANDWIDTH
 static DEFINE_MUTEX(cfs_constraints_mutex);
 
@@ -7994,6 +8139,40 @@ static u64 cpu_rt_period_read_uint(struct cgroup *cgrp, struct cftype *cft)
 }
 #endif /* CONFIG_RT_GROUP_SCHED */
 
+#ifdef CONFIG_SCHED_WAKEUP_HIST
+/*
+ * A header line with the lower bound of each bucket in ns, then one
+ * line of counts per cpu and class.  The counts are never reset.
+ */
+static int cpu_wakeup_hist_show(struct cgroup *cgrp, struct cftype *cft,
+				struct seq_file *m)
+{
+	static const char * const names[NR_WAKEUP_HIST_CLASSES] = {
+		[WAKEUP_HIST_RT]	= "rt",
+		[WAKEUP_HIST_FAIR]	= "fair",
+	};
+	struct task_group *tg = cgroup_tg(cgrp);
+	struct wakeup_hist *hist;
+	int cpu, class, i;
+
+	seq_puts(m, "ns");
+	for (i = 0; i < WAKEUP_HIST_BUCKETS; i++)
+		seq_printf(m, " %lu", i ? 1UL << (i + 9) : 0);
+	seq_putc(m, '\n');
+
+	for_each_possible_cpu(cpu) {
+		hist = per_cpu_ptr(tg->wakeup_hist, cpu);
+		for (class = 0; class < NR_WAKEUP_HIST_CLASSES; class++) {
+			seq_printf(m, "cpu%d %s", cpu, names[class]);
+			for (i = 0; i < WAKEUP_HIST_BUCKETS; i++)
+				seq_printf(m, " %u", hist->count[class][i]);
+			seq_putc(m, '\n');
+		}
+	}
+	return 0;
+}
+#endif /* CONFIG_SCHED_WAKEUP_HIST */
+
 static struct cftype cpu_files[] = {
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	{
@@ -8001,6 +8180,11 @@ static struct cftype cpu_files[] = {
 		.read_u64 = cpu_shares_read_u64,
 		.write_u64 = cpu_shares_write_u64,
 	},
+	{
+		.name = "boost",
+		.read_u64 = cpu_boost_read_u64,
+		.write_u64 = cpu_boost_write_u64,
+	},
 #endif
 #ifdef CONFIG_CFS_BANDWIDTH
 	{
@@ -8030,6 +8214,12 @@ static struct cftype cpu_files[] = {
 		.write_u64 = cpu_rt_period_write_uint,
 	},
 #endif
+#ifdef CONFIG_SCHED_WAKEUP_HIST
+	{
+		.name = "wakeup_hist",
+		.read_seq_string = cpu_wakeup_hist_show,
+	},
+#endif
 };
 
 static int cpu_cgroup_populate(struct cgroup_subsys *ss, struct cgroup *cont)
@@ -89,6 +89,17 @@ unsigned int normalized_sysctl_sched_wakeup_granularity = 1000000UL;
 
 const_debug unsigned int sysctl_sched_migration_cost = 500000UL;
 
+#ifdef CONFIG_SMP
+/*
+ * Tasks of nice 0 or lower priority that run less than
+ * sysctl_sched_small_task_ns per wakeup on average are woken on an
+ * already busy cpu of the cache domain rather than on an idle one.
+ * (default: 2 msec, units: nanoseconds)
+ */
+unsigned int sysctl_sched_energy_pack = 1;
+unsigned int sysctl_sched_small_task_ns = 2000000UL;
+#endif
+
 /*
  * The exponential sliding  window over which load is averaged for shares
  * distribution.
@@ -1082,6 +1093,32 @@ place_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int initial)
 
 static void check_enqueue_throttle(struct cfs_rq *cfs_rq);
 
+#ifdef CONFIG_SMP
+static inline void burst_start(struct sched_entity *se)
+{
+	if (entity_is_task(se))
+		se->wake_runtime = se->sum_exec_runtime;
+}
+
+/* Average of how long the task ran between wakeup and going to sleep */
+static inline void burst_end(struct sched_entity *se)
+{
+	if (entity_is_task(se)) {
+		u64 burst = se->sum_exec_runtime - se->wake_runtime;
+
+		se->avg_burst = (3 * se->avg_burst + burst) >> 2;
+	}
+}
+#else
+static inline void burst_start(struct sched_entity *se)
+{
+}
+
+static inline void burst_end(struct sched_entity *se)
+{
+}
+#endif
+
 static void
 enqueue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int flags)
 {
@@ -1103,6 +1140,7 @@ enqueue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int flags)
 	if (flags & ENQUEUE_WAKEUP) {
 		place_entity(cfs_rq, se, 0);
 		enqueue_sleeper(cfs_rq, se);
+		burst_start(se);
 	}
 
 	update_stats_enqueue(cfs_rq, se);
@@ -1174,6 +1212,7 @@ dequeue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int flags)
 
 	update_stats_dequeue(cfs_rq, se);
 	if (flags & DEQUEUE_SLEEP) {
+		burst_end(se);
 #ifdef CONFIG_SCHEDSTATS
 		if (entity_is_task(se)) {
 			struct task_struct *tsk = task_of(se);
@@ -2170,6 +2209,51 @@ static inline void hrtick_update(struct rq *rq)
 }
 #endif
 
+#ifdef CONFIG_FAIR_GROUP_SCHED
+static inline int task_boosted(struct task_struct *p)
+{
+	return task_cfs_rq(p)->tg->boost;
+}
+
+/*
+ * Count the tasks of boosted groups per rq and point the frequency
+ * governor at a cpu one of them just woke up on.
+ */
+static inline void boost_enqueue(struct rq *rq, struct task_struct *p,
+				 int flags)
+{
+	p->se.boosted = task_boosted(p);
+	if (!p->se.boosted)
+		return;
+
+	rq->nr_boosted++;
+	if (flags & ENQUEUE_WAKEUP)
+		sched_load_notify(cpu_of(rq), SCHED_LOAD_BOOST, -1);
+}
+
+static inline void boost_dequeue(struct rq *rq, struct task_struct *p)
+{
+	if (p->se.boosted) {
+		rq->nr_boosted--;
+		p->se.boosted = 0;
+	}
+}
+#else
+static inline int task_boosted(struct task_struct *p)
+{
+	return 0;
+}
+
+static inline void boost_enqueue(struct rq *rq, struct task_struct *p,
+				 int flags)
+{
+}
+
+static inline void boost_dequeue(struct rq *rq, struct task_struct *p)
+{
+}
+#endif
+
 /*
  * The enqueue_task method is called before nr_running is
  * increased. Here we update the fair scheduling stats and
@@ -2181,6 +2265,8 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	struct cfs_rq *cfs_rq;
 	struct sched_entity *se = &p->se;
 
+	boost_enqueue(rq, p, flags);
+
 	for_each_sched_entity(se) {
 		if (se->on_rq)
 			break;
@@ -2213,6 +2299,7 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 
 	if (!se)
 		inc_nr_running(rq);
+	sched_load_check(rq);
 	hrtick_update(rq);
 }
 
@@ -2229,6 +2316,8 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	struct sched_entity *se = &p->se;
 	int task_sleep = flags & DEQUEUE_SLEEP;
 
+	boost_dequeue(rq, p);
+
 	for_each_sched_entity(se) {
 		cfs_rq = cfs_rq_of(se);
 		dequeue_entity(cfs_rq, se, flags);
@@ -2272,6 +2361,7 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 
 	if (!se)
 		dec_nr_running(rq);
+	sched_load_check(rq);
 	hrtick_update(rq);
 }
 
@@ -2681,6 +2771,50 @@ done:
 	return target;
 }
 
+unsigned long __weak arch_cpu_power_cost(int cpu)
+{
+	return 0;
+}
+
+/*
+ * Wake a small task on a cpu of the cache domain that is running exactly
+ * one task, the cheapest one by arch_cpu_power_cost(), so that idle cpus
+ * stay idle and can be taken offline.  Tasks with a raised priority are
+ * treated as latency sensitive and left to select_idle_sibling().
+ *
+ * Returns -1 if the task is not small or no busy cpu is suitable.
+ */
+static int select_packing_cpu(struct task_struct *p, int target)
+{
+	unsigned long cost, best_cost = ULONG_MAX;
+	struct sched_domain *sd;
+	int i, best = -1;
+
+	if (!sysctl_sched_energy_pack || p->prio < DEFAULT_PRIO ||
+	    !p->se.avg_burst || p->se.avg_burst >= sysctl_sched_small_task_ns)
+		return -1;
+
+	sd = rcu_dereference(per_cpu(sd_llc, target));
+	if (!sd)
+		return -1;
+
+	for_each_cpu_and(i, sched_domain_span(sd), tsk_cpus_allowed(p)) {
+		struct rq *rq = cpu_rq(i);
+
+		if (idle_cpu(i) || rq->nr_running != 1 || rq->rt.rt_nr_running)
+			continue;
+
+		/* on a tie stay on target, then prefer the lowest cpu */
+		cost = arch_cpu_power_cost(i);
+		if (cost < best_cost || (cost == best_cost && i == target)) {
+			best_cost = cost;
+			best = i;
+		}
+	}
+
+	return best;
+}
+
 /*
  * sched_balance_self: balance the current task (running on cpu) in domains
  * that have the 'flag' flag set. In practice, this is SD_BALANCE_FORK and
@@ -2765,7 +2899,9 @@ select_task_rq_fair(struct task_struct *p, int sd_flag, int wake_flags)
 		if (cpu == prev_cpu || wake_affine(affine_sd, p, sync))
 			prev_cpu = cpu;
 
-		new_cpu = select_idle_sibling(p, prev_cpu);
+		new_cpu = select_packing_cpu(p, prev_cpu);
+		if (new_cpu < 0)
+			new_cpu = select_idle_sibling(p, prev_cpu);
 		goto unlock;
 	}
 
@@ -2941,6 +3077,13 @@ static void check_preempt_wakeup(struct rq *rq, struct task_struct *p, int wake_
 	if (unlikely(p->policy != SCHED_NORMAL))
 		return;
 
+	/* Latency critical groups do not wait for the wakeup granularity */
+	if (task_boosted(p) && !task_boosted(curr)) {
+		if (!next_buddy_marked)
+			set_next_buddy(pse);
+		goto preempt;
+	}
+
 	find_matching_se(&se, &pse);
 	update_curr(cfs_rq_of(se));
 	BUG_ON(!pse);
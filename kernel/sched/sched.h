@@ -101,6 +101,24 @@ struct cfs_bandwidth {
 };
 
 /* task group related information */
+#ifdef CONFIG_SCHED_WAKEUP_HIST
+/*
+ * Wakeup to run latency of the tasks in a group, bucket 0 is below
+ * 1024ns and bucket i up from 2^(i + 9)ns.  See cpu.wakeup_hist.
+ */
+#define WAKEUP_HIST_BUCKETS	16
+
+enum {
+	WAKEUP_HIST_RT,
+	WAKEUP_HIST_FAIR,
+	NR_WAKEUP_HIST_CLASSES
+};
+
+struct wakeup_hist {
+	unsigned int count[NR_WAKEUP_HIST_CLASSES][WAKEUP_HIST_BUCKETS];
+};
+#endif
+
 struct task_group {
 	struct cgroup_subsys_state css;
 
@@ -110,6 +128,8 @@ struct task_group {
 	/* runqueue "owned" by this group on each cpu */
 	struct cfs_rq **cfs_rq;
 	unsigned long shares;
+	/* tasks are latency critical, see cpu.boost */
+	unsigned int boost;
 
 	atomic_t load_weight;
 #endif
@@ -128,6 +148,10 @@ struct task_group {
 	struct list_head siblings;
 	struct list_head children;
 
+#ifdef CONFIG_SCHED_WAKEUP_HIST
+	struct wakeup_hist __percpu *wakeup_hist;
+#endif
+
 #ifdef CONFIG_SCHED_AUTOGROUP
 	struct autogroup *autogroup;
 #endif
@@ -365,6 +389,8 @@ struct rq {
 
 	/* capture load from *all* tasks on this cpu: */
 	struct load_weight load;
+	/* load.weight when the load hook was last called */
+	unsigned long load_notified;
 	unsigned long nr_load_updates;
 	u64 nr_switches;
 
@@ -386,6 +412,8 @@ struct rq {
 	 * it on another CPU. Always updated under the runqueue lock:
 	 */
 	unsigned long nr_uninterruptible;
+	/* queued fair tasks of boosted groups */
+	unsigned long nr_boosted;
 
 	struct task_struct *curr, *idle, *stop;
 	unsigned long next_balance;
@@ -914,6 +942,37 @@ extern void cpuacct_charge(struct task_struct *tsk, u64 cputime);
 static inline void cpuacct_charge(struct task_struct *tsk, u64 cputime) {}
 #endif
 
+extern sched_load_hook_t sched_load_hook;
+
+static inline void sched_load_notify(int cpu, int event, int src_cpu)
+{
+	sched_load_hook_t hook = ACCESS_ONCE(sched_load_hook);
+
+	if (hook)
+		hook(cpu, event, src_cpu);
+}
+
+/*
+ * Tell the load hook when the load of @rq at least doubled or halved,
+ * give or take half a nice 0 task, since it was last told.
+ */
+static inline void sched_load_check(struct rq *rq)
+{
+	unsigned long load = rq->load.weight;
+	unsigned long old = rq->load_notified;
+
+	if (!ACCESS_ONCE(sched_load_hook))
+		return;
+
+	if (load >= 2 * old + NICE_0_LOAD / 2) {
+		rq->load_notified = load;
+		sched_load_notify(cpu_of(rq), SCHED_LOAD_RISE, -1);
+	} else if (2 * load + NICE_0_LOAD / 2 <= old) {
+		rq->load_notified = load;
+		sched_load_notify(cpu_of(rq), SCHED_LOAD_DROP, -1);
+	}
+}
+
 static inline void inc_nr_running(struct rq *rq)
 {
 	rq->nr_running++;
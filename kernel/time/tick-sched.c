@@ -21,6 +21,7 @@
 #include <linux/sched.h>
 #include <linux/module.h>
 #include <linux/rq_stats.h>
+#include <linux/vmstat.h>
 
 #include <asm/irq_regs.h>
 
@@ -407,6 +408,8 @@ static void tick_nohz_stop_sched_tick(struct tick_sched *ts)
 		 */
 		if (!ts->tick_stopped) {
 			select_nohz_load_balancer(1);
+			if (ts->inidle)
+				quiet_vmstat();
 
 			ts->idle_tick = hrtimer_get_expires(&ts->sched_timer);
 			ts->tick_stopped = 1;
@@ -780,7 +783,8 @@ static void update_rq_stats(void)
 		if (!rq_info.rq_avg)
 			rq_info.rq_poll_total_jiffies = 0;
 
-		rq_avg = nr_running() * 10;
+		/* tasks of boosted groups count twice */
+		rq_avg = (nr_running() + nr_boosted_running()) * 10;
 
 		if (rq_info.rq_poll_total_jiffies) {
 			rq_avg = (rq_avg * jiffy_gap) +
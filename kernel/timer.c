@@ -731,8 +731,8 @@ __mod_timer(struct timer_list *timer, unsigned long expires,
 	cpu = smp_processor_id();
 
 #if defined(CONFIG_NO_HZ) && defined(CONFIG_SMP)
-	if (!pinned && get_sysctl_timer_migration() && idle_cpu(cpu))
-		cpu = get_nohz_timer_target();
+	if (!pinned && get_sysctl_timer_migration())
+		cpu = get_unpinned_timer_target();
 #endif
 	new_base = per_cpu(tvec_bases, cpu);
 
@@ -38,6 +38,7 @@
 #include <linux/poll.h>
 #include <linux/nmi.h>
 #include <linux/fs.h>
+#include <linux/workqueue.h>
 #include <linux/coresight-stm.h>
 
 #include "trace.h"
@@ -384,7 +385,7 @@ EXPORT_SYMBOL_GPL(tracing_on);
 void tracing_off(void)
 {
 	if (global_trace.buffer)
-		ring_buffer_record_on(global_trace.buffer);
+		ring_buffer_record_off(global_trace.buffer);
 	/*
 	 * This flag is only looked at when buffers haven't been
 	 * allocated yet. We don't really care about the race
@@ -3028,12 +3029,10 @@ static int __tracing_resize_ring_buffer(unsigned long size)
 	return ret;
 }
 
-static ssize_t tracing_resize_ring_buffer(unsigned long size)
+static ssize_t tracing_resize_ring_buffer_locked(unsigned long size)
 {
 	int cpu, ret = size;
 
-	mutex_lock(&trace_types_lock);
-
 	tracing_stop();
 
 	/* disable all cpu buffers */
@@ -3058,11 +3057,69 @@ static ssize_t tracing_resize_ring_buffer(unsigned long size)
 	}
 
 	tracing_start();
+
+	return ret;
+}
+
+static ssize_t tracing_resize_ring_buffer(unsigned long size)
+{
+	ssize_t ret;
+
+	mutex_lock(&trace_types_lock);
+	ret = tracing_resize_ring_buffer_locked(size);
 	mutex_unlock(&trace_types_lock);
 
 	return ret;
 }
 
+/*
+ * Once no tracer and no event has used the ring buffers for
+ * buffer_idle_shrink_sec seconds, they are shrunk to the minimum and
+ * expand again on the next use, like they do the first time.  A trace
+ * that was stopped with tracing_off(), from tracing_on or an event
+ * trigger, is kept for as long as tracing stays off.
+ */
+static unsigned long buffer_idle_shrink_sec;
+static unsigned long buffer_last_use;
+
+static void tracing_idle_shrink(struct work_struct *work);
+static DECLARE_DELAYED_WORK(tracing_idle_shrink_work, tracing_idle_shrink);
+
+static void tracing_idle_shrink(struct work_struct *work)
+{
+	unsigned long idle = buffer_idle_shrink_sec * HZ;
+
+	mutex_lock(&trace_types_lock);
+	if (!idle || !ring_buffer_expanded || !tracing_is_on() ||
+	    current_trace != &nop_trace || ftrace_events_enabled)
+		goto out;
+
+	/* the buffers were expanded again for an event about to start */
+	if (time_before(jiffies, buffer_last_use + idle)) {
+		schedule_delayed_work(&tracing_idle_shrink_work,
+				      buffer_last_use + idle - jiffies);
+		goto out;
+	}
+
+	/* expand to the size that was in use, not the boot default */
+	if (global_trace.entries)
+		trace_buf_size = global_trace.entries;
+	if (tracing_resize_ring_buffer_locked(0) >= 0)
+		ring_buffer_expanded = 0;
+ out:
+	mutex_unlock(&trace_types_lock);
+}
+
+void tracing_buffers_idle(void)
+{
+	if (!buffer_idle_shrink_sec)
+		return;
+
+	buffer_last_use = jiffies;
+	schedule_delayed_work(&tracing_idle_shrink_work,
+			      buffer_idle_shrink_sec * HZ);
+}
+
 
 /**
  * tracing_update_buffers - used by tracing facility to expand ring buffers
@@ -3081,6 +3138,7 @@ int tracing_update_buffers(void)
 	mutex_lock(&trace_types_lock);
 	if (!ring_buffer_expanded)
 		ret = __tracing_resize_ring_buffer(trace_buf_size);
+	buffer_last_use = jiffies;
 	mutex_unlock(&trace_types_lock);
 
 	return ret;
@@ -3152,6 +3210,8 @@ static int tracing_set_tracer(const char *buf)
 	}
 
 	trace_branch_enable(tr);
+	if (current_trace == &nop_trace)
+		tracing_buffers_idle();
  out:
 	mutex_unlock(&trace_types_lock);
 
@@ -3948,6 +4008,46 @@ static const struct file_operations tracing_total_entries_fops = {
 	.llseek		= generic_file_llseek,
 };
 
+static ssize_t
+tracing_idle_shrink_read(struct file *filp, char __user *ubuf,
+			 size_t cnt, loff_t *ppos)
+{
+	char buf[32];
+	int r;
+
+	r = sprintf(buf, "%lu\n", buffer_idle_shrink_sec);
+	return simple_read_from_buffer(ubuf, cnt, ppos, buf, r);
+}
+
+static ssize_t
+tracing_idle_shrink_write(struct file *filp, const char __user *ubuf,
+			  size_t cnt, loff_t *ppos)
+{
+	unsigned long val;
+	int ret;
+
+	ret = kstrtoul_from_user(ubuf, cnt, 10, &val);
+	if (ret)
+		return ret;
+
+	buffer_idle_shrink_sec = val;
+	if (val)
+		tracing_buffers_idle();
+	else
+		cancel_delayed_work_sync(&tracing_idle_shrink_work);
+
+	*ppos += cnt;
+
+	return cnt;
+}
+
+static const struct file_operations tracing_idle_shrink_fops = {
+	.open		= tracing_open_generic,
+	.read		= tracing_idle_shrink_read,
+	.write		= tracing_idle_shrink_write,
+	.llseek		= generic_file_llseek,
+};
+
 static const struct file_operations tracing_free_buffer_fops = {
 	.write		= tracing_free_buffer_write,
 	.release	= tracing_free_buffer_release,
@@ -4729,6 +4829,9 @@ static __init int tracer_init_debugfs(void)
 	trace_create_file("free_buffer", 0644, d_tracer,
 			&global_trace, &tracing_free_buffer_fops);
 
+	trace_create_file("buffer_idle_shrink_sec", 0644, d_tracer,
+			NULL, &tracing_idle_shrink_fops);
+
 	trace_create_file("trace_marker", 0220, d_tracer,
 			NULL, &tracing_mark_fops);
 
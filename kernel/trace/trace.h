@@ -704,6 +704,8 @@ static inline void trace_branch_disable(void)
 
 /* set ring buffers to default size if not already done so */
 int tracing_update_buffers(void);
+/* called when the last tracer or event stops using the ring buffers */
+void tracing_buffers_idle(void);
 
 /* trace event type bit fields, not numeric */
 enum {
@@ -815,6 +817,10 @@ filter_check_discard(struct ftrace_event_call *call, void *rec,
 		return 1;
 	}
 
+	/* freeze the buffer with this event as the last one recorded */
+	if (unlikely(call->flags & TRACE_EVENT_FL_TRACEOFF))
+		tracing_off();
+
 	return 0;
 }
 
@@ -822,6 +828,7 @@ extern void trace_event_enable_cmd_record(bool enable);
 
 extern struct mutex event_mutex;
 extern struct list_head ftrace_events;
+extern int ftrace_events_enabled;
 
 extern const char *__start___trace_bprintk_fmt[];
 extern const char *__stop___trace_bprintk_fmt[];
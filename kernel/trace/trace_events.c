@@ -34,6 +34,8 @@ char event_storage[EVENT_STORAGE_SIZE];
 EXPORT_SYMBOL_GPL(event_storage);
 
 LIST_HEAD(ftrace_events);
+/* number of events enabled, protected by event_mutex */
+int ftrace_events_enabled;
 LIST_HEAD(ftrace_common_fields);
 
 struct list_head *
@@ -216,6 +218,8 @@ static int ftrace_event_enable_disable(struct ftrace_event_call *call,
 				call->flags &= ~TRACE_EVENT_FL_RECORDED_CMD;
 			}
 			call->class->reg(call, TRACE_REG_UNREGISTER, NULL);
+			if (!--ftrace_events_enabled)
+				tracing_buffers_idle();
 		}
 		break;
 	case 1:
@@ -232,6 +236,7 @@ static int ftrace_event_enable_disable(struct ftrace_event_call *call,
 				break;
 			}
 			call->flags |= TRACE_EVENT_FL_ENABLED;
+			ftrace_events_enabled++;
 		}
 		break;
 	}
@@ -552,6 +557,61 @@ event_enable_write(struct file *filp, const char __user *ubuf, size_t cnt,
 	return ret ? ret : cnt;
 }
 
+/*
+ * "traceoff" stops recording into the ring buffer, see tracing_off(),
+ * the first time the event is recorded.  Together with a filter it
+ * keeps the trace leading up to a condition, such as a slow frame.
+ */
+static ssize_t
+event_trigger_read(struct file *filp, char __user *ubuf, size_t cnt,
+		   loff_t *ppos)
+{
+	struct ftrace_event_call *call = filp->private_data;
+	char *buf;
+
+	if (call->flags & TRACE_EVENT_FL_TRACEOFF)
+		buf = "traceoff\n";
+	else
+		buf = "none\n";
+
+	return simple_read_from_buffer(ubuf, cnt, ppos, buf, strlen(buf));
+}
+
+static ssize_t
+event_trigger_write(struct file *filp, const char __user *ubuf, size_t cnt,
+		    loff_t *ppos)
+{
+	struct ftrace_event_call *call = filp->private_data;
+	char buf[16];
+	char *cmd;
+	int ret = 0;
+
+	if (cnt >= sizeof(buf))
+		return -EINVAL;
+
+	if (copy_from_user(buf, ubuf, cnt))
+		return -EFAULT;
+
+	buf[cnt] = 0;
+	cmd = strstrip(buf);
+
+	mutex_lock(&event_mutex);
+	if (strcmp(cmd, "traceoff") == 0)
+		call->flags |= TRACE_EVENT_FL_TRACEOFF;
+	else if (strcmp(cmd, "none") == 0 || strcmp(cmd, "0") == 0)
+		call->flags &= ~TRACE_EVENT_FL_TRACEOFF;
+	else
+		ret = -EINVAL;
+	mutex_unlock(&event_mutex);
+
+	if (ret)
+		return ret;
+
+	*ppos += cnt;
+
+	return cnt;
+}
+
 static ssize_t
 system_enable_read(struct file *filp, char __user *ubuf, size_t cnt,
 		   loff_t *ppos)
@@ -1036,6 +1096,13 @@ static const struct file_operations ftrace_event_filter_fops = {
 	.llseek = default_llseek,
 };
 
+static const struct file_operations ftrace_event_trigger_fops = {
+	.open = tracing_open_generic,
+	.read = event_trigger_read,
+	.write = event_trigger_write,
+	.llseek = default_llseek,
+};
+
 static const struct file_operations ftrace_subsystem_filter_fops = {
 	.open = subsystem_open,
 	.read = subsystem_filter_read,
@@ -1148,6 +1215,7 @@ event_create_dir(struct ftrace_event_call *call, struct dentry *d_events,
 		 const struct file_operations *id,
 		 const struct file_operations *enable,
 		 const struct file_operations *filter,
+		 const struct file_operations *trigger,
 		 const struct file_operations *format)
 {
 	struct list_head *head;
@@ -1193,6 +1261,9 @@ event_create_dir(struct ftrace_event_call *call, struct dentry *d_events,
 	trace_create_file("filter", 0644, call->dir, call,
 			  filter);
 
+	trace_create_file("trigger", 0644, call->dir, call,
+			  trigger);
+
 	trace_create_file("format", 0444, call->dir, call,
 			  format);
 
@@ -1204,6 +1275,7 @@ __trace_add_event_call(struct ftrace_event_call *call, struct module *mod,
 		       const struct file_operations *id,
 		       const struct file_operations *enable,
 		       const struct file_operations *filter,
+		       const struct file_operations *trigger,
 		       const struct file_operations *format)
 {
 	struct dentry *d_events;
@@ -1227,7 +1299,8 @@ __trace_add_event_call(struct ftrace_event_call *call, struct module *mod,
 	if (!d_events)
 		return -ENOENT;
 
-	ret = event_create_dir(call, d_events, id, enable, filter, format);
+	ret = event_create_dir(call, d_events, id, enable, filter, trigger,
+			       format);
 	if (!ret)
 		list_add(&call->list, &ftrace_events);
 	call->mod = mod;
@@ -1243,6 +1316,7 @@ int trace_add_event_call(struct ftrace_event_call *call)
 	ret = __trace_add_event_call(call, NULL, &ftrace_event_id_fops,
 				     &ftrace_enable_fops,
 				     &ftrace_event_filter_fops,
+				     &ftrace_event_trigger_fops,
 				     &ftrace_event_format_fops);
 	mutex_unlock(&event_mutex);
 	return ret;
@@ -1312,6 +1386,7 @@ struct ftrace_module_file_ops {
 	struct file_operations		enable;
 	struct file_operations		format;
 	struct file_operations		filter;
+	struct file_operations		trigger;
 };
 
 static struct ftrace_module_file_ops *
@@ -1341,6 +1416,9 @@ trace_create_file_ops(struct module *mod)
 	file_ops->filter = ftrace_event_filter_fops;
 	file_ops->filter.owner = mod;
 
+	file_ops->trigger = ftrace_event_trigger_fops;
+	file_ops->trigger.owner = mod;
+
 	file_ops->format = ftrace_event_format_fops;
 	file_ops->format.owner = mod;
 
@@ -1367,7 +1445,8 @@ static void trace_module_add_events(struct module *mod)
 	for_each_event(call, start, end) {
 		__trace_add_event_call(*call, mod,
 				       &file_ops->id, &file_ops->enable,
-				       &file_ops->filter, &file_ops->format);
+				       &file_ops->filter, &file_ops->trigger,
+				       &file_ops->format);
 	}
 }
 
@@ -1501,6 +1580,7 @@ static __init int event_trace_init(void)
 		__trace_add_event_call(*call, NULL, &ftrace_event_id_fops,
 				       &ftrace_enable_fops,
 				       &ftrace_event_filter_fops,
+				       &ftrace_event_trigger_fops,
 				       &ftrace_event_format_fops);
 	}
 
@@ -41,6 +41,7 @@
 #include <linux/debug_locks.h>
 #include <linux/lockdep.h>
 #include <linux/idr.h>
+#include <linux/moduleparam.h>
 
 #include "workqueue_sched.h"
 
@@ -137,6 +138,8 @@ struct worker {
 	unsigned int		flags;		/* X: flags */
 	int			id;		/* I: worker id */
 	struct work_struct	rebind_work;	/* L: rebind worker to cpu */
+	/* wq_unbound_cpus_seq applied, only used by the worker itself */
+	unsigned int		cpus_seq;
 };
 
 /*
@@ -254,12 +257,16 @@ struct workqueue_struct *system_nrt_wq __read_mostly;
 struct workqueue_struct *system_unbound_wq __read_mostly;
 struct workqueue_struct *system_freezable_wq __read_mostly;
 struct workqueue_struct *system_nrt_freezable_wq __read_mostly;
+struct workqueue_struct *system_power_efficient_wq __read_mostly;
+struct workqueue_struct *system_freezable_power_efficient_wq __read_mostly;
 EXPORT_SYMBOL_GPL(system_wq);
 EXPORT_SYMBOL_GPL(system_long_wq);
 EXPORT_SYMBOL_GPL(system_nrt_wq);
 EXPORT_SYMBOL_GPL(system_unbound_wq);
 EXPORT_SYMBOL_GPL(system_freezable_wq);
 EXPORT_SYMBOL_GPL(system_nrt_freezable_wq);
+EXPORT_SYMBOL_GPL(system_power_efficient_wq);
+EXPORT_SYMBOL_GPL(system_freezable_power_efficient_wq);
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/workqueue.h>
@@ -454,6 +461,53 @@ static DEFINE_PER_CPU_SHARED_ALIGNED(atomic_t, gcwq_nr_running);
 static struct global_cwq unbound_global_cwq;
 static atomic_t unbound_gcwq_nr_running = ATOMIC_INIT(0);	/* always 0 */
 
+/* turn WQ_POWER_EFFICIENT workqueues into unbound ones */
+static bool wq_power_efficient = true;
+module_param_named(power_efficient, wq_power_efficient, bool, 0444);
+
+/*
+ * CPUs the workers of the unbound gcwq may run on.  Workers pick up a
+ * new mask the next time they wake up, wq_unbound_cpus_seq tells them
+ * it changed.
+ */
+static cpumask_t wq_unbound_cpus = CPU_MASK_ALL;
+static unsigned int wq_unbound_cpus_seq;
+static DEFINE_MUTEX(wq_unbound_cpus_mutex);
+
+static int wq_unbound_cpus_set(const char *val, const struct kernel_param *kp)
+{
+	cpumask_t cpus;
+	int ret;
+
+	ret = cpulist_parse(val, &cpus);
+	if (ret)
+		return ret;
+	if (!cpumask_intersects(&cpus, cpu_possible_mask))
+		return -EINVAL;
+
+	mutex_lock(&wq_unbound_cpus_mutex);
+	cpumask_copy(&wq_unbound_cpus, &cpus);
+	wq_unbound_cpus_seq++;
+	mutex_unlock(&wq_unbound_cpus_mutex);
+	return 0;
+}
+
+static int wq_unbound_cpus_get(char *buffer, const struct kernel_param *kp)
+{
+	int len;
+
+	mutex_lock(&wq_unbound_cpus_mutex);
+	len = cpulist_scnprintf(buffer, PAGE_SIZE, &wq_unbound_cpus);
+	mutex_unlock(&wq_unbound_cpus_mutex);
+	return len;
+}
+
+static struct kernel_param_ops wq_unbound_cpus_ops = {
+	.set = wq_unbound_cpus_set,
+	.get = wq_unbound_cpus_get,
+};
+module_param_cb(unbound_cpus, &wq_unbound_cpus_ops, NULL, 0644);
+
 static int worker_thread(void *__worker);
 
 static struct global_cwq *get_gcwq(unsigned int cpu)
@@ -1337,6 +1391,23 @@ static struct worker *alloc_worker(void)
 	return worker;
 }
 
+/*
+ * Move an unbound worker to wq_unbound_cpus if it changed.  Only the
+ * worker itself can do this, PF_THREAD_BOUND keeps everyone else from
+ * changing its affinity.
+ */
+static void worker_update_unbound_cpus(struct worker *worker)
+{
+	if (worker->cpus_seq == ACCESS_ONCE(wq_unbound_cpus_seq))
+		return;
+
+	mutex_lock(&wq_unbound_cpus_mutex);
+	/* none of the cpus online, stay where we are until one is */
+	if (!set_cpus_allowed_ptr(worker->task, &wq_unbound_cpus))
+		worker->cpus_seq = wq_unbound_cpus_seq;
+	mutex_unlock(&wq_unbound_cpus_mutex);
+}
+
 /**
  * create_worker - create a new workqueue worker
  * @gcwq: gcwq the new worker will belong to
@@ -1939,6 +2010,8 @@ static int worker_thread(void *__worker)
 	/* tell the scheduler that this is a workqueue worker */
 	worker->task->flags |= PF_WQ_WORKER;
 woke_up:
+	if (gcwq->cpu == WORK_CPU_UNBOUND)
+		worker_update_unbound_cpus(worker);
 	spin_lock_irq(&gcwq->lock);
 
 	/* DIE can be set only while we're idle, checking here is enough */
@@ -2976,6 +3049,9 @@ struct workqueue_struct *__alloc_workqueue_key(const char *fmt,
 	if (flags & WQ_MEM_RECLAIM)
 		flags |= WQ_RESCUER;
 
+	if ((flags & WQ_POWER_EFFICIENT) && wq_power_efficient)
+		flags |= WQ_UNBOUND;
+
 	/*
 	 * Unbound workqueues aren't concurrency managed and should be
 	 * dispatched to workers immediately.
@@ -3826,9 +3902,15 @@ static int __init init_workqueues(void)
 					      WQ_FREEZABLE, 0);
 	system_nrt_freezable_wq = alloc_workqueue("events_nrt_freezable",
 			WQ_NON_REENTRANT | WQ_FREEZABLE, 0);
+	system_power_efficient_wq = alloc_workqueue("events_power_efficient",
+					      WQ_POWER_EFFICIENT, 0);
+	system_freezable_power_efficient_wq = alloc_workqueue(
+			"events_freezable_power_efficient",
+			WQ_FREEZABLE | WQ_POWER_EFFICIENT, 0);
 	BUG_ON(!system_wq || !system_long_wq || !system_nrt_wq ||
 	       !system_unbound_wq || !system_freezable_wq ||
-		!system_nrt_freezable_wq);
+		!system_nrt_freezable_wq || !system_power_efficient_wq ||
+		!system_freezable_power_efficient_wq);
 	return 0;
 }
 early_initcall(init_workqueues);
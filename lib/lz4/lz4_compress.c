@@ -0,0 +1,136 @@
+/*
+ * LZ4 - Fast LZ compression algorithm
+ *
+ * Single-pass, hash-table driven compressor producing LZ4 block format
+ * output. Matches are found through a 4K-entry table of 32-bit source
+ * offsets indexed by a multiplicative hash of the next four input bytes.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/string.h>
+#include <linux/lz4.h>
+#include "lz4defs.h"
+
+static inline unsigned char *lz4_write_length(unsigned char *op, size_t len)
+{
+	for (; len >= 255; len -= 255)
+		*op++ = 255;
+	*op++ = (unsigned char)len;
+
+	return op;
+}
+
+static unsigned char *lz4_write_literals(unsigned char *op,
+		const unsigned char *anchor, size_t lit_len, size_t *token)
+{
+	if (lit_len >= RUN_MASK) {
+		*token = RUN_MASK << ML_BITS;
+		op = lz4_write_length(op, lit_len - RUN_MASK);
+	} else {
+		*token = lit_len << ML_BITS;
+	}
+
+	memcpy(op, anchor, lit_len);
+
+	return op + lit_len;
+}
+
+static size_t lz4_do_compress(const unsigned char *src, size_t src_len,
+		unsigned char *dst, u32 *hash_table)
+{
+	const unsigned char *ip = src;
+	const unsigned char *anchor = src;
+	const unsigned char * const iend = src + src_len;
+	const unsigned char * const mflimit = iend - MFLIMIT;
+	const unsigned char * const matchlimit = iend - LASTLITERALS;
+	unsigned char *op = dst;
+	unsigned char *token;
+	size_t token_val;
+
+	if (src_len < MINLENGTH)
+		goto last_literals;
+
+	memset(hash_table, 0, LZ4_MEM_COMPRESS);
+	hash_table[LZ4_HASH_VALUE(ip)] = 0;
+	ip++;
+
+	while (ip <= mflimit) {
+		const unsigned char *ref;
+		const unsigned char *match_start;
+		u32 h;
+
+		h = LZ4_HASH_VALUE(ip);
+		ref = src + hash_table[h];
+		hash_table[h] = ip - src;
+
+		if (ref >= ip || ip - ref > MAX_DISTANCE ||
+		    LZ4_READ32(ref) != LZ4_READ32(ip)) {
+			ip += 1 + ((ip - anchor) >> SKIPSTRENGTH);
+			continue;
+		}
+
+		/* Extend the match backwards over pending literals */
+		while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+			ip--;
+			ref--;
+		}
+
+		token = op++;
+		op = lz4_write_literals(op, anchor, ip - anchor, &token_val);
+
+		LZ4_WRITE16_LE((u16)(ip - ref), op);
+		op += 2;
+
+		match_start = ip;
+		ip += MINMATCH;
+		ref += MINMATCH;
+		while (ip < matchlimit && *ip == *ref) {
+			ip++;
+			ref++;
+		}
+
+		if ((size_t)(ip - match_start - MINMATCH) >= ML_MASK) {
+			token_val |= ML_MASK;
+			op = lz4_write_length(op,
+					ip - match_start - MINMATCH - ML_MASK);
+		} else {
+			token_val |= ip - match_start - MINMATCH;
+		}
+		*token = (unsigned char)token_val;
+
+		anchor = ip;
+		if (ip > mflimit)
+			break;
+
+		/* Seed the table with the tail of this match */
+		hash_table[LZ4_HASH_VALUE(ip - 2)] = ip - 2 - src;
+	}
+
+last_literals:
+	token = op++;
+	op = lz4_write_literals(op, anchor, iend - anchor, &token_val);
+	*token = (unsigned char)token_val;
+
+	return op - dst;
+}
+
+int lz4_compress(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len, void *wrkmem)
+{
+	if (unlikely(!wrkmem))
+		return -EINVAL;
+
+	*dst_len = lz4_do_compress(src, src_len, dst, wrkmem);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(lz4_compress);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 compressor");
@@ -0,0 +1,121 @@
+/*
+ * LZ4 Decompressor for Linux kernel
+ *
+ * Every length read from the stream is checked against both the input
+ * and the output buffer, so corrupted data fails with -EINVAL instead
+ * of overrunning either buffer.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef STATIC
+#include <linux/module.h>
+#include <linux/kernel.h>
+#endif
+#include <linux/errno.h>
+#include <linux/string.h>
+#include <linux/lz4.h>
+#include "lz4defs.h"
+
+static inline int lz4_read_length(const unsigned char **ip,
+		const unsigned char *iend, size_t *len)
+{
+	unsigned int s;
+
+	do {
+		if (unlikely(*ip >= iend))
+			return -1;
+		s = *(*ip)++;
+		*len += s;
+	} while (s == 255);
+
+	return 0;
+}
+
+int lz4_decompress_unknownoutputsize(const unsigned char *src, size_t src_len,
+		unsigned char *dest, size_t *dest_len)
+{
+	const unsigned char *ip = src;
+	const unsigned char * const iend = src + src_len;
+	unsigned char *op = dest;
+	unsigned char * const oend = dest + *dest_len;
+
+	while (ip < iend) {
+		const unsigned char *ref;
+		unsigned int token;
+		size_t len, offset;
+
+		token = *ip++;
+
+		/* literal run */
+		len = token >> ML_BITS;
+		if (len == RUN_MASK && lz4_read_length(&ip, iend, &len))
+			goto _output_error;
+
+		if (unlikely(len > (size_t)(iend - ip) ||
+			     len > (size_t)(oend - op)))
+			goto _output_error;
+
+#ifdef LZ4_FAST_UNALIGNED
+		if (len + 8 <= (size_t)(iend - ip) &&
+		    len + 8 <= (size_t)(oend - op))
+			LZ4_WILDCOPY(op, ip, len);
+		else
+#endif
+			memcpy(op, ip, len);
+		op += len;
+		ip += len;
+
+		/* the last sequence carries literals only */
+		if (ip == iend)
+			break;
+
+		if (unlikely(iend - ip < 2))
+			goto _output_error;
+		offset = LZ4_READ16_LE(ip);
+		ip += 2;
+
+		if (unlikely(!offset || offset > (size_t)(op - dest)))
+			goto _output_error;
+		ref = op - offset;
+
+		/* match */
+		len = token & ML_MASK;
+		if (len == ML_MASK && lz4_read_length(&ip, iend, &len))
+			goto _output_error;
+		len += MINMATCH;
+
+		if (unlikely(len > (size_t)(oend - op)))
+			goto _output_error;
+
+#ifdef LZ4_FAST_UNALIGNED
+		/* a distance of eight or more never reads ahead of op */
+		if (offset >= 8 && len + 8 <= (size_t)(oend - op)) {
+			LZ4_WILDCOPY(op, ref, len);
+			op += len;
+		} else
+#endif
+		if (offset >= len) {
+			memcpy(op, ref, len);
+			op += len;
+		} else {
+			/* overlapping copy replicates the last offset bytes */
+			while (len--)
+				*op++ = *ref++;
+		}
+	}
+
+	*dest_len = op - dest;
+	return 0;
+
+_output_error:
+	return -EINVAL;
+}
+#ifndef STATIC
+EXPORT_SYMBOL_GPL(lz4_decompress_unknownoutputsize);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 Decompressor");
+#endif
@@ -0,0 +1,78 @@
+/*
+ * lz4defs.h -- architecture specific defines
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <asm/unaligned.h>
+
+/*
+ * Sequence layout: a token byte whose high nibble is the literal run
+ * length and low nibble is the match length minus MINMATCH, optional
+ * length extension bytes, the literals, then a 16-bit little-endian
+ * match offset.
+ */
+#define MINMATCH	4
+
+#define ML_BITS		4
+#define ML_MASK		((1U << ML_BITS) - 1)
+#define RUN_BITS	(8 - ML_BITS)
+#define RUN_MASK	((1U << RUN_BITS) - 1)
+
+#define MAX_DISTANCE	((1 << 16) - 1)
+
+/*
+ * The last match must start at least MFLIMIT bytes before the end of
+ * the block and the last LASTLITERALS bytes are always literals.
+ */
+#define LASTLITERALS	5
+#define MFLIMIT		(8 + MINMATCH)
+#define MINLENGTH	(MFLIMIT + 1)
+
+/*
+ * Increasing this value makes incompressible data be skipped faster at
+ * the expense of compression ratio.
+ */
+#define SKIPSTRENGTH	6
+
+/*
+ * As in lib/lzo, where unaligned words are cheap short runs are copied
+ * eight bytes at a time instead of through memcpy(), overshooting into
+ * output room that is overwritten later.
+ */
+#if defined(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS) || \
+	defined(__ARM_FEATURE_UNALIGNED)
+#define LZ4_FAST_UNALIGNED	1
+
+struct lz4_una_u32 {
+	u32 x;
+} __packed;
+
+#define LZ4_COPY4(d, s)	\
+	(((struct lz4_una_u32 *)(d))->x = ((const struct lz4_una_u32 *)(s))->x)
+#define LZ4_COPY8(d, s)	\
+	do { LZ4_COPY4(d, s); LZ4_COPY4((d) + 4, (s) + 4); } while (0)
+
+/* copy at least @len bytes, @len + 7 must fit at @d and @s */
+#define LZ4_WILDCOPY(d, s, len)					\
+	do {							\
+		unsigned char *__d = (d);			\
+		const unsigned char *__s = (s);			\
+		unsigned char * const __e = __d + (len);	\
+								\
+		do {						\
+			LZ4_COPY8(__d, __s);			\
+			__d += 8;				\
+			__s += 8;				\
+		} while (__d < __e);				\
+	} while (0)
+#endif
+
+#define LZ4_READ32(p)		get_unaligned((const u32 *)(p))
+#define LZ4_READ16_LE(p)	get_unaligned_le16(p)
+#define LZ4_WRITE16_LE(v, p)	put_unaligned_le16(v, p)
+
+#define LZ4_HASH_VALUE(p)	\
+	((LZ4_READ32(p) * 2654435761U) >> ((MINMATCH * 8) - LZ4_HASH_LOG))
@@ -24,9 +24,6 @@
 #define HAVE_OP(x, op_end, op) ((size_t)(op_end - op) < (x))
 #define HAVE_LB(m_pos, out, op) (m_pos < out || m_pos >= op)
 
-#define COPY4(dst, src)	\
-		put_unaligned(get_unaligned((const u32 *)(src)), (u32 *)(dst))
-
 int lzo1x_decompress_safe(const unsigned char *in, size_t in_len,
 			unsigned char *out, size_t *out_len)
 {
@@ -72,6 +69,21 @@ int lzo1x_decompress_safe(const unsigned char *in, size_t in_len,
 		if (HAVE_IP(t + 4, ip_end, ip))
 			goto input_overrun;
 
+#ifdef LZO_FAST_UNALIGNED
+		if (!HAVE_OP(t + 3 + 7, op_end, op) &&
+		    !HAVE_IP(t + 4 + 7, ip_end, ip)) {
+			const unsigned char *ie = ip + t + 3;
+
+			do {
+				COPY8(op, ip);
+				op += 8;
+				ip += 8;
+			} while (ip < ie);
+			op -= ip - ie;
+			ip = ie;
+			goto first_literal_run;
+		}
+#endif
 		COPY4(op, ip);
 		op += 4;
 		ip += 4;
@@ -183,6 +195,21 @@ match:
 			if (HAVE_OP(t + 3 - 1, op_end, op))
 				goto output_overrun;
 
+copy_match:
+#ifdef LZO_FAST_UNALIGNED
+			/* a distance of eight or more never reads ahead of op */
+			if (op - m_pos >= 8 && !HAVE_OP(t + 2 + 7, op_end, op)) {
+				unsigned char * const oe = op + t + 2;
+
+				do {
+					COPY8(op, m_pos);
+					op += 8;
+					m_pos += 8;
+				} while (op < oe);
+				op = oe;
+				goto match_done;
+			}
+#endif
 			if (t >= 2 * 4 - (3 - 1) && (op - m_pos) >= 4) {
 				COPY4(op, m_pos);
 				op += 4;
@@ -199,7 +226,6 @@ match:
 						*op++ = *m_pos++;
 					} while (--t > 0);
 			} else {
-copy_match:
 				*op++ = *m_pos++;
 				*op++ = *m_pos++;
 				do {
@@ -216,11 +242,20 @@ match_next:
 			if (HAVE_IP(t + 1, ip_end, ip))
 				goto input_overrun;
 
-			*op++ = *ip++;
-			if (t > 1) {
+#ifdef LZO_FAST_UNALIGNED
+			if (!HAVE_OP(4, op_end, op) && !HAVE_IP(4, ip_end, ip)) {
+				COPY4(op, ip);
+				op += t;
+				ip += t;
+			} else
+#endif
+			{
 				*op++ = *ip++;
-				if (t > 2)
+				if (t > 1) {
 					*op++ = *ip++;
+					if (t > 2)
+						*op++ = *ip++;
+				}
 			}
 
 			t = *ip++;
@@ -38,6 +38,32 @@
 #define D_MASK		((1u << D_BITS) - 1)
 #define D_HIGH		((D_MASK >> 1) + 1)
 
+/*
+ * ARMv6 and later load and store unaligned words with single ldr/str
+ * instructions when the compiler is allowed to emit them, while the
+ * generic get_unaligned() goes byte by byte.  Where word accesses are
+ * cheap the decompressor copies eight bytes at a time and may write
+ * up to seven bytes past the end of a run, if the output has room.
+ */
+#if defined(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS) || \
+	defined(__ARM_FEATURE_UNALIGNED)
+#define LZO_FAST_UNALIGNED	1
+
+struct lzo_una_u32 {
+	u32 x;
+} __packed;
+
+#define COPY4(dst, src)	\
+	(((struct lzo_una_u32 *)(dst))->x = \
+		((const struct lzo_una_u32 *)(src))->x)
+#else
+#define COPY4(dst, src)	\
+		put_unaligned(get_unaligned((const u32 *)(src)), (u32 *)(dst))
+#endif
+
+#define COPY8(dst, src)	\
+	do { COPY4(dst, src); COPY4((dst) + 4, (src) + 4); } while (0)
+
 #define DX2(p, s1, s2)	(((((size_t)((p)[2]) << (s2)) ^ (p)[1]) \
 							<< (s1)) ^ (p)[0])
 #define DX3(p, s1, s2, s3)	((DX2((p)+1, s2, s3) << (s1)) ^ (p)[0])
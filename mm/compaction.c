@@ -14,6 +14,11 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#ifdef CONFIG_HAS_EARLYSUSPEND
+#include <linux/earlysuspend.h>
+#endif
 #include "internal.h"
 
 #if defined CONFIG_COMPACTION || defined CONFIG_CMA
@@ -619,7 +624,7 @@ unsigned long compaction_suitable(struct zone *zone, int order)
 	 * allocated and for a short time, the footprint is higher
 	 */
 	watermark = low_wmark_pages(zone) + (2UL << order);
-	if (!zone_watermark_ok(zone, 0, watermark, 0, 0))
+	if (!zone_watermark_ok_safe(zone, 0, watermark, 0, 0))
 		return COMPACT_SKIPPED;
 
 	/*
@@ -637,7 +642,7 @@ unsigned long compaction_suitable(struct zone *zone, int order)
 	if (fragindex >= 0 && fragindex <= sysctl_extfrag_threshold)
 		return COMPACT_SKIPPED;
 
-	if (fragindex == -1000 && zone_watermark_ok(zone, order, watermark,
+	if (fragindex == -1000 && zone_watermark_ok_safe(zone, order, watermark,
 	    0, 0))
 		return COMPACT_PARTIAL;
 
@@ -871,6 +876,134 @@ int sysctl_extfrag_handler(struct ctl_table *table, int write,
 	return 0;
 }
 
+#ifdef CONFIG_COMPACTION
+/*
+ * Background compaction.  kcompactd is woken whenever an allocation of
+ * order > 0 enters the slow path, which covers the atomic allocations
+ * that can never compact for themselves, and compacts every zone that
+ * is short of free pages of that order for as long as the fragmentation
+ * index says compaction can help.  Every compaction_proactive_ms it also
+ * makes sure that PAGE_ALLOC_COSTLY_ORDER pages are available, but only
+ * while the display is off so the migration never competes with the
+ * user; turning the display off starts such a pass right away.
+ */
+int sysctl_compaction_proactive_ms = 10000;
+
+static DECLARE_WAIT_QUEUE_HEAD(kcompactd_wait);
+/* highest order asked for since the last pass, -1 if none */
+static int kcompactd_order = -1;
+static bool kcompactd_interactive = true;
+
+/* racing wakeups may lose an order, the next failure asks again */
+void wakeup_kcompactd(int order)
+{
+	if (order > kcompactd_order)
+		kcompactd_order = order;
+	if (waitqueue_active(&kcompactd_wait))
+		wake_up_interruptible(&kcompactd_wait);
+}
+
+int sysctl_compaction_proactive_handler(struct ctl_table *table, int write,
+			void __user *buffer, size_t *length, loff_t *ppos)
+{
+	int ret = proc_dointvec_minmax(table, write, buffer, length, ppos);
+
+	/* order 0 only makes kcompactd pick up the new interval */
+	if (!ret && write)
+		wakeup_kcompactd(0);
+	return ret;
+}
+
+static long kcompactd_timeout(void)
+{
+	if (!sysctl_compaction_proactive_ms || kcompactd_interactive)
+		return MAX_SCHEDULE_TIMEOUT;
+	return msecs_to_jiffies(sysctl_compaction_proactive_ms);
+}
+
+static void kcompactd_zone(struct zone *zone, int order)
+{
+	if (zone_watermark_ok(zone, order, low_wmark_pages(zone), 0, 0))
+		return;
+
+	/* compaction_suitable() checks the fragmentation index */
+	compact_zone_order(zone, order, GFP_KERNEL, false);
+}
+
+static int kcompactd(void *p)
+{
+	struct zone *zone;
+	int order;
+
+	set_freezable();
+	/* only fill idle time, direct compaction is there for the rest */
+	set_user_nice(current, 19);
+
+	while (!kthread_should_stop()) {
+		wait_event_freezable_timeout(kcompactd_wait,
+				kcompactd_order >= 0 || kthread_should_stop(),
+				kcompactd_timeout());
+
+		order = xchg(&kcompactd_order, -1);
+		if (order < 0) {
+			/* timed out, unless the display was turned on since */
+			if (kcompactd_interactive ||
+			    !sysctl_compaction_proactive_ms)
+				continue;
+			order = PAGE_ALLOC_COSTLY_ORDER;
+		}
+		if (!order)
+			continue;
+
+		lru_add_drain();
+		for_each_populated_zone(zone)
+			kcompactd_zone(zone, order);
+	}
+
+	return 0;
+}
+
+#ifdef CONFIG_HAS_EARLYSUSPEND
+static void kcompactd_early_suspend(struct early_suspend *h)
+{
+	kcompactd_interactive = false;
+	if (sysctl_compaction_proactive_ms)
+		wakeup_kcompactd(PAGE_ALLOC_COSTLY_ORDER);
+}
+
+static void kcompactd_late_resume(struct early_suspend *h)
+{
+	kcompactd_interactive = true;
+}
+
+static struct early_suspend kcompactd_early_suspend_desc = {
+	.level = EARLY_SUSPEND_LEVEL_DISABLE_FB + 1,
+	.suspend = kcompactd_early_suspend,
+	.resume = kcompactd_late_resume,
+};
+#endif
+
+static int __init kcompactd_init(void)
+{
+	struct task_struct *task;
+
+	task = kthread_run(kcompactd, NULL, "kcompactd");
+	if (IS_ERR(task)) {
+		pr_err("Failed to start kcompactd\n");
+		return PTR_ERR(task);
+	}
+
+#ifdef CONFIG_HAS_EARLYSUSPEND
+	register_early_suspend(&kcompactd_early_suspend_desc);
+#else
+	/* nothing tells us about the display, stay proactive */
+	kcompactd_interactive = false;
+#endif
+	return 0;
+}
+module_init(kcompactd_init)
+#endif /* CONFIG_COMPACTION */
+
 #if defined(CONFIG_SYSFS) && defined(CONFIG_NUMA)
 ssize_t sysfs_compact_node(struct device *dev,
 			struct device_attribute *attr,
@@ -334,6 +334,9 @@ static inline void mminit_validate_memmodel_limits(unsigned long *start_pfn,
 #define ZONE_RECLAIM_SUCCESS	1
 #endif
 
+extern void do_set_file_pte(struct vm_area_struct *vma, unsigned long address,
+			    struct page *page, pte_t *pte);
+
 extern int hwpoison_filter(struct page *p);
 
 extern u32 hwpoison_filter_dev_major;
@@ -36,6 +36,9 @@
 #include <linux/hash.h>
 #include <linux/freezer.h>
 #include <linux/oom.h>
+#ifdef CONFIG_HAS_EARLYSUSPEND
+#include <linux/earlysuspend.h>
+#endif
 
 #include <asm/tlbflush.h>
 #include "internal.h"
@@ -86,12 +89,14 @@
  * @mm_list: link into the mm_slots list, rooted in ksm_mm_head
  * @rmap_list: head for this mm_slot's singly-linked list of rmap_items
  * @mm: the mm that this information is valid for
+ * @idle_scans: consecutive full scans of this mm that merged nothing
  */
 struct mm_slot {
 	struct hlist_node link;
 	struct list_head mm_list;
 	struct rmap_item *rmap_list;
 	struct mm_struct *mm;
+	unsigned int idle_scans;
 };
 
 /**
@@ -100,6 +105,7 @@ struct mm_slot {
  * @address: the next address inside that to be scanned
  * @rmap_list: link to the next rmap to be scanned in the rmap_list
  * @seqnr: count of completed full scans (needed when removing unstable node)
+ * @mm_merged: ksm_pages_merged when scanning of the current mm started
  *
  * There is only the one ksm_scan instance of this cursor structure.
  */
@@ -108,6 +114,7 @@ struct ksm_scan {
 	unsigned long address;
 	struct rmap_item **rmap_list;
 	unsigned long seqnr;
+	unsigned long mm_merged;
 };
 
 /**
@@ -183,6 +190,9 @@ static unsigned long ksm_pages_unshared;
 /* The number of rmap_items in use: to calculate pages_volatile */
 static unsigned long ksm_rmap_items;
 
+/* The number of rmap_items ever added to the stable tree */
+static unsigned long ksm_pages_merged;
+
 /* Number of pages ksmd should scan in one batch */
 static unsigned int ksm_thread_pages_to_scan = 100;
 
@@ -194,6 +204,20 @@ static unsigned int ksm_thread_sleep_millisecs = 20;
 #define KSM_RUN_UNMERGE	2
 static unsigned int ksm_run = KSM_RUN_STOP;
 
+/*
+ * Adaptive scanning: an mm that merged nothing in its last n full scans
+ * is only scanned every 2^n scans, so newly merged areas get the scan
+ * time; ksmd sleeps up to 2^KSM_MAX_BACKOFF times longer while batches
+ * merge less than one page in a hundred, and does not run at all while
+ * the display is on.
+ */
+#define KSM_MAX_IDLE_SHIFT	4
+#define KSM_MAX_BACKOFF		5
+static unsigned int ksm_adaptive = 1;
+static unsigned int ksm_backoff;
+static bool ksm_new_mm;
+static bool ksm_interactive;
+
 static DECLARE_WAIT_QUEUE_HEAD(ksm_thread_wait);
 static DEFINE_MUTEX(ksm_thread_mutex);
 static DEFINE_SPINLOCK(ksm_mmlist_lock);
@@ -1156,6 +1180,7 @@ static void stable_tree_append(struct rmap_item *rmap_item,
 	rmap_item->head = stable_node;
 	rmap_item->address |= STABLE_FLAG;
 	hlist_add_head(&rmap_item->hlist, &stable_node->hlist);
+	ksm_pages_merged++;
 
 	if (rmap_item->hlist.next)
 		ksm_pages_sharing++;
@@ -1276,6 +1301,32 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 	return rmap_item;
 }
 
+/*
+ * Should the scan that is starting on @slot pass over it?  Its rmap_items
+ * from the unstable tree of the previous scan are taken out right away,
+ * remove_rmap_item_from_tree() cannot deal with older ones.
+ */
+static bool ksm_skip_mm_slot(struct mm_slot *slot)
+{
+	struct rmap_item *rmap_item;
+	unsigned int shift;
+
+	shift = min_t(unsigned int, slot->idle_scans, KSM_MAX_IDLE_SHIFT);
+	if (!ksm_adaptive || !shift || ksm_test_exit(slot->mm))
+		return false;
+	if (!(ksm_scan.seqnr & ((1UL << shift) - 1)))
+		return false;
+
+	for (rmap_item = slot->rmap_list; rmap_item;
+	     rmap_item = rmap_item->rmap_list) {
+		if (rmap_item->address & UNSTABLE_FLAG) {
+			ksm_pages_unshared--;
+			rmap_item->address &= PAGE_MASK;
+		}
+	}
+	return true;
+}
+
 static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 {
 	struct mm_struct *mm;
@@ -1313,8 +1364,21 @@ static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 		if (slot == &ksm_mm_head)
 			return NULL;
 next_mm:
+		if (ksm_skip_mm_slot(slot)) {
+			spin_lock(&ksm_mmlist_lock);
+			slot = list_entry(slot->mm_list.next,
+					  struct mm_slot, mm_list);
+			ksm_scan.mm_slot = slot;
+			spin_unlock(&ksm_mmlist_lock);
+			if (slot == &ksm_mm_head) {
+				ksm_scan.seqnr++;
+				return NULL;
+			}
+			goto next_mm;
+		}
 		ksm_scan.address = 0;
 		ksm_scan.rmap_list = &slot->rmap_list;
+		ksm_scan.mm_merged = ksm_pages_merged;
 	}
 
 	mm = slot->mm;
@@ -1372,6 +1436,11 @@ next_mm:
 	 */
 	remove_trailing_rmap_items(slot, ksm_scan.rmap_list);
 
+	if (ksm_pages_merged != ksm_scan.mm_merged)
+		slot->idle_scans = 0;
+	else if (slot->idle_scans < KSM_MAX_IDLE_SHIFT)
+		slot->idle_scans++;
+
 	spin_lock(&ksm_mmlist_lock);
 	ksm_scan.mm_slot = list_entry(slot->mm_list.next,
 						struct mm_slot, mm_list);
@@ -1429,25 +1498,45 @@ static void ksm_do_scan(unsigned int scan_npages)
 
 static int ksmd_should_run(void)
 {
+	if (ksm_adaptive && ksm_interactive)
+		return 0;
 	return (ksm_run & KSM_RUN_MERGE) && !list_empty(&ksm_mm_head.mm_list);
 }
 
+/* Back off while the scan turns up less than one merge per 100 pages */
+static void ksm_update_backoff(unsigned long merged)
+{
+	if (!ksm_adaptive || merged * 100 >= ksm_thread_pages_to_scan)
+		ksm_backoff = 0;
+	else if (ksm_backoff < KSM_MAX_BACKOFF)
+		ksm_backoff++;
+}
+
 static int ksm_scan_thread(void *nothing)
 {
+	unsigned long merged;
+
 	set_freezable();
 	set_user_nice(current, 5);
 
 	while (!kthread_should_stop()) {
 		mutex_lock(&ksm_thread_mutex);
-		if (ksmd_should_run())
+		if (ksmd_should_run()) {
+			merged = ksm_pages_merged;
 			ksm_do_scan(ksm_thread_pages_to_scan);
+			ksm_update_backoff(ksm_pages_merged - merged);
+		}
 		mutex_unlock(&ksm_thread_mutex);
 
 		try_to_freeze();
 
 		if (ksmd_should_run()) {
-			schedule_timeout_interruptible(
-				msecs_to_jiffies(ksm_thread_sleep_millisecs));
+			/* a new mm cuts the backoff short */
+			ksm_new_mm = false;
+			wait_event_interruptible_timeout(ksm_thread_wait,
+				ksm_new_mm || kthread_should_stop(),
+				msecs_to_jiffies(ksm_thread_sleep_millisecs) <<
+				ksm_backoff);
 		} else {
 			wait_event_freezable(ksm_thread_wait,
 				ksmd_should_run() || kthread_should_stop());
@@ -1524,6 +1613,11 @@ int __ksm_enter(struct mm_struct *mm)
 	set_bit(MMF_VM_MERGEABLE, &mm->flags);
 	atomic_inc(&mm->mm_count);
 
+	if (ksm_adaptive && ksm_backoff) {
+		ksm_backoff = 0;
+		ksm_new_mm = true;
+		needs_wakeup = 1;
+	}
 	if (needs_wakeup)
 		wake_up_interruptible(&ksm_thread_wait);
 
@@ -1926,6 +2020,34 @@ static ssize_t run_store(struct kobject *kobj, struct kobj_attribute *attr,
 }
 KSM_ATTR(run);
 
+static ssize_t adaptive_show(struct kobject *kobj,
+			     struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_adaptive);
+}
+
+static ssize_t adaptive_store(struct kobject *kobj,
+			      struct kobj_attribute *attr,
+			      const char *buf, size_t count)
+{
+	unsigned long adaptive;
+	int err;
+
+	err = strict_strtoul(buf, 10, &adaptive);
+	if (err || adaptive > 1)
+		return -EINVAL;
+
+	mutex_lock(&ksm_thread_mutex);
+	ksm_adaptive = adaptive;
+	ksm_backoff = 0;
+	mutex_unlock(&ksm_thread_mutex);
+
+	wake_up_interruptible(&ksm_thread_wait);
+
+	return count;
+}
+KSM_ATTR(adaptive);
+
 static ssize_t pages_shared_show(struct kobject *kobj,
 				 struct kobj_attribute *attr, char *buf)
 {
@@ -1975,6 +2097,7 @@ static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
 	&run_attr.attr,
+	&adaptive_attr.attr,
 	&pages_shared_attr.attr,
 	&pages_sharing_attr.attr,
 	&pages_unshared_attr.attr,
@@ -1989,6 +2112,25 @@ static struct attribute_group ksm_attr_group = {
 };
 #endif /* CONFIG_SYSFS */
 
+#ifdef CONFIG_HAS_EARLYSUSPEND
+static void ksm_early_suspend(struct early_suspend *h)
+{
+	ksm_interactive = false;
+	wake_up_interruptible(&ksm_thread_wait);
+}
+
+static void ksm_late_resume(struct early_suspend *h)
+{
+	ksm_interactive = true;
+}
+
+static struct early_suspend ksm_early_suspend_desc = {
+	.level = EARLY_SUSPEND_LEVEL_DISABLE_FB + 1,
+	.suspend = ksm_early_suspend,
+	.resume = ksm_late_resume,
+};
+#endif
+
 static int __init ksm_init(void)
 {
 	struct task_struct *ksm_thread;
@@ -2023,6 +2165,11 @@ static int __init ksm_init(void)
 	 * later callbacks could only be taking locks which nest within that.
 	 */
 	hotplug_memory_notifier(ksm_memory_callback, 100);
+#endif
+#ifdef CONFIG_HAS_EARLYSUSPEND
+	/* the display is on until told otherwise */
+	ksm_interactive = true;
+	register_early_suspend(&ksm_early_suspend_desc);
 #endif
 	return 0;
 
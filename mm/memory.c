@@ -2912,7 +2912,7 @@ static int do_swap_page(struct mm_struct *mm, struct vm_area_struct *vma,
 	page = lookup_swap_cache(entry);
 	if (!page) {
 		grab_swap_token(mm); /* Contend for token _before_ read-in */
-		page = swapin_readahead(entry,
+		page = swapin_readahead_vma(entry,
 					GFP_HIGHUSER_MOVABLE, vma, address);
 		if (!page) {
 			/*
@@ -3173,6 +3173,73 @@ oom:
  * but allow concurrent faults), and pte neither mapped nor locked.
  * We return with mmap_sem still held, but pte unmapped and unlocked.
  */
+/*
+ * Read faults on a mapping with ->map_pages() also map the pages around
+ * the faulting address that are already cached and uptodate, up to
+ * vm.fault_around_pages within the same page table.  Nothing is read
+ * in for them: pages that are not ready get their own faults.
+ */
+int sysctl_fault_around_pages = 16;
+
+/**
+ * do_set_file_pte - map a page cache page for reading
+ * @vma: vma the address belongs to
+ * @address: user address to map the page at
+ * @page: locked page cache page
+ * @pte: empty pte of @address, with the page table lock held
+ */
+void do_set_file_pte(struct vm_area_struct *vma, unsigned long address,
+		     struct page *page, pte_t *pte)
+{
+	get_page(page);
+	flush_icache_page(vma, page);
+	inc_mm_counter_fast(vma->vm_mm, MM_FILEPAGES);
+	page_add_file_rmap(page);
+	set_pte_at(vma->vm_mm, address, pte, mk_pte(page, vma->vm_page_prot));
+
+	/* no need to invalidate: a not-present page won't be cached */
+	update_mmu_cache(vma, address, pte);
+}
+
+static void do_fault_around(struct vm_area_struct *vma, unsigned long address,
+			    pte_t *pte, pgoff_t pgoff, unsigned int flags)
+{
+	unsigned long nr_pages, start_addr;
+	pgoff_t max_pgoff;
+	struct vm_fault vmf;
+	int off;
+
+	nr_pages = rounddown_pow_of_two(ACCESS_ONCE(sysctl_fault_around_pages));
+	start_addr = max(address & ~(nr_pages * PAGE_SIZE - 1) & PAGE_MASK,
+			 vma->vm_start);
+	off = ((address - start_addr) >> PAGE_SHIFT) & (PTRS_PER_PTE - 1);
+	pte -= off;
+	pgoff -= off;
+
+	/* up to the end of the page table, of the vma or of the window */
+	max_pgoff = pgoff - ((start_addr >> PAGE_SHIFT) & (PTRS_PER_PTE - 1)) +
+		PTRS_PER_PTE - 1;
+	max_pgoff = min3(max_pgoff, vma_pages(vma) + vma->vm_pgoff - 1,
+			 pgoff + nr_pages - 1);
+
+	/* nothing to do if the window is mapped already */
+	while (!pte_none(*pte)) {
+		if (++pgoff > max_pgoff)
+			return;
+		start_addr += PAGE_SIZE;
+		if (start_addr >= vma->vm_end)
+			return;
+		pte++;
+	}
+
+	vmf.virtual_address = (void __user *)start_addr;
+	vmf.pte = pte;
+	vmf.pgoff = pgoff;
+	vmf.max_pgoff = max_pgoff;
+	vmf.flags = flags;
+	vma->vm_ops->map_pages(vma, &vmf);
+}
+
 static int __do_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 		unsigned long address, pmd_t *pmd,
 		pgoff_t pgoff, unsigned int flags, pte_t orig_pte)
@@ -3188,6 +3255,22 @@ static int __do_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	int ret;
 	int page_mkwrite = 0;
 
+	/*
+	 * Map what is cached around a read fault first, the faulting page
+	 * is often among it and ->fault() is not needed at all.
+	 */
+	if (!(flags & (FAULT_FLAG_WRITE | FAULT_FLAG_NONLINEAR)) &&
+	    vma->vm_ops->map_pages && sysctl_fault_around_pages > 1) {
+		int mapped;
+
+		page_table = pte_offset_map_lock(mm, pmd, address, &ptl);
+		do_fault_around(vma, address, page_table, pgoff, flags);
+		mapped = !pte_same(*page_table, orig_pte);
+		pte_unmap_unlock(page_table, ptl);
+		if (mapped)
+			return 0;
+	}
+
 	/*
 	 * If we do COW later, allocate page befor taking lock_page()
 	 * on the file cache page. This will reduce lock holding time.
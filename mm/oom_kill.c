@@ -62,6 +62,7 @@ void compare_swap_oom_score_adj(int old_val, int new_val)
 		current->signal->oom_score_adj = new_val;
 	trace_oom_score_adj_update(current);
 	spin_unlock_irq(&sighand->siglock);
+	lmk_adj_index_update(current);
 }
 
 /**
@@ -82,6 +83,7 @@ int test_set_oom_score_adj(int new_val)
 	current->signal->oom_score_adj = new_val;
 	trace_oom_score_adj_update(current);
 	spin_unlock_irq(&sighand->siglock);
+	lmk_adj_index_update(current);
 
 	return old_val;
 }
@@ -206,10 +208,11 @@ unsigned int oom_badness(struct task_struct *p, struct mem_cgroup *memcg,
 
 	/*
 	 * The baseline for the badness score is the proportion of RAM that each
-	 * task's rss, pagetable and swap space use.
+	 * task's rss, pagetable, swap space and driver allocations use.
 	 */
 	points = get_mm_rss(p->mm) + p->mm->nr_ptes;
 	points += get_mm_counter(p->mm, MM_SWAPENTS);
+	points += get_mm_counter(p->mm, MM_DRIVERPAGES);
 
 	points *= 1000;
 	points /= totalpages;
@@ -0,0 +1,246 @@
+/*
+ * mm/ra_replay.c - replay the page cache misses of a previous run
+ *
+ * Files like app packages and their optimized dex are read in the same
+ * scattered order on every launch, which the readahead window heuristics
+ * in mm/readahead.c cannot predict.  For files on block devices the
+ * extents that missed the page cache are remembered, keyed by device and
+ * inode number so the record survives inode eviction.  When such a file
+ * is opened again while mostly uncached, the recorded extents are
+ * submitted in their original order as one asynchronous prefetch.
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/list.h>
+#include <linux/hash.h>
+#include <linux/slab.h>
+#include <linux/file.h>
+#include <linux/jiffies.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+
+#define RA_REPLAY_HASH_BITS	7
+#define RA_REPLAY_MAX_FILES	256
+#define RA_REPLAY_EXTENTS	64
+/* misses closer than this are recorded as one extent */
+#define RA_REPLAY_GAP		4
+/* a file is not prefetched again within this time */
+#define RA_REPLAY_INTERVAL	(10 * HZ)
+
+/* 0: off, 1: record and replay (vm.readahead_replay) */
+int sysctl_readahead_replay = 1;
+
+struct ra_replay_extent {
+	pgoff_t start;
+	unsigned long nr;
+};
+
+struct ra_replay_file {
+	struct hlist_node hash;
+	struct list_head lru;
+	dev_t dev;
+	unsigned long ino;
+	unsigned long replayed;		/* jiffies of the last replay */
+	unsigned int nr;		/* extents in use */
+	unsigned int next;		/* slot to overwrite when full */
+	unsigned long pages;		/* pages covered by the extents */
+	struct ra_replay_extent extents[RA_REPLAY_EXTENTS];
+};
+
+struct ra_replay_work {
+	struct work_struct work;
+	struct file *file;
+	unsigned int nr;
+	struct ra_replay_extent extents[RA_REPLAY_EXTENTS];
+};
+
+static DEFINE_SPINLOCK(ra_replay_lock);
+static struct hlist_head ra_replay_hash[1 << RA_REPLAY_HASH_BITS];
+static LIST_HEAD(ra_replay_lru);
+static unsigned int ra_replay_files;
+
+static inline struct hlist_head *ra_replay_bucket(dev_t dev,
+						  unsigned long ino)
+{
+	return &ra_replay_hash[hash_long(ino ^ dev, RA_REPLAY_HASH_BITS)];
+}
+
+static bool ra_replay_wanted(struct inode *inode)
+{
+	return sysctl_readahead_replay && S_ISREG(inode->i_mode) &&
+		inode->i_sb->s_bdev;
+}
+
+static struct ra_replay_file *ra_replay_lookup(dev_t dev, unsigned long ino)
+{
+	struct ra_replay_file *rf;
+	struct hlist_node *node;
+
+	hlist_for_each_entry(rf, node, ra_replay_bucket(dev, ino), hash) {
+		if (rf->dev == dev && rf->ino == ino) {
+			list_move(&rf->lru, &ra_replay_lru);
+			return rf;
+		}
+	}
+	return NULL;
+}
+
+static void ra_replay_add_extent(struct ra_replay_file *rf, pgoff_t start,
+				 unsigned long nr)
+{
+	struct ra_replay_extent *ext;
+	unsigned int i;
+
+	for (i = 0; i < rf->nr; i++) {
+		ext = &rf->extents[i];
+		if (start + nr + RA_REPLAY_GAP < ext->start ||
+		    start > ext->start + ext->nr + RA_REPLAY_GAP)
+			continue;
+		/* grow the extent already covering this neighbourhood */
+		if (start < ext->start) {
+			rf->pages += ext->start - start;
+			ext->nr += ext->start - start;
+			ext->start = start;
+		}
+		if (start + nr > ext->start + ext->nr) {
+			rf->pages += start + nr - (ext->start + ext->nr);
+			ext->nr = start + nr - ext->start;
+		}
+		return;
+	}
+
+	if (rf->nr < RA_REPLAY_EXTENTS) {
+		ext = &rf->extents[rf->nr++];
+	} else {
+		/* full: forget the oldest miss */
+		ext = &rf->extents[rf->next];
+		rf->next = (rf->next + 1) % RA_REPLAY_EXTENTS;
+		rf->pages -= ext->nr;
+	}
+	ext->start = start;
+	ext->nr = nr;
+	rf->pages += nr;
+}
+
+/**
+ * ra_replay_record - remember a page cache miss
+ * @mapping: address_space of the file
+ * @offset: first missing page
+ * @nr: number of pages the reader asked for
+ */
+void ra_replay_record(struct address_space *mapping, pgoff_t offset,
+		      unsigned long nr)
+{
+	struct inode *inode = mapping->host;
+	struct ra_replay_file *rf, *new = NULL;
+	dev_t dev;
+
+	if (!inode || !ra_replay_wanted(inode) || !nr)
+		return;
+	dev = inode->i_sb->s_dev;
+
+	spin_lock(&ra_replay_lock);
+	rf = ra_replay_lookup(dev, inode->i_ino);
+	if (!rf) {
+		spin_unlock(&ra_replay_lock);
+		new = kzalloc(sizeof(*new), GFP_NOFS);
+		if (!new)
+			return;
+		spin_lock(&ra_replay_lock);
+		rf = ra_replay_lookup(dev, inode->i_ino);
+	}
+	if (!rf) {
+		if (ra_replay_files >= RA_REPLAY_MAX_FILES) {
+			/* recycle the least recently used record */
+			rf = list_entry(ra_replay_lru.prev,
+					struct ra_replay_file, lru);
+			list_del(&rf->lru);
+			hlist_del(&rf->hash);
+			memset(rf, 0, sizeof(*rf));
+		} else {
+			rf = new;
+			new = NULL;
+			ra_replay_files++;
+		}
+		rf->dev = dev;
+		rf->ino = inode->i_ino;
+		hlist_add_head(&rf->hash, ra_replay_bucket(dev, rf->ino));
+		list_add(&rf->lru, &ra_replay_lru);
+	}
+	ra_replay_add_extent(rf, offset, nr);
+	spin_unlock(&ra_replay_lock);
+
+	kfree(new);
+}
+
+static void ra_replay_work_fn(struct work_struct *work)
+{
+	struct ra_replay_work *rw = container_of(work, struct ra_replay_work,
+						 work);
+	struct address_space *mapping = rw->file->f_mapping;
+	unsigned int i;
+
+	for (i = 0; i < rw->nr; i++)
+		force_page_cache_readahead(mapping, rw->file,
+					   rw->extents[i].start,
+					   rw->extents[i].nr);
+
+	fput(rw->file);
+	kfree(rw);
+}
+
+/**
+ * ra_replay_open - prefetch what a previous run of @file missed
+ * @file: file just opened
+ *
+ * Nothing is done unless the file was recorded before, has not been
+ * replayed recently and less than half of the recorded pages are cached.
+ */
+void ra_replay_open(struct file *file)
+{
+	struct address_space *mapping = file->f_mapping;
+	struct inode *inode = mapping->host;
+	struct ra_replay_file *rf;
+	struct ra_replay_work *rw;
+	unsigned int i, n;
+
+	if ((file->f_mode & (FMODE_READ | FMODE_WRITE)) != FMODE_READ ||
+	    (file->f_flags & O_DIRECT) || !ra_replay_wanted(inode) ||
+	    !file->f_ra.ra_pages)
+		return;
+
+	spin_lock(&ra_replay_lock);
+	rf = ra_replay_lookup(inode->i_sb->s_dev, inode->i_ino);
+	if (!rf || mapping->nrpages >= rf->pages / 2 ||
+	    (rf->replayed && time_before(jiffies,
+					 rf->replayed + RA_REPLAY_INTERVAL))) {
+		spin_unlock(&ra_replay_lock);
+		return;
+	}
+	rf->replayed = jiffies ? jiffies : 1;
+	spin_unlock(&ra_replay_lock);
+
+	rw = kmalloc(sizeof(*rw), GFP_KERNEL);
+	if (!rw)
+		return;
+
+	spin_lock(&ra_replay_lock);
+	rf = ra_replay_lookup(inode->i_sb->s_dev, inode->i_ino);
+	if (!rf) {
+		spin_unlock(&ra_replay_lock);
+		kfree(rw);
+		return;
+	}
+	/* oldest first, i.e. in the order of the original misses */
+	n = rf->nr;
+	for (i = 0; i < n; i++)
+		rw->extents[i] = rf->extents[(rf->next + i) % n];
+	rw->nr = n;
+	spin_unlock(&ra_replay_lock);
+
+	get_file(file);
+	rw->file = file;
+	INIT_WORK(&rw->work, ra_replay_work_fn);
+	queue_work(system_unbound_wq, &rw->work);
+}
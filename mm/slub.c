@@ -226,9 +226,23 @@ static inline void sysfs_slab_remove(struct kmem_cache *s)
 
 #endif
 
+/*
+ * Everything but the fast paths is counted in any kernel with sysfs:
+ * the slow paths take locks or cmpxchg anyway, so a per cpu increment
+ * there is lost in the noise.  CONFIG_SLUB_STATS adds the fast paths.
+ */
+static inline bool stat_fastpath(enum stat_item si)
+{
+	return si == ALLOC_FASTPATH || si == FREE_FASTPATH;
+}
+
 static inline void stat(const struct kmem_cache *s, enum stat_item si)
 {
-#ifdef CONFIG_SLUB_STATS
+#ifdef CONFIG_SYSFS
+#ifndef CONFIG_SLUB_STATS
+	if (stat_fastpath(si))
+		return;
+#endif
 	__this_cpu_inc(s->cpu_slab->stat[si]);
 #endif
 }
@@ -5015,7 +5029,6 @@ static ssize_t remote_node_defrag_ratio_store(struct kmem_cache *s,
 SLAB_ATTR(remote_node_defrag_ratio);
 #endif
 
-#ifdef CONFIG_SLUB_STATS
 static int show_stat(struct kmem_cache *s, char *buf, enum stat_item si)
 {
 	unsigned long sum  = 0;
@@ -5068,9 +5081,11 @@ static ssize_t text##_store(struct kmem_cache *s,		\
 }								\
 SLAB_ATTR(text);						\
 
+#ifdef CONFIG_SLUB_STATS
 STAT_ATTR(ALLOC_FASTPATH, alloc_fastpath);
-STAT_ATTR(ALLOC_SLOWPATH, alloc_slowpath);
 STAT_ATTR(FREE_FASTPATH, free_fastpath);
+#endif
+STAT_ATTR(ALLOC_SLOWPATH, alloc_slowpath);
 STAT_ATTR(FREE_SLOWPATH, free_slowpath);
 STAT_ATTR(FREE_FROZEN, free_frozen);
 STAT_ATTR(FREE_ADD_PARTIAL, free_add_partial);
@@ -5094,7 +5109,6 @@ STAT_ATTR(CPU_PARTIAL_ALLOC, cpu_partial_alloc);
 STAT_ATTR(CPU_PARTIAL_FREE, cpu_partial_free);
 STAT_ATTR(CPU_PARTIAL_NODE, cpu_partial_node);
 STAT_ATTR(CPU_PARTIAL_DRAIN, cpu_partial_drain);
-#endif
 
 static struct attribute *slab_attrs[] = {
 	&slab_size_attr.attr,
@@ -5136,8 +5150,9 @@ static struct attribute *slab_attrs[] = {
 #endif
 #ifdef CONFIG_SLUB_STATS
 	&alloc_fastpath_attr.attr,
-	&alloc_slowpath_attr.attr,
 	&free_fastpath_attr.attr,
+#endif
+	&alloc_slowpath_attr.attr,
 	&free_slowpath_attr.attr,
 	&free_frozen_attr.attr,
 	&free_add_partial_attr.attr,
@@ -5161,7 +5176,6 @@ static struct attribute *slab_attrs[] = {
 	&cpu_partial_free_attr.attr,
 	&cpu_partial_node_attr.attr,
 	&cpu_partial_drain_attr.attr,
-#endif
 #ifdef CONFIG_FAILSLAB
 	&failslab_attr.attr,
 #endif
@@ -35,6 +35,12 @@ static struct backing_dev_info swap_backing_dev_info = {
 	.capabilities	= BDI_CAP_NO_ACCT_AND_WRITEBACK | BDI_CAP_SWAP_BACKED,
 };
 
+/* Readahead pages found in the swap cache since the last readahead */
+static atomic_t swapin_readahead_hits = ATOMIC_INIT(4);
+
+/* Largest window of the page table based readahead */
+#define SWAP_RA_VMA_MAX		16
+
 struct address_space swapper_space = {
 	.page_tree	= RADIX_TREE_INIT(GFP_ATOMIC|__GFP_NOWARN),
 	.tree_lock	= __SPIN_LOCK_UNLOCKED(swapper_space.tree_lock),
@@ -264,8 +270,11 @@ struct page * lookup_swap_cache(swp_entry_t entry)
 
 	page = find_get_page(&swapper_space, entry.val);
 
-	if (page)
+	if (page) {
 		INC_CACHE_INFO(find_success);
+		if (TestClearPageReadahead(page))
+			atomic_inc(&swapin_readahead_hits);
+	}
 
 	INC_CACHE_INFO(find_total);
 	return page;
@@ -350,6 +359,51 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 	return found_page;
 }
 
+/*
+ * Size the next readahead window from how the last ones were used: every
+ * readahead page that was faulted on since widens it, a window that went
+ * unused shrinks it by half at a time, down to no readahead at all for
+ * a random access pattern.  Returns a power of two up to @max_pages.
+ */
+static unsigned long swapin_nr_pages(unsigned long offset,
+				     unsigned int max_pages)
+{
+	static unsigned long prev_offset;
+	static atomic_t last_readahead_pages;
+	unsigned int pages, last_ra;
+
+	if (max_pages <= 1)
+		return 1;
+
+	pages = atomic_xchg(&swapin_readahead_hits, 0) + 2;
+	if (pages == 2) {
+		/*
+		 * Without hits to judge by, keep reading ahead only while
+		 * the faults walk through adjacent entries.
+		 */
+		if (offset != prev_offset + 1 && offset != prev_offset - 1)
+			pages = 1;
+		prev_offset = offset;
+	} else {
+		unsigned int roundup = 4;
+
+		while (roundup < pages)
+			roundup <<= 1;
+		pages = roundup;
+	}
+
+	if (pages > max_pages)
+		pages = max_pages;
+
+	/* Don't shrink readahead too fast */
+	last_ra = atomic_read(&last_readahead_pages) / 2;
+	if (pages < last_ra)
+		pages = last_ra;
+	atomic_set(&last_readahead_pages, pages);
+
+	return pages;
+}
+
 /**
  * swapin_readahead - swap in pages in hope we need them soon
  * @entry: swap entry of this memory
@@ -360,9 +414,13 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
  * Returns the struct page for entry and addr, after queueing swapin.
  *
  * Primitive swap readahead code. We simply read an aligned block of
- * (1 << page_cluster) entries in the swap area. This method is chosen
- * because it doesn't cost us any seek time.  We also make sure to queue
- * the 'original' request together with the readahead ones...
+ * entries in the swap area, up to (1 << page_cluster) of them as
+ * swapin_nr_pages() allows. This method is chosen because it doesn't
+ * cost us any seek time.  We also make sure to queue the 'original'
+ * request together with the readahead ones...
+ *
+ * Devices whose reads are synchronous and cost CPU rather than seeks,
+ * such as zram, get no readahead at all.
  *
  * This has been extended to use the NUMA policies from the mm triggering
  * the readahead.
@@ -373,11 +431,19 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 			struct vm_area_struct *vma, unsigned long addr)
 {
 	struct page *page;
-	unsigned long offset = swp_offset(entry);
+	unsigned long entry_offset = swp_offset(entry);
+	unsigned long offset = entry_offset;
 	unsigned long start_offset, end_offset;
-	unsigned long mask = (1UL << page_cluster) - 1;
+	unsigned long mask;
+
+	if (swp_swap_info(entry)->flags & SWP_SYNCHRONOUS_IO)
+		goto skip;
 
-	/* Read a page_cluster sized and aligned cluster around offset. */
+	mask = swapin_nr_pages(offset, 1U << ACCESS_ONCE(page_cluster)) - 1;
+	if (!mask)
+		goto skip;
+
+	/* Read a swapin_nr_pages sized and aligned cluster around offset. */
 	start_offset = offset & ~mask;
 	end_offset = offset | mask;
 	if (!start_offset)	/* First page is swap header. */
@@ -389,8 +455,93 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 						gfp_mask, vma, addr);
 		if (!page)
 			continue;
+		if (offset != entry_offset)
+			SetPageReadahead(page);
 		page_cache_release(page);
 	}
 	lru_add_drain();	/* Push any new pages onto the LRU now */
+skip:
 	return read_swap_cache_async(entry, gfp_mask, vma, addr);
 }
+
+/**
+ * swapin_readahead_vma - swap in pages around a faulting address
+ * @fentry: swap entry of the faulting pte
+ * @gfp_mask: memory allocation flags
+ * @vma: user vma the fault is in
+ * @addr: faulting address
+ *
+ * Like swapin_readahead(), but on a non-rotational device the window is
+ * taken from the swap entries of the ptes neighbouring @addr rather than
+ * from the neighbouring swap slots: what a process touches next is near
+ * in its address space, while the slots next to it hold whatever was
+ * swapped out at the same time.  The window neither leaves @vma nor the
+ * page table of @addr, and is sized by the same readahead hit feedback.
+ *
+ * Caller must hold down_read on the vma->vm_mm.
+ */
+struct page *swapin_readahead_vma(swp_entry_t fentry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr)
+{
+	struct swap_info_struct *si = swp_swap_info(fentry);
+	pte_t ptes[SWAP_RA_VMA_MAX], *pte;
+	unsigned long faddr = addr & PAGE_MASK;
+	unsigned long start, end, nr, i;
+	struct page *page;
+	swp_entry_t entry;
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd;
+
+	if ((si->flags & (SWP_SOLIDSTATE | SWP_SYNCHRONOUS_IO)) !=
+	    SWP_SOLIDSTATE)
+		return swapin_readahead(fentry, gfp_mask, vma, addr);
+
+	nr = swapin_nr_pages(faddr >> PAGE_SHIFT,
+			min_t(unsigned int, 1U << ACCESS_ONCE(page_cluster),
+			      SWAP_RA_VMA_MAX));
+	if (nr <= 1)
+		goto skip;
+
+	start = faddr & ~((nr << PAGE_SHIFT) - 1);
+	end = start + (nr << PAGE_SHIFT);
+	start = max3(start, vma->vm_start, faddr & PMD_MASK);
+	end = min(end, pmd_addr_end(faddr, vma->vm_end));
+
+	pgd = pgd_offset(vma->vm_mm, faddr);
+	if (pgd_none(*pgd) || unlikely(pgd_bad(*pgd)))
+		goto skip;
+	pud = pud_offset(pgd, faddr);
+	if (pud_none(*pud) || unlikely(pud_bad(*pud)))
+		goto skip;
+	pmd = pmd_offset(pud, faddr);
+	if (pmd_none(*pmd) || pmd_trans_huge(*pmd) || unlikely(pmd_bad(*pmd)))
+		goto skip;
+
+	/*
+	 * The ptes are only a hint: an entry that was freed meanwhile is
+	 * refused by read_swap_cache_async(), and the fault on an entry
+	 * that changed finds the page in the swap cache or reads it.
+	 */
+	nr = (end - start) >> PAGE_SHIFT;
+	pte = pte_offset_map(pmd, start);
+	for (i = 0; i < nr; i++)
+		ptes[i] = pte[i];
+	pte_unmap(pte);
+
+	for (i = 0; i < nr; i++, start += PAGE_SIZE) {
+		if (start == faddr || !is_swap_pte(ptes[i]))
+			continue;
+		entry = pte_to_swp_entry(ptes[i]);
+		if (unlikely(non_swap_entry(entry)))
+			continue;
+		page = read_swap_cache_async(entry, gfp_mask, vma, start);
+		if (!page)
+			continue;
+		SetPageReadahead(page);
+		page_cache_release(page);
+	}
+	lru_add_drain();	/* Push any new pages onto the LRU now */
+skip:
+	return read_swap_cache_async(fentry, gfp_mask, vma, addr);
+}
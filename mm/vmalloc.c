@@ -325,6 +325,18 @@ static void __insert_vmap_area(struct vmap_area *va)
 
 static void purge_vmap_area_lazy(void);
 
+/*
+ * vmap_area_lock is global; count how often it is found taken so that
+ * serialisation of kernel mappings shows up in /proc/vmstat.
+ */
+static inline void lock_vmap_area(void)
+{
+	if (!spin_trylock(&vmap_area_lock)) {
+		count_vm_event(VMAP_LOCK_CONTENDED);
+		spin_lock(&vmap_area_lock);
+	}
+}
+
 /*
  * Allocate a region of KVA of the specified size and alignment, within the
  * vstart and vend.
@@ -350,7 +362,7 @@ static struct vmap_area *alloc_vmap_area(unsigned long size,
 		return ERR_PTR(-ENOMEM);
 
 retry:
-	spin_lock(&vmap_area_lock);
+	lock_vmap_area();
 	/*
 	 * Invalidate cache if we have more permissive parameters.
 	 * cached_hole_size notes the largest hole noticed _below_
@@ -492,7 +504,7 @@ static void __free_vmap_area(struct vmap_area *va)
  */
 static void free_vmap_area(struct vmap_area *va)
 {
-	spin_lock(&vmap_area_lock);
+	lock_vmap_area();
 	__free_vmap_area(va);
 	spin_unlock(&vmap_area_lock);
 }
@@ -542,10 +554,16 @@ static void vmap_debug_free_range(unsigned long start, unsigned long end)
  * code, and it will be simple to change the scale factor if we find that it
  * becomes a problem on bigger systems.
  */
+/* 0: scale with the number of cpus as above (vm.vmap_lazy_max_pages) */
+int sysctl_vmap_lazy_max_pages;
+
 static unsigned long lazy_max_pages(void)
 {
 	unsigned int log;
 
+	if (sysctl_vmap_lazy_max_pages)
+		return sysctl_vmap_lazy_max_pages;
+
 	log = fls(num_online_cpus());
 
 	return log * (32UL * 1024 * 1024 / PAGE_SIZE);
@@ -616,11 +634,13 @@ static void __purge_vmap_area_lazy(unsigned long *start, unsigned long *end,
 	if (nr)
 		atomic_sub(nr, &vmap_lazy_nr);
 
-	if (nr || force_flush)
+	if (nr || force_flush) {
+		count_vm_event(VMAP_PURGE);
 		flush_tlb_kernel_range(*start, *end);
+	}
 
 	if (nr) {
-		spin_lock(&vmap_area_lock);
+		lock_vmap_area();
 		list_for_each_entry_safe(va, n_va, &valist, purge_list)
 			__free_vmap_area(va);
 		spin_unlock(&vmap_area_lock);
@@ -685,7 +705,7 @@ static struct vmap_area *find_vmap_area(unsigned long addr)
 {
 	struct vmap_area *va;
 
-	spin_lock(&vmap_area_lock);
+	lock_vmap_area();
 	va = __find_vmap_area(addr);
 	spin_unlock(&vmap_area_lock);
 
@@ -2401,7 +2421,7 @@ struct vm_struct **pcpu_get_vm_areas(const unsigned long *offsets,
 			goto err_free;
 	}
 retry:
-	spin_lock(&vmap_area_lock);
+	lock_vmap_area();
 
 	/* start scanning - we scan from the top, begin with the last area */
 	area = term_area = last_area;
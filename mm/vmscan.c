@@ -42,6 +42,7 @@
 #include <linux/sysctl.h>
 #include <linux/oom.h>
 #include <linux/prefetch.h>
+#include <linux/vmpressure.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -113,6 +114,9 @@ struct scan_control {
 	 * are scanned.
 	 */
 	nodemask_t	*nodemask;
+
+	/* Reclaim pages even if they were referenced recently */
+	int ignore_references;
 };
 
 struct mem_cgroup_zone {
@@ -534,9 +538,11 @@ static pageout_t pageout(struct page *page, struct address_space *mapping,
 
 /*
  * Same as remove_mapping, but if the page is removed from the mapping, it
- * gets returned with a refcount of 0.
+ * gets returned with a refcount of 0.  Pages @reclaimed under memory
+ * pressure leave a shadow entry behind for refault detection.
  */
-static int __remove_mapping(struct address_space *mapping, struct page *page)
+static int __remove_mapping(struct address_space *mapping, struct page *page,
+			    bool reclaimed)
 {
 	BUG_ON(!PageLocked(page));
 	BUG_ON(mapping != page_mapping(page));
@@ -582,10 +588,13 @@ static int __remove_mapping(struct address_space *mapping, struct page *page)
 		swapcache_free(swap, page);
 	} else {
 		void (*freepage)(struct page *);
+		void *shadow = NULL;
 
 		freepage = mapping->a_ops->freepage;
 
-		__delete_from_page_cache(page);
+		if (reclaimed && page_is_file_cache(page))
+			shadow = workingset_eviction(mapping, page);
+		__delete_from_page_cache(page, shadow);
 		spin_unlock_irq(&mapping->tree_lock);
 		mem_cgroup_uncharge_cache_page(page);
 
@@ -608,7 +617,7 @@ cannot_free:
  */
 int remove_mapping(struct address_space *mapping, struct page *page)
 {
-	if (__remove_mapping(mapping, page)) {
+	if (__remove_mapping(mapping, page, false)) {
 		/*
 		 * Unfreezing the refcount with 1 rather than 2 effectively
 		 * drops the pagecache ref for us without requiring another
@@ -714,6 +723,10 @@ static enum page_references page_check_references(struct page *page,
 	if (sc->reclaim_mode & RECLAIM_MODE_LUMPYRECLAIM)
 		return PAGEREF_RECLAIM;
 
+	/* The caller picked the pages to reclaim */
+	if (sc->ignore_references)
+		return PAGEREF_RECLAIM;
+
 	/*
 	 * Mlock lost the isolation race with us.  Let try_to_unmap()
 	 * move the page to the unevictable list.
@@ -968,7 +981,7 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 			}
 		}
 
-		if (!mapping || !__remove_mapping(mapping, page))
+		if (!mapping || !__remove_mapping(mapping, page, true))
 			goto keep_locked;
 
 		/*
@@ -1031,6 +1044,62 @@ keep_lumpy:
 	return nr_reclaimed;
 }
 
+/**
+ * reclaim_pages_from_list - reclaim a list of isolated pages
+ * @page_list: pages taken off the LRU with isolate_lru_page() and
+ *	accounted in NR_ISOLATED_ANON or NR_ISOLATED_FILE
+ *
+ * The pages are reclaimed regardless of their references, anonymous ones
+ * are swapped out.  Pages that cannot be reclaimed are put back on the
+ * LRU.  Returns the number of pages freed.
+ */
+unsigned long reclaim_pages_from_list(struct list_head *page_list)
+{
+	struct scan_control sc = {
+		.gfp_mask = GFP_KERNEL,
+		.may_writepage = 1,
+		.may_unmap = 1,
+		.may_swap = 1,
+		.reclaim_mode = RECLAIM_MODE_SINGLE,
+		.ignore_references = 1,
+	};
+	struct mem_cgroup_zone mz = {
+		.mem_cgroup = NULL,
+	};
+	unsigned long nr_reclaimed = 0;
+	unsigned long nr_dirty = 0, nr_writeback = 0;
+	unsigned long nr_isolated[2];
+	struct page *page, *next;
+	LIST_HEAD(zone_list);
+
+	/* shrink_page_list() wants the pages of one zone at a time */
+	while (!list_empty(page_list)) {
+		mz.zone = page_zone(lru_to_page(page_list));
+		nr_isolated[0] = nr_isolated[1] = 0;
+		list_for_each_entry_safe(page, next, page_list, lru) {
+			if (page_zone(page) != mz.zone)
+				continue;
+			ClearPageActive(page);
+			nr_isolated[page_is_file_cache(page)]++;
+			list_move(&page->lru, &zone_list);
+		}
+
+		nr_reclaimed += shrink_page_list(&zone_list, &mz, &sc,
+						 DEF_PRIORITY, &nr_dirty,
+						 &nr_writeback);
+
+		while (!list_empty(&zone_list)) {
+			page = lru_to_page(&zone_list);
+			list_del(&page->lru);
+			putback_lru_page(page);
+		}
+		mod_zone_page_state(mz.zone, NR_ISOLATED_ANON, -nr_isolated[0]);
+		mod_zone_page_state(mz.zone, NR_ISOLATED_FILE, -nr_isolated[1]);
+	}
+
+	return nr_reclaimed;
+}
+
 /*
  * Attempt to remove the specified page from its LRU.  Only take this page
  * if it is of the appropriate PageActive status.  Pages which are being
@@ -2141,6 +2210,8 @@ static void shrink_zone(int priority, struct zone *zone,
 		.zone = zone,
 		.priority = priority,
 	};
+	unsigned long nr_scanned = sc->nr_scanned;
+	unsigned long nr_reclaimed = sc->nr_reclaimed;
 	struct mem_cgroup *memcg;
 
 	memcg = mem_cgroup_iter(root, NULL, &reclaim);
@@ -2167,6 +2238,10 @@ static void shrink_zone(int priority, struct zone *zone,
 		}
 		memcg = mem_cgroup_iter(root, memcg, &reclaim);
 	} while (memcg);
+
+	vmpressure(sc->gfp_mask, sc->target_mem_cgroup, zone,
+		   sc->nr_scanned - nr_scanned,
+		   sc->nr_reclaimed - nr_reclaimed);
 }
 
 /* Returns true if compaction should go ahead for a high-order request */
@@ -2351,6 +2426,8 @@ static unsigned long do_try_to_free_pages(struct zonelist *zonelist,
 		count_vm_event(ALLOCSTALL);
 
 	for (priority = DEF_PRIORITY; priority >= 0; priority--) {
+		vmpressure_prio(sc->gfp_mask, sc->target_mem_cgroup,
+				priority);
 		sc->nr_scanned = 0;
 		if (!priority)
 			disable_swap_token(sc->target_mem_cgroup);
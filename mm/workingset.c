@@ -0,0 +1,103 @@
+/*
+ * mm/workingset.c - working set detection for the page cache
+ *
+ * Every zone counts the file pages it evicts and activates in
+ * inactive_age.  When reclaim evicts a page cache page, the counter is
+ * bumped and its value stored in the page's slot of the radix tree as a
+ * shadow entry.  If the page is faulted back in later, the distance
+ * between the two counter values is the number of pages that were
+ * evicted or activated in the mean time, i.e. how much larger the
+ * inactive list would have had to be for the page to stay cached.  A
+ * refault distance no bigger than the active list means the page would
+ * have been kept had the active list been smaller, so it is activated
+ * right away and competes with the established working set instead of
+ * being cycled through the inactive list again.  Cold reads still start
+ * out inactive.
+ */
+#include <linux/mm.h>
+#include <linux/mmzone.h>
+#include <linux/radix-tree.h>
+#include <linux/vmstat.h>
+#include <linux/swap.h>
+
+/* the shadow has to fit next to the zone and node bits */
+#define EVICTION_SHIFT	(RADIX_TREE_EXCEPTIONAL_SHIFT + \
+			 ZONES_SHIFT + NODES_SHIFT)
+#define EVICTION_MASK	(~0UL >> EVICTION_SHIFT)
+
+static void *pack_shadow(unsigned long eviction, struct zone *zone)
+{
+	eviction = (eviction << NODES_SHIFT) | zone->zone_pgdat->node_id;
+	eviction = (eviction << ZONES_SHIFT) | zone_idx(zone);
+	eviction = (eviction << RADIX_TREE_EXCEPTIONAL_SHIFT);
+
+	return (void *)(eviction | RADIX_TREE_EXCEPTIONAL_ENTRY);
+}
+
+static void unpack_shadow(void *shadow, struct zone **zone,
+			  unsigned long *distance)
+{
+	unsigned long entry = (unsigned long)shadow;
+	unsigned long eviction, refault;
+	int zid, nid;
+
+	entry >>= RADIX_TREE_EXCEPTIONAL_SHIFT;
+	zid = entry & ((1UL << ZONES_SHIFT) - 1);
+	entry >>= ZONES_SHIFT;
+	nid = entry & ((1UL << NODES_SHIFT) - 1);
+	entry >>= NODES_SHIFT;
+	eviction = entry;
+
+	*zone = NODE_DATA(nid)->node_zones + zid;
+
+	/* the counter may have wrapped since, the distance is still right */
+	refault = atomic_long_read(&(*zone)->inactive_age);
+	*distance = (refault - eviction) & EVICTION_MASK;
+}
+
+/**
+ * workingset_eviction - note the eviction of a page cache page
+ * @mapping: address_space the page is being removed from
+ * @page: the page being evicted
+ *
+ * Returns the shadow entry to put in the page's radix tree slot.
+ */
+void *workingset_eviction(struct address_space *mapping, struct page *page)
+{
+	struct zone *zone = page_zone(page);
+	unsigned long eviction;
+
+	eviction = atomic_long_inc_return(&zone->inactive_age);
+	return pack_shadow(eviction, zone);
+}
+
+/**
+ * workingset_refault - tell whether a refaulting page is part of the
+ *	working set
+ * @shadow: shadow entry of the evicted page
+ *
+ * Returns true if the page should be activated right away.
+ */
+bool workingset_refault(void *shadow)
+{
+	unsigned long distance;
+	struct zone *zone;
+
+	unpack_shadow(shadow, &zone, &distance);
+	inc_zone_state(zone, WORKINGSET_REFAULT);
+
+	if (distance <= zone_page_state(zone, NR_ACTIVE_FILE)) {
+		inc_zone_state(zone, WORKINGSET_ACTIVATE);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * workingset_activation - note a page being activated
+ * @page: page that is being activated
+ */
+void workingset_activation(struct page *page)
+{
+	atomic_long_inc(&page_zone(page)->inactive_age);
+}
@@ -0,0 +1,150 @@
+/*
+ * Forwarding fast path for established NAT connections.
+ *
+ * Once a forwarded TCP or UDP connection through NAT is confirmed and
+ * assured, its packets are translated and sent out right after
+ * conntrack has seen them in PREROUTING.  The mangle, nat, filter and
+ * FORWARD chains are skipped for them, as are the iptables counters
+ * and the per interface statistics of the quota and tethering rules,
+ * which is why the fast path is only taken while enabled is set.
+ * Anything it does not handle, including every packet of a connection
+ * with a helper, goes the normal way.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/types.h>
+#include <linux/ip.h>
+#include <linux/netdevice.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter_ipv4.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/skbuff.h>
+#include <net/dst.h>
+#include <net/ip.h>
+#include <net/neighbour.h>
+#include <net/route.h>
+
+#include <net/netfilter/nf_conntrack.h>
+#include <net/netfilter/nf_conntrack_helper.h>
+#include <net/netfilter/nf_nat.h>
+#include <net/netfilter/nf_nat_core.h>
+
+static bool enabled;
+module_param(enabled, bool, 0644);
+MODULE_PARM_DESC(enabled, "forward established NAT connections directly");
+
+#define FASTPATH_CT_STATUS	(IPS_CONFIRMED | IPS_ASSURED | \
+				 IPS_NAT_DONE_MASK)
+
+/* is @skb a plain packet of a connection that the fast path may take? */
+static struct nf_conn *nat_fastpath_ct(struct sk_buff *skb,
+				       enum ip_conntrack_info *ctinfo)
+{
+	const struct iphdr *iph = ip_hdr(skb);
+	struct nf_conn *ct;
+
+	if (iph->ihl != 5 || iph->ttl <= 1 || ip_is_fragment(iph) ||
+	    (iph->protocol != IPPROTO_TCP && iph->protocol != IPPROTO_UDP))
+		return NULL;
+	if (skb->pkt_type != PACKET_HOST || skb_is_gso(skb) || skb_dst(skb))
+		return NULL;
+
+	ct = nf_ct_get(skb, ctinfo);
+	if (!ct || nf_ct_is_untracked(ct))
+		return NULL;
+	if (*ctinfo != IP_CT_ESTABLISHED && *ctinfo != IP_CT_ESTABLISHED_REPLY)
+		return NULL;
+	if ((ct->status & FASTPATH_CT_STATUS) != FASTPATH_CT_STATUS ||
+	    !(ct->status & IPS_NAT_MASK) || nfct_help(ct))
+		return NULL;
+	return ct;
+}
+
+static unsigned int nat_fastpath_in(unsigned int hooknum,
+				    struct sk_buff *skb,
+				    const struct net_device *in,
+				    const struct net_device *out,
+				    int (*okfn)(struct sk_buff *))
+{
+	enum ip_conntrack_info ctinfo;
+	enum ip_conntrack_dir dir;
+	struct nf_conn *ct;
+	struct dst_entry *dst;
+	struct rtable *rt;
+	struct neighbour *neigh;
+	struct iphdr *iph;
+	__be32 daddr;
+
+	if (!enabled)
+		return NF_ACCEPT;
+	ct = nat_fastpath_ct(skb, &ctinfo);
+	if (!ct)
+		return NF_ACCEPT;
+
+	/* route to where the packet goes once destination NAT is done */
+	dir = CTINFO2DIR(ctinfo);
+	daddr = ct->tuplehash[!dir].tuple.src.u3.ip;
+	iph = ip_hdr(skb);
+	if (ip_route_input_noref(skb, daddr, iph->saddr, iph->tos, skb->dev))
+		return NF_ACCEPT;
+
+	rt = skb_rtable(skb);
+	dst = &rt->dst;
+	if (rt->rt_type != RTN_UNICAST || (rt->rt_flags & RTCF_LOCAL) ||
+	    dst->xfrm || dst->dev == skb->dev || skb->len > dst_mtu(dst)) {
+		/* let the normal path route it again and send any errors */
+		skb_dst_drop(skb);
+		return NF_ACCEPT;
+	}
+
+	if (skb_cow(skb, LL_RESERVED_SPACE(dst->dev) + dst->header_len))
+		return NF_DROP;
+	if (nf_nat_packet(ct, ctinfo, NF_INET_PRE_ROUTING, skb) != NF_ACCEPT ||
+	    nf_nat_packet(ct, ctinfo, NF_INET_POST_ROUTING, skb) != NF_ACCEPT)
+		return NF_DROP;
+
+	iph = ip_hdr(skb);
+	ip_decrease_ttl(iph);
+	skb->priority = rt_tos2priority(iph->tos);
+	IPCB(skb)->flags |= IPSKB_FORWARDED;
+	IP_INC_STATS_BH(dev_net(dst->dev), IPSTATS_MIB_OUTFORWDATAGRAMS);
+
+	skb->dev = dst->dev;
+	rcu_read_lock();
+	neigh = dst_get_neighbour_noref(dst);
+	if (neigh)
+		neigh_output(neigh, skb);
+	else
+		kfree_skb(skb);
+	rcu_read_unlock();
+	return NF_STOLEN;
+}
+
+static struct nf_hook_ops nat_fastpath_ops __read_mostly = {
+	.hook		= nat_fastpath_in,
+	.owner		= THIS_MODULE,
+	.pf		= NFPROTO_IPV4,
+	.hooknum	= NF_INET_PRE_ROUTING,
+	/* right after conntrack, before mangle and destination NAT */
+	.priority	= NF_IP_PRI_CONNTRACK + 1,
+};
+
+static int __init nf_nat_fastpath_init(void)
+{
+	/* nf_nat_packet() keeps nf_nat and with it conntrack loaded */
+	return nf_register_hook(&nat_fastpath_ops);
+}
+
+static void __exit nf_nat_fastpath_fini(void)
+{
+	nf_unregister_hook(&nat_fastpath_ops);
+}
+
+module_init(nf_nat_fastpath_init);
+module_exit(nf_nat_fastpath_fini);
+
+MODULE_DESCRIPTION("Forwarding fast path for established NAT connections");
+MODULE_LICENSE("GPL");
@@ -50,6 +50,14 @@ static struct snd_msm compressed_audio = {NULL, 0x2000} ;
 
 static struct audio_locks the_locks;
 
+/*
+ * Periods kept queued with the DSP.  The DSP is refilled whenever fewer
+ * are queued, so large periods keep the apps processor asleep between
+ * refills without the DSP running dry while it wakes up.
+ */
+static unsigned int queued_periods = 2;
+module_param(queued_periods, uint, 0644);
+
 static struct snd_pcm_hardware msm_compr_hardware_capture = {
 	.info =		 (SNDRV_PCM_INFO_MMAP |
 				SNDRV_PCM_INFO_BLOCK_TRANSFER |
@@ -102,26 +110,59 @@ static struct snd_pcm_hw_constraint_list constraints_sample_rates = {
 	.mask = 0,
 };
 
+/*
+ * Queue periods with the DSP until queued_periods are there or the
+ * application has written nothing more.  Returns the number queued.
+ */
+static int compr_queue_buffers(struct msm_audio *prtd)
+{
+	struct snd_pcm_runtime *runtime = prtd->substream->runtime;
+	struct audio_buffer *buf = prtd->audio_client->port[IN].buf;
+	struct audio_aio_write_param param;
+	int want = clamp_t(int, queued_periods, 1, runtime->periods - 1);
+	int sent = 0;
+
+	while (prtd->out_queued < want &&
+	       snd_pcm_playback_hw_avail(runtime) >
+			(snd_pcm_sframes_t)(prtd->out_queued *
+					    runtime->period_size)) {
+		pr_debug("%s:writing %d bytes of buffer[%d] to dsp\n",
+				__func__, prtd->pcm_count, prtd->out_head);
+		param.paddr = (unsigned long)buf[0].phys
+				+ (prtd->out_head * prtd->pcm_count);
+		param.len = prtd->pcm_count;
+		param.msw_ts = 0;
+		param.lsw_ts = 0;
+		param.flags = NO_TIMESTAMP;
+		param.uid = param.paddr;
+		if (q6asm_async_write(prtd->audio_client, &param) < 0) {
+			pr_err("%s:q6asm_async_write failed\n", __func__);
+			break;
+		}
+		prtd->out_head = (prtd->out_head + 1) & (runtime->periods - 1);
+		prtd->out_queued++;
+		sent++;
+	}
+	return sent;
+}
+
 static void compr_event_handler(uint32_t opcode,
 		uint32_t token, uint32_t *payload, void *priv)
 {
 	struct compr_audio *compr = priv;
 	struct msm_audio *prtd = &compr->prtd;
 	struct snd_pcm_substream *substream = prtd->substream;
-	struct snd_pcm_runtime *runtime = substream->runtime;
-	struct audio_aio_write_param param;
 	struct audio_aio_read_param read_param;
 	struct audio_buffer *buf = NULL;
 	uint32_t *ptrmem = (uint32_t *)payload;
-	int i = 0;
 
 	pr_debug("%s opcode =%08x\n", __func__, opcode);
 	switch (opcode) {
 	case ASM_DATA_EVENT_WRITE_DONE: {
-		uint32_t *ptrmem = (uint32_t *)&param;
 		pr_debug("ASM_DATA_EVENT_WRITE_DONE\n");
-		pr_debug("Buffer Consumed = 0x%08x\n", *ptrmem);
 		prtd->pcm_irq_pos += prtd->pcm_count;
+		if (prtd->out_queued)
+			prtd->out_queued--;
 		if (atomic_read(&prtd->start))
 			snd_pcm_period_elapsed(substream);
 		else
@@ -134,34 +175,7 @@ static void compr_event_handler(uint32_t opcode,
 			break;
 		} else
 			atomic_set(&prtd->pending_buffer, 0);
-		if (runtime->status->hw_ptr >= runtime->control->appl_ptr)
-			break;
-		buf = prtd->audio_client->port[IN].buf;
-		pr_debug("%s:writing %d bytes of buffer[%d] to dsp 2\n",
-				__func__, prtd->pcm_count, prtd->out_head);
-		pr_debug("%s:writing buffer[%d] from 0x%08x\n",
-				__func__, prtd->out_head,
-				((unsigned int)buf[0].phys
-				+ (prtd->out_head * prtd->pcm_count)));
-
-		param.paddr = (unsigned long)buf[0].phys
-				+ (prtd->out_head * prtd->pcm_count);
-		param.len = prtd->pcm_count;
-		param.msw_ts = 0;
-		param.lsw_ts = 0;
-		param.flags = NO_TIMESTAMP;
-		param.uid =  (unsigned long)buf[0].phys
-				+ (prtd->out_head * prtd->pcm_count);
-		for (i = 0; i < sizeof(struct audio_aio_write_param)/4;
-					i++, ++ptrmem)
-			pr_debug("cmd[%d]=0x%08x\n", i, *ptrmem);
-		if (q6asm_async_write(prtd->audio_client,
-					&param) < 0)
-			pr_err("%s:q6asm_async_write failed\n",
-				__func__);
-		else
-			prtd->out_head =
-				(prtd->out_head + 1) & (runtime->periods - 1);
+		compr_queue_buffers(prtd);
 		break;
 	}
 	case ASM_DATA_CMDRSP_EOS:
@@ -241,31 +255,9 @@ static void compr_event_handler(uint32_t opcode,
 				atomic_set(&prtd->start, 1);
 				break;
 			}
-			if (!atomic_read(&prtd->pending_buffer))
-				break;
-			pr_debug("%s:writing %d bytes"
-				" of buffer[%d] to dsp\n",
-				__func__, prtd->pcm_count, prtd->out_head);
-			buf = prtd->audio_client->port[IN].buf;
-			pr_debug("%s:writing buffer[%d] from 0x%08x\n",
-				__func__, prtd->out_head,
-				((unsigned int)buf[0].phys
-				+ (prtd->out_head * prtd->pcm_count)));
-			param.paddr = (unsigned long)buf[prtd->out_head].phys;
-			param.len = prtd->pcm_count;
-			param.msw_ts = 0;
-			param.lsw_ts = 0;
-			param.flags = NO_TIMESTAMP;
-			param.uid =  (unsigned long)buf[prtd->out_head].phys;
-			if (q6asm_async_write(prtd->audio_client,
-						&param) < 0)
-				pr_err("%s:q6asm_async_write failed\n",
-					__func__);
-			else
-				prtd->out_head =
-					(prtd->out_head + 1)
-					& (runtime->periods - 1);
-			atomic_set(&prtd->pending_buffer, 0);
+			/* top up whatever was consumed before the pause */
+			if (compr_queue_buffers(prtd))
+				atomic_set(&prtd->pending_buffer, 0);
 		}
 			break;
 		case ASM_STREAM_CMD_FLUSH:
@@ -302,6 +294,7 @@ static int msm_compr_playback_prepare(struct snd_pcm_substream *substream)
 	prtd->samp_rate = runtime->rate;
 	prtd->channel_mode = runtime->channels;
 	prtd->out_head = 0;
+	prtd->out_queued = 0;
 	atomic_set(&prtd->out_count, runtime->periods);
 
 	if (prtd->enabled)
@@ -608,8 +601,8 @@ int compressed_set_volume(unsigned volume)
 {
 	int rc = 0;
 	if (compressed_audio.prtd && compressed_audio.prtd->audio_client) {
-		rc = q6asm_set_volume(compressed_audio.prtd->audio_client,
-								 volume);
+		rc = q6asm_set_volume_nowait(
+				compressed_audio.prtd->audio_client, volume);
 		if (rc < 0) {
 			pr_err("%s: Send Volume command failed"
 					" rc=%d\n", __func__, rc);
@@ -922,6 +915,7 @@ static int msm_compr_ioctl(struct snd_pcm_substream *substream,
 		if (rc < 0)
 			pr_err("Flush cmd timeout\n");
 		prtd->pcm_irq_pos = 0;
+		prtd->out_queued = 0;
 		break;
 	default:
 		break;
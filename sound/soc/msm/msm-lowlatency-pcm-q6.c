@@ -45,8 +45,9 @@ struct snd_msm_volume {
 };
 
 #define PLAYBACK_NUM_PERIODS		2
+#define PLAYBACK_MAX_NUM_PERIODS	8
 #define PLAYBACK_MAX_PERIOD_SIZE	4096
-#define PLAYBACK_MIN_PERIOD_SIZE	512
+#define PLAYBACK_MIN_PERIOD_SIZE	256
 #define CAPTURE_NUM_PERIODS		2
 #define CAPTURE_MIN_PERIOD_SIZE		128
 #define CAPTURE_MAX_PERIOD_SIZE		1024
@@ -83,11 +84,12 @@ static struct snd_pcm_hardware msm_pcm_hardware_playback = {
 	.rate_max =             48000,
 	.channels_min =         1,
 	.channels_max =         6,
-	.buffer_bytes_max =     PLAYBACK_NUM_PERIODS * PLAYBACK_MAX_PERIOD_SIZE,
+	.buffer_bytes_max =     PLAYBACK_MAX_NUM_PERIODS *
+				PLAYBACK_MAX_PERIOD_SIZE,
 	.period_bytes_min =     PLAYBACK_MIN_PERIOD_SIZE,
 	.period_bytes_max =     PLAYBACK_MAX_PERIOD_SIZE,
 	.periods_min =          PLAYBACK_NUM_PERIODS,
-	.periods_max =          PLAYBACK_NUM_PERIODS,
+	.periods_max =          PLAYBACK_MAX_NUM_PERIODS,
 	.fifo_size =            0,
 };
 
@@ -104,6 +106,28 @@ static struct snd_pcm_hw_constraint_list constraints_sample_rates = {
 	.mask = 0,
 };
 
+/* q6asm walks its buffers with a mask, so their number is a power of two */
+static unsigned int supported_playback_periods[] = {
+	2, 4, 8
+};
+
+static struct snd_pcm_hw_constraint_list constraints_playback_periods = {
+	.count = ARRAY_SIZE(supported_playback_periods),
+	.list = supported_playback_periods,
+	.mask = 0,
+};
+
+/*
+ * In mmap mode the DSP walks the ring on its own: every buffer it is done
+ * with is handed back to it from the APR callback, without waking up the
+ * application.  Keeping more than one period queued avoids a gap in the
+ * DSP's input at each hand back, which is what limits small periods.
+ */
+static unsigned int mmap_queued_periods = 2;
+module_param(mmap_queued_periods, uint, 0644);
+MODULE_PARM_DESC(mmap_queued_periods,
+		 "Periods queued to the DSP ahead of playback in mmap mode");
+
 static void event_handler(uint32_t opcode,
 		uint32_t token, uint32_t *payload, void *priv)
 {
@@ -173,11 +197,15 @@ static void event_handler(uint32_t opcode,
 				break;
 			}
 			if (prtd->mmap_flag) {
-				pr_debug("%s:writing %d bytes buffer to dsp\n",
-					__func__, prtd->pcm_count);
-				q6asm_write_nolock(prtd->audio_client,
-					prtd->pcm_count,
-					0, 0, NO_TIMESTAMP);
+				unsigned int n = clamp(mmap_queued_periods, 1U,
+						substream->runtime->periods);
+
+				pr_debug("%s:writing %d x %d bytes to dsp\n",
+					__func__, n, prtd->pcm_count);
+				while (n--)
+					q6asm_write_nolock(prtd->audio_client,
+						prtd->pcm_count,
+						0, 0, NO_TIMESTAMP);
 			} else {
 				while (atomic_read(&prtd->out_needed)) {
 					pr_debug("%s:writing %d bytesto dsp\n",
@@ -370,11 +398,16 @@ static int msm_pcm_open(struct snd_pcm_substream *substream)
 		ret = snd_pcm_hw_constraint_minmax(runtime,
 			SNDRV_PCM_HW_PARAM_BUFFER_BYTES,
 			PLAYBACK_NUM_PERIODS * PLAYBACK_MIN_PERIOD_SIZE,
-			PLAYBACK_NUM_PERIODS * PLAYBACK_MAX_PERIOD_SIZE);
+			PLAYBACK_MAX_NUM_PERIODS * PLAYBACK_MAX_PERIOD_SIZE);
 		if (ret < 0) {
 			pr_err("constraint for buffer bytes min max ret = %d\n",
 									ret);
 		}
+		ret = snd_pcm_hw_constraint_list(runtime, 0,
+			SNDRV_PCM_HW_PARAM_PERIODS,
+			&constraints_playback_periods);
+		if (ret < 0)
+			pr_err("constraint for periods ret = %d\n", ret);
 	}
 
 	if (substream->stream == SNDRV_PCM_STREAM_CAPTURE) {
@@ -35,8 +35,26 @@
 #include "msm-pcm-q6.h"
 #include "msm-pcm-routing.h"
 
+#define LPA_DEEP_PERIOD_BYTES_MAX	(512 * 1024)
+#define LPA_DEEP_BUFFER_BYTES_MAX	(2048 * 1024)
+
 static struct audio_locks the_locks;
 
+/*
+ * Periods kept queued with the DSP.  The DSP is refilled whenever fewer
+ * are queued, so a late wakeup of the apps processor does not starve it.
+ */
+static unsigned int queued_periods = 2;
+module_param(queued_periods, uint, 0644);
+
+/*
+ * Deep buffer mode allows periods of up to 512KB, about three seconds of
+ * 44.1kHz stereo, so screen off playback wakes the apps processor only
+ * every few seconds.  Takes effect on the next open.
+ */
+static bool deep_buffer;
+module_param(deep_buffer, bool, 0644);
+
 struct snd_msm {
 	struct msm_audio *prtd;
 	unsigned volume;
@@ -75,27 +93,77 @@ static struct snd_pcm_hw_constraint_list constraints_sample_rates = {
 	.mask = 0,
 };
 
+/*
+ * Queue periods with the DSP until queued_periods are there or the
+ * application has written nothing more.  With @fill, an empty queue gets
+ * a period of silence to keep the DSP running; silence is only queued
+ * behind nothing, so the silent periods are always the oldest ones.
+ * Returns the number of periods queued.  Called with event_lock held.
+ */
+static int lpa_queue_buffers(struct msm_audio *prtd, bool fill)
+{
+	struct snd_pcm_runtime *runtime = prtd->substream->runtime;
+	struct audio_buffer *buf = prtd->audio_client->port[IN].buf;
+	struct audio_aio_write_param param;
+	int want = clamp_t(int, queued_periods, 1, runtime->periods - 1);
+	bool silent;
+	int sent = 0;
+
+	while (prtd->out_queued < want) {
+		silent = snd_pcm_playback_hw_avail(runtime) <=
+			(snd_pcm_sframes_t)(prtd->out_queued *
+					    runtime->period_size);
+		if (silent) {
+			if (!fill || prtd->out_queued)
+				break;
+			memset((void *)buf[0].data +
+				(prtd->out_head * prtd->pcm_count),
+				0, prtd->pcm_count);
+		}
+		pr_debug("%s:writing %d bytes of buffer[%d] to dsp\n",
+				__func__, prtd->pcm_count, prtd->out_head);
+
+		param.paddr = (unsigned long)buf[0].phys
+				+ (prtd->out_head * prtd->pcm_count);
+		param.len = prtd->pcm_count;
+		param.msw_ts = 0;
+		param.lsw_ts = 0;
+		param.flags = NO_TIMESTAMP;
+		param.uid = param.paddr;
+		if (q6asm_async_write(prtd->audio_client, &param) < 0) {
+			pr_err("%s:q6asm_async_write failed\n", __func__);
+			break;
+		}
+		prtd->out_head = (prtd->out_head + 1) & (runtime->periods - 1);
+		prtd->out_queued++;
+		sent++;
+		if (silent) {
+			prtd->out_silent++;
+			break;
+		}
+	}
+	return sent;
+}
+
 static void event_handler(uint32_t opcode,
 		uint32_t token, uint32_t *payload, void *priv)
 {
 	struct msm_audio *prtd = priv;
 	struct snd_pcm_substream *substream = prtd->substream;
-	struct snd_pcm_runtime *runtime = substream->runtime;
-	struct audio_aio_write_param param;
-	struct audio_buffer *buf = NULL;
 	unsigned long flag = 0;
-	int i = 0;
 
 	pr_debug("%s\n", __func__);
 	spin_lock_irqsave(&the_locks.event_lock, flag);
 	switch (opcode) {
 	case ASM_DATA_EVENT_WRITE_DONE: {
-		uint32_t *ptrmem = (uint32_t *)&param;
 		pr_debug("ASM_DATA_EVENT_WRITE_DONE\n");
-		pr_debug("Buffer Consumed = 0x%08x\n", *ptrmem);
 		prtd->pcm_irq_pos += prtd->pcm_count;
 		if (prtd->pcm_irq_pos >= prtd->pcm_size)
 			prtd->pcm_irq_pos = 0;
+		if (prtd->out_queued)
+			prtd->out_queued--;
+		if (prtd->out_silent)
+			prtd->out_silent--;
 		if (atomic_read(&prtd->start))
 			snd_pcm_period_elapsed(substream);
 		else
@@ -107,36 +175,8 @@ static void event_handler(uint32_t opcode,
 		if (!atomic_read(&prtd->start)) {
 			atomic_set(&prtd->pending_buffer, 1);
 			break;
-		} else
-			atomic_set(&prtd->pending_buffer, 0);
-
-		buf = prtd->audio_client->port[IN].buf;
-		if (runtime->status->hw_ptr >= runtime->control->appl_ptr) {
-			memset((void *)buf[0].data +
-				(prtd->out_head * prtd->pcm_count),
-				0, prtd->pcm_count);
 		}
-		pr_debug("%s:writing %d bytes of buffer to dsp 2\n",
-				__func__, prtd->pcm_count);
-
-		param.paddr = (unsigned long)buf[0].phys
-				+ (prtd->out_head * prtd->pcm_count);
-		param.len = prtd->pcm_count;
-		param.msw_ts = 0;
-		param.lsw_ts = 0;
-		param.flags = NO_TIMESTAMP;
-		param.uid =  (unsigned long)buf[0].phys
-				+ (prtd->out_head * prtd->pcm_count);
-		for (i = 0; i < sizeof(struct audio_aio_write_param)/4;
-					i++, ++ptrmem)
-			pr_debug("cmd[%d]=0x%08x\n", i, *ptrmem);
-		if (q6asm_async_write(prtd->audio_client,
-					&param) < 0)
-			pr_err("%s:q6asm_async_write failed\n",
-				__func__);
-		else
-			prtd->out_head =
-				(prtd->out_head + 1) & (runtime->periods - 1);
+		lpa_queue_buffers(prtd, true);
 		atomic_set(&prtd->pending_buffer, 0);
 		break;
 	}
@@ -147,32 +187,10 @@ static void event_handler(uint32_t opcode,
 		break;
 	case APR_BASIC_RSP_RESULT: {
 		switch (payload[0]) {
-		case ASM_SESSION_CMD_RUN: {
-			if (!atomic_read(&prtd->pending_buffer))
-				break;
-			if (runtime->status->hw_ptr >=
-				runtime->control->appl_ptr)
-				break;
-			pr_debug("%s:writing %d bytes"
-				" of buffer to dsp\n",
-				__func__, prtd->pcm_count);
-			buf = prtd->audio_client->port[IN].buf;
-			param.paddr = (unsigned long)buf[prtd->out_head].phys;
-			param.len = prtd->pcm_count;
-			param.msw_ts = 0;
-			param.lsw_ts = 0;
-			param.flags = NO_TIMESTAMP;
-			param.uid =  (unsigned long)buf[prtd->out_head].phys;
-			if (q6asm_async_write(prtd->audio_client,
-						&param) < 0)
-				pr_err("%s:q6asm_async_write failed\n",
-					__func__);
-			else
-				prtd->out_head =
-					(prtd->out_head + 1)
-					& (runtime->periods - 1);
-			atomic_set(&prtd->pending_buffer, 0);
-		}
+		case ASM_SESSION_CMD_RUN:
+			/* top up whatever was consumed before the pause */
+			if (lpa_queue_buffers(prtd, false))
+				atomic_set(&prtd->pending_buffer, 0);
 			break;
 		case ASM_STREAM_CMD_FLUSH:
 			pr_debug("ASM_STREAM_CMD_FLUSH\n");
@@ -205,6 +223,8 @@ static int msm_pcm_playback_prepare(struct snd_pcm_substream *substream)
 	prtd->samp_rate = runtime->rate;
 	prtd->channel_mode = runtime->channels;
 	prtd->out_head = 0;
+	prtd->out_queued = 0;
+	prtd->out_silent = 0;
 	if (prtd->enabled)
 		return 0;
 
@@ -281,6 +301,10 @@ static int msm_pcm_open(struct snd_pcm_substream *substream)
 		return -ENOMEM;
 	}
 	runtime->hw = msm_pcm_hardware;
+	if (deep_buffer) {
+		runtime->hw.period_bytes_max = LPA_DEEP_PERIOD_BYTES_MAX;
+		runtime->hw.buffer_bytes_max = LPA_DEEP_BUFFER_BYTES_MAX;
+	}
 	prtd->substream = substream;
 	prtd->audio_client = q6asm_audio_client_alloc(
 				(app_cb)event_handler, prtd);
@@ -348,7 +372,8 @@ int lpa_set_volume(unsigned volume)
 {
 	int rc = 0;
 	if (lpa_audio.prtd && lpa_audio.prtd->audio_client) {
-		rc = q6asm_set_volume(lpa_audio.prtd->audio_client, volume);
+		rc = q6asm_set_volume_nowait(lpa_audio.prtd->audio_client,
+					     volume);
 		if (rc < 0) {
 			pr_err("%s: Send Volume command failed"
 					" rc=%d\n", __func__, rc);
@@ -363,9 +388,19 @@ static int msm_pcm_playback_close(struct snd_pcm_substream *substream)
 	struct snd_pcm_runtime *runtime = substream->runtime;
 	struct snd_soc_pcm_runtime *soc_prtd = substream->private_data;
 	struct msm_audio *prtd = runtime->private_data;
+	unsigned long flag;
+	bool audible;
 	int dir = 0;
 	int rc = 0;
 
+	/*
+	 * Silence queued to keep the DSP running is dropped by the close
+	 * instead of being played out, so the next track is not held up.
+	 */
+	spin_lock_irqsave(&the_locks.event_lock, flag);
+	audible = prtd->out_queued != prtd->out_silent;
+	spin_unlock_irqrestore(&the_locks.event_lock, flag);
+
 	/*
 	If routing is still enabled, we need to issue EOS to
 	the DSP
@@ -373,7 +408,7 @@ static int msm_pcm_playback_close(struct snd_pcm_substream *substream)
 	EOS is not honored.
 	*/
 	if (msm_routing_check_backend_enabled(soc_prtd->dai_link->be_id) &&
-		(!atomic_read(&prtd->stop))) {
+		(!atomic_read(&prtd->stop)) && audible) {
 		rc = q6asm_run(prtd->audio_client, 0, 0, 0);
 		atomic_set(&prtd->pending_buffer, 0);
 		prtd->cmd_ack = 0;
@@ -470,7 +505,7 @@ static int msm_pcm_hw_params(struct snd_pcm_substream *substream,
 		return -EPERM;
 	ret = q6asm_audio_client_buf_alloc_contiguous(dir,
 			prtd->audio_client,
-			runtime->hw.period_bytes_min,
+			runtime->hw.buffer_bytes_max / runtime->hw.periods_max,
 			runtime->hw.periods_max);
 	if (ret < 0) {
 		pr_err("Audio Start: Buffer Allocation failed \
@@ -502,6 +537,7 @@ static int msm_pcm_ioctl(struct snd_pcm_substream *substream,
 	int rc = 0;
 	struct snd_pcm_runtime *runtime = substream->runtime;
 	struct msm_audio *prtd = runtime->private_data;
+	unsigned long flag;
 	uint64_t timestamp;
 	uint64_t temp;
 
@@ -540,6 +576,10 @@ static int msm_pcm_ioctl(struct snd_pcm_substream *substream,
 		if (rc < 0)
 			pr_err("Flush cmd timeout\n");
 		prtd->pcm_irq_pos = 0;
+		spin_lock_irqsave(&the_locks.event_lock, flag);
+		prtd->out_queued = 0;
+		prtd->out_silent = 0;
+		spin_unlock_irqrestore(&the_locks.event_lock, flag);
 		break;
 	default:
 		break;
@@ -76,6 +76,8 @@ struct msm_audio {
 	atomic_t in_count;
 	atomic_t out_needed;
 	int out_head;
+	int out_queued;		/* periods queued with the DSP */
+	int out_silent;		/* ... of which silence, the oldest ones */
 	int periods;
 	int mmap_flag;
 	atomic_t pending_buffer;
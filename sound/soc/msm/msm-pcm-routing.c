@@ -979,7 +979,7 @@ static void msm_send_eq_values(int eq_idx)
 		goto done;
 	}
 
-	result = q6asm_equalizer(ac, &eq_data[eq_idx]);
+	result = q6asm_equalizer_nowait(ac, &eq_data[eq_idx]);
 
 	if (result < 0)
 		pr_err("%s: Call to ASM equalizer failed, returned = %d\n",
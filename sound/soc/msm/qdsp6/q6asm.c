@@ -54,6 +54,9 @@
 #define READDONE_IDX_FLAGS 6
 #define READDONE_IDX_NUMFRAMES 7
 #define READDONE_IDX_ID 8
+/* the equalizer carries the largest pp params payload */
+#define ASM_PP_CMD_MAX_SIZE (sizeof(struct asm_pp_params_command) + \
+				sizeof(struct asm_equalizer_params))
 #ifdef CONFIG_DEBUG_FS
 #define OUT_BUFFER_SIZE 56
 #define IN_BUFFER_SIZE 24
@@ -377,6 +380,7 @@ void q6asm_audio_client_free(struct audio_client *ac)
 		pr_debug("%s:APR De-Register common port\n", __func__);
 	}
 done:
+	kfree(ac->pp_cmd);
 	kfree(ac);
 	return;
 }
@@ -406,6 +410,9 @@ struct audio_client *q6asm_audio_client_alloc(app_cb cb, void *priv)
 	ac = kzalloc(sizeof(struct audio_client), GFP_KERNEL);
 	if (!ac)
 		return NULL;
+	ac->pp_cmd = kzalloc(ASM_PP_CMD_MAX_SIZE, GFP_KERNEL);
+	if (!ac->pp_cmd)
+		goto fail_session;
 	n = q6asm_session_alloc(ac);
 	if (n <= 0)
 		goto fail_session;
@@ -448,6 +455,8 @@ struct audio_client *q6asm_audio_client_alloc(app_cb cb, void *priv)
 	}
 	atomic_set(&ac->cmd_state, 0);
 	atomic_set(&ac->cmd_response, 0);
+	mutex_init(&ac->pp_lock);
+	atomic_set(&ac->pp_nowait_cnt, 0);
 
 	pr_debug("%s: session[%d]\n", __func__, ac->session);
 
@@ -456,6 +465,7 @@ fail:
 	q6asm_audio_client_free(ac);
 	return NULL;
 fail_session:
+	kfree(ac->pp_cmd);
 	kfree(ac);
 	return NULL;
 }
@@ -852,6 +862,15 @@ static int32_t q6asm_callback(struct apr_client_data *data, void *priv)
 			if (rtac_make_asm_callback(ac->session, payload,
 					data->payload_size))
 				break;
+			if (atomic_add_unless(&ac->pp_nowait_cnt, -1, 0)) {
+				/* ack of a _nowait() pp params command */
+				wake_up(&ac->cmd_wait);
+				if (ac->cb)
+					ac->cb(data->opcode, data->token,
+						(uint32_t *)data->payload,
+						ac->priv);
+				break;
+			}
 		case ASM_SESSION_CMD_PAUSE:
 		case ASM_DATA_CMD_EOS:
 		case ASM_STREAM_CMD_CLOSE:
@@ -2664,60 +2683,101 @@ fail_cmd:
 	return rc;
 }
 
-int q6asm_set_lrgain(struct audio_client *ac, int left_gain, int right_gain)
+/*
+ * All pp params commands of a client are built in its preallocated
+ * ac->pp_cmd packet under ac->pp_lock; apr_send_pkt() copies the packet
+ * into the shared ring, so it can be reused as soon as that returns.
+ *
+ * A _nowait() command does not wait for its ack, the ack is passed to
+ * the client callback when it arrives.  Its ack comes back as
+ * ASM_STREAM_CMD_SET_PP_PARAMS just like that of a waiting command, so
+ * a waiting command is only sent once all earlier _nowait() ones were
+ * acked, and no _nowait() command is sent while one waits.
+ */
+static struct asm_pp_params_command *q6asm_pp_cmd_get(struct audio_client *ac,
+						uint32_t param_size,
+						bool nowait)
 {
-	void *vol_cmd = NULL;
-	void *payload = NULL;
-	struct asm_pp_params_command *cmd = NULL;
-	struct asm_lrchannel_gain_params *lrgain = NULL;
-	int sz = 0;
-	int rc  = 0;
-
-	sz = sizeof(struct asm_pp_params_command) +
-		+ sizeof(struct asm_lrchannel_gain_params);
-	vol_cmd = kzalloc(sz, GFP_KERNEL);
-	if (vol_cmd == NULL) {
-		pr_err("%s[%d]: Mem alloc failed\n", __func__, ac->session);
-		rc = -EINVAL;
-		return rc;
+	struct asm_pp_params_command *cmd = ac->pp_cmd;
+	uint32_t sz = sizeof(struct asm_pp_params_command) + param_size;
+
+	mutex_lock(&ac->pp_lock);
+	if (!nowait && !wait_event_timeout(ac->cmd_wait,
+			(atomic_read(&ac->pp_nowait_cnt) == 0), 5*HZ)) {
+		pr_err("%s: timeout waiting for %d nowait pp acks\n",
+			__func__, atomic_read(&ac->pp_nowait_cnt));
+		atomic_set(&ac->pp_nowait_cnt, 0);
 	}
-	cmd = (struct asm_pp_params_command *)vol_cmd;
-	q6asm_add_hdr_async(ac, &cmd->hdr, sz, TRUE);
+
+	memset(cmd, 0, sz);
+	q6asm_add_hdr(ac, &cmd->hdr, sz, !nowait);
+	cmd->hdr.token = ac->session;
 	cmd->hdr.opcode = ASM_STREAM_CMD_SET_PP_PARAMS;
 	cmd->payload = NULL;
-	cmd->payload_size = sizeof(struct  asm_pp_param_data_hdr) +
-				sizeof(struct asm_lrchannel_gain_params);
-	cmd->params.module_id = VOLUME_CONTROL_MODULE_ID;
-	cmd->params.param_id = L_R_CHANNEL_GAIN_PARAM_ID;
-	cmd->params.param_size = sizeof(struct asm_lrchannel_gain_params);
+	cmd->payload_size = sizeof(struct  asm_pp_param_data_hdr) + param_size;
+	cmd->params.param_size = param_size;
 	cmd->params.reserved = 0;
+	return cmd;
+}
 
-	payload = (u8 *)(vol_cmd + sizeof(struct asm_pp_params_command));
-	lrgain = (struct asm_lrchannel_gain_params *)payload;
+/* Send the packet set up by q6asm_pp_cmd_get() and release it */
+static int q6asm_pp_cmd_send(struct audio_client *ac, bool nowait,
+			     const char *name)
+{
+	int rc;
 
-	lrgain->left_gain = left_gain;
-	lrgain->right_gain = right_gain;
-	rc = apr_send_pkt(ac->apr, (uint32_t *) vol_cmd);
+	/* counted first, the ack may be in before apr_send_pkt() returns */
+	if (nowait)
+		atomic_inc(&ac->pp_nowait_cnt);
+	rc = apr_send_pkt(ac->apr, (uint32_t *) ac->pp_cmd);
 	if (rc < 0) {
-		pr_err("%s: Volume Command failed\n", __func__);
+		pr_err("%s: %s Command failed\n", __func__, name);
+		if (nowait)
+			atomic_dec(&ac->pp_nowait_cnt);
 		rc = -EINVAL;
-		goto fail_cmd;
+		goto done;
 	}
 
-	rc = wait_event_timeout(ac->cmd_wait,
-			(atomic_read(&ac->cmd_state) == 0), 5*HZ);
-	if (!rc) {
-		pr_err("%s: timeout in sending volume command to apr\n",
-			__func__);
+	rc = 0;
+	if (!nowait && !wait_event_timeout(ac->cmd_wait,
+			(atomic_read(&ac->cmd_state) == 0), 5*HZ)) {
+		pr_err("%s: timeout in sending %s command to apr\n",
+			__func__, name);
 		rc = -EINVAL;
-		goto fail_cmd;
 	}
-	rc = 0;
-fail_cmd:
-	kfree(vol_cmd);
+done:
+	mutex_unlock(&ac->pp_lock);
 	return rc;
 }
 
+static int __q6asm_set_lrgain(struct audio_client *ac, int left_gain,
+			      int right_gain, bool nowait)
+{
+	struct asm_pp_params_command *cmd;
+	struct asm_lrchannel_gain_params *lrgain;
+
+	cmd = q6asm_pp_cmd_get(ac, sizeof(struct asm_lrchannel_gain_params),
+			       nowait);
+	cmd->params.module_id = VOLUME_CONTROL_MODULE_ID;
+	cmd->params.param_id = L_R_CHANNEL_GAIN_PARAM_ID;
+
+	lrgain = (struct asm_lrchannel_gain_params *)(cmd + 1);
+	lrgain->left_gain = left_gain;
+	lrgain->right_gain = right_gain;
+	return q6asm_pp_cmd_send(ac, nowait, "volume");
+}
+
+int q6asm_set_lrgain(struct audio_client *ac, int left_gain, int right_gain)
+{
+	return __q6asm_set_lrgain(ac, left_gain, right_gain, false);
+}
+
+int q6asm_set_lrgain_nowait(struct audio_client *ac, int left_gain,
+			    int right_gain)
+{
+	return __q6asm_set_lrgain(ac, left_gain, right_gain, true);
+}
+
 static int q6asm_memory_map_regions(struct audio_client *ac, int dir,
 				uint32_t bufsz, uint32_t bufcnt)
 {
@@ -2850,145 +2910,69 @@ fail_cmd:
 	return rc;
 }
 
-int q6asm_set_mute(struct audio_client *ac, int muteflag)
+static int __q6asm_set_mute(struct audio_client *ac, int muteflag,
+			    bool nowait)
 {
-	void *vol_cmd = NULL;
-	void *payload = NULL;
-	struct asm_pp_params_command *cmd = NULL;
-	struct asm_mute_params *mute = NULL;
-	int sz = 0;
-	int rc  = 0;
-
-	sz = sizeof(struct asm_pp_params_command) +
-		+ sizeof(struct asm_mute_params);
-	vol_cmd = kzalloc(sz, GFP_KERNEL);
-	if (vol_cmd == NULL) {
-		pr_err("%s[%d]: Mem alloc failed\n", __func__, ac->session);
-		rc = -EINVAL;
-		return rc;
-	}
-	cmd = (struct asm_pp_params_command *)vol_cmd;
-	q6asm_add_hdr_async(ac, &cmd->hdr, sz, TRUE);
-	cmd->hdr.opcode = ASM_STREAM_CMD_SET_PP_PARAMS;
-	cmd->payload = NULL;
-	cmd->payload_size = sizeof(struct  asm_pp_param_data_hdr) +
-				sizeof(struct asm_mute_params);
+	struct asm_pp_params_command *cmd;
+	struct asm_mute_params *mute;
+
+	cmd = q6asm_pp_cmd_get(ac, sizeof(struct asm_mute_params), nowait);
 	cmd->params.module_id = VOLUME_CONTROL_MODULE_ID;
 	cmd->params.param_id = MUTE_CONFIG_PARAM_ID;
-	cmd->params.param_size = sizeof(struct asm_mute_params);
-	cmd->params.reserved = 0;
-
-	payload = (u8 *)(vol_cmd + sizeof(struct asm_pp_params_command));
-	mute = (struct asm_mute_params *)payload;
 
+	mute = (struct asm_mute_params *)(cmd + 1);
 	mute->muteflag = muteflag;
-	rc = apr_send_pkt(ac->apr, (uint32_t *) vol_cmd);
-	if (rc < 0) {
-		pr_err("%s: Mute Command failed\n", __func__);
-		rc = -EINVAL;
-		goto fail_cmd;
-	}
+	return q6asm_pp_cmd_send(ac, nowait, "mute");
+}
 
-	rc = wait_event_timeout(ac->cmd_wait,
-			(atomic_read(&ac->cmd_state) == 0), 5*HZ);
-	if (!rc) {
-		pr_err("%s: timeout in sending mute command to apr\n",
-			__func__);
-		rc = -EINVAL;
-		goto fail_cmd;
-	}
-	rc = 0;
-fail_cmd:
-	kfree(vol_cmd);
-	return rc;
+int q6asm_set_mute(struct audio_client *ac, int muteflag)
+{
+	return __q6asm_set_mute(ac, muteflag, false);
 }
 
-int q6asm_set_volume(struct audio_client *ac, int volume)
+int q6asm_set_mute_nowait(struct audio_client *ac, int muteflag)
 {
-	void *vol_cmd = NULL;
-	void *payload = NULL;
-	struct asm_pp_params_command *cmd = NULL;
-	struct asm_master_gain_params *mgain = NULL;
-	int sz = 0;
-	int rc  = 0;
-
-	sz = sizeof(struct asm_pp_params_command) +
-		+ sizeof(struct asm_master_gain_params);
-	vol_cmd = kzalloc(sz, GFP_KERNEL);
-	if (vol_cmd == NULL) {
-		pr_err("%s[%d]: Mem alloc failed\n", __func__, ac->session);
-		rc = -EINVAL;
-		return rc;
-	}
-	cmd = (struct asm_pp_params_command *)vol_cmd;
-	q6asm_add_hdr_async(ac, &cmd->hdr, sz, TRUE);
-	cmd->hdr.opcode = ASM_STREAM_CMD_SET_PP_PARAMS;
-	cmd->payload = NULL;
-	cmd->payload_size = sizeof(struct  asm_pp_param_data_hdr) +
-				sizeof(struct asm_master_gain_params);
+	return __q6asm_set_mute(ac, muteflag, true);
+}
+
+static int __q6asm_set_volume(struct audio_client *ac, int volume,
+			      bool nowait)
+{
+	struct asm_pp_params_command *cmd;
+	struct asm_master_gain_params *mgain;
+
+	cmd = q6asm_pp_cmd_get(ac, sizeof(struct asm_master_gain_params),
+			       nowait);
 	cmd->params.module_id = VOLUME_CONTROL_MODULE_ID;
 	cmd->params.param_id = MASTER_GAIN_PARAM_ID;
-	cmd->params.param_size = sizeof(struct asm_master_gain_params);
-	cmd->params.reserved = 0;
-
-	payload = (u8 *)(vol_cmd + sizeof(struct asm_pp_params_command));
-	mgain = (struct asm_master_gain_params *)payload;
 
+	mgain = (struct asm_master_gain_params *)(cmd + 1);
 	mgain->master_gain = volume;
 	mgain->padding = 0x00;
-	rc = apr_send_pkt(ac->apr, (uint32_t *) vol_cmd);
-	if (rc < 0) {
-		pr_err("%s: Volume Command failed\n", __func__);
-		rc = -EINVAL;
-		goto fail_cmd;
-	}
+	return q6asm_pp_cmd_send(ac, nowait, "volume");
+}
 
-	rc = wait_event_timeout(ac->cmd_wait,
-			(atomic_read(&ac->cmd_state) == 0), 5*HZ);
-	if (!rc) {
-		pr_err("%s: timeout in sending volume command to apr\n",
-			__func__);
-		rc = -EINVAL;
-		goto fail_cmd;
-	}
-	rc = 0;
-fail_cmd:
-	kfree(vol_cmd);
-	return rc;
+int q6asm_set_volume(struct audio_client *ac, int volume)
+{
+	return __q6asm_set_volume(ac, volume, false);
+}
+
+int q6asm_set_volume_nowait(struct audio_client *ac, int volume)
+{
+	return __q6asm_set_volume(ac, volume, true);
 }
 
 int q6asm_set_softpause(struct audio_client *ac,
 			struct asm_softpause_params *pause_param)
 {
-	void *vol_cmd = NULL;
-	void *payload = NULL;
-	struct asm_pp_params_command *cmd = NULL;
-	struct asm_softpause_params *params = NULL;
-	int sz = 0;
-	int rc  = 0;
-
-	sz = sizeof(struct asm_pp_params_command) +
-		+ sizeof(struct asm_softpause_params);
-	vol_cmd = kzalloc(sz, GFP_KERNEL);
-	if (vol_cmd == NULL) {
-		pr_err("%s[%d]: Mem alloc failed\n", __func__, ac->session);
-		rc = -EINVAL;
-		return rc;
-	}
-	cmd = (struct asm_pp_params_command *)vol_cmd;
-	q6asm_add_hdr_async(ac, &cmd->hdr, sz, TRUE);
-	cmd->hdr.opcode = ASM_STREAM_CMD_SET_PP_PARAMS;
-	cmd->payload = NULL;
-	cmd->payload_size = sizeof(struct  asm_pp_param_data_hdr) +
-				sizeof(struct asm_softpause_params);
+	struct asm_pp_params_command *cmd;
+	struct asm_softpause_params *params;
+
+	cmd = q6asm_pp_cmd_get(ac, sizeof(struct asm_softpause_params), false);
 	cmd->params.module_id = VOLUME_CONTROL_MODULE_ID;
 	cmd->params.param_id = SOFT_PAUSE_PARAM_ID;
-	cmd->params.param_size = sizeof(struct asm_softpause_params);
-	cmd->params.reserved = 0;
-
-	payload = (u8 *)(vol_cmd + sizeof(struct asm_pp_params_command));
-	params = (struct asm_softpause_params *)payload;
 
+	params = (struct asm_softpause_params *)(cmd + 1);
 	params->enable = pause_param->enable;
 	params->period = pause_param->period;
 	params->step = pause_param->step;
@@ -2996,59 +2980,21 @@ int q6asm_set_softpause(struct audio_client *ac,
 	pr_debug("%s: soft Pause Command: enable = %d, period = %d, step = %d, curve = %d\n",
 			 __func__, params->enable,
 			 params->period, params->step, params->rampingcurve);
-	rc = apr_send_pkt(ac->apr, (uint32_t *) vol_cmd);
-	if (rc < 0) {
-		pr_err("%s: Volume Command(soft_pause) failed\n", __func__);
-		rc = -EINVAL;
-		goto fail_cmd;
-	}
-
-	rc = wait_event_timeout(ac->cmd_wait,
-			(atomic_read(&ac->cmd_state) == 0), 5*HZ);
-	if (!rc) {
-		pr_err("%s: timeout in sending volume command(soft_pause) to apr\n",
-						 __func__);
-		rc = -EINVAL;
-		goto fail_cmd;
-	}
-	rc = 0;
-fail_cmd:
-	kfree(vol_cmd);
-	return rc;
+	return q6asm_pp_cmd_send(ac, false, "volume(soft_pause)");
 }
 
 int q6asm_set_softvolume(struct audio_client *ac,
 			struct asm_softvolume_params *softvol_param)
 {
-	void *vol_cmd = NULL;
-	void *payload = NULL;
-	struct asm_pp_params_command *cmd = NULL;
-	struct asm_softvolume_params *params = NULL;
-	int sz = 0;
-	int rc  = 0;
-
-	sz = sizeof(struct asm_pp_params_command) +
-		+ sizeof(struct asm_softvolume_params);
-	vol_cmd = kzalloc(sz, GFP_KERNEL);
-	if (vol_cmd == NULL) {
-		pr_err("%s[%d]: Mem alloc failed\n", __func__, ac->session);
-		rc = -EINVAL;
-		return rc;
-	}
-	cmd = (struct asm_pp_params_command *)vol_cmd;
-	q6asm_add_hdr_async(ac, &cmd->hdr, sz, TRUE);
-	cmd->hdr.opcode = ASM_STREAM_CMD_SET_PP_PARAMS;
-	cmd->payload = NULL;
-	cmd->payload_size = sizeof(struct  asm_pp_param_data_hdr) +
-				sizeof(struct asm_softvolume_params);
+	struct asm_pp_params_command *cmd;
+	struct asm_softvolume_params *params;
+
+	cmd = q6asm_pp_cmd_get(ac, sizeof(struct asm_softvolume_params),
+			       false);
 	cmd->params.module_id = VOLUME_CONTROL_MODULE_ID;
 	cmd->params.param_id = SOFT_VOLUME_PARAM_ID;
-	cmd->params.param_size = sizeof(struct asm_softvolume_params);
-	cmd->params.reserved = 0;
-
-	payload = (u8 *)(vol_cmd + sizeof(struct asm_pp_params_command));
-	params = (struct asm_softvolume_params *)payload;
 
+	params = (struct asm_softvolume_params *)(cmd + 1);
 	params->period = softvol_param->period;
 	params->step = softvol_param->step;
 	params->rampingcurve = softvol_param->rampingcurve;
@@ -3060,59 +3006,21 @@ int q6asm_set_softvolume(struct audio_client *ac,
 	pr_debug("%s: soft Volume Command: period = %d, step = %d, curve = %d\n",
 			 __func__, params->period,
 			 params->step, params->rampingcurve);
-	rc = apr_send_pkt(ac->apr, (uint32_t *) vol_cmd);
-	if (rc < 0) {
-		pr_err("%s: Volume Command(soft_volume) failed\n", __func__);
-		rc = -EINVAL;
-		goto fail_cmd;
-	}
-
-	rc = wait_event_timeout(ac->cmd_wait,
-			(atomic_read(&ac->cmd_state) == 0), 5*HZ);
-	if (!rc) {
-		pr_err("%s: timeout in sending volume command(soft_volume) to apr\n",
-							 __func__);
-		rc = -EINVAL;
-		goto fail_cmd;
-	}
-	rc = 0;
-fail_cmd:
-	kfree(vol_cmd);
-	return rc;
+	return q6asm_pp_cmd_send(ac, false, "volume(soft_volume)");
 }
 
-int q6asm_equalizer(struct audio_client *ac, void *eq)
+static int __q6asm_equalizer(struct audio_client *ac, void *eq, bool nowait)
 {
-	void *eq_cmd = NULL;
-	void *payload = NULL;
-	struct asm_pp_params_command *cmd = NULL;
-	struct asm_equalizer_params *equalizer = NULL;
+	struct asm_pp_params_command *cmd;
+	struct asm_equalizer_params *equalizer;
 	struct msm_audio_eq_stream_config *eq_params = NULL;
 	int i  = 0;
-	int sz = 0;
-	int rc  = 0;
-
-	sz = sizeof(struct asm_pp_params_command) +
-		+ sizeof(struct asm_equalizer_params);
-	eq_cmd = kzalloc(sz, GFP_KERNEL);
-	if (eq_cmd == NULL) {
-		pr_err("%s[%d]: Mem alloc failed\n", __func__, ac->session);
-		rc = -EINVAL;
-		goto fail_cmd;
-	}
+
 	eq_params = (struct msm_audio_eq_stream_config *) eq;
-	cmd = (struct asm_pp_params_command *)eq_cmd;
-	q6asm_add_hdr(ac, &cmd->hdr, sz, TRUE);
-	cmd->hdr.opcode = ASM_STREAM_CMD_SET_PP_PARAMS;
-	cmd->payload = NULL;
-	cmd->payload_size = sizeof(struct  asm_pp_param_data_hdr) +
-				sizeof(struct asm_equalizer_params);
+	cmd = q6asm_pp_cmd_get(ac, sizeof(struct asm_equalizer_params), nowait);
 	cmd->params.module_id = EQUALIZER_MODULE_ID;
 	cmd->params.param_id = EQUALIZER_PARAM_ID;
-	cmd->params.param_size = sizeof(struct asm_equalizer_params);
-	cmd->params.reserved = 0;
-	payload = (u8 *)(eq_cmd + sizeof(struct asm_pp_params_command));
-	equalizer = (struct asm_equalizer_params *)payload;
+	equalizer = (struct asm_equalizer_params *)(cmd + 1);
 
 	equalizer->enable = eq_params->enable;
 	equalizer->num_bands = eq_params->num_bands;
@@ -3138,25 +3046,17 @@ int q6asm_equalizer(struct audio_client *ac, void *eq)
 		pr_debug("%s: q_factor:%d bandnum:%d\n", __func__,
 				eq_params->eq_bands[i].q_factor, i);
 	}
-	rc = apr_send_pkt(ac->apr, (uint32_t *) eq_cmd);
-	if (rc < 0) {
-		pr_err("%s: Equalizer Command failed\n", __func__);
-		rc = -EINVAL;
-		goto fail_cmd;
-	}
+	return q6asm_pp_cmd_send(ac, nowait, "equalizer");
+}
 
-	rc = wait_event_timeout(ac->cmd_wait,
-			(atomic_read(&ac->cmd_state) == 0), 5*HZ);
-	if (!rc) {
-		pr_err("%s: timeout in sending equalizer command to apr\n",
-			__func__);
-		rc = -EINVAL;
-		goto fail_cmd;
-	}
-	rc = 0;
-fail_cmd:
-	kfree(eq_cmd);
-	return rc;
+int q6asm_equalizer(struct audio_client *ac, void *eq)
+{
+	return __q6asm_equalizer(ac, eq, false);
+}
+
+int q6asm_equalizer_nowait(struct audio_client *ac, void *eq)
+{
+	return __q6asm_equalizer(ac, eq, true);
 }
 
 int q6asm_read(struct audio_client *ac)
@@ -0,0 +1,842 @@
+/*
+ * binder_bench - binder IPC latency and throughput benchmark
+ *
+ * Pairs of client and server processes are forked and the clients send
+ * transactions to their server as fast as they can, synchronous ones that
+ * wait for the reply or oneway ones that complete once queued.  The
+ * payload size, whether a file descriptor goes with each transaction and
+ * the number of pairs running at once are varied, and for each
+ * combination the transaction rate, its scaling over a single pair and
+ * the distribution of the per transaction latency are printed.
+ *
+ * Servers are published under a name of their own with the context
+ * manager.  When servicemanager runs that is it, which needs root, else
+ * a process of the benchmark takes the role and speaks the same protocol.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "binder.h"
+
+#define BINDER_DEV		"/dev/binder"
+#define BINDER_MAP_SIZE		(1024 * 1024 - 2 * 4096)
+#define MAX_PAIRS		64
+#define MAX_SIZES		16
+#define MAX_SERVICES		256
+#define MAX_OBJS		4
+
+/* servicemanager transaction codes */
+#define SVC_MGR_CHECK_SERVICE	2
+#define SVC_MGR_ADD_SERVICE	3
+
+/* benchmark transaction codes */
+#define BENCH_CALL		1
+#define BENCH_QUIT		2
+
+static const char svcmgr_id[] = "android.os.IServiceManager";
+
+struct binder_state {
+	int fd;
+	void *map;
+	uint8_t wbuf[512];
+	size_t wlen;
+	uint8_t rbuf[512];
+	size_t rpos, rlen;
+};
+
+struct parcel {
+	uint8_t *data;
+	size_t len, cap;
+	size_t offs[MAX_OBJS];
+	size_t nr_offs;
+	/* reading */
+	size_t pos;
+};
+
+struct client_result {
+	uint32_t nr;
+	uint32_t failed;
+	uint64_t elapsed_ns;
+};
+
+static int opt_iterations = 10000;
+static int opt_pin;
+static int nr_cpus;
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void pin_to_cpu(int cpu)
+{
+	cpu_set_t set;
+
+	if (!opt_pin)
+		return;
+	CPU_ZERO(&set);
+	CPU_SET(cpu % nr_cpus, &set);
+	if (sched_setaffinity(0, sizeof(set), &set))
+		perror("sched_setaffinity");
+}
+
+static void binder_open_state(struct binder_state *bs)
+{
+	struct binder_version version;
+
+	memset(bs, 0, sizeof(*bs));
+	bs->fd = open(BINDER_DEV, O_RDWR);
+	if (bs->fd < 0)
+		die("open " BINDER_DEV);
+	if (ioctl(bs->fd, BINDER_VERSION, &version) ||
+	    version.protocol_version != BINDER_CURRENT_PROTOCOL_VERSION) {
+		fprintf(stderr, "binder protocol version mismatch\n");
+		exit(1);
+	}
+	bs->map = mmap(NULL, BINDER_MAP_SIZE, PROT_READ, MAP_PRIVATE,
+		       bs->fd, 0);
+	if (bs->map == MAP_FAILED)
+		die("mmap " BINDER_DEV);
+}
+
+/* queue a command, it is written with the next read */
+static void binder_queue(struct binder_state *bs, uint32_t cmd,
+			 const void *arg, size_t len)
+{
+	if (bs->wlen + sizeof(cmd) + len > sizeof(bs->wbuf)) {
+		fprintf(stderr, "binder write buffer overflow\n");
+		exit(1);
+	}
+	memcpy(bs->wbuf + bs->wlen, &cmd, sizeof(cmd));
+	memcpy(bs->wbuf + bs->wlen + sizeof(cmd), arg, len);
+	bs->wlen += sizeof(cmd) + len;
+}
+
+static void binder_queue_u32(struct binder_state *bs, uint32_t cmd,
+			     uint32_t val)
+{
+	binder_queue(bs, cmd, &val, sizeof(val));
+}
+
+static void binder_queue_free(struct binder_state *bs, const void *buffer)
+{
+	binder_queue(bs, BC_FREE_BUFFER, &buffer, sizeof(buffer));
+}
+
+static void binder_queue_txn(struct binder_state *bs, uint32_t cmd,
+			     size_t handle, uint32_t code, uint32_t flags,
+			     struct parcel *p)
+{
+	struct binder_transaction_data txn;
+
+	memset(&txn, 0, sizeof(txn));
+	txn.target.handle = handle;
+	txn.code = code;
+	txn.flags = flags;
+	txn.data_size = p->len;
+	txn.offsets_size = p->nr_offs * sizeof(size_t);
+	txn.data.ptr.buffer = p->data;
+	txn.data.ptr.offsets = p->offs;
+	binder_queue(bs, cmd, &txn, sizeof(txn));
+}
+
+/* write what is queued and read what the driver has for us */
+static void binder_transfer(struct binder_state *bs)
+{
+	struct binder_write_read bwr;
+
+	bwr.write_size = bs->wlen;
+	bwr.write_consumed = 0;
+	bwr.write_buffer = (unsigned long)bs->wbuf;
+	bwr.read_size = sizeof(bs->rbuf);
+	bwr.read_consumed = 0;
+	bwr.read_buffer = (unsigned long)bs->rbuf;
+
+	while (ioctl(bs->fd, BINDER_WRITE_READ, &bwr) < 0) {
+		if (errno != EINTR)
+			die("BINDER_WRITE_READ");
+	}
+	bs->wlen = 0;
+	bs->rpos = 0;
+	bs->rlen = bwr.read_consumed;
+}
+
+/*
+ * Return the next transaction related event, the ones for reference
+ * counting are acknowledged on the way.  @txn is filled in for
+ * BR_TRANSACTION and BR_REPLY.
+ */
+static uint32_t binder_next(struct binder_state *bs,
+			    struct binder_transaction_data *txn)
+{
+	struct binder_ptr_cookie *pc;
+	uint32_t cmd;
+	void *arg;
+
+	for (;;) {
+		while (bs->rpos >= bs->rlen)
+			binder_transfer(bs);
+
+		memcpy(&cmd, bs->rbuf + bs->rpos, sizeof(cmd));
+		arg = bs->rbuf + bs->rpos + sizeof(cmd);
+		bs->rpos += sizeof(cmd) + _IOC_SIZE(cmd);
+
+		switch (cmd) {
+		case BR_NOOP:
+		case BR_SPAWN_LOOPER:
+		case BR_OK:
+		case BR_RELEASE:
+		case BR_DECREFS:
+		case BR_DEAD_BINDER:
+		case BR_CLEAR_DEATH_NOTIFICATION_DONE:
+			break;
+		case BR_INCREFS:
+			pc = arg;
+			binder_queue(bs, BC_INCREFS_DONE, pc, sizeof(*pc));
+			break;
+		case BR_ACQUIRE:
+			pc = arg;
+			binder_queue(bs, BC_ACQUIRE_DONE, pc, sizeof(*pc));
+			break;
+		case BR_TRANSACTION:
+		case BR_REPLY:
+			memcpy(txn, arg, sizeof(*txn));
+			return cmd;
+		case BR_TRANSACTION_COMPLETE:
+		case BR_FAILED_REPLY:
+		case BR_DEAD_REPLY:
+		case BR_ERROR:
+			return cmd;
+		default:
+			fprintf(stderr, "unexpected binder return %#x\n", cmd);
+			exit(1);
+		}
+	}
+}
+
+/* synchronous call, 0 and a reply to free or -1 if it failed */
+static int binder_call(struct binder_state *bs, size_t handle, uint32_t code,
+		       struct parcel *p, struct binder_transaction_data *reply)
+{
+	binder_queue_txn(bs, BC_TRANSACTION, handle, code, 0, p);
+	for (;;) {
+		switch (binder_next(bs, reply)) {
+		case BR_REPLY:
+			return 0;
+		case BR_TRANSACTION_COMPLETE:
+			break;
+		case BR_TRANSACTION:
+			fprintf(stderr, "unexpected incoming transaction\n");
+			exit(1);
+		default:
+			return -1;
+		}
+	}
+}
+
+static void parcel_init(struct parcel *p, size_t cap)
+{
+	memset(p, 0, sizeof(*p));
+	p->cap = cap;
+	p->data = calloc(1, cap);
+	if (!p->data)
+		die("calloc");
+}
+
+/* a parcel reading the data of a received transaction */
+static void parcel_from_txn(struct parcel *p,
+			    struct binder_transaction_data *txn)
+{
+	memset(p, 0, sizeof(*p));
+	p->data = (uint8_t *)txn->data.ptr.buffer;
+	p->len = p->cap = txn->data_size;
+	p->nr_offs = txn->offsets_size / sizeof(size_t);
+	if (p->nr_offs > MAX_OBJS)
+		p->nr_offs = MAX_OBJS;
+	memcpy(p->offs, txn->data.ptr.offsets, p->nr_offs * sizeof(size_t));
+}
+
+static void *parcel_alloc(struct parcel *p, size_t len)
+{
+	void *ptr;
+
+	len = (len + 3) & ~3;
+	if (p->len + len > p->cap) {
+		fprintf(stderr, "parcel overflow\n");
+		exit(1);
+	}
+	ptr = p->data + p->len;
+	p->len += len;
+	return ptr;
+}
+
+static void parcel_put_u32(struct parcel *p, uint32_t val)
+{
+	memcpy(parcel_alloc(p, sizeof(val)), &val, sizeof(val));
+}
+
+static void parcel_put_str16(struct parcel *p, const char *s)
+{
+	uint32_t len = strlen(s), i;
+	uint16_t *str;
+
+	parcel_put_u32(p, len);
+	str = parcel_alloc(p, (len + 1) * sizeof(uint16_t));
+	for (i = 0; i <= len; i++)
+		str[i] = (uint8_t)s[i];
+}
+
+static void parcel_put_obj(struct parcel *p, unsigned long type,
+			   unsigned long flags, long handle, void *cookie)
+{
+	struct flat_binder_object *obj;
+
+	p->offs[p->nr_offs++] = p->len;
+	obj = parcel_alloc(p, sizeof(*obj));
+	memset(obj, 0, sizeof(*obj));
+	obj->type = type;
+	obj->flags = flags;
+	obj->handle = handle;
+	obj->cookie = cookie;
+}
+
+static uint32_t parcel_get_u32(struct parcel *p)
+{
+	uint32_t val = 0;
+
+	if (p->pos + sizeof(val) <= p->len)
+		memcpy(&val, p->data + p->pos, sizeof(val));
+	p->pos += sizeof(val);
+	return val;
+}
+
+/* read a string16 as ASCII into @s */
+static int parcel_get_str16(struct parcel *p, char *s, size_t size)
+{
+	uint32_t len = parcel_get_u32(p), i;
+	uint16_t c;
+
+	if (len >= size || p->pos + (len + 1) * 2 > p->len)
+		return -1;
+	for (i = 0; i < len; i++) {
+		memcpy(&c, p->data + p->pos + i * 2, sizeof(c));
+		s[i] = c;
+	}
+	s[len] = '\0';
+	p->pos += ((len + 1) * 2 + 3) & ~3;
+	return 0;
+}
+
+/* the handle of the object at the current position, 0 if there is none */
+static long parcel_get_handle(struct parcel *p)
+{
+	struct flat_binder_object obj;
+	size_t i;
+
+	for (i = 0; i < p->nr_offs; i++) {
+		if (p->offs[i] != p->pos ||
+		    p->pos + sizeof(obj) > p->len)
+			continue;
+		memcpy(&obj, p->data + p->pos, sizeof(obj));
+		p->pos += sizeof(obj);
+		return obj.type == BINDER_TYPE_HANDLE ? obj.handle : 0;
+	}
+	return 0;
+}
+
+/*
+ * Context manager for when servicemanager is not running.  It answers
+ * the add and check calls of the benchmark processes, nothing else.
+ */
+static void run_manager(struct binder_state *bs)
+{
+	static struct {
+		char name[64];
+		long handle;
+	} services[MAX_SERVICES];
+	int nr_services = 0, i;
+	struct binder_transaction_data txn;
+	struct parcel in, reply;
+	char name[64];
+	long handle;
+
+	parcel_init(&reply, 64);
+	for (;;) {
+		if (binder_next(bs, &txn) != BR_TRANSACTION)
+			continue;
+
+		parcel_from_txn(&in, &txn);
+		reply.len = 0;
+		reply.nr_offs = 0;
+		parcel_get_u32(&in);
+		if (parcel_get_str16(&in, name, sizeof(name)) ||
+		    strcmp(name, svcmgr_id) ||
+		    parcel_get_str16(&in, name, sizeof(name))) {
+			parcel_put_u32(&reply, -1);
+		} else if (txn.code == SVC_MGR_ADD_SERVICE) {
+			handle = parcel_get_handle(&in);
+			if (handle && nr_services < MAX_SERVICES) {
+				binder_queue_u32(bs, BC_ACQUIRE, handle);
+				strcpy(services[nr_services].name, name);
+				services[nr_services++].handle = handle;
+			}
+			parcel_put_u32(&reply, handle ? 0 : -1);
+		} else if (txn.code == SVC_MGR_CHECK_SERVICE) {
+			for (i = 0; i < nr_services; i++)
+				if (!strcmp(services[i].name, name))
+					break;
+			if (i < nr_services)
+				parcel_put_obj(&reply, BINDER_TYPE_HANDLE, 0,
+					       services[i].handle, NULL);
+			else
+				parcel_put_u32(&reply, 0);
+		}
+		binder_queue_free(bs, txn.data.ptr.buffer);
+		if (!(txn.flags & TF_ONE_WAY))
+			binder_queue_txn(bs, BC_REPLY, 0, 0, 0, &reply);
+	}
+}
+
+/* become the context manager if nobody is, returns the pid or 0 */
+static pid_t start_manager(void)
+{
+	struct binder_state bs;
+	int fds[2];
+	char ok = 0;
+	pid_t pid;
+
+	if (pipe(fds))
+		die("pipe");
+	pid = fork();
+	if (pid < 0)
+		die("fork");
+	if (!pid) {
+		close(fds[0]);
+		binder_open_state(&bs);
+		ok = !ioctl(bs.fd, BINDER_SET_CONTEXT_MGR, 0);
+		if (write(fds[1], &ok, 1) != 1 || !ok)
+			_exit(0);
+		close(fds[1]);
+		run_manager(&bs);
+	}
+	close(fds[1]);
+	if (read(fds[0], &ok, 1) != 1)
+		ok = 0;
+	close(fds[0]);
+	if (!ok) {
+		waitpid(pid, NULL, 0);
+		return 0;
+	}
+	return pid;
+}
+
+static void publish(struct binder_state *bs, const char *name, void *cookie)
+{
+	struct binder_transaction_data reply;
+	struct parcel p;
+
+	parcel_init(&p, 256);
+	parcel_put_u32(&p, 0);
+	parcel_put_str16(&p, svcmgr_id);
+	parcel_put_str16(&p, name);
+	parcel_put_obj(&p, BINDER_TYPE_BINDER,
+		       FLAT_BINDER_FLAG_ACCEPTS_FDS | 0x7f, (long)cookie,
+		       cookie);
+	parcel_put_u32(&p, 0);	/* allow_isolated */
+	if (binder_call(bs, 0, SVC_MGR_ADD_SERVICE, &p, &reply)) {
+		fprintf(stderr, "publishing %s failed\n", name);
+		exit(1);
+	}
+	binder_queue_free(bs, reply.data.ptr.buffer);
+	free(p.data);
+}
+
+static long lookup(struct binder_state *bs, const char *name)
+{
+	struct binder_transaction_data reply;
+	struct parcel p, r;
+	long handle = 0;
+	int tries;
+
+	parcel_init(&p, 256);
+	parcel_put_u32(&p, 0);
+	parcel_put_str16(&p, svcmgr_id);
+	parcel_put_str16(&p, name);
+	for (tries = 0; !handle && tries < 100; tries++) {
+		if (tries)
+			usleep(10000);
+		if (binder_call(bs, 0, SVC_MGR_CHECK_SERVICE, &p, &reply))
+			continue;
+		parcel_from_txn(&r, &reply);
+		handle = parcel_get_handle(&r);
+		/* our own reference, the one of the reply goes with it */
+		if (handle)
+			binder_queue_u32(bs, BC_ACQUIRE, handle);
+		binder_queue_free(bs, reply.data.ptr.buffer);
+	}
+	free(p.data);
+	if (!handle) {
+		fprintf(stderr, "%s not found\n", name);
+		exit(1);
+	}
+	return handle;
+}
+
+static void run_server(const char *name, int cpu, int ready_fd)
+{
+	static int cookie;
+	struct binder_transaction_data txn;
+	struct flat_binder_object obj;
+	struct binder_state bs;
+	struct parcel reply;
+	size_t i, off, nr_offs;
+
+	pin_to_cpu(cpu);
+	binder_open_state(&bs);
+	binder_queue(&bs, BC_ENTER_LOOPER, NULL, 0);
+	publish(&bs, name, &cookie);
+	if (write(ready_fd, "", 1) != 1)
+		die("write");
+	close(ready_fd);
+
+	parcel_init(&reply, 16);
+	for (;;) {
+		if (binder_next(&bs, &txn) != BR_TRANSACTION)
+			continue;
+
+		nr_offs = txn.offsets_size / sizeof(size_t);
+		for (i = 0; i < nr_offs; i++) {
+			memcpy(&off, (const size_t *)txn.data.ptr.offsets + i,
+			       sizeof(off));
+			memcpy(&obj, (const uint8_t *)txn.data.ptr.buffer + off,
+			       sizeof(obj));
+			if (obj.type == BINDER_TYPE_FD)
+				close(obj.handle);
+		}
+		binder_queue_free(&bs, txn.data.ptr.buffer);
+		if (!(txn.flags & TF_ONE_WAY))
+			binder_queue_txn(&bs, BC_REPLY, 0, 0, 0, &reply);
+		if (txn.code == BENCH_QUIT) {
+			/* write the reply out */
+			binder_queue(&bs, BC_EXIT_LOOPER, NULL, 0);
+			while (binder_next(&bs, &txn) !=
+			       BR_TRANSACTION_COMPLETE)
+				;
+			_exit(0);
+		}
+	}
+}
+
+static void run_client(const char *name, int cpu, int go_fd, int result_fd,
+		       size_t size, int oneway, int with_fd)
+{
+	struct binder_transaction_data txn;
+	struct client_result res = { 0 };
+	struct binder_state bs;
+	struct parcel p, quit;
+	uint32_t *lat, cmd;
+	uint64_t start, t0;
+	long handle;
+	int devnull = -1, i;
+	char c;
+
+	pin_to_cpu(cpu);
+	binder_open_state(&bs);
+	handle = lookup(&bs, name);
+
+	lat = calloc(opt_iterations, sizeof(*lat));
+	parcel_init(&p, size + sizeof(struct flat_binder_object) + 4);
+	if (with_fd) {
+		devnull = open("/dev/null", O_RDONLY);
+		if (devnull < 0)
+			die("open /dev/null");
+		parcel_put_obj(&p, BINDER_TYPE_FD, 0, devnull, NULL);
+	}
+	if (p.len < size)
+		parcel_alloc(&p, size - p.len);
+
+	/* everybody starts when the parent closes the pipe */
+	if (read(go_fd, &c, 1) < 0)
+		die("read");
+	close(go_fd);
+
+	start = now_ns();
+	for (i = 0; i < opt_iterations; i++) {
+		t0 = now_ns();
+		binder_queue_txn(&bs, BC_TRANSACTION, handle, BENCH_CALL,
+				 oneway ? TF_ONE_WAY : TF_ACCEPT_FDS, &p);
+		for (;;) {
+			cmd = binder_next(&bs, &txn);
+			if (cmd == BR_TRANSACTION_COMPLETE && !oneway)
+				continue;
+			break;
+		}
+		if (cmd == BR_REPLY)
+			binder_queue_free(&bs, txn.data.ptr.buffer);
+		else if (cmd != BR_TRANSACTION_COMPLETE) {
+			res.failed++;
+			continue;
+		}
+		lat[res.nr++] = now_ns() - t0;
+	}
+	res.elapsed_ns = now_ns() - start;
+
+	parcel_init(&quit, 4);
+	if (!binder_call(&bs, handle, BENCH_QUIT, &quit, &txn))
+		binder_queue_free(&bs, txn.data.ptr.buffer);
+	binder_queue_u32(&bs, BC_RELEASE, handle);
+	binder_transfer(&bs);
+
+	if (write(result_fd, &res, sizeof(res)) != sizeof(res) ||
+	    write(result_fd, lat, res.nr * sizeof(*lat)) !=
+	    (ssize_t)(res.nr * sizeof(*lat)))
+		die("write");
+	_exit(0);
+}
+
+static int read_full(int fd, void *buf, size_t len)
+{
+	ssize_t ret;
+
+	while (len) {
+		ret = read(fd, buf, len);
+		if (ret <= 0)
+			return -1;
+		buf = (uint8_t *)buf + ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static double pct_us(uint32_t *lat, size_t nr, int permille)
+{
+	return lat[(nr - 1) * permille / 1000] / 1000.0;
+}
+
+/* run @nr_pairs pairs at once, returns transactions per second */
+static double run_one(int nr_pairs, size_t size, int oneway, int with_fd,
+		      double base)
+{
+	static int generation;
+	pid_t pids[2 * MAX_PAIRS];
+	int result_fds[MAX_PAIRS];
+	int go[2], ready[2], res_pipe[2];
+	struct client_result res;
+	uint32_t *lat = NULL;
+	size_t nr = 0;
+	uint64_t elapsed = 0;
+	uint32_t failed = 0;
+	char name[64], c;
+	double rate;
+	int i, nr_pids = 0;
+
+	generation++;
+	if (pipe(go))
+		die("pipe");
+	for (i = 0; i < nr_pairs; i++) {
+		snprintf(name, sizeof(name), "binder_bench.%d.%d.%d",
+			 getpid(), generation, i);
+		if (pipe(ready) || pipe(res_pipe))
+			die("pipe");
+
+		pids[nr_pids] = fork();
+		if (pids[nr_pids] < 0)
+			die("fork");
+		if (!pids[nr_pids]) {
+			close(ready[0]);
+			close(go[1]);
+			run_server(name, 2 * i + 1, ready[1]);
+		}
+		nr_pids++;
+		close(ready[1]);
+		if (read(ready[0], &c, 1) != 1) {
+			fprintf(stderr, "server %d did not start\n", i);
+			exit(1);
+		}
+		close(ready[0]);
+
+		pids[nr_pids] = fork();
+		if (pids[nr_pids] < 0)
+			die("fork");
+		if (!pids[nr_pids]) {
+			close(res_pipe[0]);
+			close(go[1]);
+			run_client(name, 2 * i, go[0], res_pipe[1], size,
+				   oneway, with_fd);
+		}
+		nr_pids++;
+		close(res_pipe[1]);
+		result_fds[i] = res_pipe[0];
+	}
+	close(go[0]);
+	close(go[1]);
+
+	lat = malloc((size_t)nr_pairs * opt_iterations * sizeof(*lat));
+	if (!lat)
+		die("malloc");
+	for (i = 0; i < nr_pairs; i++) {
+		if (read_full(result_fds[i], &res, sizeof(res)) ||
+		    read_full(result_fds[i], lat + nr,
+			      res.nr * sizeof(*lat))) {
+			fprintf(stderr, "client %d failed\n", i);
+			exit(1);
+		}
+		close(result_fds[i]);
+		nr += res.nr;
+		failed += res.failed;
+		if (res.elapsed_ns > elapsed)
+			elapsed = res.elapsed_ns;
+	}
+	for (i = 0; i < nr_pids; i++)
+		waitpid(pids[i], NULL, 0);
+
+	rate = elapsed ? nr * 1e9 / elapsed : 0;
+	printf("%-6s %6zu %3d %5d %9.0f %5.2f", oneway ? "oneway" : "sync",
+	       size, with_fd, nr_pairs, rate, base ? rate / base : 1.0);
+	if (nr) {
+		qsort(lat, nr, sizeof(*lat), cmp_u32);
+		printf(" %8.1f %8.1f %8.1f %8.1f %8.1f",
+		       pct_us(lat, nr, 500), pct_us(lat, nr, 900),
+		       pct_us(lat, nr, 990), pct_us(lat, nr, 999),
+		       lat[nr - 1] / 1000.0);
+	}
+	printf(" %6u\n", failed);
+	fflush(stdout);
+	free(lat);
+	return rate;
+}
+
+static int parse_list(const char *s, long *vals, int max)
+{
+	char *end;
+	int n = 0;
+
+	while (*s && n < max) {
+		vals[n++] = strtol(s, &end, 0);
+		if (end == s)
+			return -1;
+		s = *end == ',' ? end + 1 : end;
+	}
+	return n;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-n iterations] [-s sizes] [-p pairs] [-m modes]\n"
+		"          [-f fds] [-a]\n"
+		"  -n  transactions per client (10000)\n"
+		"  -s  payload sizes in bytes (0,128,1024,4096,16384)\n"
+		"  -p  numbers of concurrent pairs (1,2,4.. up to the cpus)\n"
+		"  -m  0 for sync, 1 for oneway transactions (0,1)\n"
+		"  -f  0 without, 1 with a file descriptor in each (0,1)\n"
+		"  -a  pin pair n to cpus 2n and 2n+1\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	long sizes[MAX_SIZES] = { 0, 128, 1024, 4096, 16384 };
+	long pairs[MAX_SIZES], modes[2] = { 0, 1 }, fds[2] = { 0, 1 };
+	int nr_sizes = 5, nr_pairs = 0, nr_modes = 2, nr_fds = 2;
+	int opt, s, p, m, f;
+	pid_t manager;
+	double base;
+
+	nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	if (nr_cpus < 1)
+		nr_cpus = 1;
+	for (p = 1; p <= nr_cpus && nr_pairs < MAX_SIZES; p *= 2)
+		pairs[nr_pairs++] = p;
+	if (pairs[nr_pairs - 1] != nr_cpus && nr_pairs < MAX_SIZES)
+		pairs[nr_pairs++] = nr_cpus;
+
+	while ((opt = getopt(argc, argv, "n:s:p:m:f:ah")) != -1) {
+		switch (opt) {
+		case 'n':
+			opt_iterations = atoi(optarg);
+			break;
+		case 's':
+			nr_sizes = parse_list(optarg, sizes, MAX_SIZES);
+			break;
+		case 'p':
+			nr_pairs = parse_list(optarg, pairs, MAX_SIZES);
+			break;
+		case 'm':
+			nr_modes = parse_list(optarg, modes, 2);
+			break;
+		case 'f':
+			nr_fds = parse_list(optarg, fds, 2);
+			break;
+		case 'a':
+			opt_pin = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (opt_iterations < 1 || nr_sizes < 1 || nr_pairs < 1 ||
+	    nr_modes < 1 || nr_fds < 1)
+		usage(argv[0]);
+	for (p = 0; p < nr_pairs; p++)
+		if (pairs[p] < 1 || pairs[p] > MAX_PAIRS)
+			usage(argv[0]);
+	for (s = 0; s < nr_sizes; s++)
+		if (sizes[s] < 0 || sizes[s] > BINDER_MAP_SIZE / 4)
+			usage(argv[0]);
+
+	manager = start_manager();
+	printf("# %d cpus, %d transactions per client, context manager %s\n",
+	       nr_cpus, opt_iterations, manager ? "own" : "servicemanager");
+	printf("%-6s %6s %3s %5s %9s %5s %8s %8s %8s %8s %8s %6s\n",
+	       "mode", "size", "fd", "pairs", "txn/s", "scale", "p50us",
+	       "p90us", "p99us", "p999us", "maxus", "failed");
+
+	for (m = 0; m < nr_modes; m++)
+		for (f = 0; f < nr_fds; f++)
+			for (s = 0; s < nr_sizes; s++) {
+				base = 0;
+				for (p = 0; p < nr_pairs; p++) {
+					double rate = run_one(pairs[p],
+						sizes[s], modes[m], fds[f],
+						base);
+					if (!base)
+						base = rate / pairs[p];
+				}
+			}
+
+	if (manager) {
+		kill(manager, SIGKILL);
+		waitpid(manager, NULL, 0);
+	}
+	return 0;
+}